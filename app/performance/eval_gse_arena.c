@@ -0,0 +1,244 @@
+/*
+ *
+ * This piece of software is an implementation of the Generic Stream
+ * Encapsulation (GSE) standard defined by ETSI for Linux (or other
+ * Unix-compatible OS). The library may be used to add GSE
+ * encapsulation/de-encapsulation capabilities to an application.
+ *
+ *
+ * Copyright © 2013 TAS
+ *
+ *
+ * This file is part of the GSE library.
+ *
+ *
+ * The GSE library is free software : you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY, without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see http://www.gnu.org/licenses/.
+ *
+ */
+
+/**
+ * @file     eval_gse_arena.c
+ * @brief    Evaluate the dTLB misses of the virtual buffer allocators
+ *
+ * Many GSE packets are kept in flight, the oldest one is replaced by a new
+ * packet in a random slot and the headers of other packets in flight are
+ * read, as a scheduler would. The buffers are allocated on their own, from
+ * a pool and from a hugepage pool in turn. The time and the dTLB load
+ * misses per packet are printed for each allocator. The misses are read
+ * from the hardware counters with perf_event_open(), they are not printed
+ * when the counters are not available.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "constants.h"
+#include "virtual_fragment.h"
+
+#define NB_PACKETS 2000000
+
+/* About 70 MB of packet buffers in flight */
+#define IN_FLIGHT 16384
+/* The headers of other packets read for each new packet */
+#define PEEK_NR 4
+
+#define PAYLOAD_LENGTH 1400
+#define HEAD_OFFSET GSE_MAX_REFRAG_HEAD_OFFSET
+#define TRAIL_OFFSET GSE_MAX_TRAILER_LENGTH
+#define MAX_LENGTH (GSE_VFRAG_POOL_PACKET_LENGTH - HEAD_OFFSET - TRAIL_OFFSET)
+
+gse_vfrag_t *packets[IN_FLIGHT];
+unsigned char payload[PAYLOAD_LENGTH];
+
+static double
+_unix_time(void)
+{
+	struct timeval timev;
+
+	gettimeofday(&timev, NULL);
+	return (double)timev.tv_sec + (((double)timev.tv_usec) / 1000000);
+}
+
+/* Open the dTLB load misses counter of the process, -1 if not available */
+static int
+_open_counter(void)
+{
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.type = PERF_TYPE_HW_CACHE;
+	attr.size = sizeof(attr);
+	attr.config = PERF_COUNT_HW_CACHE_DTLB |
+	              (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+	              (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+
+	return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static void
+_start_counter(int fd)
+{
+	if (fd < 0)
+		return;
+	ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+	ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+}
+
+static unsigned long long
+_stop_counter(int fd)
+{
+	unsigned long long count = 0;
+
+	if (fd < 0)
+		return 0;
+	ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+	if (read(fd, &count, sizeof(count)) != sizeof(count))
+		return 0;
+	return count;
+}
+
+/* Create a packet with the given allocator, pool is NULL for malloc */
+static gse_status_t
+_create_packet(gse_vfrag_pool_t *pool, gse_vfrag_t **packet)
+{
+	if (pool == NULL)
+		return gse_create_vfrag(packet, MAX_LENGTH, HEAD_OFFSET,
+		                        TRAIL_OFFSET);
+	return gse_create_vfrag_from_pool(packet, pool, MAX_LENGTH, HEAD_OFFSET,
+	                                  TRAIL_OFFSET);
+}
+
+/* Run the packets through an allocator, pool is NULL for malloc */
+static int
+_run(const char *name, gse_vfrag_pool_t *pool, int fd)
+{
+	gse_status_t status;
+	unsigned long long misses;
+	unsigned int seed = 1;
+	unsigned int sum = 0;
+	double clock_start;
+	double tics;
+	unsigned int slot;
+	unsigned int i;
+	unsigned int j;
+
+	for (i = 0 ; i < IN_FLIGHT ; ++i)
+	{
+		status = _create_packet(pool, &packets[i]);
+		if (status != GSE_STATUS_OK)
+			goto fail;
+		gse_copy_data(packets[i], payload, PAYLOAD_LENGTH);
+	}
+
+	clock_start = _unix_time();
+	_start_counter(fd);
+	for (i = 0 ; i < NB_PACKETS ; ++i)
+	{
+		seed = seed * 1103515245 + 12345;
+		slot = (seed >> 8) % IN_FLIGHT;
+		gse_free_vfrag(&packets[slot]);
+		status = _create_packet(pool, &packets[slot]);
+		if (status != GSE_STATUS_OK)
+			goto fail;
+		gse_copy_data(packets[slot], payload, PAYLOAD_LENGTH);
+		gse_shift_vfrag(packets[slot], -HEAD_OFFSET, 0);
+
+		for (j = 0 ; j < PEEK_NR ; ++j)
+		{
+			seed = seed * 1103515245 + 12345;
+			sum += gse_get_vfrag_start(packets[(seed >> 8) % IN_FLIGHT])[0];
+		}
+	}
+	misses = _stop_counter(fd);
+	tics = _unix_time() - clock_start;
+
+	printf("%s\n", name);
+	printf("  Tics / packet: %e seconds\n", tics / NB_PACKETS);
+	if (fd >= 0)
+		printf("  dTLB misses / packet: %.3f\n", (double)misses / NB_PACKETS);
+	else
+		printf("  dTLB misses / packet: not available\n");
+
+	for (i = 0 ; i < IN_FLIGHT ; ++i)
+		gse_free_vfrag(&packets[i]);
+	return (sum == 0xFFFFFFFF);
+
+fail:
+	fprintf(stderr, "Fail to create the packets: %s\n",
+	        gse_get_status(status));
+	for (i = 0 ; i < IN_FLIGHT ; ++i)
+	{
+		if (packets[i] != NULL)
+			gse_free_vfrag(&packets[i]);
+	}
+	return 1;
+}
+
+int main(void)
+{
+	gse_vfrag_pool_t *pool;
+	gse_vfrag_pool_t *hugepage_pool;
+	gse_status_t status;
+	int is_failure = 1;
+	int fd;
+	unsigned int i;
+
+	for (i = 0 ; i < PAYLOAD_LENGTH ; ++i)
+		payload[i] = i & 0xFF;
+
+	fd = _open_counter();
+
+	status = gse_vfrag_pool_init(GSE_VFRAG_POOL_PACKET_LENGTH, &pool);
+	if (status != GSE_STATUS_OK)
+	{
+		fprintf(stderr, "Fail to create the pool: %s\n",
+		        gse_get_status(status));
+		goto close;
+	}
+	status = gse_vfrag_pool_init_hugepage(GSE_VFRAG_POOL_PACKET_LENGTH,
+	                                      &hugepage_pool);
+	if (status != GSE_STATUS_OK)
+	{
+		fprintf(stderr, "Fail to create the hugepage pool: %s\n",
+		        gse_get_status(status));
+		goto release_pool;
+	}
+
+	printf("Packets: %d, in flight: %d\n", NB_PACKETS, IN_FLIGHT);
+	if (_run("malloc", NULL, fd) ||
+	    _run("Pool", pool, fd) ||
+	    _run("Hugepage pool", hugepage_pool, fd))
+		goto release_hugepage_pool;
+
+	/* everything went fine */
+	is_failure = 0;
+
+release_hugepage_pool:
+	gse_vfrag_pool_release(hugepage_pool);
+release_pool:
+	gse_vfrag_pool_release(pool);
+close:
+	if (fd >= 0)
+		close(fd);
+	return is_failure;
+}
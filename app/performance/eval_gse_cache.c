@@ -0,0 +1,268 @@
+/*
+ *
+ * This piece of software is an implementation of the Generic Stream
+ * Encapsulation (GSE) standard defined by ETSI for Linux (or other
+ * Unix-compatible OS). The library may be used to add GSE
+ * encapsulation/de-encapsulation capabilities to an application.
+ *
+ *
+ * Copyright © 2013 TAS
+ *
+ *
+ * This file is part of the GSE library.
+ *
+ *
+ * The GSE library is free software : you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY, without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see http://www.gnu.org/licenses/.
+ *
+ */
+
+/**
+ * @file     eval_gse_cache.c
+ * @brief    Evaluate the cache misses of the libgse contexts
+ *
+ * PDUs are fragmented on many QoS at once so that the encapsulation and the
+ * deencapsulation go through many contexts in turn, a new BBFrame is
+ * signaled to the deencapsulation after each round. The time and the cache
+ * misses per packet are printed for each stage. The cache misses are read
+ * from the hardware counters with perf_event_open(), they are not printed
+ * when the counters are not available.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "constants.h"
+#include "encap.h"
+#include "deencap.h"
+#include "virtual_fragment.h"
+
+#define NB_ROUNDS 1000
+
+/* Each QoS value is a FragID, a PDU is being fragmented on each of them */
+#define QOS_NR 250
+#define FIFO_SIZE 4
+
+#define PDU_LENGTH 4000
+#define PACKET_LENGTH 400
+/* Upper bound of the number of packets of a PDU */
+#define PACKET_PER_PDU (PDU_LENGTH / (PACKET_LENGTH - GSE_MAX_HEADER_LENGTH - \
+                                      GSE_MAX_TRAILER_LENGTH) + 2)
+
+#define PROTOCOL_TYPE 0x0800
+
+gse_vfrag_t *packets[QOS_NR * PACKET_PER_PDU];
+unsigned char ip_payload[PDU_LENGTH];
+
+uint8_t label[6] = { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05 };
+
+static double
+_unix_time(void)
+{
+	struct timeval timev;
+
+	gettimeofday(&timev, NULL);
+	return (double)timev.tv_sec + (((double)timev.tv_usec) / 1000000);
+}
+
+/* Open the cache misses counter of the process, -1 if not available */
+static int
+_open_counter(void)
+{
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.size = sizeof(attr);
+	attr.config = PERF_COUNT_HW_CACHE_MISSES;
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+
+	return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static void
+_start_counter(int fd)
+{
+	if (fd < 0)
+		return;
+	ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+	ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+}
+
+static unsigned long long
+_stop_counter(int fd)
+{
+	unsigned long long count = 0;
+
+	if (fd < 0)
+		return 0;
+	ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+	if (read(fd, &count, sizeof(count)) != sizeof(count))
+		return 0;
+	return count;
+}
+
+static void
+_print_stage(const char *name, int fd, double tics,
+             unsigned long long misses, unsigned long long packet_nbr)
+{
+	printf("%s\n", name);
+	printf("  Tics / packet: %e seconds\n", tics / packet_nbr);
+	if (fd >= 0)
+		printf("  Cache misses / packet: %.3f\n", (double)misses / packet_nbr);
+	else
+		printf("  Cache misses / packet: not available\n");
+}
+
+int main(void)
+{
+	gse_encap_t *encap_context;
+	gse_deencap_t *deencap_context;
+	gse_vfrag_t *in_vfrag;
+	gse_vfrag_t *pdu;
+	gse_status_t status;
+	uint8_t rcv_label[6];
+	uint8_t label_type;
+	uint16_t protocol;
+	uint16_t packet_length;
+	unsigned long long encap_misses = 0, deencap_misses = 0;
+	unsigned long long packet_total = 0, pdu_total = 0;
+	double clock_start, encap_tics = 0, deencap_tics = 0;
+	unsigned int packet_nbr;
+	unsigned int i;
+	int is_failure = 1;
+	int round;
+	int fd;
+	int qos;
+
+	fd = _open_counter();
+
+	status = gse_encap_init(QOS_NR, FIFO_SIZE, &encap_context);
+	if (status != GSE_STATUS_OK)
+	{
+		fprintf(stderr, "Fail to initialize encapsulation library: %s\n",
+		        gse_get_status(status));
+		goto close;
+	}
+	status = gse_deencap_init(QOS_NR, &deencap_context);
+	if (status != GSE_STATUS_OK)
+	{
+		fprintf(stderr, "Fail to initialize deencapsulation library: %s\n",
+		        gse_get_status(status));
+		goto release_encap;
+	}
+
+	for (round = 0 ; round < NB_ROUNDS ; ++round)
+	{
+		for (qos = 0 ; qos < QOS_NR ; ++qos)
+		{
+			status = gse_create_vfrag_with_data(&in_vfrag, PDU_LENGTH,
+			                                    GSE_MAX_HEADER_LENGTH,
+			                                    GSE_MAX_TRAILER_LENGTH,
+			                                    ip_payload, PDU_LENGTH);
+			if (status != GSE_STATUS_OK)
+				goto fail;
+			status = gse_encap_receive_pdu(in_vfrag, encap_context, label,
+			                               GSE_LT_6_BYTES, PROTOCOL_TYPE, qos);
+			if (status != GSE_STATUS_OK)
+				goto fail;
+		}
+
+		// One packet of each PDU in turn
+		packet_nbr = 0;
+		clock_start = _unix_time();
+		_start_counter(fd);
+		do
+		{
+			status = GSE_STATUS_FIFO_EMPTY;
+			for (qos = 0 ; qos < QOS_NR ; ++qos)
+			{
+				status = gse_encap_get_packet_copy(&packets[packet_nbr],
+				                                   encap_context,
+				                                   PACKET_LENGTH, qos);
+				if (status == GSE_STATUS_FIFO_EMPTY)
+					continue;
+				if (status != GSE_STATUS_OK)
+					break;
+				packet_nbr++;
+			}
+		}
+		while (status == GSE_STATUS_OK);
+		encap_misses += _stop_counter(fd);
+		encap_tics += _unix_time() - clock_start;
+		if (status != GSE_STATUS_FIFO_EMPTY)
+			goto fail;
+
+		clock_start = _unix_time();
+		_start_counter(fd);
+		for (i = 0 ; i < packet_nbr ; ++i)
+		{
+			if (i % QOS_NR == 0)
+				gse_deencap_new_bbframe(deencap_context);
+			status = gse_deencap_packet(packets[i], deencap_context,
+			                            &label_type, rcv_label, &protocol,
+			                            &pdu, &packet_length);
+			if (status == GSE_STATUS_PDU_RECEIVED)
+			{
+				gse_free_vfrag(&pdu);
+				pdu_total++;
+			}
+			else if (status != GSE_STATUS_OK)
+			{
+				// The next packets are freed by the deencapsulation
+				for (i++ ; i < packet_nbr ; ++i)
+					gse_free_vfrag(&packets[i]);
+				goto fail;
+			}
+		}
+		deencap_misses += _stop_counter(fd);
+		deencap_tics += _unix_time() - clock_start;
+		packet_total += packet_nbr;
+	}
+
+	if (pdu_total != (unsigned long long)NB_ROUNDS * QOS_NR)
+	{
+		fprintf(stderr, "%llu PDUs received instead of %d\n", pdu_total,
+		        NB_ROUNDS * QOS_NR);
+		goto release_deencap;
+	}
+
+	printf("Rounds: %d, contexts: %d, packets: %llu\n", NB_ROUNDS, QOS_NR,
+	       packet_total);
+	_print_stage("Encapsulation", fd, encap_tics, encap_misses, packet_total);
+	_print_stage("Deencapsulation", fd, deencap_tics, deencap_misses,
+	             packet_total);
+
+	/* everything went fine */
+	is_failure = 0;
+	goto release_deencap;
+
+fail:
+	fprintf(stderr, "Fail to send the PDUs: %s\n", gse_get_status(status));
+release_deencap:
+	gse_deencap_release(deencap_context);
+release_encap:
+	gse_encap_release(encap_context);
+close:
+	if (fd >= 0)
+		close(fd);
+	return is_failure;
+}
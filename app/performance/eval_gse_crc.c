@@ -0,0 +1,203 @@
+/*
+ *
+ * This piece of software is an implementation of the Generic Stream
+ * Encapsulation (GSE) standard defined by ETSI for Linux (or other
+ * Unix-compatible OS). The library may be used to add GSE
+ * encapsulation/de-encapsulation capabilities to an application.
+ *
+ *
+ * Copyright © 2013 TAS
+ *
+ *
+ * This file is part of the GSE library.
+ *
+ *
+ * The GSE library is free software : you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY, without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see http://www.gnu.org/licenses/.
+ *
+ */
+
+/**
+ * @file     eval_gse_crc.c
+ * @brief    Evaluate the CRC32 of large PDUs computed by several threads
+ *
+ * The CRC32 of PDUs shorter than the default minimum length of the parallel
+ * CRC32 (see gse_encap_set_crc_workers), of this length and of the maximum
+ * PDU length is computed by the calling thread alone, by the threads of a
+ * CRC32 pool and by threads created for each CRC32 as the pool replaces.
+ * The time per CRC32 and the speedup over the serial computation are
+ * printed for several numbers of threads. The speedup is only expected with
+ * as many free CPUs as threads, the difference between the pool and the
+ * serial times on a single CPU gives the cost of the threads.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#include "crc.h"
+
+#define NB_CRC 5000
+
+/* A length where the threads cost about as much as they save, the default
+ * minimum length of the PDUs whose CRC32 is computed by several threads and
+ * the maximum PDU length */
+#define SMALL_LENGTH 4096
+#define MIN_LENGTH 16384
+#define MAX_LENGTH 65535
+
+unsigned char data[MAX_LENGTH];
+
+/* A chunk computed by a thread created for one CRC32 */
+struct chunk
+{
+	unsigned char *data;
+	size_t length;
+	uint32_t crc;
+};
+
+static double
+_unix_time(void)
+{
+	struct timeval timev;
+
+	gettimeofday(&timev, NULL);
+	return (double)timev.tv_sec + (((double)timev.tv_usec) / 1000000);
+}
+
+static void *
+_compute_chunk(void *arg)
+{
+	struct chunk *chunk = arg;
+
+	chunk->crc = compute_crc(chunk->data, chunk->length, chunk->crc);
+	return NULL;
+}
+
+/* Compute a CRC32 with threads created for it */
+static uint32_t
+_compute_crc_threads(unsigned char *buf, size_t length,
+                     unsigned int worker_nbr)
+{
+	struct chunk chunks[GSE_CRC_MAX_WORKER_NBR];
+	pthread_t threads[GSE_CRC_MAX_WORKER_NBR];
+	size_t chunk_length = length / worker_nbr;
+	uint32_t crc;
+	unsigned int i;
+
+	for (i = 0 ; i < worker_nbr ; ++i)
+	{
+		chunks[i].data = buf + i * chunk_length;
+		chunks[i].length = chunk_length;
+		chunks[i].crc = 0;
+	}
+	chunks[0].crc = GSE_CRC_INIT;
+	chunks[worker_nbr - 1].length = length - (worker_nbr - 1) * chunk_length;
+
+	for (i = 1 ; i < worker_nbr ; ++i)
+	{
+		if (pthread_create(&threads[i], NULL, _compute_chunk, &chunks[i]) != 0)
+			return 0;
+	}
+	_compute_chunk(&chunks[0]);
+	crc = chunks[0].crc;
+	for (i = 1 ; i < worker_nbr ; ++i)
+	{
+		pthread_join(threads[i], NULL);
+		crc = combine_crc(crc, chunks[i].crc, chunks[i].length);
+	}
+	return crc;
+}
+
+/* Time per CRC32 of the given length, pool and worker_nbr are unused for
+ * the serial computation, pool is NULL for the threads created per CRC32 */
+static double
+_run(size_t length, int serial, gse_crc_pool_t *pool,
+     unsigned int worker_nbr, uint32_t ref_crc)
+{
+	double clock_start;
+	uint32_t crc = ref_crc;
+	unsigned int i;
+
+	clock_start = _unix_time();
+	for (i = 0 ; i < NB_CRC && crc == ref_crc ; ++i)
+	{
+		if (serial)
+			crc = compute_crc(data, length, GSE_CRC_INIT);
+		else if (pool != NULL)
+			crc = compute_crc_parallel(pool, data, length, GSE_CRC_INIT);
+		else
+			crc = _compute_crc_threads(data, length, worker_nbr);
+	}
+	if (crc != ref_crc)
+	{
+		fprintf(stderr, "Wrong CRC32 for %zu bytes with %u threads\n",
+		        length, worker_nbr);
+		return -1;
+	}
+	return (_unix_time() - clock_start) / NB_CRC;
+}
+
+int main(void)
+{
+	const size_t lengths[] = { SMALL_LENGTH, MIN_LENGTH, MAX_LENGTH };
+	const unsigned int worker_nbrs[] = { 2, 4, 8 };
+	gse_crc_pool_t *pool;
+	gse_status_t status;
+	double serial_tics;
+	double pool_tics;
+	double threads_tics;
+	uint32_t ref_crc;
+	unsigned int i;
+	unsigned int j;
+
+	for (i = 0 ; i < MAX_LENGTH ; ++i)
+		data[i] = (i * 7) & 0xFF;
+
+	printf("CRC32: %d per measure, online CPUs: %ld\n", NB_CRC,
+	       sysconf(_SC_NPROCESSORS_ONLN));
+	for (i = 0 ; i < sizeof(lengths) / sizeof(lengths[0]) ; ++i)
+	{
+		ref_crc = compute_crc(data, lengths[i], GSE_CRC_INIT);
+		serial_tics = _run(lengths[i], 1, NULL, 1, ref_crc);
+		if (serial_tics < 0)
+			return 1;
+		printf("%zu bytes\n", lengths[i]);
+		printf("  Serial: %e seconds\n", serial_tics);
+
+		for (j = 0 ; j < sizeof(worker_nbrs) / sizeof(worker_nbrs[0]) ; ++j)
+		{
+			status = gse_crc_pool_init(worker_nbrs[j], &pool);
+			if (status != GSE_STATUS_OK)
+			{
+				fprintf(stderr, "Fail to create the pool: %s\n",
+				        gse_get_status(status));
+				return 1;
+			}
+			pool_tics = _run(lengths[i], 0, pool, worker_nbrs[j], ref_crc);
+			gse_crc_pool_release(pool);
+			threads_tics = _run(lengths[i], 0, NULL, worker_nbrs[j], ref_crc);
+			if (pool_tics < 0 || threads_tics < 0)
+				return 1;
+			printf("  %u threads: pool %e seconds (speedup %.2f), "
+			       "created per CRC32 %e seconds (speedup %.2f)\n",
+			       worker_nbrs[j], pool_tics, serial_tics / pool_tics,
+			       threads_tics, serial_tics / threads_tics);
+		}
+	}
+
+	return 0;
+}
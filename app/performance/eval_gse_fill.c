@@ -0,0 +1,209 @@
+/*
+ *
+ * This piece of software is an implementation of the Generic Stream
+ * Encapsulation (GSE) standard defined by ETSI for Linux (or other
+ * Unix-compatible OS). The library may be used to add GSE
+ * encapsulation/de-encapsulation capabilities to an application.
+ *
+ *
+ * Copyright © 2013 TAS
+ *
+ *
+ * This file is part of the GSE library.
+ *
+ *
+ * The GSE library is free software : you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY, without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see http://www.gnu.org/licenses/.
+ *
+ */
+
+/**
+ * @file     eval_gse_fill.c
+ * @brief    Evaluate the frame filling policies of the libgse encapsulation
+ *
+ * Frames are filled with a mix of small, medium and large PDUs spread on two
+ * QoS, with each policy. The share of the frames used for PDU data, GSE
+ * headers, CRC and padding is printed with the time spent per frame, and
+ * the time spent scrambling the complete frames.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <sys/time.h>
+
+#include "constants.h"
+#include "encap.h"
+#include "virtual_fragment.h"
+#include "bbframe.h"
+
+#define BBFRAME_LENGTH 2001
+
+#define NB_FRAMES 1E5
+
+#define QOS_NR 2
+/* The FIFOs are full before filling each frame */
+#define FIFO_SIZE 32
+
+#define PROTOCOL_TYPE 0x0800
+
+unsigned char bbframe[BBFRAME_LENGTH];
+unsigned char ip_payload[GSE_MAX_PDU_LENGTH];
+
+uint8_t label[6] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+
+static const char *policy_names[] = { "FIFO", "first fit", "best fit" };
+
+static double
+_unix_time(void)
+{
+	struct timeval timev;
+
+	gettimeofday(&timev, NULL);
+	return (double)timev.tv_sec + (((double)timev.tv_usec) / 1000000);
+}
+
+/* Simple IMIX: 7 PDUs of 40 bytes, 4 of 576 bytes and 1 of 1500 bytes */
+static size_t
+_pdu_length(unsigned int *seed)
+{
+	unsigned int draw;
+
+	*seed = *seed * 1103515245 + 12345;
+	draw = (*seed >> 16) % 12;
+	if (draw < 7)
+		return 40;
+	if (draw < 11)
+		return 576;
+	return 1500;
+}
+
+static int
+_eval_policy(gse_fill_policy_t policy)
+{
+	gse_encap_t *encap_context;
+	gse_vfrag_t *in_vfrag;
+	gse_frame_stats_t stats;
+	gse_status_t status;
+	int is_failure = 1;
+
+	unsigned long long payload = 0, header = 0, crc = 0, padding = 0;
+	unsigned long long packets = 0, fragments = 0;
+	unsigned int seed = 1;
+	size_t length;
+	size_t data_length;
+	double clock_start, total_tics = 0, scramble_tics = 0;
+	long long iter;
+	uint8_t qos;
+
+	status = gse_encap_init(QOS_NR, FIFO_SIZE, &encap_context);
+	if (status != GSE_STATUS_OK)
+	{
+		fprintf(stderr, "Fail to initialize encapsulation library: %s\n",
+		        gse_get_status(status));
+		goto error;
+	}
+
+	for (iter = 0 ; iter < NB_FRAMES ; ++iter)
+	{
+		// Refill the FIFOs
+		for (qos = 0 ; qos < QOS_NR ; qos++)
+		{
+			do
+			{
+				length = _pdu_length(&seed);
+				status = gse_create_vfrag_with_data(&in_vfrag, length,
+				                                    GSE_MAX_HEADER_LENGTH,
+				                                    GSE_MAX_TRAILER_LENGTH,
+				                                    ip_payload, length);
+				if (status != GSE_STATUS_OK)
+				{
+					fprintf(stderr, "Fail to create input vfrag: %s\n",
+					        gse_get_status(status));
+					goto free_context;
+				}
+				// The PDU is destroyed when the FIFO is full
+				status = gse_encap_receive_pdu(in_vfrag, encap_context, label,
+				                               GSE_LT_NO_LABEL, PROTOCOL_TYPE, qos);
+				if (status != GSE_STATUS_OK && status != GSE_STATUS_FIFO_FULL)
+				{
+					fprintf(stderr, "Fail to receive PDU: %s\n",
+					        gse_get_status(status));
+					goto free_context;
+				}
+			}
+			while (status == GSE_STATUS_OK);
+		}
+
+		clock_start = _unix_time();
+		status = gse_encap_fill_frame(encap_context, policy, bbframe,
+		                              BBFRAME_LENGTH, &data_length, &stats);
+		total_tics += _unix_time() - clock_start;
+		if (status != GSE_STATUS_OK)
+		{
+			fprintf(stderr, "Fail to fill frame: %s\n",
+			        gse_get_status(status));
+			goto free_context;
+		}
+
+		// The whole frame goes through the baseband scrambler
+		clock_start = _unix_time();
+		status = gse_scramble_bbframe(bbframe, BBFRAME_LENGTH);
+		scramble_tics += _unix_time() - clock_start;
+		if (status != GSE_STATUS_OK)
+		{
+			fprintf(stderr, "Fail to scramble frame: %s\n",
+			        gse_get_status(status));
+			goto free_context;
+		}
+
+		payload += stats.payload_length;
+		header += stats.header_length;
+		crc += stats.crc_length;
+		padding += stats.padding_length;
+		packets += stats.packet_nbr;
+		fragments += stats.fragment_nbr;
+	}
+
+	printf("Policy: %s\n", policy_names[policy]);
+	printf("  Frames: %e, packets: %llu, fragments: %llu\n",
+	       NB_FRAMES, packets, fragments);
+	printf("  Payload: %.3f%%, header: %.3f%%, CRC: %.3f%%, padding: %.3f%%\n",
+	       100.0 * payload / (NB_FRAMES * BBFRAME_LENGTH),
+	       100.0 * header / (NB_FRAMES * BBFRAME_LENGTH),
+	       100.0 * crc / (NB_FRAMES * BBFRAME_LENGTH),
+	       100.0 * padding / (NB_FRAMES * BBFRAME_LENGTH));
+	printf("  Tics / frame: %e seconds\n", total_tics / NB_FRAMES);
+	printf("  Scrambling tics / frame: %e seconds (%.1f MB/s)\n",
+	       scramble_tics / NB_FRAMES,
+	       NB_FRAMES * BBFRAME_LENGTH / scramble_tics / 1E6);
+
+	/* everything went fine */
+	is_failure = 0;
+
+free_context:
+	gse_encap_release(encap_context);
+error:
+	return is_failure;
+}
+
+int main(void)
+{
+	int is_failure = 0;
+
+	is_failure |= _eval_policy(GSE_FILL_FIFO);
+	is_failure |= _eval_policy(GSE_FILL_FIRST_FIT);
+	is_failure |= _eval_policy(GSE_FILL_BEST_FIT);
+
+	return is_failure;
+}
@@ -0,0 +1,219 @@
+/*
+ *
+ * This piece of software is an implementation of the Generic Stream
+ * Encapsulation (GSE) standard defined by ETSI for Linux (or other
+ * Unix-compatible OS). The library may be used to add GSE
+ * encapsulation/de-encapsulation capabilities to an application.
+ *
+ *
+ * Copyright © 2013 TAS
+ *
+ *
+ * This file is part of the GSE library.
+ *
+ *
+ * The GSE library is free software : you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY, without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see http://www.gnu.org/licenses/.
+ *
+ */
+
+/**
+ * @file     eval_gse_instances.c
+ * @brief    Evaluate the creation and the memory of many libgse instances
+ *
+ * Pairs of encapsulation and deencapsulation structures are created as with
+ * one pair per stream, used for one fragmented PDU, then destroyed. The time
+ * spent per instance and the memory used by the instances after creation and
+ * after use are printed.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <sys/time.h>
+
+#include "constants.h"
+#include "encap.h"
+#include "deencap.h"
+#include "virtual_fragment.h"
+
+#define INSTANCE_NBR 10000
+
+#define QOS_NR 8
+#define FIFO_SIZE 1000
+/* Every FragID is accepted by the receivers */
+#define DEENCAP_QOS_NR 255
+
+#define PDU_LENGTH 1000
+#define PACKET_LENGTH 200
+
+#define PROTOCOL_TYPE 0x0800
+
+gse_encap_t *encap_contexts[INSTANCE_NBR];
+gse_deencap_t *deencap_contexts[INSTANCE_NBR];
+unsigned char ip_payload[PDU_LENGTH];
+
+uint8_t label[6] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+
+static double
+_unix_time(void)
+{
+	struct timeval timev;
+
+	gettimeofday(&timev, NULL);
+	return (double)timev.tv_sec + (((double)timev.tv_usec) / 1000000);
+}
+
+static int
+_get_footprint(size_t *footprint)
+{
+	gse_status_t status;
+	size_t size;
+	int i;
+
+	*footprint = 0;
+	for (i = 0 ; i < INSTANCE_NBR ; ++i)
+	{
+		status = gse_encap_get_footprint(encap_contexts[i], &size);
+		if (status != GSE_STATUS_OK)
+			goto error;
+		*footprint += size;
+		status = gse_deencap_get_footprint(deencap_contexts[i], &size);
+		if (status != GSE_STATUS_OK)
+			goto error;
+		*footprint += size;
+	}
+	return 0;
+
+error:
+	fprintf(stderr, "Fail to get footprint: %s\n", gse_get_status(status));
+	return 1;
+}
+
+static int
+_use_instance(gse_encap_t *encap_context, gse_deencap_t *deencap_context)
+{
+	gse_vfrag_t *in_vfrag;
+	gse_vfrag_t *packet;
+	gse_vfrag_t *pdu;
+	gse_status_t status;
+	uint8_t rcv_label[6];
+	uint8_t label_type;
+	uint16_t protocol;
+	uint16_t packet_length;
+
+	status = gse_create_vfrag_with_data(&in_vfrag, PDU_LENGTH,
+	                                    GSE_MAX_HEADER_LENGTH,
+	                                    GSE_MAX_TRAILER_LENGTH,
+	                                    ip_payload, PDU_LENGTH);
+	if (status != GSE_STATUS_OK)
+		goto error;
+	status = gse_encap_receive_pdu(in_vfrag, encap_context, label,
+	                               GSE_LT_NO_LABEL, PROTOCOL_TYPE, 0);
+	if (status != GSE_STATUS_OK)
+		goto error;
+
+	// Send the PDU in several fragments, the last one gives it back
+	do
+	{
+		status = gse_encap_get_packet_copy(&packet, encap_context,
+		                                   PACKET_LENGTH, 0);
+		if (status != GSE_STATUS_OK)
+			goto error;
+		status = gse_deencap_packet(packet, deencap_context, &label_type,
+		                            rcv_label, &protocol, &pdu,
+		                            &packet_length);
+	}
+	while (status == GSE_STATUS_OK);
+	if (status != GSE_STATUS_PDU_RECEIVED)
+		goto error;
+	gse_free_vfrag(&pdu);
+
+	return 0;
+
+error:
+	fprintf(stderr, "Fail to send a PDU: %s\n", gse_get_status(status));
+	return 1;
+}
+
+int main(void)
+{
+	gse_status_t status;
+	size_t footprint;
+	double clock_start;
+	double create_tics, use_tics, release_tics;
+	int is_failure = 1;
+	int nbr = 0;
+	int i;
+
+	clock_start = _unix_time();
+	for (nbr = 0 ; nbr < INSTANCE_NBR ; ++nbr)
+	{
+		status = gse_encap_init(QOS_NR, FIFO_SIZE, &encap_contexts[nbr]);
+		if (status != GSE_STATUS_OK)
+		{
+			fprintf(stderr, "Fail to initialize encapsulation library: %s\n",
+			        gse_get_status(status));
+			goto release;
+		}
+		status = gse_deencap_init(DEENCAP_QOS_NR, &deencap_contexts[nbr]);
+		if (status != GSE_STATUS_OK)
+		{
+			fprintf(stderr, "Fail to initialize deencapsulation library: %s\n",
+			        gse_get_status(status));
+			gse_encap_release(encap_contexts[nbr]);
+			goto release;
+		}
+	}
+	create_tics = _unix_time() - clock_start;
+
+	if (_get_footprint(&footprint))
+		goto release;
+	printf("Instances: %d (%d QoS, FIFOs of %d PDUs)\n", INSTANCE_NBR, QOS_NR,
+	       FIFO_SIZE);
+	printf("  Creation tics / instance: %e seconds\n",
+	       create_tics / INSTANCE_NBR);
+	printf("  Footprint after creation: %zu bytes / instance\n",
+	       footprint / INSTANCE_NBR);
+
+	clock_start = _unix_time();
+	for (i = 0 ; i < INSTANCE_NBR ; ++i)
+	{
+		if (_use_instance(encap_contexts[i], deencap_contexts[i]))
+			goto release;
+	}
+	use_tics = _unix_time() - clock_start;
+
+	if (_get_footprint(&footprint))
+		goto release;
+	printf("  Tics / PDU: %e seconds\n", use_tics / INSTANCE_NBR);
+	printf("  Footprint after one PDU: %zu bytes / instance\n",
+	       footprint / INSTANCE_NBR);
+
+	/* everything went fine */
+	is_failure = 0;
+
+release:
+	clock_start = _unix_time();
+	for (i = 0 ; i < nbr ; ++i)
+	{
+		gse_deencap_release(deencap_contexts[i]);
+		gse_encap_release(encap_contexts[i]);
+	}
+	release_tics = _unix_time() - clock_start;
+	if (!is_failure)
+		printf("  Release tics / instance: %e seconds\n",
+		       release_tics / INSTANCE_NBR);
+
+	return is_failure;
+}
@@ -0,0 +1,216 @@
+/*
+ *
+ * This piece of software is an implementation of the Generic Stream
+ * Encapsulation (GSE) standard defined by ETSI for Linux (or other
+ * Unix-compatible OS). The library may be used to add GSE
+ * encapsulation/de-encapsulation capabilities to an application.
+ *
+ *
+ * Copyright © 2013 TAS
+ *
+ *
+ * This file is part of the GSE library.
+ *
+ *
+ * The GSE library is free software : you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY, without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see http://www.gnu.org/licenses/.
+ *
+ */
+
+/**
+ * @file     eval_gse_numa.c
+ * @brief    Evaluate the throughput of libgse with local and remote memory
+ *
+ * The encapsulation and deencapsulation contexts and the pool of the PDUs
+ * are placed on a NUMA node, then the PDUs are encapsulated and
+ * deencapsulated by a thread running on each node in turn. The throughput
+ * is printed for each pair of CPU and memory nodes. On a machine with a
+ * single node only the local placement is measured.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <sys/time.h>
+
+#include "constants.h"
+#include "encap.h"
+#include "deencap.h"
+#include "virtual_fragment.h"
+#include "numa.h"
+
+#define NB_PDUS 200000
+
+#define QOS_NR 1
+#define FIFO_SIZE 4
+
+#define PDU_LENGTH 1500
+#define PACKET_LENGTH 400
+
+#define PROTOCOL_TYPE 0x0800
+
+unsigned char ip_payload[PDU_LENGTH];
+
+uint8_t label[6] = { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05 };
+
+static double
+_unix_time(void)
+{
+	struct timeval timev;
+
+	gettimeofday(&timev, NULL);
+	return (double)timev.tv_sec + (((double)timev.tv_usec) / 1000000);
+}
+
+/* Encapsulate and deencapsulate PDUs */
+static gse_status_t
+_send_pdus(gse_encap_t *encap, gse_deencap_t *deencap,
+           gse_vfrag_pool_t *pool, unsigned int pdu_nbr)
+{
+	gse_vfrag_t *vfrag;
+	gse_vfrag_t *pdu;
+	gse_status_t status;
+	uint8_t rcv_label[6];
+	uint8_t label_type;
+	uint16_t protocol;
+	uint16_t packet_length;
+	unsigned int i;
+
+	for (i = 0 ; i < pdu_nbr ; ++i)
+	{
+		status = gse_create_vfrag_from_pool(&vfrag, pool, PDU_LENGTH,
+		                                    GSE_MAX_HEADER_LENGTH,
+		                                    GSE_MAX_TRAILER_LENGTH);
+		if (status != GSE_STATUS_OK)
+			return status;
+		gse_copy_data(vfrag, ip_payload, PDU_LENGTH);
+		status = gse_encap_receive_pdu(vfrag, encap, label, GSE_LT_6_BYTES,
+		                               PROTOCOL_TYPE, 0);
+		if (status != GSE_STATUS_OK)
+			return status;
+
+		while ((status = gse_encap_get_packet_copy(&vfrag, encap,
+		                                           PACKET_LENGTH, 0))
+		       == GSE_STATUS_OK)
+		{
+			status = gse_deencap_packet(vfrag, deencap, &label_type,
+			                            rcv_label, &protocol, &pdu,
+			                            &packet_length);
+			if (status == GSE_STATUS_PDU_RECEIVED)
+				gse_free_vfrag(&pdu);
+			else if (status != GSE_STATUS_OK)
+				return status;
+		}
+		if (status != GSE_STATUS_FIFO_EMPTY)
+			return status;
+	}
+	return GSE_STATUS_OK;
+}
+
+/* Measure the throughput with the threads on a node and the memory on
+ * another one */
+static int
+_run(int cpu_node, int mem_node)
+{
+	gse_encap_t *encap = NULL;
+	gse_deencap_t *deencap = NULL;
+	gse_vfrag_pool_t *pool = NULL;
+	gse_status_t status;
+	double clock_start;
+	double tics;
+
+	/* The contexts and the tables allocated on first use go on the memory
+	 * node */
+	status = gse_numa_bind_thread(mem_node);
+	if (status != GSE_STATUS_OK)
+		goto fail;
+	status = gse_encap_init(QOS_NR, FIFO_SIZE, &encap);
+	if (status != GSE_STATUS_OK)
+		goto fail;
+	status = gse_deencap_init(QOS_NR, &deencap);
+	if (status != GSE_STATUS_OK)
+		goto release;
+	status = gse_vfrag_pool_init(PDU_LENGTH + GSE_MAX_HEADER_LENGTH +
+	                             GSE_MAX_TRAILER_LENGTH, &pool);
+	if (status != GSE_STATUS_OK)
+		goto release;
+	status = gse_vfrag_pool_set_node(pool, mem_node);
+	if (status != GSE_STATUS_OK)
+		goto release;
+	status = _send_pdus(encap, deencap, pool, 1);
+	if (status != GSE_STATUS_OK)
+		goto release;
+
+	status = gse_numa_bind_thread(cpu_node);
+	if (status != GSE_STATUS_OK)
+		goto release;
+	clock_start = _unix_time();
+	status = _send_pdus(encap, deencap, pool, NB_PDUS);
+	tics = _unix_time() - clock_start;
+	if (status != GSE_STATUS_OK)
+		goto release;
+
+	printf("CPU node %d, memory node %d (%s)\n", cpu_node, mem_node,
+	       (cpu_node == mem_node ? "local" : "remote"));
+	printf("  Throughput: %.1f Mbit/s\n",
+	       (double)NB_PDUS * PDU_LENGTH * 8 / tics / 1000000);
+
+	gse_vfrag_pool_release(pool);
+	gse_deencap_release(deencap);
+	gse_encap_release(encap);
+	return 0;
+
+release:
+	if (pool != NULL)
+		gse_vfrag_pool_release(pool);
+	if (deencap != NULL)
+		gse_deencap_release(deencap);
+	gse_encap_release(encap);
+fail:
+	fprintf(stderr, "Fail to run on node %d with memory on node %d: %s\n",
+	        cpu_node, mem_node, gse_get_status(status));
+	return 1;
+}
+
+int main(void)
+{
+	int cpu_node;
+	int mem_node;
+	unsigned int i;
+
+	for (i = 0 ; i < PDU_LENGTH ; ++i)
+		ip_payload[i] = i & 0xFF;
+
+	if (gse_numa_check_node(0) != GSE_STATUS_OK)
+	{
+		fprintf(stderr, "No NUMA node available\n");
+		return 1;
+	}
+
+	printf("PDUs: %d of %d bytes, packets of %d bytes\n", NB_PDUS, PDU_LENGTH,
+	       PACKET_LENGTH);
+	for (cpu_node = 0 ; cpu_node < GSE_NUMA_MAX_NODE_NBR ; ++cpu_node)
+	{
+		if (gse_numa_check_node(cpu_node) != GSE_STATUS_OK)
+			continue;
+		for (mem_node = 0 ; mem_node < GSE_NUMA_MAX_NODE_NBR ; ++mem_node)
+		{
+			if (gse_numa_check_node(mem_node) != GSE_STATUS_OK)
+				continue;
+			if (_run(cpu_node, mem_node))
+				return 1;
+		}
+	}
+
+	return 0;
+}
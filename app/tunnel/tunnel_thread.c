@@ -117,6 +117,7 @@
 #include "encap.h"
 #include "deencap.h"
 #include "refrag.h"
+#include "numa.h"
 
 /*
  * Macros & definitions:
@@ -134,6 +135,10 @@
 /* GSE parameters */
 #define QOS_NBR 5
 #define FIFO_SIZE 50
+/* The encapsulation threads stop reading the TUN interface above the high
+ * watermark and resume below the low one */
+#define FIFO_HIGH_WATERMARK 40
+#define FIFO_LOW_WATERMARK 25
 
 /* DEBUG macro */
 #define DEBUG(is_debug, out, format, ...) \
@@ -245,10 +250,11 @@ void sighandler(int sig)
 void usage(void)
 {
   printf("GSE tunnel: make a GSE over UDP tunnel\n\n\
-usage: gsetunnel [-v] [-r] [-c] NAME remote RADDR local LADDR port PORT [error MODEL PARAMS]\n\
+usage: gsetunnel [-v] [-r] [-c] [-n NODE] NAME remote RADDR local LADDR port PORT [error MODEL PARAMS]\n\
   -v      activate verbose mode\n\
   -r      enable refragmentation\n\
   -c      disable zero-copy\n\
+  -n      run the threads and place the GSE contexts on the NUMA node NODE\n\
   NAME    the name of the tunnel\n\
   RADDR   the IP address of the remote host\n\
   LADDR   the IP address of the local host\n\
@@ -320,6 +326,7 @@ int main(int argc, char *argv[])
 
   int refrag = 0;
   int copy = 0;
+  int node = GSE_NUMA_NO_NODE;
 
   int port;
 
@@ -331,7 +338,7 @@ int main(int argc, char *argv[])
    * Parse arguments:
    */
 
-  if(argc < 8 || argc > 15)
+  if(argc < 8 || argc > 17)
   {
     usage();
     goto quit;
@@ -339,7 +346,7 @@ int main(int argc, char *argv[])
   is_debug = 0;
 
   /* Read options */
-  for(ref = 3; ref > 0; ref--)
+  for(ref = 4; ref > 0; ref--)
   {
     if(!(strcmp(argv[1], "-r")))
     {
@@ -359,6 +366,12 @@ int main(int argc, char *argv[])
       argv++;
       argc--;
     }
+    else if(!strcmp(argv[1], "-n") && argc > 2)
+    {
+      node = atoi(argv[2]);
+      argv += 2;
+      argc -= 2;
+    }
   }
 
   /* get the tunnel name */
@@ -538,6 +551,20 @@ int main(int argc, char *argv[])
   /*fd* GSE part:
    */
 
+  /* The contexts are allocated on the node and the threads created
+   * afterwards inherit the placement */
+  if(node != GSE_NUMA_NO_NODE)
+  {
+    ret = gse_numa_bind_thread(node);
+    if(ret > GSE_STATUS_OK)
+    {
+      fprintf(stderr, "Fail to bind to NUMA node %d: %s\n", node,
+              gse_get_status(ret));
+      goto close_udp;
+    }
+    fprintf(stderr, "Bound to NUMA node %d\n", node);
+  }
+
   /* init the GSE library */
   ret = gse_encap_init(QOS_NBR, FIFO_SIZE, &encap);
   if(ret > GSE_STATUS_OK)
@@ -570,6 +597,17 @@ int main(int argc, char *argv[])
             gse_get_status(ret));
     goto release_deencap;
   }
+  for(i = 0 ; i < QOS_NBR ; i++)
+  {
+    ret = gse_encap_set_watermarks(encap, i, FIFO_HIGH_WATERMARK,
+                                   FIFO_LOW_WATERMARK, 0, 0);
+    if(ret > GSE_STATUS_OK)
+    {
+      fprintf(stderr, "Fail to set the encapsulation watermarks: %s",
+              gse_get_status(ret));
+      goto release_deencap;
+    }
+  }
 
   /*
    * Main program:
@@ -1045,6 +1083,7 @@ error:
 void *tun2udp_thread(void *argv)
 {
   gse_vfrag_t *vfrag_pdu = NULL;
+  gse_vfrag_pool_t *pool = NULL;
 
   int ret;
 
@@ -1070,13 +1109,25 @@ void *tun2udp_thread(void *argv)
 
   fprintf(stderr, "encapsulation thread %u launched\n", arg->qos);
 
+  /* The PDUs are freed by the thread getting the packets, their buffers
+   * are given back to the pool of this thread */
+  ret = gse_vfrag_pool_init(GSE_MAX_PDU_LENGTH + GSE_MAX_HEADER_LENGTH + 2 +
+                            GSE_MAX_TRAILER_LENGTH, &pool);
+  if(ret > GSE_STATUS_OK)
+  {
+    fprintf(stderr, "THREAD ENCAP %u: Error when creating PDU pool: %s\n",
+            arg->qos, gse_get_status(ret));
+    goto error;
+  }
+
   while(alive)
   {
     sleep(0.001);
     /* Create the PDU virtual fragment */
-    ret = gse_create_vfrag(&vfrag_pdu,
-                           GSE_MAX_PDU_LENGTH,
-                           GSE_MAX_HEADER_LENGTH + 2, GSE_MAX_TRAILER_LENGTH);
+    ret = gse_create_vfrag_from_pool(&vfrag_pdu, pool,
+                                     GSE_MAX_PDU_LENGTH,
+                                     GSE_MAX_HEADER_LENGTH + 2,
+                                     GSE_MAX_TRAILER_LENGTH);
     if(ret > GSE_STATUS_OK)
     {
       fprintf(stderr, "THREAD ENCAP %u: Error when creating PDU virtual fragment: %s\n",
@@ -1108,6 +1159,13 @@ void *tun2udp_thread(void *argv)
 
     DEBUG(is_debug, stderr, "\n");
 
+    /* leave the IP packets in the virtual interface while the FIFO is
+     * congested instead of losing them when it is full */
+    while(alive && gse_encap_is_congested(arg->encap, arg->qos))
+    {
+      usleep(1000);
+    }
+
     do
     {
       /* read the IP packet from the virtual interface */
@@ -1154,11 +1212,17 @@ void *tun2udp_thread(void *argv)
   }
 
   fprintf(stderr, "terminating encapsulation thread %u...\n", arg->qos);
+  gse_vfrag_pool_release(pool);
   pthread_exit(NULL);
 free_vfrag:
   gse_free_vfrag(&vfrag_pdu);
+  gse_vfrag_pool_release(pool);
   pthread_exit(NULL);
 error:
+  if(pool != NULL)
+  {
+    gse_vfrag_pool_release(pool);
+  }
   gettimeofday(&last, NULL);
   alive = 0;
   pthread_exit((void *) 1);
@@ -1206,6 +1270,12 @@ void *get_packet_thread(void *argv)
         ret = gse_encap_get_packet_copy(&vfrag_pkt, arg->encap,
                                         rand() % 1500 + 1, arg->qos);
       }
+      if(ret == GSE_STATUS_FIFO_EMPTY)
+      {
+        /* sleep until a PDU is received, wake up regularly to check
+         * whether the tunnel is still alive */
+        gse_encap_wait_pdu(arg->encap, arg->qos, 100000);
+      }
     }
     while(alive && ret != GSE_STATUS_PACKET_TOO_SMALL);
     local_seq = seq;
@@ -49,9 +49,14 @@ rm -rf %{buildroot}
 %{_includedir}/gse/constants.h
 %{_includedir}/gse/deencap.h
 %{_includedir}/gse/deencap_header_ext.h
+%{_includedir}/gse/deencap_mis.h
 %{_includedir}/gse/encap.h
 %{_includedir}/gse/encap_header_ext.h
+%{_includedir}/gse/encap_shm.h
+%{_includedir}/gse/header_bulk.h
 %{_includedir}/gse/header_fields.h
+%{_includedir}/gse/header_fields_inline.h
+%{_includedir}/gse/numa.h
 %{_includedir}/gse/refrag.h
 %{_includedir}/gse/status.h
 %{_includedir}/gse/virtual_fragment.h
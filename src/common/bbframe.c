@@ -0,0 +1,280 @@
+/*
+ *
+ * This piece of software is an implementation of the Generic Stream
+ * Encapsulation (GSE) standard defined by ETSI for Linux (or other
+ * Unix-compatible OS). The library may be used to add GSE
+ * encapsulation/de-encapsulation capabilities to an application.
+ *
+ *
+ * Copyright © 2016 TAS
+ *
+ *
+ * This file is part of the GSE library.
+ *
+ *
+ * The GSE library is free software : you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY, without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see http://www.gnu.org/licenses/.
+ *
+ */
+
+/****************************************************************************/
+/**
+ *   @file          bbframe.c
+ *
+ *          Project:     GSE LIBRARY
+ *
+ *          Company:     THALES ALENIA SPACE
+ *
+ *          Module name: COMMON
+ *
+ *   @brief         DVB-S2 BBHEADER build and parsing
+ *
+ *   @author        Julien BERNARD / Viveris Technologies
+ *
+ */
+/****************************************************************************/
+
+#include "bbframe.h"
+
+#include <string.h>
+#include <pthread.h>
+
+
+/****************************************************************************
+ *
+ *   MACROS AND CONSTANTS
+ *
+ ****************************************************************************/
+
+/** The length of the BBHEADER covered by the CRC-8 */
+#define GSE_BBHEADER_CRC_OFFSET 9
+
+/** The initial value of the scrambler PRBS register */
+#define GSE_BB_PRBS_INIT 0x4A80
+
+/** CRC-8 table for the x^8 + x^7 + x^6 + x^4 + x^2 + 1 polynomial */
+static const uint8_t crc8tab[] =
+{
+  0x00, 0xd5, 0x7f, 0xaa, 0xfe, 0x2b, 0x81, 0x54,
+  0x29, 0xfc, 0x56, 0x83, 0xd7, 0x02, 0xa8, 0x7d,
+  0x52, 0x87, 0x2d, 0xf8, 0xac, 0x79, 0xd3, 0x06,
+  0x7b, 0xae, 0x04, 0xd1, 0x85, 0x50, 0xfa, 0x2f,
+  0xa4, 0x71, 0xdb, 0x0e, 0x5a, 0x8f, 0x25, 0xf0,
+  0x8d, 0x58, 0xf2, 0x27, 0x73, 0xa6, 0x0c, 0xd9,
+  0xf6, 0x23, 0x89, 0x5c, 0x08, 0xdd, 0x77, 0xa2,
+  0xdf, 0x0a, 0xa0, 0x75, 0x21, 0xf4, 0x5e, 0x8b,
+  0x9d, 0x48, 0xe2, 0x37, 0x63, 0xb6, 0x1c, 0xc9,
+  0xb4, 0x61, 0xcb, 0x1e, 0x4a, 0x9f, 0x35, 0xe0,
+  0xcf, 0x1a, 0xb0, 0x65, 0x31, 0xe4, 0x4e, 0x9b,
+  0xe6, 0x33, 0x99, 0x4c, 0x18, 0xcd, 0x67, 0xb2,
+  0x39, 0xec, 0x46, 0x93, 0xc7, 0x12, 0xb8, 0x6d,
+  0x10, 0xc5, 0x6f, 0xba, 0xee, 0x3b, 0x91, 0x44,
+  0x6b, 0xbe, 0x14, 0xc1, 0x95, 0x40, 0xea, 0x3f,
+  0x42, 0x97, 0x3d, 0xe8, 0xbc, 0x69, 0xc3, 0x16,
+  0xef, 0x3a, 0x90, 0x45, 0x11, 0xc4, 0x6e, 0xbb,
+  0xc6, 0x13, 0xb9, 0x6c, 0x38, 0xed, 0x47, 0x92,
+  0xbd, 0x68, 0xc2, 0x17, 0x43, 0x96, 0x3c, 0xe9,
+  0x94, 0x41, 0xeb, 0x3e, 0x6a, 0xbf, 0x15, 0xc0,
+  0x4b, 0x9e, 0x34, 0xe1, 0xb5, 0x60, 0xca, 0x1f,
+  0x62, 0xb7, 0x1d, 0xc8, 0x9c, 0x49, 0xe3, 0x36,
+  0x19, 0xcc, 0x66, 0xb3, 0xe7, 0x32, 0x98, 0x4d,
+  0x30, 0xe5, 0x4f, 0x9a, 0xce, 0x1b, 0xb1, 0x64,
+  0x72, 0xa7, 0x0d, 0xd8, 0x8c, 0x59, 0xf3, 0x26,
+  0x5b, 0x8e, 0x24, 0xf1, 0xa5, 0x70, 0xda, 0x0f,
+  0x20, 0xf5, 0x5f, 0x8a, 0xde, 0x0b, 0xa1, 0x74,
+  0x09, 0xdc, 0x76, 0xa3, 0xf7, 0x22, 0x88, 0x5d,
+  0xd6, 0x03, 0xa9, 0x7c, 0x28, 0xfd, 0x57, 0x82,
+  0xff, 0x2a, 0x80, 0x55, 0x01, 0xd4, 0x7e, 0xab,
+  0x84, 0x51, 0xfb, 0x2e, 0x7a, 0xaf, 0x05, 0xd0,
+  0xad, 0x78, 0xd2, 0x07, 0x53, 0x86, 0x2c, 0xf9
+};
+
+/** The scrambling sequence, one PRBS bit per BBFrame bit */
+static unsigned char gse_bb_prbs[GSE_MAX_BBFRAME_LENGTH];
+
+/** Ensure the scrambling sequence is computed only once */
+static pthread_once_t gse_bb_prbs_once = PTHREAD_ONCE_INIT;
+
+
+/****************************************************************************
+ *
+ *   PRIVATE FUNCTIONS
+ *
+ ****************************************************************************/
+
+/**
+ *  @brief   Compute the scrambling sequence of the longest BBFrame
+ *
+ *  The sequence is generated by the 1 + x^14 + x^15 PRBS, bits are packed
+ *  MSB first so that the first generated bit applies to the first
+ *  transmitted bit.
+ */
+static void gse_init_bb_prbs(void)
+{
+  uint16_t reg = GSE_BB_PRBS_INIT;
+  unsigned int i;
+  unsigned int j;
+  uint8_t bit;
+  uint8_t byte;
+
+  for(i = 0 ; i < GSE_MAX_BBFRAME_LENGTH ; i++)
+  {
+    byte = 0;
+    for(j = 0 ; j < 8 ; j++)
+    {
+      bit = (reg ^ (reg >> 1)) & 0x1;
+      reg = (reg >> 1) | (bit << 14);
+      byte = (byte << 1) | bit;
+    }
+    gse_bb_prbs[i] = byte;
+  }
+}
+
+/**
+ *  @brief   XOR a BBFrame with the scrambling sequence
+ *
+ *  The bulk of the frame is processed by 64-bit words, that loop is simple
+ *  enough to be vectorized by the compiler.
+ *
+ *  @param   bbframe  The BBFrame
+ *  @param   length   The length of the BBFrame (in bytes)
+ */
+static void gse_xor_bb_prbs(unsigned char *bbframe, size_t length)
+{
+  uint64_t word;
+  uint64_t prbs;
+  size_t i;
+
+  for(i = 0 ; i + sizeof(uint64_t) <= length ; i += sizeof(uint64_t))
+  {
+    /* memcpy avoids any alignment or aliasing issue */
+    memcpy(&word, bbframe + i, sizeof(uint64_t));
+    memcpy(&prbs, gse_bb_prbs + i, sizeof(uint64_t));
+    word ^= prbs;
+    memcpy(bbframe + i, &word, sizeof(uint64_t));
+  }
+  for( ; i < length ; i++)
+  {
+    bbframe[i] ^= gse_bb_prbs[i];
+  }
+}
+
+
+/****************************************************************************
+ *
+ *   PUBLIC FUNCTIONS
+ *
+ ****************************************************************************/
+
+gse_status_t gse_build_bbheader(const gse_bbheader_t *bbheader,
+                                unsigned char *buffer)
+{
+  if(bbheader == NULL || buffer == NULL)
+  {
+    return GSE_STATUS_NULL_PTR;
+  }
+
+  /* MATYPE-1 is TS/GS (2) | SIS/MIS (1) | CCM/ACM (1) | ISSYI (1) |
+   * NPD (1) | RO (2), MATYPE-2 is ISI */
+  buffer[0] = ((bbheader->ts_gs & 0x3) << 6) |
+              ((bbheader->sis_mis & 0x1) << 5) |
+              ((bbheader->ccm_acm & 0x1) << 4) |
+              ((bbheader->issyi & 0x1) << 3) |
+              ((bbheader->npd & 0x1) << 2) |
+              (bbheader->ro & 0x3);
+  buffer[1] = bbheader->isi;
+  buffer[2] = bbheader->upl >> 8;
+  buffer[3] = bbheader->upl & 0xFF;
+  buffer[4] = bbheader->dfl >> 8;
+  buffer[5] = bbheader->dfl & 0xFF;
+  buffer[6] = bbheader->sync;
+  buffer[7] = bbheader->syncd >> 8;
+  buffer[8] = bbheader->syncd & 0xFF;
+  buffer[9] = gse_compute_crc8(buffer, GSE_BBHEADER_CRC_OFFSET);
+
+  return GSE_STATUS_OK;
+}
+
+gse_status_t gse_parse_bbheader(const unsigned char *buffer, size_t length,
+                                gse_bbheader_t *bbheader)
+{
+  if(buffer == NULL || bbheader == NULL)
+  {
+    return GSE_STATUS_NULL_PTR;
+  }
+  if(length < GSE_BBHEADER_LENGTH)
+  {
+    return GSE_STATUS_INVALID_BBFRAME_LENGTH;
+  }
+  if(gse_compute_crc8(buffer, GSE_BBHEADER_CRC_OFFSET) !=
+     buffer[GSE_BBHEADER_CRC_OFFSET])
+  {
+    return GSE_STATUS_INVALID_BBHEADER_CRC;
+  }
+
+  bbheader->ts_gs = (buffer[0] >> 6) & 0x3;
+  bbheader->sis_mis = (buffer[0] >> 5) & 0x1;
+  bbheader->ccm_acm = (buffer[0] >> 4) & 0x1;
+  bbheader->issyi = (buffer[0] >> 3) & 0x1;
+  bbheader->npd = (buffer[0] >> 2) & 0x1;
+  bbheader->ro = buffer[0] & 0x3;
+  bbheader->isi = buffer[1];
+  bbheader->upl = (buffer[2] << 8) | buffer[3];
+  bbheader->dfl = (buffer[4] << 8) | buffer[5];
+  bbheader->sync = buffer[6];
+  bbheader->syncd = (buffer[7] << 8) | buffer[8];
+
+  /* The data field is a whole number of bytes for GSE */
+  if((bbheader->dfl % 8) != 0 ||
+     (size_t)(bbheader->dfl / 8) > (length - GSE_BBHEADER_LENGTH))
+  {
+    return GSE_STATUS_INVALID_DFL;
+  }
+
+  return GSE_STATUS_OK;
+}
+
+uint8_t gse_compute_crc8(const unsigned char *data, size_t length)
+{
+  uint8_t crc = 0;
+  size_t i;
+
+  for(i = 0 ; i < length ; i++)
+  {
+    crc = crc8tab[crc ^ data[i]];
+  }
+  return crc;
+}
+
+gse_status_t gse_scramble_bbframe(unsigned char *bbframe, size_t length)
+{
+  if(bbframe == NULL)
+  {
+    return GSE_STATUS_NULL_PTR;
+  }
+  if(length > GSE_MAX_BBFRAME_LENGTH)
+  {
+    return GSE_STATUS_INVALID_BBFRAME_LENGTH;
+  }
+
+  pthread_once(&gse_bb_prbs_once, gse_init_bb_prbs);
+  gse_xor_bb_prbs(bbframe, length);
+
+  return GSE_STATUS_OK;
+}
+
+gse_status_t gse_descramble_bbframe(unsigned char *bbframe, size_t length)
+{
+  /* The scrambling is a XOR with the sequence, it is its own inverse */
+  return gse_scramble_bbframe(bbframe, length);
+}
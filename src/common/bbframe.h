@@ -0,0 +1,201 @@
+/*
+ *
+ * This piece of software is an implementation of the Generic Stream
+ * Encapsulation (GSE) standard defined by ETSI for Linux (or other
+ * Unix-compatible OS). The library may be used to add GSE
+ * encapsulation/de-encapsulation capabilities to an application.
+ *
+ *
+ * Copyright © 2016 TAS
+ *
+ *
+ * This file is part of the GSE library.
+ *
+ *
+ * The GSE library is free software : you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY, without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see http://www.gnu.org/licenses/.
+ *
+ */
+
+/****************************************************************************/
+/**
+ *   @file          bbframe.h
+ *
+ *          Project:     GSE LIBRARY
+ *
+ *          Company:     THALES ALENIA SPACE
+ *
+ *          Module name: COMMON
+ *
+ *   @brief         DVB-S2 BBHEADER build and parsing, BBFrame scrambling
+ *
+ *   @author        Julien BERNARD / Viveris Technologies
+ *
+ */
+/****************************************************************************/
+
+
+#ifndef BBFRAME_H
+#define BBFRAME_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "status.h"
+
+/**
+ * @defgroup gse_bbframe GSE BBFrame API
+ */
+
+/****************************************************************************
+ *
+ *   MACROS AND CONSTANTS
+ *
+ ****************************************************************************/
+
+/** The length of the BBHEADER (in bytes) */
+#define GSE_BBHEADER_LENGTH 10
+
+/** The maximum length of a BBFrame (in bytes), i.e. the longest Kbch/8 */
+#define GSE_MAX_BBFRAME_LENGTH 7274
+
+/** TS/GS field value for Generic Continuous Streams, used to carry GSE */
+#define GSE_BB_TS_GS_GENERIC_CONTINUOUS 0x1
+
+/****************************************************************************
+ *
+ *   STRUCTURES AND TYPES
+ *
+ ****************************************************************************/
+
+/** The fields of a BBHEADER
+ *
+ *  @ingroup gse_bbframe
+ */
+typedef struct
+{
+  uint8_t ts_gs;    /**< Input stream format (2 bits) */
+  uint8_t sis_mis;  /**< Single (1) or multiple (0) input stream (1 bit) */
+  uint8_t ccm_acm;  /**< Constant (1) or adaptive (0) coding and modulation
+                         (1 bit) */
+  uint8_t issyi;    /**< Input stream synchronization indicator (1 bit) */
+  uint8_t npd;      /**< Null packet deletion indicator (1 bit) */
+  uint8_t ro;       /**< Roll-off factor (2 bits) */
+  uint8_t isi;      /**< Input stream identifier (MATYPE-2), only meaningful
+                         with multiple input streams */
+  uint16_t upl;     /**< User packet length (in bits), 0 for GSE */
+  uint16_t dfl;     /**< Data field length (in bits) */
+  uint8_t sync;     /**< User packet sync-byte, 0 for GSE */
+  uint16_t syncd;   /**< Distance to the first user packet (in bits),
+                         0 for GSE */
+} gse_bbheader_t;
+
+/****************************************************************************
+ *
+ *   FUNCTIONS
+ *
+ ****************************************************************************/
+
+/**
+ *  @brief   Write a BBHEADER and its CRC-8
+ *
+ *  @param   bbheader  The BBHEADER fields
+ *  @param   buffer    The buffer receiving the BBHEADER, at least
+ *                     GSE_BBHEADER_LENGTH bytes long
+ *
+ *  @return
+ *                     - success/informative code among:
+ *                       - \ref GSE_STATUS_OK
+ *                     - warning/error code among:
+ *                       - \ref GSE_STATUS_NULL_PTR
+ *
+ *  @ingroup gse_bbframe
+ */
+gse_status_t gse_build_bbheader(const gse_bbheader_t *bbheader,
+                                unsigned char *buffer);
+
+/**
+ *  @brief   Read a BBHEADER and check its CRC-8
+ *
+ *  @param   buffer    The beginning of the BBFrame
+ *  @param   length    The length of the BBFrame (in bytes)
+ *  @param   bbheader  OUT: The BBHEADER fields
+ *
+ *  @return
+ *                     - success/informative code among:
+ *                       - \ref GSE_STATUS_OK
+ *                     - warning/error code among:
+ *                       - \ref GSE_STATUS_NULL_PTR
+ *                       - \ref GSE_STATUS_INVALID_BBFRAME_LENGTH
+ *                       - \ref GSE_STATUS_INVALID_BBHEADER_CRC
+ *                       - \ref GSE_STATUS_INVALID_DFL
+ *
+ *  @ingroup gse_bbframe
+ */
+gse_status_t gse_parse_bbheader(const unsigned char *buffer, size_t length,
+                                gse_bbheader_t *bbheader);
+
+/**
+ *  @brief   Compute the CRC-8 of a BBHEADER
+ *
+ *  The generator polynomial is x^8 + x^7 + x^6 + x^4 + x^2 + 1, the
+ *  register is initialized with 0.
+ *
+ *  @param   data    The data
+ *  @param   length  The length of the data
+ *
+ *  @return          The CRC-8
+ *
+ *  @ingroup gse_bbframe
+ */
+uint8_t gse_compute_crc8(const unsigned char *data, size_t length);
+
+/**
+ *  @brief   Scramble a complete BBFrame in place
+ *
+ *  The whole BBFrame, BBHEADER and padding included, is XORed with the
+ *  DVB-S2 baseband scrambling sequence (1 + x^14 + x^15 PRBS initialized
+ *  with 100101010000000). The sequence is computed once and shared.
+ *
+ *  @param   bbframe  The BBFrame
+ *  @param   length   The length of the BBFrame (in bytes)
+ *
+ *  @return
+ *                     - success/informative code among:
+ *                       - \ref GSE_STATUS_OK
+ *                     - warning/error code among:
+ *                       - \ref GSE_STATUS_NULL_PTR
+ *                       - \ref GSE_STATUS_INVALID_BBFRAME_LENGTH
+ *
+ *  @ingroup gse_bbframe
+ */
+gse_status_t gse_scramble_bbframe(unsigned char *bbframe, size_t length);
+
+/**
+ *  @brief   Descramble a complete BBFrame in place
+ *
+ *  @param   bbframe  The BBFrame
+ *  @param   length   The length of the BBFrame (in bytes)
+ *
+ *  @return
+ *                     - success/informative code among:
+ *                       - \ref GSE_STATUS_OK
+ *                     - warning/error code among:
+ *                       - \ref GSE_STATUS_NULL_PTR
+ *                       - \ref GSE_STATUS_INVALID_BBFRAME_LENGTH
+ *
+ *  @ingroup gse_bbframe
+ */
+gse_status_t gse_descramble_bbframe(unsigned char *bbframe, size_t length);
+
+#endif
@@ -0,0 +1,55 @@
+/*
+ *
+ * This piece of software is an implementation of the Generic Stream
+ * Encapsulation (GSE) standard defined by ETSI for Linux (or other
+ * Unix-compatible OS). The library may be used to add GSE
+ * encapsulation/de-encapsulation capabilities to an application.
+ *
+ *
+ * Copyright © 2016 TAS
+ *
+ *
+ * This file is part of the GSE library.
+ *
+ *
+ * The GSE library is free software : you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY, without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see http://www.gnu.org/licenses/.
+ *
+ */
+
+/****************************************************************************/
+/**
+ *   @file          cache.h
+ *
+ *          Project:     GSE LIBRARY
+ *
+ *          Company:     THALES ALENIA SPACE
+ *
+ *          Module name: COMMON
+ *
+ *   @brief         Cache line constants shared by the GSE library
+ *
+ *   @author        Julien BERNARD / Viveris Technologies
+ *
+ */
+/****************************************************************************/
+
+
+#ifndef GSE_CACHE_H
+#define GSE_CACHE_H
+
+/** The size of a cache line (in bytes), the tables shared by several threads
+ *  are aligned on it */
+#define GSE_CACHE_LINE_SIZE 64
+
+#endif
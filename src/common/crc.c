@@ -63,6 +63,51 @@
 #include "crc.h"
 
 #include <stdint.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+/** The CRC-32 polynomial (without the x^32 term) */
+#define CRC_POLY 0x04c11db7
+
+/** A chunk of data handled by a CRC32 worker */
+typedef struct
+{
+  unsigned char *data;  /**< The data of the chunk */
+  size_t length;        /**< The length of the chunk */
+  uint32_t crc;         /**< The CRC32 of the chunk, computed with 0 as
+                             initial value except for the first chunk */
+} crc_chunk_t;
+
+/** A thread of a CRC32 pool */
+typedef struct
+{
+  gse_crc_pool_t *pool;  /**< The pool of the thread */
+  unsigned int index;    /**< The chunk computed by the thread */
+} crc_worker_t;
+
+/** Pool of threads computing the chunks of a CRC32 */
+struct gse_crc_pool_s
+{
+  pthread_mutex_t mutex;      /**< Mutex on the jobs */
+  pthread_cond_t start_cond;  /**< Signaled when a job is given */
+  pthread_cond_t done_cond;   /**< Signaled when the chunks of a job are
+                                   computed */
+  pthread_mutex_t call_mutex; /**< Held by the thread that gives a job */
+  pthread_t threads[GSE_CRC_MAX_WORKER_NBR];  /**< The threads, the first
+                                                   one is unused */
+  crc_worker_t workers[GSE_CRC_MAX_WORKER_NBR];  /**< The thread arguments */
+  crc_chunk_t chunks[GSE_CRC_MAX_WORKER_NBR];    /**< The chunks of the job,
+                                                      the first one is
+                                                      computed by the calling
+                                                      thread */
+  unsigned int worker_nbr;    /**< Number of workers including the calling
+                                   thread */
+  unsigned int job_nbr;       /**< Number of jobs given to the threads */
+  unsigned int chunk_nbr;     /**< Number of chunks of the current job */
+  unsigned int pending_nbr;   /**< Number of chunks of the current job not
+                                   computed yet by the threads */
+  int stop;                   /**< Whether the threads shall stop */
+};
 
 /** CRC-32 table */
 static const uint32_t crctab[] =
@@ -142,3 +187,397 @@ uint32_t compute_crc(unsigned char *data, size_t length, uint32_t crc_init)
   }
   return crc_init;
 }
+
+/**
+ *  @brief   Multiply two polynomials modulo the CRC-32 polynomial
+ *
+ *  @param   a  The first polynomial
+ *  @param   b  The second polynomial
+ *
+ *  @return     a * b mod P
+ */
+static uint32_t multiply_crc_poly(uint32_t a, uint32_t b)
+{
+  uint32_t product = 0;
+  int i;
+
+  for(i = 31 ; i >= 0 ; i--)
+  {
+    product = (product << 1) ^ ((product & 0x80000000) ? CRC_POLY : 0);
+    if(a & ((uint32_t)1 << i))
+    {
+      product ^= b;
+    }
+  }
+  return product;
+}
+
+/**
+ *  @brief   Shift a CRC32 as if length null bytes were added to the data
+ *
+ *  The CRC32 register is multiplied by x^(8 * length) modulo the CRC-32
+ *  polynomial, the power is computed by squaring so the cost only depends
+ *  on log2(length).
+ *
+ *  @param   crc     The CRC32
+ *  @param   length  The number of null bytes
+ *
+ *  @return          The shifted CRC32
+ */
+uint32_t shift_crc(uint32_t crc, size_t length)
+{
+  /* x^8 */
+  uint32_t square = 0x100;
+  /* x^0 */
+  uint32_t power = 1;
+
+  while(length > 0)
+  {
+    if(length & 1)
+    {
+      power = multiply_crc_poly(power, square);
+    }
+    square = multiply_crc_poly(square, square);
+    length >>= 1;
+  }
+  return multiply_crc_poly(crc, power);
+}
+
+/**
+ *  @brief   Combine the CRC32 of two consecutive blocks of data
+ *
+ *  The CRC32 of the second block shall be computed with 0 as initial value,
+ *  the CRC32 of the first block may be computed with any initial value.
+ *  The blocks can thus be computed independently and in any order.
+ *
+ *  @param   crc1     The CRC32 of the first block
+ *  @param   crc2     The CRC32 of the second block (initial value 0)
+ *  @param   length2  Length of the second block
+ *
+ *  @return           The CRC32 of the concatenation of the blocks
+ */
+uint32_t combine_crc(uint32_t crc1, uint32_t crc2, size_t length2)
+{
+  return shift_crc(crc1, length2) ^ crc2;
+}
+
+/**
+ *  @brief   Compute the CRC32 of a chunk
+ *
+ *  @param   chunk  The chunk
+ */
+static void compute_crc_chunk(crc_chunk_t *chunk)
+{
+  chunk->crc = compute_crc(chunk->data, chunk->length, chunk->crc);
+}
+
+/**
+ *  @brief   Compute the chunks given to a thread of a CRC32 pool until the
+ *           pool is released
+ *
+ *  @param   arg  The worker
+ *
+ *  @return       NULL
+ */
+static void *run_crc_worker(void *arg)
+{
+  crc_worker_t *worker = arg;
+  gse_crc_pool_t *pool = worker->pool;
+  unsigned int job_nbr = 0;
+
+  if(pthread_mutex_lock(&pool->mutex) != 0)
+  {
+    return NULL;
+  }
+  while(1)
+  {
+    while(!pool->stop && pool->job_nbr == job_nbr)
+    {
+      pthread_cond_wait(&pool->start_cond, &pool->mutex);
+    }
+    if(pool->stop)
+    {
+      break;
+    }
+    job_nbr = pool->job_nbr;
+    if(worker->index >= pool->chunk_nbr)
+    {
+      continue;
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    compute_crc_chunk(&pool->chunks[worker->index]);
+    pthread_mutex_lock(&pool->mutex);
+    pool->pending_nbr--;
+    if(pool->pending_nbr == 0)
+    {
+      pthread_cond_signal(&pool->done_cond);
+    }
+  }
+  pthread_mutex_unlock(&pool->mutex);
+  return NULL;
+}
+
+/**
+ *  @brief   Create a pool of threads computing the chunks of a CRC32
+ *
+ *  The threads wait for the chunks given by \ref compute_crc_parallel until
+ *  the pool is released. If a thread cannot be created, the pool works with
+ *  the threads already created.
+ *
+ *  @param   worker_nbr  The number of threads, including the calling one
+ *                       (at most GSE_CRC_MAX_WORKER_NBR)
+ *  @param   pool        OUT: The pool
+ *
+ *  @return
+ *                       - success/informative code among:
+ *                         - \ref GSE_STATUS_OK
+ *                       - warning/error code among:
+ *                         - \ref GSE_STATUS_NULL_PTR
+ *                         - \ref GSE_STATUS_MALLOC_FAILED
+ *                         - \ref GSE_STATUS_PTHREAD_MUTEX
+ */
+gse_status_t gse_crc_pool_init(unsigned int worker_nbr, gse_crc_pool_t **pool)
+{
+  gse_status_t status = GSE_STATUS_OK;
+
+  unsigned int i;
+
+  if(pool == NULL)
+  {
+    status = GSE_STATUS_NULL_PTR;
+    goto error;
+  }
+  if(worker_nbr > GSE_CRC_MAX_WORKER_NBR)
+  {
+    worker_nbr = GSE_CRC_MAX_WORKER_NBR;
+  }
+
+  *pool = calloc(1, sizeof(gse_crc_pool_t));
+  if(*pool == NULL)
+  {
+    status = GSE_STATUS_MALLOC_FAILED;
+    goto error;
+  }
+  if(pthread_mutex_init(&(*pool)->mutex, NULL) != 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+    goto free_pool;
+  }
+  if(pthread_mutex_init(&(*pool)->call_mutex, NULL) != 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+    goto destroy_mutex;
+  }
+  if(pthread_cond_init(&(*pool)->start_cond, NULL) != 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+    goto destroy_call_mutex;
+  }
+  if(pthread_cond_init(&(*pool)->done_cond, NULL) != 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+    goto destroy_start_cond;
+  }
+
+  (*pool)->worker_nbr = 1;
+  for(i = 1 ; i < worker_nbr ; i++)
+  {
+    (*pool)->workers[i].pool = *pool;
+    (*pool)->workers[i].index = i;
+    if(pthread_create(&(*pool)->threads[i], NULL, run_crc_worker,
+                      &(*pool)->workers[i]) != 0)
+    {
+      break;
+    }
+    (*pool)->worker_nbr++;
+  }
+
+  return status;
+
+destroy_start_cond:
+  pthread_cond_destroy(&(*pool)->start_cond);
+destroy_call_mutex:
+  pthread_mutex_destroy(&(*pool)->call_mutex);
+destroy_mutex:
+  pthread_mutex_destroy(&(*pool)->mutex);
+free_pool:
+  free(*pool);
+  *pool = NULL;
+error:
+  return status;
+}
+
+/**
+ *  @brief   Stop the threads of a CRC32 pool and release it
+ *
+ *  The pool shall not be used by another thread.
+ *
+ *  @param   pool  The pool, may be NULL
+ */
+void gse_crc_pool_release(gse_crc_pool_t *pool)
+{
+  unsigned int i;
+
+  if(pool == NULL)
+  {
+    return;
+  }
+  pthread_mutex_lock(&pool->mutex);
+  pool->stop = 1;
+  pthread_cond_broadcast(&pool->start_cond);
+  pthread_mutex_unlock(&pool->mutex);
+  for(i = 1 ; i < pool->worker_nbr ; i++)
+  {
+    pthread_join(pool->threads[i], NULL);
+  }
+  pthread_cond_destroy(&pool->done_cond);
+  pthread_cond_destroy(&pool->start_cond);
+  pthread_mutex_destroy(&pool->call_mutex);
+  pthread_mutex_destroy(&pool->mutex);
+  free(pool);
+}
+
+/**
+ *  @brief   Get the number of workers of a CRC32 pool
+ *
+ *  @param   pool  The pool
+ *
+ *  @return        The number of threads including the calling one, lower
+ *                 than requested if some threads could not be created
+ */
+unsigned int gse_crc_pool_get_worker_nbr(const gse_crc_pool_t *pool)
+{
+  return (pool != NULL ? pool->worker_nbr : 1);
+}
+
+/**
+ *  @brief   Compute CRC32 with the threads of a pool
+ *
+ *  The data is split in one chunk per worker, the first one is computed by
+ *  the calling thread, the others by the threads of the pool. The CRC32 of
+ *  the chunks are then combined. The CRC32 is computed by the calling thread
+ *  alone if the pool is NULL or already used by another thread.
+ *
+ *  @param   pool      The pool, may be NULL
+ *  @param   data      The data
+ *  @param   length    Length of the data
+ *  @param   crc_init  Initial CRC value
+ *
+ *  @return            The CRC32
+ */
+uint32_t compute_crc_parallel(gse_crc_pool_t *pool, unsigned char *data,
+                              size_t length, uint32_t crc_init)
+{
+  size_t chunk_length;
+  unsigned int chunk_nbr;
+  uint32_t crc;
+  unsigned int i;
+
+  if(pool == NULL || pool->worker_nbr <= 1 || length < pool->worker_nbr)
+  {
+    return compute_crc(data, length, crc_init);
+  }
+  if(pthread_mutex_trylock(&pool->call_mutex) != 0)
+  {
+    return compute_crc(data, length, crc_init);
+  }
+
+  chunk_nbr = pool->worker_nbr;
+  chunk_length = length / chunk_nbr;
+  for(i = 0 ; i < chunk_nbr ; i++)
+  {
+    pool->chunks[i].data = data + i * chunk_length;
+    pool->chunks[i].length = chunk_length;
+    pool->chunks[i].crc = 0;
+  }
+  pool->chunks[0].crc = crc_init;
+  pool->chunks[chunk_nbr - 1].length = length - (chunk_nbr - 1) * chunk_length;
+
+  /* Wake the threads up, the calling thread computes the first chunk */
+  if(pthread_mutex_lock(&pool->mutex) != 0)
+  {
+    pthread_mutex_unlock(&pool->call_mutex);
+    return compute_crc(data, length, crc_init);
+  }
+  pool->chunk_nbr = chunk_nbr;
+  pool->pending_nbr = chunk_nbr - 1;
+  pool->job_nbr++;
+  pthread_cond_broadcast(&pool->start_cond);
+  pthread_mutex_unlock(&pool->mutex);
+
+  compute_crc_chunk(&pool->chunks[0]);
+
+  pthread_mutex_lock(&pool->mutex);
+  while(pool->pending_nbr > 0)
+  {
+    pthread_cond_wait(&pool->done_cond, &pool->mutex);
+  }
+  pthread_mutex_unlock(&pool->mutex);
+
+  crc = pool->chunks[0].crc;
+  for(i = 1 ; i < chunk_nbr ; i++)
+  {
+    crc = combine_crc(crc, pool->chunks[i].crc, pool->chunks[i].length);
+  }
+  pthread_mutex_unlock(&pool->call_mutex);
+  return crc;
+}
+
+/**
+ *  @brief   Compute the CRC32 of several buffers at once
+ *
+ *  The buffers are handled by groups of GSE_CRC_LANE_NBR, the bytes of the
+ *  buffers of a group are interleaved so that the table lookups of a buffer
+ *  do not wait for the previous lookup of the same buffer.
+ *
+ *  @param   data    The buffers
+ *  @param   length  The lengths of the buffers
+ *  @param   crc     IN: the initial CRC values, OUT: the CRC32 of the
+ *                   buffers
+ *  @param   nbr     The number of buffers
+ */
+void compute_crc_multi(unsigned char **data, size_t *length, uint32_t *crc,
+                       unsigned int nbr)
+{
+  unsigned int first;
+  unsigned int lane;
+
+  for(first = 0 ; first < nbr ; first += GSE_CRC_LANE_NBR)
+  {
+    unsigned char *p[GSE_CRC_LANE_NBR];
+    uint32_t c[GSE_CRC_LANE_NBR];
+    size_t common = SIZE_MAX;
+    size_t i;
+
+    if(nbr - first < GSE_CRC_LANE_NBR)
+    {
+      for(lane = first ; lane < nbr ; lane++)
+      {
+        crc[lane] = compute_crc(data[lane], length[lane], crc[lane]);
+      }
+      break;
+    }
+
+    for(lane = 0 ; lane < GSE_CRC_LANE_NBR ; lane++)
+    {
+      p[lane] = data[first + lane];
+      c[lane] = crc[first + lane];
+      if(length[first + lane] < common)
+      {
+        common = length[first + lane];
+      }
+    }
+    for(i = 0 ; i < common ; i++)
+    {
+      COMPUTE(c[0], p[0][i]);
+      COMPUTE(c[1], p[1][i]);
+      COMPUTE(c[2], p[2][i]);
+      COMPUTE(c[3], p[3][i]);
+    }
+    for(lane = 0 ; lane < GSE_CRC_LANE_NBR ; lane++)
+    {
+      crc[first + lane] = compute_crc(p[lane] + common,
+                                      length[first + lane] - common, c[lane]);
+    }
+  }
+}
@@ -54,9 +54,37 @@
 #include <stdint.h>
 #include <string.h>
 
+#include "status.h"
+
 /**< Initial value for CRC32 computation */
 #define GSE_CRC_INIT 0xFFFFFFFF
 
+/**< Number of buffers whose CRC32 are computed together */
+#define GSE_CRC_LANE_NBR 4
+
+/**< Maximum number of threads computing a CRC32 in parallel */
+#define GSE_CRC_MAX_WORKER_NBR 16
+
+struct gse_crc_pool_s;
+/** Pool of threads computing the chunks of a CRC32 */
+typedef struct gse_crc_pool_s gse_crc_pool_t;
+
 uint32_t compute_crc(unsigned char *data, size_t length, uint32_t crc_init);
 
+uint32_t shift_crc(uint32_t crc, size_t length);
+
+uint32_t combine_crc(uint32_t crc1, uint32_t crc2, size_t length2);
+
+gse_status_t gse_crc_pool_init(unsigned int worker_nbr, gse_crc_pool_t **pool);
+
+void gse_crc_pool_release(gse_crc_pool_t *pool);
+
+unsigned int gse_crc_pool_get_worker_nbr(const gse_crc_pool_t *pool);
+
+uint32_t compute_crc_parallel(gse_crc_pool_t *pool, unsigned char *data,
+                              size_t length, uint32_t crc_init);
+
+void compute_crc_multi(unsigned char **data, size_t *length, uint32_t *crc,
+                       unsigned int nbr);
+
 #endif
@@ -0,0 +1,612 @@
+/*
+ *
+ * This piece of software is an implementation of the Generic Stream
+ * Encapsulation (GSE) standard defined by ETSI for Linux (or other
+ * Unix-compatible OS). The library may be used to add GSE
+ * encapsulation/de-encapsulation capabilities to an application.
+ *
+ *
+ * Copyright © 2016 TAS
+ *
+ *
+ * This file is part of the GSE library.
+ *
+ *
+ * The GSE library is free software : you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY, without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see http://www.gnu.org/licenses/.
+ *
+ */
+
+/****************************************************************************/
+/**
+ *   @file          header_bulk.c
+ *
+ *          Project:     GSE LIBRARY
+ *
+ *          Company:     THALES ALENIA SPACE
+ *
+ *          Module name: COMMON
+ *
+ *   @brief         Decoding of all the GSE headers of a frame and counters
+ *                  per label and per protocol
+ *
+ *   @author        Julien BERNARD / Viveris Technologies
+ *
+ */
+/****************************************************************************/
+
+#include "header_bulk.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "constants.h"
+#include "header.h"
+#include "header_fields_inline.h"
+
+
+/****************************************************************************
+ *
+ *   MACROS AND CONSTANTS
+ *
+ ****************************************************************************/
+
+/** The alignment of the arrays of the headers */
+#define GSE_HEADER_BULK_ALIGN 64
+
+/** Round a length up to the alignment of the arrays */
+#define GSE_HEADER_BULK_ROUND(x) \
+  (((x) + GSE_HEADER_BULK_ALIGN - 1) & ~((size_t)GSE_HEADER_BULK_ALIGN - 1))
+
+/** The number of Frag ID values */
+#define GSE_HEADER_STATS_FRAG_ID_NBR 256
+
+/** No label or protocol */
+#define GSE_HEADER_STATS_NONE (-1)
+
+
+/****************************************************************************
+ *
+ *   STRUCTURES AND TYPES
+ *
+ ****************************************************************************/
+
+/** Counters per label and per protocol */
+struct gse_header_stats_s
+{
+  gse_label_counters_t *labels;       /**< The counters of the labels */
+  size_t label_nbr;                   /**< The number of labels */
+  size_t max_label_nbr;               /**< The maximum number of labels */
+  uint32_t *label_table;              /**< The index + 1 of the labels by
+                                           hash, 0 for a free entry */
+  size_t label_mask;                  /**< The mask of the hash of the
+                                           labels */
+  gse_protocol_counters_t *protocols; /**< The counters of the protocols */
+  size_t protocol_nbr;                /**< The number of protocols */
+  size_t max_protocol_nbr;            /**< The maximum number of protocols */
+  uint32_t *protocol_table;           /**< The index + 1 of the protocols by
+                                           hash, 0 for a free entry */
+  size_t protocol_mask;               /**< The mask of the hash of the
+                                           protocols */
+  int last_label;                     /**< The label of the previous complete
+                                           PDU or first fragment */
+  /** The label of the fragmented PDUs by Frag ID */
+  int frag_label[GSE_HEADER_STATS_FRAG_ID_NBR];
+  /** The protocol of the fragmented PDUs by Frag ID */
+  int frag_protocol[GSE_HEADER_STATS_FRAG_ID_NBR];
+  gse_header_counters_t label_unknown;    /**< The packets without label */
+  gse_header_counters_t protocol_unknown; /**< The packets without
+                                               protocol */
+};
+
+
+/****************************************************************************
+ *
+ *   PROTOTYPES OF PRIVATE FUNCTIONS
+ *
+ ****************************************************************************/
+
+/**
+ *  @brief   Get the size of a hash table able to hold entries at half load
+ *
+ *  @param   entry_nbr  The number of entries
+ *
+ *  @return             The size of the table, a power of 2
+ */
+static size_t gse_header_stats_table_size(size_t entry_nbr);
+
+/**
+ *  @brief   Find a label or add it
+ *
+ *  @param   stats       The counters
+ *  @param   label_type  The Label Type
+ *  @param   label       The label, padded with 0
+ *
+ *  @return              The index of the label,
+ *                       \ref GSE_HEADER_STATS_NONE if there is no room left
+ */
+static int gse_header_stats_get_label(gse_header_stats_t *stats,
+                                      uint8_t label_type,
+                                      const uint8_t *label);
+
+/**
+ *  @brief   Find a protocol or add it
+ *
+ *  @param   stats          The counters
+ *  @param   protocol_type  The Protocol Type
+ *
+ *  @return                 The index of the protocol,
+ *                          \ref GSE_HEADER_STATS_NONE if there is no room left
+ */
+static int gse_header_stats_get_protocol(gse_header_stats_t *stats,
+                                         uint16_t protocol_type);
+
+/**
+ *  @brief   Count a packet
+ *
+ *  @param   counters         The counters
+ *  @param   packet_length    The length of the packet
+ *  @param   start_indicator  The Start Indicator of the packet
+ *  @param   end_indicator    The End Indicator of the packet
+ */
+static void gse_header_stats_count(gse_header_counters_t *counters,
+                                   uint16_t packet_length,
+                                   uint8_t start_indicator,
+                                   uint8_t end_indicator);
+
+
+/****************************************************************************
+ *
+ *   PUBLIC FUNCTIONS
+ *
+ ****************************************************************************/
+
+gse_status_t gse_header_bulk_init(size_t max_packet_nbr,
+                                  gse_header_bulk_t **bulk)
+{
+  gse_status_t status = GSE_STATUS_OK;
+  unsigned char *data;
+  size_t size_16;
+  size_t size_8;
+
+  if(bulk == NULL)
+  {
+    status = GSE_STATUS_NULL_PTR;
+    goto error;
+  }
+  *bulk = NULL;
+  if(max_packet_nbr == 0)
+  {
+    status = GSE_STATUS_BUFF_LENGTH_NULL;
+    goto error;
+  }
+
+  *bulk = calloc(1, sizeof(gse_header_bulk_t));
+  if(*bulk == NULL)
+  {
+    status = GSE_STATUS_MALLOC_FAILED;
+    goto error;
+  }
+
+  /* All the arrays share one allocation, each one starts on a cache line */
+  size_16 = GSE_HEADER_BULK_ROUND(max_packet_nbr * sizeof(uint16_t));
+  size_8 = GSE_HEADER_BULK_ROUND(max_packet_nbr * sizeof(uint8_t));
+  if(posix_memalign(&(*bulk)->data, GSE_HEADER_BULK_ALIGN,
+                    GSE_HEADER_BULK_ROUND(max_packet_nbr * sizeof(uint32_t)) +
+                    3 * size_16 + 5 * size_8 +
+                    GSE_HEADER_BULK_ROUND(max_packet_nbr * 6)) != 0)
+  {
+    status = GSE_STATUS_MALLOC_FAILED;
+    goto free_bulk;
+  }
+  data = (*bulk)->data;
+  (*bulk)->offset = (uint32_t *)data;
+  data += GSE_HEADER_BULK_ROUND(max_packet_nbr * sizeof(uint32_t));
+  (*bulk)->packet_length = (uint16_t *)data;
+  data += size_16;
+  (*bulk)->total_length = (uint16_t *)data;
+  data += size_16;
+  (*bulk)->protocol_type = (uint16_t *)data;
+  data += size_16;
+  (*bulk)->header_length = data;
+  data += size_8;
+  (*bulk)->start_indicator = data;
+  data += size_8;
+  (*bulk)->end_indicator = data;
+  data += size_8;
+  (*bulk)->label_type = data;
+  data += size_8;
+  (*bulk)->frag_id = data;
+  data += size_8;
+  (*bulk)->label = data;
+  (*bulk)->max_packet_nbr = max_packet_nbr;
+  (*bulk)->packet_nbr = 0;
+
+  return status;
+
+free_bulk:
+  free(*bulk);
+  *bulk = NULL;
+error:
+  return status;
+}
+
+gse_status_t gse_header_bulk_release(gse_header_bulk_t *bulk)
+{
+  if(bulk == NULL)
+  {
+    return GSE_STATUS_NULL_PTR;
+  }
+  free(bulk->data);
+  free(bulk);
+  return GSE_STATUS_OK;
+}
+
+gse_status_t gse_header_bulk_decode(gse_header_bulk_t *bulk,
+                                    const unsigned char *data, size_t length,
+                                    size_t *decoded_length)
+{
+  gse_status_t status = GSE_STATUS_OK;
+  gse_header_fields_t fields;
+  const unsigned char *packet;
+  size_t offset = 0;
+  size_t packet_length;
+  size_t i;
+
+  if(bulk == NULL || data == NULL || decoded_length == NULL)
+  {
+    status = GSE_STATUS_NULL_PTR;
+    goto error;
+  }
+
+  i = 0;
+  while(offset < length && i < bulk->max_packet_nbr)
+  {
+    packet = data + offset;
+
+    /* The rest of the data is padding */
+    if((packet[0] & 0xF0) == 0x00)
+    {
+      break;
+    }
+    if(length - offset < GSE_MIN_PACKET_LENGTH)
+    {
+      status = GSE_STATUS_PACKET_TOO_SMALL;
+      break;
+    }
+    packet_length = gse_hdr_gse_length(packet) + GSE_MANDATORY_FIELDS_LENGTH;
+    if(packet_length > length - offset ||
+       gse_hdr_length(packet) > packet_length)
+    {
+      status = GSE_STATUS_INVALID_GSE_LENGTH;
+      break;
+    }
+
+    gse_hdr_decode(packet, &fields);
+    bulk->offset[i] = offset;
+    bulk->packet_length[i] = packet_length;
+    bulk->header_length[i] = fields.header_length;
+    bulk->start_indicator[i] = fields.start_indicator;
+    bulk->end_indicator[i] = fields.end_indicator;
+    bulk->label_type[i] = fields.label_type;
+    bulk->frag_id[i] = fields.frag_id;
+    bulk->total_length[i] = fields.total_length;
+    bulk->protocol_type[i] = fields.protocol_type;
+    memcpy(bulk->label + i * 6, fields.label, 6);
+
+    offset += packet_length;
+    i++;
+  }
+  bulk->packet_nbr = i;
+  *decoded_length = offset;
+
+error:
+  return status;
+}
+
+gse_status_t gse_header_stats_init(size_t max_label_nbr,
+                                   size_t max_protocol_nbr,
+                                   gse_header_stats_t **stats)
+{
+  gse_status_t status = GSE_STATUS_OK;
+  size_t label_size;
+  size_t protocol_size;
+
+  if(stats == NULL)
+  {
+    status = GSE_STATUS_NULL_PTR;
+    goto error;
+  }
+  *stats = NULL;
+  if(max_label_nbr == 0 || max_protocol_nbr == 0)
+  {
+    status = GSE_STATUS_BUFF_LENGTH_NULL;
+    goto error;
+  }
+
+  *stats = calloc(1, sizeof(gse_header_stats_t));
+  if(*stats == NULL)
+  {
+    status = GSE_STATUS_MALLOC_FAILED;
+    goto error;
+  }
+  label_size = gse_header_stats_table_size(max_label_nbr);
+  protocol_size = gse_header_stats_table_size(max_protocol_nbr);
+  (*stats)->labels = calloc(max_label_nbr, sizeof(gse_label_counters_t));
+  (*stats)->label_table = calloc(label_size, sizeof(uint32_t));
+  (*stats)->protocols = calloc(max_protocol_nbr,
+                               sizeof(gse_protocol_counters_t));
+  (*stats)->protocol_table = calloc(protocol_size, sizeof(uint32_t));
+  if((*stats)->labels == NULL || (*stats)->label_table == NULL ||
+     (*stats)->protocols == NULL || (*stats)->protocol_table == NULL)
+  {
+    status = GSE_STATUS_MALLOC_FAILED;
+    goto free_stats;
+  }
+  (*stats)->max_label_nbr = max_label_nbr;
+  (*stats)->label_mask = label_size - 1;
+  (*stats)->max_protocol_nbr = max_protocol_nbr;
+  (*stats)->protocol_mask = protocol_size - 1;
+  gse_header_stats_reset(*stats);
+
+  return status;
+
+free_stats:
+  gse_header_stats_release(*stats);
+  *stats = NULL;
+error:
+  return status;
+}
+
+gse_status_t gse_header_stats_release(gse_header_stats_t *stats)
+{
+  if(stats == NULL)
+  {
+    return GSE_STATUS_NULL_PTR;
+  }
+  free(stats->labels);
+  free(stats->label_table);
+  free(stats->protocols);
+  free(stats->protocol_table);
+  free(stats);
+  return GSE_STATUS_OK;
+}
+
+gse_status_t gse_header_stats_reset(gse_header_stats_t *stats)
+{
+  unsigned int i;
+
+  if(stats == NULL)
+  {
+    return GSE_STATUS_NULL_PTR;
+  }
+  stats->label_nbr = 0;
+  memset(stats->label_table, 0,
+         (stats->label_mask + 1) * sizeof(uint32_t));
+  stats->protocol_nbr = 0;
+  memset(stats->protocol_table, 0,
+         (stats->protocol_mask + 1) * sizeof(uint32_t));
+  stats->last_label = GSE_HEADER_STATS_NONE;
+  for(i = 0 ; i < GSE_HEADER_STATS_FRAG_ID_NBR ; i++)
+  {
+    stats->frag_label[i] = GSE_HEADER_STATS_NONE;
+    stats->frag_protocol[i] = GSE_HEADER_STATS_NONE;
+  }
+  memset(&stats->label_unknown, 0, sizeof(gse_header_counters_t));
+  memset(&stats->protocol_unknown, 0, sizeof(gse_header_counters_t));
+  return GSE_STATUS_OK;
+}
+
+gse_status_t gse_header_stats_update(gse_header_stats_t *stats,
+                                     const gse_header_bulk_t *bulk)
+{
+  int label_index;
+  int protocol_index;
+  uint8_t frag_id;
+  size_t i;
+
+  if(stats == NULL || bulk == NULL)
+  {
+    return GSE_STATUS_NULL_PTR;
+  }
+
+  for(i = 0 ; i < bulk->packet_nbr ; i++)
+  {
+    frag_id = bulk->frag_id[i];
+    if(bulk->start_indicator[i])
+    {
+      /* A re-used label is the previous label, a frame does not start with
+       * a re-used label so the previous label may come from an earlier
+       * part of the frame */
+      if(bulk->label_type[i] == GSE_LT_REUSE)
+      {
+        label_index = stats->last_label;
+      }
+      else
+      {
+        label_index = gse_header_stats_get_label(stats, bulk->label_type[i],
+                                                 bulk->label + i * 6);
+        stats->last_label = label_index;
+      }
+      protocol_index = gse_header_stats_get_protocol(stats,
+                                                     bulk->protocol_type[i]);
+      if(!bulk->end_indicator[i])
+      {
+        stats->frag_label[frag_id] = label_index;
+        stats->frag_protocol[frag_id] = protocol_index;
+      }
+    }
+    else
+    {
+      /* The subsequent fragments belong to the first one */
+      label_index = stats->frag_label[frag_id];
+      protocol_index = stats->frag_protocol[frag_id];
+      if(bulk->end_indicator[i])
+      {
+        stats->frag_label[frag_id] = GSE_HEADER_STATS_NONE;
+        stats->frag_protocol[frag_id] = GSE_HEADER_STATS_NONE;
+      }
+    }
+
+    gse_header_stats_count(label_index == GSE_HEADER_STATS_NONE ?
+                           &stats->label_unknown :
+                           &stats->labels[label_index].counters,
+                           bulk->packet_length[i], bulk->start_indicator[i],
+                           bulk->end_indicator[i]);
+    gse_header_stats_count(protocol_index == GSE_HEADER_STATS_NONE ?
+                           &stats->protocol_unknown :
+                           &stats->protocols[protocol_index].counters,
+                           bulk->packet_length[i], bulk->start_indicator[i],
+                           bulk->end_indicator[i]);
+  }
+
+  return GSE_STATUS_OK;
+}
+
+gse_status_t gse_header_stats_get_labels(gse_header_stats_t *stats,
+                                         const gse_label_counters_t **labels,
+                                         size_t *label_nbr)
+{
+  if(stats == NULL || labels == NULL || label_nbr == NULL)
+  {
+    return GSE_STATUS_NULL_PTR;
+  }
+  *labels = stats->labels;
+  *label_nbr = stats->label_nbr;
+  return GSE_STATUS_OK;
+}
+
+gse_status_t gse_header_stats_get_protocols(gse_header_stats_t *stats,
+                                            const gse_protocol_counters_t **protocols,
+                                            size_t *protocol_nbr)
+{
+  if(stats == NULL || protocols == NULL || protocol_nbr == NULL)
+  {
+    return GSE_STATUS_NULL_PTR;
+  }
+  *protocols = stats->protocols;
+  *protocol_nbr = stats->protocol_nbr;
+  return GSE_STATUS_OK;
+}
+
+gse_status_t gse_header_stats_get_unknown(gse_header_stats_t *stats,
+                                          gse_header_counters_t *label_unknown,
+                                          gse_header_counters_t *protocol_unknown)
+{
+  if(stats == NULL || label_unknown == NULL || protocol_unknown == NULL)
+  {
+    return GSE_STATUS_NULL_PTR;
+  }
+  *label_unknown = stats->label_unknown;
+  *protocol_unknown = stats->protocol_unknown;
+  return GSE_STATUS_OK;
+}
+
+
+/****************************************************************************
+ *
+ *   PRIVATE FUNCTIONS
+ *
+ ****************************************************************************/
+
+static size_t gse_header_stats_table_size(size_t entry_nbr)
+{
+  size_t size = 1;
+
+  while(size < 2 * entry_nbr)
+  {
+    size <<= 1;
+  }
+  return size;
+}
+
+static int gse_header_stats_get_label(gse_header_stats_t *stats,
+                                      uint8_t label_type,
+                                      const uint8_t *label)
+{
+  gse_label_counters_t *entry;
+  uint32_t hash = 2166136261U;
+  size_t pos;
+  unsigned int i;
+
+  /* FNV-1a on the Label Type and the label */
+  hash = (hash ^ label_type) * 16777619U;
+  for(i = 0 ; i < 6 ; i++)
+  {
+    hash = (hash ^ label[i]) * 16777619U;
+  }
+
+  pos = hash & stats->label_mask;
+  while(stats->label_table[pos] != 0)
+  {
+    entry = &stats->labels[stats->label_table[pos] - 1];
+    if(entry->label_type == label_type &&
+       memcmp(entry->label, label, 6) == 0)
+    {
+      return stats->label_table[pos] - 1;
+    }
+    pos = (pos + 1) & stats->label_mask;
+  }
+  if(stats->label_nbr >= stats->max_label_nbr)
+  {
+    return GSE_HEADER_STATS_NONE;
+  }
+
+  entry = &stats->labels[stats->label_nbr];
+  memset(entry, 0, sizeof(gse_label_counters_t));
+  entry->label_type = label_type;
+  memcpy(entry->label, label, 6);
+  stats->label_nbr++;
+  stats->label_table[pos] = stats->label_nbr;
+  return stats->label_nbr - 1;
+}
+
+static int gse_header_stats_get_protocol(gse_header_stats_t *stats,
+                                         uint16_t protocol_type)
+{
+  gse_protocol_counters_t *entry;
+  size_t pos;
+
+  pos = ((uint32_t)protocol_type * 2654435761U >> 16) & stats->protocol_mask;
+  while(stats->protocol_table[pos] != 0)
+  {
+    entry = &stats->protocols[stats->protocol_table[pos] - 1];
+    if(entry->protocol_type == protocol_type)
+    {
+      return stats->protocol_table[pos] - 1;
+    }
+    pos = (pos + 1) & stats->protocol_mask;
+  }
+  if(stats->protocol_nbr >= stats->max_protocol_nbr)
+  {
+    return GSE_HEADER_STATS_NONE;
+  }
+
+  entry = &stats->protocols[stats->protocol_nbr];
+  memset(entry, 0, sizeof(gse_protocol_counters_t));
+  entry->protocol_type = protocol_type;
+  stats->protocol_nbr++;
+  stats->protocol_table[pos] = stats->protocol_nbr;
+  return stats->protocol_nbr - 1;
+}
+
+static void gse_header_stats_count(gse_header_counters_t *counters,
+                                   uint16_t packet_length,
+                                   uint8_t start_indicator,
+                                   uint8_t end_indicator)
+{
+  counters->packet_nbr++;
+  counters->byte_nbr += packet_length;
+  counters->pdu_nbr += start_indicator;
+  counters->fragment_nbr += !(start_indicator && end_indicator);
+}
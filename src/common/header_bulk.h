@@ -0,0 +1,347 @@
+/*
+ *
+ * This piece of software is an implementation of the Generic Stream
+ * Encapsulation (GSE) standard defined by ETSI for Linux (or other
+ * Unix-compatible OS). The library may be used to add GSE
+ * encapsulation/de-encapsulation capabilities to an application.
+ *
+ *
+ * Copyright © 2016 TAS
+ *
+ *
+ * This file is part of the GSE library.
+ *
+ *
+ * The GSE library is free software : you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY, without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see http://www.gnu.org/licenses/.
+ *
+ */
+
+/****************************************************************************/
+/**
+ *   @file          header_bulk.h
+ *
+ *          Project:     GSE LIBRARY
+ *
+ *          Company:     THALES ALENIA SPACE
+ *
+ *          Module name: COMMON
+ *
+ *   @brief         Decoding of all the GSE headers of a frame and counters
+ *                  per label and per protocol
+ *
+ *   @author        Julien BERNARD / Viveris Technologies
+ *
+ */
+/****************************************************************************/
+
+
+#ifndef GSE_HEADER_BULK_H
+#define GSE_HEADER_BULK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "status.h"
+
+/**
+ * @defgroup gse_head_bulk GSE bulk header decoding API
+ *
+ * The headers of all the GSE packets of a frame are decoded at once into
+ * arrays, one per field, indexed by the position of the packet in the
+ * frame. The statistics can then be computed by simple loops over the
+ * arrays instead of one call per field and per packet.
+ */
+
+/****************************************************************************
+ *
+ *   STRUCTURES AND TYPES
+ *
+ ****************************************************************************/
+
+/**
+ *  @brief   The headers of the GSE packets of a frame, one array per field
+ *
+ *  The arrays are aligned on cache lines. The fields absent from a packet
+ *  are set to 0 and its label is padded with 0.
+ *
+ *  @ingroup gse_head_bulk
+ */
+typedef struct
+{
+  size_t max_packet_nbr;     /**< The number of packets the arrays can hold */
+  size_t packet_nbr;         /**< The number of decoded packets */
+  uint32_t *offset;          /**< The offset of the packets in the frame */
+  uint16_t *packet_length;   /**< The length of the packets */
+  uint8_t *header_length;    /**< The length of the headers, without the
+                                  extensions */
+  uint8_t *start_indicator;  /**< The Start Indicator fields */
+  uint8_t *end_indicator;    /**< The End Indicator fields */
+  uint8_t *label_type;       /**< The Label Type fields */
+  uint8_t *frag_id;          /**< The Frag ID fields */
+  uint16_t *total_length;    /**< The Total Length fields */
+  uint16_t *protocol_type;   /**< The Protocol Type fields */
+  uint8_t *label;            /**< The Label fields, 6 bytes per packet */
+  void *data;                /**< The memory of the arrays */
+} gse_header_bulk_t;
+
+/**
+ *  @brief   The counters of a set of GSE packets
+ *
+ *  The fragmentation ratio is the number of fragments over the number of
+ *  packets.
+ *
+ *  @ingroup gse_head_bulk
+ */
+typedef struct
+{
+  uint64_t packet_nbr;       /**< The number of GSE packets */
+  uint64_t byte_nbr;         /**< The number of bytes of the GSE packets */
+  uint64_t pdu_nbr;          /**< The number of PDUs, complete or first
+                                  fragments */
+  uint64_t fragment_nbr;     /**< The number of packets carrying a fragment
+                                  of PDU */
+} gse_header_counters_t;
+
+/**
+ *  @brief   The counters of a label
+ *
+ *  @ingroup gse_head_bulk
+ */
+typedef struct
+{
+  uint8_t label_type;        /**< The Label Type, \ref GSE_LT_NO_LABEL for
+                                  the packets without label */
+  uint8_t label[6];          /**< The label, padded with 0 */
+  gse_header_counters_t counters; /**< The counters of the label */
+} gse_label_counters_t;
+
+/**
+ *  @brief   The counters of a protocol
+ *
+ *  @ingroup gse_head_bulk
+ */
+typedef struct
+{
+  uint16_t protocol_type;    /**< The Protocol Type */
+  gse_header_counters_t counters; /**< The counters of the protocol */
+} gse_protocol_counters_t;
+
+/** Counters per label and per protocol */
+typedef struct gse_header_stats_s gse_header_stats_t;
+
+/****************************************************************************
+ *
+ *   FUNCTION PROTOTYPES
+ *
+ ****************************************************************************/
+
+/**
+ *  @brief   Create the arrays of the headers of a frame
+ *
+ *  @param   max_packet_nbr  The number of packets the arrays can hold
+ *  @param   bulk            OUT: The arrays on success, NULL on error
+ *
+ *  @return
+ *                           - success/informative code among:
+ *                             - \ref GSE_STATUS_OK
+ *                           - warning/error code among:
+ *                             - \ref GSE_STATUS_NULL_PTR
+ *                             - \ref GSE_STATUS_BUFF_LENGTH_NULL
+ *                             - \ref GSE_STATUS_MALLOC_FAILED
+ *
+ *  @ingroup gse_head_bulk
+ */
+gse_status_t gse_header_bulk_init(size_t max_packet_nbr,
+                                  gse_header_bulk_t **bulk);
+
+/**
+ *  @brief   Release the arrays of the headers of a frame
+ *
+ *  @param   bulk  The arrays
+ *
+ *  @return
+ *                 - success/informative code among:
+ *                   - \ref GSE_STATUS_OK
+ *                 - warning/error code among:
+ *                   - \ref GSE_STATUS_NULL_PTR
+ *
+ *  @ingroup gse_head_bulk
+ */
+gse_status_t gse_header_bulk_release(gse_header_bulk_t *bulk);
+
+/**
+ *  @brief   Decode the headers of the GSE packets of a frame
+ *
+ *  The data is the data field of a BBFrame (see \ref gse_parse_bbheader) or
+ *  any buffer of GSE packets. The decoding stops at the padding, at the end
+ *  of the data or when the arrays are full. In the last case, the decoding
+ *  goes on by calling the function again from the decoded length.\n
+ *  On error, the packets before the invalid one are decoded.
+ *
+ *  @param   bulk            The arrays, their previous content is replaced
+ *  @param   data            The GSE packets
+ *  @param   length          The length of the data
+ *  @param   decoded_length  OUT: The length of the decoded packets
+ *
+ *  @return
+ *                           - success/informative code among:
+ *                             - \ref GSE_STATUS_OK
+ *                           - warning/error code among:
+ *                             - \ref GSE_STATUS_NULL_PTR
+ *                             - \ref GSE_STATUS_PACKET_TOO_SMALL
+ *                             - \ref GSE_STATUS_INVALID_GSE_LENGTH
+ *
+ *  @ingroup gse_head_bulk
+ */
+gse_status_t gse_header_bulk_decode(gse_header_bulk_t *bulk,
+                                    const unsigned char *data, size_t length,
+                                    size_t *decoded_length);
+
+/**
+ *  @brief   Create the counters per label and per protocol
+ *
+ *  @param   max_label_nbr     The number of labels that can be counted
+ *  @param   max_protocol_nbr  The number of protocols that can be counted
+ *  @param   stats             OUT: The counters on success, NULL on error
+ *
+ *  @return
+ *                             - success/informative code among:
+ *                               - \ref GSE_STATUS_OK
+ *                             - warning/error code among:
+ *                               - \ref GSE_STATUS_NULL_PTR
+ *                               - \ref GSE_STATUS_BUFF_LENGTH_NULL
+ *                               - \ref GSE_STATUS_MALLOC_FAILED
+ *
+ *  @ingroup gse_head_bulk
+ */
+gse_status_t gse_header_stats_init(size_t max_label_nbr,
+                                   size_t max_protocol_nbr,
+                                   gse_header_stats_t **stats);
+
+/**
+ *  @brief   Release the counters per label and per protocol
+ *
+ *  @param   stats  The counters
+ *
+ *  @return
+ *                  - success/informative code among:
+ *                    - \ref GSE_STATUS_OK
+ *                  - warning/error code among:
+ *                    - \ref GSE_STATUS_NULL_PTR
+ *
+ *  @ingroup gse_head_bulk
+ */
+gse_status_t gse_header_stats_release(gse_header_stats_t *stats);
+
+/**
+ *  @brief   Forget all the labels, protocols and fragmented PDUs
+ *
+ *  @param   stats  The counters
+ *
+ *  @return
+ *                  - success/informative code among:
+ *                    - \ref GSE_STATUS_OK
+ *                  - warning/error code among:
+ *                    - \ref GSE_STATUS_NULL_PTR
+ *
+ *  @ingroup gse_head_bulk
+ */
+gse_status_t gse_header_stats_reset(gse_header_stats_t *stats);
+
+/**
+ *  @brief   Count the decoded packets of a frame
+ *
+ *  The frames shall be given in their order of reception, a frame may be
+ *  given in several parts: the subsequent fragments carry no label nor
+ *  protocol, they are counted with the first fragment of the same Frag ID,
+ *  and a re-used label is the previous label.\n
+ *  The packets that cannot be attributed, because the first fragment was
+ *  not seen or the label or protocol could not be added, are counted
+ *  apart (see \ref gse_header_stats_get_unknown).
+ *
+ *  @param   stats  The counters
+ *  @param   bulk   The decoded headers of the frame
+ *
+ *  @return
+ *                  - success/informative code among:
+ *                    - \ref GSE_STATUS_OK
+ *                  - warning/error code among:
+ *                    - \ref GSE_STATUS_NULL_PTR
+ *
+ *  @ingroup gse_head_bulk
+ */
+gse_status_t gse_header_stats_update(gse_header_stats_t *stats,
+                                     const gse_header_bulk_t *bulk);
+
+/**
+ *  @brief   Get the counters of the labels, in their order of appearance
+ *
+ *  @param   stats      The counters
+ *  @param   labels     OUT: The counters of the labels, valid until the next
+ *                           update, reset or release
+ *  @param   label_nbr  OUT: The number of labels
+ *
+ *  @return
+ *                      - success/informative code among:
+ *                        - \ref GSE_STATUS_OK
+ *                      - warning/error code among:
+ *                        - \ref GSE_STATUS_NULL_PTR
+ *
+ *  @ingroup gse_head_bulk
+ */
+gse_status_t gse_header_stats_get_labels(gse_header_stats_t *stats,
+                                         const gse_label_counters_t **labels,
+                                         size_t *label_nbr);
+
+/**
+ *  @brief   Get the counters of the protocols, in their order of appearance
+ *
+ *  @param   stats         The counters
+ *  @param   protocols     OUT: The counters of the protocols, valid until the
+ *                              next update, reset or release
+ *  @param   protocol_nbr  OUT: The number of protocols
+ *
+ *  @return
+ *                         - success/informative code among:
+ *                           - \ref GSE_STATUS_OK
+ *                         - warning/error code among:
+ *                           - \ref GSE_STATUS_NULL_PTR
+ *
+ *  @ingroup gse_head_bulk
+ */
+gse_status_t gse_header_stats_get_protocols(gse_header_stats_t *stats,
+                                            const gse_protocol_counters_t **protocols,
+                                            size_t *protocol_nbr);
+
+/**
+ *  @brief   Get the counters of the packets attributed to no label or no
+ *           protocol
+ *
+ *  @param   stats           The counters
+ *  @param   label_unknown   OUT: The packets attributed to no label
+ *  @param   protocol_unknown OUT: The packets attributed to no protocol
+ *
+ *  @return
+ *                           - success/informative code among:
+ *                             - \ref GSE_STATUS_OK
+ *                           - warning/error code among:
+ *                             - \ref GSE_STATUS_NULL_PTR
+ *
+ *  @ingroup gse_head_bulk
+ */
+gse_status_t gse_header_stats_get_unknown(gse_header_stats_t *stats,
+                                          gse_header_counters_t *label_unknown,
+                                          gse_header_counters_t *protocol_unknown);
+
+#endif
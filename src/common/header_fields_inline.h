@@ -0,0 +1,394 @@
+/*
+ *
+ * This piece of software is an implementation of the Generic Stream
+ * Encapsulation (GSE) standard defined by ETSI for Linux (or other
+ * Unix-compatible OS). The library may be used to add GSE
+ * encapsulation/de-encapsulation capabilities to an application.
+ *
+ *
+ * Copyright © 2016 TAS
+ *
+ *
+ * This file is part of the GSE library.
+ *
+ *
+ * The GSE library is free software : you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY, without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see http://www.gnu.org/licenses/.
+ *
+ */
+
+/****************************************************************************/
+/**
+ *   @file          header_fields_inline.h
+ *
+ *          Project:     GSE LIBRARY
+ *
+ *          Company:     THALES ALENIA SPACE
+ *
+ *          Module name: COMMON
+ *
+ *   @brief         Unchecked inline access to the header fields
+ *
+ *   @author        Julien BERNARD / Viveris Technologies
+ *
+ */
+/****************************************************************************/
+
+
+#ifndef HEADER_FIELDS_INLINE_H
+#define HEADER_FIELDS_INLINE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "constants.h"
+
+/**
+ * @defgroup gse_head_inline GSE header fields inline access API
+ *
+ *  These accessors decode the bytes of the header directly. They neither
+ *  check the pointer nor whether the field is present in the packet: the
+ *  caller shall give the beginning of a GSE packet with its whole header
+ *  available, and only read the fields of its payload type (see
+ *  \ref gse_hdr_has_frag_id, \ref gse_hdr_has_total_length and
+ *  \ref gse_hdr_has_protocol_type). Untrusted data shall be checked with the
+ *  functions of \ref gse_head_access.
+ */
+
+/****************************************************************************
+ *
+ *   MACROS AND CONSTANTS
+ *
+ ****************************************************************************/
+
+/** The offset of the Frag ID field of a fragment of PDU */
+#define GSE_HDR_FRAG_ID_OFFSET 2
+/** The offset of the Total Length field of a first fragment of PDU */
+#define GSE_HDR_TOTAL_LENGTH_OFFSET 3
+/** The offset of the Protocol Type field of a complete PDU */
+#define GSE_HDR_COMPLETE_PROTOCOL_OFFSET 2
+/** The offset of the Protocol Type field of a first fragment of PDU */
+#define GSE_HDR_FIRST_FRAG_PROTOCOL_OFFSET 5
+/** The length of the header of a subsequent or last fragment of PDU */
+#define GSE_HDR_SUBS_FRAG_LENGTH 3
+
+/****************************************************************************
+ *
+ *   STRUCTURES AND TYPES
+ *
+ ****************************************************************************/
+
+/**
+ *  @brief   The fields of a GSE header decoded at once
+ *
+ *  The absent fields are set to 0.
+ *
+ *  @ingroup gse_head_inline
+ */
+typedef struct
+{
+  uint8_t start_indicator; /**< The Start Indicator field */
+  uint8_t end_indicator;   /**< The End Indicator field */
+  uint8_t label_type;      /**< The Label Type field */
+  uint8_t frag_id;         /**< The Frag ID field */
+  uint16_t gse_length;     /**< The GSE Length field */
+  uint16_t total_length;   /**< The Total Length field */
+  uint16_t protocol_type;  /**< The Protocol Type field */
+  uint8_t label_length;    /**< The length of the Label field */
+  uint8_t header_length;   /**< The length of the header */
+  uint8_t label[6];        /**< The Label field */
+} gse_header_fields_t;
+
+/****************************************************************************
+ *
+ *   FUNCTIONS
+ *
+ ****************************************************************************/
+
+/**
+ *  @brief   Get the Start Indicator field value
+ *
+ *  @param   packet  The beginning of the GSE packet
+ *
+ *  @return          The Start Indicator value
+ *
+ *  @ingroup gse_head_inline
+ */
+static inline uint8_t gse_hdr_start_indicator(const unsigned char *packet)
+{
+  return (packet[0] >> 7) & 0x1;
+}
+
+/**
+ *  @brief   Get the End Indicator field value
+ *
+ *  @param   packet  The beginning of the GSE packet
+ *
+ *  @return          The End Indicator value
+ *
+ *  @ingroup gse_head_inline
+ */
+static inline uint8_t gse_hdr_end_indicator(const unsigned char *packet)
+{
+  return (packet[0] >> 6) & 0x1;
+}
+
+/**
+ *  @brief   Get the Label Type field value
+ *
+ *  @param   packet  The beginning of the GSE packet
+ *
+ *  @return          The Label Type value
+ *
+ *  @ingroup gse_head_inline
+ */
+static inline uint8_t gse_hdr_label_type(const unsigned char *packet)
+{
+  return (packet[0] >> 4) & 0x3;
+}
+
+/**
+ *  @brief   Get the GSE Length field value
+ *
+ *  @param   packet  The beginning of the GSE packet
+ *
+ *  @return          The GSE Length value
+ *
+ *  @ingroup gse_head_inline
+ */
+static inline uint16_t gse_hdr_gse_length(const unsigned char *packet)
+{
+  return ((uint16_t)(packet[0] & 0x0F) << 8) | packet[1];
+}
+
+/**
+ *  @brief   Whether the packet carries a Frag ID field
+ *
+ *  @param   packet  The beginning of the GSE packet
+ *
+ *  @return          1 for a fragment of PDU, 0 for a complete PDU
+ *
+ *  @ingroup gse_head_inline
+ */
+static inline int gse_hdr_has_frag_id(const unsigned char *packet)
+{
+  return (packet[0] & 0xC0) != 0xC0;
+}
+
+/**
+ *  @brief   Whether the packet carries a Total Length field
+ *
+ *  @param   packet  The beginning of the GSE packet
+ *
+ *  @return          1 for a first fragment of PDU, 0 otherwise
+ *
+ *  @ingroup gse_head_inline
+ */
+static inline int gse_hdr_has_total_length(const unsigned char *packet)
+{
+  return (packet[0] & 0xC0) == 0x80;
+}
+
+/**
+ *  @brief   Whether the packet carries the Protocol Type and Label fields
+ *
+ *  @param   packet  The beginning of the GSE packet
+ *
+ *  @return          1 for a complete PDU or a first fragment, 0 otherwise
+ *
+ *  @ingroup gse_head_inline
+ */
+static inline int gse_hdr_has_protocol_type(const unsigned char *packet)
+{
+  return (packet[0] & 0x80) != 0;
+}
+
+/**
+ *  @brief   Get the Frag ID field value of a fragment of PDU
+ *
+ *  @param   packet  The beginning of the GSE packet
+ *
+ *  @return          The Frag ID value
+ *
+ *  @ingroup gse_head_inline
+ */
+static inline uint8_t gse_hdr_frag_id(const unsigned char *packet)
+{
+  return packet[GSE_HDR_FRAG_ID_OFFSET];
+}
+
+/**
+ *  @brief   Get the Total Length field value of a first fragment of PDU
+ *
+ *  @param   packet  The beginning of the GSE packet
+ *
+ *  @return          The Total Length value
+ *
+ *  @ingroup gse_head_inline
+ */
+static inline uint16_t gse_hdr_total_length(const unsigned char *packet)
+{
+  const unsigned char *field = packet + GSE_HDR_TOTAL_LENGTH_OFFSET;
+
+  return ((uint16_t)field[0] << 8) | field[1];
+}
+
+/**
+ *  @brief   Get the offset of the Protocol Type field of a complete PDU or a
+ *           first fragment, the Label field follows it
+ *
+ *  @param   packet  The beginning of the GSE packet
+ *
+ *  @return          The offset of the Protocol Type field
+ *
+ *  @ingroup gse_head_inline
+ */
+static inline size_t gse_hdr_protocol_type_offset(const unsigned char *packet)
+{
+  return (gse_hdr_end_indicator(packet) ?
+          GSE_HDR_COMPLETE_PROTOCOL_OFFSET :
+          GSE_HDR_FIRST_FRAG_PROTOCOL_OFFSET);
+}
+
+/**
+ *  @brief   Get the Protocol Type field value of a complete PDU or a first
+ *           fragment
+ *
+ *  @param   packet  The beginning of the GSE packet
+ *
+ *  @return          The Protocol Type value
+ *
+ *  @ingroup gse_head_inline
+ */
+static inline uint16_t gse_hdr_protocol_type(const unsigned char *packet)
+{
+  const unsigned char *field = packet + gse_hdr_protocol_type_offset(packet);
+
+  return ((uint16_t)field[0] << 8) | field[1];
+}
+
+/**
+ *  @brief   Get the length of the Label field
+ *
+ *  @param   packet  The beginning of the GSE packet
+ *
+ *  @return          The length of the Label field, 0 when it is absent
+ *
+ *  @ingroup gse_head_inline
+ */
+static inline size_t gse_hdr_label_length(const unsigned char *packet)
+{
+  /* 6 bytes for '00', 3 bytes for '01', none for '10' and '11' */
+  static const uint8_t label_length[4] = { 6, 3, 0, 0 };
+
+  if(!gse_hdr_has_protocol_type(packet))
+  {
+    return 0;
+  }
+  return label_length[gse_hdr_label_type(packet)];
+}
+
+/**
+ *  @brief   Get the Label field of a complete PDU or a first fragment
+ *
+ *  The label is not copied, its length is given by
+ *  \ref gse_hdr_label_length.
+ *
+ *  @param   packet  The beginning of the GSE packet
+ *
+ *  @return          The beginning of the Label field
+ *
+ *  @ingroup gse_head_inline
+ */
+static inline const unsigned char *gse_hdr_label(const unsigned char *packet)
+{
+  return packet + gse_hdr_protocol_type_offset(packet) + 2;
+}
+
+/**
+ *  @brief   Get the length of the header, without the extensions
+ *
+ *  @param   packet  The beginning of the GSE packet
+ *
+ *  @return          The length of the header
+ *
+ *  @ingroup gse_head_inline
+ */
+static inline size_t gse_hdr_length(const unsigned char *packet)
+{
+  if(!gse_hdr_has_protocol_type(packet))
+  {
+    return GSE_HDR_SUBS_FRAG_LENGTH;
+  }
+  return gse_hdr_protocol_type_offset(packet) + 2 +
+         gse_hdr_label_length(packet);
+}
+
+/**
+ *  @brief   Decode all the fields of a GSE header
+ *
+ *  @param   packet  The beginning of the GSE packet
+ *  @param   fields  OUT: The fields of the header, the absent ones are 0
+ *
+ *  @return          The length of the header, without the extensions
+ *
+ *  @ingroup gse_head_inline
+ */
+static inline size_t gse_hdr_decode(const unsigned char *packet,
+                                    gse_header_fields_t *fields)
+{
+  const unsigned char *field = packet + GSE_HDR_FRAG_ID_OFFSET;
+  uint8_t byte = packet[0];
+
+  memset(fields, 0, sizeof(gse_header_fields_t));
+  fields->start_indicator = (byte >> 7) & 0x1;
+  fields->end_indicator = (byte >> 6) & 0x1;
+  fields->label_type = (byte >> 4) & 0x3;
+  fields->gse_length = ((uint16_t)(byte & 0x0F) << 8) | packet[1];
+
+  if(!fields->end_indicator || !fields->start_indicator)
+  {
+    fields->frag_id = *field;
+    field++;
+  }
+  if(fields->start_indicator)
+  {
+    if(!fields->end_indicator)
+    {
+      fields->total_length = ((uint16_t)field[0] << 8) | field[1];
+      field += 2;
+    }
+    fields->protocol_type = ((uint16_t)field[0] << 8) | field[1];
+    field += 2;
+    switch(fields->label_type)
+    {
+      case GSE_LT_6_BYTES:
+        memcpy(fields->label, field, 6);
+        fields->label_length = 6;
+        break;
+      case GSE_LT_3_BYTES:
+        memcpy(fields->label, field, 3);
+        fields->label_length = 3;
+        break;
+      default:
+        break;
+    }
+    field += fields->label_length;
+  }
+  fields->header_length = field - packet;
+
+  return fields->header_length;
+}
+
+#endif
@@ -0,0 +1,271 @@
+/*
+ *
+ * This piece of software is an implementation of the Generic Stream
+ * Encapsulation (GSE) standard defined by ETSI for Linux (or other
+ * Unix-compatible OS). The library may be used to add GSE
+ * encapsulation/de-encapsulation capabilities to an application.
+ *
+ *
+ * Copyright © 2016 TAS
+ *
+ *
+ * This file is part of the GSE library.
+ *
+ *
+ * The GSE library is free software : you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY, without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see http://www.gnu.org/licenses/.
+ *
+ */
+
+/****************************************************************************/
+/**
+ *   @file          numa.c
+ *
+ *          Project:     GSE LIBRARY
+ *
+ *          Company:     THALES ALENIA SPACE
+ *
+ *          Module name: COMMON
+ *
+ *   @brief         Placement of threads and memory on NUMA nodes
+ *
+ *   @author        Julien BERNARD / Viveris Technologies
+ *
+ */
+/****************************************************************************/
+
+/* sched_setaffinity() and the CPU sets are GNU extensions */
+#define _GNU_SOURCE
+
+#include "numa.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+
+/** The directory of the NUMA nodes in sysfs */
+#define GSE_NUMA_SYSFS_NODE "/sys/devices/system/node/node"
+
+/** The number of bits of the node masks given to the kernel, it counts
+ *  one more bit than the mask holds */
+#define GSE_NUMA_MASK_BITS (GSE_NUMA_MAX_NODE_NBR + 1)
+
+
+/****************************************************************************
+ *
+ *   PROTOTYPES OF PRIVATE FUNCTIONS
+ *
+ ****************************************************************************/
+
+/**
+ *  @brief   Read the CPUs of a NUMA node
+ *
+ *  @param   node  The NUMA node
+ *  @param   cpus  OUT: The CPUs of the node
+ *
+ *  @return
+ *                 - success/informative code among:
+ *                   - \ref GSE_STATUS_OK
+ *                 - warning/error code among:
+ *                   - \ref GSE_STATUS_NUMA_FAILED
+ */
+static gse_status_t gse_numa_get_node_cpus(int node, cpu_set_t *cpus);
+
+
+/****************************************************************************
+ *
+ *   PUBLIC FUNCTIONS
+ *
+ ****************************************************************************/
+
+gse_status_t gse_numa_check_node(int node)
+{
+  char path[64];
+
+  if(node < 0 || node >= GSE_NUMA_MAX_NODE_NBR)
+  {
+    return GSE_STATUS_NUMA_FAILED;
+  }
+
+  snprintf(path, sizeof(path), GSE_NUMA_SYSFS_NODE "%d", node);
+  if(access(path, F_OK) != 0)
+  {
+    return GSE_STATUS_NUMA_FAILED;
+  }
+
+  return GSE_STATUS_OK;
+}
+
+gse_status_t gse_numa_bind_thread(int node)
+{
+  gse_status_t status;
+  cpu_set_t cpus;
+  unsigned long mask;
+
+  if(node == GSE_NUMA_NO_NODE)
+  {
+    if(syscall(__NR_set_mempolicy, MPOL_DEFAULT, NULL, 0) != 0)
+    {
+      return GSE_STATUS_NUMA_FAILED;
+    }
+    return GSE_STATUS_OK;
+  }
+
+  status = gse_numa_check_node(node);
+  if(status != GSE_STATUS_OK)
+  {
+    goto error;
+  }
+  status = gse_numa_get_node_cpus(node, &cpus);
+  if(status != GSE_STATUS_OK)
+  {
+    goto error;
+  }
+
+  /* A node without CPU only gets the memory policy */
+  if(CPU_COUNT(&cpus) > 0 && sched_setaffinity(0, sizeof(cpus), &cpus) != 0)
+  {
+    status = GSE_STATUS_NUMA_FAILED;
+    goto error;
+  }
+  mask = 1UL << node;
+  if(syscall(__NR_set_mempolicy, MPOL_PREFERRED, &mask,
+             GSE_NUMA_MASK_BITS) != 0)
+  {
+    status = GSE_STATUS_NUMA_FAILED;
+    goto error;
+  }
+
+error:
+  return status;
+}
+
+gse_status_t gse_numa_bind_memory(void *area, size_t length, int node)
+{
+  gse_status_t status;
+  unsigned long mask;
+
+  if(area == NULL)
+  {
+    return GSE_STATUS_NULL_PTR;
+  }
+
+  status = gse_numa_check_node(node);
+  if(status != GSE_STATUS_OK)
+  {
+    return status;
+  }
+
+  mask = 1UL << node;
+  if(syscall(__NR_mbind, area, length, MPOL_PREFERRED, &mask,
+             GSE_NUMA_MASK_BITS, 0) != 0)
+  {
+    return GSE_STATUS_NUMA_FAILED;
+  }
+
+  return GSE_STATUS_OK;
+}
+
+gse_status_t gse_numa_get_current_node(int *node)
+{
+  unsigned int cpu;
+  unsigned int cpu_node;
+
+  if(node == NULL)
+  {
+    return GSE_STATUS_NULL_PTR;
+  }
+
+  if(syscall(__NR_getcpu, &cpu, &cpu_node, NULL) != 0)
+  {
+    return GSE_STATUS_NUMA_FAILED;
+  }
+  *node = cpu_node;
+
+  return GSE_STATUS_OK;
+}
+
+gse_status_t gse_numa_get_memory_node(void *area, int *node)
+{
+  if(area == NULL || node == NULL)
+  {
+    return GSE_STATUS_NULL_PTR;
+  }
+
+  if(syscall(__NR_get_mempolicy, node, NULL, 0, area,
+             MPOL_F_NODE | MPOL_F_ADDR) != 0)
+  {
+    return GSE_STATUS_NUMA_FAILED;
+  }
+
+  return GSE_STATUS_OK;
+}
+
+
+/****************************************************************************
+ *
+ *   PRIVATE FUNCTIONS
+ *
+ ****************************************************************************/
+
+static gse_status_t gse_numa_get_node_cpus(int node, cpu_set_t *cpus)
+{
+  gse_status_t status = GSE_STATUS_OK;
+  char path[64];
+  FILE *file;
+  int first;
+  int last;
+  int cpu;
+  int sep;
+
+  CPU_ZERO(cpus);
+
+  /* The list looks like "0-3,8-11" */
+  snprintf(path, sizeof(path), GSE_NUMA_SYSFS_NODE "%d/cpulist", node);
+  file = fopen(path, "r");
+  if(file == NULL)
+  {
+    status = GSE_STATUS_NUMA_FAILED;
+    goto error;
+  }
+  while(fscanf(file, "%d", &first) == 1)
+  {
+    last = first;
+    sep = fgetc(file);
+    if(sep == '-')
+    {
+      if(fscanf(file, "%d", &last) != 1)
+      {
+        status = GSE_STATUS_NUMA_FAILED;
+        goto close;
+      }
+      sep = fgetc(file);
+    }
+    for(cpu = first ; cpu <= last && cpu < CPU_SETSIZE ; cpu++)
+    {
+      CPU_SET(cpu, cpus);
+    }
+    if(sep != ',')
+    {
+      break;
+    }
+  }
+
+close:
+  fclose(file);
+error:
+  return status;
+}
@@ -0,0 +1,173 @@
+/*
+ *
+ * This piece of software is an implementation of the Generic Stream
+ * Encapsulation (GSE) standard defined by ETSI for Linux (or other
+ * Unix-compatible OS). The library may be used to add GSE
+ * encapsulation/de-encapsulation capabilities to an application.
+ *
+ *
+ * Copyright © 2016 TAS
+ *
+ *
+ * This file is part of the GSE library.
+ *
+ *
+ * The GSE library is free software : you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY, without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see http://www.gnu.org/licenses/.
+ *
+ */
+
+/****************************************************************************/
+/**
+ *   @file          numa.h
+ *
+ *          Project:     GSE LIBRARY
+ *
+ *          Company:     THALES ALENIA SPACE
+ *
+ *          Module name: COMMON
+ *
+ *   @brief         Placement of threads and memory on NUMA nodes
+ *
+ *   @author        Julien BERNARD / Viveris Technologies
+ *
+ */
+/****************************************************************************/
+
+
+#ifndef GSE_NUMA_H
+#define GSE_NUMA_H
+
+#include <stddef.h>
+
+#include "status.h"
+
+/** No NUMA node, the placement of the system applies
+ *
+ *  @ingroup gse_numa
+ */
+#define GSE_NUMA_NO_NODE (-1)
+
+/** The number of NUMA nodes that can be used, from 0
+ *
+ *  @ingroup gse_numa
+ */
+#define GSE_NUMA_MAX_NODE_NBR 64
+
+/**
+ * @defgroup gse_numa GSE NUMA placement API
+ *
+ * The placement relies on the memory policy system calls of Linux, the
+ * first memory access of an allocation decides its node. An encapsulation
+ * or deencapsulation structure created by a thread bound to a node is
+ * placed on this node, as the tables allocated on first use by a worker
+ * thread bound to it.
+ */
+
+/****************************************************************************
+ *
+ *   FUNCTION PROTOTYPES
+ *
+ ****************************************************************************/
+
+/**
+ *  @brief   Check that a NUMA node exists
+ *
+ *  @param   node  The NUMA node
+ *
+ *  @return
+ *                 - success/informative code among:
+ *                   - \ref GSE_STATUS_OK
+ *                 - warning/error code among:
+ *                   - \ref GSE_STATUS_NUMA_FAILED
+ *
+ *  @ingroup gse_numa
+ */
+gse_status_t gse_numa_check_node(int node);
+
+/**
+ *  @brief   Bind the calling thread to a NUMA node
+ *
+ *  The thread runs on the CPUs of the node and its allocations prefer the
+ *  memory of the node. The threads it creates afterwards inherit the
+ *  placement.\n
+ *  With \ref GSE_NUMA_NO_NODE the default memory policy is restored, the
+ *  CPUs of the thread are not changed.
+ *
+ *  @param   node  The NUMA node or \ref GSE_NUMA_NO_NODE
+ *
+ *  @return
+ *                 - success/informative code among:
+ *                   - \ref GSE_STATUS_OK
+ *                 - warning/error code among:
+ *                   - \ref GSE_STATUS_NUMA_FAILED
+ *
+ *  @ingroup gse_numa
+ */
+gse_status_t gse_numa_bind_thread(int node);
+
+/**
+ *  @brief   Place a memory area on a NUMA node
+ *
+ *  The pages of the area that are not accessed yet prefer the memory of
+ *  the node.
+ *
+ *  @param   area    The memory area, aligned on a page
+ *  @param   length  The length of the area (in bytes)
+ *  @param   node    The NUMA node
+ *
+ *  @return
+ *                   - success/informative code among:
+ *                     - \ref GSE_STATUS_OK
+ *                   - warning/error code among:
+ *                     - \ref GSE_STATUS_NULL_PTR
+ *                     - \ref GSE_STATUS_NUMA_FAILED
+ *
+ *  @ingroup gse_numa
+ */
+gse_status_t gse_numa_bind_memory(void *area, size_t length, int node);
+
+/**
+ *  @brief   Get the NUMA node of the CPU running the calling thread
+ *
+ *  @param   node  OUT: The NUMA node
+ *
+ *  @return
+ *                 - success/informative code among:
+ *                   - \ref GSE_STATUS_OK
+ *                 - warning/error code among:
+ *                   - \ref GSE_STATUS_NULL_PTR
+ *                   - \ref GSE_STATUS_NUMA_FAILED
+ *
+ *  @ingroup gse_numa
+ */
+gse_status_t gse_numa_get_current_node(int *node);
+
+/**
+ *  @brief   Get the NUMA node of a memory area
+ *
+ *  @param   area  The memory area, it shall be accessed already
+ *  @param   node  OUT: The NUMA node of its first page
+ *
+ *  @return
+ *                 - success/informative code among:
+ *                   - \ref GSE_STATUS_OK
+ *                 - warning/error code among:
+ *                   - \ref GSE_STATUS_NULL_PTR
+ *                   - \ref GSE_STATUS_NUMA_FAILED
+ *
+ *  @ingroup gse_numa
+ */
+gse_status_t gse_numa_get_memory_node(void *area, int *node);
+
+#endif
@@ -62,7 +62,10 @@ static char *gse_status_string[GSE_STATUS_MAX] =
   [0x0102] = "Pointer given in parameter is NULL",
   [0x0103] = "Error with pthread_mutex function",
   [0x0104] = "Internal error, please report bug",
-  [0x0105 ... 0x01FF] = "Unknown status",
+  [0x0105] = "NUMA placement failed",
+  [0x0106] = "eventfd or futex system call failed",
+  [0x0107] = "Shared memory segment creation or mapping failed",
+  [0x0108 ... 0x01FF] = "Unknown status",
   [0x0200] = "Warning or error on virtual buffer management",
   [0x0201] = "Number of fragments can not be outside [0,2]",
   [0x0202] = "Fragment does not contain data",
@@ -73,13 +76,23 @@ static char *gse_status_string[GSE_STATUS_MAX] =
   [0x0207] = "The specified offset are too long for the virtual buffer",
   [0x0208] = "The specified length for buffer is null",
   [0x0209] = "The offsets values are invalid",
-  [0x020A ... 0x02FF] = "Unknown status",
+  [0x020A] = "The chain of virtual fragments is full",
+  [0x020B ... 0x02FF] = "Unknown status",
   [0x0300] = "Warning or error on FIFO management",
   [0x0301] = "FIFO is full",
   [0x0302] = "FIFO is empty",
   [0x0303] = "FIFO size is null",
   [0x0304] = "FIFO number is null",
-  [0x0305 ... 0x03FF] = "Unknown status",
+  [0x0305] = "No Frag ID available for a new fragmented PDU",
+  [0x0306] = "FIFOs are not empty",
+  [0x0307] = "Invalid number of FragID values",
+  [0x0308] = "FragID pool is required",
+  [0x0309] = "PDUs are limited by their shapers",
+  [0x030A] = "Invalid shaper configuration",
+  [0x030B] = "No shaper is configured",
+  [0x030C] = "PDUs are waiting for data",
+  [0x030D] = "PDU was aborted",
+  [0x030E ... 0x03FF] = "Unknown status",
   [0x0400] = "Warning or error on length parameters",
   [0x0401] = "PDU is to long",
   [0x0402] = "Length is too small for a GSE packet (try another FragID or use padding)",
@@ -97,13 +110,17 @@ static char *gse_status_string[GSE_STATUS_MAX] =
   [0x0508] = "The extension callback returned an error",
   [0x0509] = "Cannot add extension because this is a fragment or there are already extensions in the GSE packet",
   [0x050A] = "Extensions are not valid",
-  [0x050B ... 0x05FF] = "Unknown status",
+  [0x050B] = "The label is not known",
+  [0x050C ... 0x05FF] = "Unknown status",
   [0x0600] = "Warning or error on deencapsulation",
   [0x0601] = "Subsequent fragment of PDU received while first fragment is missing: packet dropped",
   [0x0602] = "Timeout, PDU was not completely received in 256 BBFrames: PDU dropped",
   [0x0603] = "Packet is too long for the deencapsulation buffer: PDU dropped",
   [0x0604] = "Packet is too small for a GSE packet",
-  [0x0605 ... 0x06FF] = "Unknown status",
+  [0x0605] = "Sink callback failed: PDU dropped",
+  [0x0606] = "No PDU waiting for CRC verification",
+  [0x0607] = "PDU too long for the reassembly pool: PDU dropped",
+  [0x0608 ... 0x06FF] = "Unknown status",
   [0x0700] = "Warning or error when verifying incoming PDU data",
   [0x0701] = "Total length does not match the PDU length: PDU dropped",
   [0x0702] = "CRC32 computed does not match the received one: PDU dropped",
@@ -115,12 +132,19 @@ static char *gse_status_string[GSE_STATUS_MAX] =
   [0x0803 ... 0x08FF] = "Unknown status",
   [0x0900] = "Deencapsulation success code received, a complete PDU is returned",
   [0x0901] = "A complete PDU is returned",
-  [0x0902 ... 0x09FF] = "Unknown status",
+  [0x0902] = "A complete PDU was given to the sink",
+  [0x0903] = "A complete PDU was queued for CRC verification",
+  [0x0904 ... 0x09FF] = "Unknown status",
   [0x0A00] = "Warning or error when retrieving a header field value",
   [0x0A01] = "The GSE packet does not contain the requested field",
   [0x0A02 ... 0x0AFF] = "Unknown status",
   [0x0B01] = "The CRC has been updated but this was not the last fragment, update the next packet in the fifo",
   [0x0B02 ... 0x0BFF] = "Unknown status",
+  [0x0C00] = "Warning or error on BBFrame",
+  [0x0C01] = "CRC-8 of the BBHEADER is invalid: BBFrame dropped",
+  [0x0C02] = "Data field length does not fit in the BBFrame: BBFrame dropped",
+  [0x0C03] = "BBFrame length is invalid",
+  [0x0C04 ... 0x0CFF] = "Unknown status",
 };
 
 char *gse_get_status(gse_status_t status)
@@ -74,6 +74,13 @@ typedef enum
   GSE_STATUS_PTHREAD_MUTEX            = 0x0103,
   /** Internal error, please report bug */
   GSE_STATUS_INTERNAL_ERROR           = 0x0104,
+  /** The NUMA node does not exist or the placement on it failed */
+  GSE_STATUS_NUMA_FAILED              = 0x0105,
+  /** An eventfd or futex system call failed */
+  GSE_STATUS_EVENT_FAILED             = 0x0106,
+  /** The shared memory segment cannot be created or mapped, or it is not a
+   *  valid segment */
+  GSE_STATUS_SHM_FAILED               = 0x0107,
 
   /* Virtual buffer status */
 
@@ -97,6 +104,8 @@ typedef enum
   GSE_STATUS_BUFF_LENGTH_NULL         = 0x0208,
   /** Offsets values are invalid */
   GSE_STATUS_BAD_OFFSETS              = 0x0209,
+  /** The chain of virtual fragments cannot hold another segment */
+  GSE_STATUS_CHAIN_FULL               = 0x020A,
 
   /* FIFO status */
 
@@ -108,6 +117,27 @@ typedef enum
   GSE_STATUS_FIFO_SIZE_NULL           = 0x0303,
   /** There is no FIFO */
   GSE_STATUS_QOS_NBR_NULL             = 0x0304,
+  /** All the Frag ID values are used by PDUs being fragmented, try again once
+   *  a fragmented PDU is completely sent */
+  GSE_STATUS_FRAG_ID_EXHAUSTED        = 0x0305,
+  /** The operation requires the FIFOs to be empty */
+  GSE_STATUS_FIFO_NOT_EMPTY           = 0x0306,
+  /** The number of FragID values in the pool is greater than 256 */
+  GSE_STATUS_INVALID_FRAG_ID_NBR      = 0x0307,
+  /** The operation requires the FragID pool to be enabled */
+  GSE_STATUS_FRAG_ID_POOL_REQUIRED    = 0x0308,
+  /** The PDUs exceed the rate of their shapers, try again once the shapers
+   *  are refilled */
+  GSE_STATUS_RATE_LIMITED             = 0x0309,
+  /** The shaper configuration is not valid */
+  GSE_STATUS_INVALID_SHAPER           = 0x030A,
+  /** There is no shaper for the QoS value or the label */
+  GSE_STATUS_NO_SHAPER                = 0x030B,
+  /** The PDUs in the FIFO wait for data, try again once data is appended to
+   *  a PDU opened with \ref gse_encap_open_pdu */
+  GSE_STATUS_PDU_NOT_READY            = 0x030C,
+  /** The PDU was aborted or the encapsulation context released */
+  GSE_STATUS_PDU_ABORTED              = 0x030D,
 
   /* Length parameters status */
 
@@ -145,6 +175,8 @@ typedef enum
   GSE_STATUS_EXTENSION_UNAVAILABLE    = 0x509,
   /** Extensions are not valid */
   GSE_STATUS_INVALID_EXTENSIONS       = 0x50A,
+  /** The label is not known */
+  GSE_STATUS_UNKNOWN_LABEL            = 0x50B,
 
   /* Deencapsulation context error/warning status */
 
@@ -158,6 +190,13 @@ typedef enum
   GSE_STATUS_NO_SPACE_IN_BUFF         = 0x0603,
   /** The packet is to small for a GSE packet */
   GSE_STATUS_PACKET_TOO_SMALL         = 0x0604,
+  /** The sink callback returned an error, the PDU is dropped */
+  GSE_STATUS_SINK_CB_FAILED           = 0x0605,
+  /** No PDU is waiting in the CRC verification queue */
+  GSE_STATUS_NO_PDU_QUEUED            = 0x0606,
+  /** The PDU does not fit in the reassembly pool even after the eviction of
+   *  the other PDUs, the PDU is dropped */
+  GSE_STATUS_POOL_FULL                = 0x0607,
 
   /* Received PDU status */
 
@@ -181,6 +220,10 @@ typedef enum
 
   /** A PDU and useful information are returned */
   GSE_STATUS_PDU_RECEIVED             = 0x0901,
+  /** A PDU was completely given to the sink callback and committed */
+  GSE_STATUS_PDU_STREAMED             = 0x0902,
+  /** A PDU was queued for deferred CRC verification */
+  GSE_STATUS_PDU_QUEUED               = 0x0903,
 
   /* Header fields access */
 
@@ -193,7 +236,16 @@ typedef enum
    *  update the next packet in the fifo */
   GSE_STATUS_PARTIAL_CRC              = 0x0B01,
 
-  GSE_STATUS_MAX                      = 0x0C00,
+  /* BBFrame status */
+
+  /** The CRC-8 of the BBHEADER does not match its content */
+  GSE_STATUS_INVALID_BBHEADER_CRC     = 0x0C01,
+  /** The Data Field Length does not fit in the BBFrame */
+  GSE_STATUS_INVALID_DFL              = 0x0C02,
+  /** The BBFrame length is invalid */
+  GSE_STATUS_INVALID_BBFRAME_LENGTH   = 0x0C03,
+
+  GSE_STATUS_MAX                      = 0x0D00,
 } gse_status_t;
 
 /****************************************************************************
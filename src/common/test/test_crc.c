@@ -0,0 +1,275 @@
+/*
+ *
+ * This piece of software is an implementation of the Generic Stream
+ * Encapsulation (GSE) standard defined by ETSI for Linux (or other
+ * Unix-compatible OS). The library may be used to add GSE
+ * encapsulation/de-encapsulation capabilities to an application.
+ *
+ *
+ * Copyright © 2016 TAS
+ *
+ *
+ * This file is part of the GSE library.
+ *
+ *
+ * The GSE library is free software : you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY, without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see http://www.gnu.org/licenses/.
+ *
+ */
+
+/****************************************************************************/
+/**
+ *   @file          test_crc.c
+ *
+ *          Project:     GSE LIBRARY
+ *
+ *          Company:     THALES ALENIA SPACE
+ *
+ *          Module name: COMMON
+ *
+ *   @brief         CRC32 combination, parallel and multi-buffer tests
+ *
+ *   @author        Julien BERNARD / Viveris Technologies
+ *
+ */
+/****************************************************************************/
+
+/****************************************************************************
+ *
+ *   INCLUDES
+ *
+ *****************************************************************************/
+
+/* system includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+/* GSE includes */
+#include "crc.h"
+
+/****************************************************************************
+ *
+ *   MACROS AND CONSTANTS
+ *
+ *****************************************************************************/
+
+/** Length of the data */
+#define DATA_LENGTH 65535
+/** Number of fragments the data is split in */
+#define FRAG_NBR 7
+/** Number of buffers whose CRC32 are computed together */
+#define MULTI_NBR 11
+
+/* DEBUG macro */
+#define DEBUG(verbose, format, ...) \
+  do { \
+    if(verbose) \
+      printf(format, ##__VA_ARGS__); \
+  } while(0)
+
+/****************************************************************************
+ *
+ *   PROTOTYPES OF PRIVATE FUNCTIONS
+ *
+ *****************************************************************************/
+
+static int test_crc(int verbose);
+
+/****************************************************************************
+ *
+ *   PUBLIC FUNCTIONS
+ *
+ *****************************************************************************/
+
+/**
+ * @brief Main function for the GSE CRC32 test program
+ *
+ * @param argc  the number of program arguments
+ * @param argv  the program arguments
+ * @return      the unix return code:
+ *               \li 0 in case of success,
+ *               \li 1 in case of failure
+ */
+int main(int argc, char *argv[])
+{
+  int res = 1;
+  int verbose = 0;
+
+  if(argc > 2 || argc < 1)
+  {
+    printf("USAGE : test_crc [verbose]\n");
+  }
+  else
+  {
+    if(argc == 2)
+    {
+      if(!strcmp(argv[1], "verbose"))
+      {
+        verbose = 1;
+      }
+      else
+      {
+        printf("USAGE : test_crc [verbose]\n");
+        goto quit;
+      }
+    }
+    res = test_crc(verbose);
+  }
+
+quit:
+  return res;
+}
+
+/****************************************************************************
+ *
+ *   PRIVATE FUNCTIONS
+ *
+ *****************************************************************************/
+
+/**
+ * @brief Check the combined, parallel and multi-buffer CRC32 against the
+ *        serial one
+ *
+ * @param   verbose  Print debug if verbose is 1
+ * @return  0 on success, 1 on failure
+ */
+static int test_crc(int verbose)
+{
+  int is_failure = 1;
+  unsigned char *data;
+  size_t frag_offset[FRAG_NBR + 1];
+  uint32_t frag_crc[FRAG_NBR];
+  uint32_t ref_crc;
+  uint32_t crc;
+  unsigned int worker_nbr;
+  unsigned int i;
+  gse_crc_pool_t *pool;
+  gse_status_t status;
+  size_t lengths[] = { 0, 1, 3, 17, 1500, DATA_LENGTH };
+  unsigned char *multi_data[MULTI_NBR];
+  size_t multi_length[MULTI_NBR];
+  uint32_t multi_crc[MULTI_NBR];
+
+  data = malloc(DATA_LENGTH);
+  if(data == NULL)
+  {
+    DEBUG(verbose, "Cannot allocate data\n");
+    goto quit;
+  }
+  srand(42);
+  for(i = 0 ; i < DATA_LENGTH ; i++)
+  {
+    data[i] = rand() & 0xFF;
+  }
+
+  /* Shifting a CRC32 is the same as adding null bytes */
+  crc = compute_crc(data, 100, GSE_CRC_INIT);
+  memset(data + DATA_LENGTH - 50, 0, 50);
+  if(shift_crc(crc, 50) != compute_crc(data + DATA_LENGTH - 50, 50, crc))
+  {
+    DEBUG(verbose, "Shifted CRC does not match\n");
+    goto free_data;
+  }
+  for(i = DATA_LENGTH - 50 ; i < DATA_LENGTH ; i++)
+  {
+    data[i] = rand() & 0xFF;
+  }
+  ref_crc = compute_crc(data, DATA_LENGTH, GSE_CRC_INIT);
+
+  /* The fragments CRC32 are computed in reverse order then combined */
+  frag_offset[0] = 0;
+  for(i = 1 ; i < FRAG_NBR ; i++)
+  {
+    frag_offset[i] = frag_offset[i - 1] + rand() % (DATA_LENGTH / FRAG_NBR);
+  }
+  frag_offset[FRAG_NBR] = DATA_LENGTH;
+  for(i = FRAG_NBR ; i > 0 ; i--)
+  {
+    frag_crc[i - 1] = compute_crc(data + frag_offset[i - 1],
+                                  frag_offset[i] - frag_offset[i - 1],
+                                  (i == 1 ? GSE_CRC_INIT : 0));
+  }
+  crc = frag_crc[0];
+  for(i = 1 ; i < FRAG_NBR ; i++)
+  {
+    crc = combine_crc(crc, frag_crc[i], frag_offset[i + 1] - frag_offset[i]);
+  }
+  DEBUG(verbose, "Combined CRC %08x, expected %08x\n", crc, ref_crc);
+  if(crc != ref_crc)
+  {
+    DEBUG(verbose, "Combined CRC does not match\n");
+    goto free_data;
+  }
+
+  /* The parallel CRC32 matches the serial one, the threads of a pool are
+   * used for several CRC32 */
+  for(worker_nbr = 0 ; worker_nbr <= GSE_CRC_MAX_WORKER_NBR + 1 ;
+      worker_nbr++)
+  {
+    status = gse_crc_pool_init(worker_nbr, &pool);
+    if(status != GSE_STATUS_OK)
+    {
+      DEBUG(verbose, "Error %#.4x when creating the pool of %u workers "
+            "(%s)\n", status, worker_nbr, gse_get_status(status));
+      goto free_data;
+    }
+    for(i = 0 ; i < sizeof(lengths) / sizeof(lengths[0]) ; i++)
+    {
+      ref_crc = compute_crc(data, lengths[i], GSE_CRC_INIT);
+      crc = compute_crc_parallel(pool, data, lengths[i], GSE_CRC_INIT);
+      if(crc != ref_crc)
+      {
+        DEBUG(verbose, "Parallel CRC does not match for %zu bytes with "
+              "%u workers\n", lengths[i],
+              gse_crc_pool_get_worker_nbr(pool));
+        gse_crc_pool_release(pool);
+        goto free_data;
+      }
+    }
+    gse_crc_pool_release(pool);
+  }
+  if(compute_crc_parallel(NULL, data, DATA_LENGTH, GSE_CRC_INIT) !=
+     compute_crc(data, DATA_LENGTH, GSE_CRC_INIT))
+  {
+    DEBUG(verbose, "Parallel CRC without pool does not match\n");
+    goto free_data;
+  }
+
+  /* The CRC32 of several buffers computed together match the serial ones,
+   * the buffers overlap and have different lengths */
+  for(i = 0 ; i < MULTI_NBR ; i++)
+  {
+    multi_data[i] = data + i * 97;
+    multi_length[i] = (i * 7919) % (DATA_LENGTH - MULTI_NBR * 97);
+    multi_crc[i] = (i % 2 ? GSE_CRC_INIT : i);
+  }
+  compute_crc_multi(multi_data, multi_length, multi_crc, MULTI_NBR);
+  for(i = 0 ; i < MULTI_NBR ; i++)
+  {
+    if(multi_crc[i] != compute_crc(multi_data[i], multi_length[i],
+                                   (i % 2 ? GSE_CRC_INIT : i)))
+    {
+      DEBUG(verbose, "CRC of buffer %u among several does not match\n", i);
+      goto free_data;
+    }
+  }
+
+  is_failure = 0;
+
+free_data:
+  free(data);
+quit:
+  return is_failure;
+}
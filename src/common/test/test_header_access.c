@@ -62,6 +62,7 @@
 
 /* GSE includes */
 #include "header_fields.h"
+#include "header_fields_inline.h"
 #include "constants.h"
 #include "status.h"
 
@@ -327,6 +328,7 @@ static int check_header_fields(int verbose, int counter, unsigned char *in_packe
   uint16_t total_length;
   uint16_t protocol_type;
   uint8_t label[6];
+  gse_header_fields_t fields;
   gse_status_t status;
   int label_length;
   int i;
@@ -509,6 +511,45 @@ static int check_header_fields(int verbose, int counter, unsigned char *in_packe
     }
   }
 
+  /* Check the inline accessors against the reference values */
+  if(gse_hdr_start_indicator(in_packet) != s_ref[counter] ||
+     gse_hdr_end_indicator(in_packet) != e_ref[counter] ||
+     gse_hdr_label_type(in_packet) != lt_ref[counter] ||
+     gse_hdr_gse_length(in_packet) != gse_length_ref[counter] ||
+     (gse_hdr_has_frag_id(in_packet) &&
+      gse_hdr_frag_id(in_packet) != frag_id_ref[counter]) ||
+     gse_hdr_has_total_length(in_packet) != (total_length_ref[counter] != 0) ||
+     (gse_hdr_has_total_length(in_packet) &&
+      gse_hdr_total_length(in_packet) != total_length_ref[counter]) ||
+     gse_hdr_has_protocol_type(in_packet) != (protocol_type_ref[counter] != 0) ||
+     (gse_hdr_has_protocol_type(in_packet) &&
+      gse_hdr_protocol_type(in_packet) != protocol_type_ref[counter]) ||
+     gse_hdr_label_length(in_packet) != (size_t)label_length ||
+     memcmp(gse_hdr_label(in_packet), label_ref[counter],
+            gse_hdr_label_length(in_packet)))
+  {
+    DEBUG(verbose, "Bad value given by the inline accessors in packet #%u\n",
+          counter + 1);
+    goto error;
+  }
+
+  /* Check the decoding of all the fields at once */
+  if(gse_hdr_decode(in_packet, &fields) != gse_hdr_length(in_packet) ||
+     fields.start_indicator != s_ref[counter] ||
+     fields.end_indicator != e_ref[counter] ||
+     fields.label_type != lt_ref[counter] ||
+     fields.gse_length != gse_length_ref[counter] ||
+     fields.frag_id != frag_id_ref[counter] ||
+     fields.total_length != total_length_ref[counter] ||
+     fields.protocol_type != protocol_type_ref[counter] ||
+     fields.label_length != label_length ||
+     memcmp(fields.label, label_ref[counter], 6))
+  {
+    DEBUG(verbose, "Bad value given by the header decoding in packet #%u\n",
+          counter + 1);
+    goto error;
+  }
+
   return 0;
 
 error:
@@ -0,0 +1,458 @@
+/*
+ *
+ * This piece of software is an implementation of the Generic Stream
+ * Encapsulation (GSE) standard defined by ETSI for Linux (or other
+ * Unix-compatible OS). The library may be used to add GSE
+ * encapsulation/de-encapsulation capabilities to an application.
+ *
+ *
+ * Copyright © 2016 TAS
+ *
+ *
+ * This file is part of the GSE library.
+ *
+ *
+ * The GSE library is free software : you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY, without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see http://www.gnu.org/licenses/.
+ *
+ */
+
+/****************************************************************************/
+/**
+ *   @file          test_header_bulk.c
+ *
+ *          Project:     GSE LIBRARY
+ *
+ *          Company:     THALES ALENIA SPACE
+ *
+ *          Module name: COMMON
+ *
+ *   @brief         Decoding of all the headers of a frame and counters per
+ *                  label and per protocol
+ *
+ *   @author        Julien BERNARD / Viveris Technologies
+ *
+ */
+/****************************************************************************/
+
+/****************************************************************************
+ *
+ *   INCLUDES
+ *
+ *****************************************************************************/
+
+/* system includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+/* GSE includes */
+#include "header_bulk.h"
+#include "constants.h"
+
+/****************************************************************************
+ *
+ *   MACROS AND CONSTANTS
+ *
+ *****************************************************************************/
+
+/** The length of the frame */
+#define FRAME_LENGTH 512
+/** The number of packets of the frame */
+#define PACKET_NBR 7
+/** The number of packets decoded at once, below the number of packets so
+ *  that the decoding is resumed */
+#define BULK_PACKET_NBR 4
+/** The number of labels that can be counted */
+#define LABEL_NBR 8
+/** The number of protocols that can be counted */
+#define PROTOCOL_NBR 4
+/** The Frag ID of the fragmented PDU */
+#define FRAG_ID 5
+/** A Frag ID never seen in a first fragment */
+#define UNKNOWN_FRAG_ID 9
+/** The IPv4 protocol */
+#define PROTOCOL_IPV4 0x0800
+/** The IPv6 protocol */
+#define PROTOCOL_IPV6 0x86DD
+
+/* DEBUG macro */
+#define DEBUG(verbose, format, ...) \
+  do { \
+    if(verbose) \
+      printf(format, ##__VA_ARGS__); \
+  } while(0)
+
+/** The description of a GSE packet of the frame */
+typedef struct
+{
+  uint8_t s;              /**< The Start Indicator */
+  uint8_t e;              /**< The End Indicator */
+  uint8_t lt;             /**< The Label Type */
+  uint16_t protocol;      /**< The Protocol Type */
+  uint8_t label[6];       /**< The label */
+  size_t payload_length;  /**< The length of the data after the header */
+} packet_desc_t;
+
+/** The packets of the frame */
+static const packet_desc_t packets[PACKET_NBR] =
+{
+  /* complete PDU with a 6-byte label */
+  { 1, 1, GSE_LT_6_BYTES, PROTOCOL_IPV4, { 1, 1, 1, 1, 1, 1 }, 10 },
+  /* first fragment with another label */
+  { 1, 0, GSE_LT_6_BYTES, PROTOCOL_IPV6, { 2, 2, 2, 2, 2, 2 }, 20 },
+  /* complete PDU re-using the previous label */
+  { 1, 1, GSE_LT_REUSE, PROTOCOL_IPV4, { 0 }, 5 },
+  /* subsequent fragment */
+  { 0, 0, GSE_LT_REUSE, 0, { 0 }, 30 },
+  /* last fragment, with the CRC */
+  { 0, 1, GSE_LT_REUSE, 0, { 0 }, 44 },
+  /* complete PDU with a 3-byte label */
+  { 1, 1, GSE_LT_3_BYTES, PROTOCOL_IPV4, { 3, 3, 3 }, 8 },
+  /* complete PDU without label */
+  { 1, 1, GSE_LT_NO_LABEL, PROTOCOL_IPV4, { 0 }, 4 },
+};
+
+/****************************************************************************
+ *
+ *   PROTOTYPES OF PRIVATE FUNCTIONS
+ *
+ *****************************************************************************/
+
+static int test_header_bulk(int verbose);
+static size_t write_packet(unsigned char *packet, const packet_desc_t *desc,
+                           uint8_t frag_id);
+static int check_counters(int verbose, const char *name,
+                          const gse_header_counters_t *counters,
+                          uint64_t packet_nbr, uint64_t byte_nbr,
+                          uint64_t pdu_nbr, uint64_t fragment_nbr);
+
+/****************************************************************************
+ *
+ *   PUBLIC FUNCTIONS
+ *
+ *****************************************************************************/
+
+/**
+ * @brief Main function for the GSE bulk header decoding test program
+ *
+ * @param argc  the number of program arguments
+ * @param argv  the program arguments
+ * @return      the unix return code:
+ *               \li 0 in case of success,
+ *               \li 1 in case of failure
+ */
+int main(int argc, char *argv[])
+{
+  int res = 1;
+  int verbose = 0;
+
+  if(argc > 2 || argc < 1)
+  {
+    printf("USAGE : test_header_bulk [verbose]\n");
+  }
+  else
+  {
+    if(argc == 2)
+    {
+      if(!strcmp(argv[1], "verbose"))
+      {
+        verbose = 1;
+      }
+      else
+      {
+        printf("USAGE : test_header_bulk [verbose]\n");
+        goto quit;
+      }
+    }
+    res = test_header_bulk(verbose);
+  }
+
+quit:
+  return res;
+}
+
+/****************************************************************************
+ *
+ *   PRIVATE FUNCTIONS
+ *
+ *****************************************************************************/
+
+/**
+ * @brief Decode a frame in several steps and count its packets
+ *
+ * @param   verbose  Print debug if verbose is 1
+ * @return  0 on success, 1 on failure
+ */
+static int test_header_bulk(int verbose)
+{
+  int is_failure = 1;
+  unsigned char frame[FRAME_LENGTH];
+  size_t packet_length[PACKET_NBR];
+  size_t offset[PACKET_NBR];
+  gse_header_bulk_t *bulk = NULL;
+  gse_header_stats_t *stats = NULL;
+  const gse_label_counters_t *labels;
+  const gse_protocol_counters_t *protocols;
+  gse_header_counters_t label_unknown;
+  gse_header_counters_t protocol_unknown;
+  gse_status_t status;
+  size_t frame_length = 0;
+  size_t decoded_length;
+  size_t packet_nbr = 0;
+  size_t label_nbr;
+  size_t protocol_nbr;
+  size_t i;
+  size_t j;
+
+  /* The frame ends with padding */
+  memset(frame, 0, FRAME_LENGTH);
+  for(i = 0 ; i < PACKET_NBR ; i++)
+  {
+    offset[i] = frame_length;
+    packet_length[i] = write_packet(frame + frame_length, &packets[i],
+                                    FRAG_ID);
+    frame_length += packet_length[i];
+  }
+
+  status = gse_header_bulk_init(BULK_PACKET_NBR, &bulk);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when creating the arrays (%s)\n",
+          status, gse_get_status(status));
+    goto quit;
+  }
+  status = gse_header_stats_init(LABEL_NBR, PROTOCOL_NBR, &stats);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when creating the counters (%s)\n",
+          status, gse_get_status(status));
+    goto release_bulk;
+  }
+
+  /* The decoding goes on from the decoded length while the arrays fill up */
+  decoded_length = 0;
+  do
+  {
+    size_t length;
+
+    status = gse_header_bulk_decode(bulk, frame + decoded_length,
+                                    FRAME_LENGTH - decoded_length, &length);
+    if(status != GSE_STATUS_OK)
+    {
+      DEBUG(verbose, "Error %#.4x when decoding the frame (%s)\n",
+            status, gse_get_status(status));
+      goto release_stats;
+    }
+    for(j = 0 ; j < bulk->packet_nbr ; j++)
+    {
+      const packet_desc_t *desc = &packets[packet_nbr + j];
+
+      if(decoded_length + bulk->offset[j] != offset[packet_nbr + j] ||
+         bulk->packet_length[j] != packet_length[packet_nbr + j] ||
+         bulk->start_indicator[j] != desc->s ||
+         bulk->end_indicator[j] != desc->e ||
+         bulk->label_type[j] != desc->lt ||
+         bulk->protocol_type[j] != desc->protocol ||
+         memcmp(bulk->label + j * 6, desc->label, 6) != 0 ||
+         bulk->frag_id[j] != ((desc->s && desc->e) ? 0 : FRAG_ID) ||
+         bulk->total_length[j] != ((desc->s && !desc->e) ? 100 : 0))
+      {
+        DEBUG(verbose, "Bad header for packet #%zu\n", packet_nbr + j + 1);
+        goto release_stats;
+      }
+    }
+    status = gse_header_stats_update(stats, bulk);
+    if(status != GSE_STATUS_OK)
+    {
+      DEBUG(verbose, "Error %#.4x when counting the packets (%s)\n",
+            status, gse_get_status(status));
+      goto release_stats;
+    }
+    packet_nbr += bulk->packet_nbr;
+    decoded_length += length;
+  }
+  while(bulk->packet_nbr == BULK_PACKET_NBR);
+  if(packet_nbr != PACKET_NBR || decoded_length != frame_length)
+  {
+    DEBUG(verbose, "%zu packets decoded on %zu bytes instead of %u on %zu "
+          "bytes\n", packet_nbr, decoded_length, PACKET_NBR, frame_length);
+    goto release_stats;
+  }
+
+  /* A subsequent fragment whose first fragment was not seen */
+  write_packet(frame, &packets[3], UNKNOWN_FRAG_ID);
+  status = gse_header_bulk_decode(bulk, frame, packet_length[3],
+                                  &decoded_length);
+  if(status != GSE_STATUS_OK || bulk->packet_nbr != 1 ||
+     gse_header_stats_update(stats, bulk) != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error when counting the unknown fragment\n");
+    goto release_stats;
+  }
+
+  /* A packet longer than the data is refused */
+  status = gse_header_bulk_decode(bulk, frame, packet_length[3] - 1,
+                                  &decoded_length);
+  if(status != GSE_STATUS_INVALID_GSE_LENGTH || bulk->packet_nbr != 0 ||
+     decoded_length != 0)
+  {
+    DEBUG(verbose, "Truncated packet not detected\n");
+    goto release_stats;
+  }
+
+  /* The fragmented PDU is counted with the label and the protocol of its
+   * first fragment, the re-used label with the previous one */
+  if(gse_header_stats_get_labels(stats, &labels, &label_nbr) !=
+     GSE_STATUS_OK ||
+     gse_header_stats_get_protocols(stats, &protocols, &protocol_nbr) !=
+     GSE_STATUS_OK ||
+     gse_header_stats_get_unknown(stats, &label_unknown,
+                                  &protocol_unknown) != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error when getting the counters\n");
+    goto release_stats;
+  }
+  if(label_nbr != 4 || protocol_nbr != 2)
+  {
+    DEBUG(verbose, "%zu labels and %zu protocols instead of 4 and 2\n",
+          label_nbr, protocol_nbr);
+    goto release_stats;
+  }
+  if(labels[0].label_type != GSE_LT_6_BYTES ||
+     memcmp(labels[0].label, packets[0].label, 6) != 0 ||
+     memcmp(labels[1].label, packets[1].label, 6) != 0 ||
+     labels[2].label_type != GSE_LT_3_BYTES ||
+     labels[3].label_type != GSE_LT_NO_LABEL ||
+     protocols[0].protocol_type != PROTOCOL_IPV4 ||
+     protocols[1].protocol_type != PROTOCOL_IPV6)
+  {
+    DEBUG(verbose, "Bad labels or protocols\n");
+    goto release_stats;
+  }
+  if(check_counters(verbose, "label 1", &labels[0].counters,
+                    1, packet_length[0], 1, 0) ||
+     check_counters(verbose, "label 2", &labels[1].counters,
+                    4, packet_length[1] + packet_length[2] +
+                    packet_length[3] + packet_length[4], 2, 3) ||
+     check_counters(verbose, "label 3", &labels[2].counters,
+                    1, packet_length[5], 1, 0) ||
+     check_counters(verbose, "no label", &labels[3].counters,
+                    1, packet_length[6], 1, 0) ||
+     check_counters(verbose, "IPv4", &protocols[0].counters,
+                    4, packet_length[0] + packet_length[2] +
+                    packet_length[5] + packet_length[6], 4, 0) ||
+     check_counters(verbose, "IPv6", &protocols[1].counters,
+                    3, packet_length[1] + packet_length[3] +
+                    packet_length[4], 1, 3) ||
+     check_counters(verbose, "unknown label", &label_unknown,
+                    1, packet_length[3], 0, 1) ||
+     check_counters(verbose, "unknown protocol", &protocol_unknown,
+                    1, packet_length[3], 0, 1))
+  {
+    goto release_stats;
+  }
+
+  /* Nothing is left after a reset */
+  if(gse_header_stats_reset(stats) != GSE_STATUS_OK ||
+     gse_header_stats_get_labels(stats, &labels, &label_nbr) !=
+     GSE_STATUS_OK || label_nbr != 0)
+  {
+    DEBUG(verbose, "Counters not reset\n");
+    goto release_stats;
+  }
+  DEBUG(verbose, "%u packets decoded and counted\n", PACKET_NBR);
+
+  is_failure = 0;
+
+release_stats:
+  gse_header_stats_release(stats);
+release_bulk:
+  gse_header_bulk_release(bulk);
+quit:
+  return is_failure;
+}
+
+/**
+ * @brief Write a GSE packet, the first fragments carry a Total Length of 100
+ *
+ * @param   packet   The buffer of the packet
+ * @param   desc     The description of the packet
+ * @param   frag_id  The Frag ID of the fragments
+ * @return  The length of the packet
+ */
+static size_t write_packet(unsigned char *packet, const packet_desc_t *desc,
+                           uint8_t frag_id)
+{
+  size_t length = 2;
+  uint16_t gse_length;
+  int label_length = 0;
+
+  if(!desc->s || !desc->e)
+  {
+    packet[length++] = frag_id;
+  }
+  if(desc->s)
+  {
+    if(!desc->e)
+    {
+      packet[length++] = 0;
+      packet[length++] = 100;
+    }
+    packet[length++] = desc->protocol >> 8;
+    packet[length++] = desc->protocol & 0xFF;
+    label_length = gse_get_label_length(desc->lt);
+    memcpy(packet + length, desc->label, label_length);
+    length += label_length;
+  }
+  memset(packet + length, 0xAA, desc->payload_length);
+  length += desc->payload_length;
+
+  gse_length = length - 2;
+  packet[0] = (desc->s << 7) | (desc->e << 6) | (desc->lt << 4) |
+              ((gse_length >> 8) & 0x0F);
+  packet[1] = gse_length & 0xFF;
+  return length;
+}
+
+/**
+ * @brief Check a set of counters
+ *
+ * @param   verbose       Print debug if verbose is 1
+ * @param   name          The name of the counters
+ * @param   counters      The counters
+ * @param   packet_nbr    The expected number of packets
+ * @param   byte_nbr      The expected number of bytes
+ * @param   pdu_nbr       The expected number of PDUs
+ * @param   fragment_nbr  The expected number of fragments
+ * @return  0 on success, 1 on failure
+ */
+static int check_counters(int verbose, const char *name,
+                          const gse_header_counters_t *counters,
+                          uint64_t packet_nbr, uint64_t byte_nbr,
+                          uint64_t pdu_nbr, uint64_t fragment_nbr)
+{
+  if(counters->packet_nbr != packet_nbr || counters->byte_nbr != byte_nbr ||
+     counters->pdu_nbr != pdu_nbr || counters->fragment_nbr != fragment_nbr)
+  {
+    DEBUG(verbose, "Bad counters for %s: %llu packets, %llu bytes, %llu PDUs, "
+          "%llu fragments\n", name,
+          (unsigned long long)counters->packet_nbr,
+          (unsigned long long)counters->byte_nbr,
+          (unsigned long long)counters->pdu_nbr,
+          (unsigned long long)counters->fragment_nbr);
+    return 1;
+  }
+  return 0;
+}
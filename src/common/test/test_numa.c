@@ -0,0 +1,248 @@
+/*
+ *
+ * This piece of software is an implementation of the Generic Stream
+ * Encapsulation (GSE) standard defined by ETSI for Linux (or other
+ * Unix-compatible OS). The library may be used to add GSE
+ * encapsulation/de-encapsulation capabilities to an application.
+ *
+ *
+ * Copyright © 2016 TAS
+ *
+ *
+ * This file is part of the GSE library.
+ *
+ *
+ * The GSE library is free software : you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY, without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see http://www.gnu.org/licenses/.
+ *
+ */
+
+/****************************************************************************/
+/**
+ *   @file          test_numa.c
+ *
+ *          Project:     GSE LIBRARY
+ *
+ *          Company:     THALES ALENIA SPACE
+ *
+ *          Module name: COMMON
+ *
+ *   @brief         Placement of a thread and of a pool on a NUMA node
+ *
+ *   @author        Julien BERNARD / Viveris Technologies
+ *
+ */
+/****************************************************************************/
+
+/****************************************************************************
+ *
+ *   INCLUDES
+ *
+ *****************************************************************************/
+
+/* system includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* GSE includes */
+#include "numa.h"
+#include "virtual_fragment.h"
+
+/****************************************************************************
+ *
+ *   MACROS AND CONSTANTS
+ *
+ *****************************************************************************/
+
+/** The NUMA node everything is placed on, it always exists */
+#define NODE 0
+/** The length of the buffers of the pool */
+#define BUFFER_LENGTH 4096
+/** The number of virtual fragments created from the pool */
+#define VFRAG_NBR 16
+
+/* DEBUG macro */
+#define DEBUG(verbose, format, ...) \
+  do { \
+    if(verbose) \
+      printf(format, ##__VA_ARGS__); \
+  } while(0)
+
+/****************************************************************************
+ *
+ *   PROTOTYPES OF PRIVATE FUNCTIONS
+ *
+ *****************************************************************************/
+
+static int test_numa(int verbose);
+
+/****************************************************************************
+ *
+ *   PUBLIC FUNCTIONS
+ *
+ *****************************************************************************/
+
+/**
+ * @brief Main function for the GSE NUMA placement test program
+ *
+ * @param argc  the number of program arguments
+ * @param argv  the program arguments
+ * @return      the unix return code:
+ *               \li 0 in case of success,
+ *               \li 1 in case of failure
+ */
+int main(int argc, char *argv[])
+{
+  int res = 1;
+  int verbose = 0;
+
+  if(argc > 2 || argc < 1)
+  {
+    printf("USAGE : test_numa [verbose]\n");
+  }
+  else
+  {
+    if(argc == 2)
+    {
+      if(!strcmp(argv[1], "verbose"))
+      {
+        verbose = 1;
+      }
+      else
+      {
+        printf("USAGE : test_numa [verbose]\n");
+        goto quit;
+      }
+    }
+    res = test_numa(verbose);
+  }
+
+quit:
+  return res;
+}
+
+/****************************************************************************
+ *
+ *   PRIVATE FUNCTIONS
+ *
+ *****************************************************************************/
+
+/**
+ * @brief Bind the thread and a pool to a node and check the placement
+ *
+ * @param   verbose  Print debug if verbose is 1
+ * @return  0 on success, 1 on failure
+ */
+static int test_numa(int verbose)
+{
+  int is_failure = 1;
+  gse_vfrag_pool_t *pool = NULL;
+  gse_vfrag_t *vfrags[VFRAG_NBR] = { NULL };
+  gse_status_t status;
+  int node;
+  unsigned int i;
+
+  /* The kernel may not be built with NUMA support */
+  if(gse_numa_check_node(NODE) != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "No NUMA node, test skipped\n");
+    is_failure = 0;
+    goto quit;
+  }
+  if(gse_numa_check_node(GSE_NUMA_MAX_NODE_NBR) != GSE_STATUS_NUMA_FAILED ||
+     gse_numa_check_node(GSE_NUMA_NO_NODE) != GSE_STATUS_NUMA_FAILED)
+  {
+    DEBUG(verbose, "Wrong node not detected\n");
+    goto quit;
+  }
+
+  status = gse_numa_bind_thread(NODE);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when binding the thread (%s)\n",
+          status, gse_get_status(status));
+    goto quit;
+  }
+  status = gse_numa_get_current_node(&node);
+  if(status != GSE_STATUS_OK || node != NODE)
+  {
+    DEBUG(verbose, "Thread running on node %d instead of %d (status "
+          "%#.4x)\n", node, NODE, status);
+    goto unbind;
+  }
+
+  status = gse_vfrag_pool_init(BUFFER_LENGTH, &pool);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when creating the pool (%s)\n",
+          status, gse_get_status(status));
+    goto unbind;
+  }
+  status = gse_vfrag_pool_set_node(pool, GSE_NUMA_MAX_NODE_NBR);
+  if(status != GSE_STATUS_NUMA_FAILED)
+  {
+    DEBUG(verbose, "Wrong pool node not detected (status %#.4x)\n", status);
+    goto release_pool;
+  }
+  status = gse_vfrag_pool_set_node(pool, NODE);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when placing the pool (%s)\n",
+          status, gse_get_status(status));
+    goto release_pool;
+  }
+
+  for(i = 0 ; i < VFRAG_NBR ; i++)
+  {
+    status = gse_create_vfrag_from_pool(&vfrags[i], pool, BUFFER_LENGTH, 0,
+                                        0);
+    if(status != GSE_STATUS_OK)
+    {
+      DEBUG(verbose, "Error %#.4x when creating virtual fragment (%s)\n",
+            status, gse_get_status(status));
+      goto free_vfrags;
+    }
+    memset(gse_get_vfrag_start(vfrags[i]), i, BUFFER_LENGTH);
+    status = gse_numa_get_memory_node(gse_get_vfrag_start(vfrags[i]), &node);
+    if(status != GSE_STATUS_OK || node != NODE)
+    {
+      DEBUG(verbose, "Buffer %u on node %d instead of %d (status %#.4x)\n",
+            i, node, NODE, status);
+      goto free_vfrags;
+    }
+  }
+
+  is_failure = 0;
+
+free_vfrags:
+  for(i = 0 ; i < VFRAG_NBR ; i++)
+  {
+    if(vfrags[i] != NULL)
+    {
+      gse_free_vfrag(&vfrags[i]);
+    }
+  }
+release_pool:
+  gse_vfrag_pool_release(pool);
+unbind:
+  status = gse_numa_bind_thread(GSE_NUMA_NO_NODE);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when unbinding the thread (%s)\n",
+          status, gse_get_status(status));
+    is_failure = 1;
+  }
+quit:
+  return is_failure;
+}
@@ -0,0 +1,424 @@
+/*
+ *
+ * This piece of software is an implementation of the Generic Stream
+ * Encapsulation (GSE) standard defined by ETSI for Linux (or other
+ * Unix-compatible OS). The library may be used to add GSE
+ * encapsulation/de-encapsulation capabilities to an application.
+ *
+ *
+ * Copyright © 2016 TAS
+ *
+ *
+ * This file is part of the GSE library.
+ *
+ *
+ * The GSE library is free software : you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY, without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see http://www.gnu.org/licenses/.
+ *
+ */
+
+/****************************************************************************/
+/**
+ *   @file          test_vfrag_pool.c
+ *
+ *          Project:     GSE LIBRARY
+ *
+ *          Company:     THALES ALENIA SPACE
+ *
+ *          Module name: COMMON
+ *
+ *   @brief         Virtual fragments created from a pool and freed by
+ *                  another thread
+ *
+ *   @author        Julien BERNARD / Viveris Technologies
+ *
+ */
+/****************************************************************************/
+
+/****************************************************************************
+ *
+ *   INCLUDES
+ *
+ *****************************************************************************/
+
+/* system includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+/* GSE includes */
+#include "virtual_fragment.h"
+
+/****************************************************************************
+ *
+ *   MACROS AND CONSTANTS
+ *
+ *****************************************************************************/
+
+/** The length of the buffers of the pool */
+#define BUFFER_LENGTH 2048
+/** The number of virtual fragments in use at the same time */
+#define VFRAG_NBR 64
+/** The number of times the virtual fragments are created and freed */
+#define ROUND_NBR 8
+/** The header offset of the virtual fragments */
+#define HEAD_OFFSET 12
+/** The trailer offset of the virtual fragments */
+#define TRAIL_OFFSET 4
+
+/* DEBUG macro */
+#define DEBUG(verbose, format, ...) \
+  do { \
+    if(verbose) \
+      printf(format, ##__VA_ARGS__); \
+  } while(0)
+
+/****************************************************************************
+ *
+ *   PROTOTYPES OF PRIVATE FUNCTIONS
+ *
+ *****************************************************************************/
+
+static int test_local(int verbose, int is_hugepage);
+static int test_remote(int verbose, int is_hugepage);
+static gse_status_t init_pool(gse_vfrag_pool_t **pool, int is_hugepage);
+static void *free_vfrags(void *arg);
+
+/****************************************************************************
+ *
+ *   PUBLIC FUNCTIONS
+ *
+ *****************************************************************************/
+
+/**
+ * @brief Main function for the GSE virtual fragment pool test program
+ *
+ * @param argc  the number of program arguments
+ * @param argv  the program arguments
+ * @return      the unix return code:
+ *               \li 0 in case of success,
+ *               \li 1 in case of failure
+ */
+int main(int argc, char *argv[])
+{
+  int res = 1;
+  int verbose = 0;
+
+  if(argc > 2 || argc < 1)
+  {
+    printf("USAGE : test_vfrag_pool [verbose]\n");
+  }
+  else
+  {
+    if(argc == 2)
+    {
+      if(!strcmp(argv[1], "verbose"))
+      {
+        verbose = 1;
+      }
+      else
+      {
+        printf("USAGE : test_vfrag_pool [verbose]\n");
+        goto quit;
+      }
+    }
+    res = test_local(verbose, 0) || test_remote(verbose, 0) ||
+          test_local(verbose, 1) || test_remote(verbose, 1);
+  }
+
+quit:
+  return res;
+}
+
+/****************************************************************************
+ *
+ *   PRIVATE FUNCTIONS
+ *
+ *****************************************************************************/
+
+/**
+ * @brief Create and free virtual fragments of a pool in its owner thread
+ *
+ * @param   verbose      Print debug if verbose is 1
+ * @param   is_hugepage  Whether the buffers are carved from hugepages
+ * @return  0 on success, 1 on failure
+ */
+static int test_local(int verbose, int is_hugepage)
+{
+  int is_failure = 1;
+  gse_vfrag_pool_t *pool = NULL;
+  gse_vfrag_t *vfrags[VFRAG_NBR] = { NULL };
+  gse_vfrag_t *dup = NULL;
+  gse_status_t status;
+  unsigned int buffer_nbr;
+  unsigned int free_nbr;
+  unsigned int round;
+  unsigned int i;
+
+  status = init_pool(&pool, is_hugepage);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when creating the pool (%s)\n",
+          status, gse_get_status(status));
+    goto quit;
+  }
+
+  status = gse_create_vfrag_from_pool(&vfrags[0], pool, BUFFER_LENGTH,
+                                      HEAD_OFFSET, TRAIL_OFFSET);
+  if(status != GSE_STATUS_DATA_TOO_LONG)
+  {
+    DEBUG(verbose, "Too long virtual fragment not detected (status "
+          "%#.4x)\n", status);
+    goto free_vfrags;
+  }
+
+  /* The buffers are reused from one round to the other */
+  for(round = 0 ; round < ROUND_NBR ; round++)
+  {
+    for(i = 0 ; i < VFRAG_NBR ; i++)
+    {
+      status = gse_create_vfrag_from_pool(&vfrags[i], pool,
+                                          BUFFER_LENGTH - HEAD_OFFSET -
+                                          TRAIL_OFFSET, HEAD_OFFSET,
+                                          TRAIL_OFFSET);
+      if(status != GSE_STATUS_OK)
+      {
+        DEBUG(verbose, "Error %#.4x when creating virtual fragment (%s)\n",
+              status, gse_get_status(status));
+        goto free_vfrags;
+      }
+      if(gse_get_vfrag_available_head(vfrags[i]) != HEAD_OFFSET ||
+         gse_get_vfrag_available_trail(vfrags[i]) != TRAIL_OFFSET)
+      {
+        DEBUG(verbose, "Wrong offsets for virtual fragment %u\n", i);
+        goto free_vfrags;
+      }
+      memset(gse_get_vfrag_start(vfrags[i]), i,
+             gse_get_vfrag_length(vfrags[i]));
+    }
+    for(i = 0 ; i < VFRAG_NBR ; i++)
+    {
+      status = gse_free_vfrag(&vfrags[i]);
+      if(status != GSE_STATUS_OK)
+      {
+        DEBUG(verbose, "Error %#.4x when freeing virtual fragment (%s)\n",
+              status, gse_get_status(status));
+        goto free_vfrags;
+      }
+    }
+  }
+  gse_vfrag_pool_get_usage(pool, &buffer_nbr, &free_nbr);
+  if(buffer_nbr != VFRAG_NBR || free_nbr != VFRAG_NBR)
+  {
+    DEBUG(verbose, "%u buffers allocated, %u free instead of %u\n",
+          buffer_nbr, free_nbr, VFRAG_NBR);
+    goto free_vfrags;
+  }
+
+  /* A duplicated buffer is given back with its last fragment */
+  status = gse_create_vfrag_from_pool(&vfrags[0], pool, 100, HEAD_OFFSET,
+                                      TRAIL_OFFSET);
+  if(status == GSE_STATUS_OK)
+  {
+    status = gse_duplicate_vfrag(&dup, vfrags[0], 50);
+  }
+  if(status == GSE_STATUS_OK)
+  {
+    status = gse_free_vfrag(&vfrags[0]);
+  }
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x with duplicated virtual fragment (%s)\n",
+          status, gse_get_status(status));
+    goto free_vfrags;
+  }
+  gse_vfrag_pool_get_usage(pool, &buffer_nbr, &free_nbr);
+  if(free_nbr != VFRAG_NBR - 1)
+  {
+    DEBUG(verbose, "Buffer given back before its last fragment\n");
+    goto free_vfrags;
+  }
+  gse_free_vfrag(&dup);
+
+  /* A reallocated buffer keeps its place in the pool */
+  status = gse_create_vfrag_from_pool(&vfrags[0], pool, 100, HEAD_OFFSET,
+                                      TRAIL_OFFSET);
+  if(status == GSE_STATUS_OK)
+  {
+    status = gse_reallocate_vfrag(vfrags[0], HEAD_OFFSET, 2 * BUFFER_LENGTH,
+                                  HEAD_OFFSET, TRAIL_OFFSET);
+  }
+  if(status == GSE_STATUS_OK)
+  {
+    status = gse_free_vfrag(&vfrags[0]);
+  }
+  gse_vfrag_pool_get_usage(pool, &buffer_nbr, &free_nbr);
+  if(status != GSE_STATUS_OK || buffer_nbr != VFRAG_NBR ||
+     free_nbr != VFRAG_NBR)
+  {
+    DEBUG(verbose, "Error %#.4x with reallocated virtual fragment (%s)\n",
+          status, gse_get_status(status));
+    goto free_vfrags;
+  }
+
+  is_failure = 0;
+
+free_vfrags:
+  for(i = 0 ; i < VFRAG_NBR ; i++)
+  {
+    if(vfrags[i] != NULL)
+    {
+      gse_free_vfrag(&vfrags[i]);
+    }
+  }
+  if(dup != NULL)
+  {
+    gse_free_vfrag(&dup);
+  }
+  gse_vfrag_pool_release(pool);
+quit:
+  return is_failure;
+}
+
+/**
+ * @brief Create virtual fragments of a pool and free them in another thread
+ *
+ * @param   verbose      Print debug if verbose is 1
+ * @param   is_hugepage  Whether the buffers are carved from hugepages
+ * @return  0 on success, 1 on failure
+ */
+static int test_remote(int verbose, int is_hugepage)
+{
+  int is_failure = 1;
+  gse_vfrag_pool_t *pool = NULL;
+  gse_vfrag_t *vfrags[VFRAG_NBR] = { NULL };
+  gse_status_t status;
+  pthread_t thread;
+  unsigned int buffer_nbr;
+  unsigned int free_nbr;
+  unsigned int round;
+  unsigned int i;
+
+  status = init_pool(&pool, is_hugepage);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when creating the pool (%s)\n",
+          status, gse_get_status(status));
+    goto quit;
+  }
+
+  for(round = 0 ; round < ROUND_NBR ; round++)
+  {
+    for(i = 0 ; i < VFRAG_NBR ; i++)
+    {
+      status = gse_create_vfrag_from_pool(&vfrags[i], pool, 1000,
+                                          HEAD_OFFSET, TRAIL_OFFSET);
+      if(status != GSE_STATUS_OK)
+      {
+        DEBUG(verbose, "Error %#.4x when creating virtual fragment (%s)\n",
+              status, gse_get_status(status));
+        goto free_vfrags;
+      }
+    }
+    if(pthread_create(&thread, NULL, free_vfrags, vfrags) != 0)
+    {
+      DEBUG(verbose, "Cannot create the thread\n");
+      goto free_vfrags;
+    }
+    pthread_join(thread, NULL);
+
+    /* The buffers are on the return queue, not on the free list */
+    gse_vfrag_pool_get_usage(pool, &buffer_nbr, &free_nbr);
+    DEBUG(verbose, "Round %u: %u buffers allocated, %u free\n", round,
+          buffer_nbr, free_nbr);
+    if(buffer_nbr != VFRAG_NBR || free_nbr != 0)
+    {
+      DEBUG(verbose, "Buffers not returned to the pool\n");
+      goto free_vfrags;
+    }
+  }
+
+  /* The buffers still in use when the pool is released are freed by the
+   * other thread */
+  for(i = 0 ; i < VFRAG_NBR ; i++)
+  {
+    status = gse_create_vfrag_from_pool(&vfrags[i], pool, 1000,
+                                        HEAD_OFFSET, TRAIL_OFFSET);
+    if(status != GSE_STATUS_OK)
+    {
+      DEBUG(verbose, "Error %#.4x when creating virtual fragment (%s)\n",
+            status, gse_get_status(status));
+      goto free_vfrags;
+    }
+  }
+  gse_vfrag_pool_release(pool);
+  pool = NULL;
+  if(pthread_create(&thread, NULL, free_vfrags, vfrags) != 0)
+  {
+    DEBUG(verbose, "Cannot create the thread\n");
+    goto free_vfrags;
+  }
+  pthread_join(thread, NULL);
+
+  is_failure = 0;
+
+free_vfrags:
+  for(i = 0 ; i < VFRAG_NBR ; i++)
+  {
+    if(vfrags[i] != NULL)
+    {
+      gse_free_vfrag(&vfrags[i]);
+    }
+  }
+  if(pool != NULL)
+  {
+    gse_vfrag_pool_release(pool);
+  }
+quit:
+  return is_failure;
+}
+
+/**
+ * @brief Free the virtual fragments, run in another thread
+ *
+ * @param   arg  The table of virtual fragments
+ * @return  NULL
+ */
+static void *free_vfrags(void *arg)
+{
+  gse_vfrag_t **vfrags = arg;
+  unsigned int i;
+
+  for(i = 0 ; i < VFRAG_NBR ; i++)
+  {
+    gse_free_vfrag(&vfrags[i]);
+  }
+  return NULL;
+}
+
+/**
+ * @brief Create a pool of buffers
+ *
+ * @param   pool         OUT: The pool
+ * @param   is_hugepage  Whether the buffers are carved from hugepages
+ * @return  The status of the pool creation
+ */
+static gse_status_t init_pool(gse_vfrag_pool_t **pool, int is_hugepage)
+{
+  if(is_hugepage)
+  {
+    return gse_vfrag_pool_init_hugepage(BUFFER_LENGTH, pool);
+  }
+  return gse_vfrag_pool_init(BUFFER_LENGTH, pool);
+}
@@ -49,7 +49,75 @@
 #include "virtual_fragment.h"
 
 #include <stdlib.h>
+#include <stdint.h>
 #include <assert.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include "numa.h"
+#include "cache.h"
+
+
+/** Get the maximum between two values */
+#define MAX(x, y)  (((x) > (y)) ? (x) : (y))
+
+/** The length of the chunks the buffers of a hugepage pool are carved
+ *  from */
+#define GSE_VFRAG_POOL_HUGEPAGE_SIZE (2 * 1024 * 1024)
+
+
+/****************************************************************************
+ *
+ *   STRUCTURES AND TYPES
+ *
+ ****************************************************************************/
+
+/** Buffer of a pool, its data are allocated right after it */
+typedef struct gse_vfrag_pool_item_s
+{
+  gse_vbuf_t vbuf;        /**< The virtual buffer, shall be the first field
+                               so that the item is found from it */
+  gse_vfrag_t vfrag;      /**< The first virtual fragment of the buffer */
+  unsigned char *data;    /**< The data of the buffer */
+  struct gse_vfrag_pool_item_s *next; /**< The next free buffer */
+  int is_carved;          /**< Whether the buffer is carved from a chunk */
+} gse_vfrag_pool_item_t;
+
+/** Chunk of a pool, followed by the buffers carved from it */
+typedef struct gse_vfrag_pool_chunk_s
+{
+  struct gse_vfrag_pool_chunk_s *next; /**< The previous chunk of the pool */
+  size_t length;                       /**< The length of the chunk */
+} gse_vfrag_pool_chunk_t;
+
+/** Pool of virtual buffers */
+struct gse_vfrag_pool_s
+{
+  size_t buffer_length;   /**< The length of the buffers */
+  pthread_t owner;        /**< The thread allocating the buffers */
+  gse_vfrag_pool_item_t *free_items;     /**< The free buffers, only used by
+                                              the owner */
+  gse_vfrag_pool_item_t *returned_items; /**< The buffers freed by the other
+                                              threads, pushed atomically and
+                                              drained at once by the owner */
+  unsigned int buffer_nbr; /**< The number of buffers allocated */
+  unsigned int ref_nbr;   /**< The number of buffers in use, plus 1 until
+                               the pool is released (atomic) */
+  int is_released;        /**< Whether the pool is released by its owner */
+  int is_hugepage;        /**< Whether the buffers are carved from
+                               hugepages */
+  int node;               /**< The NUMA node of the buffers, they are carved
+                               from chunks bound to it if it is set */
+  size_t slot_length;     /**< The length of a buffer slot in a chunk */
+  size_t chunk_length;    /**< The length of the chunks */
+  gse_vfrag_pool_chunk_t *chunks; /**< The chunks mapped by the pool */
+  unsigned char *chunk_next;      /**< The next slot of the last chunk */
+  size_t chunk_left;              /**< The length left in the last chunk */
+};
+
+/** The number of virtual buffers moved in a new allocation by
+ *  \ref gse_reallocate_vfrag (atomic) */
+static unsigned long gse_vfrag_realloc_nbr = 0;
 
 
 /****************************************************************************
@@ -96,6 +164,53 @@ static gse_status_t gse_create_vbuf(gse_vbuf_t **vbuf, size_t length);
  */
 static gse_status_t gse_free_vbuf(gse_vbuf_t *vbuf);
 
+/**
+ *  @brief   Give a buffer back to its pool
+ *
+ *  The buffer is put on the free list if the caller is the owner of the
+ *  pool, on the return queue otherwise.
+ *
+ *  @param   item  The buffer
+ */
+static void gse_vfrag_pool_put(gse_vfrag_pool_item_t *item);
+
+/**
+ *  @brief   Free a released pool and the buffers left on its return queue
+ *
+ *  @param   pool  The pool
+ */
+static void gse_vfrag_pool_destroy(gse_vfrag_pool_t *pool);
+
+/**
+ *  @brief   Allocate a buffer of a pool
+ *
+ *  @param   pool  The pool
+ *
+ *  @return        The buffer on success, NULL on failure
+ */
+static gse_vfrag_pool_item_t *gse_vfrag_pool_alloc(gse_vfrag_pool_t *pool);
+
+/**
+ *  @brief   Map a chunk of a pool
+ *
+ *  The chunk is aligned on a hugepage and bound to the NUMA node of the
+ *  pool.
+ *
+ *  @param   pool  The pool
+ *
+ *  @return        The chunk on success, NULL on failure
+ */
+static void *gse_vfrag_pool_map_chunk(gse_vfrag_pool_t *pool);
+
+/**
+ *  @brief   Free a list of buffers
+ *
+ *  The buffers carved from chunks are freed with their chunks.
+ *
+ *  @param   item  The first buffer of the list
+ */
+static void gse_vfrag_pool_free_items(gse_vfrag_pool_item_t *item);
+
 /****************************************************************************
  *
  *   PUBLIC FUNCTIONS
@@ -260,6 +375,9 @@ gse_status_t gse_create_vfrag_from_buf(gse_vfrag_t **vfrag, unsigned char *buffe
   vbuf->length = head_offset + data_length + trail_offset;
   vbuf->end = vbuf->start + vbuf->length;
   vbuf->vfrag_count = 0;
+  vbuf->pool = NULL;
+  vbuf->release = NULL;
+  vbuf->opaque = NULL;
 
   *vfrag = malloc(sizeof(gse_vfrag_t));
   if(*vfrag == NULL)
@@ -297,6 +415,35 @@ error:
   return status;
 }
 
+gse_status_t gse_create_vfrag_from_ext_buf(gse_vfrag_t **vfrag,
+                                           unsigned char *buffer,
+                                           size_t head_offset,
+                                           size_t trail_offset,
+                                           size_t data_length,
+                                           gse_vbuf_release_cb_t release,
+                                           void *opaque)
+{
+  gse_status_t status;
+
+  if(release == NULL)
+  {
+    status = GSE_STATUS_NULL_PTR;
+    goto error;
+  }
+
+  status = gse_create_vfrag_from_buf(vfrag, buffer, head_offset, trail_offset,
+                                     data_length);
+  if(status != GSE_STATUS_OK)
+  {
+    goto error;
+  }
+  (*vfrag)->vbuf->release = release;
+  (*vfrag)->vbuf->opaque = opaque;
+
+error:
+  return status;
+}
+
 gse_status_t gse_allocate_vfrag(gse_vfrag_t **vfrag, int alloc_vbuf)
 {
   int status = GSE_STATUS_OK;
@@ -318,6 +465,9 @@ gse_status_t gse_allocate_vfrag(gse_vfrag_t **vfrag, int alloc_vbuf)
     }
 
     vbuf->vfrag_count = 0;
+    vbuf->pool = NULL;
+    vbuf->release = NULL;
+    vbuf->opaque = NULL;
   }
   
   *vfrag = malloc(sizeof(gse_vfrag_t));
@@ -388,6 +538,8 @@ error:
 gse_status_t gse_free_vfrag(gse_vfrag_t **vfrag)
 {
   gse_status_t status;
+  gse_vbuf_t *vbuf;
+  int is_pool_vfrag;
 
   if(vfrag == NULL || *vfrag == NULL)
   {
@@ -401,11 +553,17 @@ gse_status_t gse_free_vfrag(gse_vfrag_t **vfrag)
     goto error;
   }
 
-  (*vfrag)->vbuf->vfrag_count--;
+  /* The first virtual fragment of a pooled buffer is stored with it, the
+   * buffer may be reused as soon as it is given back */
+  vbuf = (*vfrag)->vbuf;
+  is_pool_vfrag = (vbuf->pool != NULL &&
+                   *vfrag == &(((gse_vfrag_pool_item_t *)vbuf)->vfrag));
+
+  vbuf->vfrag_count--;
 
-  if(gse_get_vfrag_nbr(*vfrag) == 0)
+  if(vbuf->vfrag_count == 0)
   {
-    status = gse_free_vbuf((*vfrag)->vbuf);
+    status = gse_free_vbuf(vbuf);
     if(status != GSE_STATUS_OK)
     {
       goto free_vfrag;
@@ -415,7 +573,10 @@ gse_status_t gse_free_vfrag(gse_vfrag_t **vfrag)
   status = GSE_STATUS_OK;
 
 free_vfrag:
-  free(*vfrag);
+  if(!is_pool_vfrag)
+  {
+    free(*vfrag);
+  }
   *vfrag = NULL;
 error:
   return status;
@@ -706,6 +867,8 @@ gse_status_t gse_reallocate_vfrag(gse_vfrag_t *vfrag, size_t start_offset,
   gse_status_t status = GSE_STATUS_OK;
 
   size_t length_buf;
+  size_t capacity;
+  size_t length;
   unsigned char *new_ptr;
 
   if(vfrag == NULL)
@@ -730,6 +893,25 @@ gse_status_t gse_reallocate_vfrag(gse_vfrag_t *vfrag, size_t start_offset,
     goto error;
   }
 
+  length = MIN(max_length + head_offset - start_offset, vfrag->length);
+
+  /* The data are moved inside the buffer if no other fragment uses it and
+   * if it is long enough, a pooled buffer may grow up to the length of the
+   * buffers of its pool */
+  capacity = vfrag->vbuf->length;
+  if(vfrag->vbuf->pool != NULL &&
+     vfrag->vbuf->start == ((gse_vfrag_pool_item_t *)vfrag->vbuf)->data)
+  {
+    capacity = MAX(capacity, vfrag->vbuf->pool->buffer_length);
+  }
+  if(vfrag->vbuf->vfrag_count == 1 && length_buf <= capacity)
+  {
+    memmove(vfrag->vbuf->start + start_offset, vfrag->start, length);
+    vfrag->vbuf->length = MAX(vfrag->vbuf->length, length_buf);
+    vfrag->vbuf->end = vfrag->vbuf->start + vfrag->vbuf->length;
+    goto update;
+  }
+
   /* increase the length of the global buffer */
   new_ptr = calloc(length_buf, sizeof(unsigned char));
   if(new_ptr == NULL)
@@ -737,21 +919,33 @@ gse_status_t gse_reallocate_vfrag(gse_vfrag_t *vfrag, size_t start_offset,
     status = GSE_STATUS_MALLOC_FAILED;
     goto error;
   }
+  __atomic_add_fetch(&gse_vfrag_realloc_nbr, 1, __ATOMIC_RELAXED);
   /* move the previous data in the new buffer */
-  memcpy(new_ptr + start_offset, vfrag->start,
-         MIN(max_length + head_offset - start_offset, vfrag->length));
+  memcpy(new_ptr + start_offset, vfrag->start, length);
 
-  free(vfrag->vbuf->start);
+  /* The data of a pooled buffer are allocated with it, an external buffer
+   * is given back as soon as its data are moved */
+  if(vfrag->vbuf->release != NULL)
+  {
+    vfrag->vbuf->release(vfrag->vbuf->start, vfrag->vbuf->opaque);
+    vfrag->vbuf->release = NULL;
+  }
+  else if(vfrag->vbuf->pool == NULL ||
+          vfrag->vbuf->start != ((gse_vfrag_pool_item_t *)vfrag->vbuf)->data)
+  {
+    free(vfrag->vbuf->start);
+  }
   /* update the buffer */
   vfrag->vbuf->start = new_ptr;
   /* update the virtual buffer length and end pointer */
   vfrag->vbuf->length = length_buf;
   vfrag->vbuf->end = vfrag->vbuf->start + vfrag->vbuf->length;
 
+update:
   /* update the virtual fragment start and end pointers,
    * length is only modified if new available length is smaller */
   vfrag->start = (vfrag->vbuf->start + start_offset);
-  vfrag->length = MIN(vfrag->length, max_length - start_offset);
+  vfrag->length = length;
   vfrag->end = vfrag->start + vfrag->length;
 
   assert((vfrag->end) <= (vfrag->vbuf->end));
@@ -768,6 +962,444 @@ error:
 
 }
 
+unsigned long gse_get_vfrag_realloc_nbr(void)
+{
+  return __atomic_load_n(&gse_vfrag_realloc_nbr, __ATOMIC_RELAXED);
+}
+
+gse_status_t gse_vfrag_pool_init(size_t buffer_length,
+                                 gse_vfrag_pool_t **pool)
+{
+  gse_status_t status = GSE_STATUS_OK;
+  size_t slot_length;
+
+  if(pool == NULL)
+  {
+    status = GSE_STATUS_NULL_PTR;
+    goto error;
+  }
+  if(buffer_length == 0)
+  {
+    status = GSE_STATUS_BUFF_LENGTH_NULL;
+    goto error;
+  }
+
+  /* The buffers are allocated when they are needed */
+  *pool = calloc(1, sizeof(gse_vfrag_pool_t));
+  if(*pool == NULL)
+  {
+    status = GSE_STATUS_MALLOC_FAILED;
+    goto error;
+  }
+  (*pool)->buffer_length = buffer_length;
+  (*pool)->owner = pthread_self();
+  (*pool)->ref_nbr = 1;
+  (*pool)->node = GSE_NUMA_NO_NODE;
+
+  /* The chunks are mapped when the buffers are carved, they hold at least
+   * one buffer */
+  slot_length = sizeof(gse_vfrag_pool_item_t) + buffer_length;
+  slot_length += GSE_CACHE_LINE_SIZE - 1;
+  slot_length -= slot_length % GSE_CACHE_LINE_SIZE;
+  (*pool)->slot_length = slot_length;
+  (*pool)->chunk_length = slot_length + GSE_CACHE_LINE_SIZE +
+                          GSE_VFRAG_POOL_HUGEPAGE_SIZE - 1;
+  (*pool)->chunk_length -= (*pool)->chunk_length % GSE_VFRAG_POOL_HUGEPAGE_SIZE;
+
+error:
+  return status;
+}
+
+gse_status_t gse_vfrag_pool_init_hugepage(size_t buffer_length,
+                                          gse_vfrag_pool_t **pool)
+{
+  gse_status_t status;
+
+  status = gse_vfrag_pool_init(buffer_length, pool);
+  if(status != GSE_STATUS_OK)
+  {
+    goto error;
+  }
+  (*pool)->is_hugepage = 1;
+
+error:
+  return status;
+}
+
+gse_status_t gse_vfrag_pool_set_node(gse_vfrag_pool_t *pool, int node)
+{
+  gse_status_t status;
+
+  if(pool == NULL)
+  {
+    return GSE_STATUS_NULL_PTR;
+  }
+
+  if(node != GSE_NUMA_NO_NODE)
+  {
+    status = gse_numa_check_node(node);
+    if(status != GSE_STATUS_OK)
+    {
+      return status;
+    }
+  }
+  pool->node = node;
+
+  return GSE_STATUS_OK;
+}
+
+gse_status_t gse_vfrag_pool_release(gse_vfrag_pool_t *pool)
+{
+  if(pool == NULL)
+  {
+    return GSE_STATUS_NULL_PTR;
+  }
+
+  /* The buffers still in use go to the return queue from now on, the
+   * chunks are kept until all the buffers are back */
+  pool->is_released = 1;
+  gse_vfrag_pool_free_items(pool->free_items);
+  pool->free_items = NULL;
+  gse_vfrag_pool_free_items(__atomic_exchange_n(&pool->returned_items, NULL,
+                                                __ATOMIC_ACQUIRE));
+
+  if(__atomic_sub_fetch(&pool->ref_nbr, 1, __ATOMIC_ACQ_REL) == 0)
+  {
+    gse_vfrag_pool_destroy(pool);
+  }
+
+  return GSE_STATUS_OK;
+}
+
+gse_status_t gse_vfrag_pool_set_owner(gse_vfrag_pool_t *pool)
+{
+  if(pool == NULL)
+  {
+    return GSE_STATUS_NULL_PTR;
+  }
+
+  pool->owner = pthread_self();
+
+  return GSE_STATUS_OK;
+}
+
+gse_status_t gse_create_vfrag_from_pool(gse_vfrag_t **vfrag,
+                                        gse_vfrag_pool_t *pool,
+                                        size_t max_length, size_t head_offset,
+                                        size_t trail_offset)
+{
+  gse_status_t status = GSE_STATUS_OK;
+  gse_vfrag_pool_item_t *item;
+  size_t length_buf;
+
+  if(vfrag == NULL || pool == NULL)
+  {
+    status = GSE_STATUS_NULL_PTR;
+    goto error;
+  }
+
+  length_buf = max_length + head_offset + trail_offset;
+  if(length_buf == 0)
+  {
+    status = GSE_STATUS_BUFF_LENGTH_NULL;
+    goto error;
+  }
+  if(length_buf > pool->buffer_length)
+  {
+    status = GSE_STATUS_DATA_TOO_LONG;
+    goto error;
+  }
+
+  /* Take back the buffers freed by the other threads in one batch when
+   * there is no free buffer left */
+  if(pool->free_items == NULL)
+  {
+    pool->free_items = __atomic_exchange_n(&pool->returned_items, NULL,
+                                           __ATOMIC_ACQUIRE);
+  }
+  item = pool->free_items;
+  if(item != NULL)
+  {
+    pool->free_items = item->next;
+  }
+  else
+  {
+    item = gse_vfrag_pool_alloc(pool);
+    if(item == NULL)
+    {
+      status = GSE_STATUS_MALLOC_FAILED;
+      goto error;
+    }
+    item->data = (unsigned char *)(item + 1);
+    item->vbuf.pool = pool;
+    item->vbuf.release = NULL;
+    item->vbuf.opaque = NULL;
+    pool->buffer_nbr++;
+  }
+  __atomic_add_fetch(&pool->ref_nbr, 1, __ATOMIC_RELAXED);
+
+  item->vbuf.start = item->data;
+  item->vbuf.length = length_buf;
+  item->vbuf.end = item->vbuf.start + item->vbuf.length;
+  item->vbuf.vfrag_count = 1;
+
+  *vfrag = &(item->vfrag);
+  (*vfrag)->vbuf = &(item->vbuf);
+  (*vfrag)->start = item->vbuf.start + head_offset;
+  (*vfrag)->length = max_length;
+  (*vfrag)->end = (*vfrag)->start + (*vfrag)->length;
+
+  return status;
+error:
+  if(vfrag != NULL)
+  {
+    *vfrag = NULL;
+  }
+  return status;
+}
+
+gse_status_t gse_vfrag_pool_get_usage(gse_vfrag_pool_t *pool,
+                                      unsigned int *buffer_nbr,
+                                      unsigned int *free_nbr)
+{
+  gse_vfrag_pool_item_t *item;
+
+  if(pool == NULL || buffer_nbr == NULL || free_nbr == NULL)
+  {
+    return GSE_STATUS_NULL_PTR;
+  }
+
+  *buffer_nbr = pool->buffer_nbr;
+  *free_nbr = 0;
+  for(item = pool->free_items ; item != NULL ; item = item->next)
+  {
+    (*free_nbr)++;
+  }
+
+  return GSE_STATUS_OK;
+}
+
+gse_status_t gse_create_vfrag_chain(gse_vfrag_chain_t **chain,
+                                    unsigned int max_seg_nbr)
+{
+  gse_status_t status = GSE_STATUS_OK;
+
+  if(chain == NULL)
+  {
+    status = GSE_STATUS_NULL_PTR;
+    goto error;
+  }
+  *chain = NULL;
+  if(max_seg_nbr == 0)
+  {
+    status = GSE_STATUS_BUFF_LENGTH_NULL;
+    goto error;
+  }
+
+  *chain = calloc(1, sizeof(gse_vfrag_chain_t));
+  if(*chain == NULL)
+  {
+    status = GSE_STATUS_MALLOC_FAILED;
+    goto error;
+  }
+  (*chain)->segments = calloc(max_seg_nbr, sizeof(gse_vfrag_t *));
+  if((*chain)->segments == NULL)
+  {
+    status = GSE_STATUS_MALLOC_FAILED;
+    goto free_chain;
+  }
+  (*chain)->max_seg_nbr = max_seg_nbr;
+  (*chain)->ref_nbr = 1;
+
+  return status;
+
+free_chain:
+  free(*chain);
+  *chain = NULL;
+error:
+  return status;
+}
+
+gse_status_t gse_append_vfrag_chain(gse_vfrag_chain_t *chain,
+                                    gse_vfrag_t *vfrag)
+{
+  if(chain == NULL || vfrag == NULL)
+  {
+    return GSE_STATUS_NULL_PTR;
+  }
+  if(vfrag->length == 0)
+  {
+    return GSE_STATUS_EMPTY_FRAG;
+  }
+  if(chain->seg_nbr >= chain->max_seg_nbr)
+  {
+    return GSE_STATUS_CHAIN_FULL;
+  }
+
+  chain->segments[chain->seg_nbr] = vfrag;
+  chain->seg_nbr++;
+  chain->length += vfrag->length;
+  return GSE_STATUS_OK;
+}
+
+gse_status_t gse_set_vfrag_chain_trailer(gse_vfrag_chain_t *chain,
+                                         const unsigned char *data,
+                                         size_t length)
+{
+  if(chain == NULL || (data == NULL && length > 0))
+  {
+    return GSE_STATUS_NULL_PTR;
+  }
+  if(length > GSE_MAX_TRAILER_LENGTH)
+  {
+    return GSE_STATUS_DATA_TOO_LONG;
+  }
+
+  chain->length += length;
+  chain->length -= chain->trailer_length;
+  if(length > 0)
+  {
+    memcpy(chain->trailer, data, length);
+  }
+  chain->trailer_length = length;
+  return GSE_STATUS_OK;
+}
+
+gse_status_t gse_hold_vfrag_chain(gse_vfrag_chain_t *chain)
+{
+  if(chain == NULL)
+  {
+    return GSE_STATUS_NULL_PTR;
+  }
+  __atomic_add_fetch(&chain->ref_nbr, 1, __ATOMIC_RELAXED);
+  return GSE_STATUS_OK;
+}
+
+gse_status_t gse_free_vfrag_chain(gse_vfrag_chain_t **chain)
+{
+  gse_status_t status = GSE_STATUS_OK;
+  gse_status_t seg_status;
+  unsigned int i;
+
+  if(chain == NULL || *chain == NULL)
+  {
+    status = GSE_STATUS_NULL_PTR;
+    goto error;
+  }
+  if((*chain)->ref_nbr == 0)
+  {
+    status = GSE_STATUS_FRAG_NBR;
+    goto error;
+  }
+
+  /* The data may be read by the other users until the last reference */
+  if(__atomic_sub_fetch(&(*chain)->ref_nbr, 1, __ATOMIC_ACQ_REL) == 0)
+  {
+    for(i = 0 ; i < (*chain)->seg_nbr ; i++)
+    {
+      seg_status = gse_free_vfrag(&(*chain)->segments[i]);
+      if(seg_status != GSE_STATUS_OK)
+      {
+        status = seg_status;
+      }
+    }
+    free((*chain)->segments);
+    free(*chain);
+  }
+  *chain = NULL;
+
+error:
+  return status;
+}
+
+gse_status_t gse_get_vfrag_chain_iov(gse_vfrag_chain_t *chain, size_t offset,
+                                     size_t max_length, struct iovec *iov,
+                                     unsigned int iov_max,
+                                     unsigned int *iov_nbr, size_t *length)
+{
+  unsigned int i;
+  size_t seg_length;
+
+  if(chain == NULL || (iov == NULL && iov_max > 0) || iov_nbr == NULL ||
+     length == NULL)
+  {
+    return GSE_STATUS_NULL_PTR;
+  }
+  if(offset > chain->length)
+  {
+    return GSE_STATUS_OFFSET_TOO_HIGH;
+  }
+
+  *iov_nbr = 0;
+  *length = 0;
+  max_length = MIN(max_length, chain->length - offset);
+
+  /* Skip the segments before the offset */
+  for(i = 0 ; i < chain->seg_nbr && offset >= chain->segments[i]->length ; i++)
+  {
+    offset -= chain->segments[i]->length;
+  }
+  for( ; i < chain->seg_nbr && *length < max_length && *iov_nbr < iov_max ;
+      i++)
+  {
+    seg_length = MIN(chain->segments[i]->length - offset,
+                     max_length - *length);
+    iov[*iov_nbr].iov_base = chain->segments[i]->start + offset;
+    iov[*iov_nbr].iov_len = seg_length;
+    (*iov_nbr)++;
+    *length += seg_length;
+    offset = 0;
+  }
+  /* The trailer follows the last segment */
+  if(i == chain->seg_nbr && *length < max_length && *iov_nbr < iov_max)
+  {
+    seg_length = max_length - *length;
+    iov[*iov_nbr].iov_base = chain->trailer + offset;
+    iov[*iov_nbr].iov_len = seg_length;
+    (*iov_nbr)++;
+    *length += seg_length;
+  }
+
+  return GSE_STATUS_OK;
+}
+
+gse_status_t gse_copy_vfrag_chain(gse_vfrag_chain_t *chain, size_t offset,
+                                  size_t length, unsigned char *buffer)
+{
+  gse_status_t status;
+  struct iovec iov[16];
+  unsigned int iov_nbr;
+  unsigned int i;
+  size_t part_length;
+
+  if(buffer == NULL && length > 0)
+  {
+    return GSE_STATUS_NULL_PTR;
+  }
+
+  while(length > 0)
+  {
+    status = gse_get_vfrag_chain_iov(chain, offset, length, iov, 16, &iov_nbr,
+                                     &part_length);
+    if(status != GSE_STATUS_OK)
+    {
+      return status;
+    }
+    if(part_length == 0)
+    {
+      return GSE_STATUS_OFFSET_TOO_HIGH;
+    }
+    for(i = 0 ; i < iov_nbr ; i++)
+    {
+      memcpy(buffer, iov[i].iov_base, iov[i].iov_len);
+      buffer += iov[i].iov_len;
+    }
+    offset += part_length;
+    length -= part_length;
+  }
+  return GSE_STATUS_OK;
+}
+
 /****************************************************************************
  *
  *   PRIVATE FUNCTIONS
@@ -806,6 +1438,9 @@ static gse_status_t gse_create_vbuf(gse_vbuf_t **vbuf, size_t length)
 
   (*vbuf)->end = (*vbuf)->start + (*vbuf)->length;
   (*vbuf)->vfrag_count = 0;
+  (*vbuf)->pool = NULL;
+  (*vbuf)->release = NULL;
+  (*vbuf)->opaque = NULL;
 
   return status;
 free_vbuf:
@@ -827,9 +1462,179 @@ static gse_status_t gse_free_vbuf(gse_vbuf_t *vbuf)
     status = GSE_STATUS_FRAG_NBR;
     goto error;
   }
-  free(vbuf->start);
+  if(vbuf->pool != NULL)
+  {
+    gse_vfrag_pool_put((gse_vfrag_pool_item_t *)vbuf);
+    goto error;
+  }
+  if(vbuf->release != NULL)
+  {
+    vbuf->release(vbuf->start, vbuf->opaque);
+  }
+  else
+  {
+    free(vbuf->start);
+  }
   free(vbuf);
 
 error:
   return status;
 }
+
+static void gse_vfrag_pool_put(gse_vfrag_pool_item_t *item)
+{
+  gse_vfrag_pool_t *pool = item->vbuf.pool;
+
+  /* Give its own data back to a reallocated buffer */
+  if(item->vbuf.start != item->data)
+  {
+    free(item->vbuf.start);
+    item->vbuf.start = item->data;
+  }
+
+  if(pthread_equal(pthread_self(), pool->owner) && !pool->is_released)
+  {
+    item->next = pool->free_items;
+    pool->free_items = item;
+  }
+  else
+  {
+    /* Only the owner takes the buffers from the queue and it takes all of
+     * them at once, so the push cannot suffer from ABA */
+    item->next = __atomic_load_n(&pool->returned_items, __ATOMIC_RELAXED);
+    while(!__atomic_compare_exchange_n(&pool->returned_items, &item->next,
+                                       item, 1, __ATOMIC_RELEASE,
+                                       __ATOMIC_RELAXED))
+    {
+    }
+  }
+
+  if(__atomic_sub_fetch(&pool->ref_nbr, 1, __ATOMIC_ACQ_REL) == 0)
+  {
+    gse_vfrag_pool_destroy(pool);
+  }
+}
+
+static void gse_vfrag_pool_destroy(gse_vfrag_pool_t *pool)
+{
+  gse_vfrag_pool_chunk_t *chunk;
+
+  gse_vfrag_pool_free_items(__atomic_exchange_n(&pool->returned_items, NULL,
+                                                __ATOMIC_ACQUIRE));
+  while(pool->chunks != NULL)
+  {
+    chunk = pool->chunks;
+    pool->chunks = chunk->next;
+    munmap(chunk, chunk->length);
+  }
+  free(pool);
+}
+
+static gse_vfrag_pool_item_t *gse_vfrag_pool_alloc(gse_vfrag_pool_t *pool)
+{
+  gse_vfrag_pool_chunk_t *chunk;
+  gse_vfrag_pool_item_t *item;
+
+  if(!pool->is_hugepage && pool->node == GSE_NUMA_NO_NODE)
+  {
+    item = malloc(sizeof(gse_vfrag_pool_item_t) + pool->buffer_length);
+    if(item != NULL)
+    {
+      item->is_carved = 0;
+    }
+    return item;
+  }
+
+  if(pool->chunk_left < pool->slot_length)
+  {
+    chunk = gse_vfrag_pool_map_chunk(pool);
+    if(chunk == NULL)
+    {
+      return NULL;
+    }
+    chunk->next = pool->chunks;
+    chunk->length = pool->chunk_length;
+    pool->chunks = chunk;
+    pool->chunk_next = (unsigned char *)chunk + GSE_CACHE_LINE_SIZE;
+    pool->chunk_left = pool->chunk_length - GSE_CACHE_LINE_SIZE;
+  }
+  item = (gse_vfrag_pool_item_t *)pool->chunk_next;
+  pool->chunk_next += pool->slot_length;
+  pool->chunk_left -= pool->slot_length;
+  item->is_carved = 1;
+
+  return item;
+}
+
+static void *gse_vfrag_pool_map_chunk(gse_vfrag_pool_t *pool)
+{
+  size_t length = pool->chunk_length;
+  unsigned char *area;
+  unsigned char *chunk;
+  size_t head;
+
+#ifdef MAP_HUGETLB
+  chunk = MAP_FAILED;
+  if(pool->is_hugepage)
+  {
+    chunk = mmap(NULL, length, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  }
+  if(chunk != MAP_FAILED)
+  {
+    goto bind;
+  }
+#endif
+
+  /* No hugepage is reserved, map one more hugepage to align the chunk so
+   * that it can be backed by transparent hugepages */
+  area = mmap(NULL, length + GSE_VFRAG_POOL_HUGEPAGE_SIZE,
+              PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if(area == MAP_FAILED)
+  {
+    return NULL;
+  }
+  head = (GSE_VFRAG_POOL_HUGEPAGE_SIZE -
+          (uintptr_t)area % GSE_VFRAG_POOL_HUGEPAGE_SIZE) %
+         GSE_VFRAG_POOL_HUGEPAGE_SIZE;
+  chunk = area + head;
+  if(head > 0)
+  {
+    munmap(area, head);
+  }
+  munmap(chunk + length, GSE_VFRAG_POOL_HUGEPAGE_SIZE - head);
+#ifdef MADV_HUGEPAGE
+  if(pool->is_hugepage)
+  {
+    madvise(chunk, length, MADV_HUGEPAGE);
+  }
+#endif
+
+#ifdef MAP_HUGETLB
+bind:
+#endif
+  /* The pages are not accessed yet, they are allocated on the node */
+  if(pool->node != GSE_NUMA_NO_NODE &&
+     gse_numa_bind_memory(chunk, length, pool->node) != GSE_STATUS_OK)
+  {
+    munmap(chunk, length);
+    return NULL;
+  }
+
+  return chunk;
+}
+
+static void gse_vfrag_pool_free_items(gse_vfrag_pool_item_t *item)
+{
+  gse_vfrag_pool_item_t *next;
+
+  while(item != NULL)
+  {
+    next = item->next;
+    if(!item->is_carved)
+    {
+      free(item);
+    }
+    item = next;
+  }
+}
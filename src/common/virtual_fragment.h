@@ -51,12 +51,25 @@
 #define VIRTUAL_FRAGMENT_H
 
 #include <string.h>
+#include <sys/uio.h>
 
 #include "status.h"
+#include "constants.h"
 
 /** Get the minimum between two values */
 #define MIN(x, y)  (((x) < (y)) ? (x) : (y))
 
+/** The buffer length of a pool of GSE packets, with the refragmentation
+ *  offset and the CRC32 */
+#define GSE_VFRAG_POOL_PACKET_LENGTH \
+  (GSE_MAX_PACKET_LENGTH + GSE_MAX_REFRAG_HEAD_OFFSET + GSE_MAX_TRAILER_LENGTH)
+
+/** The buffer length of a pool of PDUs, with the GSE header, the header
+ *  extensions and the CRC32 */
+#define GSE_VFRAG_POOL_PDU_LENGTH \
+  (GSE_MAX_PDU_LENGTH + GSE_MAX_HEADER_LENGTH + GSE_MAX_EXT_LENGTH + \
+   GSE_MAX_TRAILER_LENGTH)
+
 /**
  * @defgroup gse_virtual_fragment GSE virtual fragment API
  */
@@ -67,6 +80,21 @@
  *
  ****************************************************************************/
 
+struct gse_vfrag_pool_s;
+/** Pool of virtual buffers owned by a thread */
+typedef struct gse_vfrag_pool_s gse_vfrag_pool_t;
+
+/**
+ *  @brief   Callback giving back an external buffer once no virtual fragment
+ *           uses it
+ *
+ *  @param   buffer  The buffer given on creation
+ *  @param   opaque  The user specific data given on creation
+ *
+ *  @ingroup gse_virtual_fragment
+ */
+typedef void (*gse_vbuf_release_cb_t)(unsigned char *buffer, void *opaque);
+
 /** Virtual buffer */
 typedef struct
 {
@@ -75,6 +103,12 @@ typedef struct
   size_t length;        /**< Length of the virtual buffer (in bytes)*/
   unsigned int vfrag_count; /**< Number of virtual fragments
                                  This value should not be greater than 2 */
+  gse_vfrag_pool_t *pool; /**< The pool the buffer is given back to when it
+                               is freed, NULL if it is allocated on its own */
+  gse_vbuf_release_cb_t release; /**< The callback giving back an external
+                                      buffer, NULL if the buffer is freed by
+                                      the library */
+  void *opaque;         /**< User specific data for the release callback */
 } gse_vbuf_t;
 
 /** Virtual fragment: represent a subpart of a virtual buffer */
@@ -86,6 +120,26 @@ typedef struct
   size_t length;        /**< length of the virtual fragment (in bytes)*/
 } gse_vfrag_t;
 
+/** Chain of virtual fragments: the data of a PDU spread over several
+ *  buffers, in order
+ *
+ *  A trailer stored in the chain may follow the data of the segments. The
+ *  chain is shared by its users, the segments are freed with the last
+ *  reference.
+ */
+typedef struct
+{
+  gse_vfrag_t **segments;  /**< The virtual fragments of the chain */
+  unsigned int seg_nbr;    /**< The number of segments */
+  unsigned int max_seg_nbr; /**< The maximum number of segments */
+  size_t length;           /**< The length of the data of the segments and
+                                of the trailer (in bytes) */
+  unsigned char trailer[GSE_MAX_TRAILER_LENGTH]; /**< The data following the
+                                                      segments */
+  size_t trailer_length;   /**< The length of the trailer (in bytes) */
+  unsigned int ref_nbr;    /**< The number of users of the chain */
+} gse_vfrag_chain_t;
+
 /****************************************************************************
  *
  *   FUNCTION PROTOTYPES
@@ -207,6 +261,42 @@ gse_status_t gse_copy_data(gse_vfrag_t *vfrag, unsigned char const* data,
 gse_status_t gse_create_vfrag_from_buf(gse_vfrag_t **vfrag, unsigned char *buffer,
                                        unsigned int head_offset, unsigned int trail_offset,
                                        unsigned int data_length);
+/**
+ *  @brief   Transform an external buffer into a virtual fragment
+ *
+ *  The buffer is not copied and the library does not free it, it is given
+ *  back with the release callback once the last virtual fragment using it
+ *  is freed or once its data are moved by \ref gse_reallocate_vfrag. The
+ *  buffer may for example be a slot of a shared memory segment.\n
+ *  All length are expressed in bytes.
+ *
+ *  @param   vfrag         OUT: The virtual fragment on success,
+ *                              NULL on error
+ *  @param   buffer        The buffer to transform
+ *  @param   head_offset   The offset applied before the data in the buffer
+ *  @param   trail_offset  The offset applied after the data in the buffer
+ *  @param   data_length   The length of the data in the buffer
+ *  @param   release       The callback giving back the buffer
+ *  @param   opaque        The user specific data given to the callback
+ *
+ *  @return
+ *                         - success/informative code among:
+ *                           - \ref GSE_STATUS_OK
+ *                         - warning/error code among:
+ *                           - \ref GSE_STATUS_NULL_PTR
+ *                           - \ref GSE_STATUS_MALLOC_FAILED
+ *                           - \ref GSE_STATUS_INTERNAL_ERROR
+ *
+ *  @ingroup gse_virtual_fragment
+ */
+gse_status_t gse_create_vfrag_from_ext_buf(gse_vfrag_t **vfrag,
+                                           unsigned char *buffer,
+                                           size_t head_offset,
+                                           size_t trail_offset,
+                                           size_t data_length,
+                                           gse_vbuf_release_cb_t release,
+                                           void *opaque);
+
 /**
  *  @brief   Create an empty virtual fragment - No allocation mode
  *
@@ -459,8 +549,12 @@ size_t gse_get_vfrag_available_trail(gse_vfrag_t *vfrag);
  *  @brief   Reallocate a virtual fragment internal buffer to increase
  *           its available length
  *
- *  The length of the virtual buffer containing the fragment will be
+ *  The length of the virtual buffer containing the fragment will be at least
  *  max_length + head_offset + trail_offset.\n
+ *  The data are moved inside the buffer when the fragment is its only user
+ *  and the buffer is long enough, or the length of the buffers of its pool
+ *  for a pooled buffer. A new buffer is allocated otherwise, see
+ *  \ref gse_get_vfrag_realloc_nbr.\n
  *  All length are expressed in bytes.\n
  *
  *  @param   vfrag         IN: The virtual fragment to reallocate
@@ -487,5 +581,325 @@ gse_status_t gse_reallocate_vfrag(gse_vfrag_t *vfrag,
                                   size_t start_offset, size_t max_length,
                                   size_t head_offset, size_t trail_offset);
 
+/**
+ *  @brief   Get the number of buffers allocated by \ref gse_reallocate_vfrag
+ *           because the data did not fit in their buffer
+ *
+ *  The counter is shared by all the threads of the process. It should not
+ *  change with the buffers allocated with room for the GSE header and the
+ *  header extensions.
+ *
+ *  @return  The number of reallocations since the start of the process
+ *
+ *  @ingroup gse_virtual_fragment
+ */
+unsigned long gse_get_vfrag_realloc_nbr(void);
+
+/**
+ *  @brief   Create a pool of virtual buffers
+ *
+ *  The buffers are allocated by the owner of the pool, the thread that
+ *  creates it, and kept when their virtual fragments are freed. A buffer
+ *  freed by another thread is pushed on a lock-free return queue that the
+ *  owner drains at once when it runs out of free buffers, so that the
+ *  buffers go back to the thread that allocated them.
+ *
+ *  @param   buffer_length  The length of the buffers (in bytes)
+ *  @param   pool           OUT: The pool
+ *
+ *  @return
+ *                          - success/informative code among:
+ *                            - \ref GSE_STATUS_OK
+ *                          - warning/error code among:
+ *                            - \ref GSE_STATUS_NULL_PTR
+ *                            - \ref GSE_STATUS_BUFF_LENGTH_NULL
+ *                            - \ref GSE_STATUS_MALLOC_FAILED
+ *
+ *  @ingroup gse_virtual_fragment
+ */
+gse_status_t gse_vfrag_pool_init(size_t buffer_length,
+                                 gse_vfrag_pool_t **pool);
+
+/**
+ *  @brief   Create a pool of virtual buffers carved from hugepages
+ *
+ *  The pool behaves as the one of \ref gse_vfrag_pool_init but its buffers
+ *  are carved in cache line aligned slots from 2 MiB chunks, so that many
+ *  buffers are covered by a single TLB entry. The chunks are mapped with
+ *  explicit hugepages if some are reserved, they are aligned and advised
+ *  for transparent hugepages otherwise. They are unmapped when the pool
+ *  and all its buffers are released.\n
+ *  \ref GSE_VFRAG_POOL_PACKET_LENGTH and \ref GSE_VFRAG_POOL_PDU_LENGTH
+ *  are the buffer lengths for GSE packets and PDUs.
+ *
+ *  @param   buffer_length  The length of the buffers (in bytes)
+ *  @param   pool           OUT: The pool
+ *
+ *  @return
+ *                          - success/informative code among:
+ *                            - \ref GSE_STATUS_OK
+ *                          - warning/error code among:
+ *                            - \ref GSE_STATUS_NULL_PTR
+ *                            - \ref GSE_STATUS_BUFF_LENGTH_NULL
+ *                            - \ref GSE_STATUS_MALLOC_FAILED
+ *
+ *  @ingroup gse_virtual_fragment
+ */
+gse_status_t gse_vfrag_pool_init_hugepage(size_t buffer_length,
+                                          gse_vfrag_pool_t **pool);
+
+/**
+ *  @brief   Place the buffers of a pool on a NUMA node
+ *
+ *  The buffers allocated afterwards are carved from chunks bound to the
+ *  node, whatever the thread that allocates them.
+ *
+ *  @param   pool  The pool
+ *  @param   node  The NUMA node, \ref GSE_NUMA_NO_NODE for the placement of
+ *                 the system
+ *
+ *  @return
+ *                 - success/informative code among:
+ *                   - \ref GSE_STATUS_OK
+ *                 - warning/error code among:
+ *                   - \ref GSE_STATUS_NULL_PTR
+ *                   - \ref GSE_STATUS_NUMA_FAILED
+ *
+ *  @ingroup gse_virtual_fragment
+ */
+gse_status_t gse_vfrag_pool_set_node(gse_vfrag_pool_t *pool, int node);
+
+/**
+ *  @brief   Release a pool of virtual buffers
+ *
+ *  The virtual fragments of the pool may still be in use, their buffers
+ *  are released when they are freed and the pool with the last of them.
+ *  The pool shall not be used to create virtual fragments any more.
+ *
+ *  @param   pool  The pool
+ *
+ *  @return
+ *                 - success/informative code among:
+ *                   - \ref GSE_STATUS_OK
+ *                 - warning/error code among:
+ *                   - \ref GSE_STATUS_NULL_PTR
+ *
+ *  @ingroup gse_virtual_fragment
+ */
+gse_status_t gse_vfrag_pool_release(gse_vfrag_pool_t *pool);
+
+/**
+ *  @brief   Make the calling thread the owner of a pool of virtual buffers
+ *
+ *  This shall be done before virtual fragments are created from the pool.
+ *
+ *  @param   pool  The pool
+ *
+ *  @return
+ *                 - success/informative code among:
+ *                   - \ref GSE_STATUS_OK
+ *                 - warning/error code among:
+ *                   - \ref GSE_STATUS_NULL_PTR
+ *
+ *  @ingroup gse_virtual_fragment
+ */
+gse_status_t gse_vfrag_pool_set_owner(gse_vfrag_pool_t *pool);
+
+/**
+ *  @brief   Create an empty virtual fragment in a buffer of a pool
+ *
+ *  Contrary to \ref gse_create_vfrag the buffer is not initialized. The
+ *  function shall be called by the owner of the pool, the virtual fragment
+ *  can be freed by any thread with \ref gse_free_vfrag.
+ *
+ *  @param   vfrag         OUT: The virtual fragment on success,
+ *                              NULL on error
+ *  @param   pool          The pool
+ *  @param   max_length    The maximum length of the fragment
+ *  @param   head_offset   The offset applied before the fragment
+ *  @param   trail_offset  The offset applied after the fragment
+ *
+ *  @return
+ *                         - success/informative code among:
+ *                           - \ref GSE_STATUS_OK
+ *                         - warning/error code among:
+ *                           - \ref GSE_STATUS_NULL_PTR
+ *                           - \ref GSE_STATUS_BUFF_LENGTH_NULL
+ *                           - \ref GSE_STATUS_DATA_TOO_LONG
+ *                           - \ref GSE_STATUS_MALLOC_FAILED
+ *
+ *  @ingroup gse_virtual_fragment
+ */
+gse_status_t gse_create_vfrag_from_pool(gse_vfrag_t **vfrag,
+                                        gse_vfrag_pool_t *pool,
+                                        size_t max_length, size_t head_offset,
+                                        size_t trail_offset);
+
+/**
+ *  @brief   Get the number of buffers of a pool
+ *
+ *  The function shall be called by the owner of the pool, the buffers on
+ *  the return queue are not counted as free.
+ *
+ *  @param   pool        The pool
+ *  @param   buffer_nbr  OUT: The number of buffers allocated by the pool
+ *  @param   free_nbr    OUT: The number of free buffers of the owner
+ *
+ *  @return
+ *                       - success/informative code among:
+ *                         - \ref GSE_STATUS_OK
+ *                       - warning/error code among:
+ *                         - \ref GSE_STATUS_NULL_PTR
+ *
+ *  @ingroup gse_virtual_fragment
+ */
+gse_status_t gse_vfrag_pool_get_usage(gse_vfrag_pool_t *pool,
+                                      unsigned int *buffer_nbr,
+                                      unsigned int *free_nbr);
+
+/**
+ *  @brief   Create an empty chain of virtual fragments
+ *
+ *  @param   chain        OUT: The chain on success, NULL on error
+ *  @param   max_seg_nbr  The maximum number of segments of the chain
+ *
+ *  @return
+ *                        - success/informative code among:
+ *                          - \ref GSE_STATUS_OK
+ *                        - warning/error code among:
+ *                          - \ref GSE_STATUS_NULL_PTR
+ *                          - \ref GSE_STATUS_BUFF_LENGTH_NULL
+ *                          - \ref GSE_STATUS_MALLOC_FAILED
+ *
+ *  @ingroup gse_virtual_fragment
+ */
+gse_status_t gse_create_vfrag_chain(gse_vfrag_chain_t **chain,
+                                    unsigned int max_seg_nbr);
+
+/**
+ *  @brief   Append a virtual fragment at the end of a chain
+ *
+ *  The virtual fragment belongs to the chain on success, it is left to the
+ *  caller on error. The chain shall not be modified once given to the
+ *  encapsulation.
+ *
+ *  @param   chain  The chain
+ *  @param   vfrag  The virtual fragment
+ *
+ *  @return
+ *                  - success/informative code among:
+ *                    - \ref GSE_STATUS_OK
+ *                  - warning/error code among:
+ *                    - \ref GSE_STATUS_NULL_PTR
+ *                    - \ref GSE_STATUS_EMPTY_FRAG
+ *                    - \ref GSE_STATUS_CHAIN_FULL
+ *
+ *  @ingroup gse_virtual_fragment
+ */
+gse_status_t gse_append_vfrag_chain(gse_vfrag_chain_t *chain,
+                                    gse_vfrag_t *vfrag);
+
+/**
+ *  @brief   Set the data following the segments of a chain
+ *
+ *  @param   chain   The chain
+ *  @param   data    The data of the trailer
+ *  @param   length  The length of the trailer, at most
+ *                   \ref GSE_MAX_TRAILER_LENGTH
+ *
+ *  @return
+ *                   - success/informative code among:
+ *                     - \ref GSE_STATUS_OK
+ *                   - warning/error code among:
+ *                     - \ref GSE_STATUS_NULL_PTR
+ *                     - \ref GSE_STATUS_DATA_TOO_LONG
+ *
+ *  @ingroup gse_virtual_fragment
+ */
+gse_status_t gse_set_vfrag_chain_trailer(gse_vfrag_chain_t *chain,
+                                         const unsigned char *data,
+                                         size_t length);
+
+/**
+ *  @brief   Take a reference on a chain
+ *
+ *  @param   chain  The chain
+ *
+ *  @return
+ *                  - success/informative code among:
+ *                    - \ref GSE_STATUS_OK
+ *                  - warning/error code among:
+ *                    - \ref GSE_STATUS_NULL_PTR
+ *
+ *  @ingroup gse_virtual_fragment
+ */
+gse_status_t gse_hold_vfrag_chain(gse_vfrag_chain_t *chain);
+
+/**
+ *  @brief   Release a reference on a chain, the chain and its segments are
+ *           freed with the last one
+ *
+ *  @param   chain  IN: The chain
+ *                  OUT: NULL
+ *
+ *  @return
+ *                  - success/informative code among:
+ *                    - \ref GSE_STATUS_OK
+ *                  - warning/error code among:
+ *                    - \ref GSE_STATUS_NULL_PTR
+ *                    - \ref GSE_STATUS_FRAG_NBR
+ *
+ *  @ingroup gse_virtual_fragment
+ */
+gse_status_t gse_free_vfrag_chain(gse_vfrag_chain_t **chain);
+
+/**
+ *  @brief   Describe a part of the data of a chain with I/O vectors
+ *
+ *  The part stops at the maximum length, at the end of the data or when the
+ *  vectors are all used.
+ *
+ *  @param   chain       The chain
+ *  @param   offset      The offset of the part in the data of the chain
+ *  @param   max_length  The maximum length of the part
+ *  @param   iov         OUT: The vectors
+ *  @param   iov_max     The number of vectors
+ *  @param   iov_nbr     OUT: The number of vectors used
+ *  @param   length      OUT: The length of the part
+ *
+ *  @return
+ *                       - success/informative code among:
+ *                         - \ref GSE_STATUS_OK
+ *                       - warning/error code among:
+ *                         - \ref GSE_STATUS_NULL_PTR
+ *                         - \ref GSE_STATUS_OFFSET_TOO_HIGH
+ *
+ *  @ingroup gse_virtual_fragment
+ */
+gse_status_t gse_get_vfrag_chain_iov(gse_vfrag_chain_t *chain, size_t offset,
+                                     size_t max_length, struct iovec *iov,
+                                     unsigned int iov_max,
+                                     unsigned int *iov_nbr, size_t *length);
+
+/**
+ *  @brief   Copy a part of the data of a chain in a buffer
+ *
+ *  @param   chain   The chain
+ *  @param   offset  The offset of the part in the data of the chain
+ *  @param   length  The length of the part
+ *  @param   buffer  The buffer, at least length long
+ *
+ *  @return
+ *                   - success/informative code among:
+ *                     - \ref GSE_STATUS_OK
+ *                   - warning/error code among:
+ *                     - \ref GSE_STATUS_NULL_PTR
+ *                     - \ref GSE_STATUS_OFFSET_TOO_HIGH
+ *
+ *  @ingroup gse_virtual_fragment
+ */
+gse_status_t gse_copy_vfrag_chain(gse_vfrag_chain_t *chain, size_t offset,
+                                  size_t length, unsigned char *buffer);
+
 
 #endif
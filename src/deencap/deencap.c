@@ -54,6 +54,7 @@
 #include "header.h"
 #include "crc.h"
 #include "header_fields.h"
+#include "cache.h"
 
 
 /****************************************************************************
@@ -62,24 +63,81 @@
  *
  ****************************************************************************/
 
-/** Deencapsulation context */
+/** Deencapsulation context
+ *
+ *  The state read for each BBFrame and updated for each fragment, the
+ *  contexts of the successive FragIDs share the cache lines.
+ */
 typedef struct
 {
   gse_vfrag_t *partial_pdu;    /**< Virtual buffer containing the PDU chunks */
+  uint32_t crc;                /**< CRC32 computed with chunks of PDU */
+  uint16_t bbframe_nbr;        /**< Number of BB Frames since the reception of
+                                    first fragment, saturated after the
+                                    timeout */
+  uint8_t streaming;           /**< Whether the PDU chunks are given to the
+                                    sink instead of being stored */
+  uint8_t crc_deferred;        /**< Whether the CRC32 of the PDU data is
+                                    computed once the PDU is queued */
+} gse_deencap_ctx_t;
+
+/** Header fields of a deencapsulation context
+ *
+ *  Only read with the first and the last fragments or by the sink, they are
+ *  kept apart from the context state.
+ */
+typedef struct
+{
   gse_label_t label;           /**< Label field value */
   uint16_t total_length;       /**< Total length field value */
-  size_t tot_ext_length;       /**< The length of extensions */
   uint16_t protocol_type;      /**< Protocol type field value */
   gse_label_type_t label_type; /**< Label type field value */
-  unsigned int bbframe_nbr;    /**< Number of BB Frames since the reception of
-                                    first fragment */
-  uint32_t crc;                /**< CRC32 computed with chunks of PDU */
-} gse_deencap_ctx_t;
+  size_t tot_ext_length;       /**< The length of extensions */
+  size_t pdu_length;           /**< PDU length given by Total Length when
+                                    streaming */
+  size_t stream_length;        /**< Length of the PDU data given to the
+                                    sink */
+  size_t pool_length;          /**< Length reserved in the reassembly pool
+                                    for the PDU, 0 if it is not in the pool */
+} gse_deencap_ctx_info_t;
+
+/** PDU waiting in the CRC verification queue */
+typedef struct
+{
+  gse_vfrag_t *pdu;            /**< The PDU with the deencapsulation offsets */
+  uint32_t crc;                /**< The header part of the CRC32 until the
+                                    PDU is verified */
+  uint32_t rcv_crc;            /**< The received CRC32 */
+  int verified;                /**< Whether the CRC32 was checked */
+  gse_status_t status;         /**< The status of the PDU once verified */
+  gse_label_t label;           /**< Label field value */
+  gse_label_type_t label_type; /**< Label type field value */
+  uint16_t protocol_type;      /**< Protocol type field value */
+} gse_deencap_queued_pdu_t;
+
+/** The maximum number of PDUs verified together */
+#define GSE_DEENCAP_MAX_CRC_BATCH 64
+
+/** The number of deencapsulation contexts allocated with the first
+ *  fragment */
+#define GSE_DEENCAP_CTX_MIN_NBR 4
+
+/** The number of deencapsulation structures allocated in a reassembly pool
+ *  with the first one */
+#define GSE_DEENCAP_POOL_MIN_SIZE 8
+
+/** The number of PDUs allocated in the CRC verification queue at first */
+#define GSE_DEENCAP_CRC_QUEUE_MIN_SIZE 16
 
 /** Deencapsulation structure */
 struct gse_deencap_s
 {
-  gse_deencap_ctx_t *deencap_ctx; /**< Table of deencapsulation contexts */
+  gse_deencap_ctx_t *deencap_ctx; /**< Table of deencapsulation contexts,
+                                       NULL until the first fragment */
+  gse_deencap_ctx_info_t *deencap_ctx_info; /**< Table of the header fields
+                                                 of the contexts */
+  unsigned int ctx_nbr;           /**< Number of contexts allocated in the
+                                       table */
   size_t head_offset;             /**< Offset applied on the beginning of the
                                        returned PDU (default: 0) */
   size_t trail_offset;            /**< Offset applied on the end of the
@@ -89,6 +147,33 @@ struct gse_deencap_s
   /**> Callback to read header extensions */
   gse_deencap_read_header_ext_cb_t read_header_ext;
   void *opaque;                   /**< User specific data for extension callback */
+  gse_deencap_sink_cb_t sink;     /**< Callback receiving the fragmented PDUs,
+                                       NULL to store them */
+  void *sink_opaque;              /**< User specific data for sink callback */
+  unsigned int crc_batch;         /**< Number of PDUs verified together, 0 if
+                                       the CRC32 is verified right away */
+  gse_deencap_queued_pdu_t *crc_queue; /**< Circular table of the PDUs
+                                            waiting to be returned */
+  size_t crc_queue_size;          /**< Size of the CRC verification queue */
+  size_t crc_queue_first;         /**< Index of the oldest queued PDU */
+  size_t crc_queue_nbr;           /**< Number of queued PDUs */
+  gse_deencap_pool_t *pool;       /**< Reassembly pool of the fragmented PDUs,
+                                       NULL if they are not bounded */
+};
+
+/** Reassembly pool */
+struct gse_deencap_pool_s
+{
+  size_t max_length;              /**< Maximum length of the PDUs being
+                                       reassembled */
+  size_t used_length;             /**< Length of the PDUs being reassembled */
+  unsigned long evicted_nbr;      /**< Number of PDUs evicted to make room */
+  gse_deencap_t **deencaps;       /**< Table of the deencapsulation
+                                       structures using the pool */
+  unsigned int deencap_nbr;       /**< Number of deencapsulation structures
+                                       using the pool */
+  unsigned int deencap_size;      /**< Size of the table of deencapsulation
+                                       structures */
 };
 
 
@@ -108,6 +193,30 @@ struct gse_deencap_s
  */
 static uint8_t gse_deencap_get_qos_nbr(gse_deencap_t *const deencap);
 
+/**
+ *  @brief   Deencapsulate a GSE packet
+ *
+ *  @param   packet      The GSE packet, destroyed by the function
+ *  @param   header      The header of the GSE packet
+ *  @param   deencap     The deencapsulation structure
+ *  @param   label_type  OUT: The label type of the returned PDU
+ *  @param   label       OUT: The label of the returned PDU
+ *  @param   protocol    OUT: The protocol of the returned PDU
+ *  @param   pdu         OUT: The PDU if it is complete and not queued
+ *  @param   in_frame    Whether the packet shares its buffer with the next
+ *                       packets of a BBFrame, the PDUs are then queued
+ *
+ *  @return              The codes of \ref gse_deencap_packet
+ */
+static gse_status_t gse_deencap_handle_packet(gse_vfrag_t *packet,
+                                              gse_header_t header,
+                                              gse_deencap_t *deencap,
+                                              uint8_t *label_type,
+                                              uint8_t label[6],
+                                              uint16_t *protocol,
+                                              gse_vfrag_t **pdu,
+                                              int in_frame);
+
 /**
  *  @brief   Create deencapsulation context
  *
@@ -115,6 +224,8 @@ static uint8_t gse_deencap_get_qos_nbr(gse_deencap_t *const deencap);
  *  @param   deencap      The deencapsulation structure
  *  @param   header       Header of the GSE packet carrying data
  *  @param   crc          The header part of CRC32
+ *  @param   in_frame     Whether the packet shares its buffer with the next
+ *                        packets of a BBFrame, the fragment is then copied
  *
  *  @return
  *                        - success/informative code among:
@@ -133,7 +244,7 @@ static uint8_t gse_deencap_get_qos_nbr(gse_deencap_t *const deencap);
 static gse_status_t gse_deencap_create_ctx(gse_vfrag_t *partial_pdu,
                                            gse_deencap_t *deencap,
                                            gse_header_t header,
-                                           uint32_t crc);
+                                           uint32_t crc, int in_frame);
 
 /**
  *  @brief   Fill deencapsulation context with fragments
@@ -181,7 +292,192 @@ static gse_status_t gse_deencap_add_frag(gse_vfrag_t *data, gse_deencap_t *deenc
  */
 static gse_status_t gse_deencap_add_last_frag(gse_vfrag_t *data,
                                               gse_deencap_t *deencap,
-                                              gse_header_t header);
+                                              gse_header_t header,
+                                              uint32_t *rcv_crc);
+
+/**
+ *  @brief   Start giving a fragmented PDU to the sink
+ *
+ *  @param   partial_pdu  The GSE packet received
+ *  @param   deencap      The deencapsulation structure
+ *  @param   header       Header of the GSE packet carrying data
+ *  @param   crc          The header part of CRC32
+ *
+ *  @return
+ *                        - success/informative code among:
+ *                          - \ref GSE_STATUS_OK
+ *                          - \ref GSE_STATUS_DATA_OVERWRITTEN
+ *                        - warning/error code among:
+ *                          - \ref GSE_STATUS_INVALID_QOS
+ *                          - \ref GSE_STATUS_INVALID_LABEL
+ *                          - \ref GSE_STATUS_NO_SPACE_IN_BUFF
+ *                          - \ref GSE_STATUS_SINK_CB_FAILED
+ */
+static gse_status_t gse_deencap_start_stream(gse_vfrag_t *partial_pdu,
+                                             gse_deencap_t *deencap,
+                                             gse_header_t header,
+                                             uint32_t crc);
+
+/**
+ *  @brief   Give a subsequent or last fragment to the sink
+ *
+ *  @param   partial_pdu  The GSE packet received
+ *  @param   deencap      The deencapsulation structure
+ *  @param   header       Header of the GSE packet carrying data
+ *  @param   last         Whether the fragment is the last one
+ *
+ *  @return
+ *                        - success/informative code among:
+ *                          - \ref GSE_STATUS_OK
+ *                          - \ref GSE_STATUS_PDU_STREAMED
+ *                        - warning/error code among:
+ *                          - \ref GSE_STATUS_INVALID_LT
+ *                          - \ref GSE_STATUS_TIMEOUT
+ *                          - \ref GSE_STATUS_NO_SPACE_IN_BUFF
+ *                          - \ref GSE_STATUS_PTR_OUTSIDE_BUFF
+ *                          - \ref GSE_STATUS_FRAG_PTRS
+ *                          - \ref GSE_STATUS_INVALID_DATA_LENGTH
+ *                          - \ref GSE_STATUS_INVALID_CRC
+ *                          - \ref GSE_STATUS_SINK_CB_FAILED
+ */
+static gse_status_t gse_deencap_add_stream_frag(gse_vfrag_t *partial_pdu,
+                                                gse_deencap_t *deencap,
+                                                gse_header_t header,
+                                                int last);
+
+/**
+ *  @brief   Give an event of the PDU of a context to the sink
+ *
+ *  @param   deencap  The deencapsulation structure
+ *  @param   frag_id  The FragID of the context
+ *  @param   event    The event
+ *  @param   data     The chunk of PDU data, NULL if there is no data
+ *  @param   length   The length of the chunk
+ *
+ *  @return           The value returned by the sink callback
+ */
+static int gse_deencap_call_sink(gse_deencap_t *deencap, uint8_t frag_id,
+                                 gse_sink_event_t event,
+                                 const unsigned char *data, size_t length);
+
+/**
+ *  @brief   Drop the PDU of a deencapsulation context
+ *
+ *  The stored fragments are freed and the PDU given to the sink is aborted.
+ *
+ *  @param   deencap  The deencapsulation structure
+ *  @param   frag_id  The FragID of the context
+ *
+ *  @return           1 if there was a PDU in the context, 0 otherwise
+ */
+static int gse_deencap_drop_ctx(gse_deencap_t *deencap, uint8_t frag_id);
+
+/**
+ *  @brief   Get the deencapsulation context of a FragID
+ *
+ *  @param   deencap  The deencapsulation structure
+ *  @param   frag_id  The FragID of the context
+ *
+ *  @return           The context, NULL if it was never allocated
+ */
+static gse_deencap_ctx_t *gse_deencap_get_ctx(gse_deencap_t *deencap,
+                                              uint8_t frag_id);
+
+/**
+ *  @brief   Get the deencapsulation context of a FragID, allocate it if needed
+ *
+ *  The tables of contexts are enlarged up to the FragID, the new contexts are
+ *  empty.
+ *
+ *  @param   deencap  The deencapsulation structure
+ *  @param   frag_id  The FragID of the context, lower than the QoS number
+ *  @param   ctx      OUT: The context
+ *
+ *  @return
+ *                    - success/informative code among:
+ *                      - \ref GSE_STATUS_OK
+ *                    - warning/error code among:
+ *                      - \ref GSE_STATUS_MALLOC_FAILED
+ */
+static gse_status_t gse_deencap_alloc_ctx(gse_deencap_t *deencap,
+                                          uint8_t frag_id,
+                                          gse_deencap_ctx_t **ctx);
+
+/**
+ *  @brief   Free the PDU stored in a deencapsulation context
+ *
+ *  The length reserved for the PDU in the reassembly pool is given back.
+ *
+ *  @param   deencap  The deencapsulation structure
+ *  @param   frag_id  The FragID of the context
+ *
+ *  @return           The status of \ref gse_free_vfrag
+ */
+static gse_status_t gse_deencap_free_partial_pdu(gse_deencap_t *deencap,
+                                                 uint8_t frag_id);
+
+/**
+ *  @brief   Reserve a length in the reassembly pool
+ *
+ *  The oldest PDUs being reassembled by the deencapsulation structures of the
+ *  pool are evicted until the length fits.
+ *
+ *  @param   pool    The reassembly pool
+ *  @param   length  The length to reserve
+ *
+ *  @return
+ *                   - success/informative code among:
+ *                     - \ref GSE_STATUS_OK
+ *                   - warning/error code among:
+ *                     - \ref GSE_STATUS_POOL_FULL
+ */
+static gse_status_t gse_deencap_pool_reserve(gse_deencap_pool_t *pool,
+                                             size_t length);
+
+/**
+ *  @brief   Stop using the reassembly pool
+ *
+ *  The PDUs being reassembled are kept but they are no longer accounted in
+ *  the pool.
+ *
+ *  @param   deencap  The deencapsulation structure
+ */
+static void gse_deencap_detach_pool(gse_deencap_t *deencap);
+
+/**
+ *  @brief   Add a PDU at the end of the CRC verification queue
+ *
+ *  @param   deencap     The deencapsulation structure
+ *  @param   pdu         The PDU, owned by the queue on success
+ *  @param   label_type  The label type of the PDU
+ *  @param   label       The label of the PDU
+ *  @param   protocol    The protocol of the PDU
+ *  @param   verify      Whether the CRC32 of the PDU shall be verified
+ *  @param   crc         The header part of the CRC32 if verify is set
+ *  @param   rcv_crc     The received CRC32 if verify is set
+ *
+ *  @return
+ *                       - success/informative code among:
+ *                         - \ref GSE_STATUS_PDU_QUEUED
+ *                       - warning/error code among:
+ *                         - \ref GSE_STATUS_MALLOC_FAILED
+ */
+static gse_status_t gse_deencap_queue_pdu(gse_deencap_t *deencap,
+                                          gse_vfrag_t *pdu,
+                                          gse_label_type_t label_type,
+                                          uint8_t label[6], uint16_t protocol,
+                                          int verify, uint32_t crc,
+                                          uint32_t rcv_crc);
+
+/**
+ *  @brief   Verify the CRC32 of the next queued PDUs together
+ *
+ *  Up to crc_batch PDUs that are not verified yet are verified, starting
+ *  with the oldest one.
+ *
+ *  @param   deencap  The deencapsulation structure
+ */
+static void gse_deencap_verify_queue(gse_deencap_t *deencap);
 
 /**
  *  @brief   Compute PDU length from total length field
@@ -245,15 +541,8 @@ gse_status_t gse_deencap_init(uint8_t qos_nbr, gse_deencap_t **deencap)
     goto error;
   }
 
-  /* Create as deencapsulation contexts as QoS values
-   * The context are initialized to 0 because on release, virtual fragments
-   * contained by context must be destroyed only if they exist */
-  (*deencap)->deencap_ctx = calloc(qos_nbr, sizeof(gse_deencap_ctx_t));
-  if((*deencap)->deencap_ctx == NULL)
-  {
-    status = GSE_STATUS_MALLOC_FAILED;
-    goto free_deencap;
-  }
+  /* The deencapsulation contexts are allocated when the first fragment of
+   * a FragID is received, so that the unused FragIDs cost nothing */
   (*deencap)->qos_nbr = qos_nbr;
 
   /* Initialize the offsets of the virtual buffers of the PDUs to 0 by default */
@@ -285,12 +574,31 @@ gse_status_t gse_deencap_release(gse_deencap_t *deencap)
     goto error;
   }
 
+  /* Release the PDUs waiting for their CRC32 verification */
+  while(deencap->crc_queue_nbr > 0)
+  {
+    gse_free_vfrag(&(deencap->crc_queue[deencap->crc_queue_first].pdu));
+    deencap->crc_queue_first = (deencap->crc_queue_first + 1) %
+                               deencap->crc_queue_size;
+    deencap->crc_queue_nbr--;
+  }
+  free(deencap->crc_queue);
+
+  if(deencap->pool != NULL)
+  {
+    gse_deencap_detach_pool(deencap);
+  }
+
   /* Release each context */
-  for(i = 0; i < gse_deencap_get_qos_nbr(deencap); i++)
+  for(i = 0; i < deencap->ctx_nbr; i++)
   {
+    if(deencap->deencap_ctx[i].streaming)
+    {
+      gse_deencap_drop_ctx(deencap, i);
+    }
     if(deencap->deencap_ctx[i].partial_pdu != NULL)
     {
-      status = gse_free_vfrag(&(deencap->deencap_ctx[i].partial_pdu));
+      status = gse_deencap_free_partial_pdu(deencap, i);
       if(status != GSE_STATUS_OK)
       {
         stat_mem = status;
@@ -298,6 +606,7 @@ gse_status_t gse_deencap_release(gse_deencap_t *deencap)
     }
   }
   free(deencap->deencap_ctx);
+  free(deencap->deencap_ctx_info);
   free(deencap);
 
   return stat_mem;
@@ -327,13 +636,6 @@ gse_status_t gse_deencap_packet(gse_vfrag_t *data, gse_deencap_t *deencap,
   gse_status_t status = GSE_STATUS_OK;
 
   gse_header_t header;
-  gse_payload_type_t payload_type;
-  size_t header_length;
-  size_t head_offset;
-  size_t field_length;
-  uint16_t data_length;
-  int label_length;
-  uint32_t crc = GSE_CRC_INIT;
   gse_vfrag_t *packet;
 
   if((data == NULL) || (deencap == NULL) || (label_type == NULL) ||
@@ -382,93 +684,464 @@ gse_status_t gse_deencap_packet(gse_vfrag_t *data, gse_deencap_t *deencap,
    * The error are not treated because the data are correctly saved */
   gse_free_vfrag(&data);
 
-  if(packet->length < GSE_MIN_PACKET_LENGTH)
+  return gse_deencap_handle_packet(packet, header, deencap, label_type, label,
+                                   protocol, pdu, 0);
+free_data:
+  gse_free_vfrag(&data);
+error:
+  return status;
+}
+
+gse_status_t gse_deencap_bbframe(gse_vfrag_t *bbframe, gse_deencap_t *deencap,
+                                 gse_bbheader_t *bbheader)
+{
+  gse_status_t status;
+  gse_status_t packet_status = GSE_STATUS_OK;
+
+  if(bbframe == NULL || deencap == NULL || bbheader == NULL)
   {
-    status = GSE_STATUS_PACKET_TOO_SMALL;
-    goto free_packet;
+    status = GSE_STATUS_NULL_PTR;
+    goto error;
   }
 
-  /* Get the payload type with S and E values:
-   *    - '00': subsequent fragment (but not the last one)
-   *    - '01': last fragment
-   *    - '10': first fragment
-   *    - '11': complete PDU
-   */
-  if(header.s == 0x1)
+  status = gse_parse_bbheader(bbframe->start, bbframe->length, bbheader);
+  if(status != GSE_STATUS_OK)
   {
-    if(header.e == 0x1)
+    goto free_bbframe;
+  }
+  gse_deencap_new_bbframe(deencap);
+
+  /* Keep the data field only, the BBFrame padding is ignored */
+  status = gse_shift_vfrag(bbframe, GSE_BBHEADER_LENGTH,
+                           (int)(bbheader->dfl / 8) -
+                           (int)(bbframe->length - GSE_BBHEADER_LENGTH));
+  if(status != GSE_STATUS_OK)
+  {
+    goto free_bbframe;
+  }
+
+  /* The GSE packets share the BBFrame buffer, they are deencapsulated one
+   * after the other */
+  while(bbframe->length > 0)
+  {
+    gse_header_t header;
+    gse_vfrag_t *packet;
+    gse_vfrag_t *pdu = NULL;
+    uint8_t label_type;
+    uint8_t label[6];
+    uint16_t protocol;
+    size_t packet_length;
+
+    if(bbframe->length < GSE_MIN_PACKET_LENGTH)
     {
-      payload_type = GSE_PDU_COMPLETE;
+      packet_status = GSE_STATUS_PACKET_TOO_SMALL;
+      break;
     }
-    else
+    memcpy(&header, bbframe->start, MIN(sizeof(gse_header_t), bbframe->length));
+
+    /* The rest of the data field is padding */
+    if((header.s == 0x0) && (header.e == 0x0) && (header.lt == 0x0))
     {
-      payload_type = GSE_PDU_FIRST_FRAG;
+      break;
     }
-  }
-  else
-  {
-    if(header.e == 0x1)
+
+    packet_length = (((uint16_t)header.gse_length_hi << 8) |
+                     header.gse_length_lo) + GSE_MANDATORY_FIELDS_LENGTH;
+    if(packet_length > bbframe->length)
     {
-      payload_type = GSE_PDU_LAST_FRAG;
+      packet_status = GSE_STATUS_INVALID_GSE_LENGTH;
+      break;
     }
-    else
+    status = gse_duplicate_vfrag(&packet, bbframe, packet_length);
+    if(status != GSE_STATUS_OK)
     {
-      payload_type = GSE_PDU_SUBS_FRAG;
+      goto free_bbframe;
+    }
+    status = gse_shift_vfrag(bbframe, packet_length, 0);
+    if(status != GSE_STATUS_OK)
+    {
+      gse_free_vfrag(&packet);
+      goto free_bbframe;
     }
-  }
 
-  /* Determine the length of the label of the GSE packet */
-  label_length = gse_get_label_length(header.lt);
-  if(label_length < 0)
-  {
-    goto free_packet;
+    /* The PDUs are queued, a packet in error does not prevent the next ones
+     * from being deencapsulated */
+    status = gse_deencap_handle_packet(packet, header, deencap, &label_type,
+                                      label, &protocol, &pdu, 1);
+    assert(pdu == NULL);
+    if(status != GSE_STATUS_OK && status != GSE_STATUS_PDU_QUEUED &&
+       status != GSE_STATUS_PDU_STREAMED && packet_status == GSE_STATUS_OK)
+    {
+      packet_status = status;
+    }
   }
+  status = packet_status;
 
-  /* Determine the length of the GSE header */
-  header_length = gse_compute_header_length(payload_type, header.lt);
-  if(header_length == 0)
-  {
-    status = GSE_STATUS_INTERNAL_ERROR;
-    goto free_packet;
-  }
-  if(header_length > packet->length)
+free_bbframe:
+  gse_free_vfrag(&bbframe);
+error:
+  return status;
+}
+
+gse_status_t gse_deencap_new_bbframe(gse_deencap_t *deencap)
+{
+  unsigned int i;
+
+  if(deencap == NULL)
   {
-    status = GSE_STATUS_INVALID_HEADER;
-    goto free_packet;
+    return GSE_STATUS_NULL_PTR;
   }
 
-  /* Check if the last fragment contain at least the complete CRC */
-  data_length = packet->length - header_length;
-  if((payload_type == GSE_PDU_LAST_FRAG) && (data_length < GSE_MAX_TRAILER_LENGTH))
+  for(i = 0 ; i < deencap->ctx_nbr ; i++)
   {
-    status = GSE_STATUS_CRC_FRAGMENTED;
-    goto free_packet;
+    if((deencap->deencap_ctx[i].partial_pdu != NULL ||
+        deencap->deencap_ctx[i].streaming) &&
+       deencap->deencap_ctx[i].bbframe_nbr <= 255)
+    {
+      deencap->deencap_ctx[i].bbframe_nbr++;
+    }
   }
 
-  /* Compute the header part of the CRC32 if the fragment is a first one */
-  if(payload_type == GSE_PDU_FIRST_FRAG)
+  return GSE_STATUS_OK;
+}
+
+gse_status_t gse_deencap_set_extension_callback(gse_deencap_t *deencap,
+                                                gse_deencap_read_header_ext_cb_t callback,
+                                                void *opaque)
+{
+  if(deencap == NULL)
   {
-    head_offset = GSE_MANDATORY_FIELDS_LENGTH + GSE_FRAG_ID_LENGTH;
-    field_length = GSE_TOTAL_LENGTH_LENGTH + GSE_PROTOCOL_TYPE_LENGTH +
-                   gse_get_label_length(header.lt);
-    crc = gse_deencap_compute_crc(packet->start + head_offset, field_length,
-                                  GSE_CRC_INIT);
+    return GSE_STATUS_NULL_PTR;
   }
 
-  /* Move fragment start pointer to the beginning of data field */
-  status = gse_shift_vfrag(packet, header_length, 0);
-  if(status != GSE_STATUS_OK)
+  deencap->read_header_ext = callback;
+  deencap->opaque = opaque;
+
+  return GSE_STATUS_OK;
+}
+
+gse_status_t gse_deencap_set_sink(gse_deencap_t *deencap,
+                                  gse_deencap_sink_cb_t callback,
+                                  void *opaque)
+{
+  unsigned int i;
+
+  if(deencap == NULL)
   {
-    goto free_packet;
+    return GSE_STATUS_NULL_PTR;
   }
 
-  /* Deencapsulate the GSE packet according to its payload */
-  switch(payload_type)
+  /* The next fragments of the PDUs given to the previous sink would be
+   * missing their beginning */
+  for(i = 0 ; i < deencap->ctx_nbr ; i++)
   {
-    /* GSE packet carrying a complete PDU */
-    case GSE_PDU_COMPLETE:
+    if(deencap->deencap_ctx[i].streaming)
     {
-      size_t tot_ext_length = 0;
+      gse_deencap_drop_ctx(deencap, i);
+    }
+  }
+  deencap->sink = callback;
+  deencap->sink_opaque = opaque;
+
+  return GSE_STATUS_OK;
+}
+
+gse_status_t gse_deencap_set_deferred_crc(gse_deencap_t *deencap,
+                                          unsigned int batch)
+{
+  if(deencap == NULL)
+  {
+    return GSE_STATUS_NULL_PTR;
+  }
+
+  deencap->crc_batch = MIN(batch, GSE_DEENCAP_MAX_CRC_BATCH);
+
+  return GSE_STATUS_OK;
+}
+
+gse_status_t gse_deencap_get_pdu(gse_deencap_t *deencap,
+                                 uint8_t *label_type, uint8_t label[6],
+                                 uint16_t *protocol, gse_vfrag_t **pdu)
+{
+  gse_status_t status;
+  gse_deencap_queued_pdu_t *queued;
+  int label_length;
+
+  if((deencap == NULL) || (label_type == NULL) || (label == NULL) ||
+     (protocol == NULL) || (pdu == NULL))
+  {
+    return GSE_STATUS_NULL_PTR;
+  }
+  *pdu = NULL;
+
+  if(deencap->crc_queue_nbr == 0)
+  {
+    return GSE_STATUS_NO_PDU_QUEUED;
+  }
+  queued = &(deencap->crc_queue[deencap->crc_queue_first]);
+  if(!queued->verified)
+  {
+    gse_deencap_verify_queue(deencap);
+  }
+  assert(queued->verified);
+
+  *label_type = queued->label_type;
+  label_length = gse_get_label_length(queued->label_type);
+  if(label_length > 0)
+  {
+    memcpy(label, &(queued->label), label_length);
+  }
+  *protocol = queued->protocol_type;
+  status = queued->status;
+  if(status == GSE_STATUS_PDU_RECEIVED)
+  {
+    *pdu = queued->pdu;
+    queued->pdu = NULL;
+  }
+  else
+  {
+    gse_free_vfrag(&(queued->pdu));
+  }
+  deencap->crc_queue_first = (deencap->crc_queue_first + 1) %
+                             deencap->crc_queue_size;
+  deencap->crc_queue_nbr--;
+
+  return status;
+}
+
+gse_status_t gse_deencap_get_footprint(gse_deencap_t *deencap,
+                                       size_t *footprint)
+{
+  if(deencap == NULL || footprint == NULL)
+  {
+    return GSE_STATUS_NULL_PTR;
+  }
+
+  *footprint = sizeof(gse_deencap_t) +
+               deencap->ctx_nbr * (sizeof(gse_deencap_ctx_t) +
+                                   sizeof(gse_deencap_ctx_info_t)) +
+               deencap->crc_queue_size * sizeof(gse_deencap_queued_pdu_t);
+
+  return GSE_STATUS_OK;
+}
+
+gse_status_t gse_deencap_pool_init(size_t max_length,
+                                   gse_deencap_pool_t **pool)
+{
+  if(pool == NULL)
+  {
+    return GSE_STATUS_NULL_PTR;
+  }
+
+  /* The table of deencapsulation structures is allocated with the first
+   * one */
+  *pool = calloc(1, sizeof(gse_deencap_pool_t));
+  if(*pool == NULL)
+  {
+    return GSE_STATUS_MALLOC_FAILED;
+  }
+  (*pool)->max_length = max_length;
+
+  return GSE_STATUS_OK;
+}
+
+gse_status_t gse_deencap_pool_release(gse_deencap_pool_t *pool)
+{
+  if(pool == NULL)
+  {
+    return GSE_STATUS_NULL_PTR;
+  }
+
+  while(pool->deencap_nbr > 0)
+  {
+    gse_deencap_detach_pool(pool->deencaps[0]);
+  }
+  free(pool->deencaps);
+  free(pool);
+
+  return GSE_STATUS_OK;
+}
+
+gse_status_t gse_deencap_set_pool(gse_deencap_t *deencap,
+                                  gse_deencap_pool_t *pool)
+{
+  gse_deencap_t **deencaps;
+  unsigned int size;
+
+  if(deencap == NULL)
+  {
+    return GSE_STATUS_NULL_PTR;
+  }
+  if(deencap->pool == pool)
+  {
+    return GSE_STATUS_OK;
+  }
+
+  if(pool != NULL && pool->deencap_nbr >= pool->deencap_size)
+  {
+    size = (pool->deencap_size > 0 ? pool->deencap_size * 2 :
+                                     GSE_DEENCAP_POOL_MIN_SIZE);
+    deencaps = realloc(pool->deencaps, size * sizeof(gse_deencap_t *));
+    if(deencaps == NULL)
+    {
+      return GSE_STATUS_MALLOC_FAILED;
+    }
+    pool->deencaps = deencaps;
+    pool->deencap_size = size;
+  }
+
+  /* The PDUs being reassembled stay out of the new pool */
+  if(deencap->pool != NULL)
+  {
+    gse_deencap_detach_pool(deencap);
+  }
+  if(pool != NULL)
+  {
+    pool->deencaps[pool->deencap_nbr] = deencap;
+    pool->deencap_nbr++;
+    deencap->pool = pool;
+  }
+
+  return GSE_STATUS_OK;
+}
+
+gse_status_t gse_deencap_pool_get_usage(gse_deencap_pool_t *pool,
+                                        size_t *used_length,
+                                        unsigned long *evicted_nbr)
+{
+  if(pool == NULL || used_length == NULL || evicted_nbr == NULL)
+  {
+    return GSE_STATUS_NULL_PTR;
+  }
+
+  *used_length = pool->used_length;
+  *evicted_nbr = pool->evicted_nbr;
+
+  return GSE_STATUS_OK;
+}
+
+
+/****************************************************************************
+ *
+ *   PRIVATE FUNCTIONS
+ *
+ ****************************************************************************/
+
+static uint8_t gse_deencap_get_qos_nbr(gse_deencap_t *deencap)
+{
+  assert(deencap != NULL);
+
+  return deencap->qos_nbr;
+}
+
+static gse_status_t gse_deencap_handle_packet(gse_vfrag_t *packet,
+                                              gse_header_t header,
+                                              gse_deencap_t *deencap,
+                                              uint8_t *label_type,
+                                              uint8_t label[6],
+                                              uint16_t *protocol,
+                                              gse_vfrag_t **pdu,
+                                              int in_frame)
+{
+  gse_status_t status = GSE_STATUS_OK;
+
+  gse_payload_type_t payload_type;
+  size_t header_length;
+  size_t head_offset;
+  size_t field_length;
+  uint16_t data_length;
+  int label_length;
+  uint32_t crc = GSE_CRC_INIT;
+  gse_deencap_ctx_t *ctx;
+  gse_deencap_ctx_info_t *info;
+
+  if(packet->length < GSE_MIN_PACKET_LENGTH)
+  {
+    status = GSE_STATUS_PACKET_TOO_SMALL;
+    goto free_packet;
+  }
+
+  /* Get the payload type with S and E values:
+   *    - '00': subsequent fragment (but not the last one)
+   *    - '01': last fragment
+   *    - '10': first fragment
+   *    - '11': complete PDU
+   */
+  if(header.s == 0x1)
+  {
+    if(header.e == 0x1)
+    {
+      payload_type = GSE_PDU_COMPLETE;
+    }
+    else
+    {
+      payload_type = GSE_PDU_FIRST_FRAG;
+    }
+  }
+  else
+  {
+    if(header.e == 0x1)
+    {
+      payload_type = GSE_PDU_LAST_FRAG;
+    }
+    else
+    {
+      payload_type = GSE_PDU_SUBS_FRAG;
+    }
+  }
+
+  /* Determine the length of the label of the GSE packet */
+  label_length = gse_get_label_length(header.lt);
+  if(label_length < 0)
+  {
+    goto free_packet;
+  }
+
+  /* Determine the length of the GSE header */
+  header_length = gse_compute_header_length(payload_type, header.lt);
+  if(header_length == 0)
+  {
+    status = GSE_STATUS_INTERNAL_ERROR;
+    goto free_packet;
+  }
+  if(header_length > packet->length)
+  {
+    status = GSE_STATUS_INVALID_HEADER;
+    goto free_packet;
+  }
+
+  /* Check if the last fragment contain at least the complete CRC */
+  data_length = packet->length - header_length;
+  if((payload_type == GSE_PDU_LAST_FRAG) && (data_length < GSE_MAX_TRAILER_LENGTH))
+  {
+    status = GSE_STATUS_CRC_FRAGMENTED;
+    goto free_packet;
+  }
+
+  /* Compute the header part of the CRC32 if the fragment is a first one */
+  if(payload_type == GSE_PDU_FIRST_FRAG)
+  {
+    head_offset = GSE_MANDATORY_FIELDS_LENGTH + GSE_FRAG_ID_LENGTH;
+    field_length = GSE_TOTAL_LENGTH_LENGTH + GSE_PROTOCOL_TYPE_LENGTH +
+                   gse_get_label_length(header.lt);
+    crc = gse_deencap_compute_crc(packet->start + head_offset, field_length,
+                                  GSE_CRC_INIT);
+  }
+
+  /* Move fragment start pointer to the beginning of data field */
+  status = gse_shift_vfrag(packet, header_length, 0);
+  if(status != GSE_STATUS_OK)
+  {
+    goto free_packet;
+  }
+
+  /* Deencapsulate the GSE packet according to its payload */
+  switch(payload_type)
+  {
+    /* GSE packet carrying a complete PDU */
+    case GSE_PDU_COMPLETE:
+    {
+      size_t tot_ext_length = 0;
       
       *protocol = ntohs(header.complete_s.protocol_type);
       /* read header extensions (but do not handle LLC as extension headers) */
@@ -527,7 +1200,6 @@ gse_status_t gse_deencap_packet(gse_vfrag_t *data, gse_deencap_t *deencap,
         status = GSE_STATUS_INVALID_LABEL;
         goto free_packet;
       }
-      *protocol = ntohs(header.complete_s.protocol_type);
       *pdu = packet;
 
       /* Create the virtual buffer containing the PDU with appropriated offsets */
@@ -541,13 +1213,32 @@ gse_status_t gse_deencap_packet(gse_vfrag_t *data, gse_deencap_t *deencap,
         goto error;
       }
       status = GSE_STATUS_PDU_RECEIVED;
+
+      /* The PDU is returned after the PDUs queued before it */
+      if(deencap->crc_batch > 0 || in_frame)
+      {
+        status = gse_deencap_queue_pdu(deencap, *pdu, *label_type, label,
+                                       *protocol, 0, 0, 0);
+        *pdu = NULL;
+      }
     }
     break;
 
     /* GSE packet carrying a first fragment of PDU */
     case GSE_PDU_FIRST_FRAG:
     {
-      status = gse_deencap_create_ctx(packet, deencap, header, crc);
+      /* The extensions are read once the PDU is complete, so the PDUs with
+       * extensions are stored even with a sink */
+      if(deencap->sink != NULL &&
+         !gse_is_ext_hdr(ntohs(header.first_frag_s.protocol_type)))
+      {
+        status = gse_deencap_start_stream(packet, deencap, header, crc);
+      }
+      else
+      {
+        status = gse_deencap_create_ctx(packet, deencap, header, crc,
+                                        in_frame);
+      }
       if(status != GSE_STATUS_OK)
       {
         goto error;
@@ -558,7 +1249,15 @@ gse_status_t gse_deencap_packet(gse_vfrag_t *data, gse_deencap_t *deencap,
     /* GSE packet carrying a subsequent fragment of PDU (but not the last one) */
     case GSE_PDU_SUBS_FRAG:
     {
-      status = gse_deencap_add_frag(packet, deencap, header);
+      ctx = gse_deencap_get_ctx(deencap, header.subs_frag_s.frag_id);
+      if(ctx != NULL && ctx->streaming)
+      {
+        status = gse_deencap_add_stream_frag(packet, deencap, header, 0);
+      }
+      else
+      {
+        status = gse_deencap_add_frag(packet, deencap, header);
+      }
       if(status != GSE_STATUS_OK)
       {
         goto error;
@@ -569,25 +1268,34 @@ gse_status_t gse_deencap_packet(gse_vfrag_t *data, gse_deencap_t *deencap,
     /* GSE packet carrying a last fragment of PDU */
     case GSE_PDU_LAST_FRAG:
     {
-      gse_deencap_ctx_t *ctx;
+      uint32_t rcv_crc;
 
-      status = gse_deencap_add_last_frag(packet, deencap, header);
+      /* The PDU given to the sink is not returned */
+      ctx = gse_deencap_get_ctx(deencap, header.subs_frag_s.frag_id);
+      if(ctx != NULL && ctx->streaming)
+      {
+        status = gse_deencap_add_stream_frag(packet, deencap, header, 1);
+        break;
+      }
+
+      status = gse_deencap_add_last_frag(packet, deencap, header, &rcv_crc);
       if(status != GSE_STATUS_OK)
       {
         goto error;
       }
 
       /*  Create a new fragment in order to free context */
-      ctx = &(deencap->deencap_ctx[header.subs_frag_s.frag_id]);
-      *label_type = ctx->label_type;
-      label_length = gse_get_label_length(ctx->label_type);
+      ctx = gse_deencap_get_ctx(deencap, header.subs_frag_s.frag_id);
+      info = &(deencap->deencap_ctx_info[header.subs_frag_s.frag_id]);
+      *label_type = info->label_type;
+      label_length = gse_get_label_length(info->label_type);
       if(label_length < 0)
       {
         status = GSE_STATUS_INVALID_LT;
         goto error;
       }
-      memcpy(label, &(ctx->label), label_length);
-      *protocol = ctx->protocol_type;
+      memcpy(label, &(info->label), label_length);
+      *protocol = info->protocol_type;
 
       /* Create the virtual buffer containing the PDU with appropriated offsets */
       status = gse_create_vfrag_with_data(pdu, ctx->partial_pdu->length,
@@ -595,12 +1303,22 @@ gse_status_t gse_deencap_packet(gse_vfrag_t *data, gse_deencap_t *deencap,
                                           deencap->trail_offset,
                                           ctx->partial_pdu->start,
                                           ctx->partial_pdu->length);
-      gse_free_vfrag(&(ctx->partial_pdu));
+      gse_deencap_free_partial_pdu(deencap, header.subs_frag_s.frag_id);
       if(status != GSE_STATUS_OK)
       {
         goto error;
       }
       status = GSE_STATUS_PDU_RECEIVED;
+
+      /* The PDU is returned after the PDUs queued before it, once its CRC32
+       * is verified */
+      if(deencap->crc_batch > 0 || in_frame)
+      {
+        status = gse_deencap_queue_pdu(deencap, *pdu, *label_type, label,
+                                       *protocol, ctx->crc_deferred, ctx->crc,
+                                       ntohl(rcv_crc));
+        *pdu = NULL;
+      }
     }
     break;
 
@@ -611,9 +1329,6 @@ gse_status_t gse_deencap_packet(gse_vfrag_t *data, gse_deencap_t *deencap,
       goto free_packet;
   }
 
-  return status;
-free_data:
-  gse_free_vfrag(&data);
   return status;
 free_packet:
   gse_free_vfrag(&packet);
@@ -621,60 +1336,14 @@ error:
   return status;
 }
 
-gse_status_t gse_deencap_new_bbframe(gse_deencap_t *deencap)
-{
-  unsigned int i;
-
-  if(deencap == NULL)
-  {
-    return GSE_STATUS_NULL_PTR;
-  }
-
-  for(i = 0 ; i < gse_deencap_get_qos_nbr(deencap) ; i++)
-  {
-    if(deencap->deencap_ctx[i].partial_pdu != NULL)
-    {
-      deencap->deencap_ctx[i].bbframe_nbr++;
-    }
-  }
-
-  return GSE_STATUS_OK;
-}
-
-gse_status_t gse_deencap_set_extension_callback(gse_deencap_t *deencap,
-                                                gse_deencap_read_header_ext_cb_t callback,
-                                                void *opaque)
-{
-  if(deencap == NULL)
-  {
-    return GSE_STATUS_NULL_PTR;
-  }
-
-  deencap->read_header_ext = callback;
-  deencap->opaque = opaque;
-
-  return GSE_STATUS_OK;
-}
-
-
-/****************************************************************************
- *
- *   PRIVATE FUNCTIONS
- *
- ****************************************************************************/
-
-static uint8_t gse_deencap_get_qos_nbr(gse_deencap_t *deencap)
-{
-  assert(deencap != NULL);
-
-  return deencap->qos_nbr;
-}
 
 static gse_status_t gse_deencap_create_ctx(gse_vfrag_t *partial_pdu, gse_deencap_t *deencap,
-                                           gse_header_t header, uint32_t crc)
+                                           gse_header_t header, uint32_t crc,
+                                           int in_frame)
 {
   gse_status_t status = GSE_STATUS_OK;
   gse_deencap_ctx_t *ctx;
+  gse_deencap_ctx_info_t *info;
   uint16_t pdu_length;
   size_t partial_pdu_start_offset;
 
@@ -695,29 +1364,59 @@ static gse_status_t gse_deencap_create_ctx(gse_vfrag_t *partial_pdu, gse_deencap
     status = GSE_STATUS_EXTENSION_NOT_SUPPORTED;
     goto free_partial_pdu;
   }
-
-  /* Retrieve the context structure */
-  ctx = &(deencap->deencap_ctx[header.first_frag_s.frag_id]);
-
-  /* Compute the data field part of the CRC32 and store it */
-  ctx->crc = gse_deencap_compute_crc(partial_pdu->start, partial_pdu->length, crc);
+
+  /* Retrieve the context structure */
+  status = gse_deencap_alloc_ctx(deencap, header.first_frag_s.frag_id, &ctx);
+  if(status != GSE_STATUS_OK)
+  {
+    goto free_partial_pdu;
+  }
+  info = &(deencap->deencap_ctx_info[header.first_frag_s.frag_id]);
 
   /* Overwrite partial PDU if context is not empty */
-  if(ctx->partial_pdu != NULL)
+  if(gse_deencap_drop_ctx(deencap, header.first_frag_s.frag_id))
   {
     status = GSE_STATUS_DATA_OVERWRITTEN;
-    gse_free_vfrag(&(ctx->partial_pdu));
   }
-  ctx->label_type = header.lt;
-  ctx->total_length = ntohs(header.first_frag_s.total_length);
-  pdu_length = gse_deencap_compute_pdu_length(ctx->total_length, header.lt,
-                                              ctx->tot_ext_length);
+
+  /* Compute the data field part of the CRC32 and store it, the extensions
+   * are read once the PDU is complete so the CRC32 of the PDUs with
+   * extensions is not deferred */
+  ctx->crc_deferred = (deencap->crc_batch > 0 &&
+                       !gse_is_ext_hdr(ntohs(header.first_frag_s.protocol_type)));
+  if(ctx->crc_deferred)
+  {
+    ctx->crc = crc;
+  }
+  else
+  {
+    ctx->crc = gse_deencap_compute_crc(partial_pdu->start, partial_pdu->length,
+                                       crc);
+  }
+  info->label_type = header.lt;
+  info->total_length = ntohs(header.first_frag_s.total_length);
+  info->tot_ext_length = 0;
+  pdu_length = gse_deencap_compute_pdu_length(info->total_length, header.lt,
+                                              info->tot_ext_length);
 
   /* Compute offset from start of buffer to partial PDU start */
   partial_pdu_start_offset = partial_pdu->start - partial_pdu->vbuf->start;
-  /* Check if there is enough space in the virtual buffer for the complete PDU */
-  if((partial_pdu->vbuf->length - partial_pdu_start_offset) < pdu_length)
+  /* Check if there is enough space in the virtual buffer for the complete PDU,
+   * the next fragments cannot be added in a BBFrame */
+  if((partial_pdu->vbuf->length - partial_pdu_start_offset) < pdu_length ||
+     in_frame || deencap->pool != NULL)
   {
+    /* The PDU length is taken from the reassembly pool, the PDUs placed in it
+     * are copied so that only the PDU length is accounted */
+    if(deencap->pool != NULL)
+    {
+      status = gse_deencap_pool_reserve(deencap->pool, pdu_length);
+      if(status != GSE_STATUS_OK)
+      {
+        goto free_partial_pdu;
+      }
+    }
+
     /* Create a new virtual fragment for PDU because current virtual fragment is
      * too small */
     status = gse_create_vfrag_with_data(&(ctx->partial_pdu), pdu_length, 0,
@@ -726,8 +1425,16 @@ static gse_status_t gse_deencap_create_ctx(gse_vfrag_t *partial_pdu, gse_deencap
                                         partial_pdu->length);
     if(status != GSE_STATUS_OK)
     {
+      if(deencap->pool != NULL)
+      {
+        deencap->pool->used_length -= pdu_length;
+      }
       goto free_partial_pdu;
     }
+    if(deencap->pool != NULL)
+    {
+      info->pool_length = pdu_length;
+    }
 
     /* Free the partial PDU because it has been saved in the context
      * The error are not treated because the data are correctly saved */
@@ -737,13 +1444,13 @@ static gse_status_t gse_deencap_create_ctx(gse_vfrag_t *partial_pdu, gse_deencap
   {
     ctx->partial_pdu = partial_pdu;
   }
-  ctx->protocol_type = ntohs(header.first_frag_s.protocol_type);
-  memcpy(&(ctx->label), &(header.first_frag_s.label),
+  info->protocol_type = ntohs(header.first_frag_s.protocol_type);
+  memcpy(&(info->label), &(header.first_frag_s.label),
          gse_get_label_length(header.lt));
 
   /* Check if label is not '00:00:00:00:00:00' */
   if(header.lt == GSE_LT_6_BYTES &&
-     memcmp(&(ctx->label), "\x0\x0\x0\x0\x0\x0", 6) == 0)
+     memcmp(&(info->label), "\x0\x0\x0\x0\x0\x0", 6) == 0)
   {
     status = GSE_STATUS_INVALID_LABEL;
     goto free_vfrag;
@@ -752,10 +1459,7 @@ static gse_status_t gse_deencap_create_ctx(gse_vfrag_t *partial_pdu, gse_deencap
 
   return status;
 free_vfrag:
-  if(ctx != NULL)
-  {
-    gse_free_vfrag(&(ctx->partial_pdu));
-  }
+  gse_deencap_free_partial_pdu(deencap, header.first_frag_s.frag_id);
 free_partial_pdu:
   if(partial_pdu != NULL)
   {
@@ -786,10 +1490,10 @@ static gse_status_t gse_deencap_add_frag(gse_vfrag_t *partial_pdu,
     status = GSE_STATUS_INVALID_QOS;
     goto free_partial_pdu;
   }
-  ctx = &(deencap->deencap_ctx[header.subs_frag_s.frag_id]);
+  ctx = gse_deencap_get_ctx(deencap, header.subs_frag_s.frag_id);
 
   /* Check if context exists for this Frag ID */
-  if(ctx->partial_pdu == NULL)
+  if(ctx == NULL || ctx->partial_pdu == NULL)
   {
     status = GSE_STATUS_CTX_NOT_INIT;
     goto free_partial_pdu;
@@ -817,8 +1521,11 @@ static gse_status_t gse_deencap_add_frag(gse_vfrag_t *partial_pdu,
   }
 
   /* Compute the data field part of the CRC32 and store it */
-  ctx->crc = gse_deencap_compute_crc(partial_pdu->start, partial_pdu->length,
-                                     ctx->crc);
+  if(!ctx->crc_deferred)
+  {
+    ctx->crc = gse_deencap_compute_crc(partial_pdu->start, partial_pdu->length,
+                                       ctx->crc);
+  }
 
   /* Free partial_pdu as it is stored in context
    * The error are not treated because the data are correctly saved */
@@ -826,7 +1533,7 @@ static gse_status_t gse_deencap_add_frag(gse_vfrag_t *partial_pdu,
 
   return status;
 free_ctx:
-  gse_free_vfrag(&(ctx->partial_pdu));
+  gse_deencap_free_partial_pdu(deencap, header.subs_frag_s.frag_id);
 free_partial_pdu:
   gse_free_vfrag(&partial_pdu);
   return status;
@@ -834,11 +1541,12 @@ free_partial_pdu:
 
 static gse_status_t gse_deencap_add_last_frag(gse_vfrag_t *partial_pdu,
                                               gse_deencap_t *deencap,
-                                              gse_header_t header)
+                                              gse_header_t header,
+                                              uint32_t *rcv_crc)
 {
   gse_status_t status = GSE_STATUS_OK;
   gse_deencap_ctx_t *ctx;
-  uint32_t rcv_crc;
+  gse_deencap_ctx_info_t *info;
 
   assert(partial_pdu != NULL);
   assert(deencap != NULL);
@@ -856,13 +1564,14 @@ static gse_status_t gse_deencap_add_last_frag(gse_vfrag_t *partial_pdu,
     goto free_partial_pdu;
   }
 
-  ctx = &(deencap->deencap_ctx[header.subs_frag_s.frag_id]);
+  ctx = gse_deencap_get_ctx(deencap, header.subs_frag_s.frag_id);
   /* Check if context exists for this Frag ID */
-  if(ctx->partial_pdu == NULL)
+  if(ctx == NULL || ctx->partial_pdu == NULL)
   {
     status = GSE_STATUS_CTX_NOT_INIT;
     goto free_partial_pdu;
   }
+  info = &(deencap->deencap_ctx_info[header.subs_frag_s.frag_id]);
 
   /* Move end pointer to the end of the data field */
   status = gse_shift_vfrag(partial_pdu, 0, GSE_MAX_TRAILER_LENGTH * -1);
@@ -872,7 +1581,7 @@ static gse_status_t gse_deencap_add_last_frag(gse_vfrag_t *partial_pdu,
   }
 
   /* Store the received CRC32 */
-  memcpy(&rcv_crc, partial_pdu->end, GSE_MAX_TRAILER_LENGTH);
+  memcpy(rcv_crc, partial_pdu->end, GSE_MAX_TRAILER_LENGTH);
 
   /* Add the fragment to deencapsulation buffer */
   status = gse_deencap_add_frag(partial_pdu, deencap, header);
@@ -883,12 +1592,12 @@ static gse_status_t gse_deencap_add_last_frag(gse_vfrag_t *partial_pdu,
 
   /* read header extensions (when entire data is received because extensions
    * can be fragmented) */
-  ctx->tot_ext_length = 0;
-  if(gse_is_ext_hdr(ctx->protocol_type))
+  info->tot_ext_length = 0;
+  if(gse_is_ext_hdr(info->protocol_type))
   {
     int ret;
     uint16_t protocol_type;
-    uint16_t extension_type = ctx->protocol_type;
+    uint16_t extension_type = info->protocol_type;
 
     if(deencap->read_header_ext == NULL)
     {
@@ -896,8 +1605,9 @@ static gse_status_t gse_deencap_add_last_frag(gse_vfrag_t *partial_pdu,
       goto free_ctx;
     }
 
-    ctx->tot_ext_length = partial_pdu->length;
-    ret = deencap->read_header_ext(partial_pdu->start, &(ctx->tot_ext_length),
+    info->tot_ext_length = ctx->partial_pdu->length;
+    ret = deencap->read_header_ext(ctx->partial_pdu->start,
+                                   &(info->tot_ext_length),
                                    &protocol_type, extension_type,
                                    deencap->opaque);
     if(ret < 0)
@@ -905,25 +1615,25 @@ static gse_status_t gse_deencap_add_last_frag(gse_vfrag_t *partial_pdu,
       status = GSE_STATUS_EXTENSION_CB_FAILED;
       goto free_ctx;
     }
-    ctx->protocol_type = protocol_type;
+    info->protocol_type = protocol_type;
 
     /* check extensions validity */
-    status = gse_check_header_extension_validity(partial_pdu->start,
-                                                 &ctx->tot_ext_length,
+    status = gse_check_header_extension_validity(ctx->partial_pdu->start,
+                                                 &info->tot_ext_length,
                                                  extension_type,
                                                  &protocol_type);
     if(status != GSE_STATUS_OK)
     {
       goto free_ctx;
     }
-    if(protocol_type != ctx->protocol_type)
+    if(protocol_type != info->protocol_type)
     {
       status = GSE_STATUS_INVALID_EXTENSIONS;
       goto free_ctx;
     }
 
     /* move PDU start after extensions */
-    status = gse_shift_vfrag(partial_pdu, ctx->tot_ext_length, 0);
+    status = gse_shift_vfrag(ctx->partial_pdu, info->tot_ext_length, 0);
     if(status != GSE_STATUS_OK)
     {
       goto free_ctx;
@@ -931,15 +1641,16 @@ static gse_status_t gse_deencap_add_last_frag(gse_vfrag_t *partial_pdu,
   }
 
   /* Chek PDU length according to Total Length */
-  if(gse_deencap_compute_pdu_length(ctx->total_length, ctx->label_type,
-                                    ctx->tot_ext_length)
+  if(gse_deencap_compute_pdu_length(info->total_length, info->label_type,
+                                    info->tot_ext_length)
      != ctx->partial_pdu->length)
   {
     status = GSE_STATUS_INVALID_DATA_LENGTH;
     goto free_ctx;
   }
 
-  if(ntohl(rcv_crc) != ctx->crc)
+  /* The CRC32 is verified later when it is deferred */
+  if(!ctx->crc_deferred && ntohl(*rcv_crc) != ctx->crc)
   {
     status = GSE_STATUS_INVALID_CRC;
     goto free_ctx;
@@ -947,7 +1658,7 @@ static gse_status_t gse_deencap_add_last_frag(gse_vfrag_t *partial_pdu,
 
   return status;
 free_ctx:
-  gse_free_vfrag(&(ctx->partial_pdu));
+  gse_deencap_free_partial_pdu(deencap, header.subs_frag_s.frag_id);
   return status;
 free_partial_pdu:
   gse_free_vfrag(&partial_pdu);
@@ -955,6 +1666,499 @@ error:
   return status;
 }
 
+static gse_status_t gse_deencap_start_stream(gse_vfrag_t *partial_pdu,
+                                             gse_deencap_t *deencap,
+                                             gse_header_t header,
+                                             uint32_t crc)
+{
+  gse_status_t status = GSE_STATUS_OK;
+  gse_deencap_ctx_t *ctx;
+  gse_deencap_ctx_info_t *info;
+  uint8_t frag_id;
+
+  assert(partial_pdu != NULL);
+  assert(deencap != NULL);
+  assert(deencap->sink != NULL);
+
+  /* Check if a context can exist for this Frag ID */
+  frag_id = header.first_frag_s.frag_id;
+  if(frag_id >= gse_deencap_get_qos_nbr(deencap))
+  {
+    status = GSE_STATUS_INVALID_QOS;
+    goto free_partial_pdu;
+  }
+  status = gse_deencap_alloc_ctx(deencap, frag_id, &ctx);
+  if(status != GSE_STATUS_OK)
+  {
+    goto free_partial_pdu;
+  }
+  info = &(deencap->deencap_ctx_info[frag_id]);
+
+  /* Overwrite partial PDU if context is not empty */
+  if(gse_deencap_drop_ctx(deencap, frag_id))
+  {
+    status = GSE_STATUS_DATA_OVERWRITTEN;
+  }
+
+  /* Check if label is not '00:00:00:00:00:00' */
+  if(header.lt == GSE_LT_6_BYTES &&
+     memcmp(&(header.first_frag_s.label), "\x0\x0\x0\x0\x0\x0", 6) == 0)
+  {
+    status = GSE_STATUS_INVALID_LABEL;
+    goto free_partial_pdu;
+  }
+
+  info->label_type = header.lt;
+  info->total_length = ntohs(header.first_frag_s.total_length);
+  info->tot_ext_length = 0;
+  info->protocol_type = ntohs(header.first_frag_s.protocol_type);
+  memcpy(&(info->label), &(header.first_frag_s.label),
+         gse_get_label_length(header.lt));
+  info->pdu_length = gse_deencap_compute_pdu_length(info->total_length,
+                                                   header.lt, 0);
+  info->stream_length = 0;
+  ctx->bbframe_nbr = 0;
+  ctx->crc_deferred = 0;
+  if(partial_pdu->length > info->pdu_length)
+  {
+    status = GSE_STATUS_NO_SPACE_IN_BUFF;
+    goto free_partial_pdu;
+  }
+
+  /* Compute the data field part of the CRC32 and store it */
+  ctx->crc = gse_deencap_compute_crc(partial_pdu->start, partial_pdu->length,
+                                     crc);
+
+  if(gse_deencap_call_sink(deencap, frag_id, GSE_SINK_START,
+                           NULL, 0) < 0)
+  {
+    status = GSE_STATUS_SINK_CB_FAILED;
+    goto free_partial_pdu;
+  }
+  ctx->streaming = 1;
+  if(gse_deencap_call_sink(deencap, frag_id, GSE_SINK_DATA,
+                           partial_pdu->start, partial_pdu->length) < 0)
+  {
+    status = GSE_STATUS_SINK_CB_FAILED;
+    gse_deencap_drop_ctx(deencap, frag_id);
+    goto free_partial_pdu;
+  }
+  info->stream_length = partial_pdu->length;
+
+free_partial_pdu:
+  gse_free_vfrag(&partial_pdu);
+  return status;
+}
+
+static gse_status_t gse_deencap_add_stream_frag(gse_vfrag_t *partial_pdu,
+                                                gse_deencap_t *deencap,
+                                                gse_header_t header,
+                                                int last)
+{
+  gse_status_t status = GSE_STATUS_OK;
+  gse_deencap_ctx_t *ctx;
+  gse_deencap_ctx_info_t *info;
+  uint32_t rcv_crc = 0;
+  uint8_t frag_id;
+
+  assert(partial_pdu != NULL);
+  assert(deencap != NULL);
+
+  frag_id = header.subs_frag_s.frag_id;
+  ctx = gse_deencap_get_ctx(deencap, frag_id);
+  assert(ctx != NULL && ctx->streaming);
+  info = &(deencap->deencap_ctx_info[frag_id]);
+
+  if(header.lt != GSE_LT_REUSE)
+  {
+    status = GSE_STATUS_INVALID_LT;
+    goto free_partial_pdu;
+  }
+
+  /* Check if a timeout occurred (i.e. if the complete PDU had not been received
+   * in 256 BBFrames) */
+  if(ctx->bbframe_nbr > 255)
+  {
+    status = GSE_STATUS_TIMEOUT;
+    goto drop_ctx;
+  }
+
+  if(last)
+  {
+    /* Move end pointer to the end of the data field and store the received
+     * CRC32 */
+    status = gse_shift_vfrag(partial_pdu, 0, GSE_MAX_TRAILER_LENGTH * -1);
+    if(status != GSE_STATUS_OK)
+    {
+      goto drop_ctx;
+    }
+    memcpy(&rcv_crc, partial_pdu->end, GSE_MAX_TRAILER_LENGTH);
+  }
+
+  /* Check if the fragment does not exceed the PDU length */
+  if(info->stream_length + partial_pdu->length > info->pdu_length)
+  {
+    status = GSE_STATUS_NO_SPACE_IN_BUFF;
+    goto drop_ctx;
+  }
+
+  /* Compute the data field part of the CRC32 and store it */
+  ctx->crc = gse_deencap_compute_crc(partial_pdu->start, partial_pdu->length,
+                                     ctx->crc);
+
+  if(partial_pdu->length > 0)
+  {
+    if(gse_deencap_call_sink(deencap, frag_id, GSE_SINK_DATA,
+                             partial_pdu->start, partial_pdu->length) < 0)
+    {
+      status = GSE_STATUS_SINK_CB_FAILED;
+      goto drop_ctx;
+    }
+    info->stream_length += partial_pdu->length;
+  }
+  if(!last)
+  {
+    goto free_partial_pdu;
+  }
+
+  /* Chek PDU length according to Total Length */
+  if(info->stream_length != info->pdu_length)
+  {
+    status = GSE_STATUS_INVALID_DATA_LENGTH;
+    goto drop_ctx;
+  }
+  if(ntohl(rcv_crc) != ctx->crc)
+  {
+    status = GSE_STATUS_INVALID_CRC;
+    goto drop_ctx;
+  }
+
+  ctx->streaming = 0;
+  if(gse_deencap_call_sink(deencap, frag_id, GSE_SINK_COMMIT,
+                           NULL, 0) < 0)
+  {
+    status = GSE_STATUS_SINK_CB_FAILED;
+    goto free_partial_pdu;
+  }
+  status = GSE_STATUS_PDU_STREAMED;
+  goto free_partial_pdu;
+
+drop_ctx:
+  gse_deencap_drop_ctx(deencap, frag_id);
+free_partial_pdu:
+  gse_free_vfrag(&partial_pdu);
+  return status;
+}
+
+static int gse_deencap_call_sink(gse_deencap_t *deencap, uint8_t frag_id,
+                                 gse_sink_event_t event,
+                                 const unsigned char *data, size_t length)
+{
+  gse_deencap_ctx_info_t *info = &(deencap->deencap_ctx_info[frag_id]);
+  gse_sink_pdu_t pdu;
+  int label_length;
+
+  pdu.frag_id = frag_id;
+  pdu.label_type = info->label_type;
+  memset(pdu.label, 0, sizeof(pdu.label));
+  label_length = gse_get_label_length(info->label_type);
+  if(label_length > 0)
+  {
+    memcpy(pdu.label, &(info->label), label_length);
+  }
+  pdu.protocol = info->protocol_type;
+  pdu.pdu_length = info->pdu_length;
+  pdu.offset = info->stream_length;
+
+  return deencap->sink(event, &pdu, data, length, deencap->sink_opaque);
+}
+
+static int gse_deencap_drop_ctx(gse_deencap_t *deencap, uint8_t frag_id)
+{
+  gse_deencap_ctx_t *ctx = gse_deencap_get_ctx(deencap, frag_id);
+  int dropped = 0;
+
+  if(ctx == NULL)
+  {
+    return 0;
+  }
+
+  if(ctx->partial_pdu != NULL)
+  {
+    gse_deencap_free_partial_pdu(deencap, frag_id);
+    dropped = 1;
+  }
+  if(ctx->streaming)
+  {
+    /* The PDU is dropped whatever the sink answer is */
+    ctx->streaming = 0;
+    gse_deencap_call_sink(deencap, frag_id, GSE_SINK_ABORT, NULL, 0);
+    dropped = 1;
+  }
+
+  return dropped;
+}
+
+static gse_deencap_ctx_t *gse_deencap_get_ctx(gse_deencap_t *deencap,
+                                              uint8_t frag_id)
+{
+  if(frag_id >= deencap->ctx_nbr)
+  {
+    return NULL;
+  }
+  return &(deencap->deencap_ctx[frag_id]);
+}
+
+static gse_status_t gse_deencap_alloc_ctx(gse_deencap_t *deencap,
+                                          uint8_t frag_id,
+                                          gse_deencap_ctx_t **ctx)
+{
+  gse_deencap_ctx_t *deencap_ctx;
+  gse_deencap_ctx_info_t *deencap_ctx_info;
+  unsigned int ctx_nbr;
+
+  assert(frag_id < gse_deencap_get_qos_nbr(deencap));
+
+  if(frag_id >= deencap->ctx_nbr)
+  {
+    /* Double the table to limit the reallocations, without going beyond
+     * the QoS number */
+    ctx_nbr = (deencap->ctx_nbr > 0 ? deencap->ctx_nbr * 2 :
+                                      GSE_DEENCAP_CTX_MIN_NBR);
+    if(ctx_nbr <= frag_id)
+    {
+      ctx_nbr = frag_id + 1;
+    }
+    if(ctx_nbr > gse_deencap_get_qos_nbr(deencap))
+    {
+      ctx_nbr = gse_deencap_get_qos_nbr(deencap);
+    }
+    /* The tables start on a cache line, the contexts are moved in them.
+     * On release, the virtual fragments contained by the contexts are
+     * destroyed only if they exist */
+    if(posix_memalign((void **)&deencap_ctx, GSE_CACHE_LINE_SIZE,
+                      ctx_nbr * sizeof(gse_deencap_ctx_t)) != 0)
+    {
+      return GSE_STATUS_MALLOC_FAILED;
+    }
+    if(posix_memalign((void **)&deencap_ctx_info, GSE_CACHE_LINE_SIZE,
+                      ctx_nbr * sizeof(gse_deencap_ctx_info_t)) != 0)
+    {
+      free(deencap_ctx);
+      return GSE_STATUS_MALLOC_FAILED;
+    }
+    memset(deencap_ctx, 0, ctx_nbr * sizeof(gse_deencap_ctx_t));
+    memset(deencap_ctx_info, 0, ctx_nbr * sizeof(gse_deencap_ctx_info_t));
+    if(deencap->ctx_nbr > 0)
+    {
+      memcpy(deencap_ctx, deencap->deencap_ctx,
+             deencap->ctx_nbr * sizeof(gse_deencap_ctx_t));
+      memcpy(deencap_ctx_info, deencap->deencap_ctx_info,
+             deencap->ctx_nbr * sizeof(gse_deencap_ctx_info_t));
+    }
+    free(deencap->deencap_ctx);
+    free(deencap->deencap_ctx_info);
+    deencap->deencap_ctx = deencap_ctx;
+    deencap->deencap_ctx_info = deencap_ctx_info;
+    deencap->ctx_nbr = ctx_nbr;
+  }
+  *ctx = &(deencap->deencap_ctx[frag_id]);
+
+  return GSE_STATUS_OK;
+}
+
+static gse_status_t gse_deencap_free_partial_pdu(gse_deencap_t *deencap,
+                                                 uint8_t frag_id)
+{
+  gse_deencap_ctx_info_t *info = &(deencap->deencap_ctx_info[frag_id]);
+
+  if(info->pool_length > 0)
+  {
+    assert(deencap->pool != NULL);
+    deencap->pool->used_length -= info->pool_length;
+    info->pool_length = 0;
+  }
+  return gse_free_vfrag(&(deencap->deencap_ctx[frag_id].partial_pdu));
+}
+
+static gse_status_t gse_deencap_pool_reserve(gse_deencap_pool_t *pool,
+                                             size_t length)
+{
+  gse_deencap_t *victim;
+  unsigned int victim_frag_id;
+  unsigned int i;
+  unsigned int j;
+
+  while(pool->used_length + length > pool->max_length)
+  {
+    /* Evict the PDU waiting for its fragments for the most BBFrames, the
+     * longest one between PDUs of the same age */
+    victim = NULL;
+    victim_frag_id = 0;
+    for(i = 0 ; i < pool->deencap_nbr ; i++)
+    {
+      gse_deencap_t *deencap = pool->deencaps[i];
+
+      for(j = 0 ; j < deencap->ctx_nbr ; j++)
+      {
+        if(deencap->deencap_ctx_info[j].pool_length == 0)
+        {
+          continue;
+        }
+        if(victim == NULL ||
+           deencap->deencap_ctx[j].bbframe_nbr >
+           victim->deencap_ctx[victim_frag_id].bbframe_nbr ||
+           (deencap->deencap_ctx[j].bbframe_nbr ==
+            victim->deencap_ctx[victim_frag_id].bbframe_nbr &&
+            deencap->deencap_ctx_info[j].pool_length >
+            victim->deencap_ctx_info[victim_frag_id].pool_length))
+        {
+          victim = deencap;
+          victim_frag_id = j;
+        }
+      }
+    }
+    if(victim == NULL)
+    {
+      return GSE_STATUS_POOL_FULL;
+    }
+    gse_deencap_drop_ctx(victim, victim_frag_id);
+    pool->evicted_nbr++;
+  }
+  pool->used_length += length;
+
+  return GSE_STATUS_OK;
+}
+
+static void gse_deencap_detach_pool(gse_deencap_t *deencap)
+{
+  gse_deencap_pool_t *pool = deencap->pool;
+  unsigned int i;
+
+  assert(pool != NULL);
+
+  for(i = 0 ; i < deencap->ctx_nbr ; i++)
+  {
+    pool->used_length -= deencap->deencap_ctx_info[i].pool_length;
+    deencap->deencap_ctx_info[i].pool_length = 0;
+  }
+  for(i = 0 ; i < pool->deencap_nbr ; i++)
+  {
+    if(pool->deencaps[i] == deencap)
+    {
+      pool->deencaps[i] = pool->deencaps[pool->deencap_nbr - 1];
+      pool->deencap_nbr--;
+      break;
+    }
+  }
+  deencap->pool = NULL;
+}
+
+static gse_status_t gse_deencap_queue_pdu(gse_deencap_t *deencap,
+                                          gse_vfrag_t *pdu,
+                                          gse_label_type_t label_type,
+                                          uint8_t label[6], uint16_t protocol,
+                                          int verify, uint32_t crc,
+                                          uint32_t rcv_crc)
+{
+  gse_status_t status = GSE_STATUS_PDU_QUEUED;
+  gse_deencap_queued_pdu_t *queued;
+  int label_length;
+
+  /* Double the size of the queue when it is full, the queued PDUs are moved
+   * at the beginning of the new table */
+  if(deencap->crc_queue_nbr == deencap->crc_queue_size)
+  {
+    gse_deencap_queued_pdu_t *crc_queue;
+    size_t size;
+    size_t i;
+
+    size = (deencap->crc_queue_size > 0 ? 2 * deencap->crc_queue_size :
+            GSE_DEENCAP_CRC_QUEUE_MIN_SIZE);
+    crc_queue = calloc(size, sizeof(gse_deencap_queued_pdu_t));
+    if(crc_queue == NULL)
+    {
+      status = GSE_STATUS_MALLOC_FAILED;
+      goto free_pdu;
+    }
+    for(i = 0 ; i < deencap->crc_queue_nbr ; i++)
+    {
+      crc_queue[i] = deencap->crc_queue[(deencap->crc_queue_first + i) %
+                                        deencap->crc_queue_size];
+    }
+    free(deencap->crc_queue);
+    deencap->crc_queue = crc_queue;
+    deencap->crc_queue_size = size;
+    deencap->crc_queue_first = 0;
+  }
+
+  queued = &(deencap->crc_queue[(deencap->crc_queue_first +
+                                 deencap->crc_queue_nbr) %
+                                deencap->crc_queue_size]);
+  queued->pdu = pdu;
+  queued->crc = crc;
+  queued->rcv_crc = rcv_crc;
+  queued->verified = !verify;
+  queued->status = GSE_STATUS_PDU_RECEIVED;
+  queued->label_type = label_type;
+  label_length = gse_get_label_length(label_type);
+  if(label_length > 0)
+  {
+    memcpy(&(queued->label), label, label_length);
+  }
+  queued->protocol_type = protocol;
+  deencap->crc_queue_nbr++;
+
+  return status;
+free_pdu:
+  gse_free_vfrag(&pdu);
+  return status;
+}
+
+static void gse_deencap_verify_queue(gse_deencap_t *deencap)
+{
+  gse_deencap_queued_pdu_t *batch[GSE_DEENCAP_MAX_CRC_BATCH];
+  unsigned char *data[GSE_DEENCAP_MAX_CRC_BATCH];
+  size_t length[GSE_DEENCAP_MAX_CRC_BATCH];
+  uint32_t crc[GSE_DEENCAP_MAX_CRC_BATCH];
+  unsigned int batch_nbr = 0;
+  unsigned int max_nbr;
+  unsigned int i;
+  size_t pos;
+
+  /* The queue may still contain PDUs to verify after the deferred
+   * verification is disabled */
+  max_nbr = (deencap->crc_batch > 0 ? deencap->crc_batch : 1);
+  for(pos = 0 ; pos < deencap->crc_queue_nbr && batch_nbr < max_nbr ; pos++)
+  {
+    gse_deencap_queued_pdu_t *queued;
+
+    queued = &(deencap->crc_queue[(deencap->crc_queue_first + pos) %
+                                  deencap->crc_queue_size]);
+    if(queued->verified)
+    {
+      continue;
+    }
+    batch[batch_nbr] = queued;
+    data[batch_nbr] = queued->pdu->start;
+    length[batch_nbr] = queued->pdu->length;
+    crc[batch_nbr] = queued->crc;
+    batch_nbr++;
+  }
+
+  compute_crc_multi(data, length, crc, batch_nbr);
+
+  for(i = 0 ; i < batch_nbr ; i++)
+  {
+    batch[i]->crc = crc[i];
+    batch[i]->verified = 1;
+    if(crc[i] != batch[i]->rcv_crc)
+    {
+      batch[i]->status = GSE_STATUS_INVALID_CRC;
+    }
+  }
+}
+
 static size_t gse_deencap_compute_pdu_length(uint16_t total_length,
                                              gse_label_type_t label_type,
                                              size_t tot_ext_length)
@@ -52,14 +52,69 @@
 
 #include "virtual_fragment.h"
 #include "deencap_header_ext.h"
+#include "bbframe.h"
 
 struct gse_deencap_s;
 typedef struct gse_deencap_s gse_deencap_t;
 
+struct gse_deencap_pool_s;
+typedef struct gse_deencap_pool_s gse_deencap_pool_t;
+
 /**
  * @defgroup gse_deencap GSE deencapsulation API
  */
 
+/** Events given to the sink of the fragmented PDUs
+ *
+ *  @ingroup gse_deencap
+ */
+typedef enum
+{
+  GSE_SINK_START,  /**< The first fragment of a PDU is received */
+  GSE_SINK_DATA,   /**< The next chunk of the PDU data is received */
+  GSE_SINK_COMMIT, /**< The PDU is complete and its CRC is valid */
+  GSE_SINK_ABORT,  /**< The PDU is dropped, the chunks already given shall be
+                        discarded */
+} gse_sink_event_t;
+
+/** The PDU given to the sink
+ *
+ *  @ingroup gse_deencap
+ */
+typedef struct
+{
+  uint8_t frag_id;    /**< The FragID of the PDU fragments */
+  uint8_t label_type; /**< The label type field value */
+  uint8_t label[6];   /**< The PDU label */
+  uint16_t protocol;  /**< The PDU protocol */
+  size_t pdu_length;  /**< The PDU length given by the Total Length field */
+  size_t offset;      /**< The length of the PDU data given before the
+                           current chunk */
+} gse_sink_pdu_t;
+
+/**
+ *  @brief   Callback receiving the fragmented PDUs as their fragments arrive
+ *
+ *  The chunks of a PDU are given in order. The PDU shall be used only once
+ *  it is committed, the sink shall drop it if it is aborted.
+ *
+ *  @param   event   The event
+ *  @param   pdu     The PDU
+ *  @param   data    The chunk of PDU data for \ref GSE_SINK_DATA,
+ *                   NULL otherwise
+ *  @param   length  The length of the chunk (in bytes)
+ *  @param   opaque  The user specific data
+ *
+ *  @return          0 on success, -1 to drop the PDU
+ *
+ *  @ingroup gse_deencap
+ */
+typedef int (*gse_deencap_sink_cb_t)(gse_sink_event_t event,
+                                     const gse_sink_pdu_t *pdu,
+                                     const unsigned char *data,
+                                     size_t length,
+                                     void *opaque);
+
 /****************************************************************************
  *
  *   FUNCTION PROTOTYPES
@@ -158,6 +213,8 @@ gse_status_t gse_deencap_set_offsets(gse_deencap_t *deencap,
  *                            - \ref GSE_STATUS_PADDING_DETECTED
  *                            - \ref GSE_STATUS_DATA_OVERWRITTEN
  *                            - \ref GSE_STATUS_PDU_RECEIVED
+ *                            - \ref GSE_STATUS_PDU_STREAMED
+ *                            - \ref GSE_STATUS_PDU_QUEUED
  *                          - warning/error code among:
  *                            - \ref GSE_STATUS_NULL_PTR
  *                            - \ref GSE_STATUS_PACKET_TOO_SMALL
@@ -182,6 +239,7 @@ gse_status_t gse_deencap_set_offsets(gse_deencap_t *deencap,
  *                            - \ref GSE_STATUS_INVALID_DATA_LENGTH
  *                            - \ref GSE_STATUS_INVALID_CRC
  *                            - \ref GSE_STATUS_EXTENSION_CB_FAILED
+ *                            - \ref GSE_STATUS_SINK_CB_FAILED
  *
  *  @ingroup gse_deencap
  */
@@ -212,6 +270,238 @@ gse_status_t gse_deencap_packet(gse_vfrag_t *data, gse_deencap_t *deencap,
  */
 gse_status_t gse_deencap_new_bbframe(gse_deencap_t *deencap);
 
+/**
+ *  @brief   Deencapsulate all the GSE packets of a BBFrame
+ *
+ *  The BBHEADER is checked, \ref gse_deencap_new_bbframe is called, then the
+ *  GSE packets of the data field are deencapsulated in place until the end
+ *  of the data field or the padding. The complete PDUs are queued and shall
+ *  be retrieved with \ref gse_deencap_get_pdu, their CRC32 verification is
+ *  deferred if enabled (see \ref gse_deencap_set_deferred_crc). The first
+ *  fragments of PDUs are copied in the deencapsulation contexts.\n
+ *  A GSE packet in error does not prevent the next ones from being
+ *  deencapsulated.
+ *
+ *  @param   bbframe   The BBFrame, starting with its BBHEADER, destroyed by
+ *                     the function
+ *  @param   deencap   The deencapsulation context structure
+ *  @param   bbheader  OUT: The BBHEADER fields
+ *
+ *  @return
+ *                     - success/informative code among:
+ *                       - \ref GSE_STATUS_OK
+ *                     - warning/error code among:
+ *                       - \ref GSE_STATUS_NULL_PTR
+ *                       - \ref GSE_STATUS_INVALID_BBFRAME_LENGTH
+ *                       - \ref GSE_STATUS_INVALID_BBHEADER_CRC
+ *                       - \ref GSE_STATUS_INVALID_DFL
+ *                       - \ref GSE_STATUS_FRAG_NBR
+ *                       - \ref GSE_STATUS_MALLOC_FAILED
+ *                       - the first warning/error code returned for a GSE
+ *                         packet of the data field, as listed for
+ *                         \ref gse_deencap_packet
+ *
+ *  @ingroup gse_deencap
+ */
+gse_status_t gse_deencap_bbframe(gse_vfrag_t *bbframe, gse_deencap_t *deencap,
+                                 gse_bbheader_t *bbheader);
+
+/**
+ *  @brief   Give the fragmented PDUs to a sink as their fragments arrive
+ *
+ *  By default the fragments of a PDU are stored until its last fragment and
+ *  the PDU is returned by \ref gse_deencap_packet once its CRC is checked.\n
+ *  With a sink, the data of each fragment is given to the sink callback
+ *  right away, so the PDU is not stored by the library. The PDU is then
+ *  committed or aborted according to its length and CRC, and
+ *  \ref gse_deencap_packet returns \ref GSE_STATUS_PDU_STREAMED with its last
+ *  fragment.\n
+ *  The complete PDUs and the PDUs with header extensions are still returned
+ *  by \ref gse_deencap_packet.\n
+ *  The PDUs given to the previous sink are aborted.
+ *
+ *  @param   deencap   The deencapsulation context structure
+ *  @param   callback  The sink callback, NULL to store the fragments again
+ *  @param   opaque    The user specific data for the callback
+ *
+ *  @return
+ *                     - success/informative code among:
+ *                       - \ref GSE_STATUS_OK
+ *                     - warning/error code among:
+ *                       - \ref GSE_STATUS_NULL_PTR
+ *
+ *  @ingroup gse_deencap
+ */
+gse_status_t gse_deencap_set_sink(gse_deencap_t *deencap,
+                                  gse_deencap_sink_cb_t callback,
+                                  void *opaque);
+
+/**
+ *  @brief   Defer the CRC verification of the fragmented PDUs
+ *
+ *  By default the CRC32 of a fragmented PDU is updated with each fragment and
+ *  checked with its last fragment.\n
+ *  With a deferred verification, \ref gse_deencap_packet queues the PDUs
+ *  and returns \ref GSE_STATUS_PDU_QUEUED instead of the PDU. The PDUs are
+ *  then returned by \ref gse_deencap_get_pdu in their order of reception,
+ *  the CRC32 of up to batch PDUs being computed together the first time one
+ *  of them is requested.\n
+ *  The complete PDUs are queued too so that the order is kept. The PDUs with
+ *  header extensions and the PDUs given to a sink are verified right away.
+ *
+ *  @param   deencap  The deencapsulation context structure
+ *  @param   batch    The number of PDUs verified together (at most 64),
+ *                    0 to verify the CRC32 right away (default)
+ *
+ *  @return
+ *                    - success/informative code among:
+ *                      - \ref GSE_STATUS_OK
+ *                    - warning/error code among:
+ *                      - \ref GSE_STATUS_NULL_PTR
+ *
+ *  @ingroup gse_deencap
+ */
+gse_status_t gse_deencap_set_deferred_crc(gse_deencap_t *deencap,
+                                          unsigned int batch);
+
+/**
+ *  @brief   Get the oldest PDU queued by the deferred CRC verification or by
+ *           \ref gse_deencap_bbframe
+ *
+ *  The PDU is verified with the next queued PDUs if it is not verified yet.
+ *  A PDU whose CRC32 is wrong is dropped, its label and protocol are still
+ *  returned.\n
+ *  The PDUs queued before the deferred verification is disabled can still
+ *  be retrieved.
+ *
+ *  @param   deencap     The deencapsulation context structure
+ *  @param   label_type  OUT: The label type of the PDU
+ *  @param   label       OUT: The label of the PDU
+ *  @param   protocol    OUT: The protocol of the PDU
+ *  @param   pdu         OUT: The PDU on success, NULL otherwise
+ *
+ *  @return
+ *                       - success/informative code among:
+ *                         - \ref GSE_STATUS_PDU_RECEIVED
+ *                       - warning/error code among:
+ *                         - \ref GSE_STATUS_NULL_PTR
+ *                         - \ref GSE_STATUS_NO_PDU_QUEUED
+ *                         - \ref GSE_STATUS_INVALID_CRC
+ *
+ *  @ingroup gse_deencap
+ */
+gse_status_t gse_deencap_get_pdu(gse_deencap_t *deencap,
+                                 uint8_t *label_type, uint8_t label[6],
+                                 uint16_t *protocol, gse_vfrag_t **pdu);
+
+/**
+ *  @brief   Get the memory used by a deencapsulation structure
+ *
+ *  The structure and its tables are accounted. The context of a FragID is
+ *  only allocated once a first fragment is received with this FragID. The
+ *  PDUs being reassembled are not accounted.
+ *
+ *  @param   deencap    The deencapsulation context structure
+ *  @param   footprint  OUT: The memory used by the structure (in bytes)
+ *
+ *  @return
+ *                      - success/informative code among:
+ *                        - \ref GSE_STATUS_OK
+ *                      - warning/error code among:
+ *                        - \ref GSE_STATUS_NULL_PTR
+ *
+ *  @ingroup gse_deencap
+ */
+gse_status_t gse_deencap_get_footprint(gse_deencap_t *deencap,
+                                       size_t *footprint);
+
+/**
+ *  @brief   Create a reassembly pool
+ *
+ *  A reassembly pool bounds the total length of the fragmented PDUs being
+ *  reassembled by several deencapsulation structures, for example one per
+ *  input stream of a multi-stream receiver. When a new fragmented PDU does
+ *  not fit in the pool, the PDU waiting for its fragments for the most
+ *  BBFrames, among all the deencapsulation structures using the pool, is
+ *  dropped.
+ *
+ *  The pool is not protected against concurrent accesses, the
+ *  deencapsulation structures using it shall be used from the same thread.
+ *
+ *  @param   max_length  The maximum length of the PDUs being reassembled
+ *  @param   pool        OUT: The reassembly pool
+ *
+ *  @return
+ *                       - success/informative code among:
+ *                         - \ref GSE_STATUS_OK
+ *                       - warning/error code among:
+ *                         - \ref GSE_STATUS_NULL_PTR
+ *                         - \ref GSE_STATUS_MALLOC_FAILED
+ *
+ *  @ingroup gse_deencap
+ */
+gse_status_t gse_deencap_pool_init(size_t max_length,
+                                   gse_deencap_pool_t **pool);
+
+/**
+ *  @brief   Release a reassembly pool
+ *
+ *  The deencapsulation structures still using the pool stop using it.
+ *
+ *  @param   pool  The reassembly pool
+ *
+ *  @return
+ *                 - success/informative code among:
+ *                   - \ref GSE_STATUS_OK
+ *                 - warning/error code among:
+ *                   - \ref GSE_STATUS_NULL_PTR
+ *
+ *  @ingroup gse_deencap
+ */
+gse_status_t gse_deencap_pool_release(gse_deencap_pool_t *pool);
+
+/**
+ *  @brief   Set the reassembly pool of a deencapsulation structure
+ *
+ *  The fragmented PDUs received afterwards are reassembled in the pool, the
+ *  PDUs already being reassembled are not accounted in it.
+ *  A deencapsulation structure using a pool always copies the first fragment
+ *  of a PDU, even in BBFrames.
+ *
+ *  @param   deencap  The deencapsulation structure
+ *  @param   pool     The reassembly pool, NULL to stop using a pool
+ *
+ *  @return
+ *                    - success/informative code among:
+ *                      - \ref GSE_STATUS_OK
+ *                    - warning/error code among:
+ *                      - \ref GSE_STATUS_NULL_PTR
+ *                      - \ref GSE_STATUS_MALLOC_FAILED
+ *
+ *  @ingroup gse_deencap
+ */
+gse_status_t gse_deencap_set_pool(gse_deencap_t *deencap,
+                                  gse_deencap_pool_t *pool);
+
+/**
+ *  @brief   Get the usage of a reassembly pool
+ *
+ *  @param   pool         The reassembly pool
+ *  @param   used_length  OUT: The length of the PDUs being reassembled
+ *  @param   evicted_nbr  OUT: The number of PDUs dropped to make room
+ *
+ *  @return
+ *                        - success/informative code among:
+ *                          - \ref GSE_STATUS_OK
+ *                        - warning/error code among:
+ *                          - \ref GSE_STATUS_NULL_PTR
+ *
+ *  @ingroup gse_deencap
+ */
+gse_status_t gse_deencap_pool_get_usage(gse_deencap_pool_t *pool,
+                                        size_t *used_length,
+                                        unsigned long *evicted_nbr);
+
 /**
  *  @brief  Set the callback that read header extensions
  *
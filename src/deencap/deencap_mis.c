@@ -0,0 +1,251 @@
+/*
+ *
+ * This piece of software is an implementation of the Generic Stream
+ * Encapsulation (GSE) standard defined by ETSI for Linux (or other
+ * Unix-compatible OS). The library may be used to add GSE
+ * encapsulation/de-encapsulation capabilities to an application.
+ *
+ *
+ * Copyright © 2016 TAS
+ *
+ *
+ * This file is part of the GSE library.
+ *
+ *
+ * The GSE library is free software : you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY, without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see http://www.gnu.org/licenses/.
+ *
+ */
+
+/****************************************************************************/
+/**
+ *   @file          deencap_mis.c
+ *
+ *          Project:     GSE LIBRARY
+ *
+ *          Company:     THALES ALENIA SPACE
+ *
+ *          Module name: DEENCAPSULATION
+ *
+ *   @brief         GSE multiple input stream deencapsulation functions
+ *
+ *   @author        Julien BERNARD / Viveris Technologies
+ *
+ */
+/****************************************************************************/
+
+#include "deencap_mis.h"
+
+#include <stdlib.h>
+
+/** The number of input streams (ISI values) */
+#define GSE_DEENCAP_MIS_STREAM_NBR 256
+
+
+/****************************************************************************
+ *
+ *   STRUCTURES AND TYPES
+ *
+ ****************************************************************************/
+
+/** Multiple input stream deencapsulation structure */
+struct gse_deencap_mis_s
+{
+  uint8_t qos_nbr;            /**< Number of FragID of each stream */
+  gse_deencap_pool_t *pool;   /**< Reassembly pool shared by the streams */
+  gse_deencap_t *streams[GSE_DEENCAP_MIS_STREAM_NBR];
+                              /**< Deencapsulation structures of the streams,
+                                   NULL until their first BBFrame */
+};
+
+
+/****************************************************************************
+ *
+ *   PUBLIC FUNCTIONS
+ *
+ ****************************************************************************/
+
+gse_status_t gse_deencap_mis_init(uint8_t qos_nbr,
+                                  size_t max_reassembly_length,
+                                  gse_deencap_mis_t **mis)
+{
+  gse_status_t status = GSE_STATUS_OK;
+
+  if(mis == NULL)
+  {
+    status = GSE_STATUS_NULL_PTR;
+    goto error;
+  }
+  if(qos_nbr == 0)
+  {
+    status = GSE_STATUS_INVALID_QOS;
+    goto error;
+  }
+
+  *mis = calloc(1, sizeof(gse_deencap_mis_t));
+  if(*mis == NULL)
+  {
+    status = GSE_STATUS_MALLOC_FAILED;
+    goto error;
+  }
+  (*mis)->qos_nbr = qos_nbr;
+
+  status = gse_deencap_pool_init(max_reassembly_length, &((*mis)->pool));
+  if(status != GSE_STATUS_OK)
+  {
+    goto free_mis;
+  }
+
+  return status;
+
+free_mis:
+  free(*mis);
+  *mis = NULL;
+error:
+  return status;
+}
+
+gse_status_t gse_deencap_mis_release(gse_deencap_mis_t *mis)
+{
+  gse_status_t status = GSE_STATUS_OK;
+  gse_status_t stream_status;
+  unsigned int i;
+
+  if(mis == NULL)
+  {
+    status = GSE_STATUS_NULL_PTR;
+    goto error;
+  }
+
+  for(i = 0; i < GSE_DEENCAP_MIS_STREAM_NBR; i++)
+  {
+    if(mis->streams[i] == NULL)
+    {
+      continue;
+    }
+    stream_status = gse_deencap_release(mis->streams[i]);
+    if(stream_status != GSE_STATUS_OK && status == GSE_STATUS_OK)
+    {
+      status = stream_status;
+    }
+  }
+  gse_deencap_pool_release(mis->pool);
+  free(mis);
+
+error:
+  return status;
+}
+
+gse_status_t gse_deencap_mis_get_stream(gse_deencap_mis_t *mis, uint8_t isi,
+                                        gse_deencap_t **deencap)
+{
+  gse_status_t status = GSE_STATUS_OK;
+
+  if(mis == NULL || deencap == NULL)
+  {
+    status = GSE_STATUS_NULL_PTR;
+    goto error;
+  }
+
+  if(mis->streams[isi] == NULL)
+  {
+    status = gse_deencap_init(mis->qos_nbr, &(mis->streams[isi]));
+    if(status != GSE_STATUS_OK)
+    {
+      goto error;
+    }
+    status = gse_deencap_set_pool(mis->streams[isi], mis->pool);
+    if(status != GSE_STATUS_OK)
+    {
+      goto release;
+    }
+  }
+  *deencap = mis->streams[isi];
+
+  return status;
+
+release:
+  gse_deencap_release(mis->streams[isi]);
+  mis->streams[isi] = NULL;
+error:
+  return status;
+}
+
+gse_status_t gse_deencap_mis_bbframe(gse_vfrag_t *bbframe,
+                                     gse_deencap_mis_t *mis,
+                                     gse_bbheader_t *bbheader)
+{
+  gse_status_t status;
+  gse_deencap_t *deencap;
+  uint8_t isi;
+
+  if(bbframe == NULL || mis == NULL || bbheader == NULL)
+  {
+    status = GSE_STATUS_NULL_PTR;
+    goto error;
+  }
+
+  /* The BBHEADER is only read to select the stream, it is checked again
+   * when the BBFrame is deencapsulated */
+  status = gse_parse_bbheader(bbframe->start, bbframe->length, bbheader);
+  if(status != GSE_STATUS_OK)
+  {
+    goto free_bbframe;
+  }
+  isi = (bbheader->sis_mis ? 0 : bbheader->isi);
+
+  status = gse_deencap_mis_get_stream(mis, isi, &deencap);
+  if(status != GSE_STATUS_OK)
+  {
+    goto free_bbframe;
+  }
+
+  return gse_deencap_bbframe(bbframe, deencap, bbheader);
+
+free_bbframe:
+  gse_free_vfrag(&bbframe);
+error:
+  return status;
+}
+
+gse_status_t gse_deencap_mis_get_pdu(gse_deencap_mis_t *mis, uint8_t isi,
+                                     uint8_t *label_type, uint8_t label[6],
+                                     uint16_t *protocol, gse_vfrag_t **pdu)
+{
+  if(mis == NULL || label_type == NULL || label == NULL || protocol == NULL ||
+     pdu == NULL)
+  {
+    return GSE_STATUS_NULL_PTR;
+  }
+
+  if(mis->streams[isi] == NULL)
+  {
+    *pdu = NULL;
+    return GSE_STATUS_NO_PDU_QUEUED;
+  }
+
+  return gse_deencap_get_pdu(mis->streams[isi], label_type, label, protocol,
+                             pdu);
+}
+
+gse_status_t gse_deencap_mis_get_usage(gse_deencap_mis_t *mis,
+                                       size_t *used_length,
+                                       unsigned long *evicted_nbr)
+{
+  if(mis == NULL)
+  {
+    return GSE_STATUS_NULL_PTR;
+  }
+
+  return gse_deencap_pool_get_usage(mis->pool, used_length, evicted_nbr);
+}
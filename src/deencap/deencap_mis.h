@@ -0,0 +1,211 @@
+/*
+ *
+ * This piece of software is an implementation of the Generic Stream
+ * Encapsulation (GSE) standard defined by ETSI for Linux (or other
+ * Unix-compatible OS). The library may be used to add GSE
+ * encapsulation/de-encapsulation capabilities to an application.
+ *
+ *
+ * Copyright © 2016 TAS
+ *
+ *
+ * This file is part of the GSE library.
+ *
+ *
+ * The GSE library is free software : you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY, without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see http://www.gnu.org/licenses/.
+ *
+ */
+
+/****************************************************************************/
+/**
+ *   @file          deencap_mis.h
+ *
+ *          Project:     GSE LIBRARY
+ *
+ *          Company:     THALES ALENIA SPACE
+ *
+ *          Module name: DEENCAPSULATION
+ *
+ *   @brief         GSE multiple input stream deencapsulation public functions
+ *
+ *   @author        Julien BERNARD / Viveris Technologies
+ *
+ */
+/****************************************************************************/
+
+
+#ifndef GSE_DEENCAP_MIS_H
+#define GSE_DEENCAP_MIS_H
+
+#include <stdint.h>
+
+#include "deencap.h"
+
+struct gse_deencap_mis_s;
+typedef struct gse_deencap_mis_s gse_deencap_mis_t;
+
+/**
+ * @defgroup gse_deencap_mis GSE multiple input stream deencapsulation API
+ *
+ * The BBFrames of several input streams are dispatched on their ISI to one
+ * deencapsulation structure per stream, the PDUs of all the streams are
+ * reassembled in a shared reassembly pool.
+ */
+
+/****************************************************************************
+ *
+ *   FUNCTION PROTOTYPES
+ *
+ ****************************************************************************/
+
+/**
+ *  @brief   Create a multiple input stream deencapsulation structure
+ *
+ *  The deencapsulation structure of an input stream is created with the
+ *  first BBFrame of the stream.
+ *
+ *  @param   qos_nbr                The number of FragID of each stream
+ *  @param   max_reassembly_length  The maximum length of the PDUs being
+ *                                  reassembled for all the streams
+ *  @param   mis                    OUT: The multiple input stream
+ *                                       deencapsulation structure
+ *
+ *  @return
+ *                                  - success/informative code among:
+ *                                    - \ref GSE_STATUS_OK
+ *                                  - warning/error code among:
+ *                                    - \ref GSE_STATUS_NULL_PTR
+ *                                    - \ref GSE_STATUS_INVALID_QOS
+ *                                    - \ref GSE_STATUS_MALLOC_FAILED
+ *
+ *  @ingroup gse_deencap_mis
+ */
+gse_status_t gse_deencap_mis_init(uint8_t qos_nbr,
+                                  size_t max_reassembly_length,
+                                  gse_deencap_mis_t **mis);
+
+/**
+ *  @brief   Release a multiple input stream deencapsulation structure
+ *
+ *  @param   mis  The multiple input stream deencapsulation structure
+ *
+ *  @return
+ *                - success/informative code among:
+ *                  - \ref GSE_STATUS_OK
+ *                - warning/error code among:
+ *                  - \ref GSE_STATUS_NULL_PTR
+ *                  - the first warning/error code returned by
+ *                    \ref gse_deencap_release
+ *
+ *  @ingroup gse_deencap_mis
+ */
+gse_status_t gse_deencap_mis_release(gse_deencap_mis_t *mis);
+
+/**
+ *  @brief   Get the deencapsulation structure of an input stream
+ *
+ *  The structure is created if the stream has not been received yet, it can
+ *  be configured as any deencapsulation structure but it shall not be
+ *  released.
+ *
+ *  @param   mis      The multiple input stream deencapsulation structure
+ *  @param   isi      The input stream identifier
+ *  @param   deencap  OUT: The deencapsulation structure of the stream
+ *
+ *  @return
+ *                    - success/informative code among:
+ *                      - \ref GSE_STATUS_OK
+ *                    - warning/error code among:
+ *                      - \ref GSE_STATUS_NULL_PTR
+ *                      - \ref GSE_STATUS_MALLOC_FAILED
+ *
+ *  @ingroup gse_deencap_mis
+ */
+gse_status_t gse_deencap_mis_get_stream(gse_deencap_mis_t *mis, uint8_t isi,
+                                        gse_deencap_t **deencap);
+
+/**
+ *  @brief   Deencapsulate a BBFrame in the deencapsulation structure of its
+ *           input stream
+ *
+ *  The stream is given by the ISI of the BBHEADER, the BBFrames of a single
+ *  input stream are deencapsulated in the stream 0.
+ *  The complete PDUs shall be retrieved with \ref gse_deencap_mis_get_pdu.
+ *
+ *  @param   bbframe   The BBFrame, starting with its BBHEADER, destroyed by
+ *                     the function
+ *  @param   mis       The multiple input stream deencapsulation structure
+ *  @param   bbheader  OUT: The BBHEADER fields
+ *
+ *  @return
+ *                     - success/informative code among:
+ *                       - \ref GSE_STATUS_OK
+ *                     - warning/error code among:
+ *                       - \ref GSE_STATUS_NULL_PTR
+ *                       - \ref GSE_STATUS_MALLOC_FAILED
+ *                       - \ref GSE_STATUS_POOL_FULL
+ *                       - the warning/error codes of
+ *                         \ref gse_deencap_bbframe
+ *
+ *  @ingroup gse_deencap_mis
+ */
+gse_status_t gse_deencap_mis_bbframe(gse_vfrag_t *bbframe,
+                                     gse_deencap_mis_t *mis,
+                                     gse_bbheader_t *bbheader);
+
+/**
+ *  @brief   Get the next complete PDU of an input stream
+ *
+ *  @param   mis         The multiple input stream deencapsulation structure
+ *  @param   isi         The input stream identifier
+ *  @param   label_type  OUT: The label type of the PDU
+ *  @param   label       OUT: The label of the PDU
+ *  @param   protocol    OUT: The protocol of the PDU
+ *  @param   pdu         OUT: The PDU, NULL if it is dropped
+ *
+ *  @return
+ *                       - success/informative code among:
+ *                         - \ref GSE_STATUS_OK
+ *                         - \ref GSE_STATUS_NO_PDU_QUEUED
+ *                       - warning/error code among:
+ *                         - \ref GSE_STATUS_NULL_PTR
+ *                         - the warning/error codes of
+ *                           \ref gse_deencap_get_pdu
+ *
+ *  @ingroup gse_deencap_mis
+ */
+gse_status_t gse_deencap_mis_get_pdu(gse_deencap_mis_t *mis, uint8_t isi,
+                                     uint8_t *label_type, uint8_t label[6],
+                                     uint16_t *protocol, gse_vfrag_t **pdu);
+
+/**
+ *  @brief   Get the usage of the reassembly pool shared by the input streams
+ *
+ *  @param   mis          The multiple input stream deencapsulation structure
+ *  @param   used_length  OUT: The length of the PDUs being reassembled
+ *  @param   evicted_nbr  OUT: The number of PDUs dropped to make room
+ *
+ *  @return
+ *                        - success/informative code among:
+ *                          - \ref GSE_STATUS_OK
+ *                        - warning/error code among:
+ *                          - \ref GSE_STATUS_NULL_PTR
+ *
+ *  @ingroup gse_deencap_mis
+ */
+gse_status_t gse_deencap_mis_get_usage(gse_deencap_mis_t *mis,
+                                       size_t *used_length,
+                                       unsigned long *evicted_nbr);
+
+#endif
@@ -0,0 +1,536 @@
+/*
+ *
+ * This piece of software is an implementation of the Generic Stream
+ * Encapsulation (GSE) standard defined by ETSI for Linux (or other
+ * Unix-compatible OS). The library may be used to add GSE
+ * encapsulation/de-encapsulation capabilities to an application.
+ *
+ *
+ * Copyright © 2016 TAS
+ *
+ *
+ * This file is part of the GSE library.
+ *
+ *
+ * The GSE library is free software : you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY, without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see http://www.gnu.org/licenses/.
+ *
+ */
+
+/****************************************************************************/
+/**
+ *   @file          test_deencap_bbframe.c
+ *
+ *          Project:     GSE LIBRARY
+ *
+ *          Company:     THALES ALENIA SPACE
+ *
+ *          Module name: DEENCAP
+ *
+ *   @brief         BBFrames built by the frame filler, scrambled and
+ *                  deencapsulated at once
+ *
+ *   @author        Julien BERNARD / Viveris Technologies
+ *
+ */
+/****************************************************************************/
+
+/****************************************************************************
+ *
+ *   INCLUDES
+ *
+ *****************************************************************************/
+
+/* system includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+/* GSE includes */
+#include "encap.h"
+#include "deencap.h"
+
+/****************************************************************************
+ *
+ *   MACROS AND CONSTANTS
+ *
+ *****************************************************************************/
+
+/** The number of FIFOs */
+#define QOS_NBR 2
+/** The size of the FIFOs */
+#define FIFO_SIZE 32
+/** The length of the BBFrames (Kbch/8 of the normal 3/4 code rate) */
+#define BBFRAME_LENGTH 5822
+/** The number of PDUs sent */
+#define PDU_NBR 24
+/** The maximum length of the PDUs */
+#define MAX_PDU_LENGTH 4000
+/** The number of BBFrames sent at most */
+#define MAX_BBFRAME_NBR 32
+/** The type of label carried by the GSE packets */
+#define LABEL_TYPE 0x0
+/** The protocol carried by the GSE packets */
+#define PROTOCOL 0x2345
+
+/* DEBUG macro */
+#define DEBUG(verbose, format, ...) \
+  do { \
+    if(verbose) \
+      printf(format, ##__VA_ARGS__); \
+  } while(0)
+
+/****************************************************************************
+ *
+ *   PROTOTYPES OF PRIVATE FUNCTIONS
+ *
+ *****************************************************************************/
+
+static int test_bbheader(int verbose);
+static int test_scrambler(int verbose);
+static int test_bbframe(int verbose);
+static uint8_t crc8_bitwise(const unsigned char *data, size_t length);
+static void scramble_bitwise(unsigned char *data, size_t length);
+static size_t get_pdu_length(unsigned int index);
+
+/****************************************************************************
+ *
+ *   PUBLIC FUNCTIONS
+ *
+ *****************************************************************************/
+
+/**
+ * @brief Main function for the GSE BBFrame test program
+ *
+ * @param argc  the number of program arguments
+ * @param argv  the program arguments
+ * @return      the unix return code:
+ *               \li 0 in case of success,
+ *               \li 1 in case of failure
+ */
+int main(int argc, char *argv[])
+{
+  int res = 1;
+  int verbose = 0;
+
+  if(argc > 2 || argc < 1)
+  {
+    printf("USAGE : test_deencap_bbframe [verbose]\n");
+  }
+  else
+  {
+    if(argc == 2)
+    {
+      if(!strcmp(argv[1], "verbose"))
+      {
+        verbose = 1;
+      }
+      else
+      {
+        printf("USAGE : test_deencap_bbframe [verbose]\n");
+        goto quit;
+      }
+    }
+    res = test_bbheader(verbose) || test_scrambler(verbose) ||
+          test_bbframe(verbose);
+  }
+
+quit:
+  return res;
+}
+
+/****************************************************************************
+ *
+ *   PRIVATE FUNCTIONS
+ *
+ *****************************************************************************/
+
+/**
+ * @brief Build and parse BBHEADERs
+ *
+ * @param   verbose  Print debug if verbose is 1
+ * @return  0 on success, 1 on failure
+ */
+static int test_bbheader(int verbose)
+{
+  unsigned char buffer[GSE_BBHEADER_LENGTH + 16];
+  gse_bbheader_t bbheader;
+  gse_bbheader_t parsed;
+  gse_status_t status;
+
+  memset(&bbheader, 0, sizeof(gse_bbheader_t));
+  bbheader.ts_gs = GSE_BB_TS_GS_GENERIC_CONTINUOUS;
+  bbheader.sis_mis = 0;
+  bbheader.ccm_acm = 1;
+  bbheader.ro = 2;
+  bbheader.isi = 0x42;
+  bbheader.dfl = 16 * 8;
+
+  status = gse_build_bbheader(&bbheader, buffer);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when building BBHEADER (%s)\n",
+          status, gse_get_status(status));
+    return 1;
+  }
+  if(buffer[0] != 0x52 || buffer[1] != 0x42 || buffer[4] != 0x00 ||
+     buffer[5] != 0x80 || buffer[9] != crc8_bitwise(buffer, 9))
+  {
+    DEBUG(verbose, "Wrong BBHEADER %02x %02x ... CRC-8 %02x\n",
+          buffer[0], buffer[1], buffer[9]);
+    return 1;
+  }
+
+  status = gse_parse_bbheader(buffer, sizeof(buffer), &parsed);
+  if(status != GSE_STATUS_OK ||
+     memcmp(&parsed, &bbheader, sizeof(gse_bbheader_t)) != 0)
+  {
+    DEBUG(verbose, "BBHEADER not parsed (status %#.4x)\n", status);
+    return 1;
+  }
+  status = gse_parse_bbheader(buffer, sizeof(buffer) - 1, &parsed);
+  if(status != GSE_STATUS_INVALID_DFL)
+  {
+    DEBUG(verbose, "Too long data field not detected (status %#.4x)\n",
+          status);
+    return 1;
+  }
+  buffer[3] ^= 0x10;
+  status = gse_parse_bbheader(buffer, sizeof(buffer), &parsed);
+  if(status != GSE_STATUS_INVALID_BBHEADER_CRC)
+  {
+    DEBUG(verbose, "Wrong CRC-8 not detected (status %#.4x)\n", status);
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * @brief Scramble BBFrames and compare with a bitwise scrambler
+ *
+ * @param   verbose  Print debug if verbose is 1
+ * @return  0 on success, 1 on failure
+ */
+static int test_scrambler(int verbose)
+{
+  /* First bytes of the sequence for a null BBFrame */
+  const unsigned char first_bytes[] = { 0x03, 0xF6, 0x08, 0x34 };
+  static unsigned char bbframe[GSE_MAX_BBFRAME_LENGTH];
+  static unsigned char ref[GSE_MAX_BBFRAME_LENGTH];
+  gse_status_t status;
+  size_t lengths[] = { 0, 1, 7, 9, 3072, 5822, GSE_MAX_BBFRAME_LENGTH };
+  unsigned int i;
+  size_t j;
+
+  memset(bbframe, 0, sizeof(bbframe));
+  status = gse_scramble_bbframe(bbframe, GSE_MAX_BBFRAME_LENGTH);
+  if(status != GSE_STATUS_OK ||
+     memcmp(bbframe, first_bytes, sizeof(first_bytes)))
+  {
+    DEBUG(verbose, "Wrong scrambling sequence %02x %02x %02x %02x "
+          "(status %#.4x)\n", bbframe[0], bbframe[1], bbframe[2], bbframe[3],
+          status);
+    return 1;
+  }
+
+  for(i = 0 ; i < sizeof(lengths) / sizeof(lengths[0]) ; i++)
+  {
+    for(j = 0 ; j < lengths[i] ; j++)
+    {
+      bbframe[j] = (j * 7 + i) & 0xFF;
+    }
+    memcpy(ref, bbframe, lengths[i]);
+    scramble_bitwise(ref, lengths[i]);
+    status = gse_scramble_bbframe(bbframe, lengths[i]);
+    if(status != GSE_STATUS_OK || memcmp(bbframe, ref, lengths[i]))
+    {
+      DEBUG(verbose, "Wrong scrambling of %zu bytes (status %#.4x)\n",
+            lengths[i], status);
+      return 1;
+    }
+    status = gse_descramble_bbframe(bbframe, lengths[i]);
+    for(j = 0 ; j < lengths[i] ; j++)
+    {
+      if(bbframe[j] != ((j * 7 + i) & 0xFF))
+      {
+        break;
+      }
+    }
+    if(status != GSE_STATUS_OK || j != lengths[i])
+    {
+      DEBUG(verbose, "Wrong descrambling of %zu bytes (status %#.4x)\n",
+            lengths[i], status);
+      return 1;
+    }
+  }
+
+  status = gse_scramble_bbframe(bbframe, GSE_MAX_BBFRAME_LENGTH + 1);
+  if(status != GSE_STATUS_INVALID_BBFRAME_LENGTH)
+  {
+    DEBUG(verbose, "Too long BBFrame not detected (status %#.4x)\n", status);
+    return 1;
+  }
+
+  return 0;
+}
+
+/**
+ * @brief Fill BBFrames with the frame filler and deencapsulate them
+ *
+ * @param   verbose  Print debug if verbose is 1
+ * @return  0 on success, 1 on failure
+ */
+static int test_bbframe(int verbose)
+{
+  int is_failure = 1;
+  gse_encap_t *encap = NULL;
+  gse_deencap_t *deencap = NULL;
+  gse_vfrag_t *vfrag;
+  gse_vfrag_t *pdu = NULL;
+  gse_status_t status;
+  gse_bbheader_t bbheader;
+  gse_bbheader_t rcv_bbheader;
+  unsigned char *pdu_data;
+  uint8_t label[6] = { 0, 1, 2, 3, 4, 5 };
+  uint8_t rcv_label[6];
+  uint8_t label_type;
+  uint16_t protocol;
+  unsigned int pdu_index;
+  unsigned int rcv_nbr = 0;
+  unsigned int bbframe_nbr;
+  size_t data_length;
+  unsigned int i;
+
+  pdu_data = malloc(MAX_PDU_LENGTH);
+  if(pdu_data == NULL)
+  {
+    DEBUG(verbose, "Cannot allocate the PDU data\n");
+    goto quit;
+  }
+  for(i = 0 ; i < MAX_PDU_LENGTH ; i++)
+  {
+    pdu_data[i] = (i * 7) % 253;
+  }
+
+  status = gse_encap_init(QOS_NBR, FIFO_SIZE, &encap);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when initializing encapsulation (%s)\n",
+          status, gse_get_status(status));
+    goto free_data;
+  }
+  status = gse_deencap_init(QOS_NBR, &deencap);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when initializing deencapsulation (%s)\n",
+          status, gse_get_status(status));
+    goto release_encap;
+  }
+
+  for(pdu_index = 0 ; pdu_index < PDU_NBR ; pdu_index++)
+  {
+    status = gse_create_vfrag_with_data(&vfrag, get_pdu_length(pdu_index),
+                                        GSE_MAX_HEADER_LENGTH,
+                                        GSE_MAX_TRAILER_LENGTH,
+                                        pdu_data + pdu_index,
+                                        get_pdu_length(pdu_index));
+    if(status != GSE_STATUS_OK)
+    {
+      DEBUG(verbose, "Error %#.4x when creating PDU (%s)\n",
+            status, gse_get_status(status));
+      goto release_deencap;
+    }
+    status = gse_encap_receive_pdu(vfrag, encap, label, LABEL_TYPE, PROTOCOL,
+                                   pdu_index % QOS_NBR);
+    if(status != GSE_STATUS_OK)
+    {
+      DEBUG(verbose, "Error %#.4x when receiving PDU (%s)\n",
+            status, gse_get_status(status));
+      goto release_deencap;
+    }
+  }
+
+  memset(&bbheader, 0, sizeof(gse_bbheader_t));
+  bbheader.ts_gs = GSE_BB_TS_GS_GENERIC_CONTINUOUS;
+  bbheader.sis_mis = 1;
+  bbheader.ccm_acm = 1;
+
+  for(bbframe_nbr = 0 ; bbframe_nbr < MAX_BBFRAME_NBR ; bbframe_nbr++)
+  {
+    status = gse_create_vfrag(&vfrag, BBFRAME_LENGTH, 0, 0);
+    if(status != GSE_STATUS_OK)
+    {
+      DEBUG(verbose, "Error %#.4x when creating BBFrame (%s)\n",
+            status, gse_get_status(status));
+      goto release_deencap;
+    }
+    status = gse_encap_fill_bbframe(encap, GSE_FILL_FIRST_FIT, &bbheader,
+                                    gse_get_vfrag_start(vfrag),
+                                    BBFRAME_LENGTH, &data_length, NULL);
+    if(status == GSE_STATUS_FIFO_EMPTY)
+    {
+      gse_free_vfrag(&vfrag);
+      break;
+    }
+    if(status != GSE_STATUS_OK)
+    {
+      DEBUG(verbose, "Error %#.4x when filling BBFrame (%s)\n",
+            status, gse_get_status(status));
+      gse_free_vfrag(&vfrag);
+      goto release_deencap;
+    }
+    DEBUG(verbose, "BBFrame %u: %zu bytes of GSE packets\n", bbframe_nbr,
+          data_length);
+
+    /* Go through the scrambler as on the air interface */
+    status = gse_scramble_bbframe(gse_get_vfrag_start(vfrag),
+                                  BBFRAME_LENGTH);
+    if(status == GSE_STATUS_OK)
+    {
+      status = gse_descramble_bbframe(gse_get_vfrag_start(vfrag),
+                                      BBFRAME_LENGTH);
+    }
+    if(status != GSE_STATUS_OK)
+    {
+      DEBUG(verbose, "Error %#.4x when scrambling BBFrame (%s)\n",
+            status, gse_get_status(status));
+      gse_free_vfrag(&vfrag);
+      goto release_deencap;
+    }
+
+    status = gse_deencap_bbframe(vfrag, deencap, &rcv_bbheader);
+    if(status != GSE_STATUS_OK || rcv_bbheader.dfl != data_length * 8 ||
+       rcv_bbheader.sis_mis != 1 || rcv_bbheader.ccm_acm != 1)
+    {
+      DEBUG(verbose, "Error %#.4x when deencapsulating BBFrame (%s)\n",
+            status, gse_get_status(status));
+      goto release_deencap;
+    }
+
+    /* The PDUs are received in order within each FIFO, the FIFOs are
+     * served by priority so only the lengths of the PDUs are checked */
+    while((status = gse_deencap_get_pdu(deencap, &label_type, rcv_label,
+                                        &protocol, &pdu))
+          == GSE_STATUS_PDU_RECEIVED)
+    {
+      size_t length = gse_get_vfrag_length(pdu);
+
+      for(i = 0 ; i < PDU_NBR ; i++)
+      {
+        if(get_pdu_length(i) == length &&
+           memcmp(gse_get_vfrag_start(pdu), pdu_data + i, length) == 0)
+        {
+          break;
+        }
+      }
+      if(i == PDU_NBR || protocol != PROTOCOL ||
+         memcmp(rcv_label, label, 6) != 0)
+      {
+        DEBUG(verbose, "Unexpected PDU of %zu bytes\n", length);
+        goto free_pdu;
+      }
+      gse_free_vfrag(&pdu);
+      rcv_nbr++;
+    }
+    if(status != GSE_STATUS_NO_PDU_QUEUED)
+    {
+      DEBUG(verbose, "Error %#.4x when getting PDU (%s)\n",
+            status, gse_get_status(status));
+      goto release_deencap;
+    }
+  }
+
+  DEBUG(verbose, "%u PDUs received in %u BBFrames\n", rcv_nbr, bbframe_nbr);
+  if(rcv_nbr != PDU_NBR)
+  {
+    DEBUG(verbose, "%u PDUs missing\n", PDU_NBR - rcv_nbr);
+    goto release_deencap;
+  }
+
+  is_failure = 0;
+
+free_pdu:
+  if(pdu != NULL)
+  {
+    gse_free_vfrag(&pdu);
+  }
+release_deencap:
+  gse_deencap_release(deencap);
+release_encap:
+  gse_encap_release(encap);
+free_data:
+  free(pdu_data);
+quit:
+  return is_failure;
+}
+
+/**
+ * @brief Compute the CRC-8 of a BBHEADER bit after bit
+ *
+ * @param   data    The data
+ * @param   length  The length of the data
+ * @return  The CRC-8
+ */
+static uint8_t crc8_bitwise(const unsigned char *data, size_t length)
+{
+  uint8_t crc = 0;
+  size_t i;
+  int bit;
+
+  for(i = 0 ; i < length ; i++)
+  {
+    crc ^= data[i];
+    for(bit = 0 ; bit < 8 ; bit++)
+    {
+      crc = (crc & 0x80) ? (crc << 1) ^ 0xD5 : (crc << 1);
+    }
+  }
+  return crc;
+}
+
+/**
+ * @brief Scramble data bit after bit with the 1 + x^14 + x^15 PRBS
+ *
+ * @param   data    The data
+ * @param   length  The length of the data
+ */
+static void scramble_bitwise(unsigned char *data, size_t length)
+{
+  /* 100101010000000 with the first stage in the LSB */
+  unsigned int reg = 0x00A9;
+  unsigned int prbs;
+  size_t i;
+  int bit;
+
+  for(i = 0 ; i < length ; i++)
+  {
+    for(bit = 7 ; bit >= 0 ; bit--)
+    {
+      prbs = ((reg >> 13) ^ (reg >> 14)) & 0x1;
+      reg = ((reg << 1) | prbs) & 0x7FFF;
+      data[i] ^= prbs << bit;
+    }
+  }
+}
+
+/**
+ * @brief Get the length of a PDU, the lengths are all different
+ *
+ * @param   index  The index of the PDU
+ * @return  The length of the PDU
+ */
+static size_t get_pdu_length(unsigned int index)
+{
+  return (index % 2 ? 100 + index * 37 : MAX_PDU_LENGTH - PDU_NBR - index * 53);
+}
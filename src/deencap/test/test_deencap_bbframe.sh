@@ -0,0 +1,16 @@
+#!/bin/sh
+
+APP="test_deencap_bbframe"
+
+# parse arguments
+SCRIPT="$0"
+if [ "x$MAKELEVEL" != "x" ] ; then
+    BASEDIR="${srcdir}"
+    APP="./${APP}"
+else
+    BASEDIR=$( dirname "${SCRIPT}" )
+    APP="${BASEDIR}/${APP}"
+fi
+
+${APP} || ${APP} verbose
+
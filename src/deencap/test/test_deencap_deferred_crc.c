@@ -0,0 +1,389 @@
+/*
+ *
+ * This piece of software is an implementation of the Generic Stream
+ * Encapsulation (GSE) standard defined by ETSI for Linux (or other
+ * Unix-compatible OS). The library may be used to add GSE
+ * encapsulation/de-encapsulation capabilities to an application.
+ *
+ *
+ * Copyright © 2016 TAS
+ *
+ *
+ * This file is part of the GSE library.
+ *
+ *
+ * The GSE library is free software : you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY, without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see http://www.gnu.org/licenses/.
+ *
+ */
+
+/****************************************************************************/
+/**
+ *   @file          test_deencap_deferred_crc.c
+ *
+ *          Project:     GSE LIBRARY
+ *
+ *          Company:     THALES ALENIA SPACE
+ *
+ *          Module name: DEENCAP
+ *
+ *   @brief         Deferred CRC verification of the received PDUs
+ *
+ *   @author        Julien BERNARD / Viveris Technologies
+ *
+ */
+/****************************************************************************/
+
+/****************************************************************************
+ *
+ *   INCLUDES
+ *
+ *****************************************************************************/
+
+/* system includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+/* GSE includes */
+#include "encap.h"
+#include "deencap.h"
+
+/****************************************************************************
+ *
+ *   MACROS AND CONSTANTS
+ *
+ *****************************************************************************/
+
+/** The number of FIFOs */
+#define QOS_NBR 2
+/** The size of the FIFOs */
+#define FIFO_SIZE 4
+/** The length of the GSE packets */
+#define PACKET_LENGTH 500
+/** The length of the fragmented PDUs */
+#define PDU_LENGTH 5000
+/** The length of the complete PDUs */
+#define SMALL_PDU_LENGTH 200
+/** The number of PDUs sent */
+#define PDU_NBR 9
+/** The number of PDUs verified together */
+#define CRC_BATCH 4
+/** The PDU sent with a wrong CRC */
+#define BAD_PDU 5
+/** The maximum number of packets of a PDU */
+#define MAX_PACKET_NBR 16
+/** The type of label carried by the GSE packets */
+#define LABEL_TYPE 0x0
+/** The protocol carried by the GSE packets */
+#define PROTOCOL 0x2345
+
+/* DEBUG macro */
+#define DEBUG(verbose, format, ...) \
+  do { \
+    if(verbose) \
+      printf(format, ##__VA_ARGS__); \
+  } while(0)
+
+/****************************************************************************
+ *
+ *   PROTOTYPES OF PRIVATE FUNCTIONS
+ *
+ *****************************************************************************/
+
+static int test_deferred_crc(int verbose);
+static size_t get_pdu_length(unsigned int index);
+static int build_packets(int verbose, unsigned char *pdu_data,
+                         size_t pdu_length, gse_vfrag_t **packets,
+                         unsigned int *packet_nbr);
+
+/****************************************************************************
+ *
+ *   PUBLIC FUNCTIONS
+ *
+ *****************************************************************************/
+
+/**
+ * @brief Main function for the GSE deferred CRC verification test program
+ *
+ * @param argc  the number of program arguments
+ * @param argv  the program arguments
+ * @return      the unix return code:
+ *               \li 0 in case of success,
+ *               \li 1 in case of failure
+ */
+int main(int argc, char *argv[])
+{
+  int res = 1;
+  int verbose = 0;
+
+  if(argc > 2 || argc < 1)
+  {
+    printf("USAGE : test_deencap_deferred_crc [verbose]\n");
+  }
+  else
+  {
+    if(argc == 2)
+    {
+      if(!strcmp(argv[1], "verbose"))
+      {
+        verbose = 1;
+      }
+      else
+      {
+        printf("USAGE : test_deencap_deferred_crc [verbose]\n");
+        goto quit;
+      }
+    }
+    res = test_deferred_crc(verbose);
+  }
+
+quit:
+  return res;
+}
+
+/****************************************************************************
+ *
+ *   PRIVATE FUNCTIONS
+ *
+ *****************************************************************************/
+
+/**
+ * @brief Deencapsulate complete and fragmented PDUs with a deferred CRC
+ *        verification and check they are returned in order
+ *
+ * @param   verbose  Print debug if verbose is 1
+ * @return  0 on success, 1 on failure
+ */
+static int test_deferred_crc(int verbose)
+{
+  int is_failure = 1;
+  gse_deencap_t *deencap = NULL;
+  gse_vfrag_t *packets[MAX_PACKET_NBR];
+  gse_vfrag_t *pdu = NULL;
+  gse_status_t status;
+  unsigned char pdu_data[PDU_NBR][PDU_LENGTH];
+  unsigned int packet_nbr = 0;
+  unsigned int pdu_index;
+  unsigned int i;
+  uint8_t label[6];
+  uint8_t label_type;
+  uint16_t protocol;
+  uint16_t packet_length;
+
+  for(pdu_index = 0 ; pdu_index < PDU_NBR ; pdu_index++)
+  {
+    for(i = 0 ; i < PDU_LENGTH ; i++)
+    {
+      pdu_data[pdu_index][i] = (i * 13 + pdu_index) % 255;
+    }
+  }
+
+  status = gse_deencap_init(QOS_NBR, &deencap);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when initializing deencapsulation (%s)\n",
+          status, gse_get_status(status));
+    goto quit;
+  }
+  status = gse_deencap_set_deferred_crc(deencap, CRC_BATCH);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when deferring CRC (%s)\n",
+          status, gse_get_status(status));
+    goto release_deencap;
+  }
+
+  /* All the PDUs are queued, one of them with a wrong CRC */
+  for(pdu_index = 0 ; pdu_index < PDU_NBR ; pdu_index++)
+  {
+    if(build_packets(verbose, pdu_data[pdu_index], get_pdu_length(pdu_index),
+                     packets, &packet_nbr))
+    {
+      goto release_deencap;
+    }
+    if(pdu_index == BAD_PDU)
+    {
+      packets[packet_nbr - 1]->end[-1] ^= 0xFF;
+    }
+    for(i = 0 ; i < packet_nbr ; i++)
+    {
+      status = gse_deencap_packet(packets[i], deencap, &label_type, label,
+                                  &protocol, &pdu, &packet_length);
+      packets[i] = NULL;
+      if(pdu != NULL ||
+         (i + 1 < packet_nbr && status != GSE_STATUS_OK) ||
+         (i + 1 == packet_nbr && status != GSE_STATUS_PDU_QUEUED))
+      {
+        DEBUG(verbose, "PDU %u packet %u: unexpected status %#.4x (%s)\n",
+              pdu_index, i, status, gse_get_status(status));
+        while(++i < packet_nbr)
+        {
+          gse_free_vfrag(&packets[i]);
+        }
+        if(pdu != NULL)
+        {
+          gse_free_vfrag(&pdu);
+        }
+        goto release_deencap;
+      }
+    }
+  }
+
+  /* The PDUs are returned in order after their verification */
+  for(pdu_index = 0 ; pdu_index < PDU_NBR ; pdu_index++)
+  {
+    status = gse_deencap_get_pdu(deencap, &label_type, label, &protocol, &pdu);
+    DEBUG(verbose, "PDU %u: status %#.4x (%s)\n", pdu_index, status,
+          gse_get_status(status));
+    if(protocol != PROTOCOL || label_type != LABEL_TYPE)
+    {
+      DEBUG(verbose, "Wrong protocol or label type for PDU %u\n", pdu_index);
+      goto free_pdu;
+    }
+    if(pdu_index == BAD_PDU)
+    {
+      if(status != GSE_STATUS_INVALID_CRC || pdu != NULL)
+      {
+        DEBUG(verbose, "PDU with wrong CRC not dropped\n");
+        goto free_pdu;
+      }
+      continue;
+    }
+    if(status != GSE_STATUS_PDU_RECEIVED ||
+       gse_get_vfrag_length(pdu) != get_pdu_length(pdu_index) ||
+       memcmp(gse_get_vfrag_start(pdu), pdu_data[pdu_index],
+              get_pdu_length(pdu_index)) != 0)
+    {
+      DEBUG(verbose, "PDU %u not returned in order\n", pdu_index);
+      goto free_pdu;
+    }
+    gse_free_vfrag(&pdu);
+  }
+  status = gse_deencap_get_pdu(deencap, &label_type, label, &protocol, &pdu);
+  if(status != GSE_STATUS_NO_PDU_QUEUED)
+  {
+    DEBUG(verbose, "Unexpected status %#.4x on empty queue\n", status);
+    goto free_pdu;
+  }
+
+  /* The queued PDUs are freed on release */
+  if(build_packets(verbose, pdu_data[0], get_pdu_length(0), packets,
+                   &packet_nbr))
+  {
+    goto release_deencap;
+  }
+  for(i = 0 ; i < packet_nbr ; i++)
+  {
+    status = gse_deencap_packet(packets[i], deencap, &label_type, label,
+                                &protocol, &pdu, &packet_length);
+  }
+  if(status != GSE_STATUS_PDU_QUEUED)
+  {
+    DEBUG(verbose, "PDU not queued before release\n");
+    goto release_deencap;
+  }
+
+  is_failure = 0;
+
+free_pdu:
+  if(pdu != NULL)
+  {
+    gse_free_vfrag(&pdu);
+  }
+release_deencap:
+  gse_deencap_release(deencap);
+quit:
+  return is_failure;
+}
+
+/**
+ * @brief Get the length of a PDU, one PDU in three is a complete one
+ *
+ * @param   index  The index of the PDU
+ * @return  The length of the PDU
+ */
+static size_t get_pdu_length(unsigned int index)
+{
+  return (index % 3 == 1 ? SMALL_PDU_LENGTH : PDU_LENGTH - index * 31);
+}
+
+/**
+ * @brief Encapsulate a PDU in GSE packets
+ *
+ * @param   verbose     Print debug if verbose is 1
+ * @param   pdu_data    The PDU data
+ * @param   pdu_length  The PDU length
+ * @param   packets     OUT: The GSE packets
+ * @param   packet_nbr  OUT: The number of GSE packets
+ * @return  0 on success, 1 on failure
+ */
+static int build_packets(int verbose, unsigned char *pdu_data,
+                         size_t pdu_length, gse_vfrag_t **packets,
+                         unsigned int *packet_nbr)
+{
+  int is_failure = 1;
+  gse_encap_t *encap;
+  gse_vfrag_t *pdu;
+  gse_status_t status;
+  uint8_t label[6] = { 0, 1, 2, 3, 4, 5 };
+
+  *packet_nbr = 0;
+  status = gse_encap_init(QOS_NBR, FIFO_SIZE, &encap);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when initializing encapsulation (%s)\n",
+          status, gse_get_status(status));
+    goto quit;
+  }
+  status = gse_create_vfrag_with_data(&pdu, pdu_length, GSE_MAX_HEADER_LENGTH,
+                                      GSE_MAX_TRAILER_LENGTH, pdu_data,
+                                      pdu_length);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when creating PDU (%s)\n",
+          status, gse_get_status(status));
+    goto release_encap;
+  }
+  status = gse_encap_receive_pdu(pdu, encap, label, LABEL_TYPE, PROTOCOL, 1);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when receiving PDU (%s)\n",
+          status, gse_get_status(status));
+    goto release_encap;
+  }
+  while(*packet_nbr < MAX_PACKET_NBR &&
+        (status = gse_encap_get_packet_copy(&packets[*packet_nbr], encap,
+                                            PACKET_LENGTH, 1))
+        == GSE_STATUS_OK)
+  {
+    (*packet_nbr)++;
+  }
+  if(status != GSE_STATUS_FIFO_EMPTY)
+  {
+    DEBUG(verbose, "Error %#.4x when getting packet (%s)\n",
+          status, gse_get_status(status));
+    while(*packet_nbr > 0)
+    {
+      gse_free_vfrag(&packets[--(*packet_nbr)]);
+    }
+    goto release_encap;
+  }
+  is_failure = 0;
+
+release_encap:
+  gse_encap_release(encap);
+quit:
+  return is_failure;
+}
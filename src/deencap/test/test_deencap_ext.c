@@ -0,0 +1,428 @@
+/*
+ *
+ * This piece of software is an implementation of the Generic Stream
+ * Encapsulation (GSE) standard defined by ETSI for Linux (or other
+ * Unix-compatible OS). The library may be used to add GSE
+ * encapsulation/de-encapsulation capabilities to an application.
+ *
+ *
+ * Copyright © 2016 TAS
+ *
+ *
+ * This file is part of the GSE library.
+ *
+ *
+ * The GSE library is free software : you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY, without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see http://www.gnu.org/licenses/.
+ *
+ */
+
+/****************************************************************************/
+/**
+ *   @file          test_deencap_ext.c
+ *
+ *          Project:     GSE LIBRARY
+ *
+ *          Company:     THALES ALENIA SPACE
+ *
+ *          Module name: DEENCAP
+ *
+ *   @brief         Header extensions of complete and fragmented PDUs
+ *
+ *   @author        Julien BERNARD / Viveris Technologies
+ *
+ */
+/****************************************************************************/
+
+/****************************************************************************
+ *
+ *   INCLUDES
+ *
+ *****************************************************************************/
+
+/* system includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+/* GSE includes */
+#include "encap.h"
+#include "encap_header_ext.h"
+#include "deencap.h"
+#include "deencap_header_ext.h"
+
+/****************************************************************************
+ *
+ *   MACROS AND CONSTANTS
+ *
+ *****************************************************************************/
+
+/** The number of FIFOs */
+#define QOS_NBR 1
+/** The size of the FIFOs */
+#define FIFO_SIZE 4
+/** The length of the PDUs sent in one packet */
+#define SHORT_PDU_LENGTH 200
+/** The length of the fragmented PDUs */
+#define LONG_PDU_LENGTH 1000
+/** The length of the GSE packets */
+#define PACKET_LENGTH 400
+/** The length of the header extensions, longer than the CRC so that a
+ *  reassembly buffer sized with a wrong extension length is too short */
+#define EXT_LENGTH 8
+/** The type of the header extensions: 00000 | H-LEN 100 | H-TYPE 0xAB */
+#define EXT_TYPE 0x04AB
+/** The type of label carried by the GSE packets */
+#define LABEL_TYPE 0x0
+/** The protocol carried by the GSE packets */
+#define PROTOCOL 0x2345
+
+/* DEBUG macro */
+#define DEBUG(verbose, format, ...) \
+  do { \
+    if(verbose) \
+      printf(format, ##__VA_ARGS__); \
+  } while(0)
+
+/** The lengths of the PDUs sent, two fragmented PDUs follow each other on
+ *  the same FragID */
+static const size_t pdu_lengths[] =
+{
+  SHORT_PDU_LENGTH,
+  LONG_PDU_LENGTH,
+  LONG_PDU_LENGTH,
+  SHORT_PDU_LENGTH,
+  LONG_PDU_LENGTH,
+};
+
+/** The number of PDUs sent */
+#define PDU_NBR (sizeof(pdu_lengths) / sizeof(pdu_lengths[0]))
+
+/****************************************************************************
+ *
+ *   PROTOTYPES OF PRIVATE FUNCTIONS
+ *
+ *****************************************************************************/
+
+static int test_ext(int verbose);
+static int push_pdu(int verbose, gse_encap_t *encap, size_t length);
+static int check_packet(int verbose, gse_deencap_t *deencap,
+                        gse_vfrag_t *packet, size_t pdu_length,
+                        int *received);
+static int build_ext(unsigned char *ext, size_t *length,
+                     uint16_t *extension_type, uint16_t protocol_type,
+                     void *opaque);
+static int read_ext(unsigned char *ext, size_t *length,
+                    uint16_t *protocol_type, uint16_t extension_type,
+                    void *opaque);
+
+/****************************************************************************
+ *
+ *   PUBLIC FUNCTIONS
+ *
+ *****************************************************************************/
+
+/**
+ * @brief Main function for the GSE header extensions deencapsulation test
+ *        program
+ *
+ * @param argc  the number of program arguments
+ * @param argv  the program arguments
+ * @return      the unix return code:
+ *               \li 0 in case of success,
+ *               \li 1 in case of failure
+ */
+int main(int argc, char *argv[])
+{
+  int res = 1;
+  int verbose = 0;
+
+  if(argc > 2 || argc < 1)
+  {
+    printf("USAGE : test_deencap_ext [verbose]\n");
+  }
+  else
+  {
+    if(argc == 2)
+    {
+      if(!strcmp(argv[1], "verbose"))
+      {
+        verbose = 1;
+      }
+      else
+      {
+        printf("USAGE : test_deencap_ext [verbose]\n");
+        goto quit;
+      }
+    }
+    res = test_ext(verbose);
+  }
+
+quit:
+  return res;
+}
+
+/****************************************************************************
+ *
+ *   PRIVATE FUNCTIONS
+ *
+ *****************************************************************************/
+
+/**
+ * @brief Encapsulate complete and fragmented PDUs with header extensions and
+ *        check the protocol and the data of the deencapsulated PDUs
+ *
+ * @param   verbose  Print debug if verbose is 1
+ * @return  0 on success, 1 on failure
+ */
+static int test_ext(int verbose)
+{
+  int is_failure = 1;
+  gse_encap_t *encap = NULL;
+  gse_deencap_t *deencap = NULL;
+  gse_vfrag_t *packet = NULL;
+  gse_status_t status;
+  unsigned int built_nbr = 0;
+  unsigned int read_nbr = 0;
+  unsigned int i;
+  int received;
+
+  status = gse_encap_init(QOS_NBR, FIFO_SIZE, &encap);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when initializing encapsulation (%s)\n",
+          status, gse_get_status(status));
+    goto quit;
+  }
+  status = gse_deencap_init(QOS_NBR, &deencap);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when initializing deencapsulation (%s)\n",
+          status, gse_get_status(status));
+    goto release_encap;
+  }
+  status = gse_encap_set_extension_callback(encap, build_ext, &built_nbr);
+  if(status == GSE_STATUS_OK)
+  {
+    status = gse_deencap_set_extension_callback(deencap, read_ext,
+                                                &read_nbr);
+  }
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when setting extension callbacks (%s)\n",
+          status, gse_get_status(status));
+    goto release_deencap;
+  }
+
+  for(i = 0 ; i < PDU_NBR ; i++)
+  {
+    if(push_pdu(verbose, encap, pdu_lengths[i]))
+    {
+      goto release_deencap;
+    }
+    received = 0;
+    while((status = gse_encap_get_packet_copy(&packet, encap, PACKET_LENGTH,
+                                              0)) == GSE_STATUS_OK)
+    {
+      if(check_packet(verbose, deencap, packet, pdu_lengths[i], &received))
+      {
+        goto release_deencap;
+      }
+    }
+    if(status != GSE_STATUS_FIFO_EMPTY || !received)
+    {
+      DEBUG(verbose, "PDU %u not received\n", i);
+      goto release_deencap;
+    }
+  }
+
+  if(built_nbr != PDU_NBR || read_nbr != PDU_NBR)
+  {
+    DEBUG(verbose, "%u extensions built and %u read\n", built_nbr,
+          read_nbr);
+    goto release_deencap;
+  }
+
+  is_failure = 0;
+
+release_deencap:
+  gse_deencap_release(deencap);
+release_encap:
+  gse_encap_release(encap);
+quit:
+  return is_failure;
+}
+
+/**
+ * @brief Create a PDU and give it to the encapsulation
+ *
+ * @param   verbose  Print debug if verbose is 1
+ * @param   encap    The encapsulation structure
+ * @param   length   The PDU length
+ * @return  0 on success, 1 on failure
+ */
+static int push_pdu(int verbose, gse_encap_t *encap, size_t length)
+{
+  gse_vfrag_t *pdu;
+  gse_status_t status;
+  uint8_t label[6] = { 0, 1, 2, 3, 4, 5 };
+  unsigned int i;
+
+  status = gse_create_vfrag(&pdu, length, GSE_MAX_HEADER_LENGTH + EXT_LENGTH,
+                            GSE_MAX_TRAILER_LENGTH);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when creating PDU (%s)\n",
+          status, gse_get_status(status));
+    return 1;
+  }
+  for(i = 0 ; i < length ; i++)
+  {
+    pdu->start[i] = i % 251;
+  }
+  status = gse_encap_receive_pdu(pdu, encap, label, LABEL_TYPE, PROTOCOL, 0);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when receiving PDU (%s)\n",
+          status, gse_get_status(status));
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * @brief Deencapsulate a GSE packet and check the PDU if it is complete
+ *
+ * @param   verbose     Print debug if verbose is 1
+ * @param   deencap     The deencapsulation structure
+ * @param   packet      The GSE packet, destroyed
+ * @param   pdu_length  The expected PDU length
+ * @param   received    OUT: Set to 1 if the PDU is received
+ * @return  0 on success, 1 on failure
+ */
+static int check_packet(int verbose, gse_deencap_t *deencap,
+                        gse_vfrag_t *packet, size_t pdu_length,
+                        int *received)
+{
+  gse_vfrag_t *pdu = NULL;
+  gse_status_t status;
+  uint8_t label[6];
+  uint8_t label_type;
+  uint16_t protocol;
+  uint16_t packet_length;
+  unsigned int i;
+
+  DEBUG(verbose, "Packet S=%u E=%u length=%zu\n",
+        (packet->start[0] >> 7) & 0x1, (packet->start[0] >> 6) & 0x1,
+        packet->length);
+  status = gse_deencap_packet(packet, deencap, &label_type, label, &protocol,
+                              &pdu, &packet_length);
+  if(status == GSE_STATUS_PDU_RECEIVED)
+  {
+    if(protocol != PROTOCOL || pdu->length != pdu_length)
+    {
+      DEBUG(verbose, "Unexpected PDU received (protocol %#.4x, length %zu)\n",
+            protocol, pdu->length);
+      gse_free_vfrag(&pdu);
+      return 1;
+    }
+    for(i = 0 ; i < pdu_length ; i++)
+    {
+      if(pdu->start[i] != i % 251)
+      {
+        DEBUG(verbose, "Unexpected data at offset %u\n", i);
+        gse_free_vfrag(&pdu);
+        return 1;
+      }
+    }
+    *received = 1;
+    gse_free_vfrag(&pdu);
+  }
+  else if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when deencapsulating packet (%s)\n",
+          status, gse_get_status(status));
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * @brief Build the header extension carried before the PDUs
+ *
+ * @param   ext             OUT: The header extensions
+ * @param   length          IN: The room for the extensions
+ *                          OUT: The length of the extensions
+ * @param   extension_type  OUT: The type of the first extension
+ * @param   protocol_type   The protocol of the PDU
+ * @param   opaque          The number of extensions built
+ * @return  The length of the extensions, -1 on failure
+ */
+static int build_ext(unsigned char *ext, size_t *length,
+                     uint16_t *extension_type, uint16_t protocol_type,
+                     void *opaque)
+{
+  unsigned int *built_nbr = opaque;
+  unsigned int i;
+
+  if(*length < EXT_LENGTH)
+  {
+    return -1;
+  }
+  (*built_nbr)++;
+  for(i = 0 ; i < EXT_LENGTH - 2 ; i++)
+  {
+    ext[i] = (i % 2) ? 0x55 : 0xAA;
+  }
+  ext[EXT_LENGTH - 2] = (protocol_type >> 8) & 0xFF;
+  ext[EXT_LENGTH - 1] = protocol_type & 0xFF;
+  *extension_type = EXT_TYPE;
+  *length = EXT_LENGTH;
+  return EXT_LENGTH;
+}
+
+/**
+ * @brief Read the header extension carried before the PDUs
+ *
+ * @param   ext             The header extensions
+ * @param   length          IN: The available length
+ *                          OUT: The length of the extensions
+ * @param   protocol_type   OUT: The protocol of the PDU
+ * @param   extension_type  The type of the first extension
+ * @param   opaque          The number of extensions read
+ * @return  0 on success, -1 on failure
+ */
+static int read_ext(unsigned char *ext, size_t *length,
+                    uint16_t *protocol_type, uint16_t extension_type,
+                    void *opaque)
+{
+  unsigned int *read_nbr = opaque;
+  unsigned int i;
+
+  if(extension_type != EXT_TYPE || *length < EXT_LENGTH)
+  {
+    return -1;
+  }
+  for(i = 0 ; i < EXT_LENGTH - 2 ; i++)
+  {
+    if(ext[i] != ((i % 2) ? 0x55 : 0xAA))
+    {
+      return -1;
+    }
+  }
+  (*read_nbr)++;
+  *protocol_type = (ext[EXT_LENGTH - 2] << 8) | ext[EXT_LENGTH - 1];
+  *length = EXT_LENGTH;
+  return 0;
+}
@@ -0,0 +1,335 @@
+/*
+ *
+ * This piece of software is an implementation of the Generic Stream
+ * Encapsulation (GSE) standard defined by ETSI for Linux (or other
+ * Unix-compatible OS). The library may be used to add GSE
+ * encapsulation/de-encapsulation capabilities to an application.
+ *
+ *
+ * Copyright © 2016 TAS
+ *
+ *
+ * This file is part of the GSE library.
+ *
+ *
+ * The GSE library is free software : you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY, without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see http://www.gnu.org/licenses/.
+ *
+ */
+
+/****************************************************************************/
+/**
+ *   @file          test_deencap_footprint.c
+ *
+ *          Project:     GSE LIBRARY
+ *
+ *          Company:     THALES ALENIA SPACE
+ *
+ *          Module name: DEENCAP
+ *
+ *   @brief         Allocation of the FIFOs and of the deencapsulation contexts
+ *                  on first use
+ *
+ *   @author        Julien BERNARD / Viveris Technologies
+ *
+ */
+/****************************************************************************/
+
+/****************************************************************************
+ *
+ *   INCLUDES
+ *
+ *****************************************************************************/
+
+/* system includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+/* GSE includes */
+#include "encap.h"
+#include "deencap.h"
+
+/****************************************************************************
+ *
+ *   MACROS AND CONSTANTS
+ *
+ *****************************************************************************/
+
+/** The number of FIFOs, the last one is used as FragID */
+#define QOS_NBR 201
+/** The size of the FIFOs */
+#define FIFO_SIZE 4
+/** The FragID of the PDUs */
+#define FRAG_ID (QOS_NBR - 1)
+/** The number of FragID accepted by the receivers */
+#define DEENCAP_QOS_NBR 255
+/** The length of the PDUs */
+#define PDU_LENGTH 1000
+/** The length of the GSE packets */
+#define PACKET_LENGTH 300
+/** The type of label carried by the GSE packets */
+#define LABEL_TYPE 0x0
+/** The protocol carried by the GSE packets */
+#define PROTOCOL 0x2345
+
+/* DEBUG macro */
+#define DEBUG(verbose, format, ...) \
+  do { \
+    if(verbose) \
+      printf(format, ##__VA_ARGS__); \
+  } while(0)
+
+/****************************************************************************
+ *
+ *   PROTOTYPES OF PRIVATE FUNCTIONS
+ *
+ *****************************************************************************/
+
+static int test_footprint(int verbose);
+static gse_status_t send_pdu(gse_encap_t *encap, unsigned char *data);
+
+/****************************************************************************
+ *
+ *   PUBLIC FUNCTIONS
+ *
+ *****************************************************************************/
+
+/**
+ * @brief Main function for the GSE footprint test program
+ *
+ * @param argc  the number of program arguments
+ * @param argv  the program arguments
+ * @return      the unix return code:
+ *               \li 0 in case of success,
+ *               \li 1 in case of failure
+ */
+int main(int argc, char *argv[])
+{
+  int res = 1;
+  int verbose = 0;
+
+  if(argc > 2 || argc < 1)
+  {
+    printf("USAGE : test_deencap_footprint [verbose]\n");
+  }
+  else
+  {
+    if(argc == 2)
+    {
+      if(!strcmp(argv[1], "verbose"))
+      {
+        verbose = 1;
+      }
+      else
+      {
+        printf("USAGE : test_deencap_footprint [verbose]\n");
+        goto quit;
+      }
+    }
+    res = test_footprint(verbose);
+  }
+
+quit:
+  return res;
+}
+
+/****************************************************************************
+ *
+ *   PRIVATE FUNCTIONS
+ *
+ *****************************************************************************/
+
+/**
+ * @brief Send two fragmented PDUs and check the footprints
+ *
+ * The subsequent fragment of the second PDU is also given to a receiver that
+ * never received any fragment.
+ *
+ * @param   verbose  Print debug if verbose is 1
+ * @return  0 on success, 1 on failure
+ */
+static int test_footprint(int verbose)
+{
+  int is_failure = 1;
+  gse_encap_t *encap = NULL;
+  gse_deencap_t *deencap = NULL;
+  gse_deencap_t *other_deencap = NULL;
+  gse_vfrag_t *packet;
+  gse_vfrag_t *copy;
+  gse_vfrag_t *pdu = NULL;
+  gse_status_t status;
+  unsigned char data[PDU_LENGTH];
+  size_t encap_init_size;
+  size_t encap_size;
+  size_t deencap_init_size;
+  size_t deencap_size;
+  size_t size;
+  uint8_t label_type;
+  uint8_t label[6];
+  uint16_t protocol;
+  uint16_t packet_length;
+  unsigned int pdu_nbr;
+  unsigned int packet_nbr;
+
+  memset(data, 0x5A, PDU_LENGTH);
+
+  status = gse_encap_init(QOS_NBR, FIFO_SIZE, &encap);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when initializing encapsulation (%s)\n",
+          status, gse_get_status(status));
+    goto quit;
+  }
+  status = gse_deencap_init(DEENCAP_QOS_NBR, &deencap);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when initializing deencapsulation (%s)\n",
+          status, gse_get_status(status));
+    goto release_encap;
+  }
+  status = gse_deencap_init(DEENCAP_QOS_NBR, &other_deencap);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when initializing deencapsulation (%s)\n",
+          status, gse_get_status(status));
+    goto release_deencap;
+  }
+
+  if(gse_encap_get_footprint(encap, &encap_init_size) != GSE_STATUS_OK ||
+     gse_deencap_get_footprint(deencap, &deencap_init_size) != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Cannot get the initial footprints\n");
+    goto release_other_deencap;
+  }
+  DEBUG(verbose, "Initial footprints: encap %zu bytes, deencap %zu bytes\n",
+        encap_init_size, deencap_init_size);
+
+  for(pdu_nbr = 0 ; pdu_nbr < 2 ; pdu_nbr++)
+  {
+    status = send_pdu(encap, data);
+    if(status != GSE_STATUS_OK)
+    {
+      DEBUG(verbose, "Error %#.4x when receiving PDU (%s)\n",
+            status, gse_get_status(status));
+      goto release_other_deencap;
+    }
+
+    packet_nbr = 0;
+    do
+    {
+      status = gse_encap_get_packet_copy(&packet, encap, PACKET_LENGTH,
+                                         FRAG_ID);
+      if(status != GSE_STATUS_OK)
+      {
+        DEBUG(verbose, "Error %#.4x when getting packet (%s)\n",
+              status, gse_get_status(status));
+        goto release_other_deencap;
+      }
+
+      /* A receiver without context rejects the subsequent fragments */
+      if(pdu_nbr == 1 && packet_nbr == 1)
+      {
+        status = gse_create_vfrag_with_data(&copy, packet->length, 0, 0,
+                                            packet->start, packet->length);
+        if(status != GSE_STATUS_OK)
+        {
+          gse_free_vfrag(&packet);
+          goto release_other_deencap;
+        }
+        status = gse_deencap_packet(copy, other_deencap, &label_type, label,
+                                    &protocol, &pdu, &packet_length);
+        if(status != GSE_STATUS_CTX_NOT_INIT)
+        {
+          DEBUG(verbose, "Fragment without context not detected (status "
+                "%#.4x)\n", status);
+          gse_free_vfrag(&packet);
+          goto release_other_deencap;
+        }
+      }
+
+      status = gse_deencap_packet(packet, deencap, &label_type, label,
+                                  &protocol, &pdu, &packet_length);
+      packet_nbr++;
+    }
+    while(status == GSE_STATUS_OK);
+    if(status != GSE_STATUS_PDU_RECEIVED || pdu == NULL ||
+       gse_get_vfrag_length(pdu) != PDU_LENGTH || packet_nbr < 3)
+    {
+      DEBUG(verbose, "Error %#.4x when receiving PDU %u (%s)\n",
+            status, pdu_nbr, gse_get_status(status));
+      goto release_other_deencap;
+    }
+    gse_free_vfrag(&pdu);
+
+    /* The tables are kept for the next PDUs */
+    if(gse_encap_get_footprint(encap, &encap_size) != GSE_STATUS_OK ||
+       gse_deencap_get_footprint(deencap, &deencap_size) != GSE_STATUS_OK)
+    {
+      DEBUG(verbose, "Cannot get the footprints\n");
+      goto release_other_deencap;
+    }
+    DEBUG(verbose, "PDU %u in %u packets, footprints: encap %zu bytes, "
+          "deencap %zu bytes\n", pdu_nbr, packet_nbr, encap_size,
+          deencap_size);
+    if(encap_size <= encap_init_size || deencap_size <= deencap_init_size)
+    {
+      DEBUG(verbose, "The tables were not allocated on first use\n");
+      goto release_other_deencap;
+    }
+  }
+
+  if(gse_deencap_get_footprint(other_deencap, &size) != GSE_STATUS_OK ||
+     size != deencap_init_size)
+  {
+    DEBUG(verbose, "Context allocated for a subsequent fragment\n");
+    goto release_other_deencap;
+  }
+
+  is_failure = 0;
+
+release_other_deencap:
+  gse_deencap_release(other_deencap);
+release_deencap:
+  gse_deencap_release(deencap);
+release_encap:
+  gse_encap_release(encap);
+quit:
+  return is_failure;
+}
+
+/**
+ * @brief Give a PDU to the encapsulation in the FIFO used as FragID
+ *
+ * @param   encap  The encapsulation structure
+ * @param   data   The PDU data
+ * @return  The status of the encapsulation
+ */
+static gse_status_t send_pdu(gse_encap_t *encap, unsigned char *data)
+{
+  uint8_t label[6] = { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05 };
+  gse_vfrag_t *vfrag;
+  gse_status_t status;
+
+  status = gse_create_vfrag_with_data(&vfrag, PDU_LENGTH,
+                                      GSE_MAX_HEADER_LENGTH,
+                                      GSE_MAX_TRAILER_LENGTH,
+                                      data, PDU_LENGTH);
+  if(status != GSE_STATUS_OK)
+  {
+    return status;
+  }
+  return gse_encap_receive_pdu(vfrag, encap, label, LABEL_TYPE, PROTOCOL,
+                               FRAG_ID);
+}
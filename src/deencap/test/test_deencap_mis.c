@@ -0,0 +1,393 @@
+/*
+ *
+ * This piece of software is an implementation of the Generic Stream
+ * Encapsulation (GSE) standard defined by ETSI for Linux (or other
+ * Unix-compatible OS). The library may be used to add GSE
+ * encapsulation/de-encapsulation capabilities to an application.
+ *
+ *
+ * Copyright © 2016 TAS
+ *
+ *
+ * This file is part of the GSE library.
+ *
+ *
+ * The GSE library is free software : you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY, without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see http://www.gnu.org/licenses/.
+ *
+ */
+
+/****************************************************************************/
+/**
+ *   @file          test_deencap_mis.c
+ *
+ *          Project:     GSE LIBRARY
+ *
+ *          Company:     THALES ALENIA SPACE
+ *
+ *          Module name: DEENCAP
+ *
+ *   @brief         BBFrames of several input streams interleaved and
+ *                  deencapsulated with a shared reassembly pool
+ *
+ *   @author        Julien BERNARD / Viveris Technologies
+ *
+ */
+/****************************************************************************/
+
+/****************************************************************************
+ *
+ *   INCLUDES
+ *
+ *****************************************************************************/
+
+/* system includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+/* GSE includes */
+#include "encap.h"
+#include "deencap_mis.h"
+
+/****************************************************************************
+ *
+ *   MACROS AND CONSTANTS
+ *
+ *****************************************************************************/
+
+/** The number of input streams */
+#define STREAM_NBR 3
+/** The ISI of the first input stream */
+#define FIRST_ISI 7
+/** The number of FIFOs */
+#define QOS_NBR 1
+/** The size of the FIFOs */
+#define FIFO_SIZE 16
+/** The length of the BBFrames, shorter than the PDUs */
+#define BBFRAME_LENGTH 1000
+/** The number of PDUs sent on each stream */
+#define PDU_NBR 6
+/** The length of the PDUs */
+#define PDU_LENGTH 1500
+/** The length of the reassembly pool when no PDU shall be evicted */
+#define LARGE_POOL_LENGTH (STREAM_NBR * PDU_LENGTH)
+/** The length of the reassembly pool when PDUs shall be evicted */
+#define SMALL_POOL_LENGTH (PDU_LENGTH + PDU_LENGTH / 2)
+/** The number of BBFrames sent at most on each stream */
+#define MAX_BBFRAME_NBR 32
+/** The type of label carried by the GSE packets */
+#define LABEL_TYPE 0x0
+/** The protocol carried by the GSE packets */
+#define PROTOCOL 0x2345
+
+/* DEBUG macro */
+#define DEBUG(verbose, format, ...) \
+  do { \
+    if(verbose) \
+      printf(format, ##__VA_ARGS__); \
+  } while(0)
+
+/****************************************************************************
+ *
+ *   PROTOTYPES OF PRIVATE FUNCTIONS
+ *
+ *****************************************************************************/
+
+static int test_mis(int verbose, size_t pool_length, int is_evicting);
+
+/****************************************************************************
+ *
+ *   PUBLIC FUNCTIONS
+ *
+ *****************************************************************************/
+
+/**
+ * @brief Main function for the GSE multiple input stream test program
+ *
+ * @param argc  the number of program arguments
+ * @param argv  the program arguments
+ * @return      the unix return code:
+ *               \li 0 in case of success,
+ *               \li 1 in case of failure
+ */
+int main(int argc, char *argv[])
+{
+  int res = 1;
+  int verbose = 0;
+
+  if(argc > 2 || argc < 1)
+  {
+    printf("USAGE : test_deencap_mis [verbose]\n");
+  }
+  else
+  {
+    if(argc == 2)
+    {
+      if(!strcmp(argv[1], "verbose"))
+      {
+        verbose = 1;
+      }
+      else
+      {
+        printf("USAGE : test_deencap_mis [verbose]\n");
+        goto quit;
+      }
+    }
+    res = test_mis(verbose, LARGE_POOL_LENGTH, 0) ||
+          test_mis(verbose, SMALL_POOL_LENGTH, 1);
+  }
+
+quit:
+  return res;
+}
+
+/****************************************************************************
+ *
+ *   PRIVATE FUNCTIONS
+ *
+ *****************************************************************************/
+
+/**
+ * @brief Interleave the BBFrames of several input streams
+ *
+ * Each stream carries PDUs longer than the BBFrames, the BBFrames of the
+ * streams are deencapsulated one after the other so that a PDU of each
+ * stream is being reassembled at the same time.
+ *
+ * @param   verbose      Print debug if verbose is 1
+ * @param   pool_length  The length of the reassembly pool
+ * @param   is_evicting  Whether PDUs shall be evicted from the pool
+ * @return  0 on success, 1 on failure
+ */
+static int test_mis(int verbose, size_t pool_length, int is_evicting)
+{
+  int is_failure = 1;
+  gse_encap_t *encaps[STREAM_NBR] = { NULL };
+  gse_deencap_mis_t *mis = NULL;
+  gse_vfrag_t *vfrag;
+  gse_vfrag_t *pdu = NULL;
+  gse_status_t status;
+  gse_bbheader_t bbheader;
+  gse_bbheader_t rcv_bbheader;
+  unsigned char pdu_data[PDU_LENGTH + STREAM_NBR * PDU_NBR];
+  uint8_t label[6] = { 0, 1, 2, 3, 4, 5 };
+  uint8_t rcv_label[6];
+  uint8_t label_type;
+  uint16_t protocol;
+  unsigned int next_pdu[STREAM_NBR] = { 0 };
+  unsigned int rcv_nbr = 0;
+  unsigned int active_nbr;
+  unsigned int bbframe_nbr;
+  unsigned int stream;
+  unsigned int i;
+  size_t data_length;
+  size_t used_length;
+  unsigned long evicted_nbr;
+
+  for(i = 0 ; i < sizeof(pdu_data) ; i++)
+  {
+    pdu_data[i] = (i * 7) % 253;
+  }
+
+  status = gse_deencap_mis_init(QOS_NBR, pool_length, &mis);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when initializing deencapsulation (%s)\n",
+          status, gse_get_status(status));
+    goto quit;
+  }
+
+  /* Each stream sends its own PDUs, they start at a different offset of the
+   * data */
+  for(stream = 0 ; stream < STREAM_NBR ; stream++)
+  {
+    status = gse_encap_init(QOS_NBR, FIFO_SIZE, &encaps[stream]);
+    if(status != GSE_STATUS_OK)
+    {
+      DEBUG(verbose, "Error %#.4x when initializing encapsulation (%s)\n",
+            status, gse_get_status(status));
+      goto release;
+    }
+    for(i = 0 ; i < PDU_NBR ; i++)
+    {
+      status = gse_create_vfrag_with_data(&vfrag, PDU_LENGTH,
+                                          GSE_MAX_HEADER_LENGTH,
+                                          GSE_MAX_TRAILER_LENGTH,
+                                          pdu_data + stream * PDU_NBR + i,
+                                          PDU_LENGTH);
+      if(status != GSE_STATUS_OK)
+      {
+        DEBUG(verbose, "Error %#.4x when creating PDU (%s)\n",
+              status, gse_get_status(status));
+        goto release;
+      }
+      status = gse_encap_receive_pdu(vfrag, encaps[stream], label, LABEL_TYPE,
+                                     PROTOCOL, 0);
+      if(status != GSE_STATUS_OK)
+      {
+        DEBUG(verbose, "Error %#.4x when receiving PDU (%s)\n",
+              status, gse_get_status(status));
+        goto release;
+      }
+    }
+  }
+
+  memset(&bbheader, 0, sizeof(gse_bbheader_t));
+  bbheader.ts_gs = GSE_BB_TS_GS_GENERIC_CONTINUOUS;
+  bbheader.sis_mis = 0;
+  bbheader.ccm_acm = 1;
+
+  for(bbframe_nbr = 0 ; bbframe_nbr < MAX_BBFRAME_NBR ; bbframe_nbr++)
+  {
+    active_nbr = 0;
+    for(stream = 0 ; stream < STREAM_NBR ; stream++)
+    {
+      status = gse_create_vfrag(&vfrag, BBFRAME_LENGTH, 0, 0);
+      if(status != GSE_STATUS_OK)
+      {
+        DEBUG(verbose, "Error %#.4x when creating BBFrame (%s)\n",
+              status, gse_get_status(status));
+        goto release;
+      }
+      bbheader.isi = FIRST_ISI + stream;
+      status = gse_encap_fill_bbframe(encaps[stream], GSE_FILL_FIRST_FIT,
+                                      &bbheader, gse_get_vfrag_start(vfrag),
+                                      BBFRAME_LENGTH, &data_length, NULL);
+      if(status == GSE_STATUS_FIFO_EMPTY)
+      {
+        gse_free_vfrag(&vfrag);
+        continue;
+      }
+      if(status != GSE_STATUS_OK)
+      {
+        DEBUG(verbose, "Error %#.4x when filling BBFrame (%s)\n",
+              status, gse_get_status(status));
+        gse_free_vfrag(&vfrag);
+        goto release;
+      }
+      active_nbr++;
+
+      /* The fragments of the evicted PDUs are rejected */
+      status = gse_deencap_mis_bbframe(vfrag, mis, &rcv_bbheader);
+      if((status != GSE_STATUS_OK &&
+          !(is_evicting && status == GSE_STATUS_CTX_NOT_INIT)) ||
+         rcv_bbheader.isi != FIRST_ISI + stream)
+      {
+        DEBUG(verbose, "Error %#.4x when deencapsulating BBFrame of stream "
+              "%u (%s)\n", status, stream, gse_get_status(status));
+        goto release;
+      }
+
+      status = gse_deencap_mis_get_usage(mis, &used_length, &evicted_nbr);
+      if(status != GSE_STATUS_OK || used_length > pool_length)
+      {
+        DEBUG(verbose, "%zu bytes used in a pool of %zu bytes (status "
+              "%#.4x)\n", used_length, pool_length, status);
+        goto release;
+      }
+
+      /* The PDUs of a stream are received in order, some of them are
+       * missing if they are evicted */
+      while((status = gse_deencap_mis_get_pdu(mis, FIRST_ISI + stream,
+                                              &label_type, rcv_label,
+                                              &protocol, &pdu))
+            == GSE_STATUS_PDU_RECEIVED)
+      {
+        for(i = next_pdu[stream] ; i < PDU_NBR ; i++)
+        {
+          if(memcmp(gse_get_vfrag_start(pdu),
+                    pdu_data + stream * PDU_NBR + i, PDU_LENGTH) == 0)
+          {
+            break;
+          }
+        }
+        if(i == PDU_NBR || gse_get_vfrag_length(pdu) != PDU_LENGTH ||
+           protocol != PROTOCOL || memcmp(rcv_label, label, 6) != 0 ||
+           (!is_evicting && i != next_pdu[stream]))
+        {
+          DEBUG(verbose, "Unexpected PDU on stream %u\n", stream);
+          goto free_pdu;
+        }
+        next_pdu[stream] = i + 1;
+        gse_free_vfrag(&pdu);
+        rcv_nbr++;
+      }
+      if(status != GSE_STATUS_NO_PDU_QUEUED)
+      {
+        DEBUG(verbose, "Error %#.4x when getting PDU (%s)\n",
+              status, gse_get_status(status));
+        goto release;
+      }
+    }
+    if(active_nbr == 0)
+    {
+      break;
+    }
+  }
+
+  status = gse_deencap_mis_get_usage(mis, &used_length, &evicted_nbr);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when getting the pool usage (%s)\n",
+          status, gse_get_status(status));
+    goto release;
+  }
+  DEBUG(verbose, "%u PDUs received in %u BBFrames per stream, %lu evicted, "
+        "%zu bytes left in the pool\n", rcv_nbr, bbframe_nbr, evicted_nbr,
+        used_length);
+  if(is_evicting)
+  {
+    if(evicted_nbr == 0 || rcv_nbr == STREAM_NBR * PDU_NBR)
+    {
+      DEBUG(verbose, "No PDU evicted from the pool\n");
+      goto release;
+    }
+  }
+  else if(evicted_nbr != 0 || used_length != 0 ||
+          rcv_nbr != STREAM_NBR * PDU_NBR)
+  {
+    DEBUG(verbose, "%u PDUs missing\n", STREAM_NBR * PDU_NBR - rcv_nbr);
+    goto release;
+  }
+
+  /* The streams that were not received have no PDU */
+  status = gse_deencap_mis_get_pdu(mis, FIRST_ISI + STREAM_NBR, &label_type,
+                                   rcv_label, &protocol, &pdu);
+  if(status != GSE_STATUS_NO_PDU_QUEUED)
+  {
+    DEBUG(verbose, "Unexpected status %#.4x for an unknown stream\n",
+          status);
+    goto free_pdu;
+  }
+
+  is_failure = 0;
+
+free_pdu:
+  if(pdu != NULL)
+  {
+    gse_free_vfrag(&pdu);
+  }
+release:
+  for(stream = 0 ; stream < STREAM_NBR ; stream++)
+  {
+    if(encaps[stream] != NULL)
+    {
+      gse_encap_release(encaps[stream]);
+    }
+  }
+  gse_deencap_mis_release(mis);
+quit:
+  return is_failure;
+}
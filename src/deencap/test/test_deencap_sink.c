@@ -0,0 +1,524 @@
+/*
+ *
+ * This piece of software is an implementation of the Generic Stream
+ * Encapsulation (GSE) standard defined by ETSI for Linux (or other
+ * Unix-compatible OS). The library may be used to add GSE
+ * encapsulation/de-encapsulation capabilities to an application.
+ *
+ *
+ * Copyright © 2016 TAS
+ *
+ *
+ * This file is part of the GSE library.
+ *
+ *
+ * The GSE library is free software : you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY, without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see http://www.gnu.org/licenses/.
+ *
+ */
+
+/****************************************************************************/
+/**
+ *   @file          test_deencap_sink.c
+ *
+ *          Project:     GSE LIBRARY
+ *
+ *          Company:     THALES ALENIA SPACE
+ *
+ *          Module name: DEENCAP
+ *
+ *   @brief         Delivery of fragmented PDUs to a sink
+ *
+ *   @author        Julien BERNARD / Viveris Technologies
+ *
+ */
+/****************************************************************************/
+
+/****************************************************************************
+ *
+ *   INCLUDES
+ *
+ *****************************************************************************/
+
+/* system includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+/* GSE includes */
+#include "encap.h"
+#include "deencap.h"
+
+/****************************************************************************
+ *
+ *   MACROS AND CONSTANTS
+ *
+ *****************************************************************************/
+
+/** The number of FIFOs */
+#define QOS_NBR 2
+/** The size of the FIFOs */
+#define FIFO_SIZE 4
+/** The length of the GSE packets */
+#define PACKET_LENGTH 500
+/** The length of the fragmented PDUs */
+#define PDU_LENGTH 5000
+/** The maximum number of packets of a PDU */
+#define MAX_PACKET_NBR 16
+/** The type of label carried by the GSE packets */
+#define LABEL_TYPE 0x0
+/** The protocol carried by the GSE packets */
+#define PROTOCOL 0x2345
+
+/* DEBUG macro */
+#define DEBUG(verbose, format, ...) \
+  do { \
+    if(verbose) \
+      printf(format, ##__VA_ARGS__); \
+  } while(0)
+
+/** The PDU rebuilt by the sink */
+typedef struct
+{
+  unsigned char data[PDU_LENGTH];  /**< The PDU data */
+  size_t length;                   /**< The length of the data received */
+  unsigned int start_nbr;          /**< The number of started PDUs */
+  unsigned int commit_nbr;         /**< The number of committed PDUs */
+  unsigned int abort_nbr;          /**< The number of aborted PDUs */
+  int in_order;                    /**< Whether the chunks are in order */
+  int fail_data;                   /**< Whether the sink refuses the data */
+} sink_t;
+
+/****************************************************************************
+ *
+ *   PROTOTYPES OF PRIVATE FUNCTIONS
+ *
+ *****************************************************************************/
+
+static int test_sink(int verbose);
+static int sink_cb(gse_sink_event_t event, const gse_sink_pdu_t *pdu,
+                   const unsigned char *data, size_t length, void *opaque);
+static int build_packets(int verbose, unsigned char *pdu_data,
+                         size_t pdu_length, gse_vfrag_t **packets,
+                         unsigned int *packet_nbr);
+static int deencap_packets(int verbose, gse_deencap_t *deencap,
+                           gse_vfrag_t **packets, unsigned int first,
+                           unsigned int last, gse_status_t *status);
+
+/****************************************************************************
+ *
+ *   PUBLIC FUNCTIONS
+ *
+ *****************************************************************************/
+
+/**
+ * @brief Main function for the GSE deencapsulation sink test program
+ *
+ * @param argc  the number of program arguments
+ * @param argv  the program arguments
+ * @return      the unix return code:
+ *               \li 0 in case of success,
+ *               \li 1 in case of failure
+ */
+int main(int argc, char *argv[])
+{
+  int res = 1;
+  int verbose = 0;
+
+  if(argc > 2 || argc < 1)
+  {
+    printf("USAGE : test_deencap_sink [verbose]\n");
+  }
+  else
+  {
+    if(argc == 2)
+    {
+      if(!strcmp(argv[1], "verbose"))
+      {
+        verbose = 1;
+      }
+      else
+      {
+        printf("USAGE : test_deencap_sink [verbose]\n");
+        goto quit;
+      }
+    }
+    res = test_sink(verbose);
+  }
+
+quit:
+  return res;
+}
+
+/****************************************************************************
+ *
+ *   PRIVATE FUNCTIONS
+ *
+ *****************************************************************************/
+
+/**
+ * @brief Deencapsulate fragmented PDUs with a sink and check the events
+ *        received by the sink
+ *
+ * @param   verbose  Print debug if verbose is 1
+ * @return  0 on success, 1 on failure
+ */
+static int test_sink(int verbose)
+{
+  int is_failure = 1;
+  gse_deencap_t *deencap = NULL;
+  gse_vfrag_t *packets[MAX_PACKET_NBR];
+  gse_status_t status;
+  unsigned char pdu_data[PDU_LENGTH];
+  unsigned int packet_nbr = 0;
+  unsigned int i;
+  sink_t *sink;
+
+  for(i = 0 ; i < PDU_LENGTH ; i++)
+  {
+    pdu_data[i] = (i * 13) % 255;
+  }
+  sink = calloc(1, sizeof(sink_t));
+  if(sink == NULL)
+  {
+    DEBUG(verbose, "Cannot allocate the sink\n");
+    goto quit;
+  }
+  sink->in_order = 1;
+
+  status = gse_deencap_init(QOS_NBR, &deencap);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when initializing deencapsulation (%s)\n",
+          status, gse_get_status(status));
+    goto free_sink;
+  }
+  status = gse_deencap_set_sink(deencap, sink_cb, sink);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when setting sink (%s)\n",
+          status, gse_get_status(status));
+    goto release_deencap;
+  }
+
+  /* The PDU is given to the sink and committed with its last fragment */
+  if(build_packets(verbose, pdu_data, PDU_LENGTH, packets, &packet_nbr))
+  {
+    goto release_deencap;
+  }
+  if(deencap_packets(verbose, deencap, packets, 0, packet_nbr, &status))
+  {
+    goto release_deencap;
+  }
+  if(status != GSE_STATUS_PDU_STREAMED || sink->commit_nbr != 1 ||
+     sink->start_nbr != 1 || !sink->in_order || sink->length != PDU_LENGTH ||
+     memcmp(sink->data, pdu_data, PDU_LENGTH) != 0)
+  {
+    DEBUG(verbose, "PDU not committed (status %#.4x, %u commits)\n",
+          status, sink->commit_nbr);
+    goto release_deencap;
+  }
+
+  /* A bad CRC aborts the PDU */
+  if(build_packets(verbose, pdu_data, PDU_LENGTH, packets, &packet_nbr))
+  {
+    goto release_deencap;
+  }
+  packets[packet_nbr - 1]->end[-1] ^= 0xFF;
+  if(deencap_packets(verbose, deencap, packets, 0, packet_nbr, &status))
+  {
+    goto release_deencap;
+  }
+  if(status != GSE_STATUS_INVALID_CRC || sink->abort_nbr != 1 ||
+     sink->commit_nbr != 1)
+  {
+    DEBUG(verbose, "PDU with bad CRC not aborted (status %#.4x)\n", status);
+    goto release_deencap;
+  }
+
+  /* A new first fragment aborts the PDU in progress */
+  if(build_packets(verbose, pdu_data, PDU_LENGTH, packets, &packet_nbr))
+  {
+    goto release_deencap;
+  }
+  if(deencap_packets(verbose, deencap, packets, 0, 2, &status))
+  {
+    goto release_deencap;
+  }
+  for(i = 2 ; i < packet_nbr ; i++)
+  {
+    gse_free_vfrag(&packets[i]);
+  }
+  if(build_packets(verbose, pdu_data, PDU_LENGTH, packets, &packet_nbr))
+  {
+    goto release_deencap;
+  }
+  if(deencap_packets(verbose, deencap, packets, 0, 1, &status))
+  {
+    goto release_deencap;
+  }
+  if(status != GSE_STATUS_DATA_OVERWRITTEN || sink->abort_nbr != 2)
+  {
+    DEBUG(verbose, "Overwritten PDU not aborted (status %#.4x)\n", status);
+    goto release_deencap;
+  }
+  if(deencap_packets(verbose, deencap, packets, 1, packet_nbr, &status))
+  {
+    goto release_deencap;
+  }
+  if(status != GSE_STATUS_PDU_STREAMED || sink->commit_nbr != 2 ||
+     !sink->in_order)
+  {
+    DEBUG(verbose, "PDU not committed after overwrite (status %#.4x)\n",
+          status);
+    goto release_deencap;
+  }
+
+  /* A PDU refused by the sink is dropped */
+  if(build_packets(verbose, pdu_data, PDU_LENGTH, packets, &packet_nbr))
+  {
+    goto release_deencap;
+  }
+  sink->fail_data = 1;
+  if(deencap_packets(verbose, deencap, packets, 0, 2, &status))
+  {
+    goto release_deencap;
+  }
+  sink->fail_data = 0;
+  if(status != GSE_STATUS_CTX_NOT_INIT || sink->abort_nbr != 3)
+  {
+    DEBUG(verbose, "PDU refused by the sink not dropped (status %#.4x)\n",
+          status);
+    for(i = 2 ; i < packet_nbr ; i++)
+    {
+      gse_free_vfrag(&packets[i]);
+    }
+    goto release_deencap;
+  }
+  for(i = 2 ; i < packet_nbr ; i++)
+  {
+    gse_free_vfrag(&packets[i]);
+  }
+
+  /* A complete PDU is still returned by the deencapsulation */
+  if(build_packets(verbose, pdu_data, PACKET_LENGTH / 2, packets, &packet_nbr))
+  {
+    goto release_deencap;
+  }
+  if(packet_nbr != 1 ||
+     deencap_packets(verbose, deencap, packets, 0, packet_nbr, &status))
+  {
+    goto release_deencap;
+  }
+  if(status != GSE_STATUS_PDU_RECEIVED || sink->start_nbr != 5)
+  {
+    DEBUG(verbose, "Complete PDU not returned (status %#.4x)\n", status);
+    goto release_deencap;
+  }
+
+  /* A PDU in progress is aborted on release */
+  if(build_packets(verbose, pdu_data, PDU_LENGTH, packets, &packet_nbr))
+  {
+    goto release_deencap;
+  }
+  if(deencap_packets(verbose, deencap, packets, 0, 1, &status))
+  {
+    goto release_deencap;
+  }
+  for(i = 1 ; i < packet_nbr ; i++)
+  {
+    gse_free_vfrag(&packets[i]);
+  }
+  status = gse_deencap_release(deencap);
+  deencap = NULL;
+  if(status != GSE_STATUS_OK || sink->abort_nbr != 4)
+  {
+    DEBUG(verbose, "PDU not aborted on release (status %#.4x)\n", status);
+    goto free_sink;
+  }
+
+  is_failure = 0;
+
+release_deencap:
+  if(deencap != NULL)
+  {
+    gse_deencap_release(deencap);
+  }
+free_sink:
+  free(sink);
+quit:
+  return is_failure;
+}
+
+/**
+ * @brief The sink callback, rebuild the PDU and count the events
+ *
+ * @param   event   The event
+ * @param   pdu     The PDU
+ * @param   data    The chunk of PDU data
+ * @param   length  The length of the chunk
+ * @param   opaque  The sink
+ * @return  0 on success, -1 on failure
+ */
+static int sink_cb(gse_sink_event_t event, const gse_sink_pdu_t *pdu,
+                   const unsigned char *data, size_t length, void *opaque)
+{
+  sink_t *sink = opaque;
+
+  if(pdu->protocol != PROTOCOL || pdu->label_type != LABEL_TYPE)
+  {
+    sink->in_order = 0;
+  }
+  switch(event)
+  {
+    case GSE_SINK_START:
+      sink->start_nbr++;
+      sink->length = 0;
+      break;
+    case GSE_SINK_DATA:
+      if(sink->fail_data)
+      {
+        return -1;
+      }
+      if(pdu->offset != sink->length ||
+         sink->length + length > pdu->pdu_length ||
+         sink->length + length > PDU_LENGTH)
+      {
+        sink->in_order = 0;
+        return -1;
+      }
+      memcpy(sink->data + sink->length, data, length);
+      sink->length += length;
+      break;
+    case GSE_SINK_COMMIT:
+      sink->commit_nbr++;
+      break;
+    case GSE_SINK_ABORT:
+      sink->abort_nbr++;
+      break;
+  }
+  return 0;
+}
+
+/**
+ * @brief Encapsulate a PDU in GSE packets
+ *
+ * @param   verbose     Print debug if verbose is 1
+ * @param   pdu_data    The PDU data
+ * @param   pdu_length  The PDU length
+ * @param   packets     OUT: The GSE packets
+ * @param   packet_nbr  OUT: The number of GSE packets
+ * @return  0 on success, 1 on failure
+ */
+static int build_packets(int verbose, unsigned char *pdu_data,
+                         size_t pdu_length, gse_vfrag_t **packets,
+                         unsigned int *packet_nbr)
+{
+  int is_failure = 1;
+  gse_encap_t *encap;
+  gse_vfrag_t *pdu;
+  gse_status_t status;
+  uint8_t label[6] = { 0, 1, 2, 3, 4, 5 };
+
+  *packet_nbr = 0;
+  status = gse_encap_init(QOS_NBR, FIFO_SIZE, &encap);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when initializing encapsulation (%s)\n",
+          status, gse_get_status(status));
+    goto quit;
+  }
+  status = gse_create_vfrag_with_data(&pdu, pdu_length, GSE_MAX_HEADER_LENGTH,
+                                      GSE_MAX_TRAILER_LENGTH, pdu_data,
+                                      pdu_length);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when creating PDU (%s)\n",
+          status, gse_get_status(status));
+    goto release_encap;
+  }
+  status = gse_encap_receive_pdu(pdu, encap, label, LABEL_TYPE, PROTOCOL, 1);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when receiving PDU (%s)\n",
+          status, gse_get_status(status));
+    goto release_encap;
+  }
+  while(*packet_nbr < MAX_PACKET_NBR &&
+        (status = gse_encap_get_packet_copy(&packets[*packet_nbr], encap,
+                                            PACKET_LENGTH, 1))
+        == GSE_STATUS_OK)
+  {
+    (*packet_nbr)++;
+  }
+  if(status != GSE_STATUS_FIFO_EMPTY)
+  {
+    DEBUG(verbose, "Error %#.4x when getting packet (%s)\n",
+          status, gse_get_status(status));
+    while(*packet_nbr > 0)
+    {
+      gse_free_vfrag(&packets[--(*packet_nbr)]);
+    }
+    goto release_encap;
+  }
+  is_failure = 0;
+
+release_encap:
+  gse_encap_release(encap);
+quit:
+  return is_failure;
+}
+
+/**
+ * @brief Deencapsulate GSE packets, the fragments shall not return a PDU
+ *
+ * @param   verbose  Print debug if verbose is 1
+ * @param   deencap  The deencapsulation structure
+ * @param   packets  The GSE packets, destroyed by the deencapsulation
+ * @param   first    The first packet to deencapsulate
+ * @param   last     The packet after the last one to deencapsulate
+ * @param   status   OUT: The status of the last packet
+ * @return  0 on success, 1 on failure
+ */
+static int deencap_packets(int verbose, gse_deencap_t *deencap,
+                           gse_vfrag_t **packets, unsigned int first,
+                           unsigned int last, gse_status_t *status)
+{
+  gse_vfrag_t *pdu = NULL;
+  uint8_t label[6];
+  uint8_t label_type;
+  uint16_t protocol;
+  uint16_t packet_length;
+  unsigned int i;
+
+  *status = GSE_STATUS_OK;
+  for(i = first ; i < last ; i++)
+  {
+    *status = gse_deencap_packet(packets[i], deencap, &label_type, label,
+                                 &protocol, &pdu, &packet_length);
+    packets[i] = NULL;
+    DEBUG(verbose, "Packet %u: status %#.4x (%s)\n", i, *status,
+          gse_get_status(*status));
+    if(pdu != NULL)
+    {
+      gse_free_vfrag(&pdu);
+      if(i + 1 != last)
+      {
+        DEBUG(verbose, "PDU returned before the last fragment\n");
+        return 1;
+      }
+    }
+  }
+  return 0;
+}
@@ -50,12 +50,16 @@
 
 #include <stdlib.h>
 #include <assert.h>
+#include <unistd.h>
 #include <arpa/inet.h>
+#include <sys/eventfd.h>
 
 #include "constants.h"
 #include "fifo.h"
 #include "crc.h"
 #include "header_fields.h"
+#include "label_map.h"
+#include "shaper.h"
 
 
 /****************************************************************************
@@ -87,8 +91,88 @@ struct gse_encap_s
   /**> Callback to build header extensions */
   gse_encap_build_header_ext_cb_t build_header_ext;
   void *opaque;          /**< User specific data for extension callback */
+  unsigned int frag_id_nbr;  /**< Number of FragID values in the pool,
+                                  0 if the QoS value is used as FragID */
+  unsigned int frag_window;  /**< Number of PDUs of a FIFO considered for
+                                  each GSE packet */
+  uint32_t frag_id_used[8];  /**< Bitmap of the FragID values in use */
+  pthread_mutex_t frag_id_mutex; /**< Mutex on the FragID pool */
+  unsigned int fill_window;  /**< Number of PDUs of a FIFO considered when
+                                  filling a frame
+                                  (default: GSE_DEFAULT_FILL_WINDOW) */
+  size_t fifo_size;          /**< Size of each FIFO */
+  fifo_t **modcod_fifo;      /**< Table of FIFO tables of the modcod groups,
+                                  NULL until a label is associated to a
+                                  modcod */
+  label_map_t label_map;     /**< Association of the labels with the modcod
+                                  groups */
+  pthread_mutex_t modcod_mutex; /**< Mutex on the modcod groups */
+  unsigned int flow_nbr;     /**< Number of flows per FIFO,
+                                  0 if fair queuing is disabled */
+  unsigned int flow_quantum; /**< Number of bytes sent by a flow in its turn */
+  unsigned int shaper_nbr;   /**< Number of shapers, 0 if shaping is
+                                  disabled */
+  gse_shaper_t *qos_shapers; /**< Table of shapers of the QoS values,
+                                  NULL until the first one is set */
+  gse_shaper_t *label_shapers; /**< Table of shapers of the labels */
+  size_t label_shaper_size;  /**< Size of the table of label shapers */
+  label_map_t shaper_map;    /**< Position of the label shapers in their
+                                  table */
+  uint64_t shaper_time;      /**< Time of the last shapers refill
+                                  (in microseconds) */
+  int shaper_time_set;       /**< Whether the shapers were refilled once */
+  unsigned int fill_nbr;     /**< Number of frame fillings with shaping,
+                                  identifies the current one */
+  pthread_mutex_t shaper_mutex; /**< Mutex on the shapers */
+  gse_crc_pool_t *crc_pool;  /**< Threads computing the CRC32 of the large
+                                  PDUs, NULL for a serial computation
+                                  (default) */
+  size_t crc_min_length;     /**< Minimum length of the PDUs whose CRC32 is
+                                  computed by several threads */
+  int event_fd;              /**< eventfd written when a FIFO becomes non
+                                  empty, -1 until it is requested (protected
+                                  by the modcod mutex) */
+  fifo_watermark_t *watermarks; /**< Table of the watermarks of the QoS
+                                     values, NULL until they are set
+                                     (protected by the modcod mutex) */
 };
 
+/** The PDUs of a QoS value staged by a producer thread */
+typedef struct
+{
+  gse_encap_ctx_t *values;  /**< The contexts of the staged PDUs, in the
+                                 order of their reception */
+  fifo_t **fifos;           /**< The FIFO each staged PDU is pushed in */
+  unsigned int elt_nbr;     /**< Number of staged PDUs */
+} gse_encap_local_queue_t;
+
+/** The local queues of a producer thread (see \ref gse_encap_local_init) */
+struct gse_encap_local_s
+{
+  gse_encap_t *encap;       /**< The encapsulation structure fed by the
+                                 thread */
+  unsigned int size;        /**< Size of each local queue */
+  gse_encap_local_queue_t *queues; /**< Table of local queues
+                                        The size of the table is given by
+                                        the qos_nbr of encap */
+};
+
+/** The number of label shapers allocated with the first one */
+#define GSE_LABEL_SHAPER_MIN_SIZE 8
+
+/** The default number of bytes sent by a flow in its turn */
+#define GSE_DEFAULT_FLOW_QUANTUM 1500
+
+/** The number of modcod groups */
+#define GSE_MODCOD_NBR 256
+
+/** The default number of PDUs of a FIFO considered when filling a frame */
+#define GSE_DEFAULT_FILL_WINDOW 16
+
+/** The default minimum length of the PDUs whose CRC32 is computed by several
+ *  threads, see \ref gse_encap_set_crc_workers for the measures */
+#define GSE_DEFAULT_CRC_MIN_LENGTH 16384
+
 /** Encapsulation mode
  *
  * Choose how to get the encapsulated packet:
@@ -98,12 +182,18 @@ struct gse_encap_s
  *               virtual fragment).
  * \li NO_ALLOC: no allocation mode (share the buffer with a user provided,
  *               already allocated, virtual fragment)
+ * \li FRAME:    frame mode (copy the packet in a user provided buffer, no
+ *               virtual fragment is created)
+ * \li IOV:      scatter-gather mode (describe the packet with I/O vectors
+ *               referring to the PDU data)
  */
 enum encap_mode
 {
   LEGACY,
   NO_COPY,
-  NO_ALLOC
+  NO_ALLOC,
+  FRAME,
+  IOV
 };
 
 
@@ -118,10 +208,13 @@ enum encap_mode
  *  @brief   Create the GSE header and CRC
  *
  *  CRC is only created in the case of a first fragment, it is written at the
- *  end of the PDU.
+ *  end of the PDU or in the trailer of a chained PDU.
  *
  *  @param   pdu_type       Type of payload (GSE_PDU_COMPLETE, GSE_PDU_SUBS_FRAG,
  *                                           GSE_PDU_FIRST_FRAG, GSE_PDU_LAST_FRAG)
+ *  @param   header         The buffer of the header, followed by the PDU data
+ *                          unless the PDU is chained
+ *  @param   encap          The encapsulation structure
  *  @param   encap_ctx      Encapsulation context of the PDU
  *  @param   length         Length of the GSE packet (in bytes)
  *
@@ -133,6 +226,8 @@ enum encap_mode
  *                         - \ref GSE_STATUS_INTERNAL_ERROR
  */
 static gse_status_t gse_encap_create_header_and_crc(gse_payload_type_t payload_type,
+                                                    unsigned char *header,
+                                                    gse_encap_t *encap,
                                                     gse_encap_ctx_t *const encap_ctx,
                                                     size_t length);
 
@@ -183,11 +278,562 @@ static size_t gse_encap_compute_packet_length(size_t desired_length,
 /**
  *  @brief   Compute the CRC32
  *
+ *  The CRC32 of large PDUs is computed by several threads if enabled
+ *  (see \ref gse_encap_set_crc_workers).
+ *
+ *  @param   encap   The encapsulation structure
  *  @pram    vfrag   Virtual fragment
  *
  *  @return          The CRC32
  */
-static uint32_t gse_encap_compute_crc(gse_vfrag_t *vfrag);
+static uint32_t gse_encap_compute_crc(gse_encap_t *encap, gse_vfrag_t *vfrag);
+
+/**
+ *  @brief   Compute the CRC of a chained PDU
+ *
+ *  @param   header  The header of the first fragment
+ *  @param   chain   The chain holding the PDU
+ *
+ *  @return          The CRC in NBO
+ */
+static uint32_t gse_encap_compute_chain_crc(unsigned char *header,
+                                            gse_vfrag_chain_t *chain);
+
+/**
+ *  @brief   Copy the remaining data of a chained PDU in a virtual fragment
+ *
+ *  The packets are then built as for a contiguous PDU, the chain is freed.
+ *
+ *  @param   encap_ctx  The encapsulation context of the PDU
+ *
+ *  @return
+ *                      - success/informative code among:
+ *                        - \ref GSE_STATUS_OK
+ *                      - warning/error code among:
+ *                        - \ref GSE_STATUS_MALLOC_FAILED
+ *                        - \ref GSE_STATUS_OFFSET_TOO_HIGH
+ */
+static gse_status_t gse_encap_flatten_ctx(gse_encap_ctx_t *encap_ctx);
+
+/**
+ *  @brief   Take a FragID value from the FragID pool
+ *
+ *  @param   encap    The encapsulation structure
+ *  @param   frag_id  OUT: The FragID value on success
+ *
+ *  @return
+ *                    - success/informative code among:
+ *                      - \ref GSE_STATUS_OK
+ *                    - warning/error code among:
+ *                      - \ref GSE_STATUS_FRAG_ID_EXHAUSTED
+ *                      - \ref GSE_STATUS_PTHREAD_MUTEX
+ */
+static gse_status_t gse_encap_alloc_frag_id(gse_encap_t *encap,
+                                            uint8_t *frag_id);
+
+/**
+ *  @brief   Give a FragID value back to the FragID pool
+ *
+ *  @param   encap    The encapsulation structure
+ *  @param   frag_id  The FragID value
+ *
+ *  @return
+ *                    - success/informative code among:
+ *                      - \ref GSE_STATUS_OK
+ *                    - warning/error code among:
+ *                      - \ref GSE_STATUS_PTHREAD_MUTEX
+ */
+static gse_status_t gse_encap_release_frag_id(gse_encap_t *encap,
+                                              uint8_t frag_id);
+
+/**
+ *  @brief   Mark a FragID value as used outside of the FragID pool
+ *
+ *  Without FragID pool, the QoS value of a PDU fragmented while the first
+ *  PDU of its FIFO is held is marked until the end of its fragmentation.
+ *
+ *  @param   encap    The encapsulation structure
+ *  @param   frag_id  The FragID value
+ *
+ *  @return
+ *                    - success/informative code among:
+ *                      - \ref GSE_STATUS_OK
+ *                    - warning/error code among:
+ *                      - \ref GSE_STATUS_PTHREAD_MUTEX
+ */
+static gse_status_t gse_encap_take_frag_id(gse_encap_t *encap,
+                                           uint8_t frag_id);
+
+/**
+ *  @brief   Check whether a FragID value is used
+ *
+ *  @param   encap    The encapsulation structure
+ *  @param   frag_id  The FragID value
+ *  @param   used     OUT: Whether the FragID value is used
+ *
+ *  @return
+ *                    - success/informative code among:
+ *                      - \ref GSE_STATUS_OK
+ *                    - warning/error code among:
+ *                      - \ref GSE_STATUS_PTHREAD_MUTEX
+ */
+static gse_status_t gse_encap_is_frag_id_used(gse_encap_t *encap,
+                                              uint8_t frag_id, int *used);
+
+/**
+ *  @brief   Select the FIFO element used to build the next GSE packet
+ *
+ *  Without FragID pool the first element is selected. Otherwise, the
+ *  selection is done among the first elements of the FIFO as described for
+ *  \ref gse_encap_set_frag_id_pool and a FragID is taken from the pool if
+ *  the selected PDU may be fragmented.\n
+ *  With shaping, the PDUs whose color is worse than max_color are skipped as
+ *  described for \ref gse_encap_select_unheld.
+ *
+ *  @param   encap           The encapsulation structure
+ *  @param   fifo            The FIFO
+ *  @param   desired_length  The desired length for the packet (in bytes)
+ *  @param   max_color       The worst color of the PDUs that can be
+ *                           selected, GSE_SHAPER_RED to ignore the shaping
+ *  @param   index           OUT: The position of the element in the FIFO
+ *  @param   encap_ctx       OUT: The element
+ *  @param   color           OUT: The color of the element
+ *
+ *  @return
+ *                           - success/informative code among:
+ *                             - \ref GSE_STATUS_OK
+ *                           - warning/error code among:
+ *                             - \ref GSE_STATUS_FIFO_EMPTY
+ *                             - \ref GSE_STATUS_RATE_LIMITED
+ *                             - \ref GSE_STATUS_PTHREAD_MUTEX
+ *                             - \ref GSE_STATUS_FRAG_ID_EXHAUSTED
+ *                             - \ref GSE_STATUS_INTERNAL_ERROR
+ */
+static gse_status_t gse_encap_select_ctx(gse_encap_t *encap, fifo_t *fifo,
+                                         size_t desired_length,
+                                         gse_shaper_color_t max_color,
+                                         unsigned int *index,
+                                         gse_encap_ctx_t **encap_ctx,
+                                         gse_shaper_color_t *color);
+
+/**
+ *  @brief   Check the FIFO element selected for the next GSE packet without
+ *           FragID pool or with fair queuing and select another one if needed
+ *
+ *  Another element is selected among the first elements of the FIFO if the
+ *  shaping holds the selected PDU or if, without FragID pool, a PDU placed
+ *  after the first one is in fragmentation. This PDU goes on first as it is
+ *  the only one that can be fragmented. Otherwise, the first PDU whose color
+ *  is not worse than max_color is selected so the held PDUs do not block the
+ *  other labels of their QoS value.
+ *
+ *  @param   encap           The encapsulation structure
+ *  @param   fifo            The FIFO
+ *  @param   desired_length  The desired length for the packet (in bytes)
+ *  @param   max_color       The worst color of the PDUs that can be
+ *                           selected, GSE_SHAPER_RED to ignore the shaping
+ *  @param   index           IN/OUT: The position of the element in the FIFO
+ *  @param   encap_ctx       IN/OUT: The element
+ *  @param   color           OUT: The color of the element
+ *
+ *  @return                  The same codes as \ref gse_encap_select_ctx
+ */
+static gse_status_t gse_encap_select_unheld(gse_encap_t *encap, fifo_t *fifo,
+                                            size_t desired_length,
+                                            gse_shaper_color_t max_color,
+                                            unsigned int *index,
+                                            gse_encap_ctx_t **encap_ctx,
+                                            gse_shaper_color_t *color);
+
+/**
+ *  @brief   Select the FIFO element used to build the next GSE packet with
+ *           fair queuing
+ *
+ *  The element is the first PDU of the flow selected by the flow queuing
+ *  stage of the FIFO. With a FragID pool, a FragID is taken from the pool if
+ *  the PDU may be fragmented. If the pool is exhausted, a PDU in
+ *  fragmentation is selected instead.
+ *
+ *  @param   encap           The encapsulation structure
+ *  @param   fifo            The FIFO
+ *  @param   desired_length  The desired length for the packet (in bytes)
+ *  @param   index           OUT: The position of the element in the FIFO
+ *  @param   encap_ctx       OUT: The element
+ *
+ *  @return                  The same codes as \ref gse_encap_select_ctx
+ */
+static gse_status_t gse_encap_select_flow(gse_encap_t *encap, fifo_t *fifo,
+                                          size_t desired_length,
+                                          unsigned int *index,
+                                          gse_encap_ctx_t **encap_ctx);
+
+/**
+ *  @brief   Compute the flow value of a PDU
+ *
+ *  @param   label         The label
+ *  @param   label_length  The label length (in bytes)
+ *  @param   label_type    The label type
+ *  @param   flow_key      The flow key given by the user
+ *
+ *  @return                The flow value
+ */
+static uint32_t gse_encap_hash_flow(uint8_t label[6], int label_length,
+                                    uint8_t label_type, uint32_t flow_key);
+
+/**
+ *  @brief   Select the FIFO element used to build the next GSE packet of a
+ *           frame
+ *
+ *  The FIFOs are browsed by QoS value order. Except with the FIFO policy, the
+ *  first FIFO that contains a PDU that can be completely sent in the remaining
+ *  length gives the element, chosen among the first elements of the FIFO
+ *  according to the policy. If there is no such PDU, the element is selected
+ *  as in \ref gse_encap_select_ctx in the first FIFO that is not empty.\n
+ *  With shaping, the PDUs whose color is worse than max_color are skipped.
+ *
+ *  @param   encap      The encapsulation structure
+ *  @param   fifos      The table of FIFOs, one per QoS value
+ *  @param   policy     The frame filling policy
+ *  @param   length     The remaining length in the frame (in bytes)
+ *  @param   max_color  The worst color of the PDUs that can be selected
+ *  @param   fifo       OUT: The FIFO
+ *  @param   index      OUT: The position of the element in the FIFO
+ *  @param   encap_ctx  OUT: The element
+ *  @param   color      OUT: The color of the element
+ *
+ *  @return
+ *                      - success/informative code among:
+ *                        - \ref GSE_STATUS_OK
+ *                      - warning/error code among:
+ *                        - \ref GSE_STATUS_FIFO_EMPTY
+ *                        - \ref GSE_STATUS_RATE_LIMITED
+ *                        - \ref GSE_STATUS_PTHREAD_MUTEX
+ *                        - \ref GSE_STATUS_FRAG_ID_EXHAUSTED
+ *                        - \ref GSE_STATUS_INTERNAL_ERROR
+ */
+static gse_status_t gse_encap_select_fill(gse_encap_t *encap, fifo_t *fifos,
+                                          gse_fill_policy_t policy,
+                                          size_t length,
+                                          gse_shaper_color_t max_color,
+                                          fifo_t **fifo, unsigned int *index,
+                                          gse_encap_ctx_t **encap_ctx,
+                                          gse_shaper_color_t *color);
+
+/**
+ *  @brief   Get the color of a PDU according to the shapers of its QoS value
+ *           and of its label
+ *
+ *  The worst color is kept. A PDU in fragmentation is never red.
+ *
+ *  @param   encap      The encapsulation structure
+ *  @param   encap_ctx  The PDU
+ *  @param   color      OUT: The color
+ *
+ *  @return
+ *                      - success/informative code among:
+ *                        - \ref GSE_STATUS_OK
+ *                      - warning/error code among:
+ *                        - \ref GSE_STATUS_PTHREAD_MUTEX
+ */
+static gse_status_t gse_encap_get_color(gse_encap_t *encap,
+                                        gse_encap_ctx_t *encap_ctx,
+                                        gse_shaper_color_t *color);
+
+/**
+ *  @brief   Count a PDU skipped by the frame filling in the shapers that
+ *           hold it
+ *
+ *  A red PDU is counted once per frame filling, the other ones are not
+ *  held but only wait for the space left by the PDUs of better color.
+ *
+ *  @param   encap      The encapsulation structure
+ *  @param   encap_ctx  The PDU
+ *  @param   color      The color of the PDU
+ *
+ *  @return
+ *                      - success/informative code among:
+ *                        - \ref GSE_STATUS_OK
+ *                      - warning/error code among:
+ *                        - \ref GSE_STATUS_PTHREAD_MUTEX
+ */
+static gse_status_t gse_encap_hold_ctx(gse_encap_t *encap,
+                                       gse_encap_ctx_t *encap_ctx,
+                                       gse_shaper_color_t color);
+
+/**
+ *  @brief   Get the shapers of the QoS value and of the label of a PDU
+ *
+ *  The shaper mutex shall be locked.
+ *
+ *  @param   encap         The encapsulation structure
+ *  @param   encap_ctx     The PDU
+ *  @param   qos_shaper    OUT: The shaper of the QoS value, NULL if none
+ *  @param   label_shaper  OUT: The shaper of the label, NULL if none
+ *
+ *  @return
+ *                         - success/informative code among:
+ *                           - \ref GSE_STATUS_OK
+ *                         - warning/error code among:
+ *                           - \ref GSE_STATUS_PTHREAD_MUTEX
+ */
+static gse_status_t gse_encap_get_shapers(gse_encap_t *encap,
+                                          gse_encap_ctx_t *encap_ctx,
+                                          gse_shaper_t **qos_shaper,
+                                          gse_shaper_t **label_shaper);
+
+/**
+ *  @brief   Charge the shapers of the QoS value and of the label of a PDU
+ *           with a GSE packet
+ *
+ *  @param   encap       The encapsulation structure
+ *  @param   qos         The QoS value of the PDU
+ *  @param   label       The label of the PDU
+ *  @param   label_type  The label type of the PDU
+ *  @param   length      The GSE packet length (in bytes)
+ *  @param   color       The color of the PDU
+ *
+ *  @return
+ *                       - success/informative code among:
+ *                         - \ref GSE_STATUS_OK
+ *                       - warning/error code among:
+ *                         - \ref GSE_STATUS_PTHREAD_MUTEX
+ */
+static gse_status_t gse_encap_charge_shapers(gse_encap_t *encap, uint8_t qos,
+                                             uint8_t *label,
+                                             uint8_t label_type,
+                                             size_t length,
+                                             gse_shaper_color_t color);
+
+/**
+ *  @brief   Build a GSE packet with a FIFO element
+ *
+ *  The element is removed from the FIFO once the PDU is completely sent.
+ *
+ *  @param   mode            The encapsulation mode.
+ *  @param   packet          OUT: The GSE packet on success,
+ *                                NULL on error (unused in FRAME mode)
+ *  @param   buffer          The buffer where the packet is copied in FRAME
+ *                           mode (unused in other modes)
+ *  @param   encap           The encapsulation structure
+ *  @param   desired_length  The desired length for the packet (in bytes)
+ *  @param   fifo            The FIFO
+ *  @param   index           The position of the element in the FIFO
+ *  @param   encap_ctx       The element
+ *  @param   packet_length   OUT: The length of the packet on success
+ *                                (may be NULL)
+ *  @param   stats           IN/OUT: Statistics updated with the packet content
+ *                                   (may be NULL)
+ *
+ *  @return                  The same codes as \ref gse_encap_get_packet_common
+ */
+static gse_status_t gse_encap_build_packet(int mode, gse_vfrag_t **packet,
+                                           unsigned char *buffer,
+                                           gse_encap_iov_packet_t *iov_packet,
+                                           gse_encap_t *encap,
+                                           size_t desired_length,
+                                           fifo_t *fifo, unsigned int index,
+                                           gse_encap_ctx_t *encap_ctx,
+                                           size_t *packet_length,
+                                           gse_frame_stats_t *stats);
+
+/**
+ *  @brief   Check that all the FIFOs of a table are empty
+ *
+ *  @param   encap  The encapsulation structure
+ *  @param   fifos  The table of FIFOs, one per QoS value
+ *
+ *  @return
+ *                  - success/informative code among:
+ *                    - \ref GSE_STATUS_OK
+ *                  - warning/error code among:
+ *                    - \ref GSE_STATUS_FIFO_NOT_EMPTY
+ *                    - \ref GSE_STATUS_PTHREAD_MUTEX
+ */
+static gse_status_t gse_encap_check_fifos_empty(gse_encap_t *encap,
+                                                fifo_t *fifos);
+
+/**
+ *  @brief   Create the FIFOs of a modcod group if they do not exist yet
+ *
+ *  The modcod mutex shall be locked.
+ *
+ *  @param   encap   The encapsulation structure
+ *  @param   modcod  The modcod group
+ *
+ *  @return
+ *                   - success/informative code among:
+ *                     - \ref GSE_STATUS_OK
+ *                   - warning/error code among:
+ *                     - \ref GSE_STATUS_MALLOC_FAILED
+ *                     - \ref GSE_STATUS_FIFO_SIZE_NULL
+ */
+static gse_status_t gse_encap_create_modcod_fifos(gse_encap_t *encap,
+                                                  uint8_t modcod);
+
+/**
+ *  @brief   Fill a frame with GSE packets built from a table of FIFOs
+ *
+ *  @param   encap         The encapsulation structure
+ *  @param   fifos         The table of FIFOs, one per QoS value
+ *  @param   policy        The frame filling policy
+ *  @param   frame         The frame
+ *  @param   frame_length  The length of the frame (in bytes)
+ *  @param   data_length   OUT: The length of the GSE packets in the frame
+ *  @param   stats         OUT: The frame statistics (may be NULL)
+ *
+ *  @return                The same codes as \ref gse_encap_fill_frame
+ */
+static gse_status_t gse_encap_fill_fifos(gse_encap_t *encap, fifo_t *fifos,
+                                         gse_fill_policy_t policy,
+                                         unsigned char *frame,
+                                         size_t frame_length,
+                                         size_t *data_length,
+                                         gse_frame_stats_t *stats);
+
+/**
+ *  @brief   Check a PDU and push it in the FIFO of its QoS value
+ *
+ *  @param   pdu         The PDU
+ *  @param   pdu_length  The length of the whole PDU (in bytes)
+ *  @param   encap       The encapsulation structure
+ *  @param   label       The packet label
+ *  @param   label_type  The label type field value
+ *  @param   protocol    The PDU protocol
+ *  @param   qos         The QoS value of the PDU
+ *  @param   flow_key    The flow key given by the user
+ *  @param   stream      The stream of the PDU if it is received in chunks,
+ *                       NULL otherwise
+ *  @param   chain       The chain holding the PDU if it is chained, NULL
+ *                       otherwise (pdu is then NULL)
+ *
+ *  @return              The same codes as \ref gse_encap_receive_pdu
+ */
+static gse_status_t gse_encap_push_pdu(gse_vfrag_t *pdu, size_t pdu_length,
+                                       gse_encap_t *encap, uint8_t label[6],
+                                       uint8_t label_type, uint16_t protocol,
+                                       uint8_t qos, uint32_t flow_key,
+                                       gse_encap_stream_t *stream,
+                                       gse_vfrag_chain_t *chain);
+
+/**
+ *  @brief   Check a PDU and build its FIFO element
+ *
+ *  @param   pdu         The PDU
+ *  @param   pdu_length  The length of the whole PDU (in bytes)
+ *  @param   encap       The encapsulation structure
+ *  @param   label       The packet label
+ *  @param   label_type  The label type field value
+ *  @param   protocol    The PDU protocol
+ *  @param   qos         The QoS value of the PDU
+ *  @param   flow_key    The flow key given by the user
+ *  @param   stream      The stream of the PDU if it is received in chunks,
+ *                       NULL otherwise
+ *  @param   chain       The chain holding the PDU if it is chained, NULL
+ *                       otherwise (pdu is then NULL)
+ *  @param   ctx_elts    OUT: The FIFO element of the PDU
+ *  @param   fifo        OUT: The FIFO the PDU shall be pushed in
+ *
+ *  @return              The same codes as \ref gse_encap_receive_pdu except
+ *                       \ref GSE_STATUS_FIFO_FULL
+ */
+static gse_status_t gse_encap_build_ctx(gse_vfrag_t *pdu, size_t pdu_length,
+                                        gse_encap_t *encap, uint8_t label[6],
+                                        uint8_t label_type, uint16_t protocol,
+                                        uint8_t qos, uint32_t flow_key,
+                                        gse_encap_stream_t *stream,
+                                        gse_vfrag_chain_t *chain,
+                                        gse_encap_ctx_t *ctx_elts,
+                                        fifo_t **fifo);
+
+/**
+ *  @brief   Push the PDUs of a local queue in their FIFOs
+ *
+ *  The consecutive PDUs of a FIFO are pushed at once. The PDUs that cannot
+ *  be pushed are kept in order in the local queue.
+ *
+ *  @param   queue  The local queue
+ *
+ *  @return
+ *                  - success/informative code among:
+ *                    - \ref GSE_STATUS_OK
+ *                  - warning/error code among:
+ *                    - \ref GSE_STATUS_PTHREAD_MUTEX
+ *                    - \ref GSE_STATUS_FIFO_FULL
+ *                    - \ref GSE_STATUS_MALLOC_FAILED
+ */
+static gse_status_t gse_encap_flush_local_queue(gse_encap_local_queue_t *queue);
+
+/**
+ *  @brief   Get the data available for a FIFO element
+ *
+ *  A PDU received in chunks is ready once some of its data is available or
+ *  once it was aborted, it is complete once all its data was appended.
+ *
+ *  @param   encap_ctx  The element
+ *  @param   length     OUT: The length of the data available in the element
+ *  @param   complete   OUT: Whether no more data will be appended
+ *
+ *  @return
+ *                      - success/informative code among:
+ *                        - \ref GSE_STATUS_OK
+ *                      - warning/error code among:
+ *                        - \ref GSE_STATUS_PTHREAD_MUTEX
+ */
+static gse_status_t gse_encap_get_ctx_data(gse_encap_ctx_t *encap_ctx,
+                                           size_t *length, int *complete);
+
+/**
+ *  @brief   Remove an element whose data was completely sent from its FIFO
+ *
+ *  @param   mode       The encapsulation mode
+ *  @param   encap      The encapsulation structure
+ *  @param   fifo       The FIFO
+ *  @param   index      The position of the element in the FIFO
+ *  @param   encap_ctx  The element
+ *
+ *  @return
+ *                      - success/informative code among:
+ *                        - \ref GSE_STATUS_OK
+ *                      - warning/error code among:
+ *                        - \ref GSE_STATUS_NULL_PTR
+ *                        - \ref GSE_STATUS_FRAG_NBR
+ *                        - \ref GSE_STATUS_PTHREAD_MUTEX
+ *                        - \ref GSE_STATUS_FIFO_EMPTY
+ */
+static gse_status_t gse_encap_remove_ctx(int mode, gse_encap_t *encap,
+                                         fifo_t *fifo, unsigned int index,
+                                         gse_encap_ctx_t *encap_ctx);
+
+/**
+ *  @brief   Release a reference on a stream and free it with the last one
+ *
+ *  @param   stream  The stream
+ */
+static void gse_encap_put_stream(gse_encap_stream_t *stream);
+
+/**
+ *  @brief   Abort the streams of the elements of a FIFO before its release
+ *
+ *  @param   fifo  The FIFO
+ */
+static void gse_encap_release_streams(fifo_t *fifo);
+
+/**
+ *  @brief   Allocate the watermarks of the QoS values
+ *
+ *  The watermarks are disabled, they are applied to all the FIFOs. The
+ *  modcod mutex shall be locked.
+ *
+ *  @param   encap  The encapsulation structure
+ *
+ *  @return
+ *                  - success/informative code among:
+ *                    - \ref GSE_STATUS_OK
+ *                  - warning/error code among:
+ *                    - \ref GSE_STATUS_MALLOC_FAILED
+ *                    - \ref GSE_STATUS_PTHREAD_MUTEX
+ */
+static gse_status_t gse_encap_alloc_watermarks(gse_encap_t *encap);
 
 /**
  *  @brief   Get a GSE packet from the encapsulation context structure
@@ -195,6 +841,7 @@ static uint32_t gse_encap_compute_crc(gse_vfrag_t *vfrag);
  *  @param   mode             The encapsulation mode.
  *  @param   packet           OUT: The GSE packet on success,
  *                                 NULL on error
+ *  @param   iov_packet       OUT: The GSE packet in scatter-gather mode
  *  @param   encap            The encapsulation context structure
  *  @param   desired_length   The desired length for the packet (in bytes)
  *  @param   qos              The QoS of the packet
@@ -223,6 +870,7 @@ static uint32_t gse_encap_compute_crc(gse_vfrag_t *vfrag);
  *                              - \ref GSE_STATUS_EXTENSION_CB_FAILED
  */
 static gse_status_t gse_encap_get_packet_common(int mode, gse_vfrag_t **packet,
+                                                gse_encap_iov_packet_t *iov_packet,
                                                 gse_encap_t *encap,
                                                 size_t desired_length,
                                                 uint8_t qos);
@@ -283,6 +931,43 @@ gse_status_t gse_encap_init(uint8_t qos_nbr, size_t fifo_size,
     }
   }
 
+  (*encap)->fill_window = GSE_DEFAULT_FILL_WINDOW;
+  (*encap)->crc_min_length = GSE_DEFAULT_CRC_MIN_LENGTH;
+  (*encap)->fifo_size = fifo_size;
+  (*encap)->event_fd = -1;
+
+  /* The QoS value is used as FragID until a FragID pool is enabled */
+  if(pthread_mutex_init(&(*encap)->frag_id_mutex, NULL) != 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+    goto free_fifo;
+  }
+
+  /* All the PDUs go in the default FIFOs until a label is associated to a
+   * modcod */
+  if(pthread_mutex_init(&(*encap)->modcod_mutex, NULL) != 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+    goto free_frag_id_mutex;
+  }
+  status = gse_init_label_map(&(*encap)->label_map);
+  if(status != GSE_STATUS_OK)
+  {
+    goto free_modcod_mutex;
+  }
+
+  /* Shaping is disabled until a shaper is set */
+  if(pthread_mutex_init(&(*encap)->shaper_mutex, NULL) != 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+    goto free_label_map;
+  }
+  status = gse_init_label_map(&(*encap)->shaper_map);
+  if(status != GSE_STATUS_OK)
+  {
+    goto free_shaper_mutex;
+  }
+
   /* Initialize offsets
    * The head offset length difference between first fragment header and
    * complete one, it allows to allocate enough space for a complete PDU
@@ -290,11 +975,21 @@ gse_status_t gse_encap_init(uint8_t qos_nbr, size_t fifo_size,
   status = gse_encap_set_offsets(*encap, GSE_MAX_REFRAG_HEAD_OFFSET, 0);
   if(status != GSE_STATUS_OK)
   {
-    goto free_fifo;
+    goto free_shaper_map;
   }
 
   return GSE_STATUS_OK;
 
+free_shaper_map:
+  gse_release_label_map(&(*encap)->shaper_map);
+free_shaper_mutex:
+  pthread_mutex_destroy(&(*encap)->shaper_mutex);
+free_label_map:
+  gse_release_label_map(&(*encap)->label_map);
+free_modcod_mutex:
+  pthread_mutex_destroy(&(*encap)->modcod_mutex);
+free_frag_id_mutex:
+  pthread_mutex_destroy(&(*encap)->frag_id_mutex);
 free_fifo:
   free((*encap)->fifo);
 free_encap:
@@ -313,6 +1008,7 @@ gse_status_t gse_encap_release(gse_encap_t *encap)
   gse_status_t stat_mem = GSE_STATUS_OK;
 
   unsigned int i;
+  unsigned int modcod;
 
   if(encap == NULL)
   {
@@ -320,9 +1016,61 @@ gse_status_t gse_encap_release(gse_encap_t *encap)
     goto error;
   }
 
+  /* Release the FIFOs of the modcod groups */
+  if(encap->modcod_fifo != NULL)
+  {
+    for(modcod = 0 ; modcod < GSE_MODCOD_NBR ; modcod++)
+    {
+      if(encap->modcod_fifo[modcod] == NULL)
+      {
+        continue;
+      }
+      for(i = 0 ; i < encap->qos_nbr ; i++)
+      {
+        gse_encap_release_streams(&encap->modcod_fifo[modcod][i]);
+        status = gse_release_fifo(&encap->modcod_fifo[modcod][i]);
+        if(status != GSE_STATUS_OK)
+        {
+          stat_mem = status;
+        }
+      }
+      free(encap->modcod_fifo[modcod]);
+    }
+    free(encap->modcod_fifo);
+  }
+  status = gse_release_label_map(&encap->label_map);
+  if(status != GSE_STATUS_OK)
+  {
+    stat_mem = status;
+  }
+  if(pthread_mutex_destroy(&encap->modcod_mutex) != 0)
+  {
+    stat_mem = GSE_STATUS_PTHREAD_MUTEX;
+  }
+
+  /* Release the shapers */
+  if(encap->qos_shapers != NULL)
+  {
+    free(encap->qos_shapers);
+  }
+  if(encap->label_shapers != NULL)
+  {
+    free(encap->label_shapers);
+  }
+  status = gse_release_label_map(&encap->shaper_map);
+  if(status != GSE_STATUS_OK)
+  {
+    stat_mem = status;
+  }
+  if(pthread_mutex_destroy(&encap->shaper_mutex) != 0)
+  {
+    stat_mem = GSE_STATUS_PTHREAD_MUTEX;
+  }
+
   /* Release FIFO in each context */
   for(i = 0 ; i < encap->qos_nbr ; i++)
   {
+    gse_encap_release_streams(&encap->fifo[i]);
     status = gse_release_fifo(&encap->fifo[i]);
     if(status != GSE_STATUS_OK)
     {
@@ -330,6 +1078,27 @@ gse_status_t gse_encap_release(gse_encap_t *encap)
     }
   }
   free(encap->fifo);
+  if(pthread_mutex_destroy(&encap->frag_id_mutex) != 0)
+  {
+    stat_mem = GSE_STATUS_PTHREAD_MUTEX;
+  }
+  gse_crc_pool_release(encap->crc_pool);
+  if(encap->event_fd >= 0)
+  {
+    close(encap->event_fd);
+  }
+  if(encap->watermarks != NULL)
+  {
+    for(i = 0 ; i < encap->qos_nbr ; i++)
+    {
+      status = gse_release_fifo_watermark(&encap->watermarks[i]);
+      if(status != GSE_STATUS_OK)
+      {
+        stat_mem = status;
+      }
+    }
+    free(encap->watermarks);
+  }
   free(encap);
 
   return stat_mem;
@@ -349,67 +1118,262 @@ gse_status_t gse_encap_set_offsets(gse_encap_t *encap,
   return GSE_STATUS_OK;
 }
 
-/* Encapsulation functions */
-
-gse_status_t gse_encap_receive_pdu(gse_vfrag_t *pdu, gse_encap_t *encap,
-                                   uint8_t label[6], uint8_t label_type,
-                                   uint16_t protocol, uint8_t qos)
+gse_status_t gse_encap_set_frag_id_pool(gse_encap_t *encap,
+                                        unsigned int frag_id_nbr,
+                                        unsigned int window)
 {
   gse_status_t status = GSE_STATUS_OK;
 
-  gse_encap_ctx_t *encap_ctx;
-  gse_encap_ctx_t ctx_elts;
-  int label_length = -1;
+  unsigned int modcod;
+  int elt_nbr;
 
-  /* Check parameters validity */
-  if(pdu == NULL)
+  if(encap == NULL)
   {
     status = GSE_STATUS_NULL_PTR;
     goto error;
   }
-  if(encap == NULL)
+  /* FragID field is 8 bits long */
+  if(frag_id_nbr > 256)
   {
-    status = GSE_STATUS_NULL_PTR;
-    goto free_pdu;
+    status = GSE_STATUS_INVALID_FRAG_ID_NBR;
+    goto error;
   }
-  label_length = gse_get_label_length(label_type);
-  if(label_length < 0)
+  /* The modcod groups need the FragID pool */
+  if(frag_id_nbr == 0)
   {
-    status = GSE_STATUS_INVALID_LT;
-    goto free_pdu;
-  }
-  /* Total length field shall be < 65536 */
-  if(pdu->length > (GSE_MAX_PDU_LENGTH - GSE_PROTOCOL_TYPE_LENGTH -
-                    (unsigned int)label_length))
+    elt_nbr = gse_get_label_map_elt_nbr(&encap->label_map);
+    if(elt_nbr < 0)
+    {
+      status = GSE_STATUS_PTHREAD_MUTEX;
+      goto error;
+    }
+    if(elt_nbr > 0)
+    {
+      status = GSE_STATUS_FRAG_ID_POOL_REQUIRED;
+      goto error;
+    }
+  }
+  /* FragID values cannot be changed while PDUs are being fragmented */
+  status = gse_encap_check_fifos_empty(encap, encap->fifo);
+  if(status != GSE_STATUS_OK)
   {
-    status = GSE_STATUS_PDU_LENGTH;
+    goto error;
+  }
+  if(pthread_mutex_lock(&encap->modcod_mutex) != 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+    goto error;
+  }
+  if(encap->modcod_fifo != NULL)
+  {
+    for(modcod = 0 ; modcod < GSE_MODCOD_NBR ; modcod++)
+    {
+      if(encap->modcod_fifo[modcod] == NULL)
+      {
+        continue;
+      }
+      status = gse_encap_check_fifos_empty(encap, encap->modcod_fifo[modcod]);
+      if(status != GSE_STATUS_OK)
+      {
+        break;
+      }
+    }
+  }
+  if(pthread_mutex_unlock(&encap->modcod_mutex) != 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+  }
+  if(status != GSE_STATUS_OK)
+  {
+    goto error;
+  }
+
+  if(pthread_mutex_lock(&encap->frag_id_mutex) != 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+    goto error;
+  }
+  encap->frag_id_nbr = frag_id_nbr;
+  encap->frag_window = (window > 0 ? window : 1);
+  memset(encap->frag_id_used, 0, sizeof(encap->frag_id_used));
+  if(pthread_mutex_unlock(&encap->frag_id_mutex) != 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+  }
+
+error:
+  return status;
+}
+
+gse_status_t gse_encap_set_flow_queuing(gse_encap_t *encap, uint16_t flow_nbr,
+                                        unsigned int quantum)
+{
+  gse_status_t status = GSE_STATUS_OK;
+
+  unsigned int modcod;
+  unsigned int i;
+
+  if(encap == NULL)
+  {
+    status = GSE_STATUS_NULL_PTR;
+    goto error;
+  }
+  if(quantum == 0)
+  {
+    quantum = GSE_DEFAULT_FLOW_QUANTUM;
+  }
+
+  /* The PDUs already received are not accounted in the flows */
+  status = gse_encap_check_fifos_empty(encap, encap->fifo);
+  if(status != GSE_STATUS_OK)
+  {
+    goto error;
+  }
+  if(pthread_mutex_lock(&encap->modcod_mutex) != 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+    goto error;
+  }
+  if(encap->modcod_fifo != NULL)
+  {
+    for(modcod = 0 ; modcod < GSE_MODCOD_NBR ; modcod++)
+    {
+      if(encap->modcod_fifo[modcod] == NULL)
+      {
+        continue;
+      }
+      status = gse_encap_check_fifos_empty(encap, encap->modcod_fifo[modcod]);
+      if(status != GSE_STATUS_OK)
+      {
+        goto unlock;
+      }
+    }
+  }
+
+  for(i = 0 ; i < encap->qos_nbr ; i++)
+  {
+    status = gse_set_fifo_flows(&encap->fifo[i], flow_nbr, quantum);
+    if(status != GSE_STATUS_OK)
+    {
+      goto unlock;
+    }
+  }
+  if(encap->modcod_fifo != NULL)
+  {
+    for(modcod = 0 ; modcod < GSE_MODCOD_NBR ; modcod++)
+    {
+      if(encap->modcod_fifo[modcod] == NULL)
+      {
+        continue;
+      }
+      for(i = 0 ; i < encap->qos_nbr ; i++)
+      {
+        status = gse_set_fifo_flows(&encap->modcod_fifo[modcod][i], flow_nbr,
+                                    quantum);
+        if(status != GSE_STATUS_OK)
+        {
+          goto unlock;
+        }
+      }
+    }
+  }
+  encap->flow_nbr = flow_nbr;
+  encap->flow_quantum = quantum;
+
+unlock:
+  if(pthread_mutex_unlock(&encap->modcod_mutex) != 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+  }
+error:
+  return status;
+}
+
+/* Encapsulation functions */
+
+gse_status_t gse_encap_receive_pdu(gse_vfrag_t *pdu, gse_encap_t *encap,
+                                   uint8_t label[6], uint8_t label_type,
+                                   uint16_t protocol, uint8_t qos)
+{
+  return gse_encap_receive_pdu_flow(pdu, encap, label, label_type, protocol,
+                                    qos, 0);
+}
+
+gse_status_t gse_encap_receive_pdu_flow(gse_vfrag_t *pdu, gse_encap_t *encap,
+                                        uint8_t label[6], uint8_t label_type,
+                                        uint16_t protocol, uint8_t qos,
+                                        uint32_t flow_key)
+{
+  gse_status_t status = GSE_STATUS_OK;
+
+  /* Check parameters validity */
+  if(pdu == NULL)
+  {
+    status = GSE_STATUS_NULL_PTR;
+    goto error;
+  }
+  if(encap == NULL)
+  {
+    status = GSE_STATUS_NULL_PTR;
     goto free_pdu;
   }
-  /* Check if we got a good protocol */
-  if(gse_is_ext_hdr(protocol))
+
+  status = gse_encap_push_pdu(pdu, pdu->length, encap, label, label_type,
+                              protocol, qos, flow_key, NULL, NULL);
+  if(status != GSE_STATUS_OK)
   {
-    status = GSE_STATUS_WRONG_PROTOCOL;
     goto free_pdu;
   }
-  /* Check if QoS value is supported */
-  if(qos >= encap->qos_nbr)
+
+error:
+  return status;
+free_pdu:
+  gse_free_vfrag_no_alloc(&pdu, 1, 0);
+  return status;
+}
+
+gse_status_t gse_encap_receive_pdu_chain(gse_vfrag_chain_t *pdu,
+                                         gse_encap_t *encap,
+                                         uint8_t label[6], uint8_t label_type,
+                                         uint16_t protocol, uint8_t qos,
+                                         uint32_t flow_key)
+{
+  gse_status_t status = GSE_STATUS_OK;
+
+  gse_vfrag_t *vfrag;
+
+  /* Check parameters validity */
+  if(pdu == NULL)
   {
-    status = GSE_STATUS_INVALID_QOS;
+    status = GSE_STATUS_NULL_PTR;
+    goto error;
+  }
+  if(encap == NULL)
+  {
+    status = GSE_STATUS_NULL_PTR;
+    goto free_pdu;
+  }
+  if(pdu->length == 0)
+  {
+    status = GSE_STATUS_EMPTY_FRAG;
     goto free_pdu;
   }
 
-  /* Fill context used to push the FIFO */
-  ctx_elts.vfrag = pdu;
-  ctx_elts.qos = qos;
-  ctx_elts.protocol_type = htons(protocol);
-  ctx_elts.label_type = label_type;
-  memcpy(&(ctx_elts.label), label, label_length);
-  ctx_elts.frag_nbr = 0;
-  ctx_elts.total_length = gse_encap_compute_total_length(&ctx_elts);
+  /* A single segment with room for the header and the CRC is encapsulated
+   * in place as a contiguous PDU */
+  vfrag = pdu->segments[0];
+  if(pdu->seg_nbr == 1 && pdu->trailer_length == 0 && pdu->ref_nbr == 1 &&
+     (size_t)(vfrag->start - vfrag->vbuf->start) >= GSE_MAX_HEADER_LENGTH &&
+     (size_t)(vfrag->vbuf->end - vfrag->end) >= GSE_MAX_TRAILER_LENGTH)
+  {
+    pdu->seg_nbr = 0;
+    gse_free_vfrag_chain(&pdu);
+    return gse_encap_receive_pdu_flow(vfrag, encap, label, label_type,
+                                      protocol, qos, flow_key);
+  }
 
-  /* Push FIFO */
-  encap_ctx = NULL;
-  status = gse_push_fifo(&encap->fifo[qos], &encap_ctx, ctx_elts);
+  status = gse_encap_push_pdu(NULL, pdu->length, encap, label, label_type,
+                              protocol, qos, flow_key, NULL, pdu);
   if(status != GSE_STATUS_OK)
   {
     goto free_pdu;
@@ -418,521 +1382,3840 @@ gse_status_t gse_encap_receive_pdu(gse_vfrag_t *pdu, gse_encap_t *encap,
 error:
   return status;
 free_pdu:
-  gse_free_vfrag_no_alloc(&pdu, 1, 0);
+  gse_free_vfrag_chain(&pdu);
   return status;
 }
 
-gse_status_t gse_encap_get_packet(gse_vfrag_t **packet, gse_encap_t *encap,
-                                  size_t length, uint8_t qos)
+gse_status_t gse_encap_local_init(gse_encap_t *encap, unsigned int size,
+                                  gse_encap_local_t **local)
+{
+  gse_status_t status = GSE_STATUS_OK;
+
+  unsigned int qos;
+
+  if(encap == NULL || local == NULL)
+  {
+    status = GSE_STATUS_NULL_PTR;
+    goto error;
+  }
+  if(size == 0)
+  {
+    status = GSE_STATUS_FIFO_SIZE_NULL;
+    goto error;
+  }
+
+  *local = calloc(1, sizeof(gse_encap_local_t));
+  if(*local == NULL)
+  {
+    status = GSE_STATUS_MALLOC_FAILED;
+    goto error;
+  }
+  (*local)->encap = encap;
+  (*local)->size = size;
+  (*local)->queues = calloc(encap->qos_nbr, sizeof(gse_encap_local_queue_t));
+  if((*local)->queues == NULL)
+  {
+    status = GSE_STATUS_MALLOC_FAILED;
+    goto free_local;
+  }
+  for(qos = 0 ; qos < encap->qos_nbr ; qos++)
+  {
+    (*local)->queues[qos].values = malloc(size * sizeof(gse_encap_ctx_t));
+    (*local)->queues[qos].fifos = malloc(size * sizeof(fifo_t *));
+    if((*local)->queues[qos].values == NULL ||
+       (*local)->queues[qos].fifos == NULL)
+    {
+      status = GSE_STATUS_MALLOC_FAILED;
+      goto free_queues;
+    }
+  }
+
+  return status;
+free_queues:
+  for(qos = 0 ; qos < encap->qos_nbr ; qos++)
+  {
+    free((*local)->queues[qos].values);
+    free((*local)->queues[qos].fifos);
+  }
+  free((*local)->queues);
+free_local:
+  free(*local);
+  *local = NULL;
+error:
+  return status;
+}
+
+gse_status_t gse_encap_local_release(gse_encap_local_t *local)
+{
+  gse_status_t status = GSE_STATUS_OK;
+  gse_status_t stat_mem = GSE_STATUS_OK;
+
+  gse_encap_local_queue_t *queue;
+  unsigned int qos;
+  unsigned int i;
+
+  if(local == NULL)
+  {
+    status = GSE_STATUS_NULL_PTR;
+    goto error;
+  }
+
+  /* The PDUs that were not flushed are destroyed */
+  for(qos = 0 ; qos < local->encap->qos_nbr ; qos++)
+  {
+    queue = &local->queues[qos];
+    for(i = 0 ; i < queue->elt_nbr ; i++)
+    {
+      status = gse_free_vfrag(&(queue->values[i].vfrag));
+      if(status != GSE_STATUS_OK)
+      {
+        stat_mem = status;
+      }
+    }
+    free(queue->values);
+    free(queue->fifos);
+  }
+  free(local->queues);
+  free(local);
+
+  return stat_mem;
+error:
+  return status;
+}
+
+gse_status_t gse_encap_local_receive_pdu(gse_vfrag_t *pdu,
+                                         gse_encap_local_t *local,
+                                         uint8_t label[6], uint8_t label_type,
+                                         uint16_t protocol, uint8_t qos,
+                                         uint32_t flow_key)
 {
-  return gse_encap_get_packet_common(NO_COPY, packet, encap, length, qos);
+  gse_status_t status = GSE_STATUS_OK;
+
+  gse_encap_local_queue_t *queue;
+  gse_encap_ctx_t ctx_elts;
+  fifo_t *fifo;
+
+  /* Check parameters validity */
+  if(pdu == NULL)
+  {
+    status = GSE_STATUS_NULL_PTR;
+    goto error;
+  }
+  if(local == NULL)
+  {
+    status = GSE_STATUS_NULL_PTR;
+    goto free_pdu;
+  }
+
+  status = gse_encap_build_ctx(pdu, pdu->length, local->encap, label,
+                               label_type, protocol, qos, flow_key, NULL, NULL,
+                               &ctx_elts, &fifo);
+  if(status != GSE_STATUS_OK)
+  {
+    goto free_pdu;
+  }
+
+  /* The PDU is dropped if none of the PDUs staged before it can be
+   * pushed */
+  queue = &local->queues[qos];
+  if(queue->elt_nbr >= local->size)
+  {
+    status = gse_encap_flush_local_queue(queue);
+    if(queue->elt_nbr >= local->size)
+    {
+      goto free_pdu;
+    }
+    status = GSE_STATUS_OK;
+  }
+  queue->values[queue->elt_nbr] = ctx_elts;
+  queue->fifos[queue->elt_nbr] = fifo;
+  queue->elt_nbr++;
+
+  /* The batch is pushed as soon as it is complete, the PDUs that do not fit
+   * in their FIFO are kept for the next flush */
+  if(queue->elt_nbr >= local->size)
+  {
+    gse_encap_flush_local_queue(queue);
+  }
+
+error:
+  return status;
+free_pdu:
+  gse_free_vfrag(&pdu);
+  return status;
 }
 
-gse_status_t gse_encap_get_packet_copy(gse_vfrag_t **packet, gse_encap_t *encap,
-                                       size_t length, uint8_t qos)
-{
-  return gse_encap_get_packet_common(LEGACY, packet, encap, length, qos);
+gse_status_t gse_encap_local_flush(gse_encap_local_t *local)
+{
+  gse_status_t status = GSE_STATUS_OK;
+  gse_status_t stat_qos;
+
+  unsigned int qos;
+
+  if(local == NULL)
+  {
+    status = GSE_STATUS_NULL_PTR;
+    goto error;
+  }
+
+  /* A full FIFO does not prevent the other QoS values from being flushed */
+  for(qos = 0 ; qos < local->encap->qos_nbr ; qos++)
+  {
+    stat_qos = gse_encap_flush_local_queue(&local->queues[qos]);
+    if(stat_qos != GSE_STATUS_OK)
+    {
+      status = stat_qos;
+    }
+  }
+
+error:
+  return status;
+}
+
+gse_status_t gse_encap_local_get_nbr(gse_encap_local_t *local, uint8_t qos,
+                                     unsigned int *elt_nbr)
+{
+  gse_status_t status = GSE_STATUS_OK;
+
+  if(local == NULL || elt_nbr == NULL)
+  {
+    status = GSE_STATUS_NULL_PTR;
+    goto error;
+  }
+  if(qos >= local->encap->qos_nbr)
+  {
+    status = GSE_STATUS_INVALID_QOS;
+    goto error;
+  }
+
+  *elt_nbr = local->queues[qos].elt_nbr;
+
+error:
+  return status;
+}
+
+gse_status_t gse_encap_open_pdu(gse_encap_t *encap, size_t pdu_length,
+                                uint8_t label[6], uint8_t label_type,
+                                uint16_t protocol, uint8_t qos,
+                                uint32_t flow_key, gse_encap_stream_t **stream)
+{
+  gse_status_t status = GSE_STATUS_OK;
+
+  gse_vfrag_t *pdu;
+  size_t head_offset;
+
+  if(stream == NULL)
+  {
+    status = GSE_STATUS_NULL_PTR;
+    goto error;
+  }
+  *stream = NULL;
+  if(encap == NULL)
+  {
+    status = GSE_STATUS_NULL_PTR;
+    goto error;
+  }
+  if(pdu_length == 0)
+  {
+    status = GSE_STATUS_BUFF_LENGTH_NULL;
+    goto error;
+  }
+  if(pdu_length > GSE_MAX_PDU_LENGTH)
+  {
+    status = GSE_STATUS_PDU_LENGTH;
+    goto error;
+  }
+
+  /* The PDU buffer is allocated once with room for the header, the
+   * extensions and the CRC, the data is then appended at its end */
+  head_offset = GSE_MAX_HEADER_LENGTH;
+  if(encap->build_header_ext != NULL)
+  {
+    head_offset += GSE_MAX_EXT_LENGTH;
+  }
+  status = gse_create_vfrag(&pdu, pdu_length, head_offset,
+                            GSE_MAX_TRAILER_LENGTH);
+  if(status != GSE_STATUS_OK)
+  {
+    goto error;
+  }
+  status = gse_shift_vfrag(pdu, 0, pdu_length * -1);
+  if(status != GSE_STATUS_OK)
+  {
+    goto free_pdu;
+  }
+
+  *stream = malloc(sizeof(gse_encap_stream_t));
+  if(*stream == NULL)
+  {
+    status = GSE_STATUS_MALLOC_FAILED;
+    goto free_pdu;
+  }
+  if(pthread_mutex_init(&(*stream)->mutex, NULL) != 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+    goto free_stream;
+  }
+  (*stream)->vfrag = pdu;
+  (*stream)->pdu_length = pdu_length;
+  (*stream)->received_length = 0;
+  (*stream)->crc = GSE_CRC_INIT;
+  (*stream)->crc_started = 0;
+  (*stream)->complete = 0;
+  (*stream)->aborted = 0;
+  /* The stream is used by the user and by the FIFO element */
+  (*stream)->ref_nbr = 2;
+
+  status = gse_encap_push_pdu(pdu, pdu_length, encap, label, label_type,
+                              protocol, qos, flow_key, *stream, NULL);
+  if(status != GSE_STATUS_OK)
+  {
+    goto destroy_mutex;
+  }
+
+  return status;
+destroy_mutex:
+  pthread_mutex_destroy(&(*stream)->mutex);
+free_stream:
+  free(*stream);
+  *stream = NULL;
+free_pdu:
+  gse_free_vfrag(&pdu);
+error:
+  return status;
+}
+
+gse_status_t gse_encap_append_pdu(gse_encap_stream_t *stream,
+                                  const unsigned char *data, size_t length)
+{
+  gse_status_t status = GSE_STATUS_OK;
+
+  uint32_t crc;
+  int complete = 0;
+
+  if(stream == NULL || (data == NULL && length > 0))
+  {
+    status = GSE_STATUS_NULL_PTR;
+    goto error;
+  }
+
+  if(pthread_mutex_lock(&stream->mutex) != 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+    goto error;
+  }
+  if(stream->aborted)
+  {
+    status = GSE_STATUS_PDU_ABORTED;
+    goto unlock;
+  }
+  if(length > stream->pdu_length - stream->received_length)
+  {
+    status = GSE_STATUS_DATA_TOO_LONG;
+    goto unlock;
+  }
+
+  status = gse_shift_vfrag(stream->vfrag, 0, length);
+  if(status != GSE_STATUS_OK)
+  {
+    goto unlock;
+  }
+  memcpy(stream->vfrag->end - length, data, length);
+  stream->received_length += length;
+
+  /* Once the first fragment is sent, the header fields and the data already
+   * appended are in the CRC */
+  if(stream->crc_started)
+  {
+    stream->crc = compute_crc(stream->vfrag->end - length, length,
+                              stream->crc);
+  }
+
+  if(stream->received_length == stream->pdu_length)
+  {
+    /* The CRC is added at the end of the PDU data if the first fragment is
+     * sent, else it is computed with the first fragment as usual */
+    if(stream->crc_started)
+    {
+      status = gse_shift_vfrag(stream->vfrag, 0, GSE_MAX_TRAILER_LENGTH);
+      if(status != GSE_STATUS_OK)
+      {
+        goto unlock;
+      }
+      crc = htonl(stream->crc);
+      memcpy(stream->vfrag->end - GSE_MAX_TRAILER_LENGTH, &crc,
+             GSE_MAX_TRAILER_LENGTH);
+    }
+    stream->complete = 1;
+    complete = 1;
+  }
+
+unlock:
+  if(pthread_mutex_unlock(&stream->mutex) != 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+  }
+  if(complete)
+  {
+    gse_encap_put_stream(stream);
+  }
+error:
+  return status;
+}
+
+gse_status_t gse_encap_abort_pdu(gse_encap_stream_t *stream)
+{
+  gse_status_t status = GSE_STATUS_OK;
+
+  if(stream == NULL)
+  {
+    status = GSE_STATUS_NULL_PTR;
+    goto error;
+  }
+
+  /* The FIFO element is dropped when it is next selected */
+  if(pthread_mutex_lock(&stream->mutex) != 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+    goto error;
+  }
+  stream->aborted = 1;
+  if(pthread_mutex_unlock(&stream->mutex) != 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+  }
+  gse_encap_put_stream(stream);
+
+error:
+  return status;
+}
+
+gse_status_t gse_encap_get_packet(gse_vfrag_t **packet, gse_encap_t *encap,
+                                  size_t length, uint8_t qos)
+{
+  return gse_encap_get_packet_common(NO_COPY, packet, NULL, encap, length,
+                                     qos);
+}
+
+gse_status_t gse_encap_get_packet_copy(gse_vfrag_t **packet, gse_encap_t *encap,
+                                       size_t length, uint8_t qos)
+{
+  return gse_encap_get_packet_common(LEGACY, packet, NULL, encap, length,
+                                     qos);
+}
+
+gse_status_t gse_encap_get_packet_no_alloc(gse_vfrag_t **packet, gse_encap_t *encap,
+                                           size_t length, uint8_t qos)
+{
+  return gse_encap_get_packet_common(NO_ALLOC, packet, NULL, encap, length,
+                                     qos);
+}
+
+gse_status_t gse_encap_get_packet_iov(gse_encap_iov_packet_t *packet,
+                                      gse_encap_t *encap,
+                                      size_t length, uint8_t qos)
+{
+  if(packet == NULL)
+  {
+    return GSE_STATUS_NULL_PTR;
+  }
+  packet->iov_nbr = 0;
+  packet->length = 0;
+  packet->chain = NULL;
+  packet->vfrag = NULL;
+  return gse_encap_get_packet_common(IOV, NULL, packet, encap, length, qos);
+}
+
+gse_status_t gse_encap_release_iov_packet(gse_encap_iov_packet_t *packet)
+{
+  gse_status_t status = GSE_STATUS_OK;
+
+  if(packet == NULL)
+  {
+    status = GSE_STATUS_NULL_PTR;
+    goto error;
+  }
+
+  if(packet->chain != NULL)
+  {
+    status = gse_free_vfrag_chain(&packet->chain);
+  }
+  else if(packet->vfrag != NULL)
+  {
+    status = gse_free_vfrag(&packet->vfrag);
+  }
+  packet->iov_nbr = 0;
+  packet->length = 0;
+
+error:
+  return status;
+}
+
+gse_status_t gse_encap_set_extension_callback(gse_encap_t *encap,
+                                              gse_encap_build_header_ext_cb_t callback,
+                                              void *opaque)
+{
+  if(encap == NULL)
+  {
+    return GSE_STATUS_NULL_PTR;
+  }
+
+  encap->build_header_ext = callback;
+  encap->opaque = opaque;
+
+  return GSE_STATUS_OK;
+}
+
+gse_status_t gse_encap_set_crc_workers(gse_encap_t *encap,
+                                       unsigned int worker_nbr,
+                                       size_t min_length)
+{
+  gse_status_t status = GSE_STATUS_OK;
+
+  gse_crc_pool_t *pool = NULL;
+  long cpu_nbr;
+
+  if(encap == NULL)
+  {
+    status = GSE_STATUS_NULL_PTR;
+    goto error;
+  }
+
+  /* The threads only save time if they run on other CPUs, the CRC32 is
+   * computed by the calling thread alone on a single CPU */
+  cpu_nbr = sysconf(_SC_NPROCESSORS_ONLN);
+  if(cpu_nbr > 0 && worker_nbr > (unsigned long)cpu_nbr)
+  {
+    worker_nbr = cpu_nbr;
+  }
+
+  /* The threads wait for the PDUs until the next call or the release of the
+   * encapsulation */
+  if(worker_nbr > 1)
+  {
+    status = gse_crc_pool_init(worker_nbr, &pool);
+    if(status != GSE_STATUS_OK)
+    {
+      goto error;
+    }
+  }
+  gse_crc_pool_release(encap->crc_pool);
+  encap->crc_pool = pool;
+  encap->crc_min_length = (min_length > 0 ? min_length :
+                           GSE_DEFAULT_CRC_MIN_LENGTH);
+
+error:
+  return status;
+}
+
+/* Flow control functions */
+
+gse_status_t gse_encap_set_watermarks(gse_encap_t *encap, uint8_t qos,
+                                      unsigned int high_pdu_nbr,
+                                      unsigned int low_pdu_nbr,
+                                      size_t high_length, size_t low_length)
+{
+  gse_status_t status = GSE_STATUS_OK;
+
+  fifo_watermark_t *watermark;
+  unsigned int modcod;
+
+  if(encap == NULL)
+  {
+    status = GSE_STATUS_NULL_PTR;
+    goto error;
+  }
+  if(qos >= encap->qos_nbr)
+  {
+    status = GSE_STATUS_INVALID_QOS;
+    goto error;
+  }
+
+  /* The modcod mutex prevents the creation of modcod FIFOs while the
+   * watermarks are applied */
+  if(pthread_mutex_lock(&encap->modcod_mutex) != 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+    goto error;
+  }
+  if(encap->watermarks == NULL)
+  {
+    status = gse_encap_alloc_watermarks(encap);
+    if(status != GSE_STATUS_OK)
+    {
+      goto unlock;
+    }
+  }
+  watermark = &encap->watermarks[qos];
+  /* The low watermark shall be below the high one so that the FIFO gets
+   * out of congestion */
+  watermark->high_elt_nbr = high_pdu_nbr;
+  watermark->low_elt_nbr = (high_pdu_nbr > 0 && low_pdu_nbr >= high_pdu_nbr ?
+                            high_pdu_nbr - 1 : low_pdu_nbr);
+  watermark->high_length = high_length;
+  watermark->low_length = (high_length > 0 && low_length >= high_length ?
+                           high_length - 1 : low_length);
+
+  status = gse_set_fifo_watermark(&encap->fifo[qos], watermark);
+  for(modcod = 0 ;
+      encap->modcod_fifo != NULL && modcod < GSE_MODCOD_NBR &&
+      status == GSE_STATUS_OK ;
+      modcod++)
+  {
+    if(encap->modcod_fifo[modcod] != NULL)
+    {
+      status = gse_set_fifo_watermark(&encap->modcod_fifo[modcod][qos],
+                                      watermark);
+    }
+  }
+
+unlock:
+  if(pthread_mutex_unlock(&encap->modcod_mutex) != 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+  }
+error:
+  return status;
+}
+
+gse_status_t gse_encap_set_watermark_callback(gse_encap_t *encap,
+                                              gse_encap_watermark_cb_t callback,
+                                              void *opaque)
+{
+  gse_status_t status = GSE_STATUS_OK;
+
+  unsigned int i;
+
+  if(encap == NULL)
+  {
+    status = GSE_STATUS_NULL_PTR;
+    goto error;
+  }
+
+  if(pthread_mutex_lock(&encap->modcod_mutex) != 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+    goto error;
+  }
+  if(encap->watermarks == NULL)
+  {
+    status = gse_encap_alloc_watermarks(encap);
+    if(status != GSE_STATUS_OK)
+    {
+      goto unlock;
+    }
+  }
+  for(i = 0 ; i < encap->qos_nbr && status == GSE_STATUS_OK ; i++)
+  {
+    status = gse_set_fifo_watermark_callback(&encap->watermarks[i], callback,
+                                             opaque);
+  }
+
+unlock:
+  if(pthread_mutex_unlock(&encap->modcod_mutex) != 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+  }
+error:
+  return status;
+}
+
+int gse_encap_is_congested(gse_encap_t *encap, uint8_t qos)
+{
+  fifo_watermark_t *watermarks;
+
+  if(encap == NULL || qos >= encap->qos_nbr)
+  {
+    return 0;
+  }
+  /* The table is never freed before the encapsulation structure */
+  watermarks = __atomic_load_n(&encap->watermarks, __ATOMIC_ACQUIRE);
+  if(watermarks == NULL)
+  {
+    return 0;
+  }
+  return __atomic_load_n(&watermarks[qos].congested, __ATOMIC_ACQUIRE);
+}
+
+/* Notification functions */
+
+gse_status_t gse_encap_get_event_fd(gse_encap_t *encap, int *fd)
+{
+  gse_status_t status = GSE_STATUS_OK;
+
+  unsigned int modcod;
+  unsigned int i;
+  int event_fd;
+
+  if(encap == NULL || fd == NULL)
+  {
+    status = GSE_STATUS_NULL_PTR;
+    goto error;
+  }
+
+  /* The modcod mutex prevents the creation of modcod FIFOs that would miss
+   * the eventfd */
+  if(pthread_mutex_lock(&encap->modcod_mutex) != 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+    goto error;
+  }
+  if(encap->event_fd < 0)
+  {
+    event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(event_fd < 0)
+    {
+      status = GSE_STATUS_EVENT_FAILED;
+      goto unlock;
+    }
+    for(i = 0 ; i < encap->qos_nbr && status == GSE_STATUS_OK ; i++)
+    {
+      status = gse_set_fifo_event_fd(&encap->fifo[i], event_fd);
+    }
+    for(modcod = 0 ;
+        encap->modcod_fifo != NULL && modcod < GSE_MODCOD_NBR ;
+        modcod++)
+    {
+      for(i = 0 ;
+          encap->modcod_fifo[modcod] != NULL && i < encap->qos_nbr &&
+          status == GSE_STATUS_OK ;
+          i++)
+      {
+        status = gse_set_fifo_event_fd(&encap->modcod_fifo[modcod][i],
+                                       event_fd);
+      }
+    }
+    /* The FIFOs keep the eventfd even on error, it is closed on release */
+    encap->event_fd = event_fd;
+    if(status != GSE_STATUS_OK)
+    {
+      goto unlock;
+    }
+  }
+  *fd = encap->event_fd;
+
+unlock:
+  if(pthread_mutex_unlock(&encap->modcod_mutex) != 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+  }
+error:
+  return status;
+}
+
+gse_status_t gse_encap_wait_pdu(gse_encap_t *encap, uint8_t qos,
+                                unsigned int timeout)
+{
+  if(encap == NULL)
+  {
+    return GSE_STATUS_NULL_PTR;
+  }
+  if(qos >= encap->qos_nbr)
+  {
+    return GSE_STATUS_INVALID_QOS;
+  }
+  return gse_wait_fifo(&encap->fifo[qos], timeout);
+}
+
+gse_status_t gse_encap_wait_pdu_modcod(gse_encap_t *encap, uint8_t modcod,
+                                       uint8_t qos, unsigned int timeout)
+{
+  gse_status_t status;
+  fifo_t *fifos;
+
+  if(encap == NULL)
+  {
+    return GSE_STATUS_NULL_PTR;
+  }
+  if(qos >= encap->qos_nbr)
+  {
+    return GSE_STATUS_INVALID_QOS;
+  }
+
+  /* The FIFOs of the group are created if no label was associated to it
+   * yet, so that the thread waits for its first PDU. They are only released
+   * with the encapsulation structure */
+  if(pthread_mutex_lock(&encap->modcod_mutex) != 0)
+  {
+    return GSE_STATUS_PTHREAD_MUTEX;
+  }
+  status = gse_encap_create_modcod_fifos(encap, modcod);
+  fifos = (status == GSE_STATUS_OK ? encap->modcod_fifo[modcod] : NULL);
+  if(pthread_mutex_unlock(&encap->modcod_mutex) != 0)
+  {
+    return GSE_STATUS_PTHREAD_MUTEX;
+  }
+  if(status != GSE_STATUS_OK)
+  {
+    return status;
+  }
+  return gse_wait_fifo(&fifos[qos], timeout);
+}
+
+/* Frame filling functions */
+
+gse_status_t gse_encap_set_fill_window(gse_encap_t *encap, unsigned int window)
+{
+  if(encap == NULL)
+  {
+    return GSE_STATUS_NULL_PTR;
+  }
+  encap->fill_window = (window > 0 ? window : 1);
+  return GSE_STATUS_OK;
+}
+
+gse_status_t gse_encap_fill_frame(gse_encap_t *encap,
+                                  gse_fill_policy_t policy,
+                                  unsigned char *frame, size_t frame_length,
+                                  size_t *data_length,
+                                  gse_frame_stats_t *stats)
+{
+  if(encap == NULL || frame == NULL || data_length == NULL)
+  {
+    return GSE_STATUS_NULL_PTR;
+  }
+  return gse_encap_fill_fifos(encap, encap->fifo, policy, frame, frame_length,
+                              data_length, stats);
+}
+
+gse_status_t gse_encap_fill_bbframe(gse_encap_t *encap,
+                                    gse_fill_policy_t policy,
+                                    const gse_bbheader_t *bbheader,
+                                    unsigned char *bbframe,
+                                    size_t bbframe_length,
+                                    size_t *data_length,
+                                    gse_frame_stats_t *stats)
+{
+  gse_status_t status;
+  gse_bbheader_t header;
+
+  if(encap == NULL || bbheader == NULL || bbframe == NULL ||
+     data_length == NULL)
+  {
+    return GSE_STATUS_NULL_PTR;
+  }
+  if(bbframe_length < GSE_BBHEADER_LENGTH ||
+     bbframe_length > GSE_MAX_BBFRAME_LENGTH)
+  {
+    return GSE_STATUS_INVALID_BBFRAME_LENGTH;
+  }
+
+  /* The GSE packets are written in place after the BBHEADER */
+  status = gse_encap_fill_fifos(encap, encap->fifo, policy,
+                                bbframe + GSE_BBHEADER_LENGTH,
+                                bbframe_length - GSE_BBHEADER_LENGTH,
+                                data_length, stats);
+
+  header = *bbheader;
+  header.dfl = *data_length * 8;
+  gse_build_bbheader(&header, bbframe);
+
+  return status;
+}
+
+/* Shaping functions */
+
+gse_status_t gse_encap_set_qos_shaper(gse_encap_t *encap, uint8_t qos,
+                                      const gse_shaper_conf_t *conf)
+{
+  gse_status_t status = GSE_STATUS_OK;
+
+  gse_shaper_t shaper;
+
+  if(encap == NULL)
+  {
+    status = GSE_STATUS_NULL_PTR;
+    goto error;
+  }
+  if(qos >= encap->qos_nbr)
+  {
+    status = GSE_STATUS_INVALID_QOS;
+    goto error;
+  }
+  if(conf != NULL)
+  {
+    status = gse_init_shaper(&shaper, conf);
+    if(status != GSE_STATUS_OK)
+    {
+      goto error;
+    }
+  }
+
+  if(pthread_mutex_lock(&encap->shaper_mutex) != 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+    goto error;
+  }
+  if(encap->qos_shapers == NULL)
+  {
+    if(conf == NULL)
+    {
+      status = GSE_STATUS_NO_SHAPER;
+      goto unlock;
+    }
+    encap->qos_shapers = calloc(encap->qos_nbr, sizeof(gse_shaper_t));
+    if(encap->qos_shapers == NULL)
+    {
+      status = GSE_STATUS_MALLOC_FAILED;
+      goto unlock;
+    }
+  }
+  if(conf == NULL)
+  {
+    if(!encap->qos_shapers[qos].used)
+    {
+      status = GSE_STATUS_NO_SHAPER;
+      goto unlock;
+    }
+    encap->qos_shapers[qos].used = 0;
+    encap->shaper_nbr--;
+  }
+  else
+  {
+    if(!encap->qos_shapers[qos].used)
+    {
+      encap->shaper_nbr++;
+    }
+    encap->qos_shapers[qos] = shaper;
+  }
+
+unlock:
+  if(pthread_mutex_unlock(&encap->shaper_mutex) != 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+  }
+error:
+  return status;
+}
+
+gse_status_t gse_encap_set_label_shaper(gse_encap_t *encap,
+                                        uint8_t label[6], uint8_t label_type,
+                                        const gse_shaper_conf_t *conf)
+{
+  gse_status_t status = GSE_STATUS_OK;
+
+  gse_shaper_t shaper;
+  gse_shaper_t *shapers;
+  uint32_t index;
+  size_t size;
+
+  if(encap == NULL)
+  {
+    status = GSE_STATUS_NULL_PTR;
+    goto error;
+  }
+  if(label == NULL && gse_get_label_length(label_type) > 0)
+  {
+    status = GSE_STATUS_NULL_PTR;
+    goto error;
+  }
+  if(conf != NULL)
+  {
+    status = gse_init_shaper(&shaper, conf);
+    if(status != GSE_STATUS_OK)
+    {
+      goto error;
+    }
+  }
+
+  if(pthread_mutex_lock(&encap->shaper_mutex) != 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+    goto error;
+  }
+  status = gse_get_label_map(&encap->shaper_map, label, label_type, &index);
+  if(status == GSE_STATUS_UNKNOWN_LABEL)
+  {
+    if(conf == NULL)
+    {
+      status = GSE_STATUS_NO_SHAPER;
+      goto unlock;
+    }
+    /* Take a free shaper, the table grows when it is full */
+    for(index = 0 ; index < encap->label_shaper_size ; index++)
+    {
+      if(!encap->label_shapers[index].used)
+      {
+        break;
+      }
+    }
+    if(index >= encap->label_shaper_size)
+    {
+      size = 2 * encap->label_shaper_size;
+      if(size < GSE_LABEL_SHAPER_MIN_SIZE)
+      {
+        size = GSE_LABEL_SHAPER_MIN_SIZE;
+      }
+      shapers = realloc(encap->label_shapers, size * sizeof(gse_shaper_t));
+      if(shapers == NULL)
+      {
+        status = GSE_STATUS_MALLOC_FAILED;
+        goto unlock;
+      }
+      memset(shapers + encap->label_shaper_size, 0,
+             (size - encap->label_shaper_size) * sizeof(gse_shaper_t));
+      encap->label_shapers = shapers;
+      encap->label_shaper_size = size;
+    }
+    status = gse_set_label_map(&encap->shaper_map, label, label_type, index);
+    if(status != GSE_STATUS_OK)
+    {
+      goto unlock;
+    }
+    encap->label_shapers[index] = shaper;
+    encap->shaper_nbr++;
+  }
+  else if(status != GSE_STATUS_OK)
+  {
+    goto unlock;
+  }
+  else if(conf == NULL)
+  {
+    status = gse_remove_label_map(&encap->shaper_map, label, label_type);
+    if(status != GSE_STATUS_OK)
+    {
+      goto unlock;
+    }
+    encap->label_shapers[index].used = 0;
+    encap->shaper_nbr--;
+  }
+  else
+  {
+    encap->label_shapers[index] = shaper;
+  }
+
+unlock:
+  if(pthread_mutex_unlock(&encap->shaper_mutex) != 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+  }
+error:
+  return status;
+}
+
+gse_status_t gse_encap_refill_shapers(gse_encap_t *encap, uint64_t now)
+{
+  uint64_t elapsed;
+  size_t i;
+
+  if(encap == NULL)
+  {
+    return GSE_STATUS_NULL_PTR;
+  }
+
+  if(pthread_mutex_lock(&encap->shaper_mutex) != 0)
+  {
+    return GSE_STATUS_PTHREAD_MUTEX;
+  }
+  /* The clock origin is given by the first call */
+  elapsed = 0;
+  if(encap->shaper_time_set && now > encap->shaper_time)
+  {
+    elapsed = now - encap->shaper_time;
+  }
+  encap->shaper_time = now;
+  encap->shaper_time_set = 1;
+
+  for(i = 0 ; encap->qos_shapers != NULL && i < encap->qos_nbr ; i++)
+  {
+    if(encap->qos_shapers[i].used)
+    {
+      gse_refill_shaper(&encap->qos_shapers[i], elapsed);
+    }
+  }
+  for(i = 0 ; i < encap->label_shaper_size ; i++)
+  {
+    if(encap->label_shapers[i].used)
+    {
+      gse_refill_shaper(&encap->label_shapers[i], elapsed);
+    }
+  }
+  if(pthread_mutex_unlock(&encap->shaper_mutex) != 0)
+  {
+    return GSE_STATUS_PTHREAD_MUTEX;
+  }
+  return GSE_STATUS_OK;
+}
+
+gse_status_t gse_encap_get_qos_shaper_state(gse_encap_t *encap, uint8_t qos,
+                                            gse_shaper_state_t *state)
+{
+  gse_status_t status = GSE_STATUS_OK;
+
+  if(encap == NULL || state == NULL)
+  {
+    return GSE_STATUS_NULL_PTR;
+  }
+  if(qos >= encap->qos_nbr)
+  {
+    return GSE_STATUS_INVALID_QOS;
+  }
+
+  if(pthread_mutex_lock(&encap->shaper_mutex) != 0)
+  {
+    return GSE_STATUS_PTHREAD_MUTEX;
+  }
+  if(encap->qos_shapers == NULL || !encap->qos_shapers[qos].used)
+  {
+    status = GSE_STATUS_NO_SHAPER;
+  }
+  else
+  {
+    gse_get_shaper_state(&encap->qos_shapers[qos], state);
+  }
+  if(pthread_mutex_unlock(&encap->shaper_mutex) != 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+  }
+  return status;
+}
+
+gse_status_t gse_encap_get_label_shaper_state(gse_encap_t *encap,
+                                              uint8_t label[6],
+                                              uint8_t label_type,
+                                              gse_shaper_state_t *state)
+{
+  gse_status_t status = GSE_STATUS_OK;
+
+  uint32_t index;
+
+  if(encap == NULL || state == NULL)
+  {
+    return GSE_STATUS_NULL_PTR;
+  }
+  if(label == NULL && gse_get_label_length(label_type) > 0)
+  {
+    return GSE_STATUS_NULL_PTR;
+  }
+
+  if(pthread_mutex_lock(&encap->shaper_mutex) != 0)
+  {
+    return GSE_STATUS_PTHREAD_MUTEX;
+  }
+  status = gse_get_label_map(&encap->shaper_map, label, label_type, &index);
+  if(status == GSE_STATUS_UNKNOWN_LABEL)
+  {
+    status = GSE_STATUS_NO_SHAPER;
+  }
+  else if(status == GSE_STATUS_OK)
+  {
+    gse_get_shaper_state(&encap->label_shapers[index], state);
+  }
+  if(pthread_mutex_unlock(&encap->shaper_mutex) != 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+  }
+  return status;
+}
+
+/* ACM functions */
+
+gse_status_t gse_encap_set_label_modcod(gse_encap_t *encap,
+                                        uint8_t label[6], uint8_t label_type,
+                                        uint8_t modcod)
+{
+  gse_status_t status = GSE_STATUS_OK;
+
+  if(encap == NULL)
+  {
+    status = GSE_STATUS_NULL_PTR;
+    goto error;
+  }
+  if(label == NULL && gse_get_label_length(label_type) > 0)
+  {
+    status = GSE_STATUS_NULL_PTR;
+    goto error;
+  }
+  /* FragID values shall be unique among the frames of all the modcods */
+  if(encap->frag_id_nbr == 0)
+  {
+    status = GSE_STATUS_FRAG_ID_POOL_REQUIRED;
+    goto error;
+  }
+
+  if(pthread_mutex_lock(&encap->modcod_mutex) != 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+    goto error;
+  }
+  /* Create the FIFOs of the modcod group with its first label */
+  status = gse_encap_create_modcod_fifos(encap, modcod);
+  if(status != GSE_STATUS_OK)
+  {
+    goto unlock;
+  }
+
+  status = gse_set_label_map(&encap->label_map, label, label_type, modcod);
+
+unlock:
+  if(pthread_mutex_unlock(&encap->modcod_mutex) != 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+  }
+error:
+  return status;
+}
+
+gse_status_t gse_encap_remove_label_modcod(gse_encap_t *encap,
+                                           uint8_t label[6],
+                                           uint8_t label_type)
+{
+  if(encap == NULL)
+  {
+    return GSE_STATUS_NULL_PTR;
+  }
+  if(label == NULL && gse_get_label_length(label_type) > 0)
+  {
+    return GSE_STATUS_NULL_PTR;
+  }
+  return gse_remove_label_map(&encap->label_map, label, label_type);
+}
+
+gse_status_t gse_encap_fill_frame_modcod(gse_encap_t *encap, uint8_t modcod,
+                                         gse_fill_policy_t policy,
+                                         unsigned char *frame,
+                                         size_t frame_length,
+                                         size_t *data_length,
+                                         gse_frame_stats_t *stats)
+{
+  fifo_t *fifos = NULL;
+
+  if(encap == NULL || frame == NULL || data_length == NULL)
+  {
+    return GSE_STATUS_NULL_PTR;
+  }
+
+  if(pthread_mutex_lock(&encap->modcod_mutex) != 0)
+  {
+    return GSE_STATUS_PTHREAD_MUTEX;
+  }
+  if(encap->modcod_fifo != NULL)
+  {
+    fifos = encap->modcod_fifo[modcod];
+  }
+  if(pthread_mutex_unlock(&encap->modcod_mutex) != 0)
+  {
+    return GSE_STATUS_PTHREAD_MUTEX;
+  }
+
+  /* No label was ever associated to the modcod */
+  if(fifos == NULL)
+  {
+    memset(frame, 0, frame_length);
+    *data_length = 0;
+    if(stats != NULL)
+    {
+      memset(stats, 0, sizeof(gse_frame_stats_t));
+      stats->padding_length = frame_length;
+    }
+    return GSE_STATUS_FIFO_EMPTY;
+  }
+  return gse_encap_fill_fifos(encap, fifos, policy, frame, frame_length,
+                              data_length, stats);
+}
+
+gse_status_t gse_encap_get_footprint(gse_encap_t *encap, size_t *footprint)
+{
+  size_t size;
+  unsigned int modcod;
+  unsigned int i;
+
+  if(encap == NULL || footprint == NULL)
+  {
+    return GSE_STATUS_NULL_PTR;
+  }
+
+  size = sizeof(gse_encap_t) + encap->qos_nbr * sizeof(fifo_t);
+  for(i = 0 ; i < encap->qos_nbr ; i++)
+  {
+    size += gse_get_fifo_footprint(&encap->fifo[i]);
+  }
+  size += gse_get_label_map_footprint(&encap->label_map);
+
+  if(pthread_mutex_lock(&encap->modcod_mutex) != 0)
+  {
+    return GSE_STATUS_PTHREAD_MUTEX;
+  }
+  if(encap->modcod_fifo != NULL)
+  {
+    size += GSE_MODCOD_NBR * sizeof(fifo_t *);
+    for(modcod = 0 ; modcod < GSE_MODCOD_NBR ; modcod++)
+    {
+      if(encap->modcod_fifo[modcod] == NULL)
+      {
+        continue;
+      }
+      size += encap->qos_nbr * sizeof(fifo_t);
+      for(i = 0 ; i < encap->qos_nbr ; i++)
+      {
+        size += gse_get_fifo_footprint(&encap->modcod_fifo[modcod][i]);
+      }
+    }
+  }
+  if(pthread_mutex_unlock(&encap->modcod_mutex) != 0)
+  {
+    return GSE_STATUS_PTHREAD_MUTEX;
+  }
+
+  if(pthread_mutex_lock(&encap->shaper_mutex) != 0)
+  {
+    return GSE_STATUS_PTHREAD_MUTEX;
+  }
+  if(encap->qos_shapers != NULL)
+  {
+    size += encap->qos_nbr * sizeof(gse_shaper_t);
+  }
+  size += encap->label_shaper_size * sizeof(gse_shaper_t);
+  size += gse_get_label_map_footprint(&encap->shaper_map);
+  if(pthread_mutex_unlock(&encap->shaper_mutex) != 0)
+  {
+    return GSE_STATUS_PTHREAD_MUTEX;
+  }
+
+  if(pthread_mutex_lock(&encap->modcod_mutex) != 0)
+  {
+    return GSE_STATUS_PTHREAD_MUTEX;
+  }
+  if(encap->watermarks != NULL)
+  {
+    size += encap->qos_nbr * sizeof(fifo_watermark_t);
+  }
+  if(pthread_mutex_unlock(&encap->modcod_mutex) != 0)
+  {
+    return GSE_STATUS_PTHREAD_MUTEX;
+  }
+
+  *footprint = size;
+  return GSE_STATUS_OK;
+}
+
+
+/****************************************************************************
+ *
+ *   PRIVATE FUNCTIONS
+ *
+ ****************************************************************************/
+
+static gse_status_t gse_encap_create_header_and_crc(gse_payload_type_t payload_type,
+                                                    unsigned char *header,
+                                                    gse_encap_t *encap,
+                                                    gse_encap_ctx_t *const encap_ctx,
+                                                    size_t length)
+{
+  gse_status_t status = GSE_STATUS_OK;
+
+  uint32_t crc;
+  gse_header_t *gse_header;
+  size_t label_length;
+  int ret;
+
+  assert(encap_ctx != NULL);
+
+  gse_header = (gse_header_t*)header;
+  status = gse_encap_set_gse_length(length, gse_header);
+  if(status != GSE_STATUS_OK)
+  {
+    goto error;
+  }
+
+  ret = gse_get_label_length(encap_ctx->label_type);
+  if(ret < 0)
+  {
+    goto error;
+  }
+  label_length = (size_t) ret;
+
+  switch(payload_type)
+  {
+    /* GSE packet carrying a complete PDU */
+    /* Header fields are S | E | LT | GSE Length | Protocol Type | Label | Ext */
+    case GSE_PDU_COMPLETE:
+      gse_header->s = 0x1;
+      gse_header->e = 0x1;
+      gse_header->lt = encap_ctx->label_type;
+      gse_header->complete_s.protocol_type = encap_ctx->protocol_type;
+      memcpy(&(gse_header->complete_s.label), &(encap_ctx->label), label_length);
+      break;
+
+    /* GSE packet carrying a first fragment of PDU */
+    /* Header fields are
+     * S | E | LT | GSE Length | FragID | Total Length | Protocol Type | Label | Ext */
+    case GSE_PDU_FIRST_FRAG:
+      gse_header->s = 0x1;
+      gse_header->e = 0x0;
+      gse_header->lt = encap_ctx->label_type;
+      gse_header->first_frag_s.frag_id = encap_ctx->frag_id;
+      gse_header->first_frag_s.total_length = htons(encap_ctx->total_length);
+      gse_header->first_frag_s.protocol_type = encap_ctx->protocol_type;
+      memcpy(&(gse_header->first_frag_s.label), &(encap_ctx->label), label_length);
+
+      /* The CRC of a PDU whose end is missing is computed on the header
+       * elements and the data already received, the rest of the data is
+       * added as it is appended */
+      if(encap_ctx->stream != NULL && !encap_ctx->stream->complete)
+      {
+        encap_ctx->stream->crc =
+          compute_crc(encap_ctx->vfrag->start + GSE_MANDATORY_FIELDS_LENGTH +
+                      GSE_FRAG_ID_LENGTH,
+                      encap_ctx->vfrag->length - GSE_MANDATORY_FIELDS_LENGTH -
+                      GSE_FRAG_ID_LENGTH,
+                      GSE_CRC_INIT);
+        encap_ctx->stream->crc_started = 1;
+        break;
+      }
+      /* The CRC of a chained PDU is sent after the segments */
+      if(encap_ctx->chain != NULL)
+      {
+        crc = gse_encap_compute_chain_crc(header, encap_ctx->chain);
+        status = gse_set_vfrag_chain_trailer(encap_ctx->chain,
+                                             (unsigned char *)&crc,
+                                             GSE_MAX_TRAILER_LENGTH);
+        break;
+      }
+      /* CRC is computed with first fragment because the complete PDU and
+       * some of its header elements are necessary */
+      crc = gse_encap_compute_crc(encap, encap_ctx->vfrag);
+      /* Add CRC at the end of the data field */
+      memcpy(encap_ctx->vfrag->end - GSE_MAX_TRAILER_LENGTH, &crc,
+             GSE_MAX_TRAILER_LENGTH);
+      break;
+
+    /* GSE packet carrying a subsequent fragment of PDU
+     * which is not the last one */
+    /* Header fields are S | E | LT | GSE Length | FragID */
+    case GSE_PDU_SUBS_FRAG:
+      gse_header->s = 0x0;
+      gse_header->e = 0x0;
+      gse_header->lt = GSE_LT_REUSE;
+      gse_header->subs_frag_s.frag_id = encap_ctx->frag_id;
+      break;
+
+    /* GSE packet carrying a last fragment of PDU */
+    /* Header fields are S | E | LT | GSE Length | FragID */
+    case GSE_PDU_LAST_FRAG:
+      gse_header->s = 0x0;
+      gse_header->e = 0x1;
+      gse_header->lt = GSE_LT_REUSE;
+      gse_header->subs_frag_s.frag_id = encap_ctx->frag_id;
+      break;
+
+    default:
+      /* Should not append */
+      assert(0);
+      status = GSE_STATUS_INTERNAL_ERROR;
+      goto error;
+  }
+error:
+  return status;
+}
+
+static uint16_t gse_encap_compute_total_length(gse_encap_ctx_t *const encap_ctx)
+{
+  uint16_t total_length;
+  size_t pdu_length;
+  assert(encap_ctx != NULL);
+  /* The data of a PDU received in chunks may not be there yet */
+  if(encap_ctx->stream != NULL)
+  {
+    pdu_length = encap_ctx->stream->pdu_length;
+  }
+  else if(encap_ctx->chain != NULL)
+  {
+    pdu_length = encap_ctx->chain->length - encap_ctx->chain_offset;
+  }
+  else
+  {
+    pdu_length = encap_ctx->vfrag->length;
+  }
+  total_length = gse_get_label_length(encap_ctx->label_type)
+                 + GSE_PROTOCOL_TYPE_LENGTH
+                 + pdu_length;
+  return total_length;
+}
+
+static gse_status_t gse_encap_set_gse_length(size_t packet_length,
+                                             gse_header_t *header)
+{
+  gse_status_t status = GSE_STATUS_OK;
+
+  uint16_t gse_length;
+
+  assert(header != NULL);
+  /* GSE Length take into account all the fields following it */
+  gse_length = packet_length - GSE_MANDATORY_FIELDS_LENGTH;
+  /* GSE Length field contain 12 bits */
+  if(gse_length > 0xFFF)
+  {
+    status = GSE_STATUS_LENGTH_TOO_HIGH;
+    goto error;
+  }
+
+  header->gse_length_hi = (gse_length >> 8) & 0x0F;
+  header->gse_length_lo = gse_length & 0xFF;
+
+error:
+  return status;
+}
+
+static size_t gse_encap_compute_packet_length(size_t desired_length,
+                                              size_t remaining_data_length,
+                                              size_t header_length)
+{
+  size_t packet_length;
+
+  packet_length = MIN(desired_length, GSE_MAX_PACKET_LENGTH);
+  packet_length = MIN(packet_length, remaining_data_length + header_length);
+  /* Avoid fragmentation of CRC field between 2 GSE fragments:
+   * if the computed packet length is too short by less than 4 bytes to contain
+   * the whole remaining part of the PDU and the CRC, then reduce the packet
+   * length so that the 4-bytes CRC is left for the next fragment */
+  if((packet_length < remaining_data_length + header_length) &&
+     ((remaining_data_length + header_length - packet_length)
+       < GSE_MAX_TRAILER_LENGTH))
+  {
+    packet_length = remaining_data_length - GSE_MAX_TRAILER_LENGTH +
+                    header_length;
+  }
+
+  return packet_length;
+}
+
+static uint32_t gse_encap_compute_crc(gse_encap_t *encap, gse_vfrag_t *vfrag)
+{
+  uint32_t crc;
+  unsigned char *data;
+  size_t length;
+
+  /* CRC is computed with complete PDU, Total length, Protocol Type and Label */
+  data = vfrag->start + GSE_MANDATORY_FIELDS_LENGTH + GSE_FRAG_ID_LENGTH;
+  length = vfrag->length -
+          (GSE_MANDATORY_FIELDS_LENGTH + GSE_FRAG_ID_LENGTH + GSE_MAX_TRAILER_LENGTH);
+  if(encap->crc_pool != NULL && length >= encap->crc_min_length)
+  {
+    crc = compute_crc_parallel(encap->crc_pool, data, length, GSE_CRC_INIT);
+  }
+  else
+  {
+    crc = compute_crc(data, length, GSE_CRC_INIT);
+  }
+
+  return htonl(crc);
+}
+
+static uint32_t gse_encap_compute_chain_crc(unsigned char *header,
+                                            gse_vfrag_chain_t *chain)
+{
+  uint32_t crc;
+  size_t header_length;
+  unsigned int i;
+
+  /* CRC is computed with Total length, Protocol Type, Label and the
+   * segments in order */
+  header_length = gse_compute_header_length(GSE_PDU_FIRST_FRAG,
+                                            ((gse_header_t *)header)->lt);
+  crc = compute_crc(header + GSE_MANDATORY_FIELDS_LENGTH + GSE_FRAG_ID_LENGTH,
+                    header_length - GSE_MANDATORY_FIELDS_LENGTH -
+                    GSE_FRAG_ID_LENGTH,
+                    GSE_CRC_INIT);
+  for(i = 0 ; i < chain->seg_nbr ; i++)
+  {
+    crc = compute_crc(chain->segments[i]->start, chain->segments[i]->length,
+                      crc);
+  }
+
+  return htonl(crc);
+}
+
+static gse_status_t gse_encap_flatten_ctx(gse_encap_ctx_t *encap_ctx)
+{
+  gse_status_t status = GSE_STATUS_OK;
+
+  gse_vfrag_t *vfrag;
+  size_t length;
+
+  /* Keep room for the header extensions of a first fragment */
+  length = encap_ctx->chain->length - encap_ctx->chain_offset;
+  status = gse_create_vfrag(&vfrag, length,
+                            GSE_MAX_HEADER_LENGTH + GSE_MAX_EXT_LENGTH,
+                            GSE_MAX_TRAILER_LENGTH);
+  if(status != GSE_STATUS_OK)
+  {
+    goto error;
+  }
+  status = gse_copy_vfrag_chain(encap_ctx->chain, encap_ctx->chain_offset,
+                                length, vfrag->start);
+  if(status != GSE_STATUS_OK)
+  {
+    goto free_vfrag;
+  }
+
+  gse_free_vfrag_chain(&encap_ctx->chain);
+  encap_ctx->chain_offset = 0;
+  encap_ctx->vfrag = vfrag;
+  encap_ctx->vfrag_alloc = 1;
+
+  return status;
+
+free_vfrag:
+  gse_free_vfrag(&vfrag);
+error:
+  return status;
+}
+
+static gse_status_t gse_encap_get_packet_common(int mode, gse_vfrag_t **packet,
+                                                gse_encap_iov_packet_t *iov_packet,
+                                                gse_encap_t *encap,
+                                                size_t desired_length,
+                                                uint8_t qos)
+{
+  gse_status_t status = GSE_STATUS_OK;
+
+  int elt_nbr;
+  unsigned int index;
+  gse_encap_ctx_t* encap_ctx;
+  gse_shaper_color_t color;
+
+  if((mode != IOV && packet == NULL) || (mode == IOV && iov_packet == NULL))
+  {
+    status = GSE_STATUS_NULL_PTR;
+    goto error;
+  }
+
+  /* Check parameters */
+  if(encap == NULL)
+  {
+    status = GSE_STATUS_NULL_PTR;
+    goto packet_null;
+  }
+  if(qos >= encap->qos_nbr)
+  {
+    status = GSE_STATUS_INVALID_QOS;
+    goto packet_null;
+  }
+
+  /* Check if there are elements for the specified QoS */
+  elt_nbr = gse_get_fifo_elt_nbr(&encap->fifo[qos]);
+  if(elt_nbr == 0)
+  {
+    status = GSE_STATUS_FIFO_EMPTY;
+    goto packet_null;
+  }
+  else if(elt_nbr < 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+    goto packet_null;
+  }
+
+  /* If the desired length = 0, then use the maximum possible value */
+  if(desired_length == 0)
+  {
+    desired_length = GSE_MAX_PACKET_LENGTH;
+  }
+  if(desired_length > GSE_MAX_PACKET_LENGTH)
+  {
+    status = GSE_STATUS_LENGTH_TOO_HIGH;
+    goto packet_null;
+  }
+  if(desired_length < GSE_MIN_PACKET_LENGTH)
+  {
+    status = GSE_STATUS_LENGTH_TOO_SMALL;
+    goto packet_null;
+  }
+  /* An aborted PDU is dropped when selected, try the next one */
+  do
+  {
+    status = gse_encap_select_ctx(encap, &encap->fifo[qos], desired_length,
+                                  GSE_SHAPER_RED, &index, &encap_ctx, &color);
+    if(status != GSE_STATUS_OK)
+    {
+      goto packet_null;
+    }
+
+    status = gse_encap_build_packet(mode, packet, NULL, iov_packet, encap,
+                                    desired_length, &encap->fifo[qos], index,
+                                    encap_ctx, NULL, NULL);
+  }
+  while(status == GSE_STATUS_PDU_ABORTED);
+
+  return status;
+
+packet_null:
+  if(mode != NO_ALLOC && mode != IOV)
+  {
+    *packet = NULL;
+  }
+error:
+  return status;
+}
+
+static gse_status_t gse_encap_build_packet(int mode, gse_vfrag_t **packet,
+                                           unsigned char *buffer,
+                                           gse_encap_iov_packet_t *iov_packet,
+                                           gse_encap_t *encap,
+                                           size_t desired_length,
+                                           fifo_t *fifo, unsigned int index,
+                                           gse_encap_ctx_t *encap_ctx,
+                                           size_t *packet_length,
+                                           gse_frame_stats_t *stats)
+{
+  gse_status_t status = GSE_STATUS_OK;
+
+  size_t remaining_data_length;
+  size_t header_length;
+  gse_payload_type_t payload_type;
+  unsigned char *extensions = NULL;
+  size_t tot_ext_length = 0;
+  size_t length;
+  gse_encap_stream_t *stream;
+  gse_vfrag_chain_t *chain;
+  unsigned char chain_header[GSE_MAX_HEADER_LENGTH];
+  unsigned char *header;
+  size_t reach = 0;
+  int partial = 0;
+  int limited = 0;
+  int removed = 0;
+
+  assert(encap != NULL);
+  assert(encap_ctx != NULL);
+  assert(mode != FRAME || buffer != NULL);
+  assert(mode != IOV || iov_packet != NULL);
+
+  /* The data of a PDU received in chunks is appended while the packet is
+   * built, the stream is kept until the element is removed */
+  stream = encap_ctx->stream;
+  if(stream != NULL)
+  {
+    if(pthread_mutex_lock(&stream->mutex) != 0)
+    {
+      status = GSE_STATUS_PTHREAD_MUTEX;
+      /* The stream is not locked */
+      stream = NULL;
+      goto packet_null;
+    }
+    if(stream->aborted)
+    {
+      status = gse_encap_remove_ctx(mode, encap, fifo, index, encap_ctx);
+      if(status == GSE_STATUS_OK)
+      {
+        removed = 1;
+        status = GSE_STATUS_PDU_ABORTED;
+      }
+      goto no_packet;
+    }
+    /* The PDU is fragmented until its end is received */
+    partial = !stream->complete;
+  }
+
+  /* The packets of a chained PDU refer to the segments or are copied from
+   * them, the PDU is copied in one buffer for the modes sharing the buffer
+   * with the packets and for the header extensions */
+  chain = encap_ctx->chain;
+  if(chain != NULL &&
+     (mode == NO_COPY || mode == NO_ALLOC ||
+      (encap_ctx->frag_nbr == 0 && encap->build_header_ext != NULL)))
+  {
+    status = gse_encap_flatten_ctx(encap_ctx);
+    if(status != GSE_STATUS_OK)
+    {
+      goto packet_null;
+    }
+    chain = NULL;
+  }
+
+  if(chain != NULL)
+  {
+    remaining_data_length = chain->length - encap_ctx->chain_offset;
+  }
+  else
+  {
+    remaining_data_length = encap_ctx->vfrag->length;
+  }
+
+  /* A packet refers to a limited number of segments, the PDU is fragmented
+   * if they do not hold the remaining data */
+  if(chain != NULL && mode == IOV)
+  {
+    status = gse_get_vfrag_chain_iov(chain, encap_ctx->chain_offset,
+                                     remaining_data_length,
+                                     iov_packet->iov + 1,
+                                     GSE_ENCAP_IOV_MAX - 1,
+                                     &iov_packet->iov_nbr, &reach);
+    if(status != GSE_STATUS_OK)
+    {
+      goto packet_null;
+    }
+    limited = (reach < remaining_data_length);
+  }
+
+  /* The next chunk of a PDU received in chunks may be missing, else there
+   * should always been data because free fragment are removed from the FIFO
+   * at the end of this function */
+  if(remaining_data_length <= 0 && partial)
+  {
+    status = GSE_STATUS_PDU_NOT_READY;
+    goto packet_null;
+  }
+  assert(remaining_data_length > 0);
+  if(remaining_data_length <= 0)
+  {
+    status = GSE_STATUS_INTERNAL_ERROR;
+    goto packet_null;
+  }
+
+  /* There is a complete PDU in the context */
+  if(encap_ctx->frag_nbr == 0)
+  {
+    uint16_t ext_type = 0;
+    size_t total_length = encap_ctx->total_length;
+
+    tot_ext_length = 0;
+    /* Check if we need extensions, they are added to the PDU once the packet
+     * is known to be built so they are built again if the PDU waits for a
+     * larger packet */
+    if(encap->build_header_ext != NULL)
+    {
+      int ret;
+      uint16_t proto;
+
+      extensions = calloc(GSE_MAX_EXT_LENGTH, sizeof(unsigned char));
+      if(extensions == NULL)
+      {
+        status = GSE_STATUS_MALLOC_FAILED;
+        goto packet_null;
+      }
+      tot_ext_length = GSE_MAX_EXT_LENGTH;
+      ret = encap->build_header_ext(extensions, &tot_ext_length, &ext_type,
+                                    ntohs(encap_ctx->protocol_type),
+                                    encap->opaque);
+      if(ret < 0)
+      {
+        status = GSE_STATUS_EXTENSION_CB_FAILED;
+        goto packet_null;
+      }
+
+      status = gse_check_header_extension_validity(extensions,
+                                                   &tot_ext_length,
+                                                   ext_type,
+                                                   &proto);
+      if(status != GSE_STATUS_OK)
+      {
+        goto packet_null;
+      }
+      if(proto != ntohs(encap_ctx->protocol_type))
+      {
+        status = GSE_STATUS_INVALID_EXTENSIONS;
+        goto packet_null;
+      }
+      total_length = gse_encap_compute_total_length(encap_ctx);
+    }
+
+    /* Total length field shall be < 65536 */
+    if(total_length + tot_ext_length > GSE_MAX_PDU_LENGTH)
+    {
+      status = GSE_STATUS_PDU_LENGTH;
+      goto packet_null;
+    }
+    /* update remaining data length (consider extensions as data) */
+    remaining_data_length += tot_ext_length;
+
+    /* Can the PDU be completely encapsulated ? */
+    header_length = gse_compute_header_length(GSE_PDU_COMPLETE, encap_ctx->label_type);
+    if(header_length == 0)
+    {
+      status = GSE_STATUS_INTERNAL_ERROR;
+      goto packet_null;
+    }
+    if(!partial && !limited &&
+       desired_length >= (remaining_data_length + header_length))
+    {
+      payload_type = GSE_PDU_COMPLETE;
+    }
+    else
+    {
+      header_length = gse_compute_header_length(GSE_PDU_FIRST_FRAG,
+                                                encap_ctx->label_type);
+      if(header_length == 0)
+      {
+        status = GSE_STATUS_INTERNAL_ERROR;
+        goto packet_null;
+      }
+      payload_type = GSE_PDU_FIRST_FRAG;
+      /* Check if wanted length allows 1 bit of data */
+      if((header_length + 1) > desired_length)
+      {
+        status = GSE_STATUS_LENGTH_TOO_SMALL;
+        goto packet_null;
+      }
+    }
+
+    /* move the start pointer in the buffer and add extensions, a chained
+     * PDU has no extensions */
+    if(tot_ext_length > 0)
+    {
+      status = gse_shift_vfrag(encap_ctx->vfrag, tot_ext_length * -1, 0);
+      if(status != GSE_STATUS_OK)
+      {
+        goto packet_null;
+      }
+      memcpy(encap_ctx->vfrag->start, extensions, tot_ext_length);
+    }
+    /* update the context protocol type with the extension type and the
+     * total length */
+    if(encap->build_header_ext != NULL)
+    {
+      encap_ctx->protocol_type = htons(ext_type);
+    }
+    encap_ctx->total_length = total_length + tot_ext_length;
+  }
+  /* There is a PDU fragment in the context */
+  else
+  {
+    header_length = gse_compute_header_length(GSE_PDU_SUBS_FRAG, encap_ctx->label_type);
+    if(header_length == 0)
+    {
+      status = GSE_STATUS_INTERNAL_ERROR;
+      goto packet_null;
+    }
+    /* Is this the last fragment ? */
+    if(!partial && !limited &&
+       desired_length >= (remaining_data_length + header_length))
+    {
+      payload_type = GSE_PDU_LAST_FRAG;
+      /* Check if complete CRC can be sent */
+      if((header_length + GSE_MAX_TRAILER_LENGTH) > desired_length)
+      {
+        status = GSE_STATUS_LENGTH_TOO_SMALL;
+        goto packet_null;
+      }
+    }
+    else
+    {
+      payload_type = GSE_PDU_SUBS_FRAG;
+      /* Check if wanted length allows 1 bit of data */
+      if((header_length + 1) > desired_length)
+      {
+        status = GSE_STATUS_LENGTH_TOO_SMALL;
+        goto packet_null;
+      }
+    }
+  }
+
+  /* Compute the amount of PDU bytes that is encapsulated in the GSE packet we
+   * are building, the CRC of a PDU whose end is missing is not in the data
+   * yet */
+  if(partial)
+  {
+    desired_length = MIN(desired_length, GSE_MAX_PACKET_LENGTH);
+    desired_length = MIN(desired_length, remaining_data_length + header_length);
+  }
+  else if(limited)
+  {
+    desired_length = MIN(desired_length, GSE_MAX_PACKET_LENGTH);
+    desired_length = MIN(desired_length, reach + header_length);
+  }
+  else
+  {
+    desired_length = gse_encap_compute_packet_length(desired_length,
+                                                     remaining_data_length,
+                                                     header_length);
+  }
+
+  /* The header of a packet of a chained PDU is built apart */
+  if(chain != NULL)
+  {
+    header = (mode == IOV ? iov_packet->header : chain_header);
+  }
+  /* Make room for the GSE header at the beginning of the PDU data and - if the
+   * GSE packet is a first fragment - for the CRC at the end of the PDU data */
+  else if(payload_type == GSE_PDU_FIRST_FRAG && !partial)
+  {
+    /* TODO reallocate if not enough space due to extensions instead of 
+     *      an error ? */
+    status = gse_shift_vfrag(encap_ctx->vfrag, header_length * -1,
+                             GSE_MAX_TRAILER_LENGTH);
+  }
+  else
+  {
+    status = gse_shift_vfrag(encap_ctx->vfrag, header_length * -1, 0);
+  }
+  if(status != GSE_STATUS_OK)
+  {
+    goto packet_null;
+  }
+  if(chain == NULL)
+  {
+    header = encap_ctx->vfrag->start;
+  }
+
+  status = gse_encap_create_header_and_crc(payload_type, header, encap,
+                                           encap_ctx, desired_length);
+  if(status != GSE_STATUS_OK)
+  {
+    goto packet_null;
+  }
+
+  /* Code depending on copy parameter, the packet of a chained PDU is its
+   * header followed by the data of the segments */
+  switch(mode)
+  {
+    case FRAME:
+      /* Copy the packet in the frame */
+      if(chain != NULL)
+      {
+        memcpy(buffer, header, header_length);
+        status = gse_copy_vfrag_chain(chain, encap_ctx->chain_offset,
+                                      desired_length - header_length,
+                                      buffer + header_length);
+        break;
+      }
+      memcpy(buffer, encap_ctx->vfrag->start, desired_length);
+      break;
+    case LEGACY:
+      /* Create a new fragment */
+      if(chain != NULL)
+      {
+        status = gse_create_vfrag(packet, desired_length, encap->head_offset,
+                                  encap->trail_offset);
+        if(status != GSE_STATUS_OK)
+        {
+          break;
+        }
+        memcpy((*packet)->start, header, header_length);
+        status = gse_copy_vfrag_chain(chain, encap_ctx->chain_offset,
+                                      desired_length - header_length,
+                                      (*packet)->start + header_length);
+        if(status != GSE_STATUS_OK)
+        {
+          gse_free_vfrag(packet);
+        }
+        break;
+      }
+      status = gse_create_vfrag_with_data(packet, desired_length,
+                                          encap->head_offset,
+                                          encap->trail_offset,
+                                          encap_ctx->vfrag->start,
+                                          desired_length);
+      break;
+    case NO_COPY:
+      /* Duplicate the fragment */
+      status = gse_duplicate_vfrag(packet, encap_ctx->vfrag, desired_length);
+      break;
+    case NO_ALLOC:
+      /* Duplicate the fragment - no allocation */
+      status = gse_duplicate_vfrag_no_alloc(packet, encap_ctx->vfrag, desired_length);
+      break;
+    case IOV:
+      /* Refer to the segments, the chain is kept until the packet is
+       * released */
+      if(chain != NULL)
+      {
+        iov_packet->iov[0].iov_base = header;
+        iov_packet->iov[0].iov_len = header_length;
+        status = gse_get_vfrag_chain_iov(chain, encap_ctx->chain_offset,
+                                         desired_length - header_length,
+                                         iov_packet->iov + 1,
+                                         GSE_ENCAP_IOV_MAX - 1,
+                                         &iov_packet->iov_nbr, &length);
+        if(status != GSE_STATUS_OK)
+        {
+          break;
+        }
+        assert(length == desired_length - header_length);
+        iov_packet->iov_nbr++;
+        iov_packet->length = desired_length;
+        status = gse_hold_vfrag_chain(chain);
+        iov_packet->chain = chain;
+        break;
+      }
+      /* Duplicate the fragment */
+      status = gse_duplicate_vfrag(&iov_packet->vfrag, encap_ctx->vfrag,
+                                   desired_length);
+      if(status != GSE_STATUS_OK)
+      {
+        break;
+      }
+      iov_packet->iov[0].iov_base = iov_packet->vfrag->start;
+      iov_packet->iov[0].iov_len = desired_length;
+      iov_packet->iov_nbr = 1;
+      iov_packet->length = desired_length;
+      break;
+  }
+  if(status != GSE_STATUS_OK)
+  {
+    goto packet_null;
+  }
+
+  length = desired_length;
+  if(stats != NULL)
+  {
+    size_t ext_length = 0;
+    size_t crc_length = 0;
+
+    /* Extensions are the first data of the first packet */
+    if(encap_ctx->frag_nbr == 0)
+    {
+      ext_length = MIN(tot_ext_length, length - header_length);
+    }
+    if(payload_type == GSE_PDU_LAST_FRAG)
+    {
+      crc_length = GSE_MAX_TRAILER_LENGTH;
+    }
+    stats->packet_nbr++;
+    if(payload_type != GSE_PDU_COMPLETE)
+    {
+      stats->fragment_nbr++;
+    }
+    stats->header_length += header_length + ext_length;
+    stats->crc_length += crc_length;
+    stats->payload_length += length - header_length - ext_length - crc_length;
+  }
+
+  encap_ctx->frag_nbr++;
+  /* The packet is accounted in the flow of the PDU before it may be removed */
+  status = gse_charge_fifo_flow(fifo, encap_ctx->flow, length);
+  if(status != GSE_STATUS_OK)
+  {
+    goto free_packet;
+  }
+  /* Remove copied or duplicated data from the initial fragment */
+  if(chain != NULL)
+  {
+    encap_ctx->chain_offset += length - header_length;
+    remaining_data_length = chain->length - encap_ctx->chain_offset;
+  }
+  else
+  {
+    status = gse_shift_vfrag(encap_ctx->vfrag, length, 0);
+    if(status != GSE_STATUS_OK)
+    {
+      goto free_packet;
+    }
+    remaining_data_length = encap_ctx->vfrag->length;
+  }
+
+  /* Go to the next FIFO element if the initial fragment is empty and if no
+   * more data will be appended to it */
+  if(remaining_data_length <= 0 && !partial)
+  {
+    status = gse_encap_remove_ctx(mode, encap, fifo, index, encap_ctx);
+    if(status != GSE_STATUS_OK)
+    {
+      goto free_packet;
+    }
+    removed = (stream != NULL);
+  }
+
+  if(extensions != NULL)
+  {
+    free(extensions);
+  }
+  if(packet_length != NULL)
+  {
+    *packet_length = length;
+  }
+  goto unlock;
+free_packet:
+  if(mode == NO_ALLOC)
+  {
+    gse_free_vfrag_no_alloc(packet, 1, 0);
+  }
+  else if(mode == IOV)
+  {
+    gse_encap_release_iov_packet(iov_packet);
+  }
+  else if(mode != FRAME)
+  {
+    gse_free_vfrag(packet);
+  }
+packet_null:
+  if(extensions != NULL)
+  {
+    free(extensions);
+  }
+  /* Do not keep a FragID for a PDU whose fragmentation has not started */
+  if(encap_ctx->frag_nbr == 0 && encap_ctx->frag_id_alloc)
+  {
+    gse_encap_release_frag_id(encap, encap_ctx->frag_id);
+    encap_ctx->frag_id_alloc = 0;
+  }
+no_packet:
+  if(mode == IOV)
+  {
+    iov_packet->iov_nbr = 0;
+  }
+  else if(mode != NO_ALLOC && mode != FRAME)
+  {
+    *packet = NULL;
+  }
+unlock:
+  if(stream != NULL)
+  {
+    if(pthread_mutex_unlock(&stream->mutex) != 0)
+    {
+      status = GSE_STATUS_PTHREAD_MUTEX;
+    }
+    if(removed)
+    {
+      gse_encap_put_stream(stream);
+    }
+  }
+  return status;
+}
+
+static gse_status_t gse_encap_alloc_frag_id(gse_encap_t *encap,
+                                            uint8_t *frag_id)
+{
+  gse_status_t status = GSE_STATUS_FRAG_ID_EXHAUSTED;
+
+  unsigned int i;
+
+  assert(encap != NULL);
+  assert(frag_id != NULL);
+
+  if(pthread_mutex_lock(&encap->frag_id_mutex) != 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+    goto error;
+  }
+  for(i = 0 ; i < encap->frag_id_nbr ; i++)
+  {
+    if((encap->frag_id_used[i / 32] & (1U << (i % 32))) == 0)
+    {
+      encap->frag_id_used[i / 32] |= (1U << (i % 32));
+      *frag_id = i;
+      status = GSE_STATUS_OK;
+      break;
+    }
+  }
+  if(pthread_mutex_unlock(&encap->frag_id_mutex) != 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+  }
+
+error:
+  return status;
+}
+
+static gse_status_t gse_encap_release_frag_id(gse_encap_t *encap,
+                                              uint8_t frag_id)
+{
+  gse_status_t status = GSE_STATUS_OK;
+
+  assert(encap != NULL);
+
+  if(pthread_mutex_lock(&encap->frag_id_mutex) != 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+    goto error;
+  }
+  encap->frag_id_used[frag_id / 32] &= ~(1U << (frag_id % 32));
+  if(pthread_mutex_unlock(&encap->frag_id_mutex) != 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+  }
+
+error:
+  return status;
+}
+
+static gse_status_t gse_encap_take_frag_id(gse_encap_t *encap,
+                                           uint8_t frag_id)
+{
+  gse_status_t status = GSE_STATUS_OK;
+
+  assert(encap != NULL);
+
+  if(pthread_mutex_lock(&encap->frag_id_mutex) != 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+    goto error;
+  }
+  encap->frag_id_used[frag_id / 32] |= (1U << (frag_id % 32));
+  if(pthread_mutex_unlock(&encap->frag_id_mutex) != 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+  }
+
+error:
+  return status;
+}
+
+static gse_status_t gse_encap_is_frag_id_used(gse_encap_t *encap,
+                                              uint8_t frag_id, int *used)
+{
+  gse_status_t status = GSE_STATUS_OK;
+
+  assert(encap != NULL);
+  assert(used != NULL);
+
+  if(pthread_mutex_lock(&encap->frag_id_mutex) != 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+    goto error;
+  }
+  *used = ((encap->frag_id_used[frag_id / 32] & (1U << (frag_id % 32))) != 0);
+  if(pthread_mutex_unlock(&encap->frag_id_mutex) != 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+  }
+
+error:
+  return status;
+}
+
+static gse_status_t gse_encap_select_ctx(gse_encap_t *encap, fifo_t *fifo,
+                                         size_t desired_length,
+                                         gse_shaper_color_t max_color,
+                                         unsigned int *index,
+                                         gse_encap_ctx_t **encap_ctx,
+                                         gse_shaper_color_t *color)
+{
+  gse_status_t status = GSE_STATUS_OK;
+
+  gse_encap_ctx_t *ctx;
+  size_t header_length;
+  size_t length;
+  unsigned int window;
+  unsigned int in_frag_nbr = 0;
+  int oldest_frag = -1;
+  int fit = -1;
+  int shortest = -1;
+  size_t shortest_length = 0;
+  int complete;
+  int elt_nbr;
+  int limited = 0;
+  int shaping;
+  unsigned int i;
+  uint8_t frag_id;
+  gse_shaper_color_t ctx_color = GSE_SHAPER_GREEN;
+  gse_shaper_color_t frag_color = GSE_SHAPER_GREEN;
+  gse_shaper_color_t fit_color = GSE_SHAPER_GREEN;
+  gse_shaper_color_t shortest_color = GSE_SHAPER_GREEN;
+
+  assert(encap != NULL);
+  assert(index != NULL);
+  assert(encap_ctx != NULL);
+  assert(color != NULL);
+
+  assert(fifo != NULL);
+
+  *index = 0;
+  *color = GSE_SHAPER_GREEN;
+  shaping = (encap->shaper_nbr > 0 && max_color < GSE_SHAPER_RED);
+
+  /* The flows are served in turn when fair queuing is enabled, otherwise the
+   * QoS value is the FragID and the first PDU is served */
+  if(encap->flow_nbr > 0 || encap->frag_id_nbr == 0)
+  {
+    if(encap->flow_nbr > 0)
+    {
+      status = gse_encap_select_flow(encap, fifo, desired_length, index,
+                                     encap_ctx);
+    }
+    else
+    {
+      status = gse_get_fifo_elt_at(fifo, 0, encap_ctx);
+    }
+    if(status == GSE_STATUS_OK || status == GSE_STATUS_PDU_NOT_READY)
+    {
+      status = gse_encap_select_unheld(encap, fifo, desired_length, max_color,
+                                       index, encap_ctx, color);
+    }
+    goto error;
+  }
+
+  elt_nbr = gse_get_fifo_elt_nbr(fifo);
+  if(elt_nbr < 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+    goto error;
+  }
+  window = MIN((unsigned int)elt_nbr, encap->frag_window);
+  if(window == 0)
+  {
+    status = GSE_STATUS_FIFO_EMPTY;
+    goto error;
+  }
+
+  /* Look for the PDUs in fragmentation, for the first PDU that can be
+   * completely sent in the packet and for the PDU with the least remaining
+   * data, the PDUs waiting for data are skipped */
+  for(i = 0 ; i < window ; i++)
+  {
+    status = gse_get_fifo_elt_at(fifo, i, &ctx);
+    if(status != GSE_STATUS_OK)
+    {
+      goto error;
+    }
+    if(ctx->frag_nbr > 0)
+    {
+      in_frag_nbr++;
+    }
+    status = gse_encap_get_ctx_data(ctx, &length, &complete);
+    if(status != GSE_STATUS_OK)
+    {
+      goto error;
+    }
+    if(length == 0 && !complete)
+    {
+      continue;
+    }
+    if(shaping)
+    {
+      status = gse_encap_get_color(encap, ctx, &ctx_color);
+      if(status != GSE_STATUS_OK)
+      {
+        goto error;
+      }
+      if(ctx_color > max_color)
+      {
+        status = gse_encap_hold_ctx(encap, ctx, ctx_color);
+        if(status != GSE_STATUS_OK)
+        {
+          goto error;
+        }
+        limited = 1;
+        continue;
+      }
+    }
+    if(shortest < 0 || length < shortest_length)
+    {
+      shortest = i;
+      shortest_length = length;
+      shortest_color = ctx_color;
+    }
+    if(ctx->frag_nbr > 0)
+    {
+      if(oldest_frag < 0)
+      {
+        oldest_frag = i;
+        frag_color = ctx_color;
+      }
+      header_length = gse_compute_header_length(GSE_PDU_SUBS_FRAG,
+                                                ctx->label_type);
+    }
+    else if(encap->build_header_ext == NULL)
+    {
+      header_length = gse_compute_header_length(GSE_PDU_COMPLETE,
+                                                ctx->label_type);
+    }
+    else
+    {
+      /* The extensions length is unknown before calling the callback */
+      continue;
+    }
+    if(header_length == 0)
+    {
+      status = GSE_STATUS_INTERNAL_ERROR;
+      goto error;
+    }
+    if(fit < 0 && complete && (length + header_length) <= desired_length)
+    {
+      fit = i;
+      fit_color = ctx_color;
+    }
+  }
+  if(shortest < 0)
+  {
+    status = (limited ? GSE_STATUS_RATE_LIMITED : GSE_STATUS_PDU_NOT_READY);
+    goto error;
+  }
+
+  /* A PDU in fragmentation that was skipped too many times is served first,
+   * then a PDU that ends in the packet, then the PDU with the least remaining
+   * data */
+  if(oldest_frag >= 0)
+  {
+    status = gse_get_fifo_elt_at(fifo, oldest_frag, &ctx);
+    if(status != GSE_STATUS_OK)
+    {
+      goto error;
+    }
+  }
+  if(oldest_frag >= 0 && ctx->skip_nbr >= encap->frag_window)
+  {
+    *index = oldest_frag;
+    *color = frag_color;
+  }
+  else if(fit >= 0)
+  {
+    *index = fit;
+    *color = fit_color;
+  }
+  else
+  {
+    *index = shortest;
+    *color = shortest_color;
+  }
+
+  status = gse_get_fifo_elt_at(fifo, *index, &ctx);
+  if(status != GSE_STATUS_OK)
+  {
+    goto error;
+  }
+
+  /* A new PDU that may be fragmented needs a FragID */
+  if(ctx->frag_nbr == 0 && (int)*index != fit)
+  {
+    if(in_frag_nbr >= encap->frag_window)
+    {
+      status = GSE_STATUS_FRAG_ID_EXHAUSTED;
+    }
+    else
+    {
+      status = gse_encap_alloc_frag_id(encap, &frag_id);
+    }
+    if(status == GSE_STATUS_OK)
+    {
+      ctx->frag_id = frag_id;
+      ctx->frag_id_alloc = 1;
+    }
+    else if(status == GSE_STATUS_FRAG_ID_EXHAUSTED && oldest_frag >= 0)
+    {
+      /* Go on with a PDU in fragmentation instead */
+      *index = oldest_frag;
+      *color = frag_color;
+      status = GSE_STATUS_OK;
+    }
+    else
+    {
+      goto error;
+    }
+  }
+
+  /* Age the PDUs in fragmentation that are not served */
+  for(i = 0 ; i < window ; i++)
+  {
+    status = gse_get_fifo_elt_at(fifo, i, &ctx);
+    if(status != GSE_STATUS_OK)
+    {
+      goto error;
+    }
+    if(i == *index)
+    {
+      ctx->skip_nbr = 0;
+      *encap_ctx = ctx;
+    }
+    else if(ctx->frag_nbr > 0)
+    {
+      ctx->skip_nbr++;
+    }
+  }
+
+error:
+  return status;
+}
+
+static gse_status_t gse_encap_select_unheld(gse_encap_t *encap, fifo_t *fifo,
+                                            size_t desired_length,
+                                            gse_shaper_color_t max_color,
+                                            unsigned int *index,
+                                            gse_encap_ctx_t **encap_ctx,
+                                            gse_shaper_color_t *color)
+{
+  gse_status_t status = GSE_STATUS_OK;
+
+  gse_encap_ctx_t *ctx;
+  size_t header_length;
+  size_t length;
+  unsigned int window;
+  unsigned int i;
+  int frag = -1;
+  int next = -1;
+  int complete;
+  int elt_nbr;
+  int past_head = 0;
+  int limited = 0;
+  int shaping;
+  uint8_t frag_id;
+  gse_shaper_color_t ctx_color = GSE_SHAPER_GREEN;
+
+  assert(encap != NULL);
+  assert(fifo != NULL);
+  assert(index != NULL);
+  assert(encap_ctx != NULL);
+  assert(color != NULL);
+
+  *color = GSE_SHAPER_GREEN;
+  shaping = (encap->shaper_nbr > 0 && max_color < GSE_SHAPER_RED);
+  ctx = *encap_ctx;
+
+  /* Without FragID pool, a PDU placed after the first one may be in
+   * fragmentation since the first one was held */
+  if(encap->frag_id_nbr == 0 && ctx->frag_nbr == 0)
+  {
+    status = gse_encap_is_frag_id_used(encap, ctx->frag_id, &past_head);
+    if(status != GSE_STATUS_OK)
+    {
+      goto error;
+    }
+  }
+  if(!past_head)
+  {
+    status = gse_encap_get_ctx_data(ctx, &length, &complete);
+    if(status != GSE_STATUS_OK)
+    {
+      goto error;
+    }
+    if(length == 0 && !complete)
+    {
+      status = GSE_STATUS_PDU_NOT_READY;
+      goto error;
+    }
+    if(!shaping)
+    {
+      goto error;
+    }
+    status = gse_encap_get_color(encap, ctx, color);
+    if(status != GSE_STATUS_OK || *color <= max_color)
+    {
+      goto error;
+    }
+    status = gse_encap_hold_ctx(encap, ctx, *color);
+    if(status != GSE_STATUS_OK)
+    {
+      goto error;
+    }
+    /* Do not keep a FragID for a PDU whose fragmentation has not started */
+    if(ctx->frag_nbr == 0 && ctx->frag_id_alloc)
+    {
+      status = gse_encap_release_frag_id(encap, ctx->frag_id);
+      ctx->frag_id_alloc = 0;
+      if(status != GSE_STATUS_OK)
+      {
+        goto error;
+      }
+    }
+  }
+
+  /* Look for the PDU in fragmentation and for the first PDU that is not held
+   * among the first elements of the FIFO */
+  elt_nbr = gse_get_fifo_elt_nbr(fifo);
+  if(elt_nbr < 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+    goto error;
+  }
+  window = MIN((unsigned int)elt_nbr, encap->fill_window);
+  *color = GSE_SHAPER_GREEN;
+  for(i = 0 ; i < window ; i++)
+  {
+    status = gse_get_fifo_elt_at(fifo, i, &ctx);
+    if(status != GSE_STATUS_OK)
+    {
+      goto error;
+    }
+    if(encap->frag_id_nbr == 0 && ctx->frag_nbr > 0)
+    {
+      frag = i;
+      break;
+    }
+    if(next >= 0 && (frag >= 0 || ctx->frag_nbr == 0))
+    {
+      continue;
+    }
+    status = gse_encap_get_ctx_data(ctx, &length, &complete);
+    if(status != GSE_STATUS_OK)
+    {
+      goto error;
+    }
+    if(length == 0 && !complete)
+    {
+      continue;
+    }
+    if(ctx->frag_nbr > 0 && frag < 0)
+    {
+      frag = i;
+    }
+    if(next >= 0)
+    {
+      continue;
+    }
+    if(shaping)
+    {
+      status = gse_encap_get_color(encap, ctx, &ctx_color);
+      if(status != GSE_STATUS_OK)
+      {
+        goto error;
+      }
+      if(ctx_color > max_color)
+      {
+        status = gse_encap_hold_ctx(encap, ctx, ctx_color);
+        if(status != GSE_STATUS_OK)
+        {
+          goto error;
+        }
+        limited = 1;
+        continue;
+      }
+    }
+    next = i;
+    *color = ctx_color;
+    if(encap->frag_id_nbr == 0 && !past_head)
+    {
+      break;
+    }
+  }
+  if(encap->frag_id_nbr == 0 && frag >= 0)
+  {
+    goto select_frag;
+  }
+  if(next < 0)
+  {
+    status = (limited ? GSE_STATUS_RATE_LIMITED : GSE_STATUS_PDU_NOT_READY);
+    goto error;
+  }
+  status = gse_get_fifo_elt_at(fifo, next, &ctx);
+  if(status != GSE_STATUS_OK)
+  {
+    goto error;
+  }
+
+  /* A new PDU that may be fragmented needs a FragID */
+  if(ctx->frag_nbr == 0 && (next > 0 || encap->frag_id_nbr > 0))
+  {
+    status = gse_encap_get_ctx_data(ctx, &length, &complete);
+    if(status != GSE_STATUS_OK)
+    {
+      goto error;
+    }
+    if(encap->build_header_ext == NULL)
+    {
+      header_length = gse_compute_header_length(GSE_PDU_COMPLETE,
+                                                ctx->label_type);
+      if(header_length == 0)
+      {
+        status = GSE_STATUS_INTERNAL_ERROR;
+        goto error;
+      }
+      if(complete && (length + header_length) <= desired_length)
+      {
+        goto select;
+      }
+    }
+    if(encap->frag_id_nbr == 0)
+    {
+      /* The QoS value is kept as FragID */
+      status = gse_encap_take_frag_id(encap, ctx->frag_id);
+    }
+    else
+    {
+      status = gse_encap_alloc_frag_id(encap, &frag_id);
+      if(status == GSE_STATUS_OK)
+      {
+        ctx->frag_id = frag_id;
+      }
+    }
+    if(status == GSE_STATUS_OK)
+    {
+      ctx->frag_id_alloc = 1;
+    }
+    else if(status == GSE_STATUS_FRAG_ID_EXHAUSTED && frag >= 0)
+    {
+      /* Go on with a PDU in fragmentation instead */
+      goto select_frag;
+    }
+    else
+    {
+      goto error;
+    }
+  }
+
+select:
+  *index = next;
+  *encap_ctx = ctx;
+  goto error;
+
+select_frag:
+  status = gse_get_fifo_elt_at(fifo, frag, &ctx);
+  if(status != GSE_STATUS_OK)
+  {
+    goto error;
+  }
+  status = gse_encap_get_ctx_data(ctx, &length, &complete);
+  if(status != GSE_STATUS_OK)
+  {
+    goto error;
+  }
+  if(length == 0 && !complete)
+  {
+    status = GSE_STATUS_PDU_NOT_READY;
+    goto error;
+  }
+  *color = GSE_SHAPER_GREEN;
+  if(shaping)
+  {
+    status = gse_encap_get_color(encap, ctx, color);
+    if(status != GSE_STATUS_OK)
+    {
+      goto error;
+    }
+    if(*color > max_color)
+    {
+      status = GSE_STATUS_RATE_LIMITED;
+      goto error;
+    }
+  }
+  *index = frag;
+  *encap_ctx = ctx;
+
+error:
+  return status;
+}
+
+static gse_status_t gse_encap_select_fill(gse_encap_t *encap, fifo_t *fifos,
+                                          gse_fill_policy_t policy,
+                                          size_t length,
+                                          gse_shaper_color_t max_color,
+                                          fifo_t **fifo, unsigned int *index,
+                                          gse_encap_ctx_t **encap_ctx,
+                                          gse_shaper_color_t *color)
+{
+  gse_status_t status = GSE_STATUS_FIFO_EMPTY;
+
+  gse_encap_ctx_t *ctx;
+  size_t header_length;
+  size_t needed_length;
+  size_t best_length;
+  size_t ctx_length;
+  unsigned int window;
+  unsigned int i;
+  int best;
+  int elt_nbr;
+  int complete;
+  int limited = 0;
+  int not_ready = 0;
+  uint8_t q;
+  gse_shaper_color_t ctx_color = GSE_SHAPER_GREEN;
+  gse_shaper_color_t best_color = GSE_SHAPER_GREEN;
+
+  assert(encap != NULL);
+  assert(fifos != NULL);
+  assert(fifo != NULL);
+  assert(index != NULL);
+  assert(encap_ctx != NULL);
+
+  /* Look for the PDU that completely fits in the remaining length, the
+   * priority of the FIFOs is respected but a PDU may be sent before the PDUs
+   * placed before it in its FIFO as it does not need a FragID */
+  for(q = 0 ; policy != GSE_FILL_FIFO && q < encap->qos_nbr ; q++)
+  {
+    elt_nbr = gse_get_fifo_elt_nbr(&fifos[q]);
+    if(elt_nbr < 0)
+    {
+      status = GSE_STATUS_PTHREAD_MUTEX;
+      goto error;
+    }
+    window = MIN((unsigned int)elt_nbr, encap->fill_window);
+    best = -1;
+    best_length = 0;
+    for(i = 0 ; i < window ; i++)
+    {
+      status = gse_get_fifo_elt_at(&fifos[q], i, &ctx);
+      if(status != GSE_STATUS_OK)
+      {
+        goto error;
+      }
+      if(ctx->frag_nbr > 0)
+      {
+        header_length = gse_compute_header_length(GSE_PDU_SUBS_FRAG,
+                                                  ctx->label_type);
+      }
+      else if(encap->build_header_ext == NULL)
+      {
+        header_length = gse_compute_header_length(GSE_PDU_COMPLETE,
+                                                  ctx->label_type);
+      }
+      else
+      {
+        /* The extensions length is unknown before calling the callback */
+        continue;
+      }
+      if(header_length == 0)
+      {
+        status = GSE_STATUS_INTERNAL_ERROR;
+        goto error;
+      }
+      /* A PDU whose end is missing cannot end in the frame */
+      status = gse_encap_get_ctx_data(ctx, &ctx_length, &complete);
+      if(status != GSE_STATUS_OK)
+      {
+        goto error;
+      }
+      if(!complete)
+      {
+        continue;
+      }
+      needed_length = header_length + ctx_length;
+      /* First fit stops on the first PDU, best fit keeps the PDU that leaves
+       * the least space in the frame */
+      if(needed_length > length || needed_length <= best_length)
+      {
+        continue;
+      }
+      if(encap->shaper_nbr > 0)
+      {
+        status = gse_encap_get_color(encap, ctx, &ctx_color);
+        if(status != GSE_STATUS_OK)
+        {
+          goto error;
+        }
+        if(ctx_color > max_color)
+        {
+          status = gse_encap_hold_ctx(encap, ctx, ctx_color);
+          if(status != GSE_STATUS_OK)
+          {
+            goto error;
+          }
+          limited = 1;
+          continue;
+        }
+      }
+      best = i;
+      best_length = needed_length;
+      best_color = ctx_color;
+      if(policy == GSE_FILL_FIRST_FIT)
+      {
+        break;
+      }
+    }
+    if(best >= 0)
+    {
+      *fifo = &fifos[q];
+      *index = best;
+      *color = best_color;
+      status = gse_get_fifo_elt_at(&fifos[q], best, encap_ctx);
+      goto error;
+    }
+  }
+
+  /* No PDU fits, fragment a PDU of the first FIFO that is not empty */
+  status = GSE_STATUS_FIFO_EMPTY;
+  for(q = 0 ; q < encap->qos_nbr ; q++)
+  {
+    elt_nbr = gse_get_fifo_elt_nbr(&fifos[q]);
+    if(elt_nbr < 0)
+    {
+      status = GSE_STATUS_PTHREAD_MUTEX;
+      goto error;
+    }
+    if(elt_nbr == 0)
+    {
+      continue;
+    }
+    status = gse_encap_select_ctx(encap, &fifos[q], length, max_color, index,
+                                  encap_ctx, &ctx_color);
+    if(status == GSE_STATUS_RATE_LIMITED)
+    {
+      limited = 1;
+      status = GSE_STATUS_FIFO_EMPTY;
+      continue;
+    }
+    if(status == GSE_STATUS_PDU_NOT_READY)
+    {
+      not_ready = 1;
+      status = GSE_STATUS_FIFO_EMPTY;
+      continue;
+    }
+    if(status != GSE_STATUS_FRAG_ID_EXHAUSTED)
+    {
+      *fifo = &fifos[q];
+      *color = ctx_color;
+      goto error;
+    }
+  }
+  if(status == GSE_STATUS_FIFO_EMPTY && limited)
+  {
+    status = GSE_STATUS_RATE_LIMITED;
+  }
+  else if(status == GSE_STATUS_FIFO_EMPTY && not_ready)
+  {
+    status = GSE_STATUS_PDU_NOT_READY;
+  }
+
+error:
+  return status;
+}
+
+static gse_status_t gse_encap_fill_fifos(gse_encap_t *encap, fifo_t *fifos,
+                                         gse_fill_policy_t policy,
+                                         unsigned char *frame,
+                                         size_t frame_length,
+                                         size_t *data_length,
+                                         gse_frame_stats_t *stats)
+{
+  gse_status_t status = GSE_STATUS_OK;
+
+  gse_encap_ctx_t *encap_ctx;
+  unsigned int index;
+  fifo_t *fifo;
+  size_t remaining_length;
+  size_t packet_length;
+  size_t used_length = 0;
+  int limited = 0;
+  int not_ready = 0;
+  gse_shaper_color_t max_color;
+  gse_shaper_color_t color;
+  gse_label_t label;
+  uint8_t label_type;
+  uint8_t qos;
+
+  assert(encap != NULL);
+  assert(fifos != NULL);
+  assert(frame != NULL);
+  assert(data_length != NULL);
+
+  if(stats != NULL)
+  {
+    memset(stats, 0, sizeof(gse_frame_stats_t));
+  }
+  /* The PDUs held by the shapers are counted once per frame */
+  if(encap->shaper_nbr > 0)
+  {
+    if(pthread_mutex_lock(&encap->shaper_mutex) != 0)
+    {
+      status = GSE_STATUS_PTHREAD_MUTEX;
+      goto padding;
+    }
+    encap->fill_nbr++;
+    if(pthread_mutex_unlock(&encap->shaper_mutex) != 0)
+    {
+      status = GSE_STATUS_PTHREAD_MUTEX;
+      goto padding;
+    }
+  }
+
+  while(frame_length - used_length >= GSE_MIN_PACKET_LENGTH)
+  {
+    remaining_length = MIN(frame_length - used_length, GSE_MAX_PACKET_LENGTH);
+    /* With shaping, the PDUs within their committed rate are sent first,
+     * the remaining space is then used by the PDUs within their peak rate */
+    max_color = (encap->shaper_nbr > 0 ? GSE_SHAPER_GREEN : GSE_SHAPER_RED);
+    status = gse_encap_select_fill(encap, fifos, policy, remaining_length,
+                                   max_color, &fifo, &index, &encap_ctx,
+                                   &color);
+    if(status == GSE_STATUS_RATE_LIMITED)
+    {
+      status = gse_encap_select_fill(encap, fifos, policy, remaining_length,
+                                     GSE_SHAPER_YELLOW, &fifo, &index,
+                                     &encap_ctx, &color);
+    }
+    if(status == GSE_STATUS_RATE_LIMITED)
+    {
+      limited = 1;
+      break;
+    }
+    else if(status == GSE_STATUS_PDU_NOT_READY)
+    {
+      not_ready = 1;
+      break;
+    }
+    else if(status == GSE_STATUS_FIFO_EMPTY ||
+            status == GSE_STATUS_FRAG_ID_EXHAUSTED)
+    {
+      break;
+    }
+    else if(status != GSE_STATUS_OK)
+    {
+      goto padding;
+    }
+
+    /* The element may be removed from the FIFO once the packet is built */
+    qos = encap_ctx->qos;
+    label = encap_ctx->label;
+    label_type = encap_ctx->label_type;
+    status = gse_encap_build_packet(FRAME, NULL, frame + used_length, NULL,
+                                    encap, remaining_length, fifo, index, encap_ctx,
+                                    &packet_length, stats);
+    if(status == GSE_STATUS_LENGTH_TOO_SMALL)
+    {
+      /* Not enough space for a fragment, the end of the frame is padding */
+      break;
+    }
+    else if(status == GSE_STATUS_PDU_ABORTED)
+    {
+      /* The aborted PDU is dropped, go on with the next one */
+      continue;
+    }
+    else if(status != GSE_STATUS_OK)
+    {
+      goto padding;
+    }
+    used_length += packet_length;
+    if(encap->shaper_nbr > 0)
+    {
+      status = gse_encap_charge_shapers(encap, qos, label.six_bytes_label,
+                                        label_type, packet_length, color);
+      if(status != GSE_STATUS_OK)
+      {
+        goto padding;
+      }
+    }
+  }
+
+  if(used_length > 0)
+  {
+    status = GSE_STATUS_OK;
+  }
+  else
+  {
+    status = (limited ? GSE_STATUS_RATE_LIMITED :
+              (not_ready ? GSE_STATUS_PDU_NOT_READY : GSE_STATUS_FIFO_EMPTY));
+  }
+
+padding:
+  /* Padding is made of zeros, so the start and end indicators and label
+   * type are 0 */
+  memset(frame + used_length, 0, frame_length - used_length);
+  *data_length = used_length;
+  if(stats != NULL)
+  {
+    stats->padding_length = frame_length - used_length;
+  }
+  return status;
+}
+
+static gse_status_t gse_encap_check_fifos_empty(gse_encap_t *encap,
+                                                fifo_t *fifos)
+{
+  unsigned int i;
+  int elt_nbr;
+
+  for(i = 0 ; i < encap->qos_nbr ; i++)
+  {
+    elt_nbr = gse_get_fifo_elt_nbr(&fifos[i]);
+    if(elt_nbr < 0)
+    {
+      return GSE_STATUS_PTHREAD_MUTEX;
+    }
+    if(elt_nbr > 0)
+    {
+      return GSE_STATUS_FIFO_NOT_EMPTY;
+    }
+  }
+  return GSE_STATUS_OK;
+}
+
+static gse_status_t gse_encap_create_modcod_fifos(gse_encap_t *encap,
+                                                  uint8_t modcod)
+{
+  gse_status_t status = GSE_STATUS_OK;
+
+  fifo_t *fifos;
+  unsigned int i;
+
+  if(encap->modcod_fifo == NULL)
+  {
+    encap->modcod_fifo = calloc(GSE_MODCOD_NBR, sizeof(fifo_t *));
+    if(encap->modcod_fifo == NULL)
+    {
+      status = GSE_STATUS_MALLOC_FAILED;
+      goto error;
+    }
+  }
+  if(encap->modcod_fifo[modcod] == NULL)
+  {
+    fifos = malloc(sizeof(fifo_t) * encap->qos_nbr);
+    if(fifos == NULL)
+    {
+      status = GSE_STATUS_MALLOC_FAILED;
+      goto error;
+    }
+    for(i = 0 ; i < encap->qos_nbr ; i++)
+    {
+      status = gse_init_fifo(&fifos[i], encap->fifo_size);
+      if(status == GSE_STATUS_OK)
+      {
+        fifos[i].event_fd = encap->event_fd;
+      }
+      if(status == GSE_STATUS_OK && encap->watermarks != NULL)
+      {
+        status = gse_set_fifo_watermark(&fifos[i], &encap->watermarks[i]);
+        if(status != GSE_STATUS_OK)
+        {
+          gse_release_fifo(&fifos[i]);
+        }
+      }
+      if(status == GSE_STATUS_OK && encap->flow_nbr > 0)
+      {
+        status = gse_set_fifo_flows(&fifos[i], encap->flow_nbr,
+                                    encap->flow_quantum);
+        if(status != GSE_STATUS_OK)
+        {
+          gse_release_fifo(&fifos[i]);
+        }
+      }
+      if(status != GSE_STATUS_OK)
+      {
+        while(i > 0)
+        {
+          i--;
+          gse_release_fifo(&fifos[i]);
+        }
+        free(fifos);
+        goto error;
+      }
+    }
+    encap->modcod_fifo[modcod] = fifos;
+  }
+
+error:
+  return status;
+}
+
+static gse_status_t gse_encap_select_flow(gse_encap_t *encap, fifo_t *fifo,
+                                          size_t desired_length,
+                                          unsigned int *index,
+                                          gse_encap_ctx_t **encap_ctx)
+{
+  gse_status_t status = GSE_STATUS_OK;
+
+  gse_encap_ctx_t *ctx;
+  size_t header_length;
+  size_t length;
+  int complete;
+  int elt_nbr;
+  unsigned int i;
+  uint8_t frag_id;
+
+  /* Without FragID pool, the PDU in fragmentation keeps the turn of its flow
+   * as it is the only one that can be fragmented */
+  status = gse_select_fifo_flow(fifo, encap->frag_id_nbr == 0, index);
+  if(status != GSE_STATUS_OK)
+  {
+    goto error;
+  }
+  status = gse_get_fifo_elt_at(fifo, *index, &ctx);
+  if(status != GSE_STATUS_OK)
+  {
+    goto error;
+  }
+  *encap_ctx = ctx;
+  status = gse_encap_get_ctx_data(ctx, &length, &complete);
+  if(status != GSE_STATUS_OK)
+  {
+    goto error;
+  }
+  if(length == 0 && !complete)
+  {
+    status = GSE_STATUS_PDU_NOT_READY;
+    goto error;
+  }
+  if(encap->frag_id_nbr == 0 || ctx->frag_nbr > 0)
+  {
+    goto error;
+  }
+
+  /* A new PDU that may be fragmented needs a FragID */
+  if(encap->build_header_ext == NULL)
+  {
+    header_length = gse_compute_header_length(GSE_PDU_COMPLETE,
+                                              ctx->label_type);
+    if(header_length == 0)
+    {
+      status = GSE_STATUS_INTERNAL_ERROR;
+      goto error;
+    }
+    if(complete && (length + header_length) <= desired_length)
+    {
+      goto error;
+    }
+  }
+  status = gse_encap_alloc_frag_id(encap, &frag_id);
+  if(status == GSE_STATUS_OK)
+  {
+    ctx->frag_id = frag_id;
+    ctx->frag_id_alloc = 1;
+    goto error;
+  }
+  if(status != GSE_STATUS_FRAG_ID_EXHAUSTED)
+  {
+    goto error;
+  }
+
+  /* Go on with a PDU in fragmentation instead */
+  elt_nbr = gse_get_fifo_elt_nbr(fifo);
+  if(elt_nbr < 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+    goto error;
+  }
+  for(i = 0 ; i < (unsigned int)elt_nbr ; i++)
+  {
+    status = gse_get_fifo_elt_at(fifo, i, &ctx);
+    if(status != GSE_STATUS_OK)
+    {
+      goto error;
+    }
+    if(ctx->frag_nbr == 0)
+    {
+      continue;
+    }
+    status = gse_encap_get_ctx_data(ctx, &length, &complete);
+    if(status != GSE_STATUS_OK)
+    {
+      goto error;
+    }
+    if(length > 0 || complete)
+    {
+      *index = i;
+      *encap_ctx = ctx;
+      goto error;
+    }
+  }
+  status = GSE_STATUS_FRAG_ID_EXHAUSTED;
+
+error:
+  return status;
 }
 
-gse_status_t gse_encap_get_packet_no_alloc(gse_vfrag_t **packet, gse_encap_t *encap,
-                                           size_t length, uint8_t qos)
+static uint32_t gse_encap_hash_flow(uint8_t label[6], int label_length,
+                                    uint8_t label_type, uint32_t flow_key)
 {
-  return gse_encap_get_packet_common(NO_ALLOC, packet, encap, length, qos);
-}
+  /* FNV-1a hash */
+  uint32_t hash = 2166136261U;
+  int i;
 
-gse_status_t gse_encap_set_extension_callback(gse_encap_t *encap,
-                                              gse_encap_build_header_ext_cb_t callback,
-                                              void *opaque)
-{
-  if(encap == NULL)
+  hash = (hash ^ label_type) * 16777619U;
+  for(i = 0 ; i < label_length ; i++)
   {
-    return GSE_STATUS_NULL_PTR;
+    hash = (hash ^ label[i]) * 16777619U;
   }
-
-  encap->build_header_ext = callback;
-  encap->opaque = opaque;
-
-  return GSE_STATUS_OK;
+  for(i = 0 ; i < 4 ; i++)
+  {
+    hash = (hash ^ ((flow_key >> (8 * i)) & 0xFF)) * 16777619U;
+  }
+  return hash;
 }
 
-
-/****************************************************************************
- *
- *   PRIVATE FUNCTIONS
- *
- ****************************************************************************/
-
-static gse_status_t gse_encap_create_header_and_crc(gse_payload_type_t payload_type,
-                                                    gse_encap_ctx_t *const encap_ctx,
-                                                    size_t length)
+static gse_status_t gse_encap_get_color(gse_encap_t *encap,
+                                        gse_encap_ctx_t *encap_ctx,
+                                        gse_shaper_color_t *color)
 {
   gse_status_t status = GSE_STATUS_OK;
 
-  uint32_t crc;
-  gse_header_t *gse_header;
-  size_t label_length;
-  int ret;
+  gse_shaper_t *qos_shaper;
+  gse_shaper_t *label_shaper;
+  gse_shaper_color_t qos_color = GSE_SHAPER_GREEN;
+  gse_shaper_color_t label_color = GSE_SHAPER_GREEN;
 
+  assert(encap != NULL);
   assert(encap_ctx != NULL);
+  assert(color != NULL);
 
-  gse_header = (gse_header_t*)encap_ctx->vfrag->start;
-  status = gse_encap_set_gse_length(length, gse_header);
-  if(status != GSE_STATUS_OK)
+  if(pthread_mutex_lock(&encap->shaper_mutex) != 0)
   {
+    status = GSE_STATUS_PTHREAD_MUTEX;
     goto error;
   }
 
-  ret = gse_get_label_length(encap_ctx->label_type);
-  if(ret < 0)
+  status = gse_encap_get_shapers(encap, encap_ctx, &qos_shaper,
+                                 &label_shaper);
+  if(status != GSE_STATUS_OK)
   {
-    goto error;
+    goto unlock;
   }
-  label_length = (size_t) ret;
-
-  switch(payload_type)
+  if(qos_shaper != NULL)
   {
-    /* GSE packet carrying a complete PDU */
-    /* Header fields are S | E | LT | GSE Length | Protocol Type | Label | Ext */
-    case GSE_PDU_COMPLETE:
-      gse_header->s = 0x1;
-      gse_header->e = 0x1;
-      gse_header->lt = encap_ctx->label_type;
-      gse_header->complete_s.protocol_type = encap_ctx->protocol_type;
-      memcpy(&(gse_header->complete_s.label), &(encap_ctx->label), label_length);
-      break;
-
-    /* GSE packet carrying a first fragment of PDU */
-    /* Header fields are
-     * S | E | LT | GSE Length | FragID | Total Length | Protocol Type | Label | Ext */
-    case GSE_PDU_FIRST_FRAG:
-      gse_header->s = 0x1;
-      gse_header->e = 0x0;
-      gse_header->lt = encap_ctx->label_type;
-      gse_header->first_frag_s.frag_id = encap_ctx->qos;
-      gse_header->first_frag_s.total_length = htons(encap_ctx->total_length);
-      gse_header->first_frag_s.protocol_type = encap_ctx->protocol_type;
-      memcpy(&(gse_header->first_frag_s.label), &(encap_ctx->label), label_length);
-
-      /* CRC is computed with first fragment because the complete PDU and
-       * some of its header elements are necessary */
-      crc = gse_encap_compute_crc(encap_ctx->vfrag);
-      /* Add CRC at the end of the data field */
-      memcpy(encap_ctx->vfrag->end - GSE_MAX_TRAILER_LENGTH, &crc,
-             GSE_MAX_TRAILER_LENGTH);
-      break;
-
-    /* GSE packet carrying a subsequent fragment of PDU
-     * which is not the last one */
-    /* Header fields are S | E | LT | GSE Length | FragID */
-    case GSE_PDU_SUBS_FRAG:
-      gse_header->s = 0x0;
-      gse_header->e = 0x0;
-      gse_header->lt = GSE_LT_REUSE;
-      gse_header->subs_frag_s.frag_id = encap_ctx->qos;
-      break;
+    qos_color = gse_get_shaper_color(qos_shaper);
+  }
+  if(label_shaper != NULL)
+  {
+    label_color = gse_get_shaper_color(label_shaper);
+  }
 
-    /* GSE packet carrying a last fragment of PDU */
-    /* Header fields are S | E | LT | GSE Length | FragID */
-    case GSE_PDU_LAST_FRAG:
-      gse_header->s = 0x0;
-      gse_header->e = 0x1;
-      gse_header->lt = GSE_LT_REUSE;
-      gse_header->subs_frag_s.frag_id = encap_ctx->qos;
-      break;
+  *color = (qos_color > label_color ? qos_color : label_color);
+  /* Holding a PDU in fragmentation would stall its reassembly */
+  if(*color == GSE_SHAPER_RED && encap_ctx->frag_nbr > 0)
+  {
+    *color = GSE_SHAPER_YELLOW;
+  }
 
-    default:
-      /* Should not append */
-      assert(0);
-      status = GSE_STATUS_INTERNAL_ERROR;
-      goto error;
+unlock:
+  if(pthread_mutex_unlock(&encap->shaper_mutex) != 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
   }
 error:
   return status;
 }
 
-static uint16_t gse_encap_compute_total_length(gse_encap_ctx_t *const encap_ctx)
-{
-  uint16_t total_length;
-  assert(encap_ctx != NULL);
-  total_length = gse_get_label_length(encap_ctx->label_type)
-                 + GSE_PROTOCOL_TYPE_LENGTH
-                 + encap_ctx->vfrag->length;
-  return total_length;
-}
-
-static gse_status_t gse_encap_set_gse_length(size_t packet_length,
-                                             gse_header_t *header)
+static gse_status_t gse_encap_hold_ctx(gse_encap_t *encap,
+                                       gse_encap_ctx_t *encap_ctx,
+                                       gse_shaper_color_t color)
 {
   gse_status_t status = GSE_STATUS_OK;
 
-  uint16_t gse_length;
+  gse_shaper_t *qos_shaper;
+  gse_shaper_t *label_shaper;
 
-  assert(header != NULL);
-  /* GSE Length take into account all the fields following it */
-  gse_length = packet_length - GSE_MANDATORY_FIELDS_LENGTH;
-  /* GSE Length field contain 12 bits */
-  if(gse_length > 0xFFF)
+  assert(encap != NULL);
+  assert(encap_ctx != NULL);
+
+  if(color != GSE_SHAPER_RED)
   {
-    status = GSE_STATUS_LENGTH_TOO_HIGH;
+    goto error;
+  }
+  if(pthread_mutex_lock(&encap->shaper_mutex) != 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
     goto error;
   }
 
-  header->gse_length_hi = (gse_length >> 8) & 0x0F;
-  header->gse_length_lo = gse_length & 0xFF;
+  /* The PDU is skipped for each packet of the frame but held once */
+  if(encap_ctx->held_fill == encap->fill_nbr)
+  {
+    goto unlock;
+  }
+  encap_ctx->held_fill = encap->fill_nbr;
+  status = gse_encap_get_shapers(encap, encap_ctx, &qos_shaper,
+                                 &label_shaper);
+  if(status != GSE_STATUS_OK)
+  {
+    goto unlock;
+  }
+  if(qos_shaper != NULL &&
+     gse_get_shaper_color(qos_shaper) == GSE_SHAPER_RED)
+  {
+    qos_shaper->held_nbr++;
+  }
+  if(label_shaper != NULL &&
+     gse_get_shaper_color(label_shaper) == GSE_SHAPER_RED)
+  {
+    label_shaper->held_nbr++;
+  }
 
+unlock:
+  if(pthread_mutex_unlock(&encap->shaper_mutex) != 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+  }
 error:
   return status;
 }
 
-static size_t gse_encap_compute_packet_length(size_t desired_length,
-                                              size_t remaining_data_length,
-                                              size_t header_length)
+static gse_status_t gse_encap_get_shapers(gse_encap_t *encap,
+                                          gse_encap_ctx_t *encap_ctx,
+                                          gse_shaper_t **qos_shaper,
+                                          gse_shaper_t **label_shaper)
 {
-  size_t packet_length;
+  gse_status_t status = GSE_STATUS_OK;
 
-  packet_length = MIN(desired_length, GSE_MAX_PACKET_LENGTH);
-  packet_length = MIN(packet_length, remaining_data_length + header_length);
-  /* Avoid fragmentation of CRC field between 2 GSE fragments:
-   * if the computed packet length is too short by less than 4 bytes to contain
-   * the whole remaining part of the PDU and the CRC, then reduce the packet
-   * length so that the 4-bytes CRC is left for the next fragment */
-  if((packet_length < remaining_data_length + header_length) &&
-     ((remaining_data_length + header_length - packet_length)
-       < GSE_MAX_TRAILER_LENGTH))
+  uint32_t index;
+
+  *qos_shaper = NULL;
+  *label_shaper = NULL;
+  if(encap->qos_shapers != NULL && encap->qos_shapers[encap_ctx->qos].used)
   {
-    packet_length = remaining_data_length - GSE_MAX_TRAILER_LENGTH +
-                    header_length;
+    *qos_shaper = &encap->qos_shapers[encap_ctx->qos];
   }
-
-  return packet_length;
+  if(encap->label_shaper_size > 0)
+  {
+    status = gse_get_label_map(&encap->shaper_map,
+                               encap_ctx->label.six_bytes_label,
+                               encap_ctx->label_type, &index);
+    if(status == GSE_STATUS_OK)
+    {
+      *label_shaper = &encap->label_shapers[index];
+    }
+    else if(status == GSE_STATUS_UNKNOWN_LABEL ||
+            status == GSE_STATUS_INVALID_LT)
+    {
+      status = GSE_STATUS_OK;
+    }
+  }
+  return status;
 }
 
-static uint32_t gse_encap_compute_crc(gse_vfrag_t *vfrag)
+static gse_status_t gse_encap_charge_shapers(gse_encap_t *encap, uint8_t qos,
+                                             uint8_t *label,
+                                             uint8_t label_type,
+                                             size_t length,
+                                             gse_shaper_color_t color)
 {
-  uint32_t crc;
-  unsigned char *data;
-  size_t length;
-
-  /* CRC is computed with complete PDU, Total length, Protocol Type and Label */
-  data = vfrag->start + GSE_MANDATORY_FIELDS_LENGTH + GSE_FRAG_ID_LENGTH;
-  length = vfrag->length -
-          (GSE_MANDATORY_FIELDS_LENGTH + GSE_FRAG_ID_LENGTH + GSE_MAX_TRAILER_LENGTH);
-  crc = compute_crc(data, length, GSE_CRC_INIT);
+  gse_status_t status = GSE_STATUS_OK;
 
-  return htonl(crc);
-}
+  uint32_t index;
 
-static gse_status_t gse_encap_get_packet_common(int mode, gse_vfrag_t **packet,
-                                                gse_encap_t *encap,
-                                                size_t desired_length,
-                                                uint8_t qos)
-{
-  gse_status_t status = GSE_STATUS_OK;
+  assert(encap != NULL);
 
-  if(packet == NULL)
+  if(pthread_mutex_lock(&encap->shaper_mutex) != 0)
   {
-    status = GSE_STATUS_NULL_PTR;
+    status = GSE_STATUS_PTHREAD_MUTEX;
     goto error;
   }
 
-  size_t remaining_data_length;
-  size_t header_length;
-  int elt_nbr;
-  gse_encap_ctx_t* encap_ctx;
-  gse_payload_type_t payload_type;
-  unsigned char *extensions = NULL;
-  size_t tot_ext_length;
-
-  /* Check parameters */
-  if(encap == NULL)
+  if(encap->qos_shapers != NULL && encap->qos_shapers[qos].used)
   {
-    status = GSE_STATUS_NULL_PTR;
-    goto packet_null;
+    gse_charge_shaper(&encap->qos_shapers[qos], length, color);
   }
-  if(qos >= encap->qos_nbr)
+  if(encap->label_shaper_size > 0)
   {
-    status = GSE_STATUS_INVALID_QOS;
-    goto packet_null;
+    status = gse_get_label_map(&encap->shaper_map, label, label_type, &index);
+    if(status == GSE_STATUS_OK)
+    {
+      gse_charge_shaper(&encap->label_shapers[index], length, color);
+    }
+    else if(status == GSE_STATUS_UNKNOWN_LABEL ||
+            status == GSE_STATUS_INVALID_LT)
+    {
+      status = GSE_STATUS_OK;
+    }
   }
 
-  /* Check if there are elements for the specified QoS */
-  elt_nbr = gse_get_fifo_elt_nbr(&encap->fifo[qos]);
-  if(elt_nbr == 0)
+  if(pthread_mutex_unlock(&encap->shaper_mutex) != 0)
   {
-    status = GSE_STATUS_FIFO_EMPTY;
-    goto packet_null;
+    status = GSE_STATUS_PTHREAD_MUTEX;
   }
-  else if(elt_nbr < 0)
+error:
+  return status;
+}
+
+static gse_status_t gse_encap_push_pdu(gse_vfrag_t *pdu, size_t pdu_length,
+                                       gse_encap_t *encap, uint8_t label[6],
+                                       uint8_t label_type, uint16_t protocol,
+                                       uint8_t qos, uint32_t flow_key,
+                                       gse_encap_stream_t *stream,
+                                       gse_vfrag_chain_t *chain)
+{
+  gse_status_t status = GSE_STATUS_OK;
+
+  gse_encap_ctx_t *encap_ctx;
+  gse_encap_ctx_t ctx_elts;
+  fifo_t *fifo;
+
+  status = gse_encap_build_ctx(pdu, pdu_length, encap, label, label_type,
+                               protocol, qos, flow_key, stream, chain,
+                               &ctx_elts, &fifo);
+  if(status != GSE_STATUS_OK)
   {
-    status = GSE_STATUS_PTHREAD_MUTEX;
-    goto packet_null;
+    goto error;
   }
 
-  /* If the desired length = 0, then use the maximum possible value */
-  if(desired_length == 0)
+  /* Push FIFO */
+  encap_ctx = NULL;
+  status = gse_push_fifo(fifo, &encap_ctx, ctx_elts);
+
+error:
+  return status;
+}
+
+static gse_status_t gse_encap_build_ctx(gse_vfrag_t *pdu, size_t pdu_length,
+                                        gse_encap_t *encap, uint8_t label[6],
+                                        uint8_t label_type, uint16_t protocol,
+                                        uint8_t qos, uint32_t flow_key,
+                                        gse_encap_stream_t *stream,
+                                        gse_vfrag_chain_t *chain,
+                                        gse_encap_ctx_t *ctx_elts,
+                                        fifo_t **fifo)
+{
+  gse_status_t status = GSE_STATUS_OK;
+
+  int label_length = -1;
+  fifo_t *fifos;
+  uint32_t modcod;
+
+  assert(pdu != NULL || chain != NULL);
+  assert(encap != NULL);
+
+  label_length = gse_get_label_length(label_type);
+  if(label_length < 0)
   {
-    desired_length = GSE_MAX_PACKET_LENGTH;
+    status = GSE_STATUS_INVALID_LT;
+    goto error;
   }
-  if(desired_length > GSE_MAX_PACKET_LENGTH)
+  /* Total length field shall be < 65536 */
+  if(pdu_length > (GSE_MAX_PDU_LENGTH - GSE_PROTOCOL_TYPE_LENGTH -
+                   (unsigned int)label_length))
   {
-    status = GSE_STATUS_LENGTH_TOO_HIGH;
-    goto packet_null;
+    status = GSE_STATUS_PDU_LENGTH;
+    goto error;
   }
-  if(desired_length < GSE_MIN_PACKET_LENGTH)
+  /* Check if we got a good protocol */
+  if(gse_is_ext_hdr(protocol))
   {
-    status = GSE_STATUS_LENGTH_TOO_SMALL;
-    goto packet_null;
+    status = GSE_STATUS_WRONG_PROTOCOL;
+    goto error;
   }
-  status = gse_get_fifo_elt(&encap->fifo[qos], &encap_ctx);
-  if(status != GSE_STATUS_OK)
+  /* Check if QoS value is supported */
+  if(qos >= encap->qos_nbr)
   {
-    goto packet_null;
+    status = GSE_STATUS_INVALID_QOS;
+    goto error;
   }
 
-  remaining_data_length = encap_ctx->vfrag->length;
+  /* Fill context used to push the FIFO */
+  ctx_elts->vfrag = pdu;
+  ctx_elts->stream = stream;
+  ctx_elts->chain = chain;
+  ctx_elts->chain_offset = 0;
+  ctx_elts->vfrag_alloc = (stream != NULL);
+  ctx_elts->qos = qos;
+  ctx_elts->frag_id = qos;
+  ctx_elts->frag_id_alloc = 0;
+  ctx_elts->skip_nbr = 0;
+  ctx_elts->held_fill = 0;
+  ctx_elts->protocol_type = htons(protocol);
+  ctx_elts->label_type = label_type;
+  memcpy(&(ctx_elts->label), label, label_length);
+  ctx_elts->frag_nbr = 0;
+  ctx_elts->total_length = gse_encap_compute_total_length(ctx_elts);
+  ctx_elts->flow = gse_encap_hash_flow(label, label_length, label_type,
+                                       flow_key);
 
-  /* There should always been data because free fragment are removed from the
-   * FIFO at the end of this function */
-  assert(remaining_data_length > 0);
-  if(remaining_data_length <= 0)
+  /* Select the FIFOs of the modcod group associated to the label, the
+   * default FIFOs are used for the other labels */
+  fifos = encap->fifo;
+  status = gse_get_label_map(&encap->label_map, label, label_type, &modcod);
+  if(status == GSE_STATUS_OK)
   {
-    status = GSE_STATUS_INTERNAL_ERROR;
-    goto packet_null;
+    if(pthread_mutex_lock(&encap->modcod_mutex) != 0)
+    {
+      status = GSE_STATUS_PTHREAD_MUTEX;
+      goto error;
+    }
+    fifos = encap->modcod_fifo[modcod];
+    if(pthread_mutex_unlock(&encap->modcod_mutex) != 0)
+    {
+      status = GSE_STATUS_PTHREAD_MUTEX;
+      goto error;
+    }
   }
-
-  /* There is a complete PDU in the context */
-  if(encap_ctx->frag_nbr == 0)
+  else if(status == GSE_STATUS_UNKNOWN_LABEL ||
+          status == GSE_STATUS_INVALID_LT)
   {
-    tot_ext_length = 0;
-    /* Check if we need extensions */
-    if(encap->build_header_ext != NULL)
-    {
-      int ret;
-      uint16_t ext_type;
-      uint16_t proto;
+    status = GSE_STATUS_OK;
+  }
+  else
+  {
+    goto error;
+  }
 
-      extensions = calloc(GSE_MAX_EXT_LENGTH, sizeof(unsigned char));
-      if(extensions == NULL)
-      {
-        status = GSE_STATUS_MALLOC_FAILED;
-        goto packet_null;
-      }
-      tot_ext_length = GSE_MAX_EXT_LENGTH;
-      ret = encap->build_header_ext(extensions, &tot_ext_length, &ext_type,
-                                    ntohs(encap_ctx->protocol_type),
-                                    encap->opaque);
-      if(ret < 0)
-      {
-        status = GSE_STATUS_EXTENSION_CB_FAILED;
-        goto packet_null;
-      }
+  *fifo = &fifos[qos];
 
-      status = gse_check_header_extension_validity(extensions,
-                                                   &tot_ext_length,
-                                                   ext_type,
-                                                   &proto);
-      if(status != GSE_STATUS_OK)
-      {
-        goto packet_null;
-      }
-      if(proto != ntohs(encap_ctx->protocol_type))
-      {
-        status = GSE_STATUS_INVALID_EXTENSIONS;
-        goto packet_null;
-      }
+error:
+  return status;
+}
 
-      /* update the context protocol type with the extension type */
-      encap_ctx->protocol_type = htons(ext_type);
-      encap_ctx->total_length = gse_encap_compute_total_length(encap_ctx);
-    }
+static gse_status_t gse_encap_flush_local_queue(gse_encap_local_queue_t *queue)
+{
+  gse_status_t status = GSE_STATUS_OK;
 
-    /* Total length field shall be < 65536 */
-    if(encap_ctx->total_length + tot_ext_length > GSE_MAX_PDU_LENGTH)
-    {
-      status = GSE_STATUS_PDU_LENGTH;
-      goto packet_null;
-    }
-    /* update total_length value */
-    encap_ctx->total_length += tot_ext_length;
-    /* update remaining data length (consider extensions as data) */
-    remaining_data_length += tot_ext_length;
-    /* move the start pointer in the buffer and add extensions */
+  unsigned int first = 0;
+  unsigned int last;
+  unsigned int pushed;
 
-    status = gse_shift_vfrag(encap_ctx->vfrag, tot_ext_length * -1, 0);
-    if(status != GSE_STATUS_OK)
-    {
-      goto packet_null;
-    }
-    if(tot_ext_length > 0)
-    {
-      memcpy(encap_ctx->vfrag->start, extensions, tot_ext_length);
-    }
+  assert(queue != NULL);
 
-    /* Can the PDU be completely encapsulated ? */
-    header_length = gse_compute_header_length(GSE_PDU_COMPLETE, encap_ctx->label_type);
-    if(header_length == 0)
-    {
-      status = GSE_STATUS_INTERNAL_ERROR;
-      goto packet_null;
-    }
-    if(desired_length >= (remaining_data_length + header_length))
+  while(first < queue->elt_nbr)
+  {
+    /* The PDUs of a FIFO are pushed under a single lock of the FIFO */
+    last = first + 1;
+    while(last < queue->elt_nbr && queue->fifos[last] == queue->fifos[first])
     {
-      payload_type = GSE_PDU_COMPLETE;
+      last++;
     }
-    else
+    status = gse_push_fifo_bulk(queue->fifos[first], &queue->values[first],
+                                last - first, &pushed);
+    first += pushed;
+    if(status != GSE_STATUS_OK)
     {
-      header_length = gse_compute_header_length(GSE_PDU_FIRST_FRAG,
-                                                encap_ctx->label_type);
-      if(header_length == 0)
-      {
-        status = GSE_STATUS_INTERNAL_ERROR;
-        goto packet_null;
-      }
-      payload_type = GSE_PDU_FIRST_FRAG;
-      /* Check if wanted length allows 1 bit of data */
-      if((header_length + 1) > desired_length)
-      {
-        status = GSE_STATUS_LENGTH_TOO_SMALL;
-        goto packet_null;
-      }
+      break;
     }
   }
-  /* There is a PDU fragment in the context */
-  else
+
+  /* Keep the PDUs that were not pushed in front of the queue */
+  if(first > 0)
   {
-    header_length = gse_compute_header_length(GSE_PDU_SUBS_FRAG, encap_ctx->label_type);
-    if(header_length == 0)
-    {
-      status = GSE_STATUS_INTERNAL_ERROR;
-      goto packet_null;
-    }
-    /* Is this the last fragment ? */
-    if(desired_length >= (remaining_data_length + header_length))
-    {
-      payload_type = GSE_PDU_LAST_FRAG;
-      /* Check if complete CRC can be sent */
-      if((header_length + GSE_MAX_TRAILER_LENGTH) > desired_length)
-      {
-        status = GSE_STATUS_LENGTH_TOO_SMALL;
-        goto packet_null;
-      }
-    }
-    else
-    {
-      payload_type = GSE_PDU_SUBS_FRAG;
-      /* Check if wanted length allows 1 bit of data */
-      if((header_length + 1) > desired_length)
-      {
-        status = GSE_STATUS_LENGTH_TOO_SMALL;
-        goto packet_null;
-      }
-    }
+    memmove(queue->values, queue->values + first,
+            (queue->elt_nbr - first) * sizeof(gse_encap_ctx_t));
+    memmove(queue->fifos, queue->fifos + first,
+            (queue->elt_nbr - first) * sizeof(fifo_t *));
+    queue->elt_nbr -= first;
   }
 
-  /* Compute the amount of PDU bytes that is encapsulated in the GSE packet we
-   * are building */
-  desired_length = gse_encap_compute_packet_length(desired_length,
-                                                   remaining_data_length,
-                                                   header_length);
+  return status;
+}
 
-  /* Make room for the GSE header at the beginning of the PDU data and - if the
-   * GSE packet is a first fragment - for the CRC at the end of the PDU data */
-  if(payload_type == GSE_PDU_FIRST_FRAG)
+static gse_status_t gse_encap_get_ctx_data(gse_encap_ctx_t *encap_ctx,
+                                           size_t *length, int *complete)
+{
+  gse_status_t status = GSE_STATUS_OK;
+
+  gse_encap_stream_t *stream = encap_ctx->stream;
+
+  if(encap_ctx->chain != NULL)
   {
-    /* TODO reallocate if not enough space due to extensions instead of 
-     *      an error ? */
-    status = gse_shift_vfrag(encap_ctx->vfrag, header_length * -1,
-                             GSE_MAX_TRAILER_LENGTH);
+    *length = encap_ctx->chain->length - encap_ctx->chain_offset;
+    *complete = 1;
+    goto error;
   }
-  else
+  if(stream == NULL)
   {
-    status = gse_shift_vfrag(encap_ctx->vfrag, header_length * -1, 0);
+    *length = encap_ctx->vfrag->length;
+    *complete = 1;
+    goto error;
   }
-  if(status != GSE_STATUS_OK)
+
+  if(pthread_mutex_lock(&stream->mutex) != 0)
   {
-    goto packet_null;
+    status = GSE_STATUS_PTHREAD_MUTEX;
+    goto error;
   }
-
-  status = gse_encap_create_header_and_crc(payload_type, encap_ctx, desired_length);
-  if(status != GSE_STATUS_OK)
+  *length = encap_ctx->vfrag->length;
+  /* An aborted PDU is complete so that it is selected and dropped */
+  *complete = (stream->complete || stream->aborted);
+  if(pthread_mutex_unlock(&stream->mutex) != 0)
   {
-    goto packet_null;
+    status = GSE_STATUS_PTHREAD_MUTEX;
   }
 
-  /* Code depending on copy parameter */
-  switch(mode)
+error:
+  return status;
+}
+
+static gse_status_t gse_encap_remove_ctx(int mode, gse_encap_t *encap,
+                                         fifo_t *fifo, unsigned int index,
+                                         gse_encap_ctx_t *encap_ctx)
+{
+  gse_status_t status = GSE_STATUS_OK;
+
+  /* The buffer of a PDU received in chunks or of a chained PDU copied is
+   * allocated by the library */
+  if(encap_ctx->chain != NULL)
   {
-    case LEGACY:
-      /* Create a new fragment */
-      status = gse_create_vfrag_with_data(packet, desired_length,
-                                          encap->head_offset,
-                                          encap->trail_offset,
-                                          encap_ctx->vfrag->start,
-                                          desired_length);
-      break;
-    case NO_COPY:
-      /* Duplicate the fragment */
-      status = gse_duplicate_vfrag(packet, encap_ctx->vfrag, desired_length);
-      break;
-    case NO_ALLOC:
-      /* Duplicate the fragment - no allocation */
-      status = gse_duplicate_vfrag_no_alloc(packet, encap_ctx->vfrag, desired_length);
-      break;
+    status = gse_free_vfrag_chain(&(encap_ctx->chain));
   }
-  if(status != GSE_STATUS_OK)
+  else if(mode == NO_ALLOC && !encap_ctx->vfrag_alloc)
   {
-    goto packet_null;
+    status = gse_free_vfrag_no_alloc(&(encap_ctx->vfrag), 1, 0);
+  }
+  else
+  {
+    status = gse_free_vfrag(&(encap_ctx->vfrag));
   }
-
-  encap_ctx->frag_nbr++;
-  /* Remove copied or duplicated data from the initial fragment */
-  status = gse_shift_vfrag(encap_ctx->vfrag, (*packet)->length, 0);
   if(status != GSE_STATUS_OK)
   {
-    goto free_packet;
+    goto error;
   }
-
-  /* Go to the next FIFO element if the initial fragment is empty */
-  if(encap_ctx->vfrag->length <= 0)
+  if(encap_ctx->stream != NULL)
+  {
+    encap_ctx->stream->vfrag = NULL;
+  }
+  /* The context is overwritten once removed from the FIFO */
+  if(encap_ctx->frag_id_alloc)
   {
-    if(mode == NO_ALLOC)
+    status = gse_encap_release_frag_id(encap, encap_ctx->frag_id);
+    encap_ctx->frag_id_alloc = 0;
+    if(status != GSE_STATUS_OK)
     {
-      status = gse_free_vfrag_no_alloc(&(encap_ctx->vfrag), 1, 0);
+      goto error;
     }
-    else
+  }
+  status = gse_remove_fifo_elt_at(fifo, index);
+
+error:
+  return status;
+}
+
+static void gse_encap_put_stream(gse_encap_stream_t *stream)
+{
+  int last;
+
+  if(pthread_mutex_lock(&stream->mutex) != 0)
+  {
+    return;
+  }
+  stream->ref_nbr--;
+  last = (stream->ref_nbr == 0);
+  pthread_mutex_unlock(&stream->mutex);
+
+  if(last)
+  {
+    pthread_mutex_destroy(&stream->mutex);
+    free(stream);
+  }
+}
+
+static void gse_encap_release_streams(fifo_t *fifo)
+{
+  gse_encap_ctx_t *ctx;
+  int elt_nbr;
+  int i;
+
+  elt_nbr = gse_get_fifo_elt_nbr(fifo);
+  for(i = 0 ; i < elt_nbr ; i++)
+  {
+    if(gse_get_fifo_elt_at(fifo, i, &ctx) != GSE_STATUS_OK)
     {
-      status = gse_free_vfrag(&(encap_ctx->vfrag));
+      continue;
     }
-    if(status != GSE_STATUS_OK)
+    if(ctx->stream == NULL)
     {
-      goto free_packet;
+      continue;
     }
-    status = gse_pop_fifo(&encap->fifo[qos]);
-    if(status != GSE_STATUS_OK)
+    /* The PDU buffer is freed with the FIFO, the user can no longer append
+     * data */
+    if(pthread_mutex_lock(&ctx->stream->mutex) == 0)
     {
-      goto free_packet;
+      ctx->stream->aborted = 1;
+      ctx->stream->vfrag = NULL;
+      pthread_mutex_unlock(&ctx->stream->mutex);
     }
+    gse_encap_put_stream(ctx->stream);
   }
+}
 
-  return status;
-free_packet:
-  if(mode == NO_ALLOC)
+static gse_status_t gse_encap_alloc_watermarks(gse_encap_t *encap)
+{
+  gse_status_t status = GSE_STATUS_OK;
+
+  fifo_watermark_t *watermarks;
+  unsigned int modcod;
+  unsigned int i;
+
+  watermarks = malloc(encap->qos_nbr * sizeof(fifo_watermark_t));
+  if(watermarks == NULL)
   {
-    gse_free_vfrag_no_alloc(packet, 1, 0);
+    status = GSE_STATUS_MALLOC_FAILED;
+    goto error;
   }
-  else
+  for(i = 0 ; i < encap->qos_nbr ; i++)
   {
-    gse_free_vfrag(packet);
+    status = gse_init_fifo_watermark(&watermarks[i], i);
+    if(status != GSE_STATUS_OK)
+    {
+      goto release;
+    }
   }
-packet_null:
-  if(extensions != NULL)
+
+  /* The disabled watermarks do not change the state of the FIFOs */
+  for(i = 0 ; i < encap->qos_nbr && status == GSE_STATUS_OK ; i++)
   {
-    free(extensions);
+    status = gse_set_fifo_watermark(&encap->fifo[i], &watermarks[i]);
+    for(modcod = 0 ;
+        encap->modcod_fifo != NULL && modcod < GSE_MODCOD_NBR &&
+        status == GSE_STATUS_OK ;
+        modcod++)
+    {
+      if(encap->modcod_fifo[modcod] != NULL)
+      {
+        status = gse_set_fifo_watermark(&encap->modcod_fifo[modcod][i],
+                                        &watermarks[i]);
+      }
+    }
   }
-error:
-  if(mode != NO_ALLOC && packet != NULL)
+  /* The FIFOs may already use the table, it is kept even on error */
+  __atomic_store_n(&encap->watermarks, watermarks, __ATOMIC_RELEASE);
+  return status;
+
+release:
+  while(i > 0)
   {
-    *packet = NULL;
+    i--;
+    gse_release_fifo_watermark(&watermarks[i]);
   }
+  free(watermarks);
+error:
   return status;
 }
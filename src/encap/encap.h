@@ -54,11 +54,131 @@
 
 #include "virtual_fragment.h"
 #include "encap_header_ext.h"
+#include "bbframe.h"
 
 struct gse_encap_s;
 /** Encapsulation structure type definition */
 typedef struct gse_encap_s gse_encap_t;
 
+struct gse_encap_stream_s;
+/** Type definition of a PDU received in chunks (see \ref gse_encap_open_pdu) */
+typedef struct gse_encap_stream_s gse_encap_stream_t;
+
+struct gse_encap_local_s;
+/** Type definition of the local queues of a producer thread
+ *  (see \ref gse_encap_local_init) */
+typedef struct gse_encap_local_s gse_encap_local_t;
+
+/** Policy used to choose the PDUs when filling a frame
+ *
+ *  @ingroup gse_encap
+ */
+typedef enum
+{
+  /** Fragment the first PDU of the first non-empty FIFO, as successive calls
+   *  to \ref gse_encap_get_packet would do */
+  GSE_FILL_FIFO,
+  /** Send the first PDU that completely fits in the remaining space */
+  GSE_FILL_FIRST_FIT,
+  /** Send the PDU that leaves the least remaining space */
+  GSE_FILL_BEST_FIT,
+} gse_fill_policy_t;
+
+/** Content of a frame filled by \ref gse_encap_fill_frame
+ *
+ *  All the lengths are expressed in bytes, their sum is the frame length.
+ *
+ *  @ingroup gse_encap
+ */
+typedef struct
+{
+  size_t payload_length;     /**< PDU data */
+  size_t header_length;      /**< GSE headers and header extensions */
+  size_t crc_length;         /**< CRC32 of the fragmented PDUs */
+  size_t padding_length;     /**< Unused space at the end of the frame */
+  unsigned int packet_nbr;   /**< Number of GSE packets */
+  unsigned int fragment_nbr; /**< Number of GSE packets carrying a PDU
+                                  fragment */
+} gse_frame_stats_t;
+
+/** Configuration of a token bucket shaper used when filling frames
+ *
+ *  @ingroup gse_encap
+ */
+typedef struct
+{
+  uint32_t committed_rate;   /**< Committed rate (in bytes per second) */
+  uint32_t committed_burst;  /**< Committed burst size (in bytes, not null) */
+  uint32_t peak_rate;        /**< Peak rate (in bytes per second), 0 if no
+                                  data is sent above the committed rate */
+  uint32_t peak_burst;       /**< Peak burst size (in bytes, at least the
+                                  committed burst size if peak_rate is used) */
+} gse_shaper_conf_t;
+
+/** State of a token bucket shaper
+ *
+ *  @ingroup gse_encap
+ */
+typedef struct
+{
+  gse_shaper_conf_t conf;    /**< The shaper configuration */
+  int64_t committed_tokens;  /**< Bytes that can be sent within the committed
+                                  rate, only the green packets are charged
+                                  so it is negative by at most one packet */
+  int64_t peak_tokens;       /**< Bytes that can be sent within the peak rate
+                                  (unused without peak rate) */
+  uint64_t green_bytes;      /**< Bytes of GSE packets sent within the
+                                  committed rate */
+  uint64_t yellow_bytes;     /**< Bytes of GSE packets sent above the
+                                  committed rate */
+  uint64_t held_nbr;         /**< Number of times a PDU was held by the
+                                  shaper, counted once per PDU and per
+                                  filled frame */
+} gse_shaper_state_t;
+
+/**
+ *  @brief   Callback called when a QoS value becomes congested or is no
+ *           longer congested
+ *
+ *  A QoS value is congested while one of its FIFOs is above its high
+ *  watermark, until it goes below its low watermark (see
+ *  \ref gse_encap_set_watermarks). The callback is called with the FIFO
+ *  locked, it shall not call the encapsulation functions but only tell the
+ *  PDU sources to pause or resume.
+ *
+ *  @param   qos        The QoS value
+ *  @param   congested  1 if the QoS value becomes congested, 0 otherwise
+ *  @param   opaque     The user specific data
+ *
+ *  @ingroup gse_encap
+ */
+typedef void (*gse_encap_watermark_cb_t)(uint8_t qos, int congested,
+                                         void *opaque);
+
+/** The maximum number of I/O vectors of a GSE packet
+ *
+ *  @ingroup gse_encap
+ */
+#define GSE_ENCAP_IOV_MAX 16
+
+/** GSE packet described by I/O vectors
+ *
+ *  The packet refers to the data of the PDU, it shall be released with
+ *  \ref gse_encap_release_iov_packet once sent.
+ *
+ *  @ingroup gse_encap
+ */
+typedef struct
+{
+  struct iovec iov[GSE_ENCAP_IOV_MAX]; /**< The parts of the packet */
+  unsigned int iov_nbr;      /**< The number of parts */
+  size_t length;             /**< The length of the packet */
+  unsigned char header[GSE_MAX_HEADER_LENGTH]; /**< The GSE header of a
+                                                    packet of a chained PDU */
+  gse_vfrag_chain_t *chain;  /**< The chain the packet refers to, if any */
+  gse_vfrag_t *vfrag;        /**< The fragment holding the packet, if any */
+} gse_encap_iov_packet_t;
+
 /**
  * @defgroup gse_encap GSE encapsulation API
  */
@@ -131,6 +251,82 @@ gse_status_t gse_encap_release(gse_encap_t *encap);
 gse_status_t gse_encap_set_offsets(gse_encap_t *encap,
                                    size_t head_offset, size_t trail_offset);
 
+/**
+ *  @brief   Enable the interleaved fragmentation of PDUs sharing a QoS
+ *
+ *  By default the QoS value is used as FragID, so only one PDU per FIFO can be
+ *  in fragmentation at a time and a large PDU delays all the PDUs queued
+ *  behind it.\n
+ *  Once enabled, FragID values are taken from a pool of frag_id_nbr values
+ *  shared by all the FIFOs and released with the last fragment of the PDU.
+ *  The first window PDUs of a FIFO are then candidates for the next GSE packet:
+ *  a PDU which can be completely sent in the packet is chosen first, else the
+ *  PDU with the least remaining data. Up to window PDUs of a FIFO can be
+ *  fragmented at the same time and a PDU in fragmentation cannot be skipped
+ *  more than window times in a row.\n
+ *  The deencapsulation structure of the receiver shall handle at least
+ *  frag_id_nbr FragID values (see \ref gse_deencap_init).\n
+ *  The function shall be called while all the FIFOs are empty.
+ *
+ *  @param   encap        Encapsulation structure
+ *  @param   frag_id_nbr  The number of FragID values in the pool (at most 256),
+ *                        0 to use the QoS value as FragID again
+ *  @param   window       The number of PDUs of a FIFO that can be considered
+ *                        for the next GSE packet (0 is handled as 1)
+ *
+ *  @return
+ *                        - success/informative code among:
+ *                          - \ref GSE_STATUS_OK
+ *                        - warning/error code among:
+ *                          - \ref GSE_STATUS_NULL_PTR
+ *                          - \ref GSE_STATUS_INVALID_FRAG_ID_NBR
+ *                          - \ref GSE_STATUS_FIFO_NOT_EMPTY
+ *                          - \ref GSE_STATUS_PTHREAD_MUTEX
+ *
+ *  @ingroup gse_encap
+ */
+gse_status_t gse_encap_set_frag_id_pool(gse_encap_t *encap,
+                                        unsigned int frag_id_nbr,
+                                        unsigned int window);
+
+/**
+ *  @brief   Enable the fair queuing of the flows sharing a QoS
+ *
+ *  By default each FIFO is served in order, so a flow with a high rate delays
+ *  all the other flows of the same QoS value.\n
+ *  Once enabled, the PDUs of each FIFO are hashed in flow_nbr flows according
+ *  to their label and to the flow key given to
+ *  \ref gse_encap_receive_pdu_flow. The flows are served with Deficit Round
+ *  Robin: each flow sends about quantum bytes of GSE packets in its turn. The
+ *  flows whose hash collide share their turn, so the memory used does not
+ *  depend on the number of flows.\n
+ *  Without FragID pool, a flow keeps its turn until the end of a PDU in
+ *  fragmentation. With a FragID pool, the PDUs of several flows can be in
+ *  fragmentation at the same time and the window of
+ *  \ref gse_encap_set_frag_id_pool is not used. The frame filler may still
+ *  send a PDU which fits in the frame out of turn, it is then accounted in
+ *  the deficit of its flow.\n
+ *  The function shall be called while all the FIFOs are empty.
+ *
+ *  @param   encap     Encapsulation structure
+ *  @param   flow_nbr  The number of flows per FIFO, 0 to disable fair queuing
+ *  @param   quantum   The number of bytes sent by a flow in its turn
+ *                     (0 for the default value: 1500)
+ *
+ *  @return
+ *                     - success/informative code among:
+ *                       - \ref GSE_STATUS_OK
+ *                     - warning/error code among:
+ *                       - \ref GSE_STATUS_NULL_PTR
+ *                       - \ref GSE_STATUS_FIFO_NOT_EMPTY
+ *                       - \ref GSE_STATUS_MALLOC_FAILED
+ *                       - \ref GSE_STATUS_PTHREAD_MUTEX
+ *
+ *  @ingroup gse_encap
+ */
+gse_status_t gse_encap_set_flow_queuing(gse_encap_t *encap, uint16_t flow_nbr,
+                                        unsigned int quantum);
+
 /* Encapsulation functions */
 
 /**
@@ -169,6 +365,289 @@ gse_status_t gse_encap_receive_pdu(gse_vfrag_t *pdu, gse_encap_t *encap,
                                    uint8_t label[6], uint8_t label_type,
                                    uint16_t protocol, uint8_t qos);
 
+/**
+ *  @brief   Receive a PDU of a given flow which is stored in a virtual buffer
+ *
+ *  This function is similar to \ref gse_encap_receive_pdu, the flow key is
+ *  combined with the label to select the flow of the PDU when fair queuing is
+ *  enabled (see \ref gse_encap_set_flow_queuing).
+ *  \ref gse_encap_receive_pdu uses a null flow key, so the flows are the
+ *  labels.
+ *
+ *  @warning In case of warning or error, the PDU is destroyed.
+ *
+ *  @param   pdu            The PDU to encapsulate
+ *  @param   encap          The encapsulation context structure
+ *  @param   label          The packet label
+ *  @param   label_type     The label type field value
+ *  @param   protocol       The PDU protocol
+ *  @param   qos            The QoS value of the PDU
+ *  @param   flow_key       The flow key chosen by the user (a hash of the
+ *                          PDU addresses and ports for example)
+ *
+ *  @return                 The same codes as \ref gse_encap_receive_pdu
+ *
+ *  @ingroup gse_encap
+ */
+gse_status_t gse_encap_receive_pdu_flow(gse_vfrag_t *pdu, gse_encap_t *encap,
+                                        uint8_t label[6], uint8_t label_type,
+                                        uint16_t protocol, uint8_t qos,
+                                        uint32_t flow_key);
+
+/**
+ *  @brief   Receive a PDU whose data is spread over a chain of virtual
+ *           fragments
+ *
+ *  The segments are not copied when the packets are got with
+ *  \ref gse_encap_get_packet_iov: the GSE header and the CRC are stored
+ *  apart and the fragments refer to the segments. The other functions
+ *  building packets copy the data as for a contiguous PDU; the whole PDU
+ *  is copied once if the packets are got with
+ *  \ref gse_encap_get_packet, \ref gse_encap_get_packet_no_alloc or if
+ *  header extensions are added.\n
+ *  A chain of one segment with room for the GSE header and the CRC is
+ *  received as a contiguous PDU.
+ *
+ *  @warning In case of warning or error, the chain is destroyed.
+ *
+ *  @param   pdu            The chain holding the PDU to encapsulate
+ *  @param   encap          The encapsulation context structure
+ *  @param   label          The packet label
+ *  @param   label_type     The label type field value
+ *  @param   protocol       The PDU protocol
+ *  @param   qos            The QoS value of the PDU
+ *  @param   flow_key       The flow key chosen by the user
+ *                          (see \ref gse_encap_receive_pdu_flow)
+ *
+ *  @return                 The same codes as \ref gse_encap_receive_pdu and
+ *                          \ref GSE_STATUS_EMPTY_FRAG
+ *
+ *  @ingroup gse_encap
+ */
+gse_status_t gse_encap_receive_pdu_chain(gse_vfrag_chain_t *pdu,
+                                         gse_encap_t *encap,
+                                         uint8_t label[6], uint8_t label_type,
+                                         uint16_t protocol, uint8_t qos,
+                                         uint32_t flow_key);
+
+/**
+ *  @brief   Create the local queues of a producer thread
+ *
+ *  When several threads receive PDUs, each push locks the FIFO of the QoS
+ *  value shared with the other threads and the thread building the packets.
+ *  A thread may rather stage its PDUs in local queues, one per QoS value,
+ *  with \ref gse_encap_local_receive_pdu. The PDUs of a local queue are
+ *  pushed together, under a single lock of their FIFO, once size PDUs are
+ *  staged or when \ref gse_encap_local_flush is called.\n
+ *  The PDUs of a thread keep their order in each FIFO. A staged PDU is not
+ *  seen by the functions building packets until it is pushed, the thread
+ *  should thus flush its queues when it has no more PDU to receive.\n
+ *  The local queues are not protected by any mutex, they shall only be used
+ *  by the thread that owns them and be released before the encapsulation
+ *  structure.
+ *
+ *  @param   encap   The encapsulation structure
+ *  @param   size    The size of each local queue, the number of PDUs pushed
+ *                   at once
+ *  @param   local   OUT: The local queues
+ *
+ *  @return
+ *                   - success/informative code among:
+ *                     - \ref GSE_STATUS_OK
+ *                   - warning/error code among:
+ *                     - \ref GSE_STATUS_NULL_PTR
+ *                     - \ref GSE_STATUS_FIFO_SIZE_NULL
+ *                     - \ref GSE_STATUS_MALLOC_FAILED
+ *
+ *  @ingroup gse_encap
+ */
+gse_status_t gse_encap_local_init(gse_encap_t *encap, unsigned int size,
+                                  gse_encap_local_t **local);
+
+/**
+ *  @brief   Release the local queues of a producer thread
+ *
+ *  The PDUs still staged are destroyed, the queues should be flushed with
+ *  \ref gse_encap_local_flush before.
+ *
+ *  @param   local   The local queues
+ *
+ *  @return
+ *                   - success/informative code among:
+ *                     - \ref GSE_STATUS_OK
+ *                   - warning/error code among:
+ *                     - \ref GSE_STATUS_NULL_PTR
+ *                     - \ref GSE_STATUS_FRAG_NBR
+ *
+ *  @ingroup gse_encap
+ */
+gse_status_t gse_encap_local_release(gse_encap_local_t *local);
+
+/**
+ *  @brief   Stage a PDU in the local queue of its QoS value
+ *
+ *  The PDU is checked as with \ref gse_encap_receive_pdu_flow. If its local
+ *  queue is full, the staged PDUs are pushed first. The local queue is
+ *  pushed in the FIFOs once it is full, the PDUs that do not fit in their
+ *  FIFO stay staged.
+ *
+ *  @warning In case of warning or error, the PDU is destroyed.
+ *
+ *  @param   pdu            The PDU to encapsulate
+ *  @param   local          The local queues of the calling thread
+ *  @param   label          The packet label
+ *  @param   label_type     The label type field value
+ *  @param   protocol       The PDU protocol
+ *  @param   qos            The QoS value of the PDU
+ *  @param   flow_key       The flow key chosen by the user
+ *                          (see \ref gse_encap_receive_pdu_flow)
+ *
+ *  @return                 The same codes as \ref gse_encap_receive_pdu,
+ *                          \ref GSE_STATUS_FIFO_FULL is returned when the
+ *                          local queue is full and cannot be pushed
+ *
+ *  @ingroup gse_encap
+ */
+gse_status_t gse_encap_local_receive_pdu(gse_vfrag_t *pdu,
+                                         gse_encap_local_t *local,
+                                         uint8_t label[6], uint8_t label_type,
+                                         uint16_t protocol, uint8_t qos,
+                                         uint32_t flow_key);
+
+/**
+ *  @brief   Push the PDUs staged in the local queues in the FIFOs
+ *
+ *  The PDUs that do not fit in their FIFO stay staged in order, a full FIFO
+ *  does not prevent the other QoS values from being pushed.
+ *
+ *  @param   local   The local queues
+ *
+ *  @return
+ *                   - success/informative code among:
+ *                     - \ref GSE_STATUS_OK
+ *                   - warning/error code among:
+ *                     - \ref GSE_STATUS_NULL_PTR
+ *                     - \ref GSE_STATUS_PTHREAD_MUTEX
+ *                     - \ref GSE_STATUS_FIFO_FULL
+ *                     - \ref GSE_STATUS_MALLOC_FAILED
+ *
+ *  @ingroup gse_encap
+ */
+gse_status_t gse_encap_local_flush(gse_encap_local_t *local);
+
+/**
+ *  @brief   Get the number of PDUs staged in a local queue
+ *
+ *  @param   local    The local queues
+ *  @param   qos      The QoS value
+ *  @param   elt_nbr  OUT: The number of PDUs staged for the QoS value
+ *
+ *  @return
+ *                    - success/informative code among:
+ *                      - \ref GSE_STATUS_OK
+ *                    - warning/error code among:
+ *                      - \ref GSE_STATUS_NULL_PTR
+ *                      - \ref GSE_STATUS_INVALID_QOS
+ *
+ *  @ingroup gse_encap
+ */
+gse_status_t gse_encap_local_get_nbr(gse_encap_local_t *local, uint8_t qos,
+                                     unsigned int *elt_nbr);
+
+/**
+ *  @brief   Open a PDU whose data will be received in several chunks
+ *
+ *  The PDU is placed in the FIFO before its data is received, so GSE packets
+ *  can be built as soon as its first chunk is appended with
+ *  \ref gse_encap_append_pdu instead of waiting for the whole PDU.\n
+ *  A PDU whose end is still missing is fragmented and its CRC is computed
+ *  as the data arrives. Its last fragment is built once all its data has
+ *  been appended.\n
+ *  Without FragID pool, the other PDUs of the FIFO wait for the end of the
+ *  fragmented PDU.\n
+ *  The PDU shall be completed or aborted with \ref gse_encap_abort_pdu. The
+ *  stream cannot be used once its last chunk is appended.
+ *
+ *  @warning The PDUs received in chunks cannot be used with
+ *           \ref gse_encap_get_packet_no_alloc.
+ *
+ *  @param   encap          The encapsulation context structure
+ *  @param   pdu_length     The length of the whole PDU (in bytes)
+ *  @param   label          The packet label
+ *  @param   label_type     The label type field value
+ *  @param   protocol       The PDU protocol
+ *  @param   qos            The QoS value of the PDU
+ *  @param   flow_key       The flow key chosen by the user
+ *                          (see \ref gse_encap_receive_pdu_flow)
+ *  @param   stream         OUT: The stream used to append the PDU data
+ *                               on success, NULL on error
+ *
+ *  @return
+ *                          - success/informative code among:
+ *                            - \ref GSE_STATUS_OK
+ *                          - warning/error code among:
+ *                            - \ref GSE_STATUS_NULL_PTR
+ *                            - \ref GSE_STATUS_BUFF_LENGTH_NULL
+ *                            - \ref GSE_STATUS_MALLOC_FAILED
+ *                            - \ref GSE_STATUS_INVALID_LT
+ *                            - \ref GSE_STATUS_PDU_LENGTH
+ *                            - \ref GSE_STATUS_INVALID_QOS
+ *                            - \ref GSE_STATUS_PTHREAD_MUTEX
+ *                            - \ref GSE_STATUS_FIFO_FULL
+ *                            - \ref GSE_STATUS_WRONG_PROTOCOL
+ *
+ *  @ingroup gse_encap
+ */
+gse_status_t gse_encap_open_pdu(gse_encap_t *encap, size_t pdu_length,
+                                uint8_t label[6], uint8_t label_type,
+                                uint16_t protocol, uint8_t qos,
+                                uint32_t flow_key, gse_encap_stream_t **stream);
+
+/**
+ *  @brief   Append a chunk of data to a PDU opened with
+ *           \ref gse_encap_open_pdu
+ *
+ *  The data is copied at the end of the PDU. The PDU is complete once
+ *  the length given on opening is reached, the stream is then released.
+ *
+ *  @param   stream         The stream of the PDU
+ *  @param   data           The data to append
+ *  @param   length         The length of the data (in bytes)
+ *
+ *  @return
+ *                          - success/informative code among:
+ *                            - \ref GSE_STATUS_OK
+ *                          - warning/error code among:
+ *                            - \ref GSE_STATUS_NULL_PTR
+ *                            - \ref GSE_STATUS_DATA_TOO_LONG
+ *                            - \ref GSE_STATUS_PDU_ABORTED
+ *                            - \ref GSE_STATUS_PTHREAD_MUTEX
+ *
+ *  @ingroup gse_encap
+ */
+gse_status_t gse_encap_append_pdu(gse_encap_stream_t *stream,
+                                  const unsigned char *data, size_t length);
+
+/**
+ *  @brief   Abort a PDU opened with \ref gse_encap_open_pdu
+ *
+ *  The PDU is dropped from its FIFO and the stream is released. If some
+ *  fragments were already sent, the receiver drops the partial PDU when its
+ *  FragID is reused.
+ *
+ *  @param   stream         The stream of the PDU
+ *
+ *  @return
+ *                          - success/informative code among:
+ *                            - \ref GSE_STATUS_OK
+ *                          - warning/error code among:
+ *                            - \ref GSE_STATUS_NULL_PTR
+ *                            - \ref GSE_STATUS_PTHREAD_MUTEX
+ *
+ *  @ingroup gse_encap
+ */
+gse_status_t gse_encap_abort_pdu(gse_encap_stream_t *stream);
+
 /**
  *  @brief   Get a GSE packet from the encapsulation context structure
  *
@@ -203,6 +682,8 @@ gse_status_t gse_encap_receive_pdu(gse_vfrag_t *pdu, gse_encap_t *encap,
  *                             - \ref GSE_STATUS_EMPTY_FRAG
  *                             - \ref GSE_STATUS_FRAG_NBR
  *                             - \ref GSE_STATUS_EXTENSION_CB_FAILED
+ *                             - \ref GSE_STATUS_FRAG_ID_EXHAUSTED
+ *                             - \ref GSE_STATUS_PDU_NOT_READY
  *
  *  @ingroup gse_encap
  */
@@ -244,6 +725,8 @@ gse_status_t gse_encap_get_packet(gse_vfrag_t **packet, gse_encap_t *encap,
  *                             - \ref GSE_STATUS_EMPTY_FRAG
  *                             - \ref GSE_STATUS_FRAG_NBR
  *                             - \ref GSE_STATUS_EXTENSION_CB_FAILED
+ *                             - \ref GSE_STATUS_FRAG_ID_EXHAUSTED
+ *                             - \ref GSE_STATUS_PDU_NOT_READY
  *
  *  @ingroup gse_encap
  */
@@ -285,6 +768,7 @@ gse_status_t gse_encap_get_packet_copy(gse_vfrag_t **packet, gse_encap_t *encap,
  *                             - \ref GSE_STATUS_EMPTY_FRAG
  *                             - \ref GSE_STATUS_FRAG_NBR
  *                             - \ref GSE_STATUS_EXTENSION_CB_FAILED
+ *                             - \ref GSE_STATUS_FRAG_ID_EXHAUSTED
  *
  *  @ingroup gse_encap
  */
@@ -293,6 +777,49 @@ gse_status_t gse_encap_get_packet_no_alloc(gse_vfrag_t **packet, gse_encap_t *en
 gse_status_t gse_encap_get_packet_no_alloc_old(gse_vfrag_t *packet, gse_encap_t *encap,
                                            size_t desired_length, uint8_t qos);
 
+/**
+ *  @brief   Get a GSE packet from the encapsulation context structure -
+ *           Scatter-gather mode
+ *
+ *  The packet is described by I/O vectors referring to the PDU data, ready
+ *  for writev() or for a NIC descriptor list. The packet of a chained PDU
+ *  starts with its header, then the parts of the segments and the CRC. A
+ *  packet covers at most \ref GSE_ENCAP_IOV_MAX - 1 parts of segments, the
+ *  PDU is fragmented if more are needed. A packet of a contiguous PDU is
+ *  one vector.
+ *
+ *  @param   packet          OUT: The GSE packet on success, to release with
+ *                                \ref gse_encap_release_iov_packet
+ *  @param   encap           The encapsulation context structure
+ *  @param   desired_length  The desired length for the packet (in bytes)
+ *  @param   qos             The QoS of the packet
+ *
+ *  @return                  The same codes as \ref gse_encap_get_packet
+ *
+ *  @ingroup gse_encap
+ */
+gse_status_t gse_encap_get_packet_iov(gse_encap_iov_packet_t *packet,
+                                      gse_encap_t *encap,
+                                      size_t desired_length, uint8_t qos);
+
+/**
+ *  @brief   Release a GSE packet got with \ref gse_encap_get_packet_iov
+ *
+ *  The PDU data is freed with its last packet.
+ *
+ *  @param   packet  The GSE packet
+ *
+ *  @return
+ *                   - success/informative code among:
+ *                     - \ref GSE_STATUS_OK
+ *                   - warning/error code among:
+ *                     - \ref GSE_STATUS_NULL_PTR
+ *                     - \ref GSE_STATUS_FRAG_NBR
+ *
+ *  @ingroup gse_encap
+ */
+gse_status_t gse_encap_release_iov_packet(gse_encap_iov_packet_t *packet);
+
 /**
  *  @brief  Set the callback that build header extensions
  *
@@ -311,4 +838,552 @@ gse_status_t gse_encap_set_extension_callback(gse_encap_t *encap,
                                               gse_encap_build_header_ext_cb_t callback,
                                               void *opaque);
 
+/**
+ *  @brief   Set the number of threads computing the CRC32 of large PDUs
+ *
+ *  The CRC32 of a fragmented PDU is computed when its first fragment is
+ *  built. For PDUs of at least min_length bytes, the PDU is split in
+ *  worker_nbr chunks whose CRC32 are computed by parallel threads and
+ *  combined afterwards. The smaller PDUs and the PDUs sent while another
+ *  thread uses the CRC32 threads are computed by the calling thread alone.\n
+ *  The number of threads is limited to the number of online CPUs, so no
+ *  thread is created on a single CPU where they only add the cost of their
+ *  wake-up.\n
+ *  The default minimum length comes from app/performance/eval_gse_crc: the
+ *  serial CRC32 costs about 3.2 ns per byte and giving a PDU to the threads
+ *  5 to 8 us, so 2 threads only save time above about 4 KB. At 16 KB they
+ *  save about 20 us per PDU, which also covers the wake-up of an idle CPU.\n
+ *  The threads are created by this call and wait for the PDUs until the
+ *  next call or \ref gse_encap_release. This function shall not be called
+ *  while packets are built. If a thread cannot be created, the CRC32 is
+ *  computed by the threads already created.
+ *
+ *  @param   encap       Encapsulation structure
+ *  @param   worker_nbr  The number of threads including the calling one
+ *                       (0 is handled as 1, at most 16 and the number of
+ *                       online CPUs, default: 1)
+ *  @param   min_length  The minimum length of the PDUs whose CRC32 is
+ *                       computed in parallel (0 for the default: 16384)
+ *
+ *  @return
+ *                       - success/informative code among:
+ *                         - \ref GSE_STATUS_OK
+ *                       - warning/error code among:
+ *                         - \ref GSE_STATUS_NULL_PTR
+ *                         - \ref GSE_STATUS_MALLOC_FAILED
+ *                         - \ref GSE_STATUS_PTHREAD_MUTEX
+ *
+ *  @ingroup gse_encap
+ */
+gse_status_t gse_encap_set_crc_workers(gse_encap_t *encap,
+                                       unsigned int worker_nbr,
+                                       size_t min_length);
+
+/* Flow control functions */
+
+/**
+ *  @brief   Set the watermarks of the FIFOs of a QoS value
+ *
+ *  A FIFO becomes congested when it holds at least high_pdu_nbr PDUs or
+ *  high_length bytes, it is no longer congested once it holds at most
+ *  low_pdu_nbr PDUs and low_length bytes. The bytes are those of the Total
+ *  Length fields of the PDUs. The watermarks apply to the default FIFO of
+ *  the QoS value and to those of the modcod groups.\n
+ *  The PDU sources can then pause before the FIFO is full instead of losing
+ *  PDUs with \ref GSE_STATUS_FIFO_FULL. They are told by the callback set
+ *  with \ref gse_encap_set_watermark_callback or can check
+ *  \ref gse_encap_is_congested.
+ *
+ *  @param   encap         The encapsulation context structure
+ *  @param   qos           The QoS value
+ *  @param   high_pdu_nbr  The high watermark in PDUs, 0 to disable it
+ *  @param   low_pdu_nbr   The low watermark in PDUs
+ *                         (lowered below high_pdu_nbr if needed)
+ *  @param   high_length   The high watermark in bytes, 0 to disable it
+ *  @param   low_length    The low watermark in bytes
+ *                         (lowered below high_length if needed)
+ *
+ *  @return
+ *                         - success/informative code among:
+ *                           - \ref GSE_STATUS_OK
+ *                         - warning/error code among:
+ *                           - \ref GSE_STATUS_NULL_PTR
+ *                           - \ref GSE_STATUS_INVALID_QOS
+ *                           - \ref GSE_STATUS_PTHREAD_MUTEX
+ *                           - \ref GSE_STATUS_MALLOC_FAILED
+ *
+ *  @ingroup gse_encap
+ */
+gse_status_t gse_encap_set_watermarks(gse_encap_t *encap, uint8_t qos,
+                                      unsigned int high_pdu_nbr,
+                                      unsigned int low_pdu_nbr,
+                                      size_t high_length, size_t low_length);
+
+/**
+ *  @brief   Set the callback called when a QoS value becomes congested or
+ *           is no longer congested
+ *
+ *  @param   encap     The encapsulation context structure
+ *  @param   callback  The callback, NULL to remove it
+ *  @param   opaque    The user specific data given to the callback
+ *
+ *  @return
+ *                     - success/informative code among:
+ *                       - \ref GSE_STATUS_OK
+ *                     - warning/error code among:
+ *                       - \ref GSE_STATUS_NULL_PTR
+ *                       - \ref GSE_STATUS_PTHREAD_MUTEX
+ *                       - \ref GSE_STATUS_MALLOC_FAILED
+ *
+ *  @ingroup gse_encap
+ */
+gse_status_t gse_encap_set_watermark_callback(gse_encap_t *encap,
+                                              gse_encap_watermark_cb_t callback,
+                                              void *opaque);
+
+/**
+ *  @brief   Check whether a QoS value is congested
+ *
+ *  No lock is taken, the PDU sources can check it before each PDU.
+ *
+ *  @param   encap  The encapsulation context structure
+ *  @param   qos    The QoS value
+ *
+ *  @return         1 if a FIFO of the QoS value is above its high watermark,
+ *                  0 otherwise or if the parameters are invalid
+ *
+ *  @ingroup gse_encap
+ */
+int gse_encap_is_congested(gse_encap_t *encap, uint8_t qos);
+
+/* Notification functions */
+
+/**
+ *  @brief   Get an eventfd readable when a FIFO of the encapsulation becomes
+ *           non empty
+ *
+ *  The eventfd is created on the first call and closed on release, it is
+ *  shared by all the FIFOs including those of the modcod groups. It is only
+ *  written when a PDU is received in an empty FIFO, so the reader shall
+ *  read the eventfd then get packets until the FIFOs are empty before
+ *  waiting for it again.\n
+ *  The eventfd can be given to poll, select or epoll along with the other
+ *  file descriptors of the scheduler.
+ *
+ *  @param   encap  The encapsulation context structure
+ *  @param   fd     OUT: The eventfd (non blocking)
+ *
+ *  @return
+ *                  - success/informative code among:
+ *                    - \ref GSE_STATUS_OK
+ *                  - warning/error code among:
+ *                    - \ref GSE_STATUS_NULL_PTR
+ *                    - \ref GSE_STATUS_PTHREAD_MUTEX
+ *                    - \ref GSE_STATUS_EVENT_FAILED
+ *
+ *  @ingroup gse_encap
+ */
+gse_status_t gse_encap_get_event_fd(gse_encap_t *encap, int *fd);
+
+/**
+ *  @brief   Wait until the FIFO of a QoS value is not empty
+ *
+ *  The thread sleeps on a futex woken up by the reception of a PDU, it does
+ *  not need an eventfd. The receiving threads only pay a system call when a
+ *  thread is waiting. Only the default FIFOs are watched, the FIFOs of the
+ *  modcod groups are watched with \ref gse_encap_wait_pdu_modcod.\n
+ *  A PDU received in chunks wakes up the thread as soon as it is opened,
+ *  \ref gse_encap_get_packet may then return \ref GSE_STATUS_PDU_NOT_READY.
+ *
+ *  @param   encap    The encapsulation context structure
+ *  @param   qos      The QoS value of the FIFO
+ *  @param   timeout  The maximum waiting time (in microseconds),
+ *                    0 to only check the FIFO
+ *
+ *  @return
+ *                    - success/informative code among:
+ *                      - \ref GSE_STATUS_OK
+ *                    - warning/error code among:
+ *                      - \ref GSE_STATUS_NULL_PTR
+ *                      - \ref GSE_STATUS_INVALID_QOS
+ *                      - \ref GSE_STATUS_PTHREAD_MUTEX
+ *                      - \ref GSE_STATUS_FIFO_EMPTY (timeout)
+ *                      - \ref GSE_STATUS_EVENT_FAILED
+ *
+ *  @ingroup gse_encap
+ */
+gse_status_t gse_encap_wait_pdu(gse_encap_t *encap, uint8_t qos,
+                                unsigned int timeout);
+
+/**
+ *  @brief   Wait until the FIFO of a QoS value of a modcod group is not empty
+ *
+ *  The thread sleeps as with \ref gse_encap_wait_pdu, it is woken up by the
+ *  reception of a PDU whose label is associated to the modcod group (see
+ *  \ref gse_encap_set_label_modcod). The thread may wait before the first
+ *  label is associated to the group.
+ *
+ *  @param   encap    The encapsulation context structure
+ *  @param   modcod   The modcod group
+ *  @param   qos      The QoS value of the FIFO
+ *  @param   timeout  The maximum waiting time (in microseconds),
+ *                    0 to only check the FIFO
+ *
+ *  @return
+ *                    - success/informative code among:
+ *                      - \ref GSE_STATUS_OK
+ *                    - warning/error code among:
+ *                      - \ref GSE_STATUS_NULL_PTR
+ *                      - \ref GSE_STATUS_INVALID_QOS
+ *                      - \ref GSE_STATUS_PTHREAD_MUTEX
+ *                      - \ref GSE_STATUS_MALLOC_FAILED
+ *                      - \ref GSE_STATUS_FIFO_EMPTY (timeout)
+ *                      - \ref GSE_STATUS_EVENT_FAILED
+ *
+ *  @ingroup gse_encap
+ */
+gse_status_t gse_encap_wait_pdu_modcod(gse_encap_t *encap, uint8_t modcod,
+                                       uint8_t qos, unsigned int timeout);
+
+/* Frame filling functions */
+
+/**
+ *  @brief   Set the number of PDUs of a FIFO considered when filling a frame
+ *
+ *  @param   encap   Encapsulation structure
+ *  @param   window  The number of PDUs (0 is handled as 1, default: 16)
+ *
+ *  @return
+ *                   - success/informative code among:
+ *                     - \ref GSE_STATUS_OK
+ *                   - warning/error code among:
+ *                     - \ref GSE_STATUS_NULL_PTR
+ *
+ *  @ingroup gse_encap
+ */
+gse_status_t gse_encap_set_fill_window(gse_encap_t *encap, unsigned int window);
+
+/**
+ *  @brief   Fill a frame with GSE packets
+ *
+ *  The FIFOs are served by QoS value order, the lowest value has the highest
+ *  priority. With the first fit and best fit policies, the PDUs that can be
+ *  completely sent in the remaining space of the frame are chosen first among
+ *  the first PDUs of each FIFO (see \ref gse_encap_set_fill_window), so
+ *  fragmentation, with its headers and CRC, is only used to fill the end of
+ *  the frame. A PDU of a FIFO of lower priority may thus be sent before the
+ *  start of a PDU of higher priority that does not fit in the frame.\n
+ *  PDUs needing header extensions are never chosen to fill the frame as their
+ *  length is unknown before the extension callback is called.\n
+ *  The end of the frame that does not contain GSE packets is filled with
+ *  padding (zeros).\n
+ *  The shapers are respected as described for
+ *  \ref gse_encap_set_qos_shaper.
+ *
+ *  @param   encap         Encapsulation structure
+ *  @param   policy        The policy used to choose the PDUs
+ *  @param   frame         The frame to fill
+ *  @param   frame_length  The frame length (in bytes)
+ *  @param   data_length   OUT: The length of the GSE packets in the frame,
+ *                              the packets written before an error are kept
+ *  @param   stats         OUT: The content of the frame (may be NULL)
+ *
+ *  @return
+ *                         - success/informative code among:
+ *                           - \ref GSE_STATUS_OK
+ *                         - warning/error code among:
+ *                           - \ref GSE_STATUS_NULL_PTR
+ *                           - \ref GSE_STATUS_FIFO_EMPTY
+ *                           - \ref GSE_STATUS_RATE_LIMITED
+ *                           - \ref GSE_STATUS_PDU_NOT_READY
+ *                           - \ref GSE_STATUS_PTHREAD_MUTEX
+ *                           - \ref GSE_STATUS_INTERNAL_ERROR
+ *                           - \ref GSE_STATUS_PTR_OUTSIDE_BUFF
+ *                           - \ref GSE_STATUS_FRAG_PTRS
+ *                           - \ref GSE_STATUS_INVALID_GSE_LENGTH
+ *                           - \ref GSE_STATUS_EXTENSION_CB_FAILED
+ *                           - \ref GSE_STATUS_INVALID_EXTENSIONS
+ *                           - \ref GSE_STATUS_PDU_LENGTH
+ *
+ *  @ingroup gse_encap
+ */
+gse_status_t gse_encap_fill_frame(gse_encap_t *encap,
+                                  gse_fill_policy_t policy,
+                                  unsigned char *frame, size_t frame_length,
+                                  size_t *data_length,
+                                  gse_frame_stats_t *stats);
+
+/**
+ *  @brief   Fill a BBFrame with GSE packets and write its BBHEADER
+ *
+ *  The data field of the BBFrame is filled as with
+ *  \ref gse_encap_fill_frame, then the BBHEADER is written at the beginning
+ *  of the BBFrame with the Data Field Length of the GSE packets. The end of
+ *  the BBFrame is the BBFrame padding.
+ *
+ *  @param   encap           Encapsulation structure
+ *  @param   policy          The policy used to choose the PDUs
+ *  @param   bbheader        The BBHEADER fields, the DFL field is ignored
+ *  @param   bbframe         The BBFrame to fill
+ *  @param   bbframe_length  The BBFrame length, i.e. Kbch/8 (in bytes)
+ *  @param   data_length     OUT: The length of the GSE packets in the BBFrame
+ *  @param   stats           OUT: The content of the data field (may be NULL)
+ *
+ *  @return
+ *                           - \ref GSE_STATUS_INVALID_BBFRAME_LENGTH if the
+ *                             BBFrame is shorter than the BBHEADER or longer
+ *                             than GSE_MAX_BBFRAME_LENGTH
+ *                           - otherwise the same codes as
+ *                             \ref gse_encap_fill_frame, the BBHEADER is
+ *                             written whatever the code is
+ *
+ *  @ingroup gse_encap
+ */
+gse_status_t gse_encap_fill_bbframe(gse_encap_t *encap,
+                                    gse_fill_policy_t policy,
+                                    const gse_bbheader_t *bbheader,
+                                    unsigned char *bbframe,
+                                    size_t bbframe_length,
+                                    size_t *data_length,
+                                    gse_frame_stats_t *stats);
+
+/* Shaping functions */
+
+/**
+ *  @brief   Set the shaper of a QoS value
+ *
+ *  The shapers are used by the frame filling functions only
+ *  (\ref gse_encap_fill_frame and \ref gse_encap_fill_frame_modcod). A PDU
+ *  is green if the shapers of its QoS value and of its label have committed
+ *  tokens left, yellow if they only have peak tokens left and red otherwise.
+ *  The frame is filled with the green PDUs first, then the remaining space
+ *  is filled with the yellow ones. The red PDUs are held in their FIFO until
+ *  the shapers are refilled (see \ref gse_encap_refill_shapers) while the
+ *  PDUs of the other labels placed after them are sent. A PDU in
+ *  fragmentation is never held so its receiver can reassemble it.\n
+ *  The shapers are charged with the length of the GSE packets, so the
+ *  headers are part of the rate. Setting a shaper fills its buckets.
+ *
+ *  @param   encap  Encapsulation structure
+ *  @param   qos    The QoS value
+ *  @param   conf   The shaper configuration, NULL to remove the shaper
+ *
+ *  @return
+ *                  - success/informative code among:
+ *                    - \ref GSE_STATUS_OK
+ *                  - warning/error code among:
+ *                    - \ref GSE_STATUS_NULL_PTR
+ *                    - \ref GSE_STATUS_INVALID_QOS
+ *                    - \ref GSE_STATUS_INVALID_SHAPER
+ *                    - \ref GSE_STATUS_NO_SHAPER
+ *                    - \ref GSE_STATUS_MALLOC_FAILED
+ *                    - \ref GSE_STATUS_PTHREAD_MUTEX
+ *
+ *  @ingroup gse_encap
+ */
+gse_status_t gse_encap_set_qos_shaper(gse_encap_t *encap, uint8_t qos,
+                                      const gse_shaper_conf_t *conf);
+
+/**
+ *  @brief   Set the shaper of a label
+ *
+ *  The shaper is used as described for \ref gse_encap_set_qos_shaper, it
+ *  applies to the PDUs of the label whatever their QoS value.
+ *
+ *  @param   encap       Encapsulation structure
+ *  @param   label       The label
+ *  @param   label_type  The label type (re-use is not allowed)
+ *  @param   conf        The shaper configuration, NULL to remove the shaper
+ *
+ *  @return
+ *                       - success/informative code among:
+ *                         - \ref GSE_STATUS_OK
+ *                       - warning/error code among:
+ *                         - \ref GSE_STATUS_NULL_PTR
+ *                         - \ref GSE_STATUS_INVALID_LT
+ *                         - \ref GSE_STATUS_INVALID_SHAPER
+ *                         - \ref GSE_STATUS_NO_SHAPER
+ *                         - \ref GSE_STATUS_MALLOC_FAILED
+ *                         - \ref GSE_STATUS_PTHREAD_MUTEX
+ *
+ *  @ingroup gse_encap
+ */
+gse_status_t gse_encap_set_label_shaper(gse_encap_t *encap,
+                                        uint8_t label[6], uint8_t label_type,
+                                        const gse_shaper_conf_t *conf);
+
+/**
+ *  @brief   Add the tokens earned since the previous call to the shapers
+ *
+ *  The clock is given by the user, it shall be monotonic. The first call only
+ *  sets the time origin. The function is typically called before filling
+ *  each frame.
+ *
+ *  @param   encap  Encapsulation structure
+ *  @param   now    The current time (in microseconds)
+ *
+ *  @return
+ *                  - success/informative code among:
+ *                    - \ref GSE_STATUS_OK
+ *                  - warning/error code among:
+ *                    - \ref GSE_STATUS_NULL_PTR
+ *                    - \ref GSE_STATUS_PTHREAD_MUTEX
+ *
+ *  @ingroup gse_encap
+ */
+gse_status_t gse_encap_refill_shapers(gse_encap_t *encap, uint64_t now);
+
+/**
+ *  @brief   Get a snapshot of the state of the shaper of a QoS value
+ *
+ *  @param   encap  Encapsulation structure
+ *  @param   qos    The QoS value
+ *  @param   state  OUT: The shaper state
+ *
+ *  @return
+ *                  - success/informative code among:
+ *                    - \ref GSE_STATUS_OK
+ *                  - warning/error code among:
+ *                    - \ref GSE_STATUS_NULL_PTR
+ *                    - \ref GSE_STATUS_INVALID_QOS
+ *                    - \ref GSE_STATUS_NO_SHAPER
+ *                    - \ref GSE_STATUS_PTHREAD_MUTEX
+ *
+ *  @ingroup gse_encap
+ */
+gse_status_t gse_encap_get_qos_shaper_state(gse_encap_t *encap, uint8_t qos,
+                                            gse_shaper_state_t *state);
+
+/**
+ *  @brief   Get a snapshot of the state of the shaper of a label
+ *
+ *  @param   encap       Encapsulation structure
+ *  @param   label       The label
+ *  @param   label_type  The label type
+ *  @param   state       OUT: The shaper state
+ *
+ *  @return
+ *                       - success/informative code among:
+ *                         - \ref GSE_STATUS_OK
+ *                       - warning/error code among:
+ *                         - \ref GSE_STATUS_NULL_PTR
+ *                         - \ref GSE_STATUS_INVALID_LT
+ *                         - \ref GSE_STATUS_NO_SHAPER
+ *                         - \ref GSE_STATUS_PTHREAD_MUTEX
+ *
+ *  @ingroup gse_encap
+ */
+gse_status_t gse_encap_get_label_shaper_state(gse_encap_t *encap,
+                                              uint8_t label[6],
+                                              uint8_t label_type,
+                                              gse_shaper_state_t *state);
+
+/* ACM functions */
+
+/**
+ *  @brief   Associate a label with a modcod group
+ *
+ *  With ACM, each frame is sent with a modcod and can only carry the PDUs of
+ *  the receivers able to decode this modcod. The PDUs received with a label
+ *  associated to a modcod group are stored in the FIFOs of this group, one
+ *  per QoS value, instead of the default FIFOs, and are only sent in the
+ *  frames filled with \ref gse_encap_fill_frame_modcod. The PDUs received
+ *  with other labels still go in the default FIFOs.\n
+ *  The modcod groups share the FragID pool which is thus required (see
+ *  \ref gse_encap_set_frag_id_pool) so two PDUs fragmented in frames of
+ *  different modcods never get the same FragID. The offsets and the extension
+ *  callback are also shared.\n
+ *  Changing the modcod of a label does not move the PDUs already received.
+ *
+ *  @param   encap       Encapsulation structure
+ *  @param   label       The label
+ *  @param   label_type  The label type (re-use is not allowed)
+ *  @param   modcod      The modcod group
+ *
+ *  @return
+ *                       - success/informative code among:
+ *                         - \ref GSE_STATUS_OK
+ *                       - warning/error code among:
+ *                         - \ref GSE_STATUS_NULL_PTR
+ *                         - \ref GSE_STATUS_FRAG_ID_POOL_REQUIRED
+ *                         - \ref GSE_STATUS_INVALID_LT
+ *                         - \ref GSE_STATUS_MALLOC_FAILED
+ *                         - \ref GSE_STATUS_PTHREAD_MUTEX
+ *
+ *  @ingroup gse_encap
+ */
+gse_status_t gse_encap_set_label_modcod(gse_encap_t *encap,
+                                        uint8_t label[6], uint8_t label_type,
+                                        uint8_t modcod);
+
+/**
+ *  @brief   Remove the association of a label with a modcod group
+ *
+ *  The next PDUs received with the label go in the default FIFOs.
+ *
+ *  @param   encap       Encapsulation structure
+ *  @param   label       The label
+ *  @param   label_type  The label type
+ *
+ *  @return
+ *                       - success/informative code among:
+ *                         - \ref GSE_STATUS_OK
+ *                       - warning/error code among:
+ *                         - \ref GSE_STATUS_NULL_PTR
+ *                         - \ref GSE_STATUS_UNKNOWN_LABEL
+ *                         - \ref GSE_STATUS_INVALID_LT
+ *                         - \ref GSE_STATUS_PTHREAD_MUTEX
+ *
+ *  @ingroup gse_encap
+ */
+gse_status_t gse_encap_remove_label_modcod(gse_encap_t *encap,
+                                           uint8_t label[6],
+                                           uint8_t label_type);
+
+/**
+ *  @brief   Fill a frame with the GSE packets of a modcod group
+ *
+ *  The frame is filled as with \ref gse_encap_fill_frame but with the FIFOs
+ *  of the modcod group.
+ *
+ *  @param   encap         Encapsulation structure
+ *  @param   modcod        The modcod group
+ *  @param   policy        The policy used to choose the PDUs
+ *  @param   frame         The frame to fill
+ *  @param   frame_length  The frame length (in bytes)
+ *  @param   data_length   OUT: The length of the GSE packets in the frame
+ *  @param   stats         OUT: The content of the frame (may be NULL)
+ *
+ *  @return                The same codes as \ref gse_encap_fill_frame
+ *
+ *  @ingroup gse_encap
+ */
+gse_status_t gse_encap_fill_frame_modcod(gse_encap_t *encap, uint8_t modcod,
+                                         gse_fill_policy_t policy,
+                                         unsigned char *frame,
+                                         size_t frame_length,
+                                         size_t *data_length,
+                                         gse_frame_stats_t *stats);
+
+/**
+ *  @brief   Get the memory used by an encapsulation structure
+ *
+ *  The structure and its tables are accounted. The FIFO tables are only
+ *  allocated once a PDU is received in the FIFO, the modcod groups and the
+ *  shapers once they are set. The PDUs themselves are not accounted.
+ *
+ *  @param   encap      Encapsulation structure
+ *  @param   footprint  OUT: The memory used by the structure (in bytes)
+ *
+ *  @return
+ *                      - success/informative code among:
+ *                        - \ref GSE_STATUS_OK
+ *                      - warning/error code among:
+ *                        - \ref GSE_STATUS_NULL_PTR
+ *                        - \ref GSE_STATUS_PTHREAD_MUTEX
+ *
+ *  @ingroup gse_encap
+ */
+gse_status_t gse_encap_get_footprint(gse_encap_t *encap, size_t *footprint);
+
 #endif
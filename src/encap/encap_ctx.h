@@ -48,6 +48,8 @@
 #ifndef GSE_ENCAP_CTX_H
 #define GSE_ENCAP_CTX_H
 
+#include <pthread.h>
+
 #include "header.h"
 #include "virtual_fragment.h"
 
@@ -57,16 +59,65 @@
  *
  ****************************************************************************/
 
-/** Encapsulation context */
-typedef struct
+/** PDU received in chunks
+ *
+ *  The stream is shared by the user who appends the data and by the
+ *  encapsulation context of the PDU in the FIFO, it is freed when both
+ *  release it.
+ */
+struct gse_encap_stream_s
 {
   gse_vfrag_t *vfrag;     /**< Virtual fragment containing the PDU */
+  size_t pdu_length;      /**< Length of the whole PDU */
+  size_t received_length; /**< Length of the PDU data already appended */
+  uint32_t crc;           /**< CRC of the data sent or appended since the
+                               first fragment */
+  int crc_started;        /**< Whether the first fragment was built before
+                               the end of the PDU, the CRC is then computed
+                               as the data is appended */
+  int complete;           /**< Whether all the PDU data was appended */
+  int aborted;            /**< Whether the PDU was aborted or the
+                               encapsulation context released */
+  unsigned int ref_nbr;   /**< Number of users of the stream */
+  pthread_mutex_t mutex;  /**< Mutex on the stream */
+};
+
+/** Encapsulation context
+ *
+ *  The fields read when the FIFOs are scanned to build a packet or to fill a
+ *  frame come first, the header fields only read when the packet is built
+ *  come last.
+ */
+typedef struct
+{
+  /* hot fields */
+  gse_vfrag_t *vfrag;     /**< Virtual fragment containing the PDU, NULL if
+                               the PDU is chained */
+  struct gse_encap_stream_s *stream; /**< Stream of the PDU if it is received
+                                          in chunks, NULL otherwise */
+  gse_vfrag_chain_t *chain; /**< Chain holding the PDU if its data is
+                                 spread over several buffers, NULL
+                                 otherwise */
+  size_t chain_offset;    /**< Length of the chain data already sent */
+  unsigned int frag_nbr;  /**< Number of fragment */
+  uint8_t label_type;     /**< Label type field value */
+  uint8_t qos;            /**< QoS value of the context */
+  uint8_t frag_id;        /**< FragID value used by the fragments of the PDU
+                               (the QoS value unless Frag ID pool is enabled) */
+  uint8_t frag_id_alloc;  /**< Whether the FragID was taken from the Frag ID
+                               pool and should be released */
+  uint8_t vfrag_alloc;    /**< Whether the virtual fragment was allocated by
+                               the library, for a PDU received in chunks or
+                               a chained PDU copied */
+  unsigned int skip_nbr;  /**< Number of packets built for other PDUs of the
+                               FIFO since the last fragment of this PDU */
+  unsigned int held_fill; /**< Last frame filling that held the PDU */
+  uint32_t flow;          /**< Hash of the flow of the PDU used by the flow
+                               queuing stage of the FIFO */
+  /* cold fields */
   gse_label_t label;      /**< Label field value */
   uint16_t total_length;  /**< Total length field value in Network Byte Order (NBO) */
   uint16_t protocol_type; /**< Protocol type field value in NBO */
-  uint8_t qos;            /**< QoS value of the context : used as FragID value */
-  uint8_t label_type;     /**< Label type field value */
-  unsigned int frag_nbr;  /**< Number of fragment */
 } gse_encap_ctx_t;
 
 #endif
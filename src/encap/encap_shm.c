@@ -0,0 +1,773 @@
+/*
+ *
+ * This piece of software is an implementation of the Generic Stream
+ * Encapsulation (GSE) standard defined by ETSI for Linux (or other
+ * Unix-compatible OS). The library may be used to add GSE
+ * encapsulation/de-encapsulation capabilities to an application.
+ *
+ *
+ * Copyright © 2016 TAS
+ *
+ *
+ * This file is part of the GSE library.
+ *
+ *
+ * The GSE library is free software : you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY, without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see http://www.gnu.org/licenses/.
+ *
+ */
+
+/****************************************************************************/
+/**
+ *   @file          encap_shm.c
+ *
+ *          Project:     GSE LIBRARY
+ *
+ *          Company:     THALES ALENIA SPACE
+ *
+ *          Module name: ENCAPSULATION
+ *
+ *   @brief         Queue of PDUs shared between processes for the
+ *                  encapsulation
+ *
+ *   @author        Julien BERNARD / Viveris Technologies
+ *
+ */
+/****************************************************************************/
+
+/* memfd_create() is a GNU extension */
+#define _GNU_SOURCE
+
+#include "encap_shm.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "constants.h"
+#include "header.h"
+#include "cache.h"
+
+
+/****************************************************************************
+ *
+ *   MACROS AND CONSTANTS
+ *
+ ****************************************************************************/
+
+/** The magic number at the beginning of a segment ("GSEQ") */
+#define GSE_ENCAP_SHM_MAGIC 0x47534551
+
+/** The version of the layout of the segment */
+#define GSE_ENCAP_SHM_VERSION 1
+
+/** Round a length up to a whole number of cache lines, the positions of the
+ *  rings and the slots are aligned on them */
+#define GSE_ENCAP_SHM_ALIGN(x) \
+  (((x) + GSE_CACHE_LINE_SIZE - 1) & \
+   ~((size_t)GSE_CACHE_LINE_SIZE - 1))
+
+
+/****************************************************************************
+ *
+ *   STRUCTURES AND TYPES
+ *
+ ****************************************************************************/
+
+/** Header of the segment, written once by the creator
+ *
+ *  The segment contains the header, the rings of the QoS values, the ring
+ *  of the free slots and the slots. All the positions are offsets from the
+ *  beginning of the segment.
+ */
+typedef struct
+{
+  uint32_t magic;          /**< \ref GSE_ENCAP_SHM_MAGIC */
+  uint32_t version;        /**< \ref GSE_ENCAP_SHM_VERSION */
+  uint32_t qos_nbr;        /**< The number of QoS values */
+  uint32_t slot_nbr;       /**< The number of slots */
+  uint32_t ring_size;      /**< The number of cells of a ring (a power of 2
+                                not below the number of slots) */
+  uint32_t max_pdu_length; /**< The maximum length of the PDUs */
+  uint64_t ring_offset;    /**< The offset of the first ring */
+  uint64_t ring_length;    /**< The length of a ring with its cells */
+  uint64_t slot_offset;    /**< The offset of the first slot */
+  uint64_t slot_length;    /**< The length of a slot */
+  uint64_t length;         /**< The length of the segment */
+} gse_encap_shm_header_t;
+
+/** Bounded ring of slot handles usable by several producers and consumers
+ *
+ *  Each cell carries a sequence number telling whether it can be written or
+ *  read at the current position, so no lock is required.
+ */
+typedef struct
+{
+  uint32_t enqueue_pos;    /**< The next position to write */
+  uint8_t pad1[GSE_CACHE_LINE_SIZE - sizeof(uint32_t)];
+  uint32_t dequeue_pos;    /**< The next position to read */
+  uint8_t pad2[GSE_CACHE_LINE_SIZE - sizeof(uint32_t)];
+} gse_encap_shm_ring_t;
+
+/** Cell of a ring */
+typedef struct
+{
+  uint32_t seq;            /**< The sequence number of the cell */
+  uint32_t handle;         /**< The handle of the slot */
+} gse_encap_shm_cell_t;
+
+/** Description of the PDU of a slot, the PDU follows it */
+typedef struct
+{
+  uint32_t length;         /**< The length of the PDU */
+  uint32_t flow_key;       /**< The flow key of the PDU */
+  uint16_t protocol;       /**< The protocol of the PDU */
+  uint8_t label_type;      /**< The label type field value */
+  uint8_t qos;             /**< The QoS value of the PDU */
+  uint8_t label[6];        /**< The label of the PDU */
+} gse_encap_shm_slot_t;
+
+/** Shared memory queue, local to each process */
+struct gse_encap_shm_s
+{
+  int fd;                  /**< The file descriptor of the segment */
+  unsigned char *base;     /**< The address of the mapping */
+  size_t length;           /**< The length of the mapping */
+  gse_encap_shm_header_t *header; /**< The header of the segment */
+  unsigned char *slots;    /**< The first slot */
+  size_t slot_length;      /**< The length of a slot */
+  uint32_t slot_nbr;       /**< The number of slots */
+  uint32_t ring_mask;      /**< The mask giving the cell of a position */
+  uint32_t max_pdu_length; /**< The maximum length of the PDUs, read once
+                                when the segment is mapped */
+  uint8_t qos_nbr;         /**< The number of QoS values */
+  uint8_t next_qos;        /**< The QoS value served first on the next
+                                reception */
+};
+
+/** The length left before the PDU in a slot, for the slot description and
+ *  the GSE header */
+#define GSE_ENCAP_SHM_PDU_OFFSET \
+  GSE_ENCAP_SHM_ALIGN(sizeof(gse_encap_shm_slot_t) + GSE_MAX_HEADER_LENGTH)
+
+
+/****************************************************************************
+ *
+ *   PROTOTYPES OF PRIVATE FUNCTIONS
+ *
+ ****************************************************************************/
+
+/**
+ *  @brief   Map a segment and check its header
+ *
+ *  @param   fd      The file descriptor of the segment
+ *  @param   length  The length of the segment
+ *  @param   shm     OUT: The shared memory queue on success
+ *
+ *  @return
+ *                   - success/informative code among:
+ *                     - \ref GSE_STATUS_OK
+ *                   - warning/error code among:
+ *                     - \ref GSE_STATUS_MALLOC_FAILED
+ *                     - \ref GSE_STATUS_SHM_FAILED
+ */
+static gse_status_t gse_encap_shm_map(int fd, size_t length,
+                                      gse_encap_shm_t **shm);
+
+/**
+ *  @brief   Get a ring of the segment
+ *
+ *  @param   shm    The shared memory queue
+ *  @param   index  The QoS value, or the number of QoS values for the ring
+ *                  of the free slots
+ *
+ *  @return         The ring
+ */
+static gse_encap_shm_ring_t *gse_encap_shm_get_ring(gse_encap_shm_t *shm,
+                                                    unsigned int index);
+
+/**
+ *  @brief   Write a handle in a ring
+ *
+ *  @param   shm     The shared memory queue
+ *  @param   ring    The ring
+ *  @param   handle  The handle of the slot
+ *
+ *  @return          0 on success, -1 if the ring is full
+ */
+static int gse_encap_shm_enqueue(gse_encap_shm_t *shm,
+                                 gse_encap_shm_ring_t *ring, uint32_t handle);
+
+/**
+ *  @brief   Read a handle from a ring
+ *
+ *  @param   shm     The shared memory queue
+ *  @param   ring    The ring
+ *  @param   handle  OUT: The handle of the slot
+ *
+ *  @return          0 on success, -1 if the ring is empty
+ */
+static int gse_encap_shm_dequeue(gse_encap_shm_t *shm,
+                                 gse_encap_shm_ring_t *ring, uint32_t *handle);
+
+/**
+ *  @brief   Give back the slot of a PDU once the encapsulation freed it
+ *
+ *  @param   buffer  The buffer of the PDU in the slot
+ *  @param   opaque  The shared memory queue
+ */
+static void gse_encap_shm_release_slot(unsigned char *buffer, void *opaque);
+
+
+/****************************************************************************
+ *
+ *   PUBLIC FUNCTIONS
+ *
+ ****************************************************************************/
+
+gse_status_t gse_encap_shm_create(uint8_t qos_nbr, unsigned int slot_nbr,
+                                  size_t max_pdu_length,
+                                  gse_encap_shm_t **shm)
+{
+  gse_status_t status;
+
+  gse_encap_shm_header_t header;
+  gse_encap_shm_ring_t *ring;
+  gse_encap_shm_cell_t *cells;
+  unsigned int i;
+  unsigned int j;
+  int fd;
+
+  if(shm == NULL)
+  {
+    status = GSE_STATUS_NULL_PTR;
+    goto error;
+  }
+  if(qos_nbr == 0)
+  {
+    status = GSE_STATUS_QOS_NBR_NULL;
+    goto error;
+  }
+  if(slot_nbr == 0 || slot_nbr > (1U << 31))
+  {
+    status = GSE_STATUS_FIFO_SIZE_NULL;
+    goto error;
+  }
+  if(max_pdu_length == 0 || max_pdu_length > GSE_MAX_PDU_LENGTH)
+  {
+    status = GSE_STATUS_PDU_LENGTH;
+    goto error;
+  }
+
+  /* The rings can hold all the slots so they are never full */
+  memset(&header, 0, sizeof(gse_encap_shm_header_t));
+  header.magic = GSE_ENCAP_SHM_MAGIC;
+  header.version = GSE_ENCAP_SHM_VERSION;
+  header.qos_nbr = qos_nbr;
+  header.slot_nbr = slot_nbr;
+  header.ring_size = 1;
+  while(header.ring_size < slot_nbr)
+  {
+    header.ring_size <<= 1;
+  }
+  header.max_pdu_length = max_pdu_length;
+  header.ring_offset = GSE_ENCAP_SHM_ALIGN(sizeof(gse_encap_shm_header_t));
+  header.ring_length =
+    GSE_ENCAP_SHM_ALIGN(sizeof(gse_encap_shm_ring_t) +
+                        header.ring_size * sizeof(gse_encap_shm_cell_t));
+  header.slot_offset = header.ring_offset +
+                       (qos_nbr + 1) * header.ring_length;
+  header.slot_length = GSE_ENCAP_SHM_ALIGN(GSE_ENCAP_SHM_PDU_OFFSET +
+                                           max_pdu_length +
+                                           GSE_MAX_TRAILER_LENGTH);
+  header.length = header.slot_offset + slot_nbr * header.slot_length;
+
+  fd = memfd_create("gse_encap_shm", MFD_CLOEXEC);
+  if(fd < 0)
+  {
+    status = GSE_STATUS_SHM_FAILED;
+    goto error;
+  }
+  if(ftruncate(fd, header.length) != 0)
+  {
+    status = GSE_STATUS_SHM_FAILED;
+    goto close_fd;
+  }
+  /* The header is only valid once it is written */
+  if(pwrite(fd, &header, sizeof(gse_encap_shm_header_t), 0) !=
+     sizeof(gse_encap_shm_header_t))
+  {
+    status = GSE_STATUS_SHM_FAILED;
+    goto close_fd;
+  }
+  status = gse_encap_shm_map(fd, header.length, shm);
+  if(status != GSE_STATUS_OK)
+  {
+    goto close_fd;
+  }
+
+  /* The rings of the QoS values are empty, the ring of the free slots holds
+   * all the slots */
+  for(i = 0 ; i <= qos_nbr ; i++)
+  {
+    ring = gse_encap_shm_get_ring(*shm, i);
+    cells = (gse_encap_shm_cell_t *)(ring + 1);
+    for(j = 0 ; j < header.ring_size ; j++)
+    {
+      cells[j].seq = j;
+    }
+  }
+  for(i = 0 ; i < slot_nbr ; i++)
+  {
+    gse_encap_shm_enqueue(*shm, gse_encap_shm_get_ring(*shm, qos_nbr), i);
+  }
+
+  return GSE_STATUS_OK;
+
+close_fd:
+  close(fd);
+error:
+  if(shm != NULL)
+  {
+    *shm = NULL;
+  }
+  return status;
+}
+
+gse_status_t gse_encap_shm_attach(int fd, gse_encap_shm_t **shm)
+{
+  gse_status_t status;
+  struct stat stat_buf;
+
+  if(shm == NULL)
+  {
+    status = GSE_STATUS_NULL_PTR;
+    goto error;
+  }
+  if(fstat(fd, &stat_buf) != 0 ||
+     stat_buf.st_size < (off_t)sizeof(gse_encap_shm_header_t))
+  {
+    status = GSE_STATUS_SHM_FAILED;
+    goto error;
+  }
+  status = gse_encap_shm_map(fd, stat_buf.st_size, shm);
+  if(status != GSE_STATUS_OK)
+  {
+    goto error;
+  }
+
+  return GSE_STATUS_OK;
+
+error:
+  if(shm != NULL)
+  {
+    *shm = NULL;
+  }
+  return status;
+}
+
+gse_status_t gse_encap_shm_release(gse_encap_shm_t *shm)
+{
+  gse_status_t status = GSE_STATUS_OK;
+
+  if(shm == NULL)
+  {
+    return GSE_STATUS_NULL_PTR;
+  }
+  if(munmap(shm->base, shm->length) != 0)
+  {
+    status = GSE_STATUS_SHM_FAILED;
+  }
+  close(shm->fd);
+  free(shm);
+  return status;
+}
+
+int gse_encap_shm_get_fd(gse_encap_shm_t *shm)
+{
+  if(shm == NULL)
+  {
+    return -1;
+  }
+  return shm->fd;
+}
+
+gse_status_t gse_encap_shm_alloc_pdu(gse_encap_shm_t *shm, uint32_t *handle,
+                                     unsigned char **data,
+                                     size_t *max_length)
+{
+  if(shm == NULL || handle == NULL || data == NULL || max_length == NULL)
+  {
+    return GSE_STATUS_NULL_PTR;
+  }
+  if(gse_encap_shm_dequeue(shm, gse_encap_shm_get_ring(shm, shm->qos_nbr),
+                           handle) != 0)
+  {
+    return GSE_STATUS_FIFO_FULL;
+  }
+  *data = shm->slots + *handle * shm->slot_length + GSE_ENCAP_SHM_PDU_OFFSET;
+  *max_length = shm->max_pdu_length;
+  return GSE_STATUS_OK;
+}
+
+gse_status_t gse_encap_shm_push_pdu(gse_encap_shm_t *shm, uint32_t handle,
+                                    size_t length, uint8_t label[6],
+                                    uint8_t label_type, uint16_t protocol,
+                                    uint8_t qos, uint32_t flow_key)
+{
+  gse_encap_shm_slot_t *slot;
+  int label_length;
+
+  if(shm == NULL)
+  {
+    return GSE_STATUS_NULL_PTR;
+  }
+  label_length = gse_get_label_length(label_type);
+  if(label_length < 0)
+  {
+    return GSE_STATUS_INVALID_LT;
+  }
+  if(label == NULL && label_length > 0)
+  {
+    return GSE_STATUS_NULL_PTR;
+  }
+  if(qos >= shm->qos_nbr)
+  {
+    return GSE_STATUS_INVALID_QOS;
+  }
+  if(length > shm->max_pdu_length)
+  {
+    return GSE_STATUS_PDU_LENGTH;
+  }
+  if(handle >= shm->slot_nbr)
+  {
+    return GSE_STATUS_INTERNAL_ERROR;
+  }
+
+  slot = (gse_encap_shm_slot_t *)(shm->slots + handle * shm->slot_length);
+  slot->length = length;
+  slot->flow_key = flow_key;
+  slot->protocol = protocol;
+  slot->label_type = label_type;
+  slot->qos = qos;
+  memset(slot->label, 0, sizeof(slot->label));
+  if(label_length > 0)
+  {
+    memcpy(slot->label, label, label_length);
+  }
+  /* The ring cannot be full, it holds all the slots */
+  if(gse_encap_shm_enqueue(shm, gse_encap_shm_get_ring(shm, qos),
+                           handle) != 0)
+  {
+    return GSE_STATUS_INTERNAL_ERROR;
+  }
+  return GSE_STATUS_OK;
+}
+
+gse_status_t gse_encap_shm_free_pdu(gse_encap_shm_t *shm, uint32_t handle)
+{
+  if(shm == NULL)
+  {
+    return GSE_STATUS_NULL_PTR;
+  }
+  if(handle >= shm->slot_nbr ||
+     gse_encap_shm_enqueue(shm, gse_encap_shm_get_ring(shm, shm->qos_nbr),
+                           handle) != 0)
+  {
+    return GSE_STATUS_INTERNAL_ERROR;
+  }
+  return GSE_STATUS_OK;
+}
+
+gse_status_t gse_encap_shm_receive(gse_encap_shm_t *shm, gse_encap_t *encap,
+                                   unsigned int max_pdu_nbr,
+                                   unsigned int *pdu_nbr)
+{
+  gse_status_t status = GSE_STATUS_OK;
+
+  gse_encap_shm_slot_t slot;
+  gse_vfrag_t *pdu;
+  unsigned char *buffer;
+  uint32_t handle;
+  unsigned int idle_nbr = 0;
+  uint8_t qos;
+
+  if(shm == NULL || encap == NULL || pdu_nbr == NULL)
+  {
+    status = GSE_STATUS_NULL_PTR;
+    goto error;
+  }
+
+  /* Take one PDU of each QoS value in turn until all of them are empty or
+   * congested */
+  *pdu_nbr = 0;
+  qos = shm->next_qos;
+  while(*pdu_nbr < max_pdu_nbr && idle_nbr < shm->qos_nbr)
+  {
+    if(gse_encap_is_congested(encap, qos) ||
+       gse_encap_shm_dequeue(shm, gse_encap_shm_get_ring(shm, qos),
+                             &handle) != 0)
+    {
+      idle_nbr++;
+      qos = (qos + 1) % shm->qos_nbr;
+      continue;
+    }
+    idle_nbr = 0;
+
+    /* The ring and the slot are written by the other process, the handle
+     * and a copy of the slot description are checked before being used so
+     * that they cannot change afterwards. The PDU of an invalid slot is
+     * dropped and its slot given back */
+    if(handle >= shm->slot_nbr)
+    {
+      status = GSE_STATUS_SHM_FAILED;
+      goto error;
+    }
+    buffer = shm->slots + handle * shm->slot_length;
+    memcpy(&slot, buffer, sizeof(gse_encap_shm_slot_t));
+    if(slot.length > shm->max_pdu_length)
+    {
+      status = GSE_STATUS_PDU_LENGTH;
+      goto free_slot;
+    }
+    if(slot.qos >= shm->qos_nbr)
+    {
+      status = GSE_STATUS_INVALID_QOS;
+      goto free_slot;
+    }
+    if(gse_get_label_length(slot.label_type) < 0)
+    {
+      status = GSE_STATUS_INVALID_LT;
+      goto free_slot;
+    }
+
+    status = gse_create_vfrag_from_ext_buf(&pdu,
+                                           buffer +
+                                           sizeof(gse_encap_shm_slot_t),
+                                           GSE_ENCAP_SHM_PDU_OFFSET -
+                                           sizeof(gse_encap_shm_slot_t),
+                                           GSE_MAX_TRAILER_LENGTH,
+                                           slot.length,
+                                           gse_encap_shm_release_slot, shm);
+    if(status != GSE_STATUS_OK)
+    {
+      goto free_slot;
+    }
+    /* The PDU is destroyed on error, its slot is then given back */
+    status = gse_encap_receive_pdu_flow(pdu, encap, slot.label,
+                                        slot.label_type, slot.protocol,
+                                        slot.qos, slot.flow_key);
+    if(status != GSE_STATUS_OK)
+    {
+      goto error;
+    }
+    (*pdu_nbr)++;
+    qos = (qos + 1) % shm->qos_nbr;
+  }
+  shm->next_qos = qos;
+  return GSE_STATUS_OK;
+
+free_slot:
+  gse_encap_shm_free_pdu(shm, handle);
+error:
+  return status;
+}
+
+gse_status_t gse_encap_shm_get_usage(gse_encap_shm_t *shm,
+                                     unsigned int *slot_nbr,
+                                     unsigned int *free_nbr)
+{
+  gse_encap_shm_ring_t *ring;
+
+  if(shm == NULL || slot_nbr == NULL || free_nbr == NULL)
+  {
+    return GSE_STATUS_NULL_PTR;
+  }
+  ring = gse_encap_shm_get_ring(shm, shm->qos_nbr);
+  *slot_nbr = shm->slot_nbr;
+  *free_nbr = __atomic_load_n(&ring->enqueue_pos, __ATOMIC_ACQUIRE) -
+              __atomic_load_n(&ring->dequeue_pos, __ATOMIC_ACQUIRE);
+  if(*free_nbr > shm->slot_nbr)
+  {
+    *free_nbr = shm->slot_nbr;
+  }
+  return GSE_STATUS_OK;
+}
+
+
+/****************************************************************************
+ *
+ *   PRIVATE FUNCTIONS
+ *
+ ****************************************************************************/
+
+static gse_status_t gse_encap_shm_map(int fd, size_t length,
+                                      gse_encap_shm_t **shm)
+{
+  gse_status_t status;
+  gse_encap_shm_header_t *header;
+  void *base;
+
+  *shm = malloc(sizeof(gse_encap_shm_t));
+  if(*shm == NULL)
+  {
+    status = GSE_STATUS_MALLOC_FAILED;
+    goto error;
+  }
+  base = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if(base == MAP_FAILED)
+  {
+    status = GSE_STATUS_SHM_FAILED;
+    goto free_shm;
+  }
+
+  /* A segment of another version or truncated is refused */
+  header = base;
+  if(header->magic != GSE_ENCAP_SHM_MAGIC ||
+     header->version != GSE_ENCAP_SHM_VERSION ||
+     header->qos_nbr == 0 || header->qos_nbr > 256 ||
+     header->slot_nbr == 0 || header->slot_nbr > header->ring_size ||
+     (header->ring_size & (header->ring_size - 1)) != 0 ||
+     header->length > length ||
+     header->slot_offset + (uint64_t)header->slot_nbr * header->slot_length >
+     header->length ||
+     header->slot_length < GSE_ENCAP_SHM_PDU_OFFSET + header->max_pdu_length +
+                           GSE_MAX_TRAILER_LENGTH)
+  {
+    status = GSE_STATUS_SHM_FAILED;
+    goto unmap;
+  }
+
+  (*shm)->fd = fd;
+  (*shm)->base = base;
+  (*shm)->length = length;
+  (*shm)->header = header;
+  (*shm)->slots = (unsigned char *)base + header->slot_offset;
+  (*shm)->slot_length = header->slot_length;
+  (*shm)->slot_nbr = header->slot_nbr;
+  (*shm)->ring_mask = header->ring_size - 1;
+  (*shm)->max_pdu_length = header->max_pdu_length;
+  (*shm)->qos_nbr = header->qos_nbr;
+  (*shm)->next_qos = 0;
+
+  return GSE_STATUS_OK;
+
+unmap:
+  munmap(base, length);
+free_shm:
+  free(*shm);
+error:
+  *shm = NULL;
+  return status;
+}
+
+static gse_encap_shm_ring_t *gse_encap_shm_get_ring(gse_encap_shm_t *shm,
+                                                    unsigned int index)
+{
+  return (gse_encap_shm_ring_t *)(shm->base + shm->header->ring_offset +
+                                  index * shm->header->ring_length);
+}
+
+static int gse_encap_shm_enqueue(gse_encap_shm_t *shm,
+                                 gse_encap_shm_ring_t *ring, uint32_t handle)
+{
+  gse_encap_shm_cell_t *cells = (gse_encap_shm_cell_t *)(ring + 1);
+  gse_encap_shm_cell_t *cell;
+  uint32_t pos;
+  uint32_t seq;
+  int32_t diff;
+
+  pos = __atomic_load_n(&ring->enqueue_pos, __ATOMIC_RELAXED);
+  while(1)
+  {
+    cell = &cells[pos & shm->ring_mask];
+    seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+    diff = (int32_t)(seq - pos);
+    if(diff == 0)
+    {
+      /* The cell is free at this position, take the position */
+      if(__atomic_compare_exchange_n(&ring->enqueue_pos, &pos, pos + 1, 1,
+                                     __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+      {
+        break;
+      }
+    }
+    else if(diff < 0)
+    {
+      /* The cell still holds the handle of the previous round */
+      return -1;
+    }
+    else
+    {
+      pos = __atomic_load_n(&ring->enqueue_pos, __ATOMIC_RELAXED);
+    }
+  }
+  cell->handle = handle;
+  __atomic_store_n(&cell->seq, pos + 1, __ATOMIC_RELEASE);
+  return 0;
+}
+
+static int gse_encap_shm_dequeue(gse_encap_shm_t *shm,
+                                 gse_encap_shm_ring_t *ring, uint32_t *handle)
+{
+  gse_encap_shm_cell_t *cells = (gse_encap_shm_cell_t *)(ring + 1);
+  gse_encap_shm_cell_t *cell;
+  uint32_t pos;
+  uint32_t seq;
+  int32_t diff;
+
+  pos = __atomic_load_n(&ring->dequeue_pos, __ATOMIC_RELAXED);
+  while(1)
+  {
+    cell = &cells[pos & shm->ring_mask];
+    seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+    diff = (int32_t)(seq - (pos + 1));
+    if(diff == 0)
+    {
+      /* The cell is written at this position, take the position */
+      if(__atomic_compare_exchange_n(&ring->dequeue_pos, &pos, pos + 1, 1,
+                                     __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+      {
+        break;
+      }
+    }
+    else if(diff < 0)
+    {
+      /* The cell is not written yet */
+      return -1;
+    }
+    else
+    {
+      pos = __atomic_load_n(&ring->dequeue_pos, __ATOMIC_RELAXED);
+    }
+  }
+  *handle = cell->handle;
+  /* The cell is free again for the next round */
+  __atomic_store_n(&cell->seq, pos + shm->ring_mask + 1, __ATOMIC_RELEASE);
+  return 0;
+}
+
+static void gse_encap_shm_release_slot(unsigned char *buffer, void *opaque)
+{
+  gse_encap_shm_t *shm = opaque;
+  uint32_t handle;
+
+  assert(shm != NULL);
+  assert(buffer >= shm->slots);
+
+  handle = (buffer - shm->slots) / shm->slot_length;
+  gse_encap_shm_free_pdu(shm, handle);
+}
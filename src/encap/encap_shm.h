@@ -0,0 +1,293 @@
+/*
+ *
+ * This piece of software is an implementation of the Generic Stream
+ * Encapsulation (GSE) standard defined by ETSI for Linux (or other
+ * Unix-compatible OS). The library may be used to add GSE
+ * encapsulation/de-encapsulation capabilities to an application.
+ *
+ *
+ * Copyright © 2016 TAS
+ *
+ *
+ * This file is part of the GSE library.
+ *
+ *
+ * The GSE library is free software : you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY, without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see http://www.gnu.org/licenses/.
+ *
+ */
+
+/****************************************************************************/
+/**
+ *   @file          encap_shm.h
+ *
+ *          Project:     GSE LIBRARY
+ *
+ *          Company:     THALES ALENIA SPACE
+ *
+ *          Module name: ENCAPSULATION
+ *
+ *   @brief         Queue of PDUs shared between processes for the
+ *                  encapsulation
+ *
+ *   @author        Julien BERNARD / Viveris Technologies
+ *
+ */
+/****************************************************************************/
+
+
+#ifndef GSE_ENCAP_SHM_H
+#define GSE_ENCAP_SHM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "encap.h"
+
+struct gse_encap_shm_s;
+/** Shared memory queue type definition */
+typedef struct gse_encap_shm_s gse_encap_shm_t;
+
+/**
+ * @defgroup gse_encap_shm GSE shared memory encapsulation queue API
+ *
+ * A process writes the PDUs directly in the slots of a shared memory segment
+ * and queues them per QoS value. Another process maps the same segment and
+ * gives the PDUs to its encapsulation structure without copying them, the
+ * slots are given back once the PDUs are sent. The queues are lock-free, no
+ * system call is made once the segment is mapped.\n
+ * A slot is designated by a handle, its index in the segment, which is valid
+ * in both processes whatever the address of the mapping.
+ */
+
+/****************************************************************************
+ *
+ *   FUNCTION PROTOTYPES
+ *
+ ****************************************************************************/
+
+/**
+ *  @brief   Create a shared memory queue
+ *
+ *  The segment is a memfd, its file descriptor is given to the other process
+ *  by inheritance or over a UNIX socket.
+ *
+ *  @param   qos_nbr         The number of QoS values
+ *  @param   slot_nbr        The number of PDU slots
+ *  @param   max_pdu_length  The maximum length of the PDUs (in bytes)
+ *  @param   shm             OUT: The shared memory queue on success,
+ *                                NULL on error
+ *
+ *  @return
+ *                           - success/informative code among:
+ *                             - \ref GSE_STATUS_OK
+ *                           - warning/error code among:
+ *                             - \ref GSE_STATUS_NULL_PTR
+ *                             - \ref GSE_STATUS_QOS_NBR_NULL
+ *                             - \ref GSE_STATUS_FIFO_SIZE_NULL
+ *                             - \ref GSE_STATUS_PDU_LENGTH
+ *                             - \ref GSE_STATUS_MALLOC_FAILED
+ *                             - \ref GSE_STATUS_SHM_FAILED
+ *
+ *  @ingroup gse_encap_shm
+ */
+gse_status_t gse_encap_shm_create(uint8_t qos_nbr, unsigned int slot_nbr,
+                                  size_t max_pdu_length,
+                                  gse_encap_shm_t **shm);
+
+/**
+ *  @brief   Map a shared memory queue created by another process
+ *
+ *  The file descriptor is closed on release.
+ *
+ *  @param   fd   The file descriptor of the segment
+ *  @param   shm  OUT: The shared memory queue on success,
+ *                     NULL on error
+ *
+ *  @return
+ *                - success/informative code among:
+ *                  - \ref GSE_STATUS_OK
+ *                - warning/error code among:
+ *                  - \ref GSE_STATUS_NULL_PTR
+ *                  - \ref GSE_STATUS_MALLOC_FAILED
+ *                  - \ref GSE_STATUS_SHM_FAILED
+ *
+ *  @ingroup gse_encap_shm
+ */
+gse_status_t gse_encap_shm_attach(int fd, gse_encap_shm_t **shm);
+
+/**
+ *  @brief   Unmap a shared memory queue
+ *
+ *  The PDUs given to an encapsulation structure by
+ *  \ref gse_encap_shm_receive use the segment, the encapsulation structure
+ *  shall be released before. The segment is destroyed once all the processes
+ *  released it.
+ *
+ *  @param   shm  The shared memory queue
+ *
+ *  @return
+ *                - success/informative code among:
+ *                  - \ref GSE_STATUS_OK
+ *                - warning/error code among:
+ *                  - \ref GSE_STATUS_NULL_PTR
+ *                  - \ref GSE_STATUS_SHM_FAILED
+ *
+ *  @ingroup gse_encap_shm
+ */
+gse_status_t gse_encap_shm_release(gse_encap_shm_t *shm);
+
+/**
+ *  @brief   Get the file descriptor of the segment
+ *
+ *  @param   shm  The shared memory queue
+ *
+ *  @return       The file descriptor, -1 if shm is NULL
+ *
+ *  @ingroup gse_encap_shm
+ */
+int gse_encap_shm_get_fd(gse_encap_shm_t *shm);
+
+/**
+ *  @brief   Take a free slot to write a PDU
+ *
+ *  The PDU is written at the returned address, room is left before and
+ *  after it for the GSE header and the CRC. The slot is then queued with
+ *  \ref gse_encap_shm_push_pdu or given back with
+ *  \ref gse_encap_shm_free_pdu.
+ *
+ *  @param   shm         The shared memory queue
+ *  @param   handle      OUT: The handle of the slot
+ *  @param   data        OUT: The address where the PDU is written
+ *  @param   max_length  OUT: The maximum length of the PDU (in bytes)
+ *
+ *  @return
+ *                       - success/informative code among:
+ *                         - \ref GSE_STATUS_OK
+ *                       - warning/error code among:
+ *                         - \ref GSE_STATUS_NULL_PTR
+ *                         - \ref GSE_STATUS_FIFO_FULL (no free slot)
+ *
+ *  @ingroup gse_encap_shm
+ */
+gse_status_t gse_encap_shm_alloc_pdu(gse_encap_shm_t *shm, uint32_t *handle,
+                                     unsigned char **data,
+                                     size_t *max_length);
+
+/**
+ *  @brief   Queue a PDU written in a slot
+ *
+ *  The parameters are those of \ref gse_encap_receive_pdu_flow. The slot
+ *  shall not be used afterwards.
+ *
+ *  @param   shm         The shared memory queue
+ *  @param   handle      The handle of the slot
+ *  @param   length      The length of the PDU (in bytes)
+ *  @param   label       The PDU label
+ *  @param   label_type  The label type field value
+ *  @param   protocol    The PDU protocol
+ *  @param   qos         The QoS value of the PDU
+ *  @param   flow_key    The flow key of the PDU
+ *
+ *  @return
+ *                       - success/informative code among:
+ *                         - \ref GSE_STATUS_OK
+ *                       - warning/error code among:
+ *                         - \ref GSE_STATUS_NULL_PTR
+ *                         - \ref GSE_STATUS_INVALID_QOS
+ *                         - \ref GSE_STATUS_INVALID_LT
+ *                         - \ref GSE_STATUS_PDU_LENGTH
+ *                         - \ref GSE_STATUS_INTERNAL_ERROR
+ *
+ *  @ingroup gse_encap_shm
+ */
+gse_status_t gse_encap_shm_push_pdu(gse_encap_shm_t *shm, uint32_t handle,
+                                    size_t length, uint8_t label[6],
+                                    uint8_t label_type, uint16_t protocol,
+                                    uint8_t qos, uint32_t flow_key);
+
+/**
+ *  @brief   Give back a slot without queuing its PDU
+ *
+ *  @param   shm     The shared memory queue
+ *  @param   handle  The handle of the slot
+ *
+ *  @return
+ *                   - success/informative code among:
+ *                     - \ref GSE_STATUS_OK
+ *                   - warning/error code among:
+ *                     - \ref GSE_STATUS_NULL_PTR
+ *                     - \ref GSE_STATUS_INTERNAL_ERROR
+ *
+ *  @ingroup gse_encap_shm
+ */
+gse_status_t gse_encap_shm_free_pdu(gse_encap_shm_t *shm, uint32_t handle);
+
+/**
+ *  @brief   Give the queued PDUs to an encapsulation structure
+ *
+ *  The PDUs are not copied, their slots are given back once their last GSE
+ *  packet is built. The QoS values are served in turn. The PDUs of a
+ *  congested QoS value (see \ref gse_encap_set_watermarks) stay in the
+ *  shared memory queue.\n
+ *  The slots written by the other process are checked, a PDU whose length,
+ *  QoS value or label type is not valid is dropped and its slot given back.
+ *
+ *  @param   shm          The shared memory queue
+ *  @param   encap        The encapsulation structure, with at least the QoS
+ *                        values of the queue
+ *  @param   max_pdu_nbr  The maximum number of PDUs to give
+ *  @param   pdu_nbr      OUT: The number of PDUs given
+ *
+ *  @return
+ *                        - success/informative code among:
+ *                          - \ref GSE_STATUS_OK
+ *                        - warning/error code among:
+ *                          - \ref GSE_STATUS_NULL_PTR
+ *                          - \ref GSE_STATUS_MALLOC_FAILED
+ *                          - \ref GSE_STATUS_SHM_FAILED (invalid handle in
+ *                            a queue, the slot is lost)
+ *                          - \ref GSE_STATUS_PDU_LENGTH
+ *                          - \ref GSE_STATUS_INVALID_QOS
+ *                          - \ref GSE_STATUS_INVALID_LT
+ *                          - the codes of \ref gse_encap_receive_pdu, the
+ *                            PDU is then lost
+ *
+ *  @ingroup gse_encap_shm
+ */
+gse_status_t gse_encap_shm_receive(gse_encap_shm_t *shm, gse_encap_t *encap,
+                                   unsigned int max_pdu_nbr,
+                                   unsigned int *pdu_nbr);
+
+/**
+ *  @brief   Get the usage of the slots
+ *
+ *  The counts are only a snapshot while the other process uses the queue.
+ *
+ *  @param   shm       The shared memory queue
+ *  @param   slot_nbr  OUT: The number of slots
+ *  @param   free_nbr  OUT: The number of free slots
+ *
+ *  @return
+ *                     - success/informative code among:
+ *                       - \ref GSE_STATUS_OK
+ *                     - warning/error code among:
+ *                       - \ref GSE_STATUS_NULL_PTR
+ *
+ *  @ingroup gse_encap_shm
+ */
+gse_status_t gse_encap_shm_get_usage(gse_encap_shm_t *shm,
+                                     unsigned int *slot_nbr,
+                                     unsigned int *free_nbr);
+
+#endif
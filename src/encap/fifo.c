@@ -47,7 +47,81 @@
 #include "fifo.h"
 
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "cache.h"
+
+
+/****************************************************************************
+ *
+ *   PROTOTYPES OF PRIVATE FUNCTIONS
+ *
+ ****************************************************************************/
+
+/**
+ *  @brief   Account a new element in its flow
+ *
+ *  The flow is added at the end of the list of active flows with a quantum of
+ *  deficit if it was empty. The FIFO mutex shall be locked.
+ *
+ *  @param   fifo  The FIFO
+ *  @param   flow  The flow value of the element
+ */
+static void gse_fifo_flow_add_elt(fifo_t *fifo, uint32_t flow);
+
+/**
+ *  @brief   Account an element removal in its flow
+ *
+ *  The flow is removed from the list of active flows if it becomes empty. The
+ *  FIFO mutex shall be locked.
+ *
+ *  @param   fifo  The FIFO
+ *  @param   flow  The flow value of the element
+ */
+static void gse_fifo_flow_remove_elt(fifo_t *fifo, uint32_t flow);
+
+/**
+ *  @brief   Notify the readers that an element was pushed in the FIFO
+ *
+ *  The FIFO mutex shall not be locked.
+ *
+ *  @param   fifo       The FIFO
+ *  @param   event_fd   The eventfd to write, -1 if the FIFO was not empty or
+ *                      has no eventfd
+ */
+static void gse_fifo_notify(fifo_t *fifo, int event_fd);
+
+/**
+ *  @brief   Update the congestion state of the FIFO against its watermarks
+ *
+ *  The callback of the watermarks is called if the QoS value becomes
+ *  congested or is no longer congested. The FIFO mutex shall be locked.
+ *
+ *  @param   fifo  The FIFO
+ */
+static void gse_fifo_check_watermark(fifo_t *fifo);
+
+/**
+ *  @brief   Allocate the table of the FIFO elements if it is not allocated yet
+ *
+ *  The FIFO mutex shall be locked.
+ *
+ *  @param   fifo  The FIFO
+ *
+ *  @return
+ *                 - success/informative code among:
+ *                   - \ref GSE_STATUS_OK
+ *                 - warning/error code among:
+ *                   - \ref GSE_STATUS_MALLOC_FAILED
+ */
+static gse_status_t gse_fifo_alloc_values(fifo_t *fifo);
 
 
 /****************************************************************************
@@ -67,19 +141,32 @@ gse_status_t gse_init_fifo(fifo_t *fifo, size_t size)
     status = GSE_STATUS_FIFO_SIZE_NULL;
     goto error;
   }
-  /* Each FIFO value is an encapsulation context */
-  fifo->values = calloc(size, sizeof(gse_encap_ctx_t));
-  if(fifo->values == NULL)
-  {
-    status = GSE_STATUS_MALLOC_FAILED;
-    goto error;
-  }
+  /* Each FIFO value is an encapsulation context, the table is allocated
+   * with the first element so that unused FIFOs cost nothing */
+  fifo->values = NULL;
   /* Initialize the FIFO */
   fifo->size = size;
   fifo->first = 0;
   /* When the first element is created fifo->last become 0 */
   fifo->last = size - 1;
   fifo->elt_nbr = 0;
+  /* Flow queuing is disabled */
+  fifo->flows = NULL;
+  fifo->flow_nbr = 0;
+  fifo->quantum = 0;
+  fifo->active = 0;
+  /* Nobody is notified */
+  fifo->event_fd = -1;
+  fifo->push_seq = 0;
+  fifo->waiter_nbr = 0;
+  /* There are no watermarks */
+  fifo->length = 0;
+  fifo->watermark = NULL;
+  fifo->high_elt_nbr = 0;
+  fifo->low_elt_nbr = 0;
+  fifo->high_length = 0;
+  fifo->low_length = 0;
+  fifo->congested = 0;
   /* Initialize the mutex on the FIFO */
   if(pthread_mutex_init(&fifo->mutex, NULL) != 0)
   {
@@ -111,7 +198,14 @@ gse_status_t gse_release_fifo(fifo_t *fifo)
       i != (fifo->last + 1) % fifo->size;
       i = (i + 1) % fifo->size)
   {
-    status = gse_free_vfrag(&(fifo->values[i].vfrag));
+    if(fifo->values[i].chain != NULL)
+    {
+      status = gse_free_vfrag_chain(&(fifo->values[i].chain));
+    }
+    else
+    {
+      status = gse_free_vfrag(&(fifo->values[i].vfrag));
+    }
     if(status != GSE_STATUS_OK)
     {
       stat_mem = status;
@@ -119,6 +213,10 @@ gse_status_t gse_release_fifo(fifo_t *fifo)
   }
 
   free(fifo->values);
+  if(fifo->flows != NULL)
+  {
+    free(fifo->flows);
+  }
 
   if(pthread_mutex_unlock(&fifo->mutex) != 0)
   {
@@ -155,8 +253,14 @@ gse_status_t gse_pop_fifo(fifo_t *fifo)
     status = GSE_STATUS_FIFO_EMPTY;
     goto unlock;
   }
+  if(fifo->flows != NULL)
+  {
+    gse_fifo_flow_remove_elt(fifo, fifo->values[fifo->first].flow);
+  }
+  fifo->length -= fifo->values[fifo->first].total_length;
   fifo->first = (fifo->first + 1) % fifo->size;
   fifo->elt_nbr--;
+  gse_fifo_check_watermark(fifo);
 
 unlock:
   if(pthread_mutex_unlock(&fifo->mutex) != 0)
@@ -171,6 +275,7 @@ gse_status_t gse_push_fifo(fifo_t *fifo, gse_encap_ctx_t **context,
                            gse_encap_ctx_t ctx_elts)
 {
   gse_status_t status = GSE_STATUS_OK;
+  int event_fd = -1;
 
   assert(fifo != NULL);
   assert(context != NULL);
@@ -186,19 +291,109 @@ gse_status_t gse_push_fifo(fifo_t *fifo, gse_encap_ctx_t **context,
     status = GSE_STATUS_FIFO_FULL;
     goto unlock;
   }
+  status = gse_fifo_alloc_values(fifo);
+  if(status != GSE_STATUS_OK)
+  {
+    goto unlock;
+  }
   fifo->last = (fifo->last + 1) % fifo->size;
   fifo->elt_nbr++;
+  if(fifo->elt_nbr == 1)
+  {
+    event_fd = fifo->event_fd;
+  }
 
   /* Return the context address */
   *context = &(fifo->values[fifo->last]);
   /* Copy elements in the context */
   **context = ctx_elts;
+  if(fifo->flows != NULL)
+  {
+    gse_fifo_flow_add_elt(fifo, ctx_elts.flow);
+  }
+  fifo->length += ctx_elts.total_length;
+  gse_fifo_check_watermark(fifo);
 
 unlock:
   if(pthread_mutex_unlock(&fifo->mutex) != 0)
   {
     status = GSE_STATUS_PTHREAD_MUTEX;
   }
+  if(status == GSE_STATUS_OK)
+  {
+    gse_fifo_notify(fifo, event_fd);
+  }
+error_mutex:
+  return status;
+}
+
+gse_status_t gse_push_fifo_bulk(fifo_t *fifo, const gse_encap_ctx_t *ctx_elts,
+                                unsigned int nbr, unsigned int *pushed)
+{
+  gse_status_t status = GSE_STATUS_OK;
+  int event_fd = -1;
+  unsigned int i;
+
+  assert(fifo != NULL);
+  assert(ctx_elts != NULL || nbr == 0);
+  assert(pushed != NULL);
+
+  *pushed = 0;
+  if(nbr == 0)
+  {
+    goto error_mutex;
+  }
+
+  if(pthread_mutex_lock(&fifo->mutex) != 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+    goto error_mutex;
+  }
+
+  if(fifo->elt_nbr >= fifo->size)
+  {
+    status = GSE_STATUS_FIFO_FULL;
+    goto unlock;
+  }
+  status = gse_fifo_alloc_values(fifo);
+  if(status != GSE_STATUS_OK)
+  {
+    goto unlock;
+  }
+  if(fifo->elt_nbr == 0)
+  {
+    event_fd = fifo->event_fd;
+  }
+
+  /* The elements are pushed in order until the FIFO is full */
+  for(i = 0 ; i < nbr && fifo->elt_nbr < fifo->size ; i++)
+  {
+    fifo->last = (fifo->last + 1) % fifo->size;
+    fifo->elt_nbr++;
+    fifo->values[fifo->last] = ctx_elts[i];
+    if(fifo->flows != NULL)
+    {
+      gse_fifo_flow_add_elt(fifo, ctx_elts[i].flow);
+    }
+    fifo->length += ctx_elts[i].total_length;
+  }
+  *pushed = i;
+  if(i < nbr)
+  {
+    status = GSE_STATUS_FIFO_FULL;
+  }
+  gse_fifo_check_watermark(fifo);
+
+unlock:
+  if(pthread_mutex_unlock(&fifo->mutex) != 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+  }
+  /* The readers are woken up once for all the elements */
+  if(*pushed > 0)
+  {
+    gse_fifo_notify(fifo, event_fd);
+  }
 error_mutex:
   return status;
 }
@@ -232,6 +427,380 @@ error_mutex:
   return status;
 }
 
+gse_status_t gse_get_fifo_elt_at(fifo_t *fifo, unsigned int index,
+                                 gse_encap_ctx_t **context)
+{
+  gse_status_t status = GSE_STATUS_OK;
+
+  assert(fifo != NULL);
+  assert(context != NULL);
+
+  if(pthread_mutex_lock(&fifo->mutex) != 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+    goto error_mutex;
+  }
+
+  if(index >= fifo->elt_nbr)
+  {
+    status = GSE_STATUS_FIFO_EMPTY;
+    goto unlock;
+  }
+  *context = &(fifo->values[(fifo->first + index) % fifo->size]);
+
+unlock:
+  if(pthread_mutex_unlock(&fifo->mutex) != 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+  }
+error_mutex:
+  return status;
+}
+
+gse_status_t gse_remove_fifo_elt_at(fifo_t *fifo, unsigned int index)
+{
+  gse_status_t status = GSE_STATUS_OK;
+
+  unsigned int i;
+
+  assert(fifo != NULL);
+
+  if(pthread_mutex_lock(&fifo->mutex) != 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+    goto error_mutex;
+  }
+
+  if(index >= fifo->elt_nbr)
+  {
+    status = GSE_STATUS_FIFO_EMPTY;
+    goto unlock;
+  }
+  if(fifo->flows != NULL)
+  {
+    gse_fifo_flow_remove_elt(fifo,
+                             fifo->values[(fifo->first + index) % fifo->size].flow);
+  }
+  fifo->length -=
+    fifo->values[(fifo->first + index) % fifo->size].total_length;
+  /* Move the elements placed before the removed one, the element at the head
+   * of the FIFO is then released */
+  for(i = index ; i > 0 ; i--)
+  {
+    fifo->values[(fifo->first + i) % fifo->size] =
+      fifo->values[(fifo->first + i - 1) % fifo->size];
+  }
+  fifo->first = (fifo->first + 1) % fifo->size;
+  fifo->elt_nbr--;
+  gse_fifo_check_watermark(fifo);
+
+unlock:
+  if(pthread_mutex_unlock(&fifo->mutex) != 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+  }
+error_mutex:
+  return status;
+}
+
+gse_status_t gse_set_fifo_flows(fifo_t *fifo, unsigned int flow_nbr,
+                                unsigned int quantum)
+{
+  gse_status_t status = GSE_STATUS_OK;
+
+  fifo_flow_t *flows = NULL;
+
+  assert(fifo != NULL);
+
+  if(pthread_mutex_lock(&fifo->mutex) != 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+    goto error_mutex;
+  }
+
+  /* The elements already in the FIFO are not accounted in the flows */
+  if(fifo->elt_nbr > 0)
+  {
+    status = GSE_STATUS_FIFO_NOT_EMPTY;
+    goto unlock;
+  }
+  if(flow_nbr > 0)
+  {
+    flows = calloc(flow_nbr, sizeof(fifo_flow_t));
+    if(flows == NULL)
+    {
+      status = GSE_STATUS_MALLOC_FAILED;
+      goto unlock;
+    }
+  }
+  if(fifo->flows != NULL)
+  {
+    free(fifo->flows);
+  }
+  fifo->flows = flows;
+  fifo->flow_nbr = flow_nbr;
+  /* A null quantum would never let a flow be served */
+  fifo->quantum = (quantum > 0 ? quantum : 1);
+  fifo->active = flow_nbr;
+
+unlock:
+  if(pthread_mutex_unlock(&fifo->mutex) != 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+  }
+error_mutex:
+  return status;
+}
+
+gse_status_t gse_select_fifo_flow(fifo_t *fifo, int keep_frag,
+                                  unsigned int *index)
+{
+  gse_status_t status = GSE_STATUS_OK;
+
+  fifo_flow_t *flow;
+  unsigned int i;
+
+  assert(fifo != NULL);
+  assert(index != NULL);
+
+  if(pthread_mutex_lock(&fifo->mutex) != 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+    goto error_mutex;
+  }
+
+  *index = 0;
+  if(fifo->elt_nbr == 0)
+  {
+    status = GSE_STATUS_FIFO_EMPTY;
+    goto unlock;
+  }
+  if(fifo->flows == NULL)
+  {
+    goto unlock;
+  }
+
+  /* The deficit of each active flow grows at each round so a flow is
+   * eventually selected */
+  while(1)
+  {
+    if(fifo->active >= fifo->flow_nbr)
+    {
+      status = GSE_STATUS_INTERNAL_ERROR;
+      goto unlock;
+    }
+    flow = &fifo->flows[fifo->active];
+    if(flow->deficit > 0 || keep_frag)
+    {
+      /* Look for the first element of the flow */
+      for(i = 0 ; i < fifo->elt_nbr ; i++)
+      {
+        if(fifo->values[(fifo->first + i) % fifo->size].flow % fifo->flow_nbr ==
+           fifo->active)
+        {
+          break;
+        }
+      }
+      if(i >= fifo->elt_nbr)
+      {
+        status = GSE_STATUS_INTERNAL_ERROR;
+        goto unlock;
+      }
+      if(flow->deficit > 0 ||
+         fifo->values[(fifo->first + i) % fifo->size].frag_nbr > 0)
+      {
+        *index = i;
+        break;
+      }
+    }
+    flow->deficit += fifo->quantum;
+    fifo->active = flow->next;
+  }
+
+unlock:
+  if(pthread_mutex_unlock(&fifo->mutex) != 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+  }
+error_mutex:
+  return status;
+}
+
+gse_status_t gse_charge_fifo_flow(fifo_t *fifo, uint32_t flow, size_t length)
+{
+  assert(fifo != NULL);
+
+  if(pthread_mutex_lock(&fifo->mutex) != 0)
+  {
+    return GSE_STATUS_PTHREAD_MUTEX;
+  }
+  if(fifo->flows != NULL)
+  {
+    fifo->flows[flow % fifo->flow_nbr].deficit -= length;
+  }
+  if(pthread_mutex_unlock(&fifo->mutex) != 0)
+  {
+    return GSE_STATUS_PTHREAD_MUTEX;
+  }
+  return GSE_STATUS_OK;
+}
+
+gse_status_t gse_init_fifo_watermark(fifo_watermark_t *watermark, uint8_t qos)
+{
+  assert(watermark != NULL);
+
+  memset(watermark, 0, sizeof(fifo_watermark_t));
+  watermark->qos = qos;
+  if(pthread_mutex_init(&watermark->mutex, NULL) != 0)
+  {
+    return GSE_STATUS_PTHREAD_MUTEX;
+  }
+  return GSE_STATUS_OK;
+}
+
+gse_status_t gse_release_fifo_watermark(fifo_watermark_t *watermark)
+{
+  assert(watermark != NULL);
+
+  if(pthread_mutex_destroy(&watermark->mutex) != 0)
+  {
+    return GSE_STATUS_PTHREAD_MUTEX;
+  }
+  return GSE_STATUS_OK;
+}
+
+gse_status_t gse_set_fifo_watermark_callback(fifo_watermark_t *watermark,
+                                             gse_encap_watermark_cb_t callback,
+                                             void *opaque)
+{
+  assert(watermark != NULL);
+
+  if(pthread_mutex_lock(&watermark->mutex) != 0)
+  {
+    return GSE_STATUS_PTHREAD_MUTEX;
+  }
+  watermark->callback = callback;
+  watermark->opaque = opaque;
+  if(pthread_mutex_unlock(&watermark->mutex) != 0)
+  {
+    return GSE_STATUS_PTHREAD_MUTEX;
+  }
+  return GSE_STATUS_OK;
+}
+
+gse_status_t gse_set_fifo_watermark(fifo_t *fifo, fifo_watermark_t *watermark)
+{
+  assert(fifo != NULL);
+  assert(watermark != NULL);
+
+  if(pthread_mutex_lock(&fifo->mutex) != 0)
+  {
+    return GSE_STATUS_PTHREAD_MUTEX;
+  }
+  fifo->watermark = watermark;
+  fifo->high_elt_nbr = watermark->high_elt_nbr;
+  fifo->low_elt_nbr = watermark->low_elt_nbr;
+  fifo->high_length = watermark->high_length;
+  fifo->low_length = watermark->low_length;
+  gse_fifo_check_watermark(fifo);
+  if(pthread_mutex_unlock(&fifo->mutex) != 0)
+  {
+    return GSE_STATUS_PTHREAD_MUTEX;
+  }
+  return GSE_STATUS_OK;
+}
+
+gse_status_t gse_set_fifo_event_fd(fifo_t *fifo, int fd)
+{
+  assert(fifo != NULL);
+
+  if(pthread_mutex_lock(&fifo->mutex) != 0)
+  {
+    return GSE_STATUS_PTHREAD_MUTEX;
+  }
+  fifo->event_fd = fd;
+  if(pthread_mutex_unlock(&fifo->mutex) != 0)
+  {
+    return GSE_STATUS_PTHREAD_MUTEX;
+  }
+  return GSE_STATUS_OK;
+}
+
+gse_status_t gse_wait_fifo(fifo_t *fifo, unsigned int timeout)
+{
+  gse_status_t status = GSE_STATUS_OK;
+
+  struct timespec now;
+  struct timespec end;
+  struct timespec delay;
+  uint32_t seq;
+  int elt_nbr;
+  long ret;
+
+  assert(fifo != NULL);
+
+  if(clock_gettime(CLOCK_MONOTONIC, &end) != 0)
+  {
+    status = GSE_STATUS_EVENT_FAILED;
+    goto error;
+  }
+  end.tv_sec += timeout / 1000000;
+  end.tv_nsec += (timeout % 1000000) * 1000;
+  if(end.tv_nsec >= 1000000000)
+  {
+    end.tv_sec++;
+    end.tv_nsec -= 1000000000;
+  }
+
+  while(1)
+  {
+    /* The sequence is read before the FIFO is checked, a push done after the
+     * check changes it and the futex does not sleep */
+    seq = __atomic_load_n(&fifo->push_seq, __ATOMIC_SEQ_CST);
+    elt_nbr = gse_get_fifo_elt_nbr(fifo);
+    if(elt_nbr < 0)
+    {
+      status = GSE_STATUS_PTHREAD_MUTEX;
+      goto error;
+    }
+    if(elt_nbr > 0)
+    {
+      break;
+    }
+
+    if(clock_gettime(CLOCK_MONOTONIC, &now) != 0)
+    {
+      status = GSE_STATUS_EVENT_FAILED;
+      goto error;
+    }
+    delay.tv_sec = end.tv_sec - now.tv_sec;
+    delay.tv_nsec = end.tv_nsec - now.tv_nsec;
+    if(delay.tv_nsec < 0)
+    {
+      delay.tv_sec--;
+      delay.tv_nsec += 1000000000;
+    }
+    if(delay.tv_sec < 0 || (delay.tv_sec == 0 && delay.tv_nsec == 0))
+    {
+      status = GSE_STATUS_FIFO_EMPTY;
+      goto error;
+    }
+
+    __atomic_add_fetch(&fifo->waiter_nbr, 1, __ATOMIC_SEQ_CST);
+    ret = syscall(SYS_futex, &fifo->push_seq, FUTEX_WAIT_PRIVATE, seq,
+                  &delay, NULL, 0);
+    __atomic_sub_fetch(&fifo->waiter_nbr, 1, __ATOMIC_SEQ_CST);
+    if(ret != 0 && errno != EAGAIN && errno != EINTR && errno != ETIMEDOUT)
+    {
+      status = GSE_STATUS_EVENT_FAILED;
+      goto error;
+    }
+  }
+
+error:
+  return status;
+}
+
 int gse_get_fifo_elt_nbr(fifo_t *const fifo)
 {
   int nbr;
@@ -252,3 +821,193 @@ int gse_get_fifo_elt_nbr(fifo_t *const fifo)
 error:
   return -1;
 }
+
+size_t gse_get_fifo_footprint(fifo_t *const fifo)
+{
+  size_t footprint = 0;
+
+  assert(fifo != NULL);
+
+  if(pthread_mutex_lock(&fifo->mutex) != 0)
+  {
+    goto error;
+  }
+  if(fifo->values != NULL)
+  {
+    footprint += fifo->size * sizeof(gse_encap_ctx_t);
+  }
+  if(fifo->flows != NULL)
+  {
+    footprint += fifo->flow_nbr * sizeof(fifo_flow_t);
+  }
+  pthread_mutex_unlock(&fifo->mutex);
+
+error:
+  return footprint;
+}
+
+
+/****************************************************************************
+ *
+ *   PRIVATE FUNCTIONS
+ *
+ ****************************************************************************/
+
+static void gse_fifo_flow_add_elt(fifo_t *fifo, uint32_t flow)
+{
+  unsigned int index = flow % fifo->flow_nbr;
+  fifo_flow_t *flows = fifo->flows;
+  unsigned int last;
+
+  flows[index].elt_nbr++;
+  if(flows[index].elt_nbr > 1)
+  {
+    return;
+  }
+
+  /* The list of active flows is circular, the last flow is the previous
+   * flow of the first one */
+  flows[index].deficit = fifo->quantum;
+  if(fifo->active >= fifo->flow_nbr)
+  {
+    flows[index].prev = index;
+    flows[index].next = index;
+    fifo->active = index;
+  }
+  else
+  {
+    last = flows[fifo->active].prev;
+    flows[index].prev = last;
+    flows[index].next = fifo->active;
+    flows[last].next = index;
+    flows[fifo->active].prev = index;
+  }
+}
+
+static void gse_fifo_flow_remove_elt(fifo_t *fifo, uint32_t flow)
+{
+  unsigned int index = flow % fifo->flow_nbr;
+  fifo_flow_t *flows = fifo->flows;
+
+  assert(flows[index].elt_nbr > 0);
+
+  flows[index].elt_nbr--;
+  if(flows[index].elt_nbr > 0)
+  {
+    return;
+  }
+
+  /* An empty flow leaves the list of active flows and loses its deficit */
+  flows[index].deficit = 0;
+  if(flows[index].next == index)
+  {
+    fifo->active = fifo->flow_nbr;
+  }
+  else
+  {
+    flows[flows[index].prev].next = flows[index].next;
+    flows[flows[index].next].prev = flows[index].prev;
+    if(fifo->active == index)
+    {
+      fifo->active = flows[index].next;
+    }
+  }
+}
+
+static gse_status_t gse_fifo_alloc_values(fifo_t *fifo)
+{
+  if(fifo->values != NULL)
+  {
+    return GSE_STATUS_OK;
+  }
+
+  /* The table starts on a cache line so that the hot fields of the first
+   * contexts are read at once */
+  if(posix_memalign((void **)&fifo->values, GSE_CACHE_LINE_SIZE,
+                    fifo->size * sizeof(gse_encap_ctx_t)) != 0)
+  {
+    fifo->values = NULL;
+    return GSE_STATUS_MALLOC_FAILED;
+  }
+  memset(fifo->values, 0, fifo->size * sizeof(gse_encap_ctx_t));
+
+  return GSE_STATUS_OK;
+}
+
+static void gse_fifo_notify(fifo_t *fifo, int event_fd)
+{
+  uint64_t event = 1;
+
+  /* The pusher reads the number of waiters after changing the sequence, so
+   * either it sees the waiter or the waiter sees the new sequence */
+  __atomic_add_fetch(&fifo->push_seq, 1, __ATOMIC_SEQ_CST);
+  if(__atomic_load_n(&fifo->waiter_nbr, __ATOMIC_SEQ_CST) > 0)
+  {
+    syscall(SYS_futex, &fifo->push_seq, FUTEX_WAKE_PRIVATE, INT_MAX,
+            NULL, NULL, 0);
+  }
+  if(event_fd >= 0 && write(event_fd, &event, sizeof(event)) < 0)
+  {
+    /* Nothing to do, the reader still finds the element on its next read of
+     * the FIFO */
+  }
+}
+
+static void gse_fifo_check_watermark(fifo_t *fifo)
+{
+  fifo_watermark_t *watermark = fifo->watermark;
+  int congested;
+  int notify = 0;
+
+  if(watermark == NULL)
+  {
+    return;
+  }
+
+  /* Between the watermarks the FIFO keeps its state */
+  if(!fifo->congested)
+  {
+    congested = ((fifo->high_elt_nbr > 0 &&
+                  fifo->elt_nbr >= fifo->high_elt_nbr) ||
+                 (fifo->high_length > 0 &&
+                  fifo->length >= fifo->high_length));
+  }
+  else
+  {
+    congested = !((fifo->high_elt_nbr == 0 ||
+                   fifo->elt_nbr <= fifo->low_elt_nbr) &&
+                  (fifo->high_length == 0 ||
+                   fifo->length <= fifo->low_length));
+  }
+  if(congested == fifo->congested)
+  {
+    return;
+  }
+
+  /* The QoS value is congested while one of its FIFOs is, the callbacks are
+   * called under the mutex of the watermarks so they are called in order */
+  if(pthread_mutex_lock(&watermark->mutex) != 0)
+  {
+    return;
+  }
+  fifo->congested = congested;
+  if(congested)
+  {
+    watermark->congested_nbr++;
+    notify = (watermark->congested_nbr == 1);
+  }
+  else
+  {
+    watermark->congested_nbr--;
+    notify = (watermark->congested_nbr == 0);
+  }
+  if(notify)
+  {
+    __atomic_store_n(&watermark->congested, congested, __ATOMIC_RELEASE);
+    if(watermark->callback != NULL)
+    {
+      watermark->callback(watermark->qos, congested, watermark->opaque);
+    }
+  }
+  pthread_mutex_unlock(&watermark->mutex);
+}
@@ -50,6 +50,7 @@
 
 #include <pthread.h>
 
+#include "encap.h"
 #include "encap_ctx.h"
 
 /****************************************************************************
@@ -58,6 +59,35 @@
  *
  ****************************************************************************/
 
+/** Flow of the flow queuing stage of a FIFO */
+typedef struct
+{
+  unsigned int elt_nbr;  /**< Number of elements of the flow in the FIFO */
+  long deficit;          /**< Number of bytes the flow can still send in its
+                              round (may be negative after a packet larger
+                              than the remaining deficit) */
+  unsigned int prev;     /**< Previous flow in the list of active flows */
+  unsigned int next;     /**< Next flow in the list of active flows */
+} fifo_flow_t;
+
+/** Watermarks and congestion state shared by the FIFOs of a QoS value */
+typedef struct
+{
+  uint8_t qos;                /**< The QoS value of the FIFOs */
+  unsigned int high_elt_nbr;  /**< High watermark in elements, 0 if unused */
+  unsigned int low_elt_nbr;   /**< Low watermark in elements */
+  size_t high_length;         /**< High watermark in bytes, 0 if unused */
+  size_t low_length;          /**< Low watermark in bytes */
+  unsigned int congested_nbr; /**< Number of congested FIFOs */
+  int congested;              /**< Whether one of the FIFOs is congested,
+                                   read without lock */
+  gse_encap_watermark_cb_t callback; /**< Callback called when the QoS value
+                                          becomes congested or not,
+                                          NULL if none */
+  void *opaque;               /**< User specific data for the callback */
+  pthread_mutex_t mutex;      /**< Mutex on the congestion state */
+} fifo_watermark_t;
+
 /** FIFO of GSE encapsulation contexts */
 typedef struct
 {
@@ -67,6 +97,27 @@ typedef struct
   unsigned int last;        /**< Index of the last element of the FIFO */
   unsigned int elt_nbr;     /**< Number of elements in the FIFO */
   pthread_mutex_t mutex;    /**< Mutex on the context for multithreading support */
+  fifo_flow_t *flows;       /**< The table of flows, NULL if flow queuing is
+                                 disabled */
+  unsigned int flow_nbr;    /**< Number of flows */
+  unsigned int quantum;     /**< Number of bytes given to a flow each round */
+  unsigned int active;      /**< First flow of the list of active flows,
+                                 flow_nbr if there is no active flow */
+  int event_fd;             /**< eventfd written when the FIFO becomes non
+                                 empty, -1 if there is none */
+  uint32_t push_seq;        /**< Number of elements pushed, the threads
+                                 waiting for an element sleep on it */
+  unsigned int waiter_nbr;  /**< Number of threads waiting for an element */
+  size_t length;            /**< Sum of the Total Length fields of the
+                                 elements (in bytes) */
+  fifo_watermark_t *watermark; /**< The watermarks of the FIFO, NULL if
+                                    there are none */
+  unsigned int high_elt_nbr; /**< Copy of the high watermark in elements */
+  unsigned int low_elt_nbr;  /**< Copy of the low watermark in elements */
+  size_t high_length;       /**< Copy of the high watermark in bytes */
+  size_t low_length;        /**< Copy of the low watermark in bytes */
+  int congested;            /**< Whether the FIFO reached its high watermark
+                                 and did not go back to its low one */
 } fifo_t;
 
 /****************************************************************************
@@ -82,6 +133,8 @@ typedef struct
 /**
  *  @brief   Initialize a FIFO
  *
+ *  The table of elements is allocated when the first element is pushed.
+ *
  *  @param   fifo  The FIFO to initialize
  *  @param   size  The size of the FIFO
  *
@@ -90,7 +143,6 @@ typedef struct
  *                   - \ref GSE_STATUS_OK
  *                 - warning/error code among:
  *                   - \ref GSE_STATUS_FIFO_SIZE_NULL
- *                   - \ref GSE_STATUS_MALLOC_FAILED
  *                   - \ref GSE_STATUS_PTHREAD_MUTEX
  */
 gse_status_t gse_init_fifo(fifo_t *fifo, size_t size);
@@ -143,10 +195,34 @@ gse_status_t gse_pop_fifo(fifo_t *fifo);
  *                     - warning/error code among:
  *                       - \ref GSE_STATUS_PTHREAD_MUTEX
  *                       - \ref GSE_STATUS_FIFO_FULL
+ *                       - \ref GSE_STATUS_MALLOC_FAILED
  */
 gse_status_t gse_push_fifo(fifo_t *fifo, gse_encap_ctx_t **context,
                            gse_encap_ctx_t ctx_elts);
 
+/**
+ *  @brief   Add several elements at once at the end of the FIFO
+ *
+ *  The FIFO is locked once and the readers are notified once for all the
+ *  elements. The elements are pushed in order until the FIFO is full, the
+ *  elements that were not pushed are left to the caller.
+ *
+ *  @param   fifo      The FIFO
+ *  @param   ctx_elts  The table of the elements to push
+ *  @param   nbr       The number of elements to push
+ *  @param   pushed    OUT: The number of elements pushed
+ *
+ *  @return
+ *                     - success/informative code among:
+ *                       - \ref GSE_STATUS_OK
+ *                     - warning/error code among:
+ *                       - \ref GSE_STATUS_PTHREAD_MUTEX
+ *                       - \ref GSE_STATUS_FIFO_FULL
+ *                       - \ref GSE_STATUS_MALLOC_FAILED
+ */
+gse_status_t gse_push_fifo_bulk(fifo_t *fifo, const gse_encap_ctx_t *ctx_elts,
+                                unsigned int nbr, unsigned int *pushed);
+
 /**
  *  @brief   Get the first element of the FIFO without removing it
  *
@@ -166,6 +242,211 @@ gse_status_t gse_push_fifo(fifo_t *fifo, gse_encap_ctx_t **context,
  */
 gse_status_t gse_get_fifo_elt(fifo_t *fifo, gse_encap_ctx_t **context);
 
+/**
+ *  @brief   Get an element of the FIFO by its position without removing it
+ *
+ *  The FIFO is protected by a mutex when getting the element but the element is
+ *  not protected afterwards. The returned address is only valid until the next
+ *  removal in the FIFO.
+ *
+ *  @param   fifo     The FIFO
+ *  @param   index    The position of the element (0 is the first element)
+ *  @param   context  OUT: The element to get in the FIFO
+ *
+ *  @return
+ *                    - success/informative code among:
+ *                      - \ref GSE_STATUS_OK
+ *                    - warning/error code among:
+ *                      - \ref GSE_STATUS_PTHREAD_MUTEX
+ *                      - \ref GSE_STATUS_FIFO_EMPTY
+ */
+gse_status_t gse_get_fifo_elt_at(fifo_t *fifo, unsigned int index,
+                                 gse_encap_ctx_t **context);
+
+/**
+ *  @brief   Remove an element of the FIFO by its position
+ *
+ *  The elements placed before the removed one are moved by one position so
+ *  the order of the remaining elements is kept. Removing the element at
+ *  position 0 is equivalent to \ref gse_pop_fifo.
+ *
+ *  @param   fifo   The FIFO
+ *  @param   index  The position of the element (0 is the first element)
+ *
+ *  @return
+ *                  - success/informative code among:
+ *                    - \ref GSE_STATUS_OK
+ *                  - warning/error code among:
+ *                    - \ref GSE_STATUS_PTHREAD_MUTEX
+ *                    - \ref GSE_STATUS_FIFO_EMPTY
+ */
+gse_status_t gse_remove_fifo_elt_at(fifo_t *fifo, unsigned int index);
+
+/**
+ *  @brief   Enable or disable the flow queuing stage of the FIFO
+ *
+ *  The elements are hashed in a fixed number of flows according to their
+ *  flow value. The flows are served with Deficit Round Robin (DRR), see
+ *  \ref gse_select_fifo_flow. The FIFO shall be empty.
+ *
+ *  @param   fifo      The FIFO
+ *  @param   flow_nbr  The number of flows, 0 to disable flow queuing
+ *  @param   quantum   The number of bytes given to a flow each round
+ *
+ *  @return
+ *                     - success/informative code among:
+ *                       - \ref GSE_STATUS_OK
+ *                     - warning/error code among:
+ *                       - \ref GSE_STATUS_PTHREAD_MUTEX
+ *                       - \ref GSE_STATUS_FIFO_NOT_EMPTY
+ *                       - \ref GSE_STATUS_MALLOC_FAILED
+ */
+gse_status_t gse_set_fifo_flows(fifo_t *fifo, unsigned int flow_nbr,
+                                unsigned int quantum);
+
+/**
+ *  @brief   Select the next element to serve with Deficit Round Robin
+ *
+ *  The first active flow is served while its deficit is positive. Otherwise
+ *  the quantum is added to its deficit and it is moved at the end of the list
+ *  of active flows. The selected element is the first element of the flow.
+ *
+ *  @param   fifo       The FIFO
+ *  @param   keep_frag  Whether a flow whose first element is being
+ *                      fragmented is served whatever its deficit
+ *  @param   index      OUT: The position of the element
+ *                           (0 is the first element)
+ *
+ *  @return
+ *                      - success/informative code among:
+ *                        - \ref GSE_STATUS_OK
+ *                      - warning/error code among:
+ *                        - \ref GSE_STATUS_PTHREAD_MUTEX
+ *                        - \ref GSE_STATUS_FIFO_EMPTY
+ *                        - \ref GSE_STATUS_INTERNAL_ERROR
+ */
+gse_status_t gse_select_fifo_flow(fifo_t *fifo, int keep_frag,
+                                  unsigned int *index);
+
+/**
+ *  @brief   Remove the sent bytes from the deficit of a flow
+ *
+ *  Nothing is done if flow queuing is disabled.
+ *
+ *  @param   fifo    The FIFO
+ *  @param   flow    The flow value of the element
+ *  @param   length  The number of sent bytes
+ *
+ *  @return
+ *                   - success/informative code among:
+ *                     - \ref GSE_STATUS_OK
+ *                   - warning/error code among:
+ *                     - \ref GSE_STATUS_PTHREAD_MUTEX
+ */
+gse_status_t gse_charge_fifo_flow(fifo_t *fifo, uint32_t flow, size_t length);
+
+/**
+ *  @brief   Initialize the watermarks shared by the FIFOs of a QoS value
+ *
+ *  The watermarks are disabled and there is no callback.
+ *
+ *  @param   watermark  The watermarks
+ *  @param   qos        The QoS value of the FIFOs
+ *
+ *  @return
+ *                      - success/informative code among:
+ *                        - \ref GSE_STATUS_OK
+ *                      - warning/error code among:
+ *                        - \ref GSE_STATUS_PTHREAD_MUTEX
+ */
+gse_status_t gse_init_fifo_watermark(fifo_watermark_t *watermark, uint8_t qos);
+
+/**
+ *  @brief   Release the watermarks shared by the FIFOs of a QoS value
+ *
+ *  @param   watermark  The watermarks
+ *
+ *  @return
+ *                      - success/informative code among:
+ *                        - \ref GSE_STATUS_OK
+ *                      - warning/error code among:
+ *                        - \ref GSE_STATUS_PTHREAD_MUTEX
+ */
+gse_status_t gse_release_fifo_watermark(fifo_watermark_t *watermark);
+
+/**
+ *  @brief   Set the callback of the watermarks
+ *
+ *  @param   watermark  The watermarks
+ *  @param   callback   The callback, NULL to remove it
+ *  @param   opaque     The user specific data given to the callback
+ *
+ *  @return
+ *                      - success/informative code among:
+ *                        - \ref GSE_STATUS_OK
+ *                      - warning/error code among:
+ *                        - \ref GSE_STATUS_PTHREAD_MUTEX
+ */
+gse_status_t gse_set_fifo_watermark_callback(fifo_watermark_t *watermark,
+                                             gse_encap_watermark_cb_t callback,
+                                             void *opaque);
+
+/**
+ *  @brief   Apply watermarks to the FIFO
+ *
+ *  The levels of the watermarks are copied in the FIFO, they shall not be
+ *  modified meanwhile. The congestion of the FIFO is checked again with the
+ *  new levels.
+ *
+ *  @param   fifo       The FIFO
+ *  @param   watermark  The watermarks
+ *
+ *  @return
+ *                      - success/informative code among:
+ *                        - \ref GSE_STATUS_OK
+ *                      - warning/error code among:
+ *                        - \ref GSE_STATUS_PTHREAD_MUTEX
+ */
+gse_status_t gse_set_fifo_watermark(fifo_t *fifo, fifo_watermark_t *watermark);
+
+/**
+ *  @brief   Set the eventfd written when the FIFO becomes non empty
+ *
+ *  The eventfd is only written when an element is pushed in an empty FIFO,
+ *  the reader shall empty the FIFO once the eventfd is readable to be
+ *  notified again. The eventfd is not closed with the FIFO.
+ *
+ *  @param   fifo  The FIFO
+ *  @param   fd    The eventfd, -1 to disable the notification
+ *
+ *  @return
+ *                 - success/informative code among:
+ *                   - \ref GSE_STATUS_OK
+ *                 - warning/error code among:
+ *                   - \ref GSE_STATUS_PTHREAD_MUTEX
+ */
+gse_status_t gse_set_fifo_event_fd(fifo_t *fifo, int fd);
+
+/**
+ *  @brief   Wait until the FIFO is not empty
+ *
+ *  The thread sleeps on a futex that is only woken up by the pushes done
+ *  while a thread is waiting, the pushes cost no system call otherwise.
+ *
+ *  @param   fifo     The FIFO
+ *  @param   timeout  The maximum waiting time (in microseconds),
+ *                    0 to only check the FIFO
+ *
+ *  @return
+ *                    - success/informative code among:
+ *                      - \ref GSE_STATUS_OK
+ *                    - warning/error code among:
+ *                      - \ref GSE_STATUS_PTHREAD_MUTEX
+ *                      - \ref GSE_STATUS_FIFO_EMPTY
+ *                      - \ref GSE_STATUS_EVENT_FAILED
+ */
+gse_status_t gse_wait_fifo(fifo_t *fifo, unsigned int timeout);
+
 /**
  *  @brief   Get the number of elements in the FIFO
  *
@@ -178,4 +459,16 @@ gse_status_t gse_get_fifo_elt(fifo_t *fifo, gse_encap_ctx_t **context);
  */
 int gse_get_fifo_elt_nbr(fifo_t *const fifo);
 
+/**
+ *  @brief   Get the memory allocated for the tables of the FIFO
+ *
+ *  The table of elements is only accounted once it is allocated, i.e. once
+ *  an element was pushed in the FIFO. The FIFO structure itself is not
+ *  accounted.
+ *
+ *  @param   fifo   The FIFO
+ *  @return         The size of the tables of the FIFO (in bytes)
+ */
+size_t gse_get_fifo_footprint(fifo_t *const fifo);
+
 #endif
@@ -0,0 +1,430 @@
+/*
+ *
+ * This piece of software is an implementation of the Generic Stream
+ * Encapsulation (GSE) standard defined by ETSI for Linux (or other
+ * Unix-compatible OS). The library may be used to add GSE
+ * encapsulation/de-encapsulation capabilities to an application.
+ *
+ *
+ * Copyright © 2016 TAS
+ *
+ *
+ * This file is part of the GSE library.
+ *
+ *
+ * The GSE library is free software : you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY, without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see http://www.gnu.org/licenses/.
+ *
+ */
+/****************************************************************************/
+/**
+ *   @file          label_map.c
+ *
+ *          Project:     GSE LIBRARY
+ *
+ *          Company:     THALES ALENIA SPACE
+ *
+ *          Module name: LABEL MAP
+ *
+ *   @brief         Table associating a value to GSE labels
+ *
+ *   @author        Julien BERNARD / Viveris Technologies
+ *
+ */
+/****************************************************************************/
+
+#include "label_map.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "constants.h"
+
+
+/****************************************************************************
+ *
+ *   STRUCTURES AND TYPES
+ *
+ ****************************************************************************/
+
+/** The number of entries allocated with the first label */
+#define GSE_LABEL_MAP_MIN_SIZE 16
+
+
+/****************************************************************************
+ *
+ *   PROTOTYPES OF PRIVATE FUNCTIONS
+ *
+ ****************************************************************************/
+
+/**
+ *  @brief   Build the key of a label
+ *
+ *  @param   label       The label
+ *  @param   label_type  The label type
+ *  @param   key         OUT: The key
+ *
+ *  @return
+ *                       - success/informative code among:
+ *                         - \ref GSE_STATUS_OK
+ *                       - warning/error code among:
+ *                         - \ref GSE_STATUS_INVALID_LT
+ */
+static gse_status_t gse_build_label_key(uint8_t label[6], uint8_t label_type,
+                                        uint8_t key[GSE_LABEL_KEY_LENGTH]);
+
+/**
+ *  @brief   Find the entry of a key or the free entry where it should be added
+ *
+ *  @param   map  The table, it shall contain entries
+ *  @param   key  The key
+ *
+ *  @return       The index of the entry
+ */
+static size_t gse_find_label_entry(label_map_t *map,
+                                   uint8_t key[GSE_LABEL_KEY_LENGTH]);
+
+/**
+ *  @brief   Allocate a larger table and move the entries in it
+ *
+ *  @param   map  The table
+ *
+ *  @return
+ *                - success/informative code among:
+ *                  - \ref GSE_STATUS_OK
+ *                - warning/error code among:
+ *                  - \ref GSE_STATUS_MALLOC_FAILED
+ */
+static gse_status_t gse_grow_label_map(label_map_t *map);
+
+
+/****************************************************************************
+ *
+ *   PUBLIC FUNCTIONS
+ *
+ ****************************************************************************/
+
+gse_status_t gse_init_label_map(label_map_t *map)
+{
+  gse_status_t status = GSE_STATUS_OK;
+
+  assert(map != NULL);
+
+  map->entries = NULL;
+  map->size = 0;
+  map->elt_nbr = 0;
+  if(pthread_mutex_init(&map->mutex, NULL) != 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+  }
+
+  return status;
+}
+
+gse_status_t gse_release_label_map(label_map_t *map)
+{
+  gse_status_t status = GSE_STATUS_OK;
+
+  assert(map != NULL);
+
+  free(map->entries);
+  map->entries = NULL;
+  map->size = 0;
+  map->elt_nbr = 0;
+  if(pthread_mutex_destroy(&map->mutex) != 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+  }
+
+  return status;
+}
+
+gse_status_t gse_set_label_map(label_map_t *map, uint8_t label[6],
+                               uint8_t label_type, uint32_t value)
+{
+  gse_status_t status = GSE_STATUS_OK;
+
+  uint8_t key[GSE_LABEL_KEY_LENGTH];
+  size_t index;
+
+  assert(map != NULL);
+
+  status = gse_build_label_key(label, label_type, key);
+  if(status != GSE_STATUS_OK)
+  {
+    goto error_mutex;
+  }
+
+  if(pthread_mutex_lock(&map->mutex) != 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+    goto error_mutex;
+  }
+
+  /* Keep the table at most half full so that probing sequences are short */
+  if((map->elt_nbr + 1) * 2 > map->size)
+  {
+    status = gse_grow_label_map(map);
+    if(status != GSE_STATUS_OK)
+    {
+      goto unlock;
+    }
+  }
+
+  index = gse_find_label_entry(map, key);
+  if(!map->entries[index].used)
+  {
+    memcpy(map->entries[index].key, key, GSE_LABEL_KEY_LENGTH);
+    map->entries[index].used = 1;
+    map->elt_nbr++;
+  }
+  map->entries[index].value = value;
+
+unlock:
+  if(pthread_mutex_unlock(&map->mutex) != 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+  }
+error_mutex:
+  return status;
+}
+
+gse_status_t gse_remove_label_map(label_map_t *map, uint8_t label[6],
+                                  uint8_t label_type)
+{
+  gse_status_t status = GSE_STATUS_OK;
+
+  uint8_t key[GSE_LABEL_KEY_LENGTH];
+  size_t index;
+  size_t next;
+  size_t home;
+
+  assert(map != NULL);
+
+  status = gse_build_label_key(label, label_type, key);
+  if(status != GSE_STATUS_OK)
+  {
+    goto error_mutex;
+  }
+
+  if(pthread_mutex_lock(&map->mutex) != 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+    goto error_mutex;
+  }
+
+  if(map->elt_nbr == 0)
+  {
+    status = GSE_STATUS_UNKNOWN_LABEL;
+    goto unlock;
+  }
+  index = gse_find_label_entry(map, key);
+  if(!map->entries[index].used)
+  {
+    status = GSE_STATUS_UNKNOWN_LABEL;
+    goto unlock;
+  }
+  map->entries[index].used = 0;
+  map->elt_nbr--;
+
+  /* Move back the following entries of the probing sequence that could not
+   * be found anymore because of the free entry */
+  next = (index + 1) & (map->size - 1);
+  while(map->entries[next].used)
+  {
+    home = gse_find_label_entry(map, map->entries[next].key);
+    if(home != next)
+    {
+      map->entries[home] = map->entries[next];
+      map->entries[next].used = 0;
+    }
+    next = (next + 1) & (map->size - 1);
+  }
+
+unlock:
+  if(pthread_mutex_unlock(&map->mutex) != 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+  }
+error_mutex:
+  return status;
+}
+
+gse_status_t gse_get_label_map(label_map_t *map, uint8_t label[6],
+                               uint8_t label_type, uint32_t *value)
+{
+  gse_status_t status = GSE_STATUS_OK;
+
+  uint8_t key[GSE_LABEL_KEY_LENGTH];
+  size_t index;
+
+  assert(map != NULL);
+  assert(value != NULL);
+
+  status = gse_build_label_key(label, label_type, key);
+  if(status != GSE_STATUS_OK)
+  {
+    goto error_mutex;
+  }
+
+  if(pthread_mutex_lock(&map->mutex) != 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+    goto error_mutex;
+  }
+
+  if(map->elt_nbr == 0)
+  {
+    status = GSE_STATUS_UNKNOWN_LABEL;
+    goto unlock;
+  }
+  index = gse_find_label_entry(map, key);
+  if(!map->entries[index].used)
+  {
+    status = GSE_STATUS_UNKNOWN_LABEL;
+    goto unlock;
+  }
+  *value = map->entries[index].value;
+
+unlock:
+  if(pthread_mutex_unlock(&map->mutex) != 0)
+  {
+    status = GSE_STATUS_PTHREAD_MUTEX;
+  }
+error_mutex:
+  return status;
+}
+
+int gse_get_label_map_elt_nbr(label_map_t *map)
+{
+  int nbr;
+
+  assert(map != NULL);
+
+  if(pthread_mutex_lock(&map->mutex) != 0)
+  {
+    goto error;
+  }
+  nbr = map->elt_nbr;
+  if(pthread_mutex_unlock(&map->mutex) != 0)
+  {
+    goto error;
+  }
+
+  return nbr;
+error:
+  return -1;
+}
+
+size_t gse_get_label_map_footprint(label_map_t *map)
+{
+  size_t footprint = 0;
+
+  assert(map != NULL);
+
+  if(pthread_mutex_lock(&map->mutex) != 0)
+  {
+    goto error;
+  }
+  footprint = map->size * sizeof(label_map_entry_t);
+  pthread_mutex_unlock(&map->mutex);
+
+error:
+  return footprint;
+}
+
+
+/****************************************************************************
+ *
+ *   PRIVATE FUNCTIONS
+ *
+ ****************************************************************************/
+
+static gse_status_t gse_build_label_key(uint8_t label[6], uint8_t label_type,
+                                        uint8_t key[GSE_LABEL_KEY_LENGTH])
+{
+  int label_length;
+
+  /* Label re-use cannot identify a destination */
+  label_length = gse_get_label_length(label_type);
+  if(label_length < 0 || label_type == GSE_LT_REUSE)
+  {
+    return GSE_STATUS_INVALID_LT;
+  }
+  memset(key, 0, GSE_LABEL_KEY_LENGTH);
+  key[0] = label_type;
+  if(label_length > 0)
+  {
+    memcpy(key + 1, label, label_length);
+  }
+  return GSE_STATUS_OK;
+}
+
+static size_t gse_find_label_entry(label_map_t *map,
+                                   uint8_t key[GSE_LABEL_KEY_LENGTH])
+{
+  uint32_t hash = 2166136261U;
+  size_t index;
+  unsigned int i;
+
+  assert(map->size > 0);
+
+  /* FNV-1a hash of the key */
+  for(i = 0 ; i < GSE_LABEL_KEY_LENGTH ; i++)
+  {
+    hash = (hash ^ key[i]) * 16777619U;
+  }
+  index = hash & (map->size - 1);
+  while(map->entries[index].used &&
+        memcmp(map->entries[index].key, key, GSE_LABEL_KEY_LENGTH) != 0)
+  {
+    index = (index + 1) & (map->size - 1);
+  }
+  return index;
+}
+
+static gse_status_t gse_grow_label_map(label_map_t *map)
+{
+  gse_status_t status = GSE_STATUS_OK;
+
+  label_map_entry_t *old_entries;
+  size_t old_size;
+  size_t index;
+  size_t i;
+
+  old_entries = map->entries;
+  old_size = map->size;
+
+  map->size = (old_size > 0 ? old_size * 2 : GSE_LABEL_MAP_MIN_SIZE);
+  map->entries = calloc(map->size, sizeof(label_map_entry_t));
+  if(map->entries == NULL)
+  {
+    map->entries = old_entries;
+    map->size = old_size;
+    status = GSE_STATUS_MALLOC_FAILED;
+    goto error;
+  }
+  for(i = 0 ; i < old_size ; i++)
+  {
+    if(old_entries[i].used)
+    {
+      index = gse_find_label_entry(map, old_entries[i].key);
+      map->entries[index] = old_entries[i];
+    }
+  }
+  free(old_entries);
+
+error:
+  return status;
+}
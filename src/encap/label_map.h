@@ -0,0 +1,197 @@
+/*
+ *
+ * This piece of software is an implementation of the Generic Stream
+ * Encapsulation (GSE) standard defined by ETSI for Linux (or other
+ * Unix-compatible OS). The library may be used to add GSE
+ * encapsulation/de-encapsulation capabilities to an application.
+ *
+ *
+ * Copyright © 2016 TAS
+ *
+ *
+ * This file is part of the GSE library.
+ *
+ *
+ * The GSE library is free software : you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY, without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see http://www.gnu.org/licenses/.
+ *
+ */
+
+/****************************************************************************/
+/**
+ *   @file          label_map.h
+ *
+ *          Project:     GSE LIBRARY
+ *
+ *          Company:     THALES ALENIA SPACE
+ *
+ *          Module name: LABEL MAP
+ *
+ *   @brief         Table associating a value to GSE labels
+ *
+ *   @author        Julien BERNARD / Viveris Technologies
+ *
+ */
+/****************************************************************************/
+
+#ifndef GSE_LABEL_MAP_H
+#define GSE_LABEL_MAP_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#include "status.h"
+
+/****************************************************************************
+ *
+ *   STRUCTURES AND TYPES
+ *
+ ****************************************************************************/
+
+/** Length of the key of an entry: label type and label */
+#define GSE_LABEL_KEY_LENGTH 7
+
+/** Entry of the label table */
+typedef struct
+{
+  uint8_t key[GSE_LABEL_KEY_LENGTH]; /**< Label type followed by the label,
+                                          padded with zeros */
+  uint8_t used;                      /**< Whether the entry is used */
+  uint32_t value;                    /**< Value associated to the label */
+} label_map_entry_t;
+
+/** Table associating a value to GSE labels
+ *
+ *  The table uses open addressing with linear probing, it is allocated when
+ *  the first label is added and grows when it is half full.
+ */
+typedef struct
+{
+  label_map_entry_t *entries; /**< The entries, NULL while the table is empty */
+  size_t size;                /**< Number of entries (a power of 2) */
+  size_t elt_nbr;             /**< Number of used entries */
+  pthread_mutex_t mutex;      /**< Mutex on the table for multithreading
+                                   support */
+} label_map_t;
+
+/****************************************************************************
+ *
+ *   FUNCTION PROTOTYPES
+ *
+ ****************************************************************************/
+
+/* All these functions protect the access to the table with a mutex */
+
+/**
+ *  @brief   Initialize a label table
+ *
+ *  @param   map  The table to initialize
+ *
+ *  @return
+ *                - success/informative code among:
+ *                  - \ref GSE_STATUS_OK
+ *                - warning/error code among:
+ *                  - \ref GSE_STATUS_PTHREAD_MUTEX
+ */
+gse_status_t gse_init_label_map(label_map_t *map);
+
+/**
+ *  @brief   Release a label table
+ *
+ *  @param   map  The table to release
+ *
+ *  @return
+ *                - success/informative code among:
+ *                  - \ref GSE_STATUS_OK
+ *                - warning/error code among:
+ *                  - \ref GSE_STATUS_PTHREAD_MUTEX
+ */
+gse_status_t gse_release_label_map(label_map_t *map);
+
+/**
+ *  @brief   Associate a value to a label, replacing the previous value
+ *
+ *  @param   map         The table
+ *  @param   label       The label
+ *  @param   label_type  The label type
+ *  @param   value       The value
+ *
+ *  @return
+ *                       - success/informative code among:
+ *                         - \ref GSE_STATUS_OK
+ *                       - warning/error code among:
+ *                         - \ref GSE_STATUS_INVALID_LT
+ *                         - \ref GSE_STATUS_MALLOC_FAILED
+ *                         - \ref GSE_STATUS_PTHREAD_MUTEX
+ */
+gse_status_t gse_set_label_map(label_map_t *map, uint8_t label[6],
+                               uint8_t label_type, uint32_t value);
+
+/**
+ *  @brief   Remove the value associated to a label
+ *
+ *  @param   map         The table
+ *  @param   label       The label
+ *  @param   label_type  The label type
+ *
+ *  @return
+ *                       - success/informative code among:
+ *                         - \ref GSE_STATUS_OK
+ *                       - warning/error code among:
+ *                         - \ref GSE_STATUS_INVALID_LT
+ *                         - \ref GSE_STATUS_UNKNOWN_LABEL
+ *                         - \ref GSE_STATUS_PTHREAD_MUTEX
+ */
+gse_status_t gse_remove_label_map(label_map_t *map, uint8_t label[6],
+                                  uint8_t label_type);
+
+/**
+ *  @brief   Get the value associated to a label
+ *
+ *  @param   map         The table
+ *  @param   label       The label
+ *  @param   label_type  The label type
+ *  @param   value       OUT: The value on success
+ *
+ *  @return
+ *                       - success/informative code among:
+ *                         - \ref GSE_STATUS_OK
+ *                       - warning/error code among:
+ *                         - \ref GSE_STATUS_INVALID_LT
+ *                         - \ref GSE_STATUS_UNKNOWN_LABEL
+ *                         - \ref GSE_STATUS_PTHREAD_MUTEX
+ */
+gse_status_t gse_get_label_map(label_map_t *map, uint8_t label[6],
+                               uint8_t label_type, uint32_t *value);
+
+/**
+ *  @brief   Get the number of labels in the table
+ *
+ *  @param   map  The table
+ *
+ *  @return       The number of labels on success, -1 on failure
+ */
+int gse_get_label_map_elt_nbr(label_map_t *map);
+
+/**
+ *  @brief   Get the memory allocated for the entries of the table
+ *
+ *  @param   map  The table
+ *
+ *  @return       The size of the entries (in bytes), 0 until the first
+ *                label is added
+ */
+size_t gse_get_label_map_footprint(label_map_t *map);
+
+#endif
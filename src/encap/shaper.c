@@ -0,0 +1,188 @@
+/*
+ *
+ * This piece of software is an implementation of the Generic Stream
+ * Encapsulation (GSE) standard defined by ETSI for Linux (or other
+ * Unix-compatible OS). The library may be used to add GSE
+ * encapsulation/de-encapsulation capabilities to an application.
+ *
+ *
+ * Copyright © 2016 TAS
+ *
+ *
+ * This file is part of the GSE library.
+ *
+ *
+ * The GSE library is free software : you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY, without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see http://www.gnu.org/licenses/.
+ *
+ */
+
+/****************************************************************************/
+/**
+ *   @file          shaper.c
+ *
+ *          Project:     GSE LIBRARY
+ *
+ *          Company:     THALES ALENIA SPACE
+ *
+ *          Module name: SHAPER
+ *
+ *   @brief         Token bucket shaper with committed and peak rates
+ *
+ *   @author        Julien BERNARD / Viveris Technologies
+ *
+ */
+/****************************************************************************/
+
+#include "shaper.h"
+
+#include <string.h>
+#include <assert.h>
+
+
+/****************************************************************************
+ *
+ *   STRUCTURES AND TYPES
+ *
+ ****************************************************************************/
+
+/** Number of tokens per byte */
+#define GSE_SHAPER_TOKENS_PER_BYTE 1000000
+
+/** Maximum elapsed time taken into account at once (in microseconds),
+ *  it avoids overflows after a long period without refill */
+#define GSE_SHAPER_MAX_ELAPSED 1000000000ULL
+
+
+/****************************************************************************
+ *
+ *   PUBLIC FUNCTIONS
+ *
+ ****************************************************************************/
+
+gse_status_t gse_init_shaper(gse_shaper_t *shaper,
+                             const gse_shaper_conf_t *conf)
+{
+  assert(shaper != NULL);
+  assert(conf != NULL);
+
+  /* The peak rate bucket shall allow at least the committed rate */
+  if(conf->committed_burst == 0 ||
+     (conf->peak_rate > 0 &&
+      (conf->peak_rate < conf->committed_rate ||
+       conf->peak_burst < conf->committed_burst)))
+  {
+    return GSE_STATUS_INVALID_SHAPER;
+  }
+
+  memset(shaper, 0, sizeof(gse_shaper_t));
+  shaper->conf = *conf;
+  shaper->committed_tokens = (int64_t)conf->committed_burst *
+                             GSE_SHAPER_TOKENS_PER_BYTE;
+  shaper->peak_tokens = (int64_t)conf->peak_burst *
+                        GSE_SHAPER_TOKENS_PER_BYTE;
+  shaper->used = 1;
+
+  return GSE_STATUS_OK;
+}
+
+void gse_refill_shaper(gse_shaper_t *shaper, uint64_t elapsed)
+{
+  int64_t max_tokens;
+
+  assert(shaper != NULL);
+
+  if(elapsed > GSE_SHAPER_MAX_ELAPSED)
+  {
+    elapsed = GSE_SHAPER_MAX_ELAPSED;
+  }
+
+  /* A rate in bytes per second gives one token per byte per microsecond */
+  max_tokens = (int64_t)shaper->conf.committed_burst *
+               GSE_SHAPER_TOKENS_PER_BYTE;
+  shaper->committed_tokens += (int64_t)(shaper->conf.committed_rate * elapsed);
+  if(shaper->committed_tokens > max_tokens)
+  {
+    shaper->committed_tokens = max_tokens;
+  }
+  if(shaper->conf.peak_rate > 0)
+  {
+    max_tokens = (int64_t)shaper->conf.peak_burst *
+                 GSE_SHAPER_TOKENS_PER_BYTE;
+    shaper->peak_tokens += (int64_t)(shaper->conf.peak_rate * elapsed);
+    if(shaper->peak_tokens > max_tokens)
+    {
+      shaper->peak_tokens = max_tokens;
+    }
+  }
+}
+
+gse_shaper_color_t gse_get_shaper_color(const gse_shaper_t *shaper)
+{
+  assert(shaper != NULL);
+
+  /* Without peak rate, no data is sent above the committed rate */
+  if(shaper->conf.peak_rate > 0 && shaper->peak_tokens <= 0)
+  {
+    return GSE_SHAPER_RED;
+  }
+  if(shaper->committed_tokens > 0)
+  {
+    return GSE_SHAPER_GREEN;
+  }
+  if(shaper->conf.peak_rate > 0)
+  {
+    return GSE_SHAPER_YELLOW;
+  }
+  return GSE_SHAPER_RED;
+}
+
+void gse_charge_shaper(gse_shaper_t *shaper, size_t length,
+                       gse_shaper_color_t color)
+{
+  int64_t tokens = (int64_t)length * GSE_SHAPER_TOKENS_PER_BYTE;
+
+  assert(shaper != NULL);
+
+  /* As in RFC 2698, the yellow data are only charged to the peak bucket so
+   * that a burst above the committed rate does not delay the next green
+   * data */
+  if(shaper->conf.peak_rate > 0)
+  {
+    shaper->peak_tokens -= tokens;
+  }
+  if(color == GSE_SHAPER_GREEN)
+  {
+    shaper->committed_tokens -= tokens;
+    shaper->green_bytes += length;
+  }
+  else
+  {
+    shaper->yellow_bytes += length;
+  }
+}
+
+void gse_get_shaper_state(const gse_shaper_t *shaper,
+                          gse_shaper_state_t *state)
+{
+  assert(shaper != NULL);
+  assert(state != NULL);
+
+  state->conf = shaper->conf;
+  state->committed_tokens = shaper->committed_tokens /
+                            GSE_SHAPER_TOKENS_PER_BYTE;
+  state->peak_tokens = shaper->peak_tokens / GSE_SHAPER_TOKENS_PER_BYTE;
+  state->green_bytes = shaper->green_bytes;
+  state->yellow_bytes = shaper->yellow_bytes;
+  state->held_nbr = shaper->held_nbr;
+}
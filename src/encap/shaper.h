@@ -0,0 +1,147 @@
+/*
+ *
+ * This piece of software is an implementation of the Generic Stream
+ * Encapsulation (GSE) standard defined by ETSI for Linux (or other
+ * Unix-compatible OS). The library may be used to add GSE
+ * encapsulation/de-encapsulation capabilities to an application.
+ *
+ *
+ * Copyright © 2016 TAS
+ *
+ *
+ * This file is part of the GSE library.
+ *
+ *
+ * The GSE library is free software : you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY, without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see http://www.gnu.org/licenses/.
+ *
+ */
+
+/****************************************************************************/
+/**
+ *   @file          shaper.h
+ *
+ *          Project:     GSE LIBRARY
+ *
+ *          Company:     THALES ALENIA SPACE
+ *
+ *          Module name: SHAPER
+ *
+ *   @brief         Token bucket shaper with committed and peak rates
+ *
+ *   @author        Julien BERNARD / Viveris Technologies
+ *
+ */
+/****************************************************************************/
+
+#ifndef GSE_SHAPER_H
+#define GSE_SHAPER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "encap.h"
+
+/****************************************************************************
+ *
+ *   STRUCTURES AND TYPES
+ *
+ ****************************************************************************/
+
+/** Color of the data sent through a shaper, from the best to the worst */
+typedef enum
+{
+  GSE_SHAPER_GREEN,   /**< Within the committed rate */
+  GSE_SHAPER_YELLOW,  /**< Above the committed rate, within the peak rate */
+  GSE_SHAPER_RED,     /**< Above the peak rate, the data shall be held */
+} gse_shaper_color_t;
+
+/** Token bucket shaper
+ *
+ *  The tokens are expressed in millionths of bytes so rates in bytes per
+ *  second are added without rounding for each elapsed microsecond. The
+ *  buckets are charged with all the sent data, so they may become negative
+ *  and the debt is paid before new data are sent.
+ */
+typedef struct
+{
+  gse_shaper_conf_t conf;    /**< The shaper configuration */
+  int64_t committed_tokens;  /**< Tokens of the committed rate bucket */
+  int64_t peak_tokens;       /**< Tokens of the peak rate bucket */
+  uint64_t green_bytes;      /**< Number of bytes sent as green */
+  uint64_t yellow_bytes;     /**< Number of bytes sent as yellow */
+  uint64_t held_nbr;         /**< Number of frames that held a PDU, counted
+                                  once per PDU and per frame */
+  uint8_t used;              /**< Whether the shaper is configured */
+} gse_shaper_t;
+
+/****************************************************************************
+ *
+ *   FUNCTION PROTOTYPES
+ *
+ ****************************************************************************/
+
+/* These functions do not protect the shaper, the caller shall do it */
+
+/**
+ *  @brief   Configure a shaper, its buckets are full
+ *
+ *  @param   shaper  The shaper
+ *  @param   conf    The shaper configuration
+ *
+ *  @return
+ *                   - success/informative code among:
+ *                     - \ref GSE_STATUS_OK
+ *                   - warning/error code among:
+ *                     - \ref GSE_STATUS_INVALID_SHAPER
+ */
+gse_status_t gse_init_shaper(gse_shaper_t *shaper,
+                             const gse_shaper_conf_t *conf);
+
+/**
+ *  @brief   Add the tokens earned during an elapsed time to a shaper
+ *
+ *  @param   shaper   The shaper
+ *  @param   elapsed  The elapsed time (in microseconds)
+ */
+void gse_refill_shaper(gse_shaper_t *shaper, uint64_t elapsed);
+
+/**
+ *  @brief   Get the color of the next data sent through a shaper
+ *
+ *  @param   shaper  The shaper
+ *
+ *  @return          The color
+ */
+gse_shaper_color_t gse_get_shaper_color(const gse_shaper_t *shaper);
+
+/**
+ *  @brief   Remove the tokens of sent data from a shaper
+ *
+ *  @param   shaper  The shaper
+ *  @param   length  The length of the sent data (in bytes)
+ *  @param   color   The color the data were sent with
+ */
+void gse_charge_shaper(gse_shaper_t *shaper, size_t length,
+                       gse_shaper_color_t color);
+
+/**
+ *  @brief   Get the state of a shaper
+ *
+ *  @param   shaper  The shaper
+ *  @param   state   OUT: The shaper state
+ */
+void gse_get_shaper_state(const gse_shaper_t *shaper,
+                          gse_shaper_state_t *state);
+
+#endif
@@ -0,0 +1,532 @@
+/*
+ *
+ * This piece of software is an implementation of the Generic Stream
+ * Encapsulation (GSE) standard defined by ETSI for Linux (or other
+ * Unix-compatible OS). The library may be used to add GSE
+ * encapsulation/de-encapsulation capabilities to an application.
+ *
+ *
+ * Copyright © 2016 TAS
+ *
+ *
+ * This file is part of the GSE library.
+ *
+ *
+ * The GSE library is free software : you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY, without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see http://www.gnu.org/licenses/.
+ *
+ */
+
+/****************************************************************************/
+/**
+ *   @file          test_encap_acm.c
+ *
+ *          Project:     GSE LIBRARY
+ *
+ *          Company:     THALES ALENIA SPACE
+ *
+ *          Module name: ENCAP
+ *
+ *   @brief         Frame filling per modcod group with ACM
+ *
+ *   @author        Julien BERNARD / Viveris Technologies
+ *
+ */
+/****************************************************************************/
+
+/****************************************************************************
+ *
+ *   INCLUDES
+ *
+ *****************************************************************************/
+
+/* system includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+/* GSE includes */
+#include "encap.h"
+#include "deencap.h"
+
+/****************************************************************************
+ *
+ *   MACROS AND CONSTANTS
+ *
+ *****************************************************************************/
+
+/** The number of FIFOs */
+#define QOS_NBR 1
+/** The size of the FIFOs */
+#define FIFO_SIZE 16
+/** The number of FragID values */
+#define FRAG_ID_NBR 8
+/** The number of PDUs of a FIFO considered for each GSE packet */
+#define WINDOW 4
+/** The length of the frames */
+#define FRAME_LENGTH 1000
+/** The number of receivers, the first byte of their label */
+#define RECEIVER_NBR 3
+/** The length of the PDUs */
+#define PDU_LENGTH 1500
+/** The type of label carried by the GSE packets */
+#define LABEL_TYPE 0x0
+/** The protocol carried by the GSE packets */
+#define PROTOCOL 0x2345
+
+/* DEBUG macro */
+#define DEBUG(verbose, format, ...) \
+  do { \
+    if(verbose) \
+      printf(format, ##__VA_ARGS__); \
+  } while(0)
+
+/** The modcod of the receivers, the last one is not associated to a modcod */
+static const uint8_t receiver_modcod[RECEIVER_NBR - 1] = { 4, 17 };
+
+/****************************************************************************
+ *
+ *   PROTOTYPES OF PRIVATE FUNCTIONS
+ *
+ *****************************************************************************/
+
+static int test_pool_required(int verbose);
+static int test_groups(int verbose);
+static int push_pdu(int verbose, gse_encap_t *encap, uint8_t receiver);
+static int fill_frame(int verbose, gse_encap_t *encap, int modcod,
+                      gse_deencap_t *deencap, uint8_t receiver,
+                      unsigned int *received_nbr);
+static int deencap_frame(int verbose, gse_deencap_t *deencap,
+                         unsigned char *frame, size_t length,
+                         uint8_t receiver, unsigned int *received_nbr);
+
+/****************************************************************************
+ *
+ *   PUBLIC FUNCTIONS
+ *
+ *****************************************************************************/
+
+/**
+ * @brief Main function for the GSE ACM test program
+ *
+ * @param argc  the number of program arguments
+ * @param argv  the program arguments
+ * @return      the unix return code:
+ *               \li 0 in case of success,
+ *               \li 1 in case of failure
+ */
+int main(int argc, char *argv[])
+{
+  int res = 1;
+  int verbose = 0;
+
+  if(argc > 2 || argc < 1)
+  {
+    printf("USAGE : test_encap_acm [verbose]\n");
+  }
+  else
+  {
+    if(argc == 2)
+    {
+      if(!strcmp(argv[1], "verbose"))
+      {
+        verbose = 1;
+      }
+      else
+      {
+        printf("USAGE : test_encap_acm [verbose]\n");
+        goto quit;
+      }
+    }
+    res = test_pool_required(verbose);
+    if(res != 0)
+    {
+      goto quit;
+    }
+    res = test_groups(verbose);
+  }
+
+quit:
+  return res;
+}
+
+/****************************************************************************
+ *
+ *   PRIVATE FUNCTIONS
+ *
+ *****************************************************************************/
+
+/**
+ * @brief Check that the modcod groups cannot be used without FragID pool
+ *
+ * @param   verbose  Print debug if verbose is 1
+ * @return  0 on success, 1 on failure
+ */
+static int test_pool_required(int verbose)
+{
+  int is_failure = 1;
+  gse_encap_t *encap = NULL;
+  gse_status_t status;
+  uint8_t label[6] = { 0, 1, 2, 3, 4, 5 };
+
+  status = gse_encap_init(QOS_NBR, FIFO_SIZE, &encap);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when initializing encapsulation (%s)\n",
+          status, gse_get_status(status));
+    goto quit;
+  }
+
+  status = gse_encap_set_label_modcod(encap, label, LABEL_TYPE, 1);
+  if(status != GSE_STATUS_FRAG_ID_POOL_REQUIRED)
+  {
+    DEBUG(verbose, "Modcod group accepted without FragID pool\n");
+    goto release_encap;
+  }
+
+  status = gse_encap_set_frag_id_pool(encap, FRAG_ID_NBR, WINDOW);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when enabling FragID pool (%s)\n",
+          status, gse_get_status(status));
+    goto release_encap;
+  }
+  status = gse_encap_set_label_modcod(encap, label, LABEL_TYPE, 1);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when setting label modcod (%s)\n",
+          status, gse_get_status(status));
+    goto release_encap;
+  }
+  /* The FragID pool cannot be disabled while a label has a modcod */
+  status = gse_encap_set_frag_id_pool(encap, 0, 0);
+  if(status != GSE_STATUS_FRAG_ID_POOL_REQUIRED)
+  {
+    DEBUG(verbose, "FragID pool disabled with modcod groups\n");
+    goto release_encap;
+  }
+  status = gse_encap_remove_label_modcod(encap, label, LABEL_TYPE);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when removing label modcod (%s)\n",
+          status, gse_get_status(status));
+    goto release_encap;
+  }
+  status = gse_encap_remove_label_modcod(encap, label, LABEL_TYPE);
+  if(status != GSE_STATUS_UNKNOWN_LABEL)
+  {
+    DEBUG(verbose, "Removed label was found\n");
+    goto release_encap;
+  }
+  status = gse_encap_set_frag_id_pool(encap, 0, 0);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when disabling FragID pool (%s)\n",
+          status, gse_get_status(status));
+    goto release_encap;
+  }
+
+  is_failure = 0;
+
+release_encap:
+  gse_encap_release(encap);
+quit:
+  return is_failure;
+}
+
+/**
+ * @brief Fill frames of different modcods alternately and check that each
+ *        frame only carries the PDUs of its receiver
+ *
+ * @param   verbose  Print debug if verbose is 1
+ * @return  0 on success, 1 on failure
+ */
+static int test_groups(int verbose)
+{
+  int is_failure = 1;
+  gse_encap_t *encap = NULL;
+  gse_deencap_t *deencap = NULL;
+  gse_status_t status;
+  uint8_t label[6] = { 0, 1, 2, 3, 4, 5 };
+  unsigned int received_nbr[RECEIVER_NBR] = { 0 };
+  unsigned char frame[FRAME_LENGTH];
+  size_t data_length;
+  unsigned int i;
+
+  status = gse_encap_init(QOS_NBR, FIFO_SIZE, &encap);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when initializing encapsulation (%s)\n",
+          status, gse_get_status(status));
+    goto quit;
+  }
+  status = gse_deencap_init(FRAG_ID_NBR, &deencap);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when initializing deencapsulation (%s)\n",
+          status, gse_get_status(status));
+    goto release_encap;
+  }
+  status = gse_encap_set_frag_id_pool(encap, FRAG_ID_NBR, WINDOW);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when enabling FragID pool (%s)\n",
+          status, gse_get_status(status));
+    goto release_deencap;
+  }
+  for(i = 0 ; i < RECEIVER_NBR - 1 ; i++)
+  {
+    label[0] = i;
+    status = gse_encap_set_label_modcod(encap, label, LABEL_TYPE,
+                                        receiver_modcod[i]);
+    if(status != GSE_STATUS_OK)
+    {
+      DEBUG(verbose, "Error %#.4x when setting label modcod (%s)\n",
+            status, gse_get_status(status));
+      goto release_deencap;
+    }
+  }
+
+  /* Two PDUs for each receiver */
+  for(i = 0 ; i < 2 * RECEIVER_NBR ; i++)
+  {
+    if(push_pdu(verbose, encap, i % RECEIVER_NBR))
+    {
+      goto release_deencap;
+    }
+  }
+
+  /* A modcod without label has no PDU */
+  status = gse_encap_fill_frame_modcod(encap, 5, GSE_FILL_BEST_FIT, frame,
+                                       FRAME_LENGTH, &data_length, NULL);
+  if(status != GSE_STATUS_FIFO_EMPTY || data_length != 0)
+  {
+    DEBUG(verbose, "Frame filled for a modcod without label\n");
+    goto release_deencap;
+  }
+
+  /* The PDUs of the modcod groups are fragmented in interleaved frames, each
+   * one needs its own FragID */
+  for(i = 0 ; i < 4 ; i++)
+  {
+    if(fill_frame(verbose, encap, receiver_modcod[0], deencap, 0,
+                  &received_nbr[0]) ||
+       fill_frame(verbose, encap, receiver_modcod[1], deencap, 1,
+                  &received_nbr[1]) ||
+       fill_frame(verbose, encap, -1, deencap, 2, &received_nbr[2]))
+    {
+      goto release_deencap;
+    }
+  }
+  for(i = 0 ; i < RECEIVER_NBR ; i++)
+  {
+    if(received_nbr[i] != 2)
+    {
+      DEBUG(verbose, "%u PDUs received by receiver %u instead of 2\n",
+            received_nbr[i], i);
+      goto release_deencap;
+    }
+  }
+
+  /* Without modcod, the PDUs of the receiver go in the default FIFOs */
+  label[0] = 0;
+  status = gse_encap_remove_label_modcod(encap, label, LABEL_TYPE);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when removing label modcod (%s)\n",
+          status, gse_get_status(status));
+    goto release_deencap;
+  }
+  if(push_pdu(verbose, encap, 0))
+  {
+    goto release_deencap;
+  }
+  status = gse_encap_fill_frame_modcod(encap, receiver_modcod[0],
+                                       GSE_FILL_BEST_FIT, frame, FRAME_LENGTH,
+                                       &data_length, NULL);
+  if(status != GSE_STATUS_FIFO_EMPTY)
+  {
+    DEBUG(verbose, "PDU of a removed label sent in its modcod frame\n");
+    goto release_deencap;
+  }
+  for(i = 0 ; i < 2 ; i++)
+  {
+    if(fill_frame(verbose, encap, -1, deencap, 0, &received_nbr[0]))
+    {
+      goto release_deencap;
+    }
+  }
+  if(received_nbr[0] != 3)
+  {
+    DEBUG(verbose, "PDU of a removed label not received\n");
+    goto release_deencap;
+  }
+
+  is_failure = 0;
+
+release_deencap:
+  gse_deencap_release(deencap);
+release_encap:
+  gse_encap_release(encap);
+quit:
+  return is_failure;
+}
+
+/**
+ * @brief Create a PDU for a receiver and give it to the encapsulation
+ *
+ * @param   verbose   Print debug if verbose is 1
+ * @param   encap     The encapsulation structure
+ * @param   receiver  The receiver, used as first label byte and PDU pattern
+ * @return  0 on success, 1 on failure
+ */
+static int push_pdu(int verbose, gse_encap_t *encap, uint8_t receiver)
+{
+  gse_vfrag_t *pdu;
+  gse_status_t status;
+  uint8_t label[6] = { 0, 1, 2, 3, 4, 5 };
+
+  label[0] = receiver;
+  status = gse_create_vfrag(&pdu, PDU_LENGTH, GSE_MAX_HEADER_LENGTH,
+                            GSE_MAX_TRAILER_LENGTH);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when creating PDU (%s)\n",
+          status, gse_get_status(status));
+    return 1;
+  }
+  memset(pdu->start, receiver, PDU_LENGTH);
+  status = gse_encap_receive_pdu(pdu, encap, label, LABEL_TYPE, PROTOCOL, 0);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when receiving PDU (%s)\n",
+          status, gse_get_status(status));
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * @brief Fill a frame and deencapsulate it
+ *
+ * @param   verbose       Print debug if verbose is 1
+ * @param   encap         The encapsulation structure
+ * @param   modcod        The modcod of the frame, -1 for the default FIFOs
+ * @param   deencap       The deencapsulation structure
+ * @param   receiver      The only receiver expected in the frame
+ * @param   received_nbr  IN/OUT: The number of PDUs received by the receiver
+ * @return  0 on success, 1 on failure
+ */
+static int fill_frame(int verbose, gse_encap_t *encap, int modcod,
+                      gse_deencap_t *deencap, uint8_t receiver,
+                      unsigned int *received_nbr)
+{
+  gse_status_t status;
+  unsigned char frame[FRAME_LENGTH];
+  size_t data_length;
+
+  if(modcod < 0)
+  {
+    status = gse_encap_fill_frame(encap, GSE_FILL_BEST_FIT, frame,
+                                  FRAME_LENGTH, &data_length, NULL);
+  }
+  else
+  {
+    status = gse_encap_fill_frame_modcod(encap, modcod, GSE_FILL_BEST_FIT,
+                                         frame, FRAME_LENGTH, &data_length,
+                                         NULL);
+  }
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when filling frame for modcod %d (%s)\n",
+          status, modcod, gse_get_status(status));
+    return 1;
+  }
+  DEBUG(verbose, "Frame for modcod %d: %zu bytes of GSE packets\n", modcod,
+        data_length);
+  return deencap_frame(verbose, deencap, frame, data_length, receiver,
+                       received_nbr);
+}
+
+/**
+ * @brief Deencapsulate the GSE packets of a frame and check the PDUs
+ *
+ * @param   verbose       Print debug if verbose is 1
+ * @param   deencap       The deencapsulation structure
+ * @param   frame         The frame
+ * @param   length        The length of the GSE packets in the frame
+ * @param   receiver      The only receiver expected in the frame
+ * @param   received_nbr  IN/OUT: The number of PDUs received by the receiver
+ * @return  0 on success, 1 on failure
+ */
+static int deencap_frame(int verbose, gse_deencap_t *deencap,
+                         unsigned char *frame, size_t length,
+                         uint8_t receiver, unsigned int *received_nbr)
+{
+  gse_vfrag_t *packet;
+  gse_vfrag_t *pdu;
+  gse_status_t status;
+  uint8_t label[6];
+  uint8_t label_type;
+  uint16_t protocol;
+  uint16_t packet_length;
+  size_t offset = 0;
+  size_t gse_length;
+  unsigned int i;
+
+  while(offset < length)
+  {
+    gse_length = (((frame[offset] & 0x0F) << 8) | frame[offset + 1]) + 2;
+    status = gse_create_vfrag_with_data(&packet, gse_length, 0, 0,
+                                        frame + offset, gse_length);
+    if(status != GSE_STATUS_OK)
+    {
+      DEBUG(verbose, "Error %#.4x when creating packet (%s)\n",
+            status, gse_get_status(status));
+      return 1;
+    }
+    offset += gse_length;
+    status = gse_deencap_packet(packet, deencap, &label_type, label,
+                                &protocol, &pdu, &packet_length);
+    if(status == GSE_STATUS_PDU_RECEIVED)
+    {
+      if(label[0] != receiver || pdu->length != PDU_LENGTH ||
+         protocol != PROTOCOL)
+      {
+        DEBUG(verbose, "Unexpected PDU received by receiver %u\n", receiver);
+        gse_free_vfrag(&pdu);
+        return 1;
+      }
+      for(i = 0 ; i < pdu->length ; i++)
+      {
+        if(pdu->start[i] != receiver)
+        {
+          DEBUG(verbose, "PDU content is corrupted\n");
+          gse_free_vfrag(&pdu);
+          return 1;
+        }
+      }
+      DEBUG(verbose, "PDU received by receiver %u\n", receiver);
+      (*received_nbr)++;
+      gse_free_vfrag(&pdu);
+    }
+    else if(status != GSE_STATUS_OK)
+    {
+      DEBUG(verbose, "Error %#.4x when deencapsulating packet (%s)\n",
+            status, gse_get_status(status));
+      return 1;
+    }
+  }
+  return 0;
+}
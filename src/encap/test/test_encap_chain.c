@@ -0,0 +1,717 @@
+/*
+ *
+ * This piece of software is an implementation of the Generic Stream
+ * Encapsulation (GSE) standard defined by ETSI for Linux (or other
+ * Unix-compatible OS). The library may be used to add GSE
+ * encapsulation/de-encapsulation capabilities to an application.
+ *
+ *
+ * Copyright © 2016 TAS
+ *
+ *
+ * This file is part of the GSE library.
+ *
+ *
+ * The GSE library is free software : you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY, without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see http://www.gnu.org/licenses/.
+ *
+ */
+
+/****************************************************************************/
+/**
+ *   @file          test_encap_chain.c
+ *
+ *          Project:     GSE LIBRARY
+ *
+ *          Company:     THALES ALENIA SPACE
+ *
+ *          Module name: ENCAP
+ *
+ *   @brief         Encapsulation of PDUs spread over chains of virtual
+ *                  fragments
+ *
+ *   @author        Julien BERNARD / Viveris Technologies
+ *
+ */
+/****************************************************************************/
+
+/****************************************************************************
+ *
+ *   INCLUDES
+ *
+ *****************************************************************************/
+
+/* system includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+/* GSE includes */
+#include "encap.h"
+#include "deencap.h"
+
+/****************************************************************************
+ *
+ *   MACROS AND CONSTANTS
+ *
+ *****************************************************************************/
+
+/** The number of FIFOs */
+#define QOS_NBR 1
+/** The size of the FIFOs */
+#define FIFO_SIZE 8
+/** The length of the GSE packets */
+#define PACKET_LENGTH 400
+/** The number of segments of the PDUs */
+#define SEG_NBR 20
+/** The length of the segments */
+#define SEG_LENGTH 150
+/** The length of the PDUs */
+#define PDU_LENGTH (SEG_NBR * SEG_LENGTH)
+/** The type of label carried by the GSE packets */
+#define LABEL_TYPE 0x0
+/** The protocol carried by the GSE packets */
+#define PROTOCOL 0x2345
+/** The length of the frames */
+#define FRAME_LENGTH 1000
+
+/* DEBUG macro */
+#define DEBUG(verbose, format, ...) \
+  do { \
+    if(verbose) \
+      printf(format, ##__VA_ARGS__); \
+  } while(0)
+
+/****************************************************************************
+ *
+ *   PROTOTYPES OF PRIVATE FUNCTIONS
+ *
+ *****************************************************************************/
+
+static int test_iov(int verbose);
+static int test_copy(int verbose);
+static int test_single(int verbose);
+static int push_chain(int verbose, gse_encap_t *encap, unsigned int seg_nbr,
+                      size_t seg_length, unsigned char *data);
+static int check_packet(int verbose, gse_deencap_t *deencap,
+                        unsigned char *packet, size_t length,
+                        unsigned char *data, size_t data_length,
+                        int *received);
+
+/****************************************************************************
+ *
+ *   PUBLIC FUNCTIONS
+ *
+ *****************************************************************************/
+
+/**
+ * @brief Main function for the GSE chain encapsulation test program
+ *
+ * @param argc  the number of program arguments
+ * @param argv  the program arguments
+ * @return      the unix return code:
+ *               \li 0 in case of success,
+ *               \li 1 in case of failure
+ */
+int main(int argc, char *argv[])
+{
+  int res = 1;
+  int verbose = 0;
+
+  if(argc > 2 || argc < 1)
+  {
+    printf("USAGE : test_encap_chain [verbose]\n");
+  }
+  else
+  {
+    if(argc == 2)
+    {
+      if(!strcmp(argv[1], "verbose"))
+      {
+        verbose = 1;
+      }
+      else
+      {
+        printf("USAGE : test_encap_chain [verbose]\n");
+        goto quit;
+      }
+    }
+    res = test_iov(verbose);
+    if(res == 0)
+    {
+      res = test_copy(verbose);
+    }
+    if(res == 0)
+    {
+      res = test_single(verbose);
+    }
+  }
+
+quit:
+  return res;
+}
+
+/****************************************************************************
+ *
+ *   PRIVATE FUNCTIONS
+ *
+ *****************************************************************************/
+
+/**
+ * @brief Get the packets of chained PDUs as I/O vectors, check that they
+ *        refer to the segments until released and that the PDUs are
+ *        correctly deencapsulated
+ *
+ * @param   verbose  Print debug if verbose is 1
+ * @return  0 on success, 1 on failure
+ */
+static int test_iov(int verbose)
+{
+  int is_failure = 1;
+  gse_encap_t *encap = NULL;
+  gse_deencap_t *deencap = NULL;
+  gse_encap_iov_packet_t packets[PDU_LENGTH / 100 + 1];
+  gse_status_t status;
+  unsigned char data[PDU_LENGTH];
+  unsigned char buffer[GSE_MAX_PACKET_LENGTH];
+  unsigned int packet_nbr = 0;
+  unsigned int i;
+  unsigned int j;
+  size_t length;
+  int received = 0;
+
+  for(i = 0 ; i < PDU_LENGTH ; i++)
+  {
+    data[i] = i % 251;
+  }
+
+  status = gse_encap_init(QOS_NBR, FIFO_SIZE, &encap);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when initializing encapsulation (%s)\n",
+          status, gse_get_status(status));
+    goto quit;
+  }
+  status = gse_deencap_init(QOS_NBR, &deencap);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when initializing deencapsulation (%s)\n",
+          status, gse_get_status(status));
+    goto release_encap;
+  }
+
+  status = gse_encap_get_packet_iov(NULL, encap, 0, 0);
+  if(status != GSE_STATUS_NULL_PTR)
+  {
+    DEBUG(verbose, "A NULL packet should be refused\n");
+    goto release_deencap;
+  }
+
+  /* The packets of the first PDU are all kept until its end, the packets
+   * of the maximum length of the second one are limited in segments */
+  if(push_chain(verbose, encap, SEG_NBR, SEG_LENGTH, data) ||
+     push_chain(verbose, encap, SEG_NBR, SEG_LENGTH, data))
+  {
+    goto release_deencap;
+  }
+  while((status = gse_encap_get_packet_iov(&packets[packet_nbr], encap,
+                                           PACKET_LENGTH, 0)) == GSE_STATUS_OK)
+  {
+    if(packets[packet_nbr].length > PACKET_LENGTH ||
+       packets[packet_nbr].iov_nbr > GSE_ENCAP_IOV_MAX)
+    {
+      DEBUG(verbose, "Packet too long\n");
+      goto release_packets;
+    }
+    packet_nbr++;
+    /* The PDU is deencapsulated once all its packets are got */
+    if(((packets[packet_nbr - 1].header[0] >> 6) & 0x1) == 0x1)
+    {
+      received = 1;
+      break;
+    }
+  }
+  if(!received)
+  {
+    DEBUG(verbose, "Error %#.4x when getting packet (%s)\n",
+          status, gse_get_status(status));
+    goto release_packets;
+  }
+  received = 0;
+  for(i = 0 ; i < packet_nbr ; i++)
+  {
+    length = 0;
+    for(j = 0 ; j < packets[i].iov_nbr ; j++)
+    {
+      memcpy(buffer + length, packets[i].iov[j].iov_base,
+             packets[i].iov[j].iov_len);
+      length += packets[i].iov[j].iov_len;
+    }
+    if(length != packets[i].length)
+    {
+      DEBUG(verbose, "Packet length %zu instead of %zu\n", length,
+            packets[i].length);
+      goto release_packets;
+    }
+    if(check_packet(verbose, deencap, buffer, length, data, PDU_LENGTH,
+                    &received))
+    {
+      goto release_packets;
+    }
+  }
+  if(!received)
+  {
+    DEBUG(verbose, "First PDU not received\n");
+    goto release_packets;
+  }
+  DEBUG(verbose, "First PDU received in %u packets\n", packet_nbr);
+  for(i = 0 ; i < packet_nbr ; i++)
+  {
+    status = gse_encap_release_iov_packet(&packets[i]);
+    if(status != GSE_STATUS_OK)
+    {
+      DEBUG(verbose, "Error %#.4x when releasing packet (%s)\n",
+            status, gse_get_status(status));
+      goto release_deencap;
+    }
+  }
+  packet_nbr = 0;
+
+  received = 0;
+  while((status = gse_encap_get_packet_iov(&packets[0], encap, 0, 0)) ==
+        GSE_STATUS_OK)
+  {
+    /* The first packet refers to as many segments as possible */
+    if(packet_nbr == 0 && packets[0].iov_nbr != GSE_ENCAP_IOV_MAX)
+    {
+      DEBUG(verbose, "First packet in %u vectors\n", packets[0].iov_nbr);
+      gse_encap_release_iov_packet(&packets[0]);
+      goto release_deencap;
+    }
+    packet_nbr++;
+    length = 0;
+    for(j = 0 ; j < packets[0].iov_nbr ; j++)
+    {
+      memcpy(buffer + length, packets[0].iov[j].iov_base,
+             packets[0].iov[j].iov_len);
+      length += packets[0].iov[j].iov_len;
+    }
+    gse_encap_release_iov_packet(&packets[0]);
+    if(check_packet(verbose, deencap, buffer, length, data, PDU_LENGTH,
+                    &received))
+    {
+      goto release_deencap;
+    }
+  }
+  if(status != GSE_STATUS_FIFO_EMPTY || !received || packet_nbr != 2)
+  {
+    DEBUG(verbose, "Second PDU not received in 2 packets\n");
+    goto release_deencap;
+  }
+
+  is_failure = 0;
+  goto release_deencap;
+
+release_packets:
+  for(i = 0 ; i < packet_nbr ; i++)
+  {
+    gse_encap_release_iov_packet(&packets[i]);
+  }
+release_deencap:
+  gse_deencap_release(deencap);
+release_encap:
+  gse_encap_release(encap);
+quit:
+  return is_failure;
+}
+
+/**
+ * @brief Get the packets of chained PDUs in copy, zero copy and frame
+ *        modes and check that the PDUs are correctly deencapsulated
+ *
+ * @param   verbose  Print debug if verbose is 1
+ * @return  0 on success, 1 on failure
+ */
+static int test_copy(int verbose)
+{
+  int is_failure = 1;
+  gse_encap_t *encap = NULL;
+  gse_deencap_t *deencap = NULL;
+  gse_vfrag_t *packet = NULL;
+  gse_status_t status;
+  unsigned char data[PDU_LENGTH];
+  unsigned char frame[FRAME_LENGTH];
+  size_t data_length;
+  size_t offset;
+  size_t length;
+  unsigned int i;
+  int received;
+
+  for(i = 0 ; i < PDU_LENGTH ; i++)
+  {
+    data[i] = (i * 7) % 253;
+  }
+
+  status = gse_encap_init(QOS_NBR, FIFO_SIZE, &encap);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when initializing encapsulation (%s)\n",
+          status, gse_get_status(status));
+    goto quit;
+  }
+  status = gse_deencap_init(QOS_NBR, &deencap);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when initializing deencapsulation (%s)\n",
+          status, gse_get_status(status));
+    goto release_encap;
+  }
+
+  /* Copy mode */
+  if(push_chain(verbose, encap, SEG_NBR, SEG_LENGTH, data))
+  {
+    goto release_deencap;
+  }
+  received = 0;
+  while((status = gse_encap_get_packet_copy(&packet, encap, PACKET_LENGTH,
+                                            0)) == GSE_STATUS_OK)
+  {
+    if(check_packet(verbose, deencap, packet->start, packet->length, data,
+                    PDU_LENGTH, &received))
+    {
+      gse_free_vfrag(&packet);
+      goto release_deencap;
+    }
+    gse_free_vfrag(&packet);
+  }
+  if(status != GSE_STATUS_FIFO_EMPTY || !received)
+  {
+    DEBUG(verbose, "PDU not received in copy mode\n");
+    goto release_deencap;
+  }
+
+  /* Zero copy mode, the PDU is copied once after its first packet */
+  if(push_chain(verbose, encap, SEG_NBR, SEG_LENGTH, data))
+  {
+    goto release_deencap;
+  }
+  received = 0;
+  status = gse_encap_get_packet_copy(&packet, encap, PACKET_LENGTH, 0);
+  while(status == GSE_STATUS_OK)
+  {
+    if(check_packet(verbose, deencap, packet->start, packet->length, data,
+                    PDU_LENGTH, &received))
+    {
+      gse_free_vfrag(&packet);
+      goto release_deencap;
+    }
+    gse_free_vfrag(&packet);
+    status = gse_encap_get_packet(&packet, encap, PACKET_LENGTH, 0);
+  }
+  if(status != GSE_STATUS_FIFO_EMPTY || !received)
+  {
+    DEBUG(verbose, "PDU not received in zero copy mode\n");
+    goto release_deencap;
+  }
+
+  /* Frame mode */
+  if(push_chain(verbose, encap, SEG_NBR, SEG_LENGTH, data))
+  {
+    goto release_deencap;
+  }
+  received = 0;
+  while((status = gse_encap_fill_frame(encap, GSE_FILL_BEST_FIT, frame,
+                                       FRAME_LENGTH, &data_length,
+                                       NULL)) == GSE_STATUS_OK)
+  {
+    for(offset = 0 ; offset < data_length ; offset += length)
+    {
+      length = (((frame[offset] & 0x0F) << 8) | frame[offset + 1]) + 2;
+      if(check_packet(verbose, deencap, frame + offset, length, data,
+                      PDU_LENGTH, &received))
+      {
+        goto release_deencap;
+      }
+    }
+  }
+  if(status != GSE_STATUS_FIFO_EMPTY || !received)
+  {
+    DEBUG(verbose, "PDU not received in frame mode\n");
+    goto release_deencap;
+  }
+
+  is_failure = 0;
+
+release_deencap:
+  gse_deencap_release(deencap);
+release_encap:
+  gse_encap_release(encap);
+quit:
+  return is_failure;
+}
+
+/**
+ * @brief Check that a chain of one segment with room for the header and the
+ *        CRC is encapsulated in place, that empty chains are refused and
+ *        that the chains left in the FIFOs are freed
+ *
+ * @param   verbose  Print debug if verbose is 1
+ * @return  0 on success, 1 on failure
+ */
+static int test_single(int verbose)
+{
+  int is_failure = 1;
+  gse_encap_t *encap = NULL;
+  gse_deencap_t *deencap = NULL;
+  gse_vfrag_chain_t *chain;
+  gse_encap_iov_packet_t packet;
+  gse_status_t status;
+  unsigned char data[PDU_LENGTH];
+  uint8_t label[6] = { 0, 1, 2, 3, 4, 5 };
+  unsigned int i;
+  int received = 0;
+
+  for(i = 0 ; i < PDU_LENGTH ; i++)
+  {
+    data[i] = (i * 3) % 241;
+  }
+
+  status = gse_encap_init(QOS_NBR, FIFO_SIZE, &encap);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when initializing encapsulation (%s)\n",
+          status, gse_get_status(status));
+    goto quit;
+  }
+  status = gse_deencap_init(QOS_NBR, &deencap);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when initializing deencapsulation (%s)\n",
+          status, gse_get_status(status));
+    goto release_encap;
+  }
+
+  status = gse_create_vfrag_chain(&chain, 1);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when creating chain (%s)\n",
+          status, gse_get_status(status));
+    goto release_deencap;
+  }
+  status = gse_encap_receive_pdu_chain(chain, encap, label, LABEL_TYPE,
+                                       PROTOCOL, 0, 0);
+  if(status != GSE_STATUS_EMPTY_FRAG)
+  {
+    DEBUG(verbose, "An empty chain should be refused\n");
+    goto release_deencap;
+  }
+
+  if(push_chain(verbose, encap, 1, PACKET_LENGTH / 2, data))
+  {
+    goto release_deencap;
+  }
+  status = gse_encap_get_packet_iov(&packet, encap, 0, 0);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when getting packet (%s)\n",
+          status, gse_get_status(status));
+    goto release_deencap;
+  }
+  /* The packet is the buffer of the segment */
+  if(packet.iov_nbr != 1 || packet.vfrag == NULL || packet.chain != NULL)
+  {
+    DEBUG(verbose, "The single segment was not encapsulated in place\n");
+    gse_encap_release_iov_packet(&packet);
+    goto release_deencap;
+  }
+  if(check_packet(verbose, deencap, packet.iov[0].iov_base,
+                  packet.iov[0].iov_len, data, PACKET_LENGTH / 2, &received))
+  {
+    gse_encap_release_iov_packet(&packet);
+    goto release_deencap;
+  }
+  gse_encap_release_iov_packet(&packet);
+  if(!received)
+  {
+    DEBUG(verbose, "PDU not received\n");
+    goto release_deencap;
+  }
+
+  /* The chains are freed with the FIFOs, a chain partially sent is freed
+   * with its last packet */
+  if(push_chain(verbose, encap, SEG_NBR, SEG_LENGTH, data) ||
+     push_chain(verbose, encap, SEG_NBR, SEG_LENGTH, data))
+  {
+    goto release_deencap;
+  }
+  status = gse_encap_get_packet_iov(&packet, encap, PACKET_LENGTH, 0);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when getting packet (%s)\n",
+          status, gse_get_status(status));
+    goto release_deencap;
+  }
+  gse_encap_release(encap);
+  encap = NULL;
+  status = gse_encap_release_iov_packet(&packet);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when releasing packet (%s)\n",
+          status, gse_get_status(status));
+    goto release_deencap;
+  }
+
+  is_failure = 0;
+
+release_deencap:
+  gse_deencap_release(deencap);
+release_encap:
+  if(encap != NULL)
+  {
+    gse_encap_release(encap);
+  }
+quit:
+  return is_failure;
+}
+
+/**
+ * @brief Create a chained PDU and give it to the encapsulation
+ *
+ * The segments are allocated without room for the header and the CRC.
+ *
+ * @param   verbose     Print debug if verbose is 1
+ * @param   encap       The encapsulation structure
+ * @param   seg_nbr     The number of segments
+ * @param   seg_length  The length of the segments
+ * @param   data        The data of the PDU
+ * @return  0 on success, 1 on failure
+ */
+static int push_chain(int verbose, gse_encap_t *encap, unsigned int seg_nbr,
+                      size_t seg_length, unsigned char *data)
+{
+  gse_vfrag_chain_t *chain;
+  gse_vfrag_t *segment;
+  gse_status_t status;
+  uint8_t label[6] = { 0, 1, 2, 3, 4, 5 };
+  unsigned int i;
+
+  status = gse_create_vfrag_chain(&chain, seg_nbr);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when creating chain (%s)\n",
+          status, gse_get_status(status));
+    return 1;
+  }
+  for(i = 0 ; i < seg_nbr ; i++)
+  {
+    /* A single segment has room for the header and the CRC */
+    if(seg_nbr == 1)
+    {
+      status = gse_create_vfrag_with_data(&segment, seg_length,
+                                          GSE_MAX_HEADER_LENGTH,
+                                          GSE_MAX_TRAILER_LENGTH,
+                                          data, seg_length);
+    }
+    else
+    {
+      status = gse_create_vfrag_with_data(&segment, seg_length, 0, 0,
+                                          data + i * seg_length, seg_length);
+    }
+    if(status != GSE_STATUS_OK)
+    {
+      DEBUG(verbose, "Error %#.4x when creating segment (%s)\n",
+            status, gse_get_status(status));
+      goto free_chain;
+    }
+    status = gse_append_vfrag_chain(chain, segment);
+    if(status != GSE_STATUS_OK)
+    {
+      DEBUG(verbose, "Error %#.4x when appending segment (%s)\n",
+            status, gse_get_status(status));
+      gse_free_vfrag(&segment);
+      goto free_chain;
+    }
+  }
+  status = gse_encap_receive_pdu_chain(chain, encap, label, LABEL_TYPE,
+                                       PROTOCOL, 0, 0);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when receiving PDU (%s)\n",
+          status, gse_get_status(status));
+    return 1;
+  }
+  return 0;
+
+free_chain:
+  gse_free_vfrag_chain(&chain);
+  return 1;
+}
+
+/**
+ * @brief Deencapsulate a GSE packet and check the PDU if it is complete
+ *
+ * @param   verbose      Print debug if verbose is 1
+ * @param   deencap      The deencapsulation structure
+ * @param   packet       The GSE packet
+ * @param   length       The length of the GSE packet
+ * @param   data         The expected PDU
+ * @param   data_length  The expected PDU length
+ * @param   received     OUT: Set to 1 if the PDU is received
+ * @return  0 on success, 1 on failure
+ */
+static int check_packet(int verbose, gse_deencap_t *deencap,
+                        unsigned char *packet, size_t length,
+                        unsigned char *data, size_t data_length,
+                        int *received)
+{
+  gse_vfrag_t *vfrag;
+  gse_vfrag_t *pdu = NULL;
+  gse_status_t status;
+  uint8_t label[6];
+  uint8_t label_type;
+  uint16_t protocol;
+  uint16_t packet_length;
+
+  DEBUG(verbose, "Packet S=%u E=%u length=%zu\n", (packet[0] >> 7) & 0x1,
+        (packet[0] >> 6) & 0x1, length);
+  status = gse_create_vfrag_with_data(&vfrag, length, 0, 0, packet, length);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when creating packet (%s)\n",
+          status, gse_get_status(status));
+    return 1;
+  }
+  /* The packet is destroyed by the deencapsulation */
+  status = gse_deencap_packet(vfrag, deencap, &label_type, label, &protocol,
+                              &pdu, &packet_length);
+  if(status == GSE_STATUS_PDU_RECEIVED)
+  {
+    if(protocol != PROTOCOL || pdu->length != data_length ||
+       memcmp(pdu->start, data, data_length) != 0)
+    {
+      DEBUG(verbose, "Unexpected PDU received\n");
+      gse_free_vfrag(&pdu);
+      return 1;
+    }
+    *received = 1;
+    gse_free_vfrag(&pdu);
+  }
+  else if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when deencapsulating packet (%s)\n",
+          status, gse_get_status(status));
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,356 @@
+/*
+ *
+ * This piece of software is an implementation of the Generic Stream
+ * Encapsulation (GSE) standard defined by ETSI for Linux (or other
+ * Unix-compatible OS). The library may be used to add GSE
+ * encapsulation/de-encapsulation capabilities to an application.
+ *
+ *
+ * Copyright © 2016 TAS
+ *
+ *
+ * This file is part of the GSE library.
+ *
+ *
+ * The GSE library is free software : you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY, without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see http://www.gnu.org/licenses/.
+ *
+ */
+
+/****************************************************************************/
+/**
+ *   @file          test_encap_crc.c
+ *
+ *          Project:     GSE LIBRARY
+ *
+ *          Company:     THALES ALENIA SPACE
+ *
+ *          Module name: ENCAP
+ *
+ *   @brief         CRC32 of large PDUs computed by the CRC threads
+ *
+ *   @author        Julien BERNARD / Viveris Technologies
+ *
+ */
+/****************************************************************************/
+
+/****************************************************************************
+ *
+ *   INCLUDES
+ *
+ *****************************************************************************/
+
+/* system includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+/* GSE includes */
+#include "encap.h"
+#include "deencap.h"
+
+/****************************************************************************
+ *
+ *   MACROS AND CONSTANTS
+ *
+ *****************************************************************************/
+
+/** The number of FIFOs */
+#define QOS_NBR 1
+/** The size of the FIFOs */
+#define FIFO_SIZE 4
+/** The length of the GSE packets */
+#define PACKET_LENGTH 4000
+/** The type of label carried by the GSE packets */
+#define LABEL_TYPE 0x0
+/** The protocol carried by the GSE packets */
+#define PROTOCOL 0x2345
+
+/* DEBUG macro */
+#define DEBUG(verbose, format, ...) \
+  do { \
+    if(verbose) \
+      printf(format, ##__VA_ARGS__); \
+  } while(0)
+
+/** A CRC threads configuration and the PDUs sent with it */
+typedef struct
+{
+  unsigned int worker_nbr;  /**< The number of CRC threads */
+  size_t min_length;        /**< The minimum length of the PDUs whose CRC32
+                                 is computed by the threads */
+  size_t pdu_length;        /**< The length of the PDUs */
+} crc_conf_t;
+
+/** The configurations in turn, the threads are replaced then removed */
+static const crc_conf_t confs[] =
+{
+  { 4, 0, 16384 },
+  { 4, 0, 40000 },
+  { 4, 0, 16383 },
+  { 3, 1000, 1000 },
+  { 3, 1000, 65000 },
+  { 1, 0, 40000 },
+};
+
+/** The number of configurations */
+#define CONF_NBR (sizeof(confs) / sizeof(confs[0]))
+
+/****************************************************************************
+ *
+ *   PROTOTYPES OF PRIVATE FUNCTIONS
+ *
+ *****************************************************************************/
+
+static int test_crc_workers(int verbose);
+static int push_pdu(int verbose, gse_encap_t *encap, size_t length);
+static int check_packet(int verbose, gse_deencap_t *deencap,
+                        gse_vfrag_t *packet, size_t pdu_length,
+                        int *received);
+
+/****************************************************************************
+ *
+ *   PUBLIC FUNCTIONS
+ *
+ *****************************************************************************/
+
+/**
+ * @brief Main function for the GSE CRC threads test program
+ *
+ * @param argc  the number of program arguments
+ * @param argv  the program arguments
+ * @return      the unix return code:
+ *               \li 0 in case of success,
+ *               \li 1 in case of failure
+ */
+int main(int argc, char *argv[])
+{
+  int res = 1;
+  int verbose = 0;
+
+  if(argc > 2 || argc < 1)
+  {
+    printf("USAGE : test_encap_crc [verbose]\n");
+  }
+  else
+  {
+    if(argc == 2)
+    {
+      if(!strcmp(argv[1], "verbose"))
+      {
+        verbose = 1;
+      }
+      else
+      {
+        printf("USAGE : test_encap_crc [verbose]\n");
+        goto quit;
+      }
+    }
+    res = test_crc_workers(verbose);
+  }
+
+quit:
+  return res;
+}
+
+/****************************************************************************
+ *
+ *   PRIVATE FUNCTIONS
+ *
+ *****************************************************************************/
+
+/**
+ * @brief Encapsulate fragmented PDUs with several CRC threads configurations
+ *        and check that the deencapsulation accepts their CRC32
+ *
+ * The encapsulation is released with its CRC threads running.
+ *
+ * @param   verbose  Print debug if verbose is 1
+ * @return  0 on success, 1 on failure
+ */
+static int test_crc_workers(int verbose)
+{
+  int is_failure = 1;
+  gse_encap_t *encap = NULL;
+  gse_deencap_t *deencap = NULL;
+  gse_vfrag_t *packet = NULL;
+  gse_status_t status;
+  unsigned int i;
+  int received;
+
+  status = gse_encap_init(QOS_NBR, FIFO_SIZE, &encap);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when initializing encapsulation (%s)\n",
+          status, gse_get_status(status));
+    goto quit;
+  }
+  status = gse_deencap_init(QOS_NBR, &deencap);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when initializing deencapsulation (%s)\n",
+          status, gse_get_status(status));
+    goto release_encap;
+  }
+
+  for(i = 0 ; i < CONF_NBR ; i++)
+  {
+    status = gse_encap_set_crc_workers(encap, confs[i].worker_nbr,
+                                       confs[i].min_length);
+    if(status != GSE_STATUS_OK)
+    {
+      DEBUG(verbose, "Error %#.4x when setting %u CRC threads (%s)\n",
+            status, confs[i].worker_nbr, gse_get_status(status));
+      goto release_deencap;
+    }
+    DEBUG(verbose, "%u CRC threads from %zu bytes, PDU of %zu bytes\n",
+          confs[i].worker_nbr, confs[i].min_length, confs[i].pdu_length);
+    if(push_pdu(verbose, encap, confs[i].pdu_length))
+    {
+      goto release_deencap;
+    }
+    received = 0;
+    while((status = gse_encap_get_packet_copy(&packet, encap, PACKET_LENGTH,
+                                              0)) == GSE_STATUS_OK)
+    {
+      if(check_packet(verbose, deencap, packet, confs[i].pdu_length,
+                      &received))
+      {
+        goto release_deencap;
+      }
+    }
+    if(status != GSE_STATUS_FIFO_EMPTY || !received)
+    {
+      DEBUG(verbose, "PDU %u not received\n", i);
+      goto release_deencap;
+    }
+  }
+
+  /* The threads are stopped when the encapsulation is released */
+  status = gse_encap_set_crc_workers(encap, 2, 0);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when setting CRC threads (%s)\n",
+          status, gse_get_status(status));
+    goto release_deencap;
+  }
+  if(gse_encap_set_crc_workers(NULL, 2, 0) != GSE_STATUS_NULL_PTR)
+  {
+    DEBUG(verbose, "CRC threads set without encapsulation\n");
+    goto release_deencap;
+  }
+
+  is_failure = 0;
+
+release_deencap:
+  gse_deencap_release(deencap);
+release_encap:
+  gse_encap_release(encap);
+quit:
+  return is_failure;
+}
+
+/**
+ * @brief Create a PDU and give it to the encapsulation
+ *
+ * @param   verbose  Print debug if verbose is 1
+ * @param   encap    The encapsulation structure
+ * @param   length   The PDU length
+ * @return  0 on success, 1 on failure
+ */
+static int push_pdu(int verbose, gse_encap_t *encap, size_t length)
+{
+  gse_vfrag_t *pdu;
+  gse_status_t status;
+  uint8_t label[6] = { 0, 1, 2, 3, 4, 5 };
+  unsigned int i;
+
+  status = gse_create_vfrag(&pdu, length, GSE_MAX_HEADER_LENGTH,
+                            GSE_MAX_TRAILER_LENGTH);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when creating PDU (%s)\n",
+          status, gse_get_status(status));
+    return 1;
+  }
+  for(i = 0 ; i < length ; i++)
+  {
+    pdu->start[i] = i % 251;
+  }
+  status = gse_encap_receive_pdu(pdu, encap, label, LABEL_TYPE, PROTOCOL, 0);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when receiving PDU (%s)\n",
+          status, gse_get_status(status));
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * @brief Deencapsulate a GSE packet and check the PDU if it is complete
+ *
+ * @param   verbose     Print debug if verbose is 1
+ * @param   deencap     The deencapsulation structure
+ * @param   packet      The GSE packet, destroyed
+ * @param   pdu_length  The expected PDU length
+ * @param   received    OUT: Set to 1 if the PDU is received
+ * @return  0 on success, 1 on failure
+ */
+static int check_packet(int verbose, gse_deencap_t *deencap,
+                        gse_vfrag_t *packet, size_t pdu_length,
+                        int *received)
+{
+  gse_vfrag_t *pdu = NULL;
+  gse_status_t status;
+  uint8_t label[6];
+  uint8_t label_type;
+  uint16_t protocol;
+  uint16_t packet_length;
+  unsigned int i;
+
+  DEBUG(verbose, "Packet S=%u E=%u length=%zu\n",
+        (packet->start[0] >> 7) & 0x1, (packet->start[0] >> 6) & 0x1,
+        packet->length);
+  status = gse_deencap_packet(packet, deencap, &label_type, label, &protocol,
+                              &pdu, &packet_length);
+  if(status == GSE_STATUS_PDU_RECEIVED)
+  {
+    if(protocol != PROTOCOL || pdu->length != pdu_length)
+    {
+      DEBUG(verbose, "Unexpected PDU received (protocol %#.4x, length %zu)\n",
+            protocol, pdu->length);
+      gse_free_vfrag(&pdu);
+      return 1;
+    }
+    for(i = 0 ; i < pdu_length ; i++)
+    {
+      if(pdu->start[i] != i % 251)
+      {
+        DEBUG(verbose, "Unexpected data at offset %u\n", i);
+        gse_free_vfrag(&pdu);
+        return 1;
+      }
+    }
+    *received = 1;
+    gse_free_vfrag(&pdu);
+  }
+  else if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when deencapsulating packet (%s)\n",
+          status, gse_get_status(status));
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,569 @@
+/*
+ *
+ * This piece of software is an implementation of the Generic Stream
+ * Encapsulation (GSE) standard defined by ETSI for Linux (or other
+ * Unix-compatible OS). The library may be used to add GSE
+ * encapsulation/de-encapsulation capabilities to an application.
+ *
+ *
+ * Copyright © 2016 TAS
+ *
+ *
+ * This file is part of the GSE library.
+ *
+ *
+ * The GSE library is free software : you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY, without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see http://www.gnu.org/licenses/.
+ *
+ */
+
+/****************************************************************************/
+/**
+ *   @file          test_encap_fill.c
+ *
+ *          Project:     GSE LIBRARY
+ *
+ *          Company:     THALES ALENIA SPACE
+ *
+ *          Module name: ENCAP
+ *
+ *   @brief         Frame filling with the different policies
+ *
+ *   @author        Julien BERNARD / Viveris Technologies
+ *
+ */
+/****************************************************************************/
+
+/****************************************************************************
+ *
+ *   INCLUDES
+ *
+ *****************************************************************************/
+
+/* system includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+/* GSE includes */
+#include "encap.h"
+#include "deencap.h"
+
+/****************************************************************************
+ *
+ *   MACROS AND CONSTANTS
+ *
+ *****************************************************************************/
+
+/** The number of FIFOs */
+#define QOS_NBR 2
+/** The size of the FIFOs */
+#define FIFO_SIZE 16
+/** The length of the frames */
+#define FRAME_LENGTH 1200
+/** The number of PDUs */
+#define PDU_NBR 5
+/** The type of label carried by the GSE packets */
+#define LABEL_TYPE 0x0
+/** The protocol carried by the GSE packets */
+#define PROTOCOL 0x2345
+/** The length of the frames of the extension test */
+#define EXT_FRAME_LENGTH 100
+/** The length of the header extension */
+#define EXT_LENGTH 8
+/** The type of the header extension (optional extension of 8 bytes) */
+#define EXT_TYPE 0x04AB
+/** The length of the header of a complete PDU with a 6-bytes label */
+#define HEADER_LENGTH 10
+
+/* DEBUG macro */
+#define DEBUG(verbose, format, ...) \
+  do { \
+    if(verbose) \
+      printf(format, ##__VA_ARGS__); \
+  } while(0)
+
+/** The length of the PDUs */
+static const size_t pdu_length[PDU_NBR] = { 1000, 300, 40, 200, 60 };
+
+/** The expected number of packets and fragments in the first frame */
+static const struct
+{
+  gse_fill_policy_t policy;
+  unsigned int packet_nbr;
+  unsigned int fragment_nbr;
+  unsigned int frame_nbr;
+} expected[] =
+{
+  /* 1000 complete, then 300 fragmented */
+  { GSE_FILL_FIFO, 2, 1, 2 },
+  /* 1000, 40 and 60 complete, then 300 fragmented */
+  { GSE_FILL_FIRST_FIT, 4, 1, 2 },
+  /* 1000, 60 and 40 complete, then 300 fragmented */
+  { GSE_FILL_BEST_FIT, 4, 1, 2 },
+};
+
+/****************************************************************************
+ *
+ *   PROTOTYPES OF PRIVATE FUNCTIONS
+ *
+ *****************************************************************************/
+
+static int test_policy(int verbose, unsigned int test);
+static int test_priority(int verbose);
+static int test_extensions(int verbose);
+static int ext_cb(unsigned char *ext, size_t *length, uint16_t *extension_type,
+                  uint16_t protocol_type, void *opaque);
+static int push_pdu(int verbose, gse_encap_t *encap, size_t length,
+                    unsigned char pattern, uint8_t qos);
+static int deencap_frame(int verbose, gse_deencap_t *deencap,
+                         unsigned char *frame, size_t length,
+                         unsigned int *received_nbr);
+
+/****************************************************************************
+ *
+ *   PUBLIC FUNCTIONS
+ *
+ *****************************************************************************/
+
+/**
+ * @brief Main function for the GSE frame filling test program
+ *
+ * @param argc  the number of program arguments
+ * @param argv  the program arguments
+ * @return      the unix return code:
+ *               \li 0 in case of success,
+ *               \li 1 in case of failure
+ */
+int main(int argc, char *argv[])
+{
+  int res = 1;
+  int verbose = 0;
+  unsigned int i;
+
+  if(argc > 2 || argc < 1)
+  {
+    printf("USAGE : test_encap_fill [verbose]\n");
+  }
+  else
+  {
+    if(argc == 2)
+    {
+      if(!strcmp(argv[1], "verbose"))
+      {
+        verbose = 1;
+      }
+      else
+      {
+        printf("USAGE : test_encap_fill [verbose]\n");
+        goto quit;
+      }
+    }
+    for(i = 0 ; i < sizeof(expected) / sizeof(expected[0]) ; i++)
+    {
+      res = test_policy(verbose, i);
+      if(res != 0)
+      {
+        goto quit;
+      }
+    }
+    res = test_priority(verbose);
+    if(res != 0)
+    {
+      goto quit;
+    }
+    res = test_extensions(verbose);
+  }
+
+quit:
+  return res;
+}
+
+/****************************************************************************
+ *
+ *   PRIVATE FUNCTIONS
+ *
+ *****************************************************************************/
+
+/**
+ * @brief Fill frames with a policy, check the frame content and deencapsulate
+ *        the frames
+ *
+ * @param   verbose  Print debug if verbose is 1
+ * @param   test     The index of the expected results
+ * @return  0 on success, 1 on failure
+ */
+static int test_policy(int verbose, unsigned int test)
+{
+  int is_failure = 1;
+  gse_encap_t *encap = NULL;
+  gse_deencap_t *deencap = NULL;
+  gse_frame_stats_t stats;
+  gse_status_t status;
+  unsigned char frame[FRAME_LENGTH];
+  size_t data_length;
+  unsigned int received_nbr = 0;
+  unsigned int frame_nbr = 0;
+  unsigned int i;
+
+  DEBUG(verbose, "Policy %d\n", expected[test].policy);
+
+  status = gse_encap_init(QOS_NBR, FIFO_SIZE, &encap);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when initializing encapsulation (%s)\n",
+          status, gse_get_status(status));
+    goto quit;
+  }
+  status = gse_deencap_init(QOS_NBR, &deencap);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when initializing deencapsulation (%s)\n",
+          status, gse_get_status(status));
+    goto release_encap;
+  }
+
+  for(i = 0 ; i < PDU_NBR ; i++)
+  {
+    if(push_pdu(verbose, encap, pdu_length[i], i, 0))
+    {
+      goto release_deencap;
+    }
+  }
+
+  while((status = gse_encap_fill_frame(encap, expected[test].policy,
+                                       frame, FRAME_LENGTH, &data_length,
+                                       &stats)) == GSE_STATUS_OK)
+  {
+    frame_nbr++;
+    DEBUG(verbose, "Frame %u: %u packets, %u fragments, payload %zu, "
+          "header %zu, CRC %zu, padding %zu\n", frame_nbr, stats.packet_nbr,
+          stats.fragment_nbr, stats.payload_length, stats.header_length,
+          stats.crc_length, stats.padding_length);
+    if(stats.payload_length + stats.header_length + stats.crc_length +
+       stats.padding_length != FRAME_LENGTH ||
+       stats.padding_length != FRAME_LENGTH - data_length)
+    {
+      DEBUG(verbose, "Frame statistics are inconsistent\n");
+      goto release_deencap;
+    }
+    if(frame_nbr == 1 &&
+       (stats.packet_nbr != expected[test].packet_nbr ||
+        stats.fragment_nbr != expected[test].fragment_nbr))
+    {
+      DEBUG(verbose, "Unexpected content for the first frame\n");
+      goto release_deencap;
+    }
+    if(deencap_frame(verbose, deencap, frame, data_length, &received_nbr))
+    {
+      goto release_deencap;
+    }
+  }
+  if(status != GSE_STATUS_FIFO_EMPTY)
+  {
+    DEBUG(verbose, "Error %#.4x when filling frame (%s)\n",
+          status, gse_get_status(status));
+    goto release_deencap;
+  }
+  if(frame_nbr != expected[test].frame_nbr || received_nbr != PDU_NBR)
+  {
+    DEBUG(verbose, "%u frames and %u PDUs instead of %u and %u\n", frame_nbr,
+          received_nbr, expected[test].frame_nbr, PDU_NBR);
+    goto release_deencap;
+  }
+
+  is_failure = 0;
+
+release_deencap:
+  gse_deencap_release(deencap);
+release_encap:
+  gse_encap_release(encap);
+quit:
+  return is_failure;
+}
+
+/**
+ * @brief Check that the FIFO with the lowest QoS value is served first
+ *
+ * @param   verbose  Print debug if verbose is 1
+ * @return  0 on success, 1 on failure
+ */
+static int test_priority(int verbose)
+{
+  int is_failure = 1;
+  gse_encap_t *encap = NULL;
+  gse_frame_stats_t stats;
+  gse_status_t status;
+  unsigned char frame[FRAME_LENGTH];
+  size_t data_length;
+
+  status = gse_encap_init(QOS_NBR, FIFO_SIZE, &encap);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when initializing encapsulation (%s)\n",
+          status, gse_get_status(status));
+    goto quit;
+  }
+  /* The PDU of the second FIFO fits better but the first FIFO has the
+   * priority */
+  if(push_pdu(verbose, encap, 500, 0, 0) ||
+     push_pdu(verbose, encap, 1100, 1, 1))
+  {
+    goto release_encap;
+  }
+  status = gse_encap_fill_frame(encap, GSE_FILL_BEST_FIT, frame, FRAME_LENGTH,
+                                &data_length, &stats);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when filling frame (%s)\n",
+          status, gse_get_status(status));
+    goto release_encap;
+  }
+  /* The 500 bytes PDU is complete, the end of the frame contains the first
+   * fragment of the other one */
+  if(frame[12] != 0 || stats.packet_nbr != 2 || stats.fragment_nbr != 1 ||
+     stats.padding_length != 0)
+  {
+    DEBUG(verbose, "The QoS priority is not respected\n");
+    goto release_encap;
+  }
+
+  is_failure = 0;
+
+release_encap:
+  gse_encap_release(encap);
+quit:
+  return is_failure;
+}
+
+/**
+ * @brief Check that a PDU with header extensions which does not fit in the
+ *        end of a frame is sent in the next one
+ *
+ * @param   verbose  Print debug if verbose is 1
+ * @return  0 on success, 1 on failure
+ */
+static int test_extensions(int verbose)
+{
+  int is_failure = 1;
+  gse_encap_t *encap = NULL;
+  gse_status_t status;
+  unsigned char frame[EXT_FRAME_LENGTH];
+  size_t data_length;
+  unsigned int ext_nbr = 0;
+  uint16_t protocol;
+
+  status = gse_encap_init(QOS_NBR, FIFO_SIZE, &encap);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when initializing encapsulation (%s)\n",
+          status, gse_get_status(status));
+    goto quit;
+  }
+  status = gse_encap_set_extension_callback(encap, ext_cb, &ext_nbr);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when setting extension callback (%s)\n",
+          status, gse_get_status(status));
+    goto release_encap;
+  }
+  if(push_pdu(verbose, encap, 75, 0, 0) ||
+     push_pdu(verbose, encap, 50, 1, 0))
+  {
+    goto release_encap;
+  }
+
+  /* The first PDU is complete, the end of the frame is too short for a
+   * first fragment of the second one */
+  status = gse_encap_fill_frame(encap, GSE_FILL_FIFO, frame, EXT_FRAME_LENGTH,
+                                &data_length, NULL);
+  if(status != GSE_STATUS_OK ||
+     data_length != HEADER_LENGTH + EXT_LENGTH + 75)
+  {
+    DEBUG(verbose, "Status %#.4x and %zu bytes in the first frame (%s)\n",
+          status, data_length, gse_get_status(status));
+    goto release_encap;
+  }
+  /* The second PDU is sent with its extensions in the next frame */
+  status = gse_encap_fill_frame(encap, GSE_FILL_FIFO, frame, EXT_FRAME_LENGTH,
+                                &data_length, NULL);
+  if(status != GSE_STATUS_OK ||
+     data_length != HEADER_LENGTH + EXT_LENGTH + 50)
+  {
+    DEBUG(verbose, "Status %#.4x and %zu bytes in the second frame (%s)\n",
+          status, data_length, gse_get_status(status));
+    goto release_encap;
+  }
+  protocol = (frame[2] << 8) | frame[3];
+  if(protocol != EXT_TYPE ||
+     frame[HEADER_LENGTH + EXT_LENGTH - 2] != (PROTOCOL >> 8) ||
+     frame[HEADER_LENGTH + EXT_LENGTH - 1] != (PROTOCOL & 0xFF) ||
+     frame[HEADER_LENGTH + EXT_LENGTH] != 1)
+  {
+    DEBUG(verbose, "The second PDU or its extensions are corrupted\n");
+    goto release_encap;
+  }
+  status = gse_encap_fill_frame(encap, GSE_FILL_FIFO, frame, EXT_FRAME_LENGTH,
+                                &data_length, NULL);
+  if(status != GSE_STATUS_FIFO_EMPTY)
+  {
+    DEBUG(verbose, "Status %#.4x instead of empty FIFOs (%s)\n",
+          status, gse_get_status(status));
+    goto release_encap;
+  }
+  DEBUG(verbose, "Extensions built %u times\n", ext_nbr);
+
+  is_failure = 0;
+
+release_encap:
+  gse_encap_release(encap);
+quit:
+  return is_failure;
+}
+
+/**
+ * @brief Build an optional header extension carrying the PDU protocol
+ *
+ * @param   ext            The beginning of the header extensions
+ * @param   length         IN: The available space, OUT: The extensions length
+ * @param   extension_type OUT: The type of the first extension
+ * @param   protocol_type  The protocol of the PDU
+ * @param   opaque         The number of times the extensions were built
+ * @return  0 on success, -1 on failure
+ */
+static int ext_cb(unsigned char *ext, size_t *length, uint16_t *extension_type,
+                  uint16_t protocol_type, void *opaque)
+{
+  unsigned int *ext_nbr = (unsigned int *)opaque;
+
+  if(*length < EXT_LENGTH || protocol_type != PROTOCOL)
+  {
+    return -1;
+  }
+  memset(ext, 0xEE, EXT_LENGTH - 2);
+  ext[EXT_LENGTH - 2] = (protocol_type >> 8) & 0xFF;
+  ext[EXT_LENGTH - 1] = protocol_type & 0xFF;
+  *length = EXT_LENGTH;
+  *extension_type = EXT_TYPE;
+  (*ext_nbr)++;
+  return 0;
+}
+
+/**
+ * @brief Create a PDU filled with a pattern and give it to the encapsulation
+ *
+ * @param   verbose  Print debug if verbose is 1
+ * @param   encap    The encapsulation structure
+ * @param   length   The PDU length
+ * @param   pattern  The byte used to fill the PDU
+ * @param   qos      The QoS of the PDU
+ * @return  0 on success, 1 on failure
+ */
+static int push_pdu(int verbose, gse_encap_t *encap, size_t length,
+                    unsigned char pattern, uint8_t qos)
+{
+  gse_vfrag_t *pdu;
+  gse_status_t status;
+  uint8_t label[6] = { 0, 1, 2, 3, 4, 5 };
+
+  /* The head offset leaves room for the header extensions */
+  status = gse_create_vfrag(&pdu, length, GSE_MAX_HEADER_LENGTH + EXT_LENGTH,
+                            GSE_MAX_TRAILER_LENGTH);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when creating PDU (%s)\n",
+          status, gse_get_status(status));
+    return 1;
+  }
+  memset(pdu->start, pattern, length);
+  status = gse_encap_receive_pdu(pdu, encap, label, LABEL_TYPE, PROTOCOL, qos);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when receiving PDU (%s)\n",
+          status, gse_get_status(status));
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * @brief Deencapsulate the GSE packets of a frame and check the PDUs
+ *
+ * @param   verbose       Print debug if verbose is 1
+ * @param   deencap       The deencapsulation structure
+ * @param   frame         The frame
+ * @param   length        The length of the GSE packets in the frame
+ * @param   received_nbr  IN/OUT: The number of received PDUs
+ * @return  0 on success, 1 on failure
+ */
+static int deencap_frame(int verbose, gse_deencap_t *deencap,
+                         unsigned char *frame, size_t length,
+                         unsigned int *received_nbr)
+{
+  gse_vfrag_t *packet;
+  gse_vfrag_t *pdu;
+  gse_status_t status;
+  uint8_t label[6];
+  uint8_t label_type;
+  uint16_t protocol;
+  uint16_t packet_length;
+  size_t offset = 0;
+  size_t gse_length;
+  unsigned int i;
+
+  while(offset < length)
+  {
+    gse_length = (((frame[offset] & 0x0F) << 8) | frame[offset + 1]) + 2;
+    status = gse_create_vfrag_with_data(&packet, gse_length, 0, 0,
+                                        frame + offset, gse_length);
+    if(status != GSE_STATUS_OK)
+    {
+      DEBUG(verbose, "Error %#.4x when creating packet (%s)\n",
+            status, gse_get_status(status));
+      return 1;
+    }
+    offset += gse_length;
+    status = gse_deencap_packet(packet, deencap, &label_type, label,
+                                &protocol, &pdu, &packet_length);
+    if(status == GSE_STATUS_PDU_RECEIVED)
+    {
+      if(pdu->length < 1 || pdu->start[0] >= PDU_NBR ||
+         pdu->length != pdu_length[pdu->start[0]] || protocol != PROTOCOL)
+      {
+        DEBUG(verbose, "Unexpected PDU received\n");
+        gse_free_vfrag(&pdu);
+        return 1;
+      }
+      for(i = 0 ; i < pdu->length ; i++)
+      {
+        if(pdu->start[i] != pdu->start[0])
+        {
+          DEBUG(verbose, "PDU %u content is corrupted\n", pdu->start[0]);
+          gse_free_vfrag(&pdu);
+          return 1;
+        }
+      }
+      DEBUG(verbose, "PDU %u received\n", pdu->start[0]);
+      (*received_nbr)++;
+      gse_free_vfrag(&pdu);
+    }
+    else if(status != GSE_STATUS_OK)
+    {
+      DEBUG(verbose, "Error %#.4x when deencapsulating packet (%s)\n",
+            status, gse_get_status(status));
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,408 @@
+/*
+ *
+ * This piece of software is an implementation of the Generic Stream
+ * Encapsulation (GSE) standard defined by ETSI for Linux (or other
+ * Unix-compatible OS). The library may be used to add GSE
+ * encapsulation/de-encapsulation capabilities to an application.
+ *
+ *
+ * Copyright © 2016 TAS
+ *
+ *
+ * This file is part of the GSE library.
+ *
+ *
+ * The GSE library is free software : you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY, without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see http://www.gnu.org/licenses/.
+ *
+ */
+
+/****************************************************************************/
+/**
+ *   @file          test_encap_flow.c
+ *
+ *          Project:     GSE LIBRARY
+ *
+ *          Company:     THALES ALENIA SPACE
+ *
+ *          Module name: ENCAP
+ *
+ *   @brief         Fair queuing of the flows sharing a QoS
+ *
+ *   @author        Julien BERNARD / Viveris Technologies
+ *
+ */
+/****************************************************************************/
+
+/****************************************************************************
+ *
+ *   INCLUDES
+ *
+ *****************************************************************************/
+
+/* system includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+/* GSE includes */
+#include "encap.h"
+#include "deencap.h"
+
+/****************************************************************************
+ *
+ *   MACROS AND CONSTANTS
+ *
+ *****************************************************************************/
+
+/** The number of FIFOs */
+#define QOS_NBR 1
+/** The size of the FIFOs */
+#define FIFO_SIZE 16
+/** The number of flows per FIFO */
+#define FLOW_NBR 64
+/** The number of FragID values */
+#define FRAG_ID_NBR 4
+/** The length of the GSE packets */
+#define PACKET_LENGTH 400
+/** The length of the PDUs */
+#define PDU_LENGTH 1000
+/** The number of bytes sent by a flow in its turn: one PDU */
+#define QUANTUM PDU_LENGTH
+/** The number of PDUs of the heavy flow, received first */
+#define HEAVY_NBR 8
+/** The number of PDUs of the light flow */
+#define LIGHT_NBR 2
+/** The type of label carried by the GSE packets */
+#define LABEL_TYPE 0x0
+/** The protocol carried by the GSE packets */
+#define PROTOCOL 0x2345
+
+/* DEBUG macro */
+#define DEBUG(verbose, format, ...) \
+  do { \
+    if(verbose) \
+      printf(format, ##__VA_ARGS__); \
+  } while(0)
+
+/** The test cases and the expected positions of the light flow PDUs in the
+ *  order of reception */
+static const struct
+{
+  uint16_t flow_nbr;
+  unsigned int frag_id_nbr;
+  int use_flow_key;
+  unsigned int light_pos[LIGHT_NBR];
+} expected[] =
+{
+  /* Strict FIFO order */
+  { 0, 0, 0, { 8, 9 } },
+  /* The flows alternate */
+  { FLOW_NBR, 0, 0, { 1, 3 } },
+  { FLOW_NBR, FRAG_ID_NBR, 0, { 1, 3 } },
+  /* The flows share the label and are separated by the flow key */
+  { FLOW_NBR, 0, 1, { 1, 3 } },
+};
+
+/****************************************************************************
+ *
+ *   PROTOTYPES OF PRIVATE FUNCTIONS
+ *
+ *****************************************************************************/
+
+static int test_flows(int verbose, unsigned int test);
+static int test_not_empty(int verbose);
+static int push_pdu(int verbose, gse_encap_t *encap, unsigned char pattern,
+                    uint8_t label_byte, uint32_t flow_key);
+
+/****************************************************************************
+ *
+ *   PUBLIC FUNCTIONS
+ *
+ *****************************************************************************/
+
+/**
+ * @brief Main function for the GSE fair queuing test program
+ *
+ * @param argc  the number of program arguments
+ * @param argv  the program arguments
+ * @return      the unix return code:
+ *               \li 0 in case of success,
+ *               \li 1 in case of failure
+ */
+int main(int argc, char *argv[])
+{
+  int res = 1;
+  int verbose = 0;
+  unsigned int i;
+
+  if(argc > 2 || argc < 1)
+  {
+    printf("USAGE : test_encap_flow [verbose]\n");
+  }
+  else
+  {
+    if(argc == 2)
+    {
+      if(!strcmp(argv[1], "verbose"))
+      {
+        verbose = 1;
+      }
+      else
+      {
+        printf("USAGE : test_encap_flow [verbose]\n");
+        goto quit;
+      }
+    }
+    for(i = 0 ; i < sizeof(expected) / sizeof(expected[0]) ; i++)
+    {
+      res = test_flows(verbose, i);
+      if(res != 0)
+      {
+        goto quit;
+      }
+    }
+    res = test_not_empty(verbose);
+  }
+
+quit:
+  return res;
+}
+
+/****************************************************************************
+ *
+ *   PRIVATE FUNCTIONS
+ *
+ *****************************************************************************/
+
+/**
+ * @brief Encapsulate a heavy flow followed by a light flow and check the
+ *        order of reception of the PDUs
+ *
+ * @param   verbose  Print debug if verbose is 1
+ * @param   test     The index of the test case
+ * @return  0 on success, 1 on failure
+ */
+static int test_flows(int verbose, unsigned int test)
+{
+  int is_failure = 1;
+  gse_encap_t *encap = NULL;
+  gse_deencap_t *deencap = NULL;
+  gse_vfrag_t *packet = NULL;
+  gse_vfrag_t *pdu;
+  gse_status_t status;
+  uint8_t label[6];
+  uint8_t label_type;
+  uint16_t protocol;
+  uint16_t packet_length;
+  unsigned int received_nbr = 0;
+  unsigned int light_nbr = 0;
+  unsigned int i;
+
+  DEBUG(verbose, "Test %u: %u flows, %u FragID values, flow key %s\n", test,
+        expected[test].flow_nbr, expected[test].frag_id_nbr,
+        expected[test].use_flow_key ? "used" : "unused");
+
+  status = gse_encap_init(QOS_NBR, FIFO_SIZE, &encap);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when initializing encapsulation (%s)\n",
+          status, gse_get_status(status));
+    goto quit;
+  }
+  status = gse_deencap_init(FRAG_ID_NBR, &deencap);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when initializing deencapsulation (%s)\n",
+          status, gse_get_status(status));
+    goto release_encap;
+  }
+  status = gse_encap_set_frag_id_pool(encap, expected[test].frag_id_nbr, 1);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when setting FragID pool (%s)\n",
+          status, gse_get_status(status));
+    goto release_deencap;
+  }
+  status = gse_encap_set_flow_queuing(encap, expected[test].flow_nbr,
+                                      QUANTUM);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when enabling flow queuing (%s)\n",
+          status, gse_get_status(status));
+    goto release_deencap;
+  }
+
+  /* The light flow is received behind the whole heavy flow */
+  for(i = 0 ; i < HEAVY_NBR + LIGHT_NBR ; i++)
+  {
+    if(expected[test].use_flow_key)
+    {
+      status = push_pdu(verbose, encap, i, 0, (i < HEAVY_NBR ? 1 : 2));
+    }
+    else
+    {
+      status = push_pdu(verbose, encap, i, (i < HEAVY_NBR ? 0 : 1), 0);
+    }
+    if(status != 0)
+    {
+      goto release_deencap;
+    }
+  }
+
+  while((status = gse_encap_get_packet_copy(&packet, encap, PACKET_LENGTH, 0))
+        == GSE_STATUS_OK)
+  {
+    status = gse_deencap_packet(packet, deencap, &label_type, label,
+                                &protocol, &pdu, &packet_length);
+    packet = NULL;
+    if(status == GSE_STATUS_PDU_RECEIVED)
+    {
+      if(pdu->length != PDU_LENGTH || protocol != PROTOCOL ||
+         pdu->start[0] >= HEAVY_NBR + LIGHT_NBR)
+      {
+        DEBUG(verbose, "Unexpected PDU received\n");
+        gse_free_vfrag(&pdu);
+        goto release_deencap;
+      }
+      for(i = 0 ; i < pdu->length ; i++)
+      {
+        if(pdu->start[i] != pdu->start[0])
+        {
+          DEBUG(verbose, "PDU %u content is corrupted\n", pdu->start[0]);
+          gse_free_vfrag(&pdu);
+          goto release_deencap;
+        }
+      }
+      DEBUG(verbose, "PDU %u received\n", pdu->start[0]);
+      if(pdu->start[0] >= HEAVY_NBR)
+      {
+        if(received_nbr != expected[test].light_pos[light_nbr])
+        {
+          DEBUG(verbose, "PDU of the light flow received in position %u "
+                "instead of %u\n", received_nbr,
+                expected[test].light_pos[light_nbr]);
+          gse_free_vfrag(&pdu);
+          goto release_deencap;
+        }
+        light_nbr++;
+      }
+      received_nbr++;
+      gse_free_vfrag(&pdu);
+    }
+    else if(status != GSE_STATUS_OK)
+    {
+      DEBUG(verbose, "Error %#.4x when deencapsulating packet (%s)\n",
+            status, gse_get_status(status));
+      goto release_deencap;
+    }
+  }
+  if(status != GSE_STATUS_FIFO_EMPTY)
+  {
+    DEBUG(verbose, "Error %#.4x when getting packet (%s)\n",
+          status, gse_get_status(status));
+    goto release_deencap;
+  }
+  if(received_nbr != HEAVY_NBR + LIGHT_NBR)
+  {
+    DEBUG(verbose, "%u PDUs received instead of %u\n", received_nbr,
+          HEAVY_NBR + LIGHT_NBR);
+    goto release_deencap;
+  }
+
+  is_failure = 0;
+
+release_deencap:
+  gse_deencap_release(deencap);
+release_encap:
+  gse_encap_release(encap);
+quit:
+  return is_failure;
+}
+
+/**
+ * @brief Check that flow queuing cannot be enabled with PDUs in the FIFOs
+ *
+ * @param   verbose  Print debug if verbose is 1
+ * @return  0 on success, 1 on failure
+ */
+static int test_not_empty(int verbose)
+{
+  int is_failure = 1;
+  gse_encap_t *encap = NULL;
+  gse_status_t status;
+
+  status = gse_encap_init(QOS_NBR, FIFO_SIZE, &encap);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when initializing encapsulation (%s)\n",
+          status, gse_get_status(status));
+    goto quit;
+  }
+  if(push_pdu(verbose, encap, 0, 0, 0))
+  {
+    goto release_encap;
+  }
+  status = gse_encap_set_flow_queuing(encap, FLOW_NBR, 0);
+  if(status != GSE_STATUS_FIFO_NOT_EMPTY)
+  {
+    DEBUG(verbose, "Flow queuing enabled with PDUs in the FIFOs\n");
+    goto release_encap;
+  }
+
+  is_failure = 0;
+
+release_encap:
+  gse_encap_release(encap);
+quit:
+  return is_failure;
+}
+
+/**
+ * @brief Create a PDU filled with a pattern and give it to the encapsulation
+ *
+ * @param   verbose     Print debug if verbose is 1
+ * @param   encap       The encapsulation structure
+ * @param   pattern     The byte used to fill the PDU
+ * @param   label_byte  The first byte of the label
+ * @param   flow_key    The flow key of the PDU
+ * @return  0 on success, 1 on failure
+ */
+static int push_pdu(int verbose, gse_encap_t *encap, unsigned char pattern,
+                    uint8_t label_byte, uint32_t flow_key)
+{
+  gse_vfrag_t *pdu;
+  gse_status_t status;
+  uint8_t label[6] = { 0, 1, 2, 3, 4, 5 };
+
+  label[0] = label_byte;
+  status = gse_create_vfrag(&pdu, PDU_LENGTH, GSE_MAX_HEADER_LENGTH,
+                            GSE_MAX_TRAILER_LENGTH);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when creating PDU (%s)\n",
+          status, gse_get_status(status));
+    return 1;
+  }
+  memset(pdu->start, pattern, PDU_LENGTH);
+  status = gse_encap_receive_pdu_flow(pdu, encap, label, LABEL_TYPE, PROTOCOL,
+                                      0, flow_key);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when receiving PDU (%s)\n",
+          status, gse_get_status(status));
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,475 @@
+/*
+ *
+ * This piece of software is an implementation of the Generic Stream
+ * Encapsulation (GSE) standard defined by ETSI for Linux (or other
+ * Unix-compatible OS). The library may be used to add GSE
+ * encapsulation/de-encapsulation capabilities to an application.
+ *
+ *
+ * Copyright © 2016 TAS
+ *
+ *
+ * This file is part of the GSE library.
+ *
+ *
+ * The GSE library is free software : you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY, without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see http://www.gnu.org/licenses/.
+ *
+ */
+
+/****************************************************************************/
+/**
+ *   @file          test_encap_frag_id.c
+ *
+ *          Project:     GSE LIBRARY
+ *
+ *          Company:     THALES ALENIA SPACE
+ *
+ *          Module name: ENCAP
+ *
+ *   @brief         Interleaved fragmentation of PDUs sharing a QoS
+ *
+ *   @author        Julien BERNARD / Viveris Technologies
+ *
+ */
+/****************************************************************************/
+
+/****************************************************************************
+ *
+ *   INCLUDES
+ *
+ *****************************************************************************/
+
+/* system includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+/* GSE includes */
+#include "encap.h"
+#include "deencap.h"
+
+/****************************************************************************
+ *
+ *   MACROS AND CONSTANTS
+ *
+ *****************************************************************************/
+
+/** The number of FIFOs */
+#define QOS_NBR 2
+/** The size of the FIFOs */
+#define FIFO_SIZE 16
+/** The number of FragID values in the pool */
+#define FRAG_ID_NBR 4
+/** The number of PDUs considered for each GSE packet */
+#define WINDOW 3
+/** The length of the GSE packets */
+#define PACKET_LENGTH 200
+/** The length of the short GSE packets, as at the end of a BBFrame */
+#define SHORT_PACKET_LENGTH 40
+/** The number of PDUs */
+#define PDU_NBR 6
+/** The type of label carried by the GSE packets */
+#define LABEL_TYPE 0x0
+/** The protocol carried by the GSE packets */
+#define PROTOCOL 0x2345
+
+/* DEBUG macro */
+#define DEBUG(verbose, format, ...) \
+  do { \
+    if(verbose) \
+      printf(format, ##__VA_ARGS__); \
+  } while(0)
+
+/** The length of the PDUs: large PDUs are followed by small ones */
+static const size_t pdu_length[PDU_NBR] = { 1500, 40, 1200, 300, 50, 900 };
+
+/****************************************************************************
+ *
+ *   PROTOTYPES OF PRIVATE FUNCTIONS
+ *
+ *****************************************************************************/
+
+static int test_interleaving(int verbose);
+static int test_exhausted(int verbose);
+static int push_pdu(int verbose, gse_encap_t *encap, size_t length,
+                    unsigned char pattern, uint8_t qos);
+
+/****************************************************************************
+ *
+ *   PUBLIC FUNCTIONS
+ *
+ *****************************************************************************/
+
+/**
+ * @brief Main function for the GSE FragID pool test program
+ *
+ * @param argc  the number of program arguments
+ * @param argv  the program arguments
+ * @return      the unix return code:
+ *               \li 0 in case of success,
+ *               \li 1 in case of failure
+ */
+int main(int argc, char *argv[])
+{
+  int res = 1;
+  int verbose = 0;
+
+  if(argc > 2 || argc < 1)
+  {
+    printf("USAGE : test_encap_frag_id [verbose]\n");
+  }
+  else
+  {
+    if(argc == 2)
+    {
+      if(!strcmp(argv[1], "verbose"))
+      {
+        verbose = 1;
+      }
+      else
+      {
+        printf("USAGE : test_encap_frag_id [verbose]\n");
+        goto quit;
+      }
+    }
+    res = test_interleaving(verbose);
+    if(res == 0)
+    {
+      res = test_exhausted(verbose);
+    }
+  }
+
+quit:
+  return res;
+}
+
+/****************************************************************************
+ *
+ *   PRIVATE FUNCTIONS
+ *
+ *****************************************************************************/
+
+/**
+ * @brief Encapsulate large and small PDUs of the same QoS, check that small
+ *        PDUs overtake the large ones and that all PDUs are deencapsulated
+ *
+ * @param   verbose  Print debug if verbose is 1
+ * @return  0 on success, 1 on failure
+ */
+static int test_interleaving(int verbose)
+{
+  int is_failure = 1;
+  gse_encap_t *encap = NULL;
+  gse_deencap_t *deencap = NULL;
+  gse_vfrag_t *packet = NULL;
+  gse_vfrag_t *pdu = NULL;
+  gse_status_t status;
+  uint8_t label[6];
+  uint8_t label_type;
+  uint16_t protocol;
+  uint16_t packet_length;
+  unsigned int received[PDU_NBR];
+  unsigned int received_nbr = 0;
+  unsigned int in_frag = 0;
+  unsigned int max_in_frag = 0;
+  unsigned int packet_nbr = 0;
+  unsigned int pushed_nbr = 0;
+  size_t length;
+  unsigned int i;
+  unsigned char s;
+  unsigned char e;
+
+  status = gse_encap_init(QOS_NBR, FIFO_SIZE, &encap);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when initializing encapsulation (%s)\n",
+          status, gse_get_status(status));
+    goto quit;
+  }
+  status = gse_deencap_init(FRAG_ID_NBR, &deencap);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when initializing deencapsulation (%s)\n",
+          status, gse_get_status(status));
+    goto release_encap;
+  }
+
+  status = gse_encap_set_frag_id_pool(encap, 257, WINDOW);
+  if(status != GSE_STATUS_INVALID_FRAG_ID_NBR)
+  {
+    DEBUG(verbose, "A pool of 257 FragID values should be refused\n");
+    goto release_deencap;
+  }
+  status = gse_encap_set_frag_id_pool(encap, FRAG_ID_NBR, WINDOW);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when enabling FragID pool (%s)\n",
+          status, gse_get_status(status));
+    goto release_deencap;
+  }
+
+  if(push_pdu(verbose, encap, pdu_length[pushed_nbr], pushed_nbr, 0))
+  {
+    goto release_deencap;
+  }
+  pushed_nbr++;
+
+  /* The pool cannot be changed while PDUs are queued */
+  status = gse_encap_set_frag_id_pool(encap, 0, 0);
+  if(status != GSE_STATUS_FIFO_NOT_EMPTY)
+  {
+    DEBUG(verbose, "FragID pool should not be changed with queued PDUs\n");
+    goto release_deencap;
+  }
+
+  /* Alternate long and short packets so that small PDUs do not always fit */
+  length = PACKET_LENGTH;
+  while((status = gse_encap_get_packet_copy(&packet, encap, length, 0))
+        == GSE_STATUS_OK)
+  {
+    packet_nbr++;
+    length = (packet_nbr % 2 ? SHORT_PACKET_LENGTH : PACKET_LENGTH);
+    /* A new PDU is received while the previous ones are fragmented */
+    if(pushed_nbr < PDU_NBR)
+    {
+      if(push_pdu(verbose, encap, pdu_length[pushed_nbr], pushed_nbr, 0))
+      {
+        goto free_packet;
+      }
+      pushed_nbr++;
+    }
+    s = (packet->start[0] >> 7) & 0x1;
+    e = (packet->start[0] >> 6) & 0x1;
+    if(!s || !e)
+    {
+      if(packet->start[2] >= FRAG_ID_NBR)
+      {
+        DEBUG(verbose, "FragID %u is outside the pool\n", packet->start[2]);
+        goto free_packet;
+      }
+      if(s)
+      {
+        in_frag++;
+        max_in_frag = (in_frag > max_in_frag ? in_frag : max_in_frag);
+      }
+      if(e)
+      {
+        in_frag--;
+      }
+    }
+    DEBUG(verbose, "Packet S=%u E=%u length=%zu\n", s, e, packet->length);
+
+    /* The packet is destroyed by the deencapsulation */
+    status = gse_deencap_packet(packet, deencap, &label_type, label,
+                                &protocol, &pdu, &packet_length);
+    packet = NULL;
+    if(status == GSE_STATUS_PDU_RECEIVED)
+    {
+      if(received_nbr >= PDU_NBR || pdu->length < 1 ||
+         pdu->start[0] >= PDU_NBR || protocol != PROTOCOL ||
+         pdu->length != pdu_length[pdu->start[0]])
+      {
+        DEBUG(verbose, "Unexpected PDU received\n");
+        gse_free_vfrag(&pdu);
+        goto release_deencap;
+      }
+      for(i = 0 ; i < pdu->length ; i++)
+      {
+        if(pdu->start[i] != pdu->start[0])
+        {
+          DEBUG(verbose, "PDU %u content is corrupted\n", pdu->start[0]);
+          gse_free_vfrag(&pdu);
+          goto release_deencap;
+        }
+      }
+      DEBUG(verbose, "PDU %u received\n", pdu->start[0]);
+      received[received_nbr++] = pdu->start[0];
+      gse_free_vfrag(&pdu);
+    }
+    else if(status != GSE_STATUS_OK)
+    {
+      DEBUG(verbose, "Error %#.4x when deencapsulating packet (%s)\n",
+            status, gse_get_status(status));
+      goto release_deencap;
+    }
+  }
+  if(status != GSE_STATUS_FIFO_EMPTY)
+  {
+    DEBUG(verbose, "Error %#.4x when getting packet (%s)\n",
+          status, gse_get_status(status));
+    goto release_deencap;
+  }
+
+  if(received_nbr != PDU_NBR)
+  {
+    DEBUG(verbose, "%u PDUs received instead of %u\n", received_nbr, PDU_NBR);
+    goto release_deencap;
+  }
+  /* The small PDU queued behind the first large one shall not wait for it */
+  if(received[0] != 1)
+  {
+    DEBUG(verbose, "PDU %u received first instead of PDU 1\n", received[0]);
+    goto release_deencap;
+  }
+  if(max_in_frag < 2 || max_in_frag > WINDOW)
+  {
+    DEBUG(verbose, "%u PDUs fragmented at the same time\n", max_in_frag);
+    goto release_deencap;
+  }
+
+  is_failure = 0;
+  goto release_deencap;
+
+free_packet:
+  gse_free_vfrag(&packet);
+release_deencap:
+  gse_deencap_release(deencap);
+release_encap:
+  gse_encap_release(encap);
+quit:
+  return is_failure;
+}
+
+/**
+ * @brief Check that a PDU is not fragmented when the FragID pool is empty
+ *
+ * @param   verbose  Print debug if verbose is 1
+ * @return  0 on success, 1 on failure
+ */
+static int test_exhausted(int verbose)
+{
+  int is_failure = 1;
+  gse_encap_t *encap = NULL;
+  gse_vfrag_t *packet = NULL;
+  gse_status_t status;
+  uint8_t qos;
+
+  status = gse_encap_init(QOS_NBR, FIFO_SIZE, &encap);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when initializing encapsulation (%s)\n",
+          status, gse_get_status(status));
+    goto quit;
+  }
+  status = gse_encap_set_frag_id_pool(encap, 1, WINDOW);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when enabling FragID pool (%s)\n",
+          status, gse_get_status(status));
+    goto release_encap;
+  }
+  for(qos = 0 ; qos < QOS_NBR ; qos++)
+  {
+    if(push_pdu(verbose, encap, 1000, qos, qos))
+    {
+      goto release_encap;
+    }
+  }
+
+  /* The first QoS takes the only FragID */
+  status = gse_encap_get_packet_copy(&packet, encap, PACKET_LENGTH, 0);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when getting packet (%s)\n",
+          status, gse_get_status(status));
+    goto release_encap;
+  }
+  gse_free_vfrag(&packet);
+  status = gse_encap_get_packet_copy(&packet, encap, PACKET_LENGTH, 1);
+  if(status != GSE_STATUS_FRAG_ID_EXHAUSTED)
+  {
+    DEBUG(verbose, "Status %#.4x instead of FragID exhaustion (%s)\n",
+          status, gse_get_status(status));
+    gse_free_vfrag(&packet);
+    goto release_encap;
+  }
+  /* A packet that does not need fragmentation can still be sent */
+  status = gse_encap_get_packet_copy(&packet, encap, 0, 1);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when getting complete packet (%s)\n",
+          status, gse_get_status(status));
+    goto release_encap;
+  }
+  gse_free_vfrag(&packet);
+
+  /* Once the first PDU is sent, the FragID can be used again */
+  while((status = gse_encap_get_packet_copy(&packet, encap, PACKET_LENGTH, 0))
+        == GSE_STATUS_OK)
+  {
+    gse_free_vfrag(&packet);
+  }
+  if(status != GSE_STATUS_FIFO_EMPTY)
+  {
+    DEBUG(verbose, "Error %#.4x when getting packet (%s)\n",
+          status, gse_get_status(status));
+    goto release_encap;
+  }
+  if(push_pdu(verbose, encap, 1000, 1, 1))
+  {
+    goto release_encap;
+  }
+  status = gse_encap_get_packet_copy(&packet, encap, PACKET_LENGTH, 1);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when getting packet (%s)\n",
+          status, gse_get_status(status));
+    goto release_encap;
+  }
+  gse_free_vfrag(&packet);
+
+  is_failure = 0;
+
+release_encap:
+  gse_encap_release(encap);
+quit:
+  return is_failure;
+}
+
+/**
+ * @brief Create a PDU filled with a pattern and give it to the encapsulation
+ *
+ * @param   verbose  Print debug if verbose is 1
+ * @param   encap    The encapsulation structure
+ * @param   length   The PDU length
+ * @param   pattern  The byte used to fill the PDU
+ * @param   qos      The QoS of the PDU
+ * @return  0 on success, 1 on failure
+ */
+static int push_pdu(int verbose, gse_encap_t *encap, size_t length,
+                    unsigned char pattern, uint8_t qos)
+{
+  gse_vfrag_t *pdu;
+  gse_status_t status;
+  uint8_t label[6] = { 0, 1, 2, 3, 4, 5 };
+
+  status = gse_create_vfrag(&pdu, length, GSE_MAX_HEADER_LENGTH,
+                            GSE_MAX_TRAILER_LENGTH);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when creating PDU (%s)\n",
+          status, gse_get_status(status));
+    return 1;
+  }
+  memset(pdu->start, pattern, length);
+  status = gse_encap_receive_pdu(pdu, encap, label, LABEL_TYPE, PROTOCOL, qos);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when receiving PDU (%s)\n",
+          status, gse_get_status(status));
+    return 1;
+  }
+  return 0;
+}
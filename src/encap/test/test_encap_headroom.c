@@ -0,0 +1,629 @@
+/*
+ *
+ * This piece of software is an implementation of the Generic Stream
+ * Encapsulation (GSE) standard defined by ETSI for Linux (or other
+ * Unix-compatible OS). The library may be used to add GSE
+ * encapsulation/de-encapsulation capabilities to an application.
+ *
+ *
+ * Copyright © 2016 TAS
+ *
+ *
+ * This file is part of the GSE library.
+ *
+ *
+ * The GSE library is free software : you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY, without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see http://www.gnu.org/licenses/.
+ *
+ */
+
+/****************************************************************************/
+/**
+ *   @file          test_encap_headroom.c
+ *
+ *          Project:     GSE LIBRARY
+ *
+ *          Company:     THALES ALENIA SPACE
+ *
+ *          Module name: ENCAP
+ *
+ *   @brief         Check that the buffers are not reallocated when they are
+ *                  allocated with room for the header and the extensions
+ *
+ *   @author        Julien BERNARD / Viveris Technologies
+ *
+ */
+/****************************************************************************/
+
+/****************************************************************************
+ *
+ *   INCLUDES
+ *
+ *****************************************************************************/
+
+/* system includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+/* GSE includes */
+#include "encap.h"
+#include "encap_header_ext.h"
+#include "deencap.h"
+#include "deencap_header_ext.h"
+
+/****************************************************************************
+ *
+ *   MACROS AND CONSTANTS
+ *
+ *****************************************************************************/
+
+/** The number of FIFOs */
+#define QOS_NBR 1
+/** The size of the FIFOs */
+#define FIFO_SIZE 8
+/** The number of PDUs of each workload */
+#define PDU_NBR 4
+/** The length of the PDUs sent in one packet */
+#define SHORT_PDU_LENGTH 200
+/** The length of the PDUs fragmented */
+#define LONG_PDU_LENGTH 1000
+/** The length of the GSE packets */
+#define PACKET_LENGTH 400
+/** The maximum length of the GSE packets with extensions, shorter than the
+ *  packets carrying the long PDUs so that they are refragmented */
+#define REFRAG_LENGTH 600
+/** The length of the header extensions */
+#define EXT_LENGTH 4
+/** The type of the header extensions: 00000 | H-LEN 010 | H-TYPE 0xAB */
+#define EXT_TYPE 0x02AB
+/** The type of label carried by the GSE packets */
+#define LABEL_TYPE 0x0
+/** The protocol carried by the GSE packets */
+#define PROTOCOL 0x2345
+
+/* DEBUG macro */
+#define DEBUG(verbose, format, ...) \
+  do { \
+    if(verbose) \
+      printf(format, ##__VA_ARGS__); \
+  } while(0)
+
+/****************************************************************************
+ *
+ *   PROTOTYPES OF PRIVATE FUNCTIONS
+ *
+ *****************************************************************************/
+
+static int test_encap(int verbose);
+static int test_add_ext(int verbose);
+static int add_ext_and_check(int verbose, gse_encap_t *encap,
+                             gse_deencap_t *deencap, size_t pdu_length,
+                             size_t max_length, unsigned int *built_nbr,
+                             int *received);
+static int push_pdu(int verbose, gse_encap_t *encap, size_t length,
+                    size_t head_offset);
+static int check_packet(int verbose, gse_deencap_t *deencap,
+                        gse_vfrag_t *packet, size_t pdu_length,
+                        int *received);
+static int build_ext(unsigned char *ext, size_t *length,
+                     uint16_t *extension_type, uint16_t protocol_type,
+                     void *opaque);
+static int read_ext(unsigned char *ext, size_t *length,
+                    uint16_t *protocol_type, uint16_t extension_type,
+                    void *opaque);
+
+/****************************************************************************
+ *
+ *   PUBLIC FUNCTIONS
+ *
+ *****************************************************************************/
+
+/**
+ * @brief Main function for the GSE headroom test program
+ *
+ * @param argc  the number of program arguments
+ * @param argv  the program arguments
+ * @return      the unix return code:
+ *               \li 0 in case of success,
+ *               \li 1 in case of failure
+ */
+int main(int argc, char *argv[])
+{
+  int res = 1;
+  int verbose = 0;
+
+  if(argc > 2 || argc < 1)
+  {
+    printf("USAGE : test_encap_headroom [verbose]\n");
+  }
+  else
+  {
+    if(argc == 2)
+    {
+      if(!strcmp(argv[1], "verbose"))
+      {
+        verbose = 1;
+      }
+      else
+      {
+        printf("USAGE : test_encap_headroom [verbose]\n");
+        goto quit;
+      }
+    }
+    res = test_encap(verbose);
+    if(res == 0)
+    {
+      res = test_add_ext(verbose);
+    }
+  }
+
+quit:
+  return res;
+}
+
+/****************************************************************************
+ *
+ *   PRIVATE FUNCTIONS
+ *
+ *****************************************************************************/
+
+/**
+ * @brief Encapsulate PDUs with header extensions built by the encapsulation
+ *        and check that no buffer is reallocated
+ *
+ * @param   verbose  Print debug if verbose is 1
+ * @return  0 on success, 1 on failure
+ */
+static int test_encap(int verbose)
+{
+  int is_failure = 1;
+  gse_encap_t *encap = NULL;
+  gse_deencap_t *deencap = NULL;
+  gse_vfrag_t *packet = NULL;
+  gse_status_t status;
+  unsigned long realloc_nbr;
+  unsigned int built_nbr = 0;
+  unsigned int read_nbr = 0;
+  unsigned int i;
+  int received = 0;
+
+  realloc_nbr = gse_get_vfrag_realloc_nbr();
+
+  status = gse_encap_init(QOS_NBR, FIFO_SIZE, &encap);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when initializing encapsulation (%s)\n",
+          status, gse_get_status(status));
+    goto quit;
+  }
+  status = gse_deencap_init(QOS_NBR, &deencap);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when initializing deencapsulation (%s)\n",
+          status, gse_get_status(status));
+    goto release_encap;
+  }
+  status = gse_encap_set_extension_callback(encap, build_ext, &built_nbr);
+  if(status == GSE_STATUS_OK)
+  {
+    status = gse_deencap_set_extension_callback(deencap, read_ext,
+                                                &read_nbr);
+  }
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when setting extension callbacks (%s)\n",
+          status, gse_get_status(status));
+    goto release_deencap;
+  }
+
+  for(i = 0 ; i < PDU_NBR ; i++)
+  {
+    if(push_pdu(verbose, encap, LONG_PDU_LENGTH,
+                GSE_MAX_HEADER_LENGTH + EXT_LENGTH))
+    {
+      goto release_deencap;
+    }
+    received = 0;
+    while((status = gse_encap_get_packet_copy(&packet, encap, PACKET_LENGTH,
+                                              0)) == GSE_STATUS_OK)
+    {
+      if(check_packet(verbose, deencap, packet, LONG_PDU_LENGTH, &received))
+      {
+        goto release_deencap;
+      }
+    }
+    if(status != GSE_STATUS_FIFO_EMPTY || !received)
+    {
+      DEBUG(verbose, "PDU %u not received\n", i);
+      goto release_deencap;
+    }
+  }
+
+  if(built_nbr != PDU_NBR || read_nbr != PDU_NBR)
+  {
+    DEBUG(verbose, "%u extensions built and %u read\n", built_nbr,
+          read_nbr);
+    goto release_deencap;
+  }
+  if(gse_get_vfrag_realloc_nbr() != realloc_nbr)
+  {
+    DEBUG(verbose, "%lu buffers reallocated\n",
+          gse_get_vfrag_realloc_nbr() - realloc_nbr);
+    goto release_deencap;
+  }
+
+  is_failure = 0;
+
+release_deencap:
+  gse_deencap_release(deencap);
+release_encap:
+  gse_encap_release(encap);
+quit:
+  return is_failure;
+}
+
+/**
+ * @brief Add header extensions to GSE packets, refragmented or not, and
+ *        check that the buffers are only reallocated when they have no room
+ *        left
+ *
+ * @param   verbose  Print debug if verbose is 1
+ * @return  0 on success, 1 on failure
+ */
+static int test_add_ext(int verbose)
+{
+  int is_failure = 1;
+  gse_encap_t *encap = NULL;
+  gse_deencap_t *deencap = NULL;
+  gse_status_t status;
+  unsigned long realloc_nbr;
+  unsigned int built_nbr = 0;
+  unsigned int read_nbr = 0;
+  unsigned int i;
+  int received = 0;
+
+  realloc_nbr = gse_get_vfrag_realloc_nbr();
+
+  status = gse_encap_init(QOS_NBR, FIFO_SIZE, &encap);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when initializing encapsulation (%s)\n",
+          status, gse_get_status(status));
+    goto quit;
+  }
+  status = gse_deencap_init(QOS_NBR, &deencap);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when initializing deencapsulation (%s)\n",
+          status, gse_get_status(status));
+    goto release_encap;
+  }
+  status = gse_deencap_set_extension_callback(deencap, read_ext, &read_nbr);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when setting extension callback (%s)\n",
+          status, gse_get_status(status));
+    goto release_deencap;
+  }
+
+  /* The packets have room for the extensions */
+  status = gse_encap_set_offsets(encap,
+                                 GSE_MAX_REFRAG_HEAD_OFFSET + EXT_LENGTH, 0);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when setting offsets (%s)\n",
+          status, gse_get_status(status));
+    goto release_deencap;
+  }
+  for(i = 0 ; i < PDU_NBR ; i++)
+  {
+    received = 0;
+    if(add_ext_and_check(verbose, encap, deencap, SHORT_PDU_LENGTH, 0,
+                         &built_nbr, &received))
+    {
+      goto release_deencap;
+    }
+  }
+
+  /* The first part of the refragmented packets grows in place */
+  status = gse_encap_set_offsets(encap, GSE_MAX_REFRAG_HEAD_OFFSET, 0);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when setting offsets (%s)\n",
+          status, gse_get_status(status));
+    goto release_deencap;
+  }
+  for(i = 0 ; i < PDU_NBR ; i++)
+  {
+    received = 0;
+    if(add_ext_and_check(verbose, encap, deencap, LONG_PDU_LENGTH,
+                         REFRAG_LENGTH,
+                         &built_nbr, &received))
+    {
+      goto release_deencap;
+    }
+  }
+
+  if(gse_get_vfrag_realloc_nbr() != realloc_nbr)
+  {
+    DEBUG(verbose, "%lu buffers reallocated\n",
+          gse_get_vfrag_realloc_nbr() - realloc_nbr);
+    goto release_deencap;
+  }
+
+  /* A packet without room is reallocated */
+  status = gse_encap_set_offsets(encap, 0, 0);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when setting offsets (%s)\n",
+          status, gse_get_status(status));
+    goto release_deencap;
+  }
+  received = 0;
+  if(add_ext_and_check(verbose, encap, deencap, SHORT_PDU_LENGTH, 0,
+                         &built_nbr, &received))
+  {
+    goto release_deencap;
+  }
+  if(gse_get_vfrag_realloc_nbr() != realloc_nbr + 1)
+  {
+    DEBUG(verbose, "The reallocation was not counted\n");
+    goto release_deencap;
+  }
+  /* The extensions are built again for the refragmented packets */
+  if(read_nbr != 2 * PDU_NBR + 1 || built_nbr != 3 * PDU_NBR + 1)
+  {
+    DEBUG(verbose, "%u extensions built and %u read\n", built_nbr,
+          read_nbr);
+    goto release_deencap;
+  }
+
+  is_failure = 0;
+
+release_deencap:
+  gse_deencap_release(deencap);
+release_encap:
+  gse_encap_release(encap);
+quit:
+  return is_failure;
+}
+
+/**
+ * @brief Encapsulate a PDU in one packet, add header extensions to the
+ *        packet and check that the PDU is correctly deencapsulated
+ *
+ * @param   verbose     Print debug if verbose is 1
+ * @param   encap       The encapsulation structure
+ * @param   deencap     The deencapsulation structure
+ * @param   pdu_length  The PDU length
+ * @param   max_length  The maximum length of the packet with extensions,
+ *                      0 for the maximum GSE packet length
+ * @param   built_nbr   IN/OUT: The number of extensions built
+ * @param   received    OUT: Set to 1 if the PDU is received
+ * @return  0 on success, 1 on failure
+ */
+static int add_ext_and_check(int verbose, gse_encap_t *encap,
+                             gse_deencap_t *deencap, size_t pdu_length,
+                             size_t max_length, unsigned int *built_nbr,
+                             int *received)
+{
+  gse_vfrag_t *packet = NULL;
+  gse_vfrag_t *frag = NULL;
+  gse_status_t status;
+  uint32_t crc;
+
+  if(push_pdu(verbose, encap, pdu_length, GSE_MAX_HEADER_LENGTH))
+  {
+    return 1;
+  }
+  status = gse_encap_get_packet_copy(&packet, encap, 0, 0);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when getting packet (%s)\n",
+          status, gse_get_status(status));
+    return 1;
+  }
+  status = gse_encap_add_header_ext(packet, &frag, &crc, build_ext,
+                                    max_length, 0, 0, 0, built_nbr);
+  if(status == GSE_STATUS_PARTIAL_CRC && frag != NULL)
+  {
+    status = gse_encap_update_crc(frag, &crc);
+  }
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when adding extensions (%s)\n",
+          status, gse_get_status(status));
+    gse_free_vfrag(&packet);
+    if(frag != NULL)
+    {
+      gse_free_vfrag(&frag);
+    }
+    return 1;
+  }
+  if(check_packet(verbose, deencap, packet, pdu_length, received))
+  {
+    if(frag != NULL)
+    {
+      gse_free_vfrag(&frag);
+    }
+    return 1;
+  }
+  if(frag != NULL &&
+     check_packet(verbose, deencap, frag, pdu_length, received))
+  {
+    return 1;
+  }
+  if(!*received)
+  {
+    DEBUG(verbose, "PDU not received\n");
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * @brief Create a PDU and give it to the encapsulation
+ *
+ * @param   verbose      Print debug if verbose is 1
+ * @param   encap        The encapsulation structure
+ * @param   length       The PDU length
+ * @param   head_offset  The room before the PDU data
+ * @return  0 on success, 1 on failure
+ */
+static int push_pdu(int verbose, gse_encap_t *encap, size_t length,
+                    size_t head_offset)
+{
+  gse_vfrag_t *pdu;
+  gse_status_t status;
+  uint8_t label[6] = { 0, 1, 2, 3, 4, 5 };
+  unsigned int i;
+
+  status = gse_create_vfrag(&pdu, length, head_offset,
+                            GSE_MAX_TRAILER_LENGTH);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when creating PDU (%s)\n",
+          status, gse_get_status(status));
+    return 1;
+  }
+  for(i = 0 ; i < length ; i++)
+  {
+    pdu->start[i] = i % 251;
+  }
+  status = gse_encap_receive_pdu(pdu, encap, label, LABEL_TYPE, PROTOCOL, 0);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when receiving PDU (%s)\n",
+          status, gse_get_status(status));
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * @brief Deencapsulate a GSE packet and check the PDU if it is complete
+ *
+ * @param   verbose     Print debug if verbose is 1
+ * @param   deencap     The deencapsulation structure
+ * @param   packet      The GSE packet, destroyed
+ * @param   pdu_length  The expected PDU length
+ * @param   received    OUT: Set to 1 if the PDU is received
+ * @return  0 on success, 1 on failure
+ */
+static int check_packet(int verbose, gse_deencap_t *deencap,
+                        gse_vfrag_t *packet, size_t pdu_length,
+                        int *received)
+{
+  gse_vfrag_t *pdu = NULL;
+  gse_status_t status;
+  uint8_t label[6];
+  uint8_t label_type;
+  uint16_t protocol;
+  uint16_t packet_length;
+  unsigned int i;
+
+  DEBUG(verbose, "Packet S=%u E=%u length=%zu\n",
+        (packet->start[0] >> 7) & 0x1, (packet->start[0] >> 6) & 0x1,
+        packet->length);
+  status = gse_deencap_packet(packet, deencap, &label_type, label, &protocol,
+                              &pdu, &packet_length);
+  if(status == GSE_STATUS_PDU_RECEIVED)
+  {
+    if(protocol != PROTOCOL || pdu->length != pdu_length)
+    {
+      DEBUG(verbose, "Unexpected PDU received (protocol %#.4x, length %zu)\n",
+            protocol, pdu->length);
+      gse_free_vfrag(&pdu);
+      return 1;
+    }
+    for(i = 0 ; i < pdu_length ; i++)
+    {
+      if(pdu->start[i] != i % 251)
+      {
+        DEBUG(verbose, "Unexpected data at offset %u\n", i);
+        gse_free_vfrag(&pdu);
+        return 1;
+      }
+    }
+    *received = 1;
+    gse_free_vfrag(&pdu);
+  }
+  else if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when deencapsulating packet (%s)\n",
+          status, gse_get_status(status));
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * @brief Build the header extension carried before the PDUs
+ *
+ * @param   ext             OUT: The header extensions
+ * @param   length          IN: The room for the extensions
+ *                          OUT: The length of the extensions
+ * @param   extension_type  OUT: The type of the first extension
+ * @param   protocol_type   The protocol of the PDU
+ * @param   opaque          The number of extensions built
+ * @return  The length of the extensions, -1 on failure
+ */
+static int build_ext(unsigned char *ext, size_t *length,
+                     uint16_t *extension_type, uint16_t protocol_type,
+                     void *opaque)
+{
+  unsigned int *built_nbr = opaque;
+
+  if(*length < EXT_LENGTH)
+  {
+    return -1;
+  }
+  (*built_nbr)++;
+  ext[0] = 0xAA;
+  ext[1] = 0x55;
+  ext[2] = (protocol_type >> 8) & 0xFF;
+  ext[3] = protocol_type & 0xFF;
+  *extension_type = EXT_TYPE;
+  *length = EXT_LENGTH;
+  return EXT_LENGTH;
+}
+
+/**
+ * @brief Read the header extension carried before the PDUs
+ *
+ * @param   ext             The header extensions
+ * @param   length          IN: The available length
+ *                          OUT: The length of the extensions
+ * @param   protocol_type   OUT: The protocol of the PDU
+ * @param   extension_type  The type of the first extension
+ * @param   opaque          The number of extensions read
+ * @return  0 on success, -1 on failure
+ */
+static int read_ext(unsigned char *ext, size_t *length,
+                    uint16_t *protocol_type, uint16_t extension_type,
+                    void *opaque)
+{
+  unsigned int *read_nbr = opaque;
+
+  if(extension_type != EXT_TYPE || *length < EXT_LENGTH ||
+     ext[0] != 0xAA || ext[1] != 0x55)
+  {
+    return -1;
+  }
+  (*read_nbr)++;
+  *protocol_type = (ext[2] << 8) | ext[3];
+  *length = EXT_LENGTH;
+  return 0;
+}
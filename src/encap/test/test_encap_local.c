@@ -0,0 +1,608 @@
+/*
+ *
+ * This piece of software is an implementation of the Generic Stream
+ * Encapsulation (GSE) standard defined by ETSI for Linux (or other
+ * Unix-compatible OS). The library may be used to add GSE
+ * encapsulation/de-encapsulation capabilities to an application.
+ *
+ *
+ * Copyright © 2016 TAS
+ *
+ *
+ * This file is part of the GSE library.
+ *
+ *
+ * The GSE library is free software : you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY, without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see http://www.gnu.org/licenses/.
+ *
+ */
+
+/****************************************************************************/
+/**
+ *   @file          test_encap_local.c
+ *
+ *          Project:     GSE LIBRARY
+ *
+ *          Company:     THALES ALENIA SPACE
+ *
+ *          Module name: ENCAP
+ *
+ *   @brief         Local queues of the producer threads
+ *
+ *   @author        Julien BERNARD / Viveris Technologies
+ *
+ */
+/****************************************************************************/
+
+/****************************************************************************
+ *
+ *   INCLUDES
+ *
+ *****************************************************************************/
+
+/* system includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+
+/* GSE includes */
+#include "encap.h"
+#include "deencap.h"
+
+/****************************************************************************
+ *
+ *   MACROS AND CONSTANTS
+ *
+ *****************************************************************************/
+
+/** The number of QoS values */
+#define QOS_NBR 2
+/** The number of producer threads */
+#define THREAD_NBR 4
+/** The number of PDUs sent by each producer thread */
+#define PDU_NBR 100
+/** The size of the FIFOs, large enough for all the PDUs */
+#define FIFO_SIZE (THREAD_NBR * PDU_NBR)
+/** The size of the local queues, PDU_NBR is not a multiple of it so that
+ *  the last PDUs are pushed by the flush */
+#define LOCAL_SIZE 8
+/** The size of the FIFO and of the local queue of the overflow test */
+#define SMALL_SIZE 4
+/** The length of the PDUs */
+#define PDU_LENGTH 100
+/** The type of label carried by the GSE packets */
+#define LABEL_TYPE 0x0
+/** The protocol carried by the GSE packets */
+#define PROTOCOL 0x2345
+
+/* DEBUG macro */
+#define DEBUG(verbose, format, ...) \
+  do { \
+    if(verbose) \
+      printf(format, ##__VA_ARGS__); \
+  } while(0)
+
+/** The parameters of a producer thread */
+typedef struct
+{
+  int verbose;         /**< Whether debug is printed */
+  gse_encap_t *encap;  /**< The encapsulation context */
+  uint8_t id;          /**< The identifier of the thread */
+  int res;             /**< The result of the thread */
+} produce_thread_t;
+
+/****************************************************************************
+ *
+ *   PROTOTYPES OF PRIVATE FUNCTIONS
+ *
+ *****************************************************************************/
+
+static int test_threads(int verbose);
+static int test_full(int verbose);
+static void *produce_thread(void *arg);
+static gse_status_t stage_pdu(gse_encap_local_t *local, uint8_t id,
+                              unsigned int index, uint8_t qos);
+static int get_packet(int verbose, gse_encap_t *encap,
+                      gse_deencap_t *deencap, uint8_t qos,
+                      unsigned int step, unsigned int *next);
+
+/****************************************************************************
+ *
+ *   PUBLIC FUNCTIONS
+ *
+ *****************************************************************************/
+
+/**
+ * @brief Main function for the GSE local queues test program
+ *
+ * @param argc  the number of program arguments
+ * @param argv  the program arguments
+ * @return      the unix return code:
+ *               \li 0 in case of success,
+ *               \li 1 in case of failure
+ */
+int main(int argc, char *argv[])
+{
+  int res = 1;
+  int verbose = 0;
+
+  if(argc > 2 || argc < 1)
+  {
+    printf("USAGE : test_encap_local [verbose]\n");
+  }
+  else
+  {
+    if(argc == 2)
+    {
+      if(!strcmp(argv[1], "verbose"))
+      {
+        verbose = 1;
+      }
+      else
+      {
+        printf("USAGE : test_encap_local [verbose]\n");
+        goto quit;
+      }
+    }
+    res = test_threads(verbose);
+    if(res == 0)
+    {
+      res = test_full(verbose);
+    }
+  }
+
+quit:
+  return res;
+}
+
+/****************************************************************************
+ *
+ *   PRIVATE FUNCTIONS
+ *
+ *****************************************************************************/
+
+/**
+ * @brief Stage PDUs from several threads and check that the PDUs of each
+ *        thread are encapsulated in order
+ *
+ * @param   verbose  Print debug if verbose is 1
+ * @return  0 on success, 1 on failure
+ */
+static int test_threads(int verbose)
+{
+  int is_failure = 1;
+  gse_encap_t *encap;
+  gse_deencap_t *deencap;
+  gse_status_t status;
+  produce_thread_t param[THREAD_NBR];
+  pthread_t thread[THREAD_NBR];
+  unsigned int next[QOS_NBR][THREAD_NBR];
+  unsigned int thread_nbr;
+  unsigned int pdu_nbr;
+  unsigned int i;
+  uint8_t qos;
+
+  status = gse_encap_init(QOS_NBR, FIFO_SIZE, &encap);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when initializing encapsulation (%s)\n",
+          status, gse_get_status(status));
+    goto quit;
+  }
+  status = gse_deencap_init(QOS_NBR, &deencap);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when initializing deencapsulation (%s)\n",
+          status, gse_get_status(status));
+    goto release_encap;
+  }
+
+  for(thread_nbr = 0 ; thread_nbr < THREAD_NBR ; thread_nbr++)
+  {
+    param[thread_nbr].verbose = verbose;
+    param[thread_nbr].encap = encap;
+    param[thread_nbr].id = thread_nbr;
+    param[thread_nbr].res = 1;
+    if(pthread_create(&thread[thread_nbr], NULL, produce_thread,
+                      &param[thread_nbr]) != 0)
+    {
+      DEBUG(verbose, "Cannot create the producer thread %u\n", thread_nbr);
+      break;
+    }
+  }
+  for(i = 0 ; i < thread_nbr ; i++)
+  {
+    pthread_join(thread[i], NULL);
+  }
+  if(thread_nbr != THREAD_NBR)
+  {
+    goto release_deencap;
+  }
+  for(i = 0 ; i < THREAD_NBR ; i++)
+  {
+    if(param[i].res)
+    {
+      DEBUG(verbose, "The producer thread %u failed\n", i);
+      goto release_deencap;
+    }
+  }
+
+  /* The PDU i of each thread is sent on the QoS value i % QOS_NBR */
+  pdu_nbr = 0;
+  for(qos = 0 ; qos < QOS_NBR ; qos++)
+  {
+    for(i = 0 ; i < THREAD_NBR ; i++)
+    {
+      next[qos][i] = qos;
+    }
+    for(i = 0 ; i < THREAD_NBR * PDU_NBR / QOS_NBR ; i++)
+    {
+      if(get_packet(verbose, encap, deencap, qos, QOS_NBR, next[qos]))
+      {
+        goto release_deencap;
+      }
+      pdu_nbr++;
+    }
+  }
+  for(qos = 0 ; qos < QOS_NBR ; qos++)
+  {
+    for(i = 0 ; i < THREAD_NBR ; i++)
+    {
+      if(next[qos][i] < PDU_NBR)
+      {
+        DEBUG(verbose, "PDU %u of thread %u not received\n", next[qos][i], i);
+        goto release_deencap;
+      }
+    }
+  }
+  DEBUG(verbose, "%u PDUs received from %u threads\n", pdu_nbr, THREAD_NBR);
+
+  is_failure = 0;
+
+release_deencap:
+  gse_deencap_release(deencap);
+release_encap:
+  gse_encap_release(encap);
+quit:
+  return is_failure;
+}
+
+/**
+ * @brief Check that the PDUs which do not fit in the FIFO are kept in the
+ *        local queue and that a full local queue drops the new PDUs only
+ *        when none of its PDUs can be pushed
+ *
+ * @param   verbose  Print debug if verbose is 1
+ * @return  0 on success, 1 on failure
+ */
+static int test_full(int verbose)
+{
+  int is_failure = 1;
+  gse_encap_t *encap;
+  gse_deencap_t *deencap;
+  gse_encap_local_t *local;
+  gse_status_t status;
+  unsigned int next = 0;
+  unsigned int elt_nbr;
+  unsigned int i;
+
+  status = gse_encap_init(1, SMALL_SIZE, &encap);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when initializing encapsulation (%s)\n",
+          status, gse_get_status(status));
+    goto quit;
+  }
+  status = gse_deencap_init(1, &deencap);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when initializing deencapsulation (%s)\n",
+          status, gse_get_status(status));
+    goto release_encap;
+  }
+  status = gse_encap_local_init(encap, 0, &local);
+  if(status != GSE_STATUS_FIFO_SIZE_NULL)
+  {
+    DEBUG(verbose, "Local queues created with a null size\n");
+    goto release_deencap;
+  }
+  status = gse_encap_local_init(encap, SMALL_SIZE, &local);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when creating the local queues (%s)\n",
+          status, gse_get_status(status));
+    goto release_deencap;
+  }
+
+  /* The first batch fills the FIFO, the second one stays staged */
+  for(i = 0 ; i < 2 * SMALL_SIZE ; i++)
+  {
+    status = stage_pdu(local, 0, i, 0);
+    if(status != GSE_STATUS_OK)
+    {
+      DEBUG(verbose, "Error %#.4x when staging PDU %u (%s)\n",
+            status, i, gse_get_status(status));
+      goto release_local;
+    }
+  }
+  status = gse_encap_local_get_nbr(local, 0, &elt_nbr);
+  if(status != GSE_STATUS_OK || elt_nbr != SMALL_SIZE)
+  {
+    DEBUG(verbose, "%u PDUs staged instead of %u\n", elt_nbr, SMALL_SIZE);
+    goto release_local;
+  }
+  status = stage_pdu(local, 0, 2 * SMALL_SIZE, 0);
+  if(status != GSE_STATUS_FIFO_FULL)
+  {
+    DEBUG(verbose, "PDU staged in a full local queue\n");
+    goto release_local;
+  }
+  status = gse_encap_local_flush(local);
+  if(status != GSE_STATUS_FIFO_FULL)
+  {
+    DEBUG(verbose, "Local queue flushed in a full FIFO\n");
+    goto release_local;
+  }
+
+  /* A packet built from the FIFO gives room to one staged PDU, which gives
+   * room to the new PDU in the local queue */
+  if(get_packet(verbose, encap, deencap, 0, 1, &next))
+  {
+    goto release_local;
+  }
+  status = stage_pdu(local, 0, 2 * SMALL_SIZE, 0);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when staging PDU %u (%s)\n",
+          status, 2 * SMALL_SIZE, gse_get_status(status));
+    goto release_local;
+  }
+  status = gse_encap_local_get_nbr(local, 0, &elt_nbr);
+  if(status != GSE_STATUS_OK || elt_nbr != SMALL_SIZE)
+  {
+    DEBUG(verbose, "%u PDUs staged instead of %u\n", elt_nbr, SMALL_SIZE);
+    goto release_local;
+  }
+
+  /* Once the FIFO is emptied, the staged PDUs follow the first batch */
+  for(i = 0 ; i < SMALL_SIZE ; i++)
+  {
+    if(get_packet(verbose, encap, deencap, 0, 1, &next))
+    {
+      goto release_local;
+    }
+  }
+  status = gse_encap_local_flush(local);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when flushing the local queues (%s)\n",
+          status, gse_get_status(status));
+    goto release_local;
+  }
+  status = gse_encap_local_get_nbr(local, 0, &elt_nbr);
+  if(status != GSE_STATUS_OK || elt_nbr != 0)
+  {
+    DEBUG(verbose, "%u PDUs still staged after flush\n", elt_nbr);
+    goto release_local;
+  }
+  for(i = 0 ; i < SMALL_SIZE ; i++)
+  {
+    if(get_packet(verbose, encap, deencap, 0, 1, &next))
+    {
+      goto release_local;
+    }
+  }
+  if(next != 2 * SMALL_SIZE + 1)
+  {
+    DEBUG(verbose, "%u PDUs received instead of %u\n", next,
+          2 * SMALL_SIZE + 1);
+    goto release_local;
+  }
+
+  is_failure = 0;
+
+release_local:
+  status = gse_encap_local_release(local);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when releasing the local queues (%s)\n",
+          status, gse_get_status(status));
+    is_failure = 1;
+  }
+release_deencap:
+  gse_deencap_release(deencap);
+release_encap:
+  gse_encap_release(encap);
+quit:
+  return is_failure;
+}
+
+/**
+ * @brief Stage the PDUs of a thread in its local queues, the PDU i is sent
+ *        on the QoS value i % QOS_NBR
+ *
+ * @param   arg  The parameters of the thread
+ * @return  NULL
+ */
+static void *produce_thread(void *arg)
+{
+  produce_thread_t *param = arg;
+  gse_encap_local_t *local;
+  gse_status_t status;
+  unsigned int elt_nbr;
+  unsigned int i;
+  uint8_t qos;
+
+  status = gse_encap_local_init(param->encap, LOCAL_SIZE, &local);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(param->verbose, "Error %#.4x when creating the local queues (%s)\n",
+          status, gse_get_status(status));
+    goto quit;
+  }
+
+  for(i = 0 ; i < PDU_NBR ; i++)
+  {
+    status = stage_pdu(local, param->id, i, i % QOS_NBR);
+    if(status != GSE_STATUS_OK)
+    {
+      DEBUG(param->verbose, "Error %#.4x when staging PDU (%s)\n",
+            status, gse_get_status(status));
+      goto release;
+    }
+  }
+  status = gse_encap_local_flush(local);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(param->verbose, "Error %#.4x when flushing the local queues "
+          "(%s)\n", status, gse_get_status(status));
+    goto release;
+  }
+  for(qos = 0 ; qos < QOS_NBR ; qos++)
+  {
+    status = gse_encap_local_get_nbr(local, qos, &elt_nbr);
+    if(status != GSE_STATUS_OK || elt_nbr != 0)
+    {
+      DEBUG(param->verbose, "%u PDUs still staged after flush\n", elt_nbr);
+      goto release;
+    }
+  }
+
+  param->res = 0;
+
+release:
+  gse_encap_local_release(local);
+quit:
+  return NULL;
+}
+
+/**
+ * @brief Stage a PDU whose first bytes give the thread and the index of the
+ *        PDU, the other bytes are filled with the index
+ *
+ * @param   local  The local queues
+ * @param   id     The identifier of the thread
+ * @param   index  The index of the PDU in the thread
+ * @param   qos    The QoS value of the PDU
+ * @return  The status of the staging
+ */
+static gse_status_t stage_pdu(gse_encap_local_t *local, uint8_t id,
+                              unsigned int index, uint8_t qos)
+{
+  gse_vfrag_t *pdu;
+  gse_status_t status;
+  uint8_t label[6] = { id, 1, 2, 3, 4, 5 };
+  unsigned char data[PDU_LENGTH];
+
+  memset(data, index & 0xFF, PDU_LENGTH);
+  data[0] = id;
+  data[1] = (index >> 8) & 0xFF;
+  data[2] = index & 0xFF;
+
+  status = gse_create_vfrag_with_data(&pdu, PDU_LENGTH,
+                                      GSE_MAX_HEADER_LENGTH,
+                                      GSE_MAX_TRAILER_LENGTH,
+                                      data, PDU_LENGTH);
+  if(status != GSE_STATUS_OK)
+  {
+    goto error;
+  }
+
+  status = gse_encap_local_receive_pdu(pdu, local, label, LABEL_TYPE,
+                                       PROTOCOL, qos, 0);
+
+error:
+  return status;
+}
+
+/**
+ * @brief Get a GSE packet of a QoS value and check that its PDU is the next
+ *        one of its thread
+ *
+ * @param   verbose  Print debug if verbose is 1
+ * @param   encap    The encapsulation context
+ * @param   deencap  The deencapsulation context
+ * @param   qos      The QoS value
+ * @param   step     The difference between the indexes of two consecutive
+ *                   PDUs of a thread on the QoS value
+ * @param   next     IN/OUT: The index of the next expected PDU of each
+ *                   thread
+ * @return  0 on success, 1 on failure
+ */
+static int get_packet(int verbose, gse_encap_t *encap,
+                      gse_deencap_t *deencap, uint8_t qos,
+                      unsigned int step, unsigned int *next)
+{
+  int is_failure = 1;
+  gse_vfrag_t *packet;
+  gse_vfrag_t *pdu = NULL;
+  gse_status_t status;
+  uint8_t label_type;
+  uint8_t rcv_label[6];
+  uint16_t protocol;
+  uint16_t packet_length;
+  unsigned int index;
+  uint8_t id;
+  unsigned int i;
+
+  status = gse_encap_get_packet_copy(&packet, encap, 0, qos);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when getting a packet (%s)\n",
+          status, gse_get_status(status));
+    goto quit;
+  }
+
+  /* The packet is destroyed by the deencapsulation */
+  status = gse_deencap_packet(packet, deencap, &label_type, rcv_label,
+                              &protocol, &pdu, &packet_length);
+  if(status != GSE_STATUS_PDU_RECEIVED)
+  {
+    DEBUG(verbose, "Error %#.4x when deencapsulating packet (%s)\n",
+          status, gse_get_status(status));
+    goto quit;
+  }
+  if(protocol != PROTOCOL || pdu->length != PDU_LENGTH ||
+     pdu->start[0] >= THREAD_NBR || rcv_label[0] != pdu->start[0])
+  {
+    DEBUG(verbose, "PDU received with wrong fields\n");
+    goto free_pdu;
+  }
+  id = pdu->start[0];
+  index = ((unsigned int)pdu->start[1] << 8) | pdu->start[2];
+  if(index != next[id])
+  {
+    DEBUG(verbose, "PDU %u of thread %u received instead of PDU %u\n",
+          index, id, next[id]);
+    goto free_pdu;
+  }
+  for(i = 3 ; i < pdu->length ; i++)
+  {
+    if(pdu->start[i] != (index & 0xFF))
+    {
+      DEBUG(verbose, "PDU %u of thread %u received with wrong data\n",
+            index, id);
+      goto free_pdu;
+    }
+  }
+  next[id] += step;
+
+  is_failure = 0;
+
+free_pdu:
+  gse_free_vfrag(&pdu);
+quit:
+  return is_failure;
+}
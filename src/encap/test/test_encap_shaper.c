@@ -0,0 +1,786 @@
+/*
+ *
+ * This piece of software is an implementation of the Generic Stream
+ * Encapsulation (GSE) standard defined by ETSI for Linux (or other
+ * Unix-compatible OS). The library may be used to add GSE
+ * encapsulation/de-encapsulation capabilities to an application.
+ *
+ *
+ * Copyright © 2016 TAS
+ *
+ *
+ * This file is part of the GSE library.
+ *
+ *
+ * The GSE library is free software : you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY, without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see http://www.gnu.org/licenses/.
+ *
+ */
+
+/****************************************************************************/
+/**
+ *   @file          test_encap_shaper.c
+ *
+ *          Project:     GSE LIBRARY
+ *
+ *          Company:     THALES ALENIA SPACE
+ *
+ *          Module name: ENCAP
+ *
+ *   @brief         Frame filling with token bucket shapers
+ *
+ *   @author        Julien BERNARD / Viveris Technologies
+ *
+ */
+/****************************************************************************/
+
+/****************************************************************************
+ *
+ *   INCLUDES
+ *
+ *****************************************************************************/
+
+/* system includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+/* GSE includes */
+#include "encap.h"
+
+/****************************************************************************
+ *
+ *   MACROS AND CONSTANTS
+ *
+ *****************************************************************************/
+
+/** The number of FIFOs */
+#define QOS_NBR 2
+/** The size of the FIFOs */
+#define FIFO_SIZE 16
+/** The length of the frames */
+#define FRAME_LENGTH 4000
+/** The length of the PDUs */
+#define PDU_LENGTH 400
+/** The length of the header of a complete PDU with a 6-bytes label */
+#define HEADER_LENGTH 10
+/** The length of the GSE packets */
+#define PACKET_LENGTH (PDU_LENGTH + HEADER_LENGTH)
+/** The length of the frames that fragment the PDUs of the other labels */
+#define SMALL_FRAME_LENGTH 400
+/** The length of the PDUs of the held label */
+#define HELD_PDU_LENGTH 300
+/** The length of the PDU of the label without shaper */
+#define FREE_PDU_LENGTH 1000
+/** The length of the header of a first fragment with a 6-bytes label */
+#define FIRST_FRAG_HEADER_LENGTH 13
+/** The length of the header of a subsequent fragment */
+#define SUBS_FRAG_HEADER_LENGTH 3
+/** The length of the CRC of the last fragment */
+#define CRC_LENGTH 4
+/** The type of label carried by the GSE packets */
+#define LABEL_TYPE 0x0
+/** The protocol carried by the GSE packets */
+#define PROTOCOL 0x2345
+
+/* DEBUG macro */
+#define DEBUG(verbose, format, ...) \
+  do { \
+    if(verbose) \
+      printf(format, ##__VA_ARGS__); \
+  } while(0)
+
+/****************************************************************************
+ *
+ *   PROTOTYPES OF PRIVATE FUNCTIONS
+ *
+ *****************************************************************************/
+
+static int test_committed(int verbose);
+static int test_peak(int verbose);
+static int test_peak_burst(int verbose);
+static int test_held_label(int verbose);
+static int test_config(int verbose);
+static int push_pdu(int verbose, gse_encap_t *encap, unsigned char pattern,
+                    uint8_t qos);
+static int push_label_pdu(int verbose, gse_encap_t *encap, uint8_t label[6],
+                          size_t length, unsigned char pattern, uint8_t qos);
+static int check_frame(int verbose, unsigned char *frame, size_t length,
+                       const unsigned char *patterns, unsigned int nbr);
+
+/****************************************************************************
+ *
+ *   PUBLIC FUNCTIONS
+ *
+ *****************************************************************************/
+
+/**
+ * @brief Main function for the GSE shaping test program
+ *
+ * @param argc  the number of program arguments
+ * @param argv  the program arguments
+ * @return      the unix return code:
+ *               \li 0 in case of success,
+ *               \li 1 in case of failure
+ */
+int main(int argc, char *argv[])
+{
+  int res = 1;
+  int verbose = 0;
+
+  if(argc > 2 || argc < 1)
+  {
+    printf("USAGE : test_encap_shaper [verbose]\n");
+  }
+  else
+  {
+    if(argc == 2)
+    {
+      if(!strcmp(argv[1], "verbose"))
+      {
+        verbose = 1;
+      }
+      else
+      {
+        printf("USAGE : test_encap_shaper [verbose]\n");
+        goto quit;
+      }
+    }
+    res = test_committed(verbose);
+    if(res != 0)
+    {
+      goto quit;
+    }
+    res = test_peak(verbose);
+    if(res != 0)
+    {
+      goto quit;
+    }
+    res = test_peak_burst(verbose);
+    if(res != 0)
+    {
+      goto quit;
+    }
+    res = test_held_label(verbose);
+    if(res != 0)
+    {
+      goto quit;
+    }
+    res = test_config(verbose);
+  }
+
+quit:
+  return res;
+}
+
+/****************************************************************************
+ *
+ *   PRIVATE FUNCTIONS
+ *
+ *****************************************************************************/
+
+/**
+ * @brief Check that a label is held once its committed burst is sent and
+ *        sent again once its shaper is refilled
+ *
+ * @param   verbose  Print debug if verbose is 1
+ * @return  0 on success, 1 on failure
+ */
+static int test_committed(int verbose)
+{
+  int is_failure = 1;
+  gse_encap_t *encap = NULL;
+  gse_shaper_conf_t conf = { 1000, 1000, 0, 0 };
+  gse_shaper_state_t state;
+  gse_frame_stats_t stats;
+  gse_status_t status;
+  uint8_t label[6] = { 0, 1, 2, 3, 4, 5 };
+  unsigned char frame[FRAME_LENGTH];
+  size_t data_length;
+  unsigned int i;
+
+  status = gse_encap_init(QOS_NBR, FIFO_SIZE, &encap);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when initializing encapsulation (%s)\n",
+          status, gse_get_status(status));
+    goto quit;
+  }
+  status = gse_encap_set_label_shaper(encap, label, LABEL_TYPE, &conf);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when setting label shaper (%s)\n",
+          status, gse_get_status(status));
+    goto release_encap;
+  }
+  status = gse_encap_refill_shapers(encap, 0);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when refilling shapers (%s)\n",
+          status, gse_get_status(status));
+    goto release_encap;
+  }
+  for(i = 0 ; i < 4 ; i++)
+  {
+    if(push_pdu(verbose, encap, i, 0))
+    {
+      goto release_encap;
+    }
+  }
+
+  /* The burst of 1000 bytes allows 3 packets of 410 bytes, the last PDU is
+   * held once per frame */
+  status = gse_encap_fill_frame(encap, GSE_FILL_BEST_FIT, frame, FRAME_LENGTH,
+                                &data_length, &stats);
+  if(status != GSE_STATUS_OK || stats.packet_nbr != 3)
+  {
+    DEBUG(verbose, "Status %#.4x and %u packets instead of 3 (%s)\n",
+          status, stats.packet_nbr, gse_get_status(status));
+    goto release_encap;
+  }
+  status = gse_encap_fill_frame(encap, GSE_FILL_BEST_FIT, frame, FRAME_LENGTH,
+                                &data_length, &stats);
+  if(status != GSE_STATUS_RATE_LIMITED || data_length != 0 ||
+     stats.padding_length != FRAME_LENGTH)
+  {
+    DEBUG(verbose, "Status %#.4x instead of rate limitation (%s)\n",
+          status, gse_get_status(status));
+    goto release_encap;
+  }
+  status = gse_encap_get_label_shaper_state(encap, label, LABEL_TYPE, &state);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when getting shaper state (%s)\n",
+          status, gse_get_status(status));
+    goto release_encap;
+  }
+  DEBUG(verbose, "Committed tokens %lld, green %llu, yellow %llu, held %llu\n",
+        (long long)state.committed_tokens,
+        (unsigned long long)state.green_bytes,
+        (unsigned long long)state.yellow_bytes,
+        (unsigned long long)state.held_nbr);
+  if(state.committed_tokens != 1000 - 3 * PACKET_LENGTH ||
+     state.green_bytes != 3 * PACKET_LENGTH || state.yellow_bytes != 0 ||
+     state.held_nbr != 2)
+  {
+    DEBUG(verbose, "Unexpected shaper state\n");
+    goto release_encap;
+  }
+
+  /* One second later, 1000 bytes were earned */
+  status = gse_encap_refill_shapers(encap, 1000000);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when refilling shapers (%s)\n",
+          status, gse_get_status(status));
+    goto release_encap;
+  }
+  status = gse_encap_fill_frame(encap, GSE_FILL_BEST_FIT, frame, FRAME_LENGTH,
+                                &data_length, &stats);
+  if(status != GSE_STATUS_OK || stats.packet_nbr != 1 ||
+     data_length != PACKET_LENGTH)
+  {
+    DEBUG(verbose, "Status %#.4x and %u packets instead of 1 (%s)\n",
+          status, stats.packet_nbr, gse_get_status(status));
+    goto release_encap;
+  }
+
+  is_failure = 0;
+
+release_encap:
+  gse_encap_release(encap);
+quit:
+  return is_failure;
+}
+
+/**
+ * @brief Check that the PDUs above their committed rate only fill the space
+ *        left by the other PDUs
+ *
+ * @param   verbose  Print debug if verbose is 1
+ * @return  0 on success, 1 on failure
+ */
+static int test_peak(int verbose)
+{
+  int is_failure = 1;
+  gse_encap_t *encap = NULL;
+  gse_shaper_conf_t conf = { 500, 500, 2000, 1500 };
+  gse_shaper_state_t state;
+  gse_status_t status;
+  unsigned char frame[FRAME_LENGTH];
+  size_t data_length;
+  /* The third PDU of QoS 0 is yellow, the PDUs of QoS 1 go before it */
+  const unsigned char patterns[] = { 0, 1, 3, 4, 2 };
+  unsigned int i;
+
+  status = gse_encap_init(QOS_NBR, FIFO_SIZE, &encap);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when initializing encapsulation (%s)\n",
+          status, gse_get_status(status));
+    goto quit;
+  }
+  status = gse_encap_set_qos_shaper(encap, 0, &conf);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when setting QoS shaper (%s)\n",
+          status, gse_get_status(status));
+    goto release_encap;
+  }
+  for(i = 0 ; i < 5 ; i++)
+  {
+    if(push_pdu(verbose, encap, i, (i < 3 ? 0 : 1)))
+    {
+      goto release_encap;
+    }
+  }
+
+  status = gse_encap_fill_frame(encap, GSE_FILL_BEST_FIT, frame, FRAME_LENGTH,
+                                &data_length, NULL);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when filling frame (%s)\n",
+          status, gse_get_status(status));
+    goto release_encap;
+  }
+  if(check_frame(verbose, frame, data_length, patterns, sizeof(patterns)))
+  {
+    goto release_encap;
+  }
+  status = gse_encap_get_qos_shaper_state(encap, 0, &state);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when getting shaper state (%s)\n",
+          status, gse_get_status(status));
+    goto release_encap;
+  }
+  if(state.green_bytes != 2 * PACKET_LENGTH ||
+     state.yellow_bytes != PACKET_LENGTH ||
+     state.committed_tokens != 500 - 2 * PACKET_LENGTH ||
+     state.peak_tokens != 1500 - 3 * PACKET_LENGTH)
+  {
+    DEBUG(verbose, "Unexpected shaper state\n");
+    goto release_encap;
+  }
+  status = gse_encap_get_qos_shaper_state(encap, 1, &state);
+  if(status != GSE_STATUS_NO_SHAPER)
+  {
+    DEBUG(verbose, "State of a QoS value without shaper\n");
+    goto release_encap;
+  }
+
+  is_failure = 0;
+
+release_encap:
+  gse_encap_release(encap);
+quit:
+  return is_failure;
+}
+
+/**
+ * @brief Check that a label which bursts at its peak rate is green again
+ *        once its committed rate is refilled
+ *
+ * @param   verbose  Print debug if verbose is 1
+ * @return  0 on success, 1 on failure
+ */
+static int test_peak_burst(int verbose)
+{
+  int is_failure = 1;
+  gse_encap_t *encap = NULL;
+  gse_shaper_conf_t conf = { 500, 500, 5000, 5000 };
+  gse_shaper_state_t state;
+  gse_frame_stats_t stats;
+  gse_status_t status;
+  uint8_t label[6] = { 0, 1, 2, 3, 4, 5 };
+  unsigned char frame[FRAME_LENGTH];
+  size_t data_length;
+  unsigned int i;
+
+  status = gse_encap_init(QOS_NBR, FIFO_SIZE, &encap);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when initializing encapsulation (%s)\n",
+          status, gse_get_status(status));
+    goto quit;
+  }
+  status = gse_encap_set_label_shaper(encap, label, LABEL_TYPE, &conf);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when setting label shaper (%s)\n",
+          status, gse_get_status(status));
+    goto release_encap;
+  }
+  status = gse_encap_refill_shapers(encap, 0);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when refilling shapers (%s)\n",
+          status, gse_get_status(status));
+    goto release_encap;
+  }
+  for(i = 0 ; i < 9 ; i++)
+  {
+    if(push_pdu(verbose, encap, i, 0))
+    {
+      goto release_encap;
+    }
+  }
+
+  /* The committed burst allows 2 green packets, the 7 other packets are
+   * sent within the peak burst */
+  status = gse_encap_fill_frame(encap, GSE_FILL_BEST_FIT, frame, FRAME_LENGTH,
+                                &data_length, &stats);
+  if(status != GSE_STATUS_OK || stats.packet_nbr != 9)
+  {
+    DEBUG(verbose, "Status %#.4x and %u packets instead of 9 (%s)\n",
+          status, stats.packet_nbr, gse_get_status(status));
+    goto release_encap;
+  }
+  status = gse_encap_get_label_shaper_state(encap, label, LABEL_TYPE, &state);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when getting shaper state (%s)\n",
+          status, gse_get_status(status));
+    goto release_encap;
+  }
+  DEBUG(verbose, "Committed tokens %lld, green %llu, yellow %llu\n",
+        (long long)state.committed_tokens,
+        (unsigned long long)state.green_bytes,
+        (unsigned long long)state.yellow_bytes);
+  if(state.committed_tokens != 500 - 2 * PACKET_LENGTH ||
+     state.green_bytes != 2 * PACKET_LENGTH ||
+     state.yellow_bytes != 7 * PACKET_LENGTH)
+  {
+    DEBUG(verbose, "Unexpected shaper state after the burst\n");
+    goto release_encap;
+  }
+
+  /* One second later, the yellow packets did not use the 500 bytes earned
+   * at the committed rate, the next packet is green */
+  if(push_pdu(verbose, encap, 9, 0))
+  {
+    goto release_encap;
+  }
+  status = gse_encap_refill_shapers(encap, 1000000);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when refilling shapers (%s)\n",
+          status, gse_get_status(status));
+    goto release_encap;
+  }
+  status = gse_encap_fill_frame(encap, GSE_FILL_BEST_FIT, frame, FRAME_LENGTH,
+                                &data_length, &stats);
+  if(status != GSE_STATUS_OK || data_length != PACKET_LENGTH)
+  {
+    DEBUG(verbose, "Status %#.4x and %zu bytes instead of %d (%s)\n",
+          status, data_length, PACKET_LENGTH, gse_get_status(status));
+    goto release_encap;
+  }
+  status = gse_encap_get_label_shaper_state(encap, label, LABEL_TYPE, &state);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when getting shaper state (%s)\n",
+          status, gse_get_status(status));
+    goto release_encap;
+  }
+  if(state.committed_tokens != 1000 - 3 * PACKET_LENGTH ||
+     state.green_bytes != 3 * PACKET_LENGTH ||
+     state.yellow_bytes != 7 * PACKET_LENGTH)
+  {
+    DEBUG(verbose, "Unexpected shaper state after the refill\n");
+    goto release_encap;
+  }
+
+  is_failure = 0;
+
+release_encap:
+  gse_encap_release(encap);
+quit:
+  return is_failure;
+}
+
+/**
+ * @brief Check that a held label does not block the other labels of its QoS
+ *        value when their PDUs are fragmented
+ *
+ * @param   verbose  Print debug if verbose is 1
+ * @return  0 on success, 1 on failure
+ */
+static int test_held_label(int verbose)
+{
+  int is_failure = 1;
+  gse_encap_t *encap = NULL;
+  gse_shaper_conf_t conf = { 100, HELD_PDU_LENGTH, 0, 0 };
+  gse_shaper_state_t state;
+  gse_status_t status;
+  uint8_t held_label[6] = { 0, 1, 2, 3, 4, 5 };
+  uint8_t free_label[6] = { 5, 4, 3, 2, 1, 0 };
+  unsigned char frame[SMALL_FRAME_LENGTH];
+  /* The PDU of the label without shaper is sent in 3 fragments */
+  const size_t lengths[] =
+  {
+    SMALL_FRAME_LENGTH,
+    SMALL_FRAME_LENGTH,
+    FREE_PDU_LENGTH + FIRST_FRAG_HEADER_LENGTH + 2 * SUBS_FRAG_HEADER_LENGTH +
+    CRC_LENGTH - 2 * SMALL_FRAME_LENGTH
+  };
+  size_t data_length;
+  unsigned int i;
+
+  status = gse_encap_init(QOS_NBR, FIFO_SIZE, &encap);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when initializing encapsulation (%s)\n",
+          status, gse_get_status(status));
+    goto quit;
+  }
+  status = gse_encap_set_label_shaper(encap, held_label, LABEL_TYPE, &conf);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when setting label shaper (%s)\n",
+          status, gse_get_status(status));
+    goto release_encap;
+  }
+  status = gse_encap_refill_shapers(encap, 0);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when refilling shapers (%s)\n",
+          status, gse_get_status(status));
+    goto release_encap;
+  }
+  for(i = 0 ; i < 2 ; i++)
+  {
+    if(push_label_pdu(verbose, encap, held_label, HELD_PDU_LENGTH, i, 0))
+    {
+      goto release_encap;
+    }
+  }
+
+  /* The burst only allows the first PDU of the shaped label */
+  status = gse_encap_fill_frame(encap, GSE_FILL_BEST_FIT, frame,
+                                SMALL_FRAME_LENGTH, &data_length, NULL);
+  if(status != GSE_STATUS_OK ||
+     data_length != HELD_PDU_LENGTH + HEADER_LENGTH ||
+     frame[HEADER_LENGTH] != 0)
+  {
+    DEBUG(verbose, "Status %#.4x and %zu bytes instead of the first PDU "
+          "(%s)\n", status, data_length, gse_get_status(status));
+    goto release_encap;
+  }
+
+  /* The second PDU of the shaped label is held, the PDU of the other label
+   * is fragmented behind it */
+  if(push_label_pdu(verbose, encap, free_label, FREE_PDU_LENGTH, 2, 0))
+  {
+    goto release_encap;
+  }
+  for(i = 0 ; i < 3 ; i++)
+  {
+    status = gse_encap_fill_frame(encap, GSE_FILL_BEST_FIT, frame,
+                                  SMALL_FRAME_LENGTH, &data_length, NULL);
+    if(status != GSE_STATUS_OK || data_length != lengths[i])
+    {
+      DEBUG(verbose, "Status %#.4x and %zu bytes instead of %zu in frame %u "
+            "(%s)\n", status, data_length, lengths[i], i + 1,
+            gse_get_status(status));
+      goto release_encap;
+    }
+    if(frame[i == 0 ? FIRST_FRAG_HEADER_LENGTH : SUBS_FRAG_HEADER_LENGTH] != 2)
+    {
+      DEBUG(verbose, "Frame %u does not carry the PDU of the other label\n",
+            i + 1);
+      goto release_encap;
+    }
+  }
+
+  /* Only the held PDU is left */
+  status = gse_encap_fill_frame(encap, GSE_FILL_BEST_FIT, frame,
+                                SMALL_FRAME_LENGTH, &data_length, NULL);
+  if(status != GSE_STATUS_RATE_LIMITED || data_length != 0)
+  {
+    DEBUG(verbose, "Status %#.4x instead of rate limitation (%s)\n",
+          status, gse_get_status(status));
+    goto release_encap;
+  }
+
+  /* The second PDU of the shaped label was held in the 5 frames */
+  status = gse_encap_get_label_shaper_state(encap, held_label, LABEL_TYPE,
+                                            &state);
+  if(status != GSE_STATUS_OK || state.held_nbr != 5)
+  {
+    DEBUG(verbose, "Status %#.4x and PDU held %llu times instead of 5 (%s)\n",
+          status, (unsigned long long)state.held_nbr,
+          gse_get_status(status));
+    goto release_encap;
+  }
+
+  is_failure = 0;
+
+release_encap:
+  gse_encap_release(encap);
+quit:
+  return is_failure;
+}
+
+/**
+ * @brief Check the shaper configuration errors
+ *
+ * @param   verbose  Print debug if verbose is 1
+ * @return  0 on success, 1 on failure
+ */
+static int test_config(int verbose)
+{
+  int is_failure = 1;
+  gse_encap_t *encap = NULL;
+  gse_shaper_conf_t no_burst = { 1000, 0, 0, 0 };
+  gse_shaper_conf_t low_peak = { 1000, 1000, 500, 1000 };
+  gse_shaper_conf_t conf = { 1000, 1000, 0, 0 };
+  gse_status_t status;
+  uint8_t label[6] = { 0, 1, 2, 3, 4, 5 };
+
+  status = gse_encap_init(QOS_NBR, FIFO_SIZE, &encap);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when initializing encapsulation (%s)\n",
+          status, gse_get_status(status));
+    goto quit;
+  }
+  if(gse_encap_set_qos_shaper(encap, 0, &no_burst) !=
+     GSE_STATUS_INVALID_SHAPER ||
+     gse_encap_set_label_shaper(encap, label, LABEL_TYPE, &low_peak) !=
+     GSE_STATUS_INVALID_SHAPER)
+  {
+    DEBUG(verbose, "Invalid shaper accepted\n");
+    goto release_encap;
+  }
+  if(gse_encap_set_qos_shaper(encap, QOS_NBR, &conf) !=
+     GSE_STATUS_INVALID_QOS)
+  {
+    DEBUG(verbose, "Shaper accepted for an invalid QoS value\n");
+    goto release_encap;
+  }
+  if(gse_encap_set_qos_shaper(encap, 0, NULL) != GSE_STATUS_NO_SHAPER ||
+     gse_encap_set_label_shaper(encap, label, LABEL_TYPE, NULL) !=
+     GSE_STATUS_NO_SHAPER)
+  {
+    DEBUG(verbose, "Unknown shaper removed\n");
+    goto release_encap;
+  }
+  if(gse_encap_set_label_shaper(encap, label, LABEL_TYPE, &conf) !=
+     GSE_STATUS_OK ||
+     gse_encap_set_label_shaper(encap, label, LABEL_TYPE, NULL) !=
+     GSE_STATUS_OK ||
+     gse_encap_set_label_shaper(encap, label, LABEL_TYPE, NULL) !=
+     GSE_STATUS_NO_SHAPER)
+  {
+    DEBUG(verbose, "Label shaper not removed\n");
+    goto release_encap;
+  }
+
+  is_failure = 0;
+
+release_encap:
+  gse_encap_release(encap);
+quit:
+  return is_failure;
+}
+
+/**
+ * @brief Create a PDU filled with a pattern and give it to the encapsulation
+ *
+ * @param   verbose  Print debug if verbose is 1
+ * @param   encap    The encapsulation structure
+ * @param   pattern  The byte used to fill the PDU
+ * @param   qos      The QoS of the PDU
+ * @return  0 on success, 1 on failure
+ */
+static int push_pdu(int verbose, gse_encap_t *encap, unsigned char pattern,
+                    uint8_t qos)
+{
+  uint8_t label[6] = { 0, 1, 2, 3, 4, 5 };
+
+  return push_label_pdu(verbose, encap, label, PDU_LENGTH, pattern, qos);
+}
+
+/**
+ * @brief Create a PDU of a label filled with a pattern and give it to the
+ *        encapsulation
+ *
+ * @param   verbose  Print debug if verbose is 1
+ * @param   encap    The encapsulation structure
+ * @param   label    The label of the PDU
+ * @param   length   The length of the PDU
+ * @param   pattern  The byte used to fill the PDU
+ * @param   qos      The QoS of the PDU
+ * @return  0 on success, 1 on failure
+ */
+static int push_label_pdu(int verbose, gse_encap_t *encap, uint8_t label[6],
+                          size_t length, unsigned char pattern, uint8_t qos)
+{
+  gse_vfrag_t *pdu;
+  gse_status_t status;
+
+  status = gse_create_vfrag(&pdu, length, GSE_MAX_HEADER_LENGTH,
+                            GSE_MAX_TRAILER_LENGTH);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when creating PDU (%s)\n",
+          status, gse_get_status(status));
+    return 1;
+  }
+  memset(pdu->start, pattern, length);
+  status = gse_encap_receive_pdu(pdu, encap, label, LABEL_TYPE, PROTOCOL, qos);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when receiving PDU (%s)\n",
+          status, gse_get_status(status));
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * @brief Check the order of the complete PDUs of a frame
+ *
+ * @param   verbose   Print debug if verbose is 1
+ * @param   frame     The frame
+ * @param   length    The length of the GSE packets in the frame
+ * @param   patterns  The expected patterns of the PDUs
+ * @param   nbr       The expected number of PDUs
+ * @return  0 on success, 1 on failure
+ */
+static int check_frame(int verbose, unsigned char *frame, size_t length,
+                       const unsigned char *patterns, unsigned int nbr)
+{
+  size_t offset = 0;
+  unsigned int i;
+
+  for(i = 0 ; i < nbr ; i++)
+  {
+    if(offset + PACKET_LENGTH > length ||
+       frame[offset + HEADER_LENGTH] != patterns[i])
+    {
+      DEBUG(verbose, "PDU %u is not the expected one\n", i);
+      return 1;
+    }
+    DEBUG(verbose, "PDU %u in position %u\n", patterns[i], i);
+    offset += PACKET_LENGTH;
+  }
+  if(offset != length)
+  {
+    DEBUG(verbose, "Unexpected data at the end of the frame\n");
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,590 @@
+/*
+ *
+ * This piece of software is an implementation of the Generic Stream
+ * Encapsulation (GSE) standard defined by ETSI for Linux (or other
+ * Unix-compatible OS). The library may be used to add GSE
+ * encapsulation/de-encapsulation capabilities to an application.
+ *
+ *
+ * Copyright © 2016 TAS
+ *
+ *
+ * This file is part of the GSE library.
+ *
+ *
+ * The GSE library is free software : you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY, without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see http://www.gnu.org/licenses/.
+ *
+ */
+
+/****************************************************************************/
+/**
+ *   @file          test_encap_shm.c
+ *
+ *          Project:     GSE LIBRARY
+ *
+ *          Company:     THALES ALENIA SPACE
+ *
+ *          Module name: ENCAP
+ *
+ *   @brief         Queue of PDUs shared with another process
+ *
+ *   @author        Julien BERNARD / Viveris Technologies
+ *
+ */
+/****************************************************************************/
+
+/****************************************************************************
+ *
+ *   INCLUDES
+ *
+ *****************************************************************************/
+
+/* system includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+/* GSE includes */
+#include "encap.h"
+#include "encap_shm.h"
+#include "deencap.h"
+
+/****************************************************************************
+ *
+ *   MACROS AND CONSTANTS
+ *
+ *****************************************************************************/
+
+/** The number of QoS values */
+#define QOS_NBR 2
+/** The size of the FIFOs */
+#define FIFO_SIZE 4
+/** The number of slots of the shared queue, below the number of PDUs so
+ *  that the slots are reused */
+#define SLOT_NBR 8
+/** The maximum length of the PDUs */
+#define MAX_PDU_LENGTH 1000
+/** The number of PDUs sent by the producer */
+#define PDU_NBR 200
+/** The length of the first PDU, the next ones are longer */
+#define PDU_LENGTH 100
+/** The type of label carried by the GSE packets */
+#define LABEL_TYPE 0x0
+/** The protocol carried by the GSE packets */
+#define PROTOCOL 0x2345
+/** The number of receptions without PDU before giving up */
+#define MAX_IDLE_NBR 100000
+
+/* DEBUG macro */
+#define DEBUG(verbose, format, ...) \
+  do { \
+    if(verbose) \
+      printf(format, ##__VA_ARGS__); \
+  } while(0)
+
+/** The offset of the PDU in its slot, the slot description is at the
+ *  beginning of the slot (version 1 of the segment) */
+#define SLOT_PDU_OFFSET 64
+
+/** The label of the PDUs */
+static uint8_t label[6] = { 0, 1, 2, 3, 4, 5 };
+
+/** The slot description of the version 1 of the segment, overwritten as a
+ *  faulty producer would do */
+typedef struct
+{
+  uint32_t length;
+  uint32_t flow_key;
+  uint16_t protocol;
+  uint8_t label_type;
+  uint8_t qos;
+  uint8_t label[6];
+} slot_t;
+
+/****************************************************************************
+ *
+ *   PROTOTYPES OF PRIVATE FUNCTIONS
+ *
+ *****************************************************************************/
+
+static int test_shm(int verbose);
+static int test_corrupted(int verbose);
+static int produce(int verbose, int fd);
+static int consume(int verbose, gse_encap_shm_t *shm);
+static int get_packet(int verbose, gse_encap_t *encap,
+                      gse_deencap_t *deencap, uint8_t qos,
+                      unsigned int *next);
+
+/****************************************************************************
+ *
+ *   PUBLIC FUNCTIONS
+ *
+ *****************************************************************************/
+
+/**
+ * @brief Main function for the GSE shared memory queue test program
+ *
+ * @param argc  the number of program arguments
+ * @param argv  the program arguments
+ * @return      the unix return code:
+ *               \li 0 in case of success,
+ *               \li 1 in case of failure
+ */
+int main(int argc, char *argv[])
+{
+  int res = 1;
+  int verbose = 0;
+
+  if(argc > 2 || argc < 1)
+  {
+    printf("USAGE : test_encap_shm [verbose]\n");
+  }
+  else
+  {
+    if(argc == 2)
+    {
+      if(!strcmp(argv[1], "verbose"))
+      {
+        verbose = 1;
+      }
+      else
+      {
+        printf("USAGE : test_encap_shm [verbose]\n");
+        goto quit;
+      }
+    }
+    res = test_shm(verbose);
+    if(res != 0)
+    {
+      goto quit;
+    }
+    res = test_corrupted(verbose);
+  }
+
+quit:
+  return res;
+}
+
+/****************************************************************************
+ *
+ *   PRIVATE FUNCTIONS
+ *
+ *****************************************************************************/
+
+/**
+ * @brief Send PDUs from a child process and encapsulate them in the parent
+ *
+ * @param   verbose  Print debug if verbose is 1
+ * @return  0 on success, 1 on failure
+ */
+static int test_shm(int verbose)
+{
+  int is_failure = 1;
+  gse_encap_shm_t *shm = NULL;
+  gse_status_t status;
+  pid_t pid;
+  int child_status;
+  unsigned int slot_nbr;
+  unsigned int free_nbr;
+
+  status = gse_encap_shm_create(QOS_NBR, SLOT_NBR, GSE_MAX_PDU_LENGTH + 1,
+                                &shm);
+  if(status != GSE_STATUS_PDU_LENGTH)
+  {
+    DEBUG(verbose, "Shared queue created with too long PDUs\n");
+    goto quit;
+  }
+  status = gse_encap_shm_create(QOS_NBR, SLOT_NBR, MAX_PDU_LENGTH, &shm);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when creating the shared queue (%s)\n",
+          status, gse_get_status(status));
+    goto quit;
+  }
+
+  pid = fork();
+  if(pid < 0)
+  {
+    DEBUG(verbose, "Cannot create the producer\n");
+    goto release;
+  }
+  if(pid == 0)
+  {
+    /* The producer maps the segment on its own from the file descriptor */
+    exit(produce(verbose, dup(gse_encap_shm_get_fd(shm))));
+  }
+
+  if(consume(verbose, shm))
+  {
+    waitpid(pid, &child_status, 0);
+    goto release;
+  }
+  if(waitpid(pid, &child_status, 0) != pid ||
+     !WIFEXITED(child_status) || WEXITSTATUS(child_status) != 0)
+  {
+    DEBUG(verbose, "The producer failed\n");
+    goto release;
+  }
+
+  /* All the slots are given back once the packets are built */
+  status = gse_encap_shm_get_usage(shm, &slot_nbr, &free_nbr);
+  if(status != GSE_STATUS_OK || slot_nbr != SLOT_NBR ||
+     free_nbr != SLOT_NBR)
+  {
+    DEBUG(verbose, "%u free slots out of %u instead of %u\n",
+          free_nbr, slot_nbr, SLOT_NBR);
+    goto release;
+  }
+  DEBUG(verbose, "%u PDUs received from the producer\n", PDU_NBR);
+
+  is_failure = 0;
+
+release:
+  status = gse_encap_shm_release(shm);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when releasing the shared queue (%s)\n",
+          status, gse_get_status(status));
+    is_failure = 1;
+  }
+quit:
+  return is_failure;
+}
+
+/**
+ * @brief Check that the PDUs whose slot description is corrupted once
+ *        queued are dropped and their slots given back
+ *
+ * @param   verbose  Print debug if verbose is 1
+ * @return  0 on success, 1 on failure
+ */
+static int test_corrupted(int verbose)
+{
+  int is_failure = 1;
+  gse_encap_shm_t *shm = NULL;
+  gse_encap_t *encap = NULL;
+  gse_status_t status;
+  gse_status_t expected;
+  unsigned char *data;
+  slot_t *slot;
+  size_t max_length;
+  uint32_t handle;
+  unsigned int pdu_nbr;
+  unsigned int slot_nbr;
+  unsigned int free_nbr;
+  unsigned int i;
+
+  status = gse_encap_shm_create(QOS_NBR, SLOT_NBR, MAX_PDU_LENGTH, &shm);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when creating the shared queue (%s)\n",
+          status, gse_get_status(status));
+    goto quit;
+  }
+  status = gse_encap_init(QOS_NBR, FIFO_SIZE, &encap);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when initializing encapsulation (%s)\n",
+          status, gse_get_status(status));
+    goto release;
+  }
+
+  /* The length, the QoS value then the label type are corrupted, the last
+   * PDU is valid */
+  for(i = 0 ; i < 4 ; i++)
+  {
+    status = gse_encap_shm_alloc_pdu(shm, &handle, &data, &max_length);
+    if(status != GSE_STATUS_OK)
+    {
+      DEBUG(verbose, "Error %#.4x when allocating PDU (%s)\n",
+            status, gse_get_status(status));
+      goto release_encap;
+    }
+    memset(data, i, PDU_LENGTH);
+    status = gse_encap_shm_push_pdu(shm, handle, PDU_LENGTH, label,
+                                    LABEL_TYPE, PROTOCOL, 0, 0);
+    if(status != GSE_STATUS_OK)
+    {
+      DEBUG(verbose, "Error %#.4x when pushing PDU (%s)\n",
+            status, gse_get_status(status));
+      goto release_encap;
+    }
+    slot = (slot_t *)(data - SLOT_PDU_OFFSET);
+    switch(i)
+    {
+      case 0:
+        slot->length = max_length + 1000;
+        expected = GSE_STATUS_PDU_LENGTH;
+        break;
+      case 1:
+        slot->qos = QOS_NBR;
+        expected = GSE_STATUS_INVALID_QOS;
+        break;
+      case 2:
+        slot->label_type = 0xFF;
+        expected = GSE_STATUS_INVALID_LT;
+        break;
+      default:
+        expected = GSE_STATUS_OK;
+        break;
+    }
+
+    status = gse_encap_shm_receive(shm, encap, 1, &pdu_nbr);
+    if(status != expected || pdu_nbr != (expected == GSE_STATUS_OK ? 1 : 0))
+    {
+      DEBUG(verbose, "Status %#.4x and %u PDUs for PDU %u, expected "
+            "%#.4x (%s)\n", status, pdu_nbr, i, expected,
+            gse_get_status(status));
+      goto release_encap;
+    }
+  }
+
+  /* Only the slot of the valid PDU is still used */
+  status = gse_encap_shm_get_usage(shm, &slot_nbr, &free_nbr);
+  if(status != GSE_STATUS_OK || free_nbr != SLOT_NBR - 1)
+  {
+    DEBUG(verbose, "%u free slots instead of %u\n", free_nbr,
+          SLOT_NBR - 1);
+    goto release_encap;
+  }
+
+  is_failure = 0;
+
+release_encap:
+  gse_encap_release(encap);
+release:
+  status = gse_encap_shm_release(shm);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when releasing the shared queue (%s)\n",
+          status, gse_get_status(status));
+    is_failure = 1;
+  }
+quit:
+  return is_failure;
+}
+
+/**
+ * @brief Write PDUs in the shared queue, the PDU i is filled with i and
+ *        sent on the QoS value i % QOS_NBR
+ *
+ * @param   verbose  Print debug if verbose is 1
+ * @param   fd       The file descriptor of the segment
+ * @return  0 on success, 1 on failure
+ */
+static int produce(int verbose, int fd)
+{
+  int is_failure = 1;
+  gse_encap_shm_t *shm;
+  gse_status_t status;
+  unsigned char *data;
+  size_t max_length;
+  uint32_t handle;
+  unsigned int i;
+
+  status = gse_encap_shm_attach(fd, &shm);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when attaching the shared queue (%s)\n",
+          status, gse_get_status(status));
+    goto quit;
+  }
+
+  for(i = 0 ; i < PDU_NBR ; i++)
+  {
+    /* Wait for the consumer to give slots back */
+    do
+    {
+      status = gse_encap_shm_alloc_pdu(shm, &handle, &data, &max_length);
+      if(status == GSE_STATUS_FIFO_FULL)
+      {
+        usleep(100);
+      }
+    }
+    while(status == GSE_STATUS_FIFO_FULL);
+    if(status != GSE_STATUS_OK || max_length != MAX_PDU_LENGTH)
+    {
+      DEBUG(verbose, "Error %#.4x when allocating PDU (%s)\n",
+            status, gse_get_status(status));
+      goto release;
+    }
+    memset(data, i & 0xFF, PDU_LENGTH + i);
+    status = gse_encap_shm_push_pdu(shm, handle, PDU_LENGTH + i, label,
+                                    LABEL_TYPE, PROTOCOL, i % QOS_NBR, 0);
+    if(status != GSE_STATUS_OK)
+    {
+      DEBUG(verbose, "Error %#.4x when pushing PDU (%s)\n",
+            status, gse_get_status(status));
+      goto release;
+    }
+  }
+
+  is_failure = 0;
+
+release:
+  gse_encap_shm_release(shm);
+quit:
+  return is_failure;
+}
+
+/**
+ * @brief Encapsulate the PDUs of the shared queue and check them
+ *
+ * @param   verbose  Print debug if verbose is 1
+ * @param   shm      The shared memory queue
+ * @return  0 on success, 1 on failure
+ */
+static int consume(int verbose, gse_encap_shm_t *shm)
+{
+  int is_failure = 1;
+  gse_encap_t *encap;
+  gse_deencap_t *deencap;
+  gse_status_t status;
+  unsigned int next[QOS_NBR];
+  unsigned int idle_nbr = 0;
+  unsigned int pdu_nbr;
+  uint8_t qos;
+
+  status = gse_encap_init(QOS_NBR, FIFO_SIZE, &encap);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when initializing encapsulation (%s)\n",
+          status, gse_get_status(status));
+    goto quit;
+  }
+  status = gse_deencap_init(QOS_NBR, &deencap);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when initializing deencapsulation (%s)\n",
+          status, gse_get_status(status));
+    goto release_encap;
+  }
+
+  for(qos = 0 ; qos < QOS_NBR ; qos++)
+  {
+    next[qos] = qos;
+  }
+  while(next[0] < PDU_NBR || next[1] < PDU_NBR)
+  {
+    /* One PDU at a time so that the FIFOs are never full */
+    status = gse_encap_shm_receive(shm, encap, 1, &pdu_nbr);
+    if(status != GSE_STATUS_OK)
+    {
+      DEBUG(verbose, "Error %#.4x when receiving from the shared queue "
+            "(%s)\n", status, gse_get_status(status));
+      goto release_deencap;
+    }
+    if(pdu_nbr == 0)
+    {
+      if(++idle_nbr > MAX_IDLE_NBR)
+      {
+        DEBUG(verbose, "No PDU from the producer\n");
+        goto release_deencap;
+      }
+      usleep(10);
+      continue;
+    }
+    idle_nbr = 0;
+    for(qos = 0 ; qos < QOS_NBR ; qos++)
+    {
+      if(get_packet(verbose, encap, deencap, qos, &next[qos]))
+      {
+        goto release_deencap;
+      }
+    }
+  }
+
+  is_failure = 0;
+
+release_deencap:
+  gse_deencap_release(deencap);
+release_encap:
+  /* The PDUs left in the FIFOs give their slots back */
+  gse_encap_release(encap);
+quit:
+  return is_failure;
+}
+
+/**
+ * @brief Get the GSE packet of a QoS value, if any, and check its PDU
+ *
+ * @param   verbose  Print debug if verbose is 1
+ * @param   encap    The encapsulation context
+ * @param   deencap  The deencapsulation context
+ * @param   qos      The QoS value
+ * @param   next     IN/OUT: The index of the next expected PDU
+ * @return  0 on success, 1 on failure
+ */
+static int get_packet(int verbose, gse_encap_t *encap,
+                      gse_deencap_t *deencap, uint8_t qos,
+                      unsigned int *next)
+{
+  int is_failure = 1;
+  gse_vfrag_t *packet;
+  gse_vfrag_t *pdu = NULL;
+  gse_status_t status;
+  uint8_t label_type;
+  uint8_t rcv_label[6];
+  uint16_t protocol;
+  uint16_t packet_length;
+  unsigned int i;
+
+  status = gse_encap_get_packet_copy(&packet, encap, 0, qos);
+  if(status == GSE_STATUS_FIFO_EMPTY)
+  {
+    return 0;
+  }
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when getting a packet (%s)\n",
+          status, gse_get_status(status));
+    goto quit;
+  }
+
+  /* The packet is destroyed by the deencapsulation */
+  status = gse_deencap_packet(packet, deencap, &label_type, rcv_label,
+                              &protocol, &pdu, &packet_length);
+  if(status != GSE_STATUS_PDU_RECEIVED)
+  {
+    DEBUG(verbose, "Error %#.4x when deencapsulating packet (%s)\n",
+          status, gse_get_status(status));
+    goto quit;
+  }
+  if(protocol != PROTOCOL || memcmp(rcv_label, label, 6) != 0 ||
+     pdu->length != PDU_LENGTH + *next)
+  {
+    DEBUG(verbose, "PDU %u received with wrong fields\n", *next);
+    goto free_pdu;
+  }
+  for(i = 0 ; i < pdu->length ; i++)
+  {
+    if(pdu->start[i] != (*next & 0xFF))
+    {
+      DEBUG(verbose, "PDU %u received with wrong data\n", *next);
+      goto free_pdu;
+    }
+  }
+  *next += QOS_NBR;
+
+  is_failure = 0;
+
+free_pdu:
+  gse_free_vfrag(&pdu);
+quit:
+  return is_failure;
+}
@@ -0,0 +1,735 @@
+/*
+ *
+ * This piece of software is an implementation of the Generic Stream
+ * Encapsulation (GSE) standard defined by ETSI for Linux (or other
+ * Unix-compatible OS). The library may be used to add GSE
+ * encapsulation/de-encapsulation capabilities to an application.
+ *
+ *
+ * Copyright © 2016 TAS
+ *
+ *
+ * This file is part of the GSE library.
+ *
+ *
+ * The GSE library is free software : you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY, without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see http://www.gnu.org/licenses/.
+ *
+ */
+
+/****************************************************************************/
+/**
+ *   @file          test_encap_stream.c
+ *
+ *          Project:     GSE LIBRARY
+ *
+ *          Company:     THALES ALENIA SPACE
+ *
+ *          Module name: ENCAP
+ *
+ *   @brief         Encapsulation of PDUs received in chunks
+ *
+ *   @author        Julien BERNARD / Viveris Technologies
+ *
+ */
+/****************************************************************************/
+
+/****************************************************************************
+ *
+ *   INCLUDES
+ *
+ *****************************************************************************/
+
+/* system includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+/* GSE includes */
+#include "encap.h"
+#include "deencap.h"
+
+/****************************************************************************
+ *
+ *   MACROS AND CONSTANTS
+ *
+ *****************************************************************************/
+
+/** The number of FIFOs */
+#define QOS_NBR 2
+/** The size of the FIFOs */
+#define FIFO_SIZE 8
+/** The number of FragID values in the pool */
+#define FRAG_ID_NBR 4
+/** The number of PDUs considered for each GSE packet */
+#define WINDOW 3
+/** The length of the GSE packets */
+#define PACKET_LENGTH 400
+/** The length of the PDU received in chunks */
+#define STREAM_LENGTH 3000
+/** The type of label carried by the GSE packets */
+#define LABEL_TYPE 0x0
+/** The protocol carried by the GSE packets */
+#define PROTOCOL 0x2345
+/** The length of the frames */
+#define FRAME_LENGTH 1000
+
+/* DEBUG macro */
+#define DEBUG(verbose, format, ...) \
+  do { \
+    if(verbose) \
+      printf(format, ##__VA_ARGS__); \
+  } while(0)
+
+/** The chunks in which the PDU is received */
+static const size_t chunk_length[] = { 1000, 1500, 500 };
+
+/****************************************************************************
+ *
+ *   PROTOTYPES OF PRIVATE FUNCTIONS
+ *
+ *****************************************************************************/
+
+static int test_cut_through(int verbose);
+static int test_pool(int verbose);
+static int test_abort(int verbose);
+static int get_packets(int verbose, gse_encap_t *encap, gse_deencap_t *deencap,
+                       uint8_t qos, unsigned char *data, size_t data_length,
+                       unsigned int *packet_nbr, int *received,
+                       gse_status_t *end_status);
+static int push_pdu(int verbose, gse_encap_t *encap, size_t length,
+                    unsigned char pattern, uint8_t qos);
+
+/****************************************************************************
+ *
+ *   PUBLIC FUNCTIONS
+ *
+ *****************************************************************************/
+
+/**
+ * @brief Main function for the GSE stream encapsulation test program
+ *
+ * @param argc  the number of program arguments
+ * @param argv  the program arguments
+ * @return      the unix return code:
+ *               \li 0 in case of success,
+ *               \li 1 in case of failure
+ */
+int main(int argc, char *argv[])
+{
+  int res = 1;
+  int verbose = 0;
+
+  if(argc > 2 || argc < 1)
+  {
+    printf("USAGE : test_encap_stream [verbose]\n");
+  }
+  else
+  {
+    if(argc == 2)
+    {
+      if(!strcmp(argv[1], "verbose"))
+      {
+        verbose = 1;
+      }
+      else
+      {
+        printf("USAGE : test_encap_stream [verbose]\n");
+        goto quit;
+      }
+    }
+    res = test_cut_through(verbose);
+    if(res == 0)
+    {
+      res = test_pool(verbose);
+    }
+    if(res == 0)
+    {
+      res = test_abort(verbose);
+    }
+  }
+
+quit:
+  return res;
+}
+
+/****************************************************************************
+ *
+ *   PRIVATE FUNCTIONS
+ *
+ *****************************************************************************/
+
+/**
+ * @brief Append a PDU in chunks, check that its fragments are sent before
+ *        its end is received and that it is correctly deencapsulated
+ *
+ * @param   verbose  Print debug if verbose is 1
+ * @return  0 on success, 1 on failure
+ */
+static int test_cut_through(int verbose)
+{
+  int is_failure = 1;
+  gse_encap_t *encap = NULL;
+  gse_deencap_t *deencap = NULL;
+  gse_encap_stream_t *stream = NULL;
+  gse_status_t status;
+  unsigned char data[STREAM_LENGTH];
+  uint8_t label[6] = { 0, 1, 2, 3, 4, 5 };
+  unsigned int packet_nbr = 0;
+  size_t offset = 0;
+  unsigned int i;
+  int received = 0;
+
+  for(i = 0 ; i < STREAM_LENGTH ; i++)
+  {
+    data[i] = i % 251;
+  }
+
+  status = gse_encap_init(QOS_NBR, FIFO_SIZE, &encap);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when initializing encapsulation (%s)\n",
+          status, gse_get_status(status));
+    goto quit;
+  }
+  status = gse_deencap_init(QOS_NBR, &deencap);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when initializing deencapsulation (%s)\n",
+          status, gse_get_status(status));
+    goto release_encap;
+  }
+
+  status = gse_encap_open_pdu(encap, 0, label, LABEL_TYPE, PROTOCOL, 0, 0,
+                              &stream);
+  if(status != GSE_STATUS_BUFF_LENGTH_NULL || stream != NULL)
+  {
+    DEBUG(verbose, "An empty PDU should be refused\n");
+    goto release_deencap;
+  }
+  status = gse_encap_open_pdu(encap, STREAM_LENGTH, label, LABEL_TYPE,
+                              PROTOCOL, 0, 0, &stream);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when opening PDU (%s)\n",
+          status, gse_get_status(status));
+    goto release_deencap;
+  }
+
+  /* Nothing can be sent before the first chunk */
+  if(get_packets(verbose, encap, deencap, 0, data, STREAM_LENGTH, &packet_nbr,
+                 &received, &status))
+  {
+    goto abort;
+  }
+  if(status != GSE_STATUS_PDU_NOT_READY || packet_nbr != 0)
+  {
+    DEBUG(verbose, "Status %#.4x instead of PDU not ready (%s)\n",
+          status, gse_get_status(status));
+    goto abort;
+  }
+
+  for(i = 0 ; i < sizeof(chunk_length) / sizeof(chunk_length[0]) ; i++)
+  {
+    /* The last chunk is too long by one byte before being appended */
+    if(offset + chunk_length[i] == STREAM_LENGTH)
+    {
+      status = gse_encap_append_pdu(stream, data + offset,
+                                    chunk_length[i] + 1);
+      if(status != GSE_STATUS_DATA_TOO_LONG)
+      {
+        DEBUG(verbose, "Data longer than the PDU should be refused\n");
+        goto abort;
+      }
+    }
+    status = gse_encap_append_pdu(stream, data + offset, chunk_length[i]);
+    if(status != GSE_STATUS_OK)
+    {
+      DEBUG(verbose, "Error %#.4x when appending chunk (%s)\n",
+            status, gse_get_status(status));
+      goto abort;
+    }
+    offset += chunk_length[i];
+    if(get_packets(verbose, encap, deencap, 0, data, STREAM_LENGTH,
+                   &packet_nbr, &received, &status))
+    {
+      goto release_deencap;
+    }
+    DEBUG(verbose, "%u packets sent after %zu bytes\n", packet_nbr, offset);
+    /* The data already received is sent before the end of the PDU */
+    if(offset < STREAM_LENGTH &&
+       (status != GSE_STATUS_PDU_NOT_READY ||
+        packet_nbr < (offset + PACKET_LENGTH - 1) / PACKET_LENGTH))
+    {
+      DEBUG(verbose, "Status %#.4x after %u packets (%s)\n",
+            status, packet_nbr, gse_get_status(status));
+      goto abort;
+    }
+  }
+  if(status != GSE_STATUS_FIFO_EMPTY || !received)
+  {
+    DEBUG(verbose, "PDU not received\n");
+    goto release_deencap;
+  }
+
+  is_failure = 0;
+  goto release_deencap;
+
+abort:
+  gse_encap_abort_pdu(stream);
+release_deencap:
+  gse_deencap_release(deencap);
+release_encap:
+  gse_encap_release(encap);
+quit:
+  return is_failure;
+}
+
+/**
+ * @brief Check that the other PDUs of a FIFO are sent while a PDU waits for
+ *        its data with a FragID pool
+ *
+ * @param   verbose  Print debug if verbose is 1
+ * @return  0 on success, 1 on failure
+ */
+static int test_pool(int verbose)
+{
+  int is_failure = 1;
+  gse_encap_t *encap = NULL;
+  gse_deencap_t *deencap = NULL;
+  gse_encap_stream_t *stream = NULL;
+  gse_vfrag_t *packet = NULL;
+  gse_status_t status;
+  unsigned char data[STREAM_LENGTH];
+  unsigned char frame[FRAME_LENGTH];
+  uint8_t label[6] = { 0, 1, 2, 3, 4, 5 };
+  unsigned int packet_nbr = 0;
+  size_t data_length;
+  unsigned int i;
+  int received = 0;
+
+  for(i = 0 ; i < STREAM_LENGTH ; i++)
+  {
+    data[i] = (i * 7) % 253;
+  }
+
+  status = gse_encap_init(QOS_NBR, FIFO_SIZE, &encap);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when initializing encapsulation (%s)\n",
+          status, gse_get_status(status));
+    goto quit;
+  }
+  status = gse_deencap_init(FRAG_ID_NBR, &deencap);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when initializing deencapsulation (%s)\n",
+          status, gse_get_status(status));
+    goto release_encap;
+  }
+  status = gse_encap_set_frag_id_pool(encap, FRAG_ID_NBR, WINDOW);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when enabling FragID pool (%s)\n",
+          status, gse_get_status(status));
+    goto release_deencap;
+  }
+
+  /* A PDU completely received before its first packet is sent as usual */
+  status = gse_encap_open_pdu(encap, PACKET_LENGTH / 2, label, LABEL_TYPE,
+                              PROTOCOL, 0, 0, &stream);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when opening PDU (%s)\n",
+          status, gse_get_status(status));
+    goto release_deencap;
+  }
+  status = gse_encap_append_pdu(stream, data, PACKET_LENGTH / 2);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when appending chunk (%s)\n",
+          status, gse_get_status(status));
+    goto abort;
+  }
+  status = gse_encap_get_packet_copy(&packet, encap, 0, 0);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when getting packet (%s)\n",
+          status, gse_get_status(status));
+    goto release_deencap;
+  }
+  if(((packet->start[0] >> 6) & 0x3) != 0x3)
+  {
+    DEBUG(verbose, "Complete PDU sent in several packets\n");
+    goto free_packet;
+  }
+  gse_free_vfrag(&packet);
+
+  /* A PDU waiting for data does not block the PDU queued behind it */
+  status = gse_encap_open_pdu(encap, STREAM_LENGTH, label, LABEL_TYPE,
+                              PROTOCOL, 0, 0, &stream);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when opening PDU (%s)\n",
+          status, gse_get_status(status));
+    goto release_deencap;
+  }
+  if(push_pdu(verbose, encap, 100, 0xAA, 0))
+  {
+    goto abort;
+  }
+  status = gse_encap_get_packet_copy(&packet, encap, 0, 0);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when getting packet (%s)\n",
+          status, gse_get_status(status));
+    goto abort;
+  }
+  if(((packet->start[0] >> 6) & 0x3) != 0x3 || packet->start[10] != 0xAA)
+  {
+    DEBUG(verbose, "The PDU behind the stream was not sent\n");
+    goto free_packet;
+  }
+  gse_free_vfrag(&packet);
+
+  /* Frames are not filled while the data is missing */
+  status = gse_encap_fill_frame(encap, GSE_FILL_BEST_FIT, frame, FRAME_LENGTH,
+                                &data_length, NULL);
+  if(status != GSE_STATUS_PDU_NOT_READY || data_length != 0)
+  {
+    DEBUG(verbose, "Status %#.4x instead of PDU not ready (%s)\n",
+          status, gse_get_status(status));
+    goto abort;
+  }
+
+  /* The first chunk is sent in the frame */
+  status = gse_encap_append_pdu(stream, data, FRAME_LENGTH);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when appending chunk (%s)\n",
+          status, gse_get_status(status));
+    goto abort;
+  }
+  status = gse_encap_fill_frame(encap, GSE_FILL_BEST_FIT, frame, FRAME_LENGTH,
+                                &data_length, NULL);
+  if(status != GSE_STATUS_OK || data_length != FRAME_LENGTH)
+  {
+    DEBUG(verbose, "Error %#.4x when filling frame with %zu bytes (%s)\n",
+          status, data_length, gse_get_status(status));
+    goto abort;
+  }
+  status = gse_create_vfrag_with_data(&packet, data_length, 0, 0, frame,
+                                      data_length);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when creating packet (%s)\n",
+          status, gse_get_status(status));
+    goto abort;
+  }
+  /* The packet is destroyed by the deencapsulation */
+  {
+    gse_vfrag_t *pdu = NULL;
+    uint8_t label_type;
+    uint8_t rcv_label[6];
+    uint16_t protocol;
+    uint16_t packet_length;
+
+    status = gse_deencap_packet(packet, deencap, &label_type, rcv_label,
+                                &protocol, &pdu, &packet_length);
+    packet = NULL;
+    if(status != GSE_STATUS_OK)
+    {
+      DEBUG(verbose, "Error %#.4x when deencapsulating packet (%s)\n",
+            status, gse_get_status(status));
+      goto abort;
+    }
+  }
+
+  status = gse_encap_append_pdu(stream, data + FRAME_LENGTH,
+                                STREAM_LENGTH - FRAME_LENGTH);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when appending chunk (%s)\n",
+          status, gse_get_status(status));
+    goto abort;
+  }
+  if(get_packets(verbose, encap, deencap, 0, data, STREAM_LENGTH, &packet_nbr,
+                 &received, &status))
+  {
+    goto release_deencap;
+  }
+  if(status != GSE_STATUS_FIFO_EMPTY || !received)
+  {
+    DEBUG(verbose, "PDU not received\n");
+    goto release_deencap;
+  }
+
+  is_failure = 0;
+  goto release_deencap;
+
+free_packet:
+  gse_free_vfrag(&packet);
+abort:
+  gse_encap_abort_pdu(stream);
+release_deencap:
+  gse_deencap_release(deencap);
+release_encap:
+  gse_encap_release(encap);
+quit:
+  return is_failure;
+}
+
+/**
+ * @brief Check that an aborted PDU is dropped and that a PDU still open is
+ *        released with the encapsulation
+ *
+ * @param   verbose  Print debug if verbose is 1
+ * @return  0 on success, 1 on failure
+ */
+static int test_abort(int verbose)
+{
+  int is_failure = 1;
+  gse_encap_t *encap = NULL;
+  gse_encap_stream_t *stream = NULL;
+  gse_vfrag_t *packet = NULL;
+  gse_status_t status;
+  unsigned char data[STREAM_LENGTH];
+  uint8_t label[6] = { 0, 1, 2, 3, 4, 5 };
+
+  memset(data, 0x55, STREAM_LENGTH);
+
+  status = gse_encap_init(QOS_NBR, FIFO_SIZE, &encap);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when initializing encapsulation (%s)\n",
+          status, gse_get_status(status));
+    goto quit;
+  }
+
+  status = gse_encap_open_pdu(encap, STREAM_LENGTH, label, LABEL_TYPE,
+                              PROTOCOL, 1, 0, &stream);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when opening PDU (%s)\n",
+          status, gse_get_status(status));
+    goto release_encap;
+  }
+  status = gse_encap_append_pdu(stream, data, PACKET_LENGTH);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when appending chunk (%s)\n",
+          status, gse_get_status(status));
+    goto abort;
+  }
+  status = gse_encap_get_packet_copy(&packet, encap, PACKET_LENGTH / 2, 1);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when getting packet (%s)\n",
+          status, gse_get_status(status));
+    goto abort;
+  }
+  gse_free_vfrag(&packet);
+
+  /* Without FragID pool, the next PDU waits for the end of the stream */
+  if(push_pdu(verbose, encap, 100, 0xAA, 1))
+  {
+    goto abort;
+  }
+  status = gse_encap_get_packet_copy(&packet, encap, 0, 1);
+  if(status != GSE_STATUS_OK || ((packet->start[0] >> 6) & 0x3) != 0x0)
+  {
+    DEBUG(verbose, "Error %#.4x when getting subsequent fragment (%s)\n",
+          status, gse_get_status(status));
+    gse_free_vfrag(&packet);
+    goto abort;
+  }
+  gse_free_vfrag(&packet);
+  status = gse_encap_get_packet_copy(&packet, encap, 0, 1);
+  if(status != GSE_STATUS_PDU_NOT_READY)
+  {
+    DEBUG(verbose, "Status %#.4x instead of PDU not ready (%s)\n",
+          status, gse_get_status(status));
+    gse_free_vfrag(&packet);
+    goto abort;
+  }
+
+  /* Once aborted, the stream is dropped and the next PDU is sent */
+  status = gse_encap_abort_pdu(stream);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when aborting PDU (%s)\n",
+          status, gse_get_status(status));
+    goto release_encap;
+  }
+  status = gse_encap_get_packet_copy(&packet, encap, 0, 1);
+  if(status != GSE_STATUS_OK || ((packet->start[0] >> 6) & 0x3) != 0x3 ||
+     packet->start[10] != 0xAA)
+  {
+    DEBUG(verbose, "Error %#.4x when getting packet after abort (%s)\n",
+          status, gse_get_status(status));
+    gse_free_vfrag(&packet);
+    goto release_encap;
+  }
+  gse_free_vfrag(&packet);
+  status = gse_encap_get_packet_copy(&packet, encap, 0, 1);
+  if(status != GSE_STATUS_FIFO_EMPTY)
+  {
+    DEBUG(verbose, "Status %#.4x instead of FIFO empty (%s)\n",
+          status, gse_get_status(status));
+    gse_free_vfrag(&packet);
+    goto release_encap;
+  }
+
+  /* A stream still open when the encapsulation is released can only be
+   * aborted */
+  status = gse_encap_open_pdu(encap, STREAM_LENGTH, label, LABEL_TYPE,
+                              PROTOCOL, 0, 0, &stream);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when opening PDU (%s)\n",
+          status, gse_get_status(status));
+    goto release_encap;
+  }
+  status = gse_encap_release(encap);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when releasing encapsulation (%s)\n",
+          status, gse_get_status(status));
+    goto abort_only;
+  }
+  status = gse_encap_append_pdu(stream, data, PACKET_LENGTH);
+  if(status != GSE_STATUS_PDU_ABORTED)
+  {
+    DEBUG(verbose, "Status %#.4x instead of PDU aborted (%s)\n",
+          status, gse_get_status(status));
+    goto abort_only;
+  }
+  status = gse_encap_abort_pdu(stream);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when aborting PDU (%s)\n",
+          status, gse_get_status(status));
+    goto quit;
+  }
+
+  is_failure = 0;
+  goto quit;
+
+abort_only:
+  gse_encap_abort_pdu(stream);
+  goto quit;
+abort:
+  gse_encap_abort_pdu(stream);
+release_encap:
+  gse_encap_release(encap);
+quit:
+  return is_failure;
+}
+
+/**
+ * @brief Get the packets of a FIFO, deencapsulate them and check the PDU
+ *
+ * @param   verbose      Print debug if verbose is 1
+ * @param   encap        The encapsulation structure
+ * @param   deencap      The deencapsulation structure
+ * @param   qos          The QoS of the packets
+ * @param   data         The expected PDU
+ * @param   data_length  The expected PDU length
+ * @param   packet_nbr   IN/OUT: The number of packets sent
+ * @param   received     OUT: Set to 1 once the PDU is received
+ * @param   end_status   OUT: The status that stopped the packet building
+ * @return  0 on success, 1 on failure
+ */
+static int get_packets(int verbose, gse_encap_t *encap, gse_deencap_t *deencap,
+                       uint8_t qos, unsigned char *data, size_t data_length,
+                       unsigned int *packet_nbr, int *received,
+                       gse_status_t *end_status)
+{
+  gse_vfrag_t *packet = NULL;
+  gse_vfrag_t *pdu = NULL;
+  gse_status_t status;
+  uint8_t label[6];
+  uint8_t label_type;
+  uint16_t protocol;
+  uint16_t packet_length;
+
+  while((status = gse_encap_get_packet_copy(&packet, encap, PACKET_LENGTH,
+                                            qos)) == GSE_STATUS_OK)
+  {
+    (*packet_nbr)++;
+    DEBUG(verbose, "Packet S=%u E=%u length=%zu\n",
+          (packet->start[0] >> 7) & 0x1, (packet->start[0] >> 6) & 0x1,
+          packet->length);
+    /* The packet is destroyed by the deencapsulation */
+    status = gse_deencap_packet(packet, deencap, &label_type, label,
+                                &protocol, &pdu, &packet_length);
+    packet = NULL;
+    if(status == GSE_STATUS_PDU_RECEIVED)
+    {
+      if(protocol != PROTOCOL || pdu->length != data_length ||
+         memcmp(pdu->start, data, data_length) != 0)
+      {
+        DEBUG(verbose, "Unexpected PDU received\n");
+        gse_free_vfrag(&pdu);
+        return 1;
+      }
+      *received = 1;
+      gse_free_vfrag(&pdu);
+    }
+    else if(status != GSE_STATUS_OK)
+    {
+      DEBUG(verbose, "Error %#.4x when deencapsulating packet (%s)\n",
+            status, gse_get_status(status));
+      return 1;
+    }
+  }
+  *end_status = status;
+  return 0;
+}
+
+/**
+ * @brief Create a PDU filled with a pattern and give it to the encapsulation
+ *
+ * @param   verbose  Print debug if verbose is 1
+ * @param   encap    The encapsulation structure
+ * @param   length   The PDU length
+ * @param   pattern  The byte used to fill the PDU
+ * @param   qos      The QoS of the PDU
+ * @return  0 on success, 1 on failure
+ */
+static int push_pdu(int verbose, gse_encap_t *encap, size_t length,
+                    unsigned char pattern, uint8_t qos)
+{
+  gse_vfrag_t *pdu;
+  gse_status_t status;
+  uint8_t label[6] = { 0, 1, 2, 3, 4, 5 };
+
+  status = gse_create_vfrag(&pdu, length, GSE_MAX_HEADER_LENGTH,
+                            GSE_MAX_TRAILER_LENGTH);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when creating PDU (%s)\n",
+          status, gse_get_status(status));
+    return 1;
+  }
+  memset(pdu->start, pattern, length);
+  status = gse_encap_receive_pdu(pdu, encap, label, LABEL_TYPE, PROTOCOL, qos);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when receiving PDU (%s)\n",
+          status, gse_get_status(status));
+    return 1;
+  }
+  return 0;
+}
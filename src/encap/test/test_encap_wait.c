@@ -0,0 +1,647 @@
+/*
+ *
+ * This piece of software is an implementation of the Generic Stream
+ * Encapsulation (GSE) standard defined by ETSI for Linux (or other
+ * Unix-compatible OS). The library may be used to add GSE
+ * encapsulation/de-encapsulation capabilities to an application.
+ *
+ *
+ * Copyright © 2016 TAS
+ *
+ *
+ * This file is part of the GSE library.
+ *
+ *
+ * The GSE library is free software : you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY, without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see http://www.gnu.org/licenses/.
+ *
+ */
+
+/****************************************************************************/
+/**
+ *   @file          test_encap_wait.c
+ *
+ *          Project:     GSE LIBRARY
+ *
+ *          Company:     THALES ALENIA SPACE
+ *
+ *          Module name: ENCAP
+ *
+ *   @brief         Notification of the PDUs received in the encapsulation
+ *                  FIFOs
+ *
+ *   @author        Julien BERNARD / Viveris Technologies
+ *
+ */
+/****************************************************************************/
+
+/****************************************************************************
+ *
+ *   INCLUDES
+ *
+ *****************************************************************************/
+
+/* system includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+
+/* GSE includes */
+#include "encap.h"
+
+/****************************************************************************
+ *
+ *   MACROS AND CONSTANTS
+ *
+ *****************************************************************************/
+
+/** The number of FIFOs */
+#define QOS_NBR 2
+/** The size of the FIFOs */
+#define FIFO_SIZE 8
+/** The length of the PDUs */
+#define PDU_LENGTH 100
+/** The length of the GSE packets */
+#define PACKET_LENGTH 400
+/** The type of label carried by the GSE packets */
+#define LABEL_TYPE 0x0
+/** The protocol carried by the GSE packets */
+#define PROTOCOL 0x2345
+/** The modcod group of the second label */
+#define MODCOD 5
+/** The number of FragID values in the pool */
+#define FRAG_ID_NBR 4
+/** The number of PDUs considered for each GSE packet */
+#define WINDOW 3
+/** The short timeout (in microseconds) */
+#define SHORT_TIMEOUT 10000
+/** The long timeout (in microseconds) */
+#define LONG_TIMEOUT 5000000
+/** The delay before the PDU is received by the other thread
+ *  (in microseconds) */
+#define PUSH_DELAY 20000
+
+/* DEBUG macro */
+#define DEBUG(verbose, format, ...) \
+  do { \
+    if(verbose) \
+      printf(format, ##__VA_ARGS__); \
+  } while(0)
+
+/** The parameters of the thread receiving a PDU */
+typedef struct
+{
+  int verbose;         /**< Whether debug is printed */
+  gse_encap_t *encap;  /**< The encapsulation context */
+  uint8_t *label;      /**< The label of the PDU */
+  uint8_t qos;         /**< The QoS value of the PDU */
+  int res;             /**< The result of the thread */
+} push_thread_t;
+
+/** The label mapped on the default FIFOs */
+static uint8_t default_label[6] = { 0, 1, 2, 3, 4, 5 };
+/** The label mapped on the FIFOs of a modcod group */
+static uint8_t modcod_label[6] = { 5, 4, 3, 2, 1, 0 };
+
+/****************************************************************************
+ *
+ *   PROTOTYPES OF PRIVATE FUNCTIONS
+ *
+ *****************************************************************************/
+
+static int test_event_fd(int verbose);
+static int test_wait(int verbose);
+static int test_wait_modcod(int verbose);
+static int check_event(int verbose, int fd, int expected);
+static int drain(int verbose, gse_encap_t *encap, uint8_t qos);
+static int push_pdu(int verbose, gse_encap_t *encap, uint8_t label[6],
+                    uint8_t qos);
+static void *push_thread(void *arg);
+static uint64_t now_us(void);
+
+/****************************************************************************
+ *
+ *   PUBLIC FUNCTIONS
+ *
+ *****************************************************************************/
+
+/**
+ * @brief Main function for the GSE encapsulation notification test program
+ *
+ * @param argc  the number of program arguments
+ * @param argv  the program arguments
+ * @return      the unix return code:
+ *               \li 0 in case of success,
+ *               \li 1 in case of failure
+ */
+int main(int argc, char *argv[])
+{
+  int res = 1;
+  int verbose = 0;
+
+  if(argc > 2 || argc < 1)
+  {
+    printf("USAGE : test_encap_wait [verbose]\n");
+  }
+  else
+  {
+    if(argc == 2)
+    {
+      if(!strcmp(argv[1], "verbose"))
+      {
+        verbose = 1;
+      }
+      else
+      {
+        printf("USAGE : test_encap_wait [verbose]\n");
+        goto quit;
+      }
+    }
+    res = test_event_fd(verbose);
+    if(res == 0)
+    {
+      res = test_wait(verbose);
+    }
+    if(res == 0)
+    {
+      res = test_wait_modcod(verbose);
+    }
+  }
+
+quit:
+  return res;
+}
+
+/****************************************************************************
+ *
+ *   PRIVATE FUNCTIONS
+ *
+ *****************************************************************************/
+
+/**
+ * @brief Check that the eventfd is only written when a FIFO becomes non
+ *        empty, including the FIFOs of a modcod group created afterwards
+ *
+ * @param   verbose  Print debug if verbose is 1
+ * @return  0 on success, 1 on failure
+ */
+static int test_event_fd(int verbose)
+{
+  int is_failure = 1;
+  gse_encap_t *encap = NULL;
+  gse_status_t status;
+  int fd;
+  int fd2;
+
+  status = gse_encap_init(QOS_NBR, FIFO_SIZE, &encap);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when initializing encapsulation (%s)\n",
+          status, gse_get_status(status));
+    goto quit;
+  }
+  /* The modcod groups require a FragID pool */
+  status = gse_encap_set_frag_id_pool(encap, FRAG_ID_NBR, WINDOW);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when setting the FragID pool (%s)\n",
+          status, gse_get_status(status));
+    goto release;
+  }
+  status = gse_encap_get_event_fd(encap, &fd);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when getting the eventfd (%s)\n",
+          status, gse_get_status(status));
+    goto release;
+  }
+  status = gse_encap_get_event_fd(encap, &fd2);
+  if(status != GSE_STATUS_OK || fd2 != fd)
+  {
+    DEBUG(verbose, "The eventfd changed on the second call\n");
+    goto release;
+  }
+  if(check_event(verbose, fd, 0))
+  {
+    goto release;
+  }
+
+  /* Only the first PDU of a FIFO is notified */
+  if(push_pdu(verbose, encap, default_label, 0) ||
+     check_event(verbose, fd, 1) ||
+     push_pdu(verbose, encap, default_label, 0) ||
+     check_event(verbose, fd, 0))
+  {
+    goto release;
+  }
+  /* Each FIFO becoming non empty is notified */
+  if(push_pdu(verbose, encap, default_label, 1) ||
+     check_event(verbose, fd, 1))
+  {
+    goto release;
+  }
+  /* The FIFO is notified again once emptied */
+  if(drain(verbose, encap, 0) ||
+     check_event(verbose, fd, 0) ||
+     push_pdu(verbose, encap, default_label, 0) ||
+     check_event(verbose, fd, 1))
+  {
+    goto release;
+  }
+
+  /* The FIFOs of a modcod group created after the eventfd use it */
+  status = gse_encap_set_label_modcod(encap, modcod_label, LABEL_TYPE, MODCOD);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when setting the label modcod (%s)\n",
+          status, gse_get_status(status));
+    goto release;
+  }
+  if(push_pdu(verbose, encap, modcod_label, 0) ||
+     check_event(verbose, fd, 1))
+  {
+    goto release;
+  }
+  DEBUG(verbose, "eventfd notified on each empty FIFO\n");
+
+  is_failure = 0;
+
+release:
+  status = gse_encap_release(encap);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when releasing encapsulation (%s)\n",
+          status, gse_get_status(status));
+    is_failure = 1;
+  }
+quit:
+  return is_failure;
+}
+
+/**
+ * @brief Check that the wait times out on an empty FIFO and ends as soon as
+ *        a PDU is received by another thread
+ *
+ * @param   verbose  Print debug if verbose is 1
+ * @return  0 on success, 1 on failure
+ */
+static int test_wait(int verbose)
+{
+  int is_failure = 1;
+  gse_encap_t *encap = NULL;
+  gse_status_t status;
+  push_thread_t param;
+  pthread_t thread;
+  uint64_t start;
+  uint64_t elapsed;
+
+  status = gse_encap_init(QOS_NBR, FIFO_SIZE, &encap);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when initializing encapsulation (%s)\n",
+          status, gse_get_status(status));
+    goto quit;
+  }
+
+  status = gse_encap_wait_pdu(encap, QOS_NBR, 0);
+  if(status != GSE_STATUS_INVALID_QOS)
+  {
+    DEBUG(verbose, "Wait on an invalid QoS returned %#.4x (%s)\n",
+          status, gse_get_status(status));
+    goto release;
+  }
+  status = gse_encap_wait_pdu(encap, 0, 0);
+  if(status != GSE_STATUS_FIFO_EMPTY)
+  {
+    DEBUG(verbose, "Check of an empty FIFO returned %#.4x (%s)\n",
+          status, gse_get_status(status));
+    goto release;
+  }
+
+  /* The wait lasts until the timeout */
+  start = now_us();
+  status = gse_encap_wait_pdu(encap, 0, SHORT_TIMEOUT);
+  elapsed = now_us() - start;
+  if(status != GSE_STATUS_FIFO_EMPTY || elapsed < SHORT_TIMEOUT)
+  {
+    DEBUG(verbose, "Wait on an empty FIFO returned %#.4x (%s) after %u us\n",
+          status, gse_get_status(status), (unsigned int)elapsed);
+    goto release;
+  }
+
+  /* A PDU received in another FIFO does not end the wait */
+  if(push_pdu(verbose, encap, default_label, 1))
+  {
+    goto release;
+  }
+  status = gse_encap_wait_pdu(encap, 0, SHORT_TIMEOUT);
+  if(status != GSE_STATUS_FIFO_EMPTY)
+  {
+    DEBUG(verbose, "Wait ended by a PDU of another QoS\n");
+    goto release;
+  }
+
+  /* The wait ends when the other thread receives the PDU */
+  param.verbose = verbose;
+  param.encap = encap;
+  param.label = default_label;
+  param.qos = 0;
+  param.res = 1;
+  if(pthread_create(&thread, NULL, push_thread, &param) != 0)
+  {
+    DEBUG(verbose, "Cannot create the thread\n");
+    goto release;
+  }
+  start = now_us();
+  status = gse_encap_wait_pdu(encap, 0, LONG_TIMEOUT);
+  elapsed = now_us() - start;
+  pthread_join(thread, NULL);
+  if(param.res != 0)
+  {
+    goto release;
+  }
+  if(status != GSE_STATUS_OK || elapsed >= LONG_TIMEOUT)
+  {
+    DEBUG(verbose, "Wait returned %#.4x (%s) after %u us\n",
+          status, gse_get_status(status), (unsigned int)elapsed);
+    goto release;
+  }
+  DEBUG(verbose, "Woken up %u us after the wait started\n",
+        (unsigned int)elapsed);
+
+  /* A non empty FIFO does not wait */
+  status = gse_encap_wait_pdu(encap, 0, LONG_TIMEOUT);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Wait on a non empty FIFO returned %#.4x (%s)\n",
+          status, gse_get_status(status));
+    goto release;
+  }
+
+  is_failure = 0;
+
+release:
+  status = gse_encap_release(encap);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when releasing encapsulation (%s)\n",
+          status, gse_get_status(status));
+    is_failure = 1;
+  }
+quit:
+  return is_failure;
+}
+
+/**
+ * @brief Check that the wait on a modcod group ends as soon as a PDU of a
+ *        label of the group is received by another thread
+ *
+ * @param   verbose  Print debug if verbose is 1
+ * @return  0 on success, 1 on failure
+ */
+static int test_wait_modcod(int verbose)
+{
+  int is_failure = 1;
+  gse_encap_t *encap = NULL;
+  gse_status_t status;
+  push_thread_t param;
+  pthread_t thread;
+  uint64_t start;
+  uint64_t elapsed;
+
+  status = gse_encap_init(QOS_NBR, FIFO_SIZE, &encap);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when initializing encapsulation (%s)\n",
+          status, gse_get_status(status));
+    goto quit;
+  }
+  status = gse_encap_set_frag_id_pool(encap, FRAG_ID_NBR, WINDOW);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when setting the FragID pool (%s)\n",
+          status, gse_get_status(status));
+    goto release;
+  }
+
+  status = gse_encap_wait_pdu_modcod(encap, MODCOD, QOS_NBR, 0);
+  if(status != GSE_STATUS_INVALID_QOS)
+  {
+    DEBUG(verbose, "Wait on an invalid QoS returned %#.4x (%s)\n",
+          status, gse_get_status(status));
+    goto release;
+  }
+  /* The group has no label yet, the wait lasts until the timeout */
+  start = now_us();
+  status = gse_encap_wait_pdu_modcod(encap, MODCOD, 0, SHORT_TIMEOUT);
+  elapsed = now_us() - start;
+  if(status != GSE_STATUS_FIFO_EMPTY || elapsed < SHORT_TIMEOUT)
+  {
+    DEBUG(verbose, "Wait on an empty group returned %#.4x (%s) after %u "
+          "us\n", status, gse_get_status(status), (unsigned int)elapsed);
+    goto release;
+  }
+
+  status = gse_encap_set_label_modcod(encap, modcod_label, LABEL_TYPE,
+                                      MODCOD);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when associating the label (%s)\n",
+          status, gse_get_status(status));
+    goto release;
+  }
+  /* A PDU received in the default FIFOs does not end the wait */
+  if(push_pdu(verbose, encap, default_label, 0))
+  {
+    goto release;
+  }
+  status = gse_encap_wait_pdu_modcod(encap, MODCOD, 0, SHORT_TIMEOUT);
+  if(status != GSE_STATUS_FIFO_EMPTY)
+  {
+    DEBUG(verbose, "Wait ended by a PDU of the default FIFOs\n");
+    goto release;
+  }
+
+  /* The wait ends when the other thread receives the PDU of the group */
+  param.verbose = verbose;
+  param.encap = encap;
+  param.label = modcod_label;
+  param.qos = 0;
+  param.res = 1;
+  if(pthread_create(&thread, NULL, push_thread, &param) != 0)
+  {
+    DEBUG(verbose, "Cannot create the thread\n");
+    goto release;
+  }
+  start = now_us();
+  status = gse_encap_wait_pdu_modcod(encap, MODCOD, 0, LONG_TIMEOUT);
+  elapsed = now_us() - start;
+  pthread_join(thread, NULL);
+  if(param.res != 0)
+  {
+    goto release;
+  }
+  if(status != GSE_STATUS_OK || elapsed >= LONG_TIMEOUT)
+  {
+    DEBUG(verbose, "Wait returned %#.4x (%s) after %u us\n",
+          status, gse_get_status(status), (unsigned int)elapsed);
+    goto release;
+  }
+  DEBUG(verbose, "Woken up %u us after the wait on the group started\n",
+        (unsigned int)elapsed);
+
+  is_failure = 0;
+
+release:
+  status = gse_encap_release(encap);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when releasing encapsulation (%s)\n",
+          status, gse_get_status(status));
+    is_failure = 1;
+  }
+quit:
+  return is_failure;
+}
+
+/**
+ * @brief Check whether the eventfd was written and reset it
+ *
+ * @param   verbose   Print debug if verbose is 1
+ * @param   fd        The eventfd
+ * @param   expected  Whether the eventfd shall be readable
+ * @return  0 on success, 1 on failure
+ */
+static int check_event(int verbose, int fd, int expected)
+{
+  uint64_t event;
+  ssize_t ret;
+
+  ret = read(fd, &event, sizeof(event));
+  if(expected && ret != sizeof(event))
+  {
+    DEBUG(verbose, "The eventfd is not readable\n");
+    return 1;
+  }
+  if(!expected && ret >= 0)
+  {
+    DEBUG(verbose, "The eventfd is readable (%u events)\n",
+          (unsigned int)event);
+    return 1;
+  }
+  if(expected && event != 1)
+  {
+    DEBUG(verbose, "The eventfd was written %u times instead of once\n",
+          (unsigned int)event);
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * @brief Get the packets of a FIFO until it is empty
+ *
+ * @param   verbose  Print debug if verbose is 1
+ * @param   encap    The encapsulation context
+ * @param   qos      The QoS value of the FIFO
+ * @return  0 on success, 1 on failure
+ */
+static int drain(int verbose, gse_encap_t *encap, uint8_t qos)
+{
+  gse_vfrag_t *packet;
+  gse_status_t status;
+
+  do
+  {
+    status = gse_encap_get_packet_copy(&packet, encap, PACKET_LENGTH, qos);
+    if(status == GSE_STATUS_OK)
+    {
+      gse_free_vfrag(&packet);
+    }
+  }
+  while(status == GSE_STATUS_OK);
+  if(status != GSE_STATUS_FIFO_EMPTY)
+  {
+    DEBUG(verbose, "Error %#.4x when getting a packet (%s)\n",
+          status, gse_get_status(status));
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * @brief Receive a PDU in the encapsulation context
+ *
+ * @param   verbose  Print debug if verbose is 1
+ * @param   encap    The encapsulation context
+ * @param   label    The label of the PDU
+ * @param   qos      The QoS value of the PDU
+ * @return  0 on success, 1 on failure
+ */
+static int push_pdu(int verbose, gse_encap_t *encap, uint8_t label[6],
+                    uint8_t qos)
+{
+  gse_vfrag_t *pdu;
+  gse_status_t status;
+
+  status = gse_create_vfrag(&pdu, PDU_LENGTH, GSE_MAX_HEADER_LENGTH,
+                            GSE_MAX_TRAILER_LENGTH);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when creating PDU (%s)\n",
+          status, gse_get_status(status));
+    return 1;
+  }
+  memset(pdu->start, qos, PDU_LENGTH);
+  status = gse_encap_receive_pdu(pdu, encap, label, LABEL_TYPE, PROTOCOL, qos);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when receiving PDU (%s)\n",
+          status, gse_get_status(status));
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * @brief Receive a PDU after a delay
+ *
+ * @param   arg  The parameters of the thread
+ * @return  NULL
+ */
+static void *push_thread(void *arg)
+{
+  push_thread_t *param = arg;
+
+  usleep(PUSH_DELAY);
+  param->res = push_pdu(param->verbose, param->encap, param->label,
+                        param->qos);
+  return NULL;
+}
+
+/**
+ * @brief Get the monotonic time
+ *
+ * @return  The time (in microseconds)
+ */
+static uint64_t now_us(void)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
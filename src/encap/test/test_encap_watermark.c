@@ -0,0 +1,603 @@
+/*
+ *
+ * This piece of software is an implementation of the Generic Stream
+ * Encapsulation (GSE) standard defined by ETSI for Linux (or other
+ * Unix-compatible OS). The library may be used to add GSE
+ * encapsulation/de-encapsulation capabilities to an application.
+ *
+ *
+ * Copyright © 2016 TAS
+ *
+ *
+ * This file is part of the GSE library.
+ *
+ *
+ * The GSE library is free software : you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY, without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see http://www.gnu.org/licenses/.
+ *
+ */
+
+/****************************************************************************/
+/**
+ *   @file          test_encap_watermark.c
+ *
+ *          Project:     GSE LIBRARY
+ *
+ *          Company:     THALES ALENIA SPACE
+ *
+ *          Module name: ENCAP
+ *
+ *   @brief         Watermarks of the encapsulation FIFOs
+ *
+ *   @author        Julien BERNARD / Viveris Technologies
+ *
+ */
+/****************************************************************************/
+
+/****************************************************************************
+ *
+ *   INCLUDES
+ *
+ *****************************************************************************/
+
+/* system includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+/* GSE includes */
+#include "encap.h"
+
+/****************************************************************************
+ *
+ *   MACROS AND CONSTANTS
+ *
+ *****************************************************************************/
+
+/** The number of FIFOs */
+#define QOS_NBR 2
+/** The size of the FIFOs */
+#define FIFO_SIZE 8
+/** The length of the PDUs */
+#define PDU_LENGTH 300
+/** The Total Length field of the PDUs (6-byte label) */
+#define TOTAL_LENGTH (PDU_LENGTH + 2 + 6)
+/** The length of the GSE packets, each one carries a whole PDU */
+#define PACKET_LENGTH 1000
+/** The high watermark in PDUs */
+#define HIGH_PDU_NBR 4
+/** The low watermark in PDUs */
+#define LOW_PDU_NBR 2
+/** The high watermark in bytes */
+#define HIGH_LENGTH 1000
+/** The low watermark in bytes */
+#define LOW_LENGTH 500
+/** The type of label carried by the GSE packets */
+#define LABEL_TYPE 0x0
+/** The protocol carried by the GSE packets */
+#define PROTOCOL 0x2345
+/** The modcod group of the second label */
+#define MODCOD 3
+/** The number of FragID values in the pool */
+#define FRAG_ID_NBR 4
+/** The number of PDUs considered for each GSE packet */
+#define WINDOW 3
+
+/* DEBUG macro */
+#define DEBUG(verbose, format, ...) \
+  do { \
+    if(verbose) \
+      printf(format, ##__VA_ARGS__); \
+  } while(0)
+
+/** The calls of the watermark callback */
+typedef struct
+{
+  unsigned int call_nbr[QOS_NBR]; /**< Number of calls per QoS value */
+  int congested[QOS_NBR];         /**< Last state given per QoS value */
+} events_t;
+
+/** The label mapped on the default FIFOs */
+static uint8_t default_label[6] = { 0, 1, 2, 3, 4, 5 };
+/** The label mapped on the FIFOs of a modcod group */
+static uint8_t modcod_label[6] = { 5, 4, 3, 2, 1, 0 };
+
+/****************************************************************************
+ *
+ *   PROTOTYPES OF PRIVATE FUNCTIONS
+ *
+ *****************************************************************************/
+
+static int test_pdu_nbr(int verbose);
+static int test_length(int verbose);
+static int test_modcod(int verbose);
+static int init_encap(int verbose, gse_encap_t **encap, events_t *events);
+static int release_encap(int verbose, gse_encap_t *encap);
+static int check_state(int verbose, gse_encap_t *encap, events_t *events,
+                       uint8_t qos, unsigned int call_nbr, int congested);
+static int get_packet(int verbose, gse_encap_t *encap, uint8_t qos);
+static int push_pdu(int verbose, gse_encap_t *encap, uint8_t label[6],
+                    uint8_t qos);
+static void watermark_cb(uint8_t qos, int congested, void *opaque);
+
+/****************************************************************************
+ *
+ *   PUBLIC FUNCTIONS
+ *
+ *****************************************************************************/
+
+/**
+ * @brief Main function for the GSE encapsulation watermarks test program
+ *
+ * @param argc  the number of program arguments
+ * @param argv  the program arguments
+ * @return      the unix return code:
+ *               \li 0 in case of success,
+ *               \li 1 in case of failure
+ */
+int main(int argc, char *argv[])
+{
+  int res = 1;
+  int verbose = 0;
+
+  if(argc > 2 || argc < 1)
+  {
+    printf("USAGE : test_encap_watermark [verbose]\n");
+  }
+  else
+  {
+    if(argc == 2)
+    {
+      if(!strcmp(argv[1], "verbose"))
+      {
+        verbose = 1;
+      }
+      else
+      {
+        printf("USAGE : test_encap_watermark [verbose]\n");
+        goto quit;
+      }
+    }
+    res = test_pdu_nbr(verbose);
+    if(res == 0)
+    {
+      res = test_length(verbose);
+    }
+    if(res == 0)
+    {
+      res = test_modcod(verbose);
+    }
+  }
+
+quit:
+  return res;
+}
+
+/****************************************************************************
+ *
+ *   PRIVATE FUNCTIONS
+ *
+ *****************************************************************************/
+
+/**
+ * @brief Check the watermarks in PDUs, with hysteresis between them
+ *
+ * @param   verbose  Print debug if verbose is 1
+ * @return  0 on success, 1 on failure
+ */
+static int test_pdu_nbr(int verbose)
+{
+  int is_failure = 1;
+  gse_encap_t *encap = NULL;
+  gse_status_t status;
+  events_t events;
+  unsigned int i;
+
+  if(init_encap(verbose, &encap, &events))
+  {
+    goto quit;
+  }
+  status = gse_encap_set_watermarks(encap, QOS_NBR, HIGH_PDU_NBR,
+                                    LOW_PDU_NBR, 0, 0);
+  if(status != GSE_STATUS_INVALID_QOS)
+  {
+    DEBUG(verbose, "Watermarks set on an invalid QoS value\n");
+    goto release;
+  }
+  status = gse_encap_set_watermarks(encap, 0, HIGH_PDU_NBR, LOW_PDU_NBR,
+                                    0, 0);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when setting the watermarks (%s)\n",
+          status, gse_get_status(status));
+    goto release;
+  }
+
+  /* The QoS value is congested at the high watermark */
+  for(i = 0 ; i < HIGH_PDU_NBR - 1 ; i++)
+  {
+    if(push_pdu(verbose, encap, default_label, 0))
+    {
+      goto release;
+    }
+  }
+  if(check_state(verbose, encap, &events, 0, 0, 0) ||
+     push_pdu(verbose, encap, default_label, 0) ||
+     check_state(verbose, encap, &events, 0, 1, 1) ||
+     push_pdu(verbose, encap, default_label, 0) ||
+     check_state(verbose, encap, &events, 0, 1, 1) ||
+     check_state(verbose, encap, &events, 1, 0, 0))
+  {
+    goto release;
+  }
+
+  /* It stays congested until the low watermark */
+  for(i = HIGH_PDU_NBR + 1 ; i > LOW_PDU_NBR + 1 ; i--)
+  {
+    if(get_packet(verbose, encap, 0) ||
+       check_state(verbose, encap, &events, 0, 1, 1))
+    {
+      goto release;
+    }
+  }
+  if(get_packet(verbose, encap, 0) ||
+     check_state(verbose, encap, &events, 0, 2, 0))
+  {
+    goto release;
+  }
+
+  /* Lower watermarks apply at once, the low watermark is lowered below the
+   * high one */
+  status = gse_encap_set_watermarks(encap, 0, LOW_PDU_NBR, HIGH_PDU_NBR,
+                                    0, 0);
+  if(status != GSE_STATUS_OK ||
+     check_state(verbose, encap, &events, 0, 3, 1) ||
+     get_packet(verbose, encap, 0) ||
+     check_state(verbose, encap, &events, 0, 4, 0))
+  {
+    goto release;
+  }
+
+  /* Disabled watermarks end the congestion */
+  if(push_pdu(verbose, encap, default_label, 0) ||
+     check_state(verbose, encap, &events, 0, 5, 1))
+  {
+    goto release;
+  }
+  status = gse_encap_set_watermarks(encap, 0, 0, 0, 0, 0);
+  if(status != GSE_STATUS_OK ||
+     check_state(verbose, encap, &events, 0, 6, 0))
+  {
+    goto release;
+  }
+  DEBUG(verbose, "Watermarks in PDUs respected\n");
+
+  is_failure = 0;
+
+release:
+  if(release_encap(verbose, encap))
+  {
+    is_failure = 1;
+  }
+quit:
+  return is_failure;
+}
+
+/**
+ * @brief Check the watermarks in bytes
+ *
+ * @param   verbose  Print debug if verbose is 1
+ * @return  0 on success, 1 on failure
+ */
+static int test_length(int verbose)
+{
+  int is_failure = 1;
+  gse_encap_t *encap = NULL;
+  gse_status_t status;
+  events_t events;
+  unsigned int pdu_nbr = 0;
+
+  if(init_encap(verbose, &encap, &events))
+  {
+    goto quit;
+  }
+  status = gse_encap_set_watermarks(encap, 1, 0, 0, HIGH_LENGTH, LOW_LENGTH);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when setting the watermarks (%s)\n",
+          status, gse_get_status(status));
+    goto release;
+  }
+
+  while((pdu_nbr + 1) * TOTAL_LENGTH < HIGH_LENGTH)
+  {
+    if(push_pdu(verbose, encap, default_label, 1) ||
+       check_state(verbose, encap, &events, 1, 0, 0))
+    {
+      goto release;
+    }
+    pdu_nbr++;
+  }
+  if(push_pdu(verbose, encap, default_label, 1) ||
+     check_state(verbose, encap, &events, 1, 1, 1))
+  {
+    goto release;
+  }
+  pdu_nbr++;
+  while((pdu_nbr - 1) * TOTAL_LENGTH > LOW_LENGTH)
+  {
+    if(get_packet(verbose, encap, 1) ||
+       check_state(verbose, encap, &events, 1, 1, 1))
+    {
+      goto release;
+    }
+    pdu_nbr--;
+  }
+  if(get_packet(verbose, encap, 1) ||
+     check_state(verbose, encap, &events, 1, 2, 0) ||
+     check_state(verbose, encap, &events, 0, 0, 0))
+  {
+    goto release;
+  }
+  DEBUG(verbose, "Watermarks in bytes respected\n");
+
+  is_failure = 0;
+
+release:
+  if(release_encap(verbose, encap))
+  {
+    is_failure = 1;
+  }
+quit:
+  return is_failure;
+}
+
+/**
+ * @brief Check that the FIFOs of the modcod groups share the state of their
+ *        QoS value
+ *
+ * @param   verbose  Print debug if verbose is 1
+ * @return  0 on success, 1 on failure
+ */
+static int test_modcod(int verbose)
+{
+  int is_failure = 1;
+  gse_encap_t *encap = NULL;
+  gse_status_t status;
+  events_t events;
+  unsigned int i;
+
+  if(init_encap(verbose, &encap, &events))
+  {
+    goto quit;
+  }
+  status = gse_encap_set_frag_id_pool(encap, FRAG_ID_NBR, WINDOW);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when setting the FragID pool (%s)\n",
+          status, gse_get_status(status));
+    goto release;
+  }
+  status = gse_encap_set_watermarks(encap, 0, HIGH_PDU_NBR, LOW_PDU_NBR,
+                                    0, 0);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when setting the watermarks (%s)\n",
+          status, gse_get_status(status));
+    goto release;
+  }
+  /* The modcod FIFOs are created after the watermarks */
+  status = gse_encap_set_label_modcod(encap, modcod_label, LABEL_TYPE, MODCOD);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when setting the label modcod (%s)\n",
+          status, gse_get_status(status));
+    goto release;
+  }
+
+  /* Both FIFOs congested only notify once */
+  for(i = 0 ; i < HIGH_PDU_NBR ; i++)
+  {
+    if(push_pdu(verbose, encap, modcod_label, 0) ||
+       push_pdu(verbose, encap, default_label, 0))
+    {
+      goto release;
+    }
+  }
+  if(check_state(verbose, encap, &events, 0, 1, 1))
+  {
+    goto release;
+  }
+  /* The QoS value stays congested while the modcod FIFO is */
+  for(i = 0 ; i < HIGH_PDU_NBR ; i++)
+  {
+    if(get_packet(verbose, encap, 0))
+    {
+      goto release;
+    }
+  }
+  if(check_state(verbose, encap, &events, 0, 1, 1))
+  {
+    goto release;
+  }
+  DEBUG(verbose, "Watermarks of the modcod FIFOs respected\n");
+
+  is_failure = 0;
+
+release:
+  if(release_encap(verbose, encap))
+  {
+    is_failure = 1;
+  }
+quit:
+  return is_failure;
+}
+
+/**
+ * @brief Initialize the encapsulation with the watermark callback
+ *
+ * @param   verbose  Print debug if verbose is 1
+ * @param   encap    OUT: The encapsulation context
+ * @param   events   The calls of the callback
+ * @return  0 on success, 1 on failure
+ */
+static int init_encap(int verbose, gse_encap_t **encap, events_t *events)
+{
+  gse_status_t status;
+
+  memset(events, 0, sizeof(events_t));
+  status = gse_encap_init(QOS_NBR, FIFO_SIZE, encap);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when initializing encapsulation (%s)\n",
+          status, gse_get_status(status));
+    return 1;
+  }
+  status = gse_encap_set_watermark_callback(*encap, watermark_cb, events);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when setting the callback (%s)\n",
+          status, gse_get_status(status));
+    gse_encap_release(*encap);
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * @brief Release the encapsulation
+ *
+ * @param   verbose  Print debug if verbose is 1
+ * @param   encap    The encapsulation context
+ * @return  0 on success, 1 on failure
+ */
+static int release_encap(int verbose, gse_encap_t *encap)
+{
+  gse_status_t status;
+
+  status = gse_encap_release(encap);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when releasing encapsulation (%s)\n",
+          status, gse_get_status(status));
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * @brief Check the congestion state of a QoS value
+ *
+ * @param   verbose    Print debug if verbose is 1
+ * @param   encap      The encapsulation context
+ * @param   events     The calls of the callback
+ * @param   qos        The QoS value
+ * @param   call_nbr   The expected number of calls of the callback
+ * @param   congested  The expected state
+ * @return  0 on success, 1 on failure
+ */
+static int check_state(int verbose, gse_encap_t *encap, events_t *events,
+                       uint8_t qos, unsigned int call_nbr, int congested)
+{
+  if(gse_encap_is_congested(encap, qos) != congested)
+  {
+    DEBUG(verbose, "QoS %u is %scongested\n", qos, congested ? "not " : "");
+    return 1;
+  }
+  if(events->call_nbr[qos] != call_nbr)
+  {
+    DEBUG(verbose, "Callback called %u times for QoS %u instead of %u\n",
+          events->call_nbr[qos], qos, call_nbr);
+    return 1;
+  }
+  if(call_nbr > 0 && events->congested[qos] != congested)
+  {
+    DEBUG(verbose, "Callback gave a wrong state for QoS %u\n", qos);
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * @brief Get a GSE packet carrying a whole PDU
+ *
+ * @param   verbose  Print debug if verbose is 1
+ * @param   encap    The encapsulation context
+ * @param   qos      The QoS value of the FIFO
+ * @return  0 on success, 1 on failure
+ */
+static int get_packet(int verbose, gse_encap_t *encap, uint8_t qos)
+{
+  gse_vfrag_t *packet;
+  gse_status_t status;
+
+  status = gse_encap_get_packet_copy(&packet, encap, PACKET_LENGTH, qos);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when getting a packet (%s)\n",
+          status, gse_get_status(status));
+    return 1;
+  }
+  gse_free_vfrag(&packet);
+  return 0;
+}
+
+/**
+ * @brief Receive a PDU in the encapsulation context
+ *
+ * @param   verbose  Print debug if verbose is 1
+ * @param   encap    The encapsulation context
+ * @param   label    The label of the PDU
+ * @param   qos      The QoS value of the PDU
+ * @return  0 on success, 1 on failure
+ */
+static int push_pdu(int verbose, gse_encap_t *encap, uint8_t label[6],
+                    uint8_t qos)
+{
+  gse_vfrag_t *pdu;
+  gse_status_t status;
+
+  status = gse_create_vfrag(&pdu, PDU_LENGTH, GSE_MAX_HEADER_LENGTH,
+                            GSE_MAX_TRAILER_LENGTH);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when creating PDU (%s)\n",
+          status, gse_get_status(status));
+    return 1;
+  }
+  memset(pdu->start, qos, PDU_LENGTH);
+  status = gse_encap_receive_pdu(pdu, encap, label, LABEL_TYPE, PROTOCOL, qos);
+  if(status != GSE_STATUS_OK)
+  {
+    DEBUG(verbose, "Error %#.4x when receiving PDU (%s)\n",
+          status, gse_get_status(status));
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * @brief Record the calls of the watermark callback
+ *
+ * @param   qos        The QoS value
+ * @param   congested  Whether the QoS value becomes congested
+ * @param   opaque     The calls of the callback
+ */
+static void watermark_cb(uint8_t qos, int congested, void *opaque)
+{
+  events_t *events = opaque;
+
+  events->call_nbr[qos]++;
+  events->congested[qos] = congested;
+}